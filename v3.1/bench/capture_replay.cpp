@@ -0,0 +1,451 @@
+/**
+ * Spider Robot v3.1 - Capture replay
+ *
+ * Plays a command capture (brain_daemon --capture, see
+ * brain_linux/src/capture.h) back into brain_daemon or brain_sim with the
+ * recorded timing, scaled by --speed, or as fast as the daemon takes it.
+ *
+ * Each WebSocket client in the capture gets its own connection, so
+ * per-client ordering and interleaving are kept. Serial input is written
+ * to --serial (a pty the daemon was started on, or the real port) in the
+ * chunks it was read in; without --serial it is skipped. Recorded
+ * PosePacket31s are outputs and are never sent; capture the replayed run
+ * too and compare the two with --dump.
+ *
+ * At the end every connection is pinged and the pongs awaited, so the
+ * elapsed time covers the daemon handling everything sent. The report
+ * gives how late each record went out against its schedule (slip).
+ *
+ * Usage: capture_replay FILE [--host H] [--port 9000] [--speed 1|N|max]
+ *                            [--serial PATH] [--json PATH]
+ *        capture_replay FILE --dump
+ */
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "capture.h"
+#include "latency_histogram.h"
+#include "ws_frame.h"
+
+extern "C" {
+#include "timebase.h"
+}
+
+#define REPLAY_MAX_CLIENTS      8           // MAX_CLIENTS in brain_linux/src/main.cpp
+#define REPLAY_TX_LIMIT         (256 * 1024)
+#define REPLAY_DRAIN_TIMEOUT_US 5000000ULL  // Longest wait for the final pongs
+
+struct Options {
+    const char* file = nullptr;
+    const char* host = "127.0.0.1";
+    int port = 9000;
+    double speed = 1.0;                 // 0 = max
+    const char* serial = nullptr;
+    const char* json = nullptr;
+    bool dump = false;
+};
+
+struct Conn {
+    int fd = -1;
+    std::vector<uint8_t> rx;
+    std::string tx;
+    uint32_t seed = 1;
+    bool ponged = false;
+};
+
+struct Stats {
+    LatencyHistogram slip;
+    uint64_t sent[CAPTURE_KIND_COUNT] = {};
+    uint64_t skipped[CAPTURE_KIND_COUNT] = {};
+    uint64_t bytes = 0;
+    uint64_t replies = 0;
+    uint64_t errors = 0;
+    uint64_t disconnects = 0;
+};
+
+static volatile sig_atomic_t g_stop = 0;
+
+static void on_signal(int) { g_stop = 1; }
+
+static uint32_t next_rand(uint32_t& s) {
+    s ^= s << 13;
+    s ^= s >> 17;
+    s ^= s << 5;
+    return s;
+}
+
+// ---- Connection ----
+
+static int connect_ws(const Options& opt, std::vector<uint8_t>& leftover) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)opt.port);
+    if (inet_pton(AF_INET, opt.host, &addr.sin_addr) != 1 ||
+        connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    const char* req =
+        "GET / HTTP/1.1\r\n"
+        "Upgrade: websocket\r\n"
+        "Connection: Upgrade\r\n"
+        "Sec-WebSocket-Key: c3BpZGVyLXJlcGxheS0wMQ==\r\n"
+        "Sec-WebSocket-Version: 13\r\n"
+        "\r\n";
+    if (send(fd, req, strlen(req), MSG_NOSIGNAL) != (ssize_t)strlen(req)) {
+        close(fd);
+        return -1;
+    }
+
+    timeval tv = {2, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    std::string resp;
+    char buf[1024];
+    size_t end;
+    while ((end = resp.find("\r\n\r\n")) == std::string::npos) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0) {
+            close(fd);
+            return -1;
+        }
+        resp.append(buf, (size_t)n);
+    }
+    if (resp.compare(0, 12, "HTTP/1.1 101") != 0) {
+        close(fd);
+        return -1;
+    }
+    leftover.assign(resp.begin() + end + 4, resp.end());
+    tv = {0, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return fd;
+}
+
+// Masked client frame of any length
+static void append_frame(std::string& tx, uint8_t opcode, const void* data, size_t len, uint32_t& seed) {
+    tx.push_back((char)(0x80 | opcode));
+    if (len < 126) {
+        tx.push_back((char)(0x80 | len));
+    } else if (len <= 0xFFFF) {
+        tx.push_back((char)(0x80 | 126));
+        tx.push_back((char)(len >> 8));
+        tx.push_back((char)len);
+    } else {
+        tx.push_back((char)(0x80 | 127));
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            tx.push_back((char)((uint64_t)len >> shift));
+        }
+    }
+    uint32_t m = next_rand(seed);
+    uint8_t mask[4];
+    memcpy(mask, &m, 4);
+    tx.append((const char*)mask, 4);
+    const uint8_t* p = (const uint8_t*)data;
+    for (size_t i = 0; i < len; i++) {
+        tx.push_back((char)(p[i] ^ mask[i % 4]));
+    }
+}
+
+static bool flush_tx(Conn& c) {
+    while (!c.tx.empty()) {
+        ssize_t n = send(c.fd, c.tx.data(), c.tx.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        c.tx.erase(0, (size_t)n);
+    }
+    return true;
+}
+
+// Replies are broadcast; only the first connection counts them. Returns false on close
+static bool handle_rx(Conn& c, bool observer, Stats& st) {
+    size_t off = 0;
+    WsFrameHeader hdr;
+    while (ws_frame_parse(c.rx.data() + off, c.rx.size() - off, hdr)) {
+        const char* payload = (const char*)c.rx.data() + off + hdr.header_len;
+        if (hdr.opcode == 0x0A) {
+            c.ponged = true;
+        } else if (hdr.opcode == 0x01 && observer) {
+            st.replies++;
+            std::string text(payload, (size_t)hdr.payload_len);
+            if (text.find("\"error\"") != std::string::npos) st.errors++;
+        } else if (hdr.opcode == 0x08) {
+            return false;
+        }
+        off += hdr.header_len + (size_t)hdr.payload_len;
+    }
+    c.rx.erase(c.rx.begin(), c.rx.begin() + off);
+    return true;
+}
+
+static bool poll_conns(std::vector<Conn>& conns, Stats& st, int timeout_ms) {
+    std::vector<pollfd> pfds(conns.size());
+    for (size_t i = 0; i < conns.size(); i++) {
+        const Conn& c = conns[i];
+        pfds[i] = {c.fd, (short)(POLLIN | (c.tx.empty() ? 0 : POLLOUT)), 0};
+    }
+    if (poll(pfds.data(), pfds.size(), timeout_ms) < 0 && errno != EINTR) {
+        perror("poll");
+        return false;
+    }
+
+    uint8_t buf[16384];
+    for (size_t i = 0; i < conns.size(); i++) {
+        Conn& c = conns[i];
+        if (c.fd < 0) continue;
+        bool ok = flush_tx(c);
+        if (ok && (pfds[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+            ssize_t n;
+            while ((n = recv(c.fd, buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+                c.rx.insert(c.rx.end(), buf, buf + n);
+            }
+            ok = n != 0 && handle_rx(c, i == 0, st);
+        }
+        if (!ok) {
+            close(c.fd);
+            c.fd = -1;
+            st.disconnects++;
+        }
+    }
+    return true;
+}
+
+// ---- Dump ----
+
+static void dump(CaptureReader& reader) {
+    const CaptureFileHeader* hdr = reader.header();
+    printf("capacity %llu KB, %u records written, %u dropped, %llu KB held\n",
+           (unsigned long long)(hdr->capacity / 1024), hdr->records, hdr->dropped,
+           (unsigned long long)((hdr->head - hdr->tail) / 1024));
+
+    CaptureRecordView rec;
+    uint64_t base = 0;
+    while (reader.next(rec)) {
+        if (base == 0) base = rec.t_us;
+        printf("%12.3f ms  %-9s", (double)(int64_t)(rec.t_us - base) / 1000.0,
+               capture_kind_name(rec.kind));
+        if (rec.kind == CAPTURE_WS_TEXT) {
+            printf(" fd=%-3u %.*s\n", rec.source, (int)std::min<size_t>(rec.len, 160), (const char*)rec.data);
+        } else if (rec.kind == CAPTURE_POSE_TX && rec.len >= sizeof(CapturePose)) {
+            CapturePose pose;
+            memcpy(&pose, rec.data, sizeof(pose));
+            printf(" seq=%u t_ms=%u flags=0x%04x exec_at=%llu us=", pose.pkt.seq, pose.pkt.t_ms,
+                   pose.pkt.flags, (unsigned long long)pose.exec_at_us);
+            for (int ch = 0; ch < SERVO_COUNT_TOTAL; ch++) {
+                printf(ch ? ",%u" : "%u", pose.pkt.servo_us[ch]);
+            }
+            printf("\n");
+        } else {
+            printf(" fd=%-3u %zu bytes\n", rec.source, rec.len);
+        }
+    }
+    if (reader.corrupt()) {
+        printf("(stopped at a damaged record)\n");
+    }
+}
+
+// ---- Replay ----
+
+static void report(const Options& opt, FILE* json, const Stats& st, double elapsed_s, double span_s) {
+    LatencyHistogram::Snapshot s;
+    st.slip.snapshot(s);
+    unsigned long long p50 = s.percentile(0.50), p99 = s.percentile(0.99), max = s.max_us;
+    uint64_t sent = st.sent[CAPTURE_WS_TEXT] + st.sent[CAPTURE_WS_BINARY] + st.sent[CAPTURE_SERIAL_RX];
+    printf("replayed %llu records (%llu text, %llu binary, %llu serial) in %.3f s, capture spans %.3f s\n",
+           (unsigned long long)sent, (unsigned long long)st.sent[CAPTURE_WS_TEXT],
+           (unsigned long long)st.sent[CAPTURE_WS_BINARY], (unsigned long long)st.sent[CAPTURE_SERIAL_RX],
+           elapsed_s, span_s);
+    printf("  rate %.1f/s, slip p50 %llu us p99 %llu us max %llu us\n",
+           elapsed_s > 0 ? sent / elapsed_s : 0.0, p50, p99, max);
+    printf("  replies %llu (%llu errors), skipped %llu serial, %llu poses, disconnects %llu\n",
+           (unsigned long long)st.replies, (unsigned long long)st.errors,
+           (unsigned long long)st.skipped[CAPTURE_SERIAL_RX], (unsigned long long)st.skipped[CAPTURE_POSE_TX],
+           (unsigned long long)st.disconnects);
+
+    if (json) {
+        fprintf(json, "{\"file\":\"%s\",\"speed\":%g,\"sent\":%llu,\"bytes\":%llu,\"elapsed_s\":%.3f,"
+                      "\"span_s\":%.3f,\"slip_us\":{\"p50\":%llu,\"p99\":%llu,\"max\":%llu},"
+                      "\"replies\":%llu,\"errors\":%llu,\"disconnects\":%llu}\n",
+                opt.file, opt.speed, (unsigned long long)sent, (unsigned long long)st.bytes,
+                elapsed_s, span_s, p50, p99, max, (unsigned long long)st.replies,
+                (unsigned long long)st.errors, (unsigned long long)st.disconnects);
+    }
+}
+
+static int replay(const Options& opt, CaptureReader& reader, FILE* json) {
+    // One connection per recorded client fd, in order of first appearance
+    std::map<uint16_t, size_t> conn_of;
+    uint64_t first_us = 0, last_us = 0;
+    CaptureRecordView rec;
+    while (reader.next(rec)) {
+        if (rec.kind == CAPTURE_POSE_TX) continue;
+        if (first_us == 0) first_us = rec.t_us;
+        last_us = rec.t_us;
+        if ((rec.kind == CAPTURE_WS_TEXT || rec.kind == CAPTURE_WS_BINARY) &&
+            !conn_of.count(rec.source)) {
+            size_t idx = conn_of.size();
+            conn_of[rec.source] = idx;
+        }
+    }
+    if (conn_of.size() > REPLAY_MAX_CLIENTS) {
+        fprintf(stderr, "%zu clients in the capture; clients past %d share the last connection\n",
+                conn_of.size(), REPLAY_MAX_CLIENTS);
+        for (auto& kv : conn_of) kv.second = std::min(kv.second, (size_t)REPLAY_MAX_CLIENTS - 1);
+    }
+
+    std::vector<Conn> conns(std::min(conn_of.size(), (size_t)REPLAY_MAX_CLIENTS));
+    for (size_t i = 0; i < conns.size(); i++) {
+        conns[i].seed = 0x9E3779B9u * (uint32_t)(i + 1);
+        conns[i].fd = connect_ws(opt, conns[i].rx);
+        if (conns[i].fd < 0) {
+            fprintf(stderr, "Cannot connect to %s:%d\n", opt.host, opt.port);
+            return 1;
+        }
+    }
+
+    int serial_fd = -1;
+    if (opt.serial && (serial_fd = open(opt.serial, O_WRONLY | O_NOCTTY | O_CLOEXEC)) < 0) {
+        fprintf(stderr, "Cannot open %s: %s\n", opt.serial, strerror(errno));
+        return 1;
+    }
+
+    Stats st;
+    const uint64_t start = timebase_micros();
+    reader.rewind();
+    while (!g_stop && reader.next(rec)) {
+        if (rec.kind == CAPTURE_POSE_TX || (rec.kind == CAPTURE_SERIAL_RX && serial_fd < 0)) {
+            st.skipped[rec.kind]++;
+            continue;
+        }
+
+        uint64_t due = start + (opt.speed > 0 ? (uint64_t)((rec.t_us - first_us) / opt.speed) : 0);
+        uint64_t now = timebase_micros();
+        while (!g_stop && now < due) {
+            // The last partial millisecond is polled without sleeping, for accuracy
+            if (!poll_conns(conns, st, (int)((due - now) / 1000))) break;
+            now = timebase_micros();
+        }
+        if (opt.speed > 0) st.slip.record(now - due);
+
+        if (rec.kind == CAPTURE_SERIAL_RX) {
+            if (write(serial_fd, rec.data, rec.len) != (ssize_t)rec.len) {
+                fprintf(stderr, "Serial write failed: %s\n", strerror(errno));
+                break;
+            }
+        } else {
+            Conn& c = conns[conn_of[rec.source]];
+            if (c.fd < 0) {
+                st.skipped[rec.kind]++;
+                continue;
+            }
+            // At max speed, let the daemon catch up rather than queue without bound
+            while (!g_stop && c.fd >= 0 && c.tx.size() > REPLAY_TX_LIMIT) {
+                poll_conns(conns, st, 10);
+            }
+            append_frame(c.tx, rec.kind == CAPTURE_WS_TEXT ? 0x01 : 0x02, rec.data, rec.len, c.seed);
+            flush_tx(c);
+        }
+        st.sent[rec.kind]++;
+        st.bytes += rec.len;
+    }
+
+    // Everything sent has been handled once each connection's pong is back
+    for (Conn& c : conns) {
+        if (c.fd >= 0) append_frame(c.tx, 0x09, nullptr, 0, c.seed);
+    }
+    const uint64_t drain_end = timebase_micros() + REPLAY_DRAIN_TIMEOUT_US;
+    while (!g_stop && timebase_micros() < drain_end) {
+        bool waiting = false;
+        for (const Conn& c : conns) waiting |= c.fd >= 0 && !c.ponged;
+        if (!waiting || !poll_conns(conns, st, 10)) break;
+    }
+
+    report(opt, json, st, (timebase_micros() - start) / 1e6, (last_us - first_us) / 1e6);
+    for (Conn& c : conns) {
+        if (c.fd >= 0) close(c.fd);
+    }
+    if (serial_fd >= 0) close(serial_fd);
+    return 0;
+}
+
+static void usage(const char* prog) {
+    printf("Usage: %s FILE [options]\n"
+           "  --host HOST       Daemon address (default 127.0.0.1)\n"
+           "  --port PORT       WebSocket port (default 9000)\n"
+           "  --speed S         1 = as recorded, N = N times faster, max = no waits (default 1)\n"
+           "  --serial PATH     Write recorded serial input here (default: skip it)\n"
+           "  --json PATH       Append the report as a JSON line\n"
+           "  --dump            Print the records instead of replaying them\n",
+           prog);
+}
+
+int main(int argc, char* argv[]) {
+    Options opt;
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i];
+        const char* v = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        if (!strcmp(a, "--host") && v) { opt.host = v; i++; }
+        else if (!strcmp(a, "--port") && v) { opt.port = atoi(v); i++; }
+        else if (!strcmp(a, "--speed") && v) {
+            opt.speed = strcmp(v, "max") ? atof(v) : 0.0;
+            if (opt.speed < 0 || (opt.speed == 0 && strcmp(v, "max"))) {
+                fprintf(stderr, "Bad --speed '%s'\n", v);
+                return 1;
+            }
+            i++;
+        }
+        else if (!strcmp(a, "--serial") && v) { opt.serial = v; i++; }
+        else if (!strcmp(a, "--json") && v) { opt.json = v; i++; }
+        else if (!strcmp(a, "--dump")) { opt.dump = true; }
+        else if (a[0] != '-' && !opt.file) { opt.file = a; }
+        else {
+            usage(argv[0]);
+            return !strcmp(a, "-h") || !strcmp(a, "--help") ? 0 : 1;
+        }
+    }
+    if (!opt.file) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    CaptureReader reader;
+    if (!reader.open(opt.file)) {
+        fprintf(stderr, "Cannot read capture %s\n", opt.file);
+        return 1;
+    }
+    if (opt.dump) {
+        dump(reader);
+        return 0;
+    }
+
+    FILE* json = nullptr;
+    if (opt.json && !(json = fopen(opt.json, "a"))) {
+        fprintf(stderr, "Cannot open %s: %s\n", opt.json, strerror(errno));
+        return 1;
+    }
+
+    std::signal(SIGINT, on_signal);
+    std::signal(SIGTERM, on_signal);
+    int rc = replay(opt, reader, json);
+    if (json) fclose(json);
+    return rc;
+}
@@ -0,0 +1,58 @@
+#!/usr/bin/env python3
+"""
+Compare two spider_bench baselines (--json output).
+
+Prints ns/op and allocs/op side by side. Exits 1 if a benchmark got slower
+than --threshold percent, or now allocates where it did not, so it can
+gate a release build.
+
+Usage: compare.py OLD.json NEW.json [--threshold 10]
+"""
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path) as f:
+        data = json.load(f)
+    if data.get("format") != 1:
+        raise SystemExit(f"{path}: unsupported baseline format {data.get('format')}")
+    return {r["name"]: r for r in data["results"]}
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Diff two spider_bench baselines")
+    parser.add_argument("old")
+    parser.add_argument("new")
+    parser.add_argument("--threshold", type=float, default=10.0,
+                        help="slowdown in percent that counts as a regression")
+    args = parser.parse_args()
+
+    old, new = load(args.old), load(args.new)
+    regressions = 0
+
+    print(f"{'benchmark':<28} {'old ns':>10} {'new ns':>10} {'delta':>8} {'allocs':>13}")
+    for name in sorted(set(old) | set(new)):
+        if name not in old or name not in new:
+            print(f"{name:<28} {'only in ' + ('new' if name in new else 'old'):>30}")
+            continue
+        o, n = old[name], new[name]
+        delta = 100.0 * (n["ns_per_op"] - o["ns_per_op"]) / max(o["ns_per_op"], 1e-9)
+        allocs = f"{o['allocs_per_op']:.2f}->{n['allocs_per_op']:.2f}"
+        flag = ""
+        if delta > args.threshold or (o["allocs_per_op"] == 0 and n["allocs_per_op"] > 0):
+            flag = "  REGRESSION"
+            regressions += 1
+        print(f"{name:<28} {o['ns_per_op']:>10.1f} {n['ns_per_op']:>10.1f} {delta:>+7.1f}% "
+              f"{allocs:>13}{flag}")
+
+    if regressions:
+        print(f"\n{regressions} regression(s) above {args.threshold:.0f}%")
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,406 @@
+/**
+ * Spider Robot v3.1 - Hot path micro-benchmarks
+ *
+ * Times the code every command, packet and frame goes through: CRC,
+ * packet encoding, WebSocket frame decoding, JSON command parsing, reply
+ * formatting, the Muscle interpolator, eye rendering and the framebuffer
+ * byte swap.
+ *
+ * Each benchmark is calibrated to run for at least --min-ms, then timed
+ * over --reps repetitions; the median is reported, so runs on an idle
+ * machine repeat to a few percent. Heap allocations (operator new) are
+ * counted per op. --json writes a baseline for compare.py.
+ *
+ * Usage: spider_bench [--filter SUBSTR] [--min-ms 50] [--reps 5] [--json PATH]
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "json_tokenizer.h"
+#include "motion_thread.h"
+#include "reply_arena.h"
+#include "servo_calibration.h"
+#include "ws_frame.h"
+#include "eye_renderer.hpp"
+#include "dual_eye_display.hpp"
+#include "rgb565_kernels.hpp"
+
+extern "C" {
+#include "crc16_ccitt_false.h"
+#include "protocol_posepacket31.h"
+#include "interpolator.h"
+}
+
+// ---- Allocation counting ----
+
+static std::atomic<uint64_t> g_allocs{0};
+
+void* operator new(size_t size) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+// Keeps the optimizer from dropping results
+static volatile uint32_t g_sink;
+
+// ---- Harness ----
+
+struct Result {
+    std::string name;
+    double ns_per_op;
+    double allocs_per_op;
+    uint64_t iterations;
+};
+
+struct Options {
+    const char* filter = nullptr;
+    double min_ms = 50.0;
+    int reps = 5;
+    const char* json = nullptr;
+};
+
+using BenchFn = std::function<void(uint64_t iters)>;
+
+static double runOnce(const BenchFn& fn, uint64_t iters) {
+    auto t0 = std::chrono::steady_clock::now();
+    fn(iters);
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(t1 - t0).count();
+}
+
+static void measure(std::vector<Result>& out, const char* name, const Options& opt,
+                    const BenchFn& fn) {
+    if (opt.filter && !strstr(name, opt.filter)) {
+        return;
+    }
+
+    // Grow the batch until one run lasts min_ms; this is also the warm-up
+    uint64_t iters = 1;
+    while (runOnce(fn, iters) < opt.min_ms * 1e6 && iters < (1ULL << 40)) {
+        iters *= 2;
+    }
+
+    std::vector<double> ns(opt.reps);
+    uint64_t allocs_before = g_allocs.load(std::memory_order_relaxed);
+    for (int r = 0; r < opt.reps; r++) {
+        ns[r] = runOnce(fn, iters) / (double)iters;
+    }
+    uint64_t allocs = g_allocs.load(std::memory_order_relaxed) - allocs_before;
+    std::sort(ns.begin(), ns.end());
+
+    Result res;
+    res.name = name;
+    res.ns_per_op = ns[opt.reps / 2];
+    res.allocs_per_op = (double)allocs / ((double)iters * opt.reps);
+    res.iterations = iters;
+    printf("%-28s %12.1f %10.3f %12llu\n", name, res.ns_per_op, res.allocs_per_op,
+           (unsigned long long)iters);
+    fflush(stdout);
+    out.push_back(res);
+}
+
+// ---- Inputs ----
+
+static std::vector<uint8_t> maskedFrame(const char* text) {
+    size_t len = strlen(text);
+    std::vector<uint8_t> frame;
+    frame.push_back(0x81);
+    if (len < 126) {
+        frame.push_back((uint8_t)(0x80 | len));
+    } else {
+        frame.push_back(0x80 | 126);
+        frame.push_back((uint8_t)(len >> 8));
+        frame.push_back((uint8_t)len);
+    }
+    const uint8_t mask[4] = {0x37, 0xFA, 0x21, 0x3D};
+    frame.insert(frame.end(), mask, mask + 4);
+    for (size_t i = 0; i < len; i++) {
+        frame.push_back((uint8_t)text[i] ^ mask[i % 4]);
+    }
+    return frame;
+}
+
+// A table with every channel offset, scaled and limited, so no step is free
+static ServoCalibration::Table calibratedTable() {
+    ServoCalibration::Table t;
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) {
+        t.gain_q12[i] = (i & 1 ? -1 : 1) * (SERVO_CALIB_SCALE_ONE + 37 * i);
+        t.center_us[i] = SERVO_PWM_NEUTRAL_US + 5 * i - 30;
+        t.min_us[i] = 700;
+        t.max_us[i] = 2300;
+    }
+    return t;
+}
+
+// ---- Benchmarks ----
+
+static void benchCrc(std::vector<Result>& out, const Options& opt, const char* name, size_t len) {
+    std::vector<uint8_t> buf(len);
+    for (size_t i = 0; i < len; i++) buf[i] = (uint8_t)(i * 131 + 7);
+    measure(out, name, opt, [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            buf[0] = (uint8_t)i;
+            g_sink = crc16_ccitt_false(buf.data(), buf.size());
+        }
+    });
+}
+
+static void benchPacket(std::vector<Result>& out, const Options& opt, const char* name,
+                        const ServoCalibration::Table& calib) {
+    MotionIntent intent = {};
+    intent.t_ms = 20;
+    intent.flags = FLAG_CLAMP_ENABLE | FLAG_INTERP_Q16;
+    uint16_t servos[SERVO_COUNT_TOTAL];
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) servos[i] = (uint16_t)(1100 + 60 * i);
+    PosePacket31 pkt;
+    measure(out, name, opt, [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            intent.seq = (uint32_t)i;
+            servos[i % SERVO_COUNT_TOTAL] ^= 1;
+            MotionThread::encodePacket(intent, servos, calib, pkt);
+            g_sink = pkt.crc16;
+        }
+    });
+}
+
+static void benchWsFrame(std::vector<Result>& out, const Options& opt, const char* name,
+                         const char* text) {
+    const std::vector<uint8_t> frame = maskedFrame(text);
+    std::vector<uint8_t> rx(frame.size());
+    measure(out, name, opt, [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            // The receive buffer is unmasked in place, so every op starts from the wire bytes
+            memcpy(rx.data(), frame.data(), frame.size());
+            WsFrameHeader hdr = {};
+            if (ws_frame_parse(rx.data(), rx.size(), hdr) && hdr.masked) {
+                ws_unmask(rx.data() + hdr.header_len, hdr.payload_len, rx.data() + hdr.header_len - 4);
+            }
+            g_sink = rx[hdr.header_len];
+        }
+    });
+}
+
+// Tokenize and look up the command name, then read the fields its handler reads
+static void benchCommand(std::vector<Result>& out, const Options& opt, const char* name,
+                         const char* text, const std::function<uint32_t(const JsonTokens&)>& fields) {
+    size_t len = strlen(text);
+    measure(out, name, opt, [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            JsonTokens msg;
+            if (!msg.parse(text, len)) abort();
+            const JsonToken* cmd = msg.find("cmd");
+            g_sink = json_hash(cmd->val, cmd->val_len) + fields(msg);
+        }
+    });
+}
+
+static void benchCommands(std::vector<Result>& out, const Options& opt) {
+    benchCommand(out, opt, "json/status", "{\"cmd\":\"status\"}",
+                 [](const JsonTokens&) { return 0u; });
+    benchCommand(out, opt, "json/servos",
+                 "{\"cmd\":\"servos\",\"us\":[1500,1520,1480,1610,1390,1500,1500,1444,1556,1500,1700,1300,1500]}",
+                 [](const JsonTokens& m) {
+                     uint16_t us[SERVO_COUNT_TOTAL];
+                     return (uint32_t)m.getUintArray("us", us, SERVO_COUNT_TOTAL) + us[0];
+                 });
+    benchCommand(out, opt, "json/move",
+                 "{\"cmd\":\"move\",\"t_ms\":400,\"profile\":\"scurve\",\"us\":[1500,1520,1480,1610,1390,1500,1500,1444,1556,1500,1700,1300,1500]}",
+                 [](const JsonTokens& m) {
+                     uint16_t us[SERVO_COUNT_TOTAL];
+                     char profile[16];
+                     m.getString("profile", profile, sizeof(profile));
+                     return (uint32_t)m.getInt("t_ms", 0) + m.getUintArray("us", us, SERVO_COUNT_TOTAL) +
+                            (uint32_t)profile[0];
+                 });
+    benchCommand(out, opt, "json/walk",
+                 "{\"cmd\":\"walk\",\"gait\":\"tripod\",\"dir\":0.5,\"turn\":-0.25,\"speed\":0.8,\"stride\":40}",
+                 [](const JsonTokens& m) {
+                     char gait[16];
+                     m.getString("gait", gait, sizeof(gait));
+                     float v = m.getFloat("dir", 0) + m.getFloat("turn", 0) +
+                               m.getFloat("speed", 0) + m.getFloat("stride", 0);
+                     return (uint32_t)v + (uint32_t)gait[0];
+                 });
+    benchCommand(out, opt, "json/look", "{\"cmd\":\"look\",\"x\":0.35,\"y\":-0.6}",
+                 [](const JsonTokens& m) {
+                     return (uint32_t)(m.getFloat("x", 0) * 100 + m.getFloat("y", 0) * 100);
+                 });
+}
+
+// Format a reply into the arena and frame it, as the daemon does before sendmsg()
+static void benchReplies(std::vector<Result>& out, const Options& opt) {
+    static ReplyArena arena;
+    const uint16_t servos[SERVO_COUNT_TOTAL] = {1500, 1520, 1480, 1610, 1390, 1500, 1500,
+                                                1444, 1556, 1500, 1700, 1300, 1500};
+    measure(out, "reply/get_servos", opt, [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            JsonWriter w(arena);
+            w.beginObject().beginArray("servos");
+            for (int ch = 0; ch < SERVO_COUNT_TOTAL; ch++) {
+                w.value(servos[ch]);
+            }
+            w.endArray().endObject();
+            size_t len;
+            g_sink = w.frame(len)[len - 1];
+            arena.reset();
+        }
+    });
+    measure(out, "reply/scan_data_180", opt, [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            JsonWriter w(arena);
+            w.beginObject().beginArray("scan_data");
+            for (int a = 0; a <= 180; a++) {
+                w.beginObject().field("a", a).field("d", 300 + a * 7).endObject();
+            }
+            w.endArray().endObject();
+            size_t len;
+            g_sink = w.frame(len)[len - 1];
+            arena.reset();
+        }
+    });
+}
+
+static void benchInterpolator(std::vector<Result>& out, const Options& opt) {
+    uint16_t a[SERVO_COUNT_TOTAL], b[SERVO_COUNT_TOTAL], output[SERVO_COUNT_TOTAL];
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) {
+        a[i] = (uint16_t)(1000 + 20 * i);
+        b[i] = (uint16_t)(2000 - 30 * i);
+    }
+    interpolator_set_substeps(4);
+    measure(out, "interp/tick", opt, [&](uint64_t n) {
+        interpolator_reset(a);
+        bool forward = true;
+        for (uint64_t i = 0; i < n; i++) {
+            if (interpolator_is_idle()) {
+                interpolator_start(forward ? a : b, forward ? b : a, 1000, INTERP_MODE_Q16);
+                forward = !forward;
+            }
+            interpolator_tick(output);
+            g_sink = output[0];
+        }
+    });
+}
+
+static void benchEyes(std::vector<Result>& out, const Options& opt) {
+    // No panel: render() draws and expands, and the pixels are dropped
+    static NullSink sink;
+    static DualEyeDisplay display(sink);
+    static EyeRenderer renderer(display);
+
+    measure(out, "eye/render_look", opt, [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            float t = (float)(i % 64) / 64.0f;
+            renderer.setEyePosition(std::sin(6.2832f * t), std::cos(6.2832f * t));
+            renderer.render();
+        }
+    });
+    measure(out, "eye/render_blink", opt, [&](uint64_t n) {
+        renderer.setEyePosition(0.0f, 0.0f);
+        for (uint64_t i = 0; i < n; i++) {
+            float amount = (float)(i % 16) / 15.0f;
+            renderer.setBlink(DualEyeDisplay::Eye::LEFT, amount);
+            renderer.setBlink(DualEyeDisplay::Eye::RIGHT, amount);
+            renderer.render();
+        }
+    });
+
+    std::vector<uint16_t> src(DualEyeDisplay::PIXELS), dst(DualEyeDisplay::PIXELS);
+    for (size_t i = 0; i < src.size(); i++) src[i] = (uint16_t)(i * 2654435761u);
+    measure(out, "rgb565/byteswap_frame", opt, [&](uint64_t n) {
+        const Rgb565Kernels& k = rgb565Kernels();
+        for (uint64_t i = 0; i < n; i++) {
+            k.byteSwap(dst.data(), src.data(), dst.size());
+            g_sink = dst[i % dst.size()];
+        }
+    });
+
+    std::vector<uint8_t> indices(DualEyeDisplay::PIXELS);
+    uint16_t palette[DualEyeDisplay::PALETTE_SIZE];
+    for (size_t i = 0; i < indices.size(); i++) indices[i] = (uint8_t)((i * 2654435761u) >> 24);
+    for (int i = 0; i < DualEyeDisplay::PALETTE_SIZE; i++) palette[i] = (uint16_t)(i * 0x0101);
+    measure(out, "rgb565/expand_frame", opt, [&](uint64_t n) {
+        const Rgb565Kernels& k = rgb565Kernels();
+        for (uint64_t i = 0; i < n; i++) {
+            k.expand(dst.data(), indices.data(), palette, dst.size());
+            g_sink = dst[i % dst.size()];
+        }
+    });
+}
+
+// ---- Main ----
+
+static bool writeJson(const char* path, const std::vector<Result>& results, const Options& opt) {
+    FILE* f = fopen(path, "w");
+    if (!f) return false;
+    fprintf(f, "{\n  \"format\": 1,\n  \"min_ms\": %.0f,\n  \"reps\": %d,\n", opt.min_ms, opt.reps);
+    fprintf(f, "  \"compiler\": \"%s\",\n  \"pixel_kernels\": \"%s\",\n  \"results\": [\n",
+            __VERSION__, rgb565Kernels().name);
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        fprintf(f, "    {\"name\": \"%s\", \"ns_per_op\": %.2f, \"allocs_per_op\": %.4f, \"iterations\": %llu}%s\n",
+                r.name.c_str(), r.ns_per_op, r.allocs_per_op, (unsigned long long)r.iterations,
+                i + 1 < results.size() ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+    return fclose(f) == 0;
+}
+
+int main(int argc, char* argv[]) {
+    Options opt;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--filter") && i + 1 < argc) {
+            opt.filter = argv[++i];
+        } else if (!strcmp(argv[i], "--min-ms") && i + 1 < argc) {
+            opt.min_ms = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--reps") && i + 1 < argc) {
+            opt.reps = std::max(1, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--json") && i + 1 < argc) {
+            opt.json = argv[++i];
+        } else {
+            printf("Usage: %s [--filter SUBSTR] [--min-ms 50] [--reps 5] [--json PATH]\n", argv[0]);
+            return !strcmp(argv[i], "-h") || !strcmp(argv[i], "--help") ? 0 : 1;
+        }
+    }
+
+    printf("%-28s %12s %10s %12s\n", "benchmark", "ns/op", "allocs/op", "iterations");
+
+    std::vector<Result> all;
+    benchCrc(all, opt, "crc16/packet_40B", sizeof(PosePacket31) - 2);
+    benchCrc(all, opt, "crc16/1KiB", 1024);
+    benchPacket(all, opt, "packet/encode_identity", ServoCalibration::Table());
+    benchPacket(all, opt, "packet/encode_calibrated", calibratedTable());
+    benchWsFrame(all, opt, "ws/frame_status", "{\"cmd\":\"status\"}");
+    benchWsFrame(all, opt, "ws/frame_servos",
+                 "{\"cmd\":\"servos\",\"us\":[1500,1520,1480,1610,1390,1500,1500,1444,1556,1500,1700,1300,1500]}");
+    std::string big = "{\"cmd\":\"noop\",\"pad\":\"" + std::string(1000, 'x') + "\"}";
+    benchWsFrame(all, opt, "ws/frame_1KiB", big.c_str());
+    benchCommands(all, opt);
+    benchReplies(all, opt);
+    benchInterpolator(all, opt);
+    benchEyes(all, opt);
+
+    if (opt.json) {
+        if (!writeJson(opt.json, all, opt)) {
+            fprintf(stderr, "Cannot write %s\n", opt.json);
+            return 1;
+        }
+        printf("Baseline written to %s\n", opt.json);
+    }
+    return 0;
+}
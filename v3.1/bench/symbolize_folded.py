@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+"""
+Name the "module+0xoffset" frames of a folded profile (profile command).
+
+A release daemon is stripped, so the profiler can only name frames in
+shared libraries. Given the unstripped build of the same binary, this
+resolves the rest with addr2line and writes folded stacks ready for
+flamegraph.pl.
+
+Usage: symbolize_folded.py PROFILE.folded --binary build/brain_daemon.debug
+           [--addr2line riscv64-unknown-linux-musl-addr2line] [-o OUT]
+"""
+
+import argparse
+import os
+import re
+import struct
+import subprocess
+import sys
+
+FRAME = re.compile(r"^(?P<module>[^;+]+)\+0x(?P<offset>[0-9a-f]+)$")
+PT_LOAD = 1
+
+
+def load_base(path):
+    """Link-time address the module's offsets count from: its lowest PT_LOAD page."""
+    with open(path, "rb") as f:
+        ident = f.read(16)
+        if ident[:4] != b"\x7fELF":
+            raise SystemExit(f"{path}: not an ELF file")
+        is64 = ident[4] == 2
+        order = "<" if ident[5] == 1 else ">"
+        if is64:
+            f.seek(0x20)
+            (phoff,) = struct.unpack(order + "Q", f.read(8))
+            f.seek(0x36)
+        else:
+            f.seek(0x1C)
+            (phoff,) = struct.unpack(order + "I", f.read(4))
+            f.seek(0x2A)
+        phentsize, phnum = struct.unpack(order + "HH", f.read(4))
+
+        lowest = None
+        for i in range(phnum):
+            f.seek(phoff + i * phentsize)
+            if is64:
+                p_type, _, _, p_vaddr = struct.unpack(order + "IIQQ", f.read(24))
+            else:
+                p_type, _, p_vaddr = struct.unpack(order + "III", f.read(12))
+            if p_type == PT_LOAD and (lowest is None or p_vaddr < lowest):
+                lowest = p_vaddr
+    return (lowest or 0) & ~0xFFF
+
+
+def resolve(addr2line, binary, addresses):
+    query = "".join(f"{a:#x}\n" for a in addresses)
+    out = subprocess.run([addr2line, "-f", "-C", "-e", binary], input=query,
+                         capture_output=True, text=True, check=True).stdout.splitlines()
+    # Two lines per address: function, then file:line
+    return {a: out[2 * i] for i, a in enumerate(addresses) if out[2 * i] != "??"}
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Symbolize a folded profile")
+    parser.add_argument("profile")
+    parser.add_argument("--binary", required=True, help="unstripped build of the profiled binary")
+    parser.add_argument("--addr2line", default="addr2line", help="addr2line for the target")
+    parser.add_argument("-o", "--output", help="output file (default: stdout)")
+    args = parser.parse_args()
+
+    module = os.path.basename(args.binary)
+    # The unstripped copy may carry a suffix the installed one does not
+    stem = module.split(".")[0]
+    base = load_base(args.binary)
+
+    with open(args.profile) as f:
+        lines = [line.rstrip("\n") for line in f if line.strip()]
+
+    offsets = set()
+    for line in lines:
+        stack, _, _ = line.rpartition(" ")
+        for frame in stack.split(";"):
+            m = FRAME.match(frame)
+            if m and m.group("module") in (module, stem):
+                offsets.add(int(m.group("offset"), 16))
+    names = resolve(args.addr2line, args.binary, sorted(base + o for o in offsets)) if offsets else {}
+
+    def name(frame):
+        m = FRAME.match(frame)
+        if not m or m.group("module") not in (module, stem):
+            return frame
+        return names.get(base + int(m.group("offset"), 16), frame)
+
+    # Offsets inside one function fold into one stack
+    folded = {}
+    for line in lines:
+        stack, _, count = line.rpartition(" ")
+        stack = ";".join(name(fr) for fr in stack.split(";"))
+        folded[stack] = folded.get(stack, 0) + int(count)
+
+    out = open(args.output, "w") if args.output else sys.stdout
+    for stack in sorted(folded):
+        out.write(f"{stack} {folded[stack]}\n")
+    if out is not sys.stdout:
+        out.close()
+    print(f"{len(names)}/{len(offsets)} addresses resolved", file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
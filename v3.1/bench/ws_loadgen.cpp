@@ -0,0 +1,618 @@
+/**
+ * Spider Robot v3.1 - WebSocket load generator and soak harness
+ *
+ * Opens up to MAX_CLIENTS connections to brain_daemon (or brain_sim) and
+ * drives a weighted mix of move, servos, status and eye commands at a
+ * fixed rate per connection, for as long as a soak needs.
+ *
+ * Replies are broadcast to every client, so they cannot be matched to a
+ * request. Each command is therefore followed by a ping carrying its id:
+ * the daemon handles a connection's frames in order and answers the ping
+ * on that connection only, after the command's own reply, so the pong
+ * marks the end of the round trip. Error replies are counted on one
+ * connection, which sees each broadcast exactly once.
+ *
+ * Every --report seconds a line with the interval's rate and latency
+ * percentiles per command is printed (and appended to --json as one JSON
+ * object per line, plus the full histograms at the end).
+ *
+ * With --metrics each report also scrapes the daemon's /metrics for
+ * spider_heap_allocs_total and prints the interval's heap allocations
+ * per command, less what the scrapes themselves cost the daemon
+ * (measured by two back-to-back scrapes at the start). Steady-state
+ * command handling should show 0.
+ *
+ * Usage: ws_loadgen [--host H] [--port 9000] [--clients 4] [--rate 50]
+ *                   [--mix move=1,servos=4,status=1,eye=1] [--duration 60]
+ *                   [--report 10] [--json PATH] [--metrics]
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "latency_histogram.h"
+#include "ws_frame.h"
+
+extern "C" {
+#include "limits.h"
+#include "timebase.h"
+}
+
+#define LOADGEN_MAX_CLIENTS     8           // MAX_CLIENTS in brain_linux/src/main.cpp
+#define LOADGEN_TX_LIMIT        (64 * 1024) // Unsent bytes before a connection counts as stalled
+#define LOADGEN_RECONNECT_US    1000000ULL
+
+enum MsgType { MSG_MOVE, MSG_SERVOS, MSG_STATUS, MSG_EYE, MSG_TYPE_COUNT };
+static const char* const s_type_names[MSG_TYPE_COUNT] = {"move", "servos", "status", "eye"};
+
+struct Options {
+    const char* host = "127.0.0.1";
+    int port = 9000;
+    int clients = 4;
+    double rate = 50.0;                 // Commands per second per connection
+    int weights[MSG_TYPE_COUNT] = {1, 4, 1, 1};
+    double duration_s = 60.0;           // 0 = until SIGINT
+    double report_s = 10.0;
+    const char* json = nullptr;
+    bool metrics = false;               // Report daemon heap allocations per command
+};
+
+struct Pending {
+    uint32_t id;
+    uint8_t type;
+    uint64_t sent_us;
+};
+
+struct Conn {
+    int fd = -1;
+    std::vector<uint8_t> rx;
+    std::string tx;
+    std::deque<Pending> pending;
+    uint64_t next_send_us = 0;
+    uint64_t retry_us = 0;
+    uint32_t next_id = 1;
+    uint32_t seed = 1;
+};
+
+struct Stats {
+    LatencyHistogram rtt[MSG_TYPE_COUNT];
+    uint64_t sent[MSG_TYPE_COUNT] = {};
+    uint64_t stalled = 0;               // Send slots skipped because the daemon was not reading
+    uint64_t lost = 0;                  // Commands whose pong never came (connection dropped)
+    uint64_t connects = 0;
+    uint64_t disconnects = 0;
+    std::map<std::string, uint64_t> errors;
+};
+
+static volatile sig_atomic_t g_stop = 0;
+
+static void on_signal(int) { g_stop = 1; }
+
+static uint32_t next_rand(uint32_t& s) {
+    s ^= s << 13;
+    s ^= s >> 17;
+    s ^= s << 5;
+    return s;
+}
+
+// ---- Connection ----
+
+static int connect_ws(const Options& opt, std::vector<uint8_t>& leftover) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)opt.port);
+    if (inet_pton(AF_INET, opt.host, &addr.sin_addr) != 1 ||
+        connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    // The key only has to be well-formed; the accept value is not checked
+    const char* req =
+        "GET / HTTP/1.1\r\n"
+        "Upgrade: websocket\r\n"
+        "Connection: Upgrade\r\n"
+        "Sec-WebSocket-Key: c3BpZGVyLWxvYWRnZW4tMDE=\r\n"
+        "Sec-WebSocket-Version: 13\r\n"
+        "\r\n";
+    if (send(fd, req, strlen(req), MSG_NOSIGNAL) != (ssize_t)strlen(req)) {
+        close(fd);
+        return -1;
+    }
+
+    timeval tv = {2, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    std::string resp;
+    char buf[1024];
+    size_t end;
+    while ((end = resp.find("\r\n\r\n")) == std::string::npos) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0) {
+            close(fd);
+            return -1;
+        }
+        resp.append(buf, (size_t)n);
+    }
+    if (resp.compare(0, 12, "HTTP/1.1 101") != 0) {
+        close(fd);
+        return -1;
+    }
+    leftover.assign(resp.begin() + end + 4, resp.end());
+    tv = {0, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return fd;
+}
+
+static void append_frame(std::string& tx, uint8_t opcode, const void* data, size_t len, uint32_t& seed) {
+    tx.push_back((char)(0x80 | opcode));
+    if (len < 126) {
+        tx.push_back((char)(0x80 | len));
+    } else {
+        tx.push_back((char)(0x80 | 126));
+        tx.push_back((char)(len >> 8));
+        tx.push_back((char)len);
+    }
+    uint32_t m = next_rand(seed);
+    uint8_t mask[4];
+    memcpy(mask, &m, 4);
+    tx.append((const char*)mask, 4);
+    const uint8_t* p = (const uint8_t*)data;
+    for (size_t i = 0; i < len; i++) {
+        tx.push_back((char)(p[i] ^ mask[i % 4]));
+    }
+}
+
+static void drop_conn(Conn& c, Stats& st, uint64_t now) {
+    if (c.fd >= 0) {
+        close(c.fd);
+        c.fd = -1;
+        st.disconnects++;
+    }
+    st.lost += c.pending.size();
+    c.pending.clear();
+    c.tx.clear();
+    c.rx.clear();
+    c.retry_us = now + LOADGEN_RECONNECT_US;
+}
+
+// Daemon's spider_heap_allocs_total, from a plain HTTP GET /metrics
+static bool scrape_allocs(const Options& opt, uint64_t& out) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return false;
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)opt.port);
+    timeval tv = {2, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    const char* req = "GET /metrics HTTP/1.1\r\nHost: spider\r\n\r\n";
+    if (inet_pton(AF_INET, opt.host, &addr.sin_addr) != 1 ||
+        connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0 ||
+        send(fd, req, strlen(req), MSG_NOSIGNAL) != (ssize_t)strlen(req)) {
+        close(fd);
+        return false;
+    }
+    // The daemon closes the connection once the reply is out
+    std::string resp;
+    char buf[4096];
+    ssize_t n;
+    while ((n = recv(fd, buf, sizeof(buf), 0)) > 0) {
+        resp.append(buf, (size_t)n);
+    }
+    close(fd);
+    size_t at = resp.find("\nspider_heap_allocs_total ");
+    if (at == std::string::npos) return false;
+    out = strtoull(resp.c_str() + at + 26, nullptr, 10);
+    return true;
+}
+
+// ---- Traffic ----
+
+static MsgType pick_type(const Options& opt, uint32_t& seed) {
+    int total = 0;
+    for (int w : opt.weights) total += w;
+    int r = (int)(next_rand(seed) % (uint32_t)total);
+    for (int t = 0; t < MSG_TYPE_COUNT; t++) {
+        if (r < opt.weights[t]) return (MsgType)t;
+        r -= opt.weights[t];
+    }
+    return MSG_STATUS;
+}
+
+static int format_command(MsgType type, uint32_t id, char* out, size_t size) {
+    // Slow sweeps, so consecutive poses differ on every channel
+    double phase = id * 0.05;
+    int n = 0;
+    switch (type) {
+    case MSG_MOVE:
+    case MSG_SERVOS:
+        n = snprintf(out, size, type == MSG_MOVE
+                         ? "{\"cmd\":\"move\",\"t_ms\":200,\"profile\":\"trapezoid\",\"us\":["
+                         : "{\"cmd\":\"servos\",\"us\":[");
+        for (int ch = 0; ch < SERVO_COUNT_TOTAL; ch++) {
+            n += snprintf(out + n, size - n, ch ? ",%d" : "%d",
+                          (int)(SERVO_PWM_NEUTRAL_US + 300 * sin(phase + ch)));
+        }
+        n += snprintf(out + n, size - n, "]}");
+        break;
+    case MSG_STATUS:
+        n = snprintf(out, size, "{\"cmd\":\"status\"}");
+        break;
+    case MSG_EYE:
+        if (id % 8 == 0) {
+            n = snprintf(out, size, "{\"type\":\"blink\"}");
+        } else {
+            n = snprintf(out, size, "{\"type\":\"look\",\"x\":%.2f,\"y\":%.2f}", sin(phase), cos(phase));
+        }
+        break;
+    default:
+        break;
+    }
+    return n;
+}
+
+static void send_command(const Options& opt, Conn& c, Stats& st, uint64_t now) {
+    if (c.tx.size() > LOADGEN_TX_LIMIT) {
+        st.stalled++;
+        return;
+    }
+    MsgType type = pick_type(opt, c.seed);
+    uint32_t id = c.next_id++;
+    char text[256];
+    int len = format_command(type, id, text, sizeof(text));
+    append_frame(c.tx, 0x01, text, (size_t)len, c.seed);
+    append_frame(c.tx, 0x09, &id, sizeof(id), c.seed);
+    c.pending.push_back({id, (uint8_t)type, now});
+    st.sent[type]++;
+}
+
+static bool flush_tx(Conn& c) {
+    while (!c.tx.empty()) {
+        ssize_t n = send(c.fd, c.tx.data(), c.tx.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        c.tx.erase(0, (size_t)n);
+    }
+    return true;
+}
+
+static void count_error(Stats& st, const char* text, size_t len) {
+    std::string s(text, len);
+    size_t at = s.find("\"error\":\"");
+    if (at == std::string::npos) return;
+    at += 9;
+    size_t end = s.find('"', at);
+    st.errors[s.substr(at, end == std::string::npos ? std::string::npos : end - at)]++;
+}
+
+// Returns false when the connection has to be dropped
+static bool handle_rx(Conn& c, bool observer, Stats& st, uint64_t now) {
+    size_t off = 0;
+    WsFrameHeader hdr;
+    while (ws_frame_parse(c.rx.data() + off, c.rx.size() - off, hdr)) {
+        const uint8_t* payload = c.rx.data() + off + hdr.header_len;
+        if (hdr.opcode == 0x0A && hdr.payload_len == sizeof(uint32_t)) {
+            uint32_t id;
+            memcpy(&id, payload, sizeof(id));
+            while (!c.pending.empty() && c.pending.front().id != id) {
+                c.pending.pop_front();
+                st.lost++;
+            }
+            if (!c.pending.empty()) {
+                const Pending& p = c.pending.front();
+                st.rtt[p.type].record(now - p.sent_us);
+                c.pending.pop_front();
+            }
+        } else if (hdr.opcode == 0x01 && observer) {
+            count_error(st, (const char*)payload, (size_t)hdr.payload_len);
+        } else if (hdr.opcode == 0x08) {
+            return false;
+        }
+        off += hdr.header_len + (size_t)hdr.payload_len;
+    }
+    c.rx.erase(c.rx.begin(), c.rx.begin() + off);
+    return true;
+}
+
+// ---- Reporting ----
+
+struct Interval {
+    LatencyHistogram::Snapshot rtt[MSG_TYPE_COUNT];
+    uint64_t sent[MSG_TYPE_COUNT] = {};
+    uint64_t errors = 0;
+};
+
+static uint64_t total_errors(const Stats& st) {
+    uint64_t n = 0;
+    for (const auto& e : st.errors) n += e.second;
+    return n;
+}
+
+// allocs < 0: not measured
+static void report(const Options& opt, FILE* json, const Stats& st, Interval& last,
+                   double elapsed_s, double interval_s, int connected, int64_t allocs) {
+    Interval now;
+    uint64_t sent = 0;
+    for (int t = 0; t < MSG_TYPE_COUNT; t++) {
+        st.rtt[t].snapshot(now.rtt[t]);
+        now.sent[t] = st.sent[t];
+        sent += st.sent[t] - last.sent[t];
+    }
+    now.errors = total_errors(st);
+
+    printf("[%7.0fs] conns=%d sent=%.0f/s errors=%llu stalled=%llu lost=%llu |",
+           elapsed_s, connected, sent / interval_s,
+           (unsigned long long)(now.errors - last.errors),
+           (unsigned long long)st.stalled, (unsigned long long)st.lost);
+    if (json) {
+        fprintf(json, "{\"t_s\":%.1f,\"conns\":%d,\"rate\":%.1f,\"errors\":%llu,\"stalled\":%llu,\"lost\":%llu",
+                elapsed_s, connected, sent / interval_s, (unsigned long long)(now.errors - last.errors),
+                (unsigned long long)st.stalled, (unsigned long long)st.lost);
+    }
+    if (allocs >= 0) {
+        double per_cmd = sent ? (double)allocs / (double)sent : 0.0;
+        printf(" allocs/cmd=%.3f |", per_cmd);
+        if (json) fprintf(json, ",\"allocs_per_cmd\":%.4f", per_cmd);
+    }
+    for (int t = 0; t < MSG_TYPE_COUNT; t++) {
+        if (opt.weights[t] == 0) continue;
+        LatencyHistogram::Snapshot d = now.rtt[t].since(last.rtt[t]);
+        printf(" %s p50=%u p99=%u p999=%u max=%u", s_type_names[t],
+               d.percentile(0.5), d.percentile(0.99), d.percentile(0.999), d.max_us);
+        if (json) {
+            fprintf(json, ",\"%s\":{\"n\":%llu,\"p50\":%u,\"p90\":%u,\"p99\":%u,\"p999\":%u,\"max\":%u}",
+                    s_type_names[t], (unsigned long long)d.count, d.percentile(0.5),
+                    d.percentile(0.9), d.percentile(0.99), d.percentile(0.999), d.max_us);
+        }
+    }
+    printf(" us\n");
+    fflush(stdout);
+    if (json) {
+        fprintf(json, "}\n");
+        fflush(json);
+    }
+    last = now;
+}
+
+static void final_report(const Options& opt, FILE* json, const Stats& st, double elapsed_s) {
+    printf("\n=== %.0f s, %llu connects, %llu disconnects ===\n", elapsed_s,
+           (unsigned long long)st.connects, (unsigned long long)st.disconnects);
+    printf("%-8s %10s %8s %8s %8s %8s %8s %8s\n", "command", "sent", "mean", "p50", "p99", "p99.9", "p99.99", "max");
+    if (json) fprintf(json, "{\"final\":true,\"t_s\":%.1f,\"histograms\":{", elapsed_s);
+    bool first = true;
+    for (int t = 0; t < MSG_TYPE_COUNT; t++) {
+        if (opt.weights[t] == 0) continue;
+        LatencyHistogram::Snapshot s;
+        st.rtt[t].snapshot(s);
+        printf("%-8s %10llu %8llu %8u %8u %8u %8u %8u\n", s_type_names[t],
+               (unsigned long long)st.sent[t], (unsigned long long)(s.count ? s.sum_us / s.count : 0),
+               s.percentile(0.5), s.percentile(0.99), s.percentile(0.999), s.percentile(0.9999), s.max_us);
+        if (json) {
+            // Non-empty buckets as [low_us, count], so soak runs can be merged offline
+            fprintf(json, "%s\"%s\":{\"sent\":%llu,\"n\":%llu,\"max\":%u,\"buckets\":[", first ? "" : ",",
+                    s_type_names[t], (unsigned long long)st.sent[t], (unsigned long long)s.count, s.max_us);
+            bool fb = true;
+            for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+                if (s.counts[i] == 0) continue;
+                fprintf(json, "%s[%u,%u]", fb ? "" : ",", LatencyHistogram::bucketLow(i), s.counts[i]);
+                fb = false;
+            }
+            fprintf(json, "]}");
+            first = false;
+        }
+    }
+    printf("Latency in us. stalled=%llu lost=%llu\n", (unsigned long long)st.stalled,
+           (unsigned long long)st.lost);
+    if (json) fprintf(json, "},\"errors\":{");
+    first = true;
+    for (const auto& e : st.errors) {
+        printf("  error %-28s %llu\n", e.first.c_str(), (unsigned long long)e.second);
+        if (json) fprintf(json, "%s\"%s\":%llu", first ? "" : ",", e.first.c_str(), (unsigned long long)e.second);
+        first = false;
+    }
+    if (json) fprintf(json, "}}\n");
+}
+
+// ---- Main ----
+
+static bool parse_mix(const char* arg, int* weights) {
+    for (int t = 0; t < MSG_TYPE_COUNT; t++) weights[t] = 0;
+    std::string s(arg);
+    size_t pos = 0;
+    while (pos < s.size()) {
+        size_t comma = s.find(',', pos);
+        std::string item = s.substr(pos, comma == std::string::npos ? std::string::npos : comma - pos);
+        size_t eq = item.find('=');
+        int t = 0;
+        while (t < MSG_TYPE_COUNT && item.compare(0, eq, s_type_names[t]) != 0) t++;
+        if (eq == std::string::npos || t == MSG_TYPE_COUNT) return false;
+        weights[t] = atoi(item.c_str() + eq + 1);
+        if (weights[t] < 0) return false;
+        if (comma == std::string::npos) break;
+        pos = comma + 1;
+    }
+    int total = 0;
+    for (int t = 0; t < MSG_TYPE_COUNT; t++) total += weights[t];
+    return total > 0;
+}
+
+static void usage(const char* prog) {
+    printf("Usage: %s [options]\n"
+           "  --host HOST       Daemon address (default 127.0.0.1)\n"
+           "  --port PORT       WebSocket port (default 9000)\n"
+           "  --clients N       Connections, 1-%d (default 4)\n"
+           "  --rate R          Commands/s per connection (default 50)\n"
+           "  --mix SPEC        Weights, e.g. move=1,servos=4,status=1,eye=1\n"
+           "  --duration S      Seconds to run, 0 = until Ctrl-C (default 60)\n"
+           "  --report S        Seconds between reports (default 10)\n"
+           "  --json PATH       Append reports as JSON lines\n"
+           "  --metrics         Report daemon heap allocations per command\n",
+           prog, LOADGEN_MAX_CLIENTS);
+}
+
+int main(int argc, char* argv[]) {
+    Options opt;
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i];
+        const char* v = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        if (!strcmp(a, "--host") && v) { opt.host = v; i++; }
+        else if (!strcmp(a, "--port") && v) { opt.port = atoi(v); i++; }
+        else if (!strcmp(a, "--clients") && v) { opt.clients = atoi(v); i++; }
+        else if (!strcmp(a, "--rate") && v) { opt.rate = atof(v); i++; }
+        else if (!strcmp(a, "--mix") && v) {
+            if (!parse_mix(v, opt.weights)) {
+                fprintf(stderr, "Bad --mix '%s'\n", v);
+                return 1;
+            }
+            i++;
+        }
+        else if (!strcmp(a, "--duration") && v) { opt.duration_s = atof(v); i++; }
+        else if (!strcmp(a, "--report") && v) { opt.report_s = atof(v); i++; }
+        else if (!strcmp(a, "--json") && v) { opt.json = v; i++; }
+        else if (!strcmp(a, "--metrics")) { opt.metrics = true; }
+        else {
+            usage(argv[0]);
+            return !strcmp(a, "-h") || !strcmp(a, "--help") ? 0 : 1;
+        }
+    }
+    if (opt.clients < 1 || opt.clients > LOADGEN_MAX_CLIENTS || opt.rate <= 0 || opt.report_s <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    FILE* json = nullptr;
+    if (opt.json && !(json = fopen(opt.json, "a"))) {
+        fprintf(stderr, "Cannot open %s: %s\n", opt.json, strerror(errno));
+        return 1;
+    }
+
+    std::signal(SIGINT, on_signal);
+    std::signal(SIGTERM, on_signal);
+
+    uint64_t allocs_last = 0;
+    int64_t scrape_cost = 0;
+    if (opt.metrics) {
+        uint64_t first;
+        if (!scrape_allocs(opt, first) || !scrape_allocs(opt, allocs_last)) {
+            fprintf(stderr, "No spider_heap_allocs_total at %s:%d/metrics\n", opt.host, opt.port);
+            return 1;
+        }
+        scrape_cost = (int64_t)(allocs_last - first);
+    }
+
+    Stats st;
+    std::vector<Conn> conns(opt.clients);
+    const uint64_t period_us = (uint64_t)(1e6 / opt.rate);
+    const uint64_t start = timebase_micros();
+    for (int i = 0; i < opt.clients; i++) {
+        conns[i].seed = 0x9E3779B9u * (uint32_t)(i + 1);
+        // Spread the connections' send slots over one period
+        conns[i].next_send_us = start + period_us * i / opt.clients;
+    }
+
+    Interval last;
+    uint64_t next_report = start + (uint64_t)(opt.report_s * 1e6);
+    uint64_t last_report = start;
+    const uint64_t end = opt.duration_s > 0 ? start + (uint64_t)(opt.duration_s * 1e6) : UINT64_MAX;
+    std::vector<pollfd> pfds(opt.clients);
+    uint8_t buf[16384];
+
+    while (!g_stop) {
+        uint64_t now = timebase_micros();
+        if (now >= end) break;
+
+        int connected = 0;
+        uint64_t wake = std::min(next_report, end);
+        for (int i = 0; i < opt.clients; i++) {
+            Conn& c = conns[i];
+            if (c.fd < 0 && now >= c.retry_us) {
+                c.fd = connect_ws(opt, c.rx);
+                if (c.fd < 0) {
+                    c.retry_us = now + LOADGEN_RECONNECT_US;
+                } else {
+                    st.connects++;
+                    c.next_send_us = std::max(c.next_send_us, now);
+                }
+                now = timebase_micros();
+            }
+            if (c.fd < 0) {
+                wake = std::min(wake, c.retry_us);
+                pfds[i] = {-1, 0, 0};
+                continue;
+            }
+            connected++;
+
+            // Catch up at most one slot, so a stall does not turn into a burst
+            if (now >= c.next_send_us) {
+                send_command(opt, c, st, now);
+                c.next_send_us += period_us;
+                if (c.next_send_us < now) c.next_send_us = now + period_us;
+            }
+            if (!flush_tx(c)) {
+                drop_conn(c, st, now);
+                pfds[i] = {-1, 0, 0};
+                continue;
+            }
+            wake = std::min(wake, c.next_send_us);
+            pfds[i] = {c.fd, (short)(POLLIN | (c.tx.empty() ? 0 : POLLOUT)), 0};
+        }
+
+        int timeout_ms = wake > now ? (int)((wake - now + 999) / 1000) : 0;
+        if (poll(pfds.data(), pfds.size(), timeout_ms) < 0 && errno != EINTR) {
+            perror("poll");
+            break;
+        }
+
+        now = timebase_micros();
+        for (int i = 0; i < opt.clients; i++) {
+            Conn& c = conns[i];
+            if (c.fd < 0 || !(pfds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            ssize_t n = recv(c.fd, buf, sizeof(buf), MSG_DONTWAIT);
+            if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+                drop_conn(c, st, now);
+                continue;
+            }
+            if (n > 0) {
+                c.rx.insert(c.rx.end(), buf, buf + n);
+                if (!handle_rx(c, i == 0, st, now)) drop_conn(c, st, now);
+            }
+        }
+
+        if (now >= next_report) {
+            int64_t allocs = -1;
+            uint64_t count;
+            if (opt.metrics && scrape_allocs(opt, count)) {
+                allocs = std::max<int64_t>(0, (int64_t)(count - allocs_last) - scrape_cost);
+                allocs_last = count;
+            }
+            report(opt, json, st, last, (now - start) / 1e6, (now - last_report) / 1e6, connected, allocs);
+            last_report = now;
+            next_report += (uint64_t)(opt.report_s * 1e6);
+        }
+    }
+
+    final_report(opt, json, st, (timebase_micros() - start) / 1e6);
+    for (Conn& c : conns) {
+        if (c.fd >= 0) close(c.fd);
+    }
+    if (json) fclose(json);
+    return 0;
+}
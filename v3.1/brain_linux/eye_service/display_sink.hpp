@@ -0,0 +1,95 @@
+#ifndef DISPLAY_SINK_HPP
+#define DISPLAY_SINK_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * DisplaySink - Where DualEyeDisplay sends its pixels
+ *
+ * One window write is begin(), then the pixels, expanded chunk by chunk
+ * straight into the sink's own memory (stage() hands out room, commit()
+ * takes what was filled in), then end(). Pixels are panel-order RGB565,
+ * row by row within the window. frameDone() follows the last window of
+ * each presented frame.
+ *
+ * Calls come from one thread at a time: the display's transfer thread
+ * while it runs, the caller otherwise.
+ *
+ * Sinks: GC9D01DualEyeSpi (the panels), NullSink (below) and FileSink
+ * (frame dumps).
+ */
+class DisplaySink {
+public:
+    // Eye sets a window goes to
+    static constexpr unsigned EYE_MASK_LEFT = 1;
+    static constexpr unsigned EYE_MASK_RIGHT = 2;
+    static constexpr unsigned EYE_MASK_BOTH = EYE_MASK_LEFT | EYE_MASK_RIGHT;
+
+    virtual ~DisplaySink() = default;
+
+    virtual const char *name() const = 0;
+
+    /**
+     * Bring the panels up (may block). Called before the first frame;
+     * returns at once when they are up already.
+     */
+    virtual void powerUp() {}
+
+    /**
+     * True until powerUp() has finished.
+     */
+    virtual bool poweringUp() const { return false; }
+
+    /**
+     * Transfer clock in Hz, 0 when there is no wire.
+     */
+    virtual uint32_t clockHz() const { return 0; }
+
+    /**
+     * Start a window write to the eyes in the mask. The window is already
+     * clipped to the panel. False if nothing can be sent; the display then
+     * skips the pixels.
+     */
+    virtual bool begin(unsigned eyes, int x, int y, int w, int h) = 0;
+
+    /**
+     * Room for the next pixels: sets n to how many of want fit (at least
+     * one) and returns where they go.
+     */
+    virtual uint16_t *stage(size_t want, size_t &n) = 0;
+
+    /**
+     * The n pixels last staged are filled in.
+     */
+    virtual void commit(size_t n) = 0;
+
+    /**
+     * Finish the window; false if any of it failed.
+     */
+    virtual bool end() = 0;
+
+    virtual void frameDone() {}
+};
+
+/**
+ * Takes every pixel and drops it, for timing the render and expansion
+ * with no transfer behind them.
+ */
+class NullSink : public DisplaySink {
+public:
+    const char *name() const override { return "null"; }
+    bool begin(unsigned, int, int, int, int) override { return true; }
+    uint16_t *stage(size_t want, size_t &n) override {
+        n = want < STAGE_PIXELS ? want : STAGE_PIXELS;
+        return m_stage;
+    }
+    void commit(size_t) override {}
+    bool end() override { return true; }
+
+private:
+    static constexpr size_t STAGE_PIXELS = 2048;    // spidev's default bufsiz
+    alignas(64) uint16_t m_stage[STAGE_PIXELS];
+};
+
+#endif // DISPLAY_SINK_HPP
@@ -0,0 +1,245 @@
+/**
+ * DualEyeDisplay Implementation
+ */
+
+#include "dual_eye_display.hpp"
+#include "rgb565_kernels.hpp"
+#include "timebase.h"
+
+#include <iostream>
+#include <cstring>
+#include <system_error>
+
+DualEyeDisplay::DualEyeDisplay(DisplaySink &sink) : m_sink(sink) {
+    std::memset(m_fb, 0, sizeof(m_fb));
+}
+
+DualEyeDisplay::~DualEyeDisplay() {
+    stopTransferThread();
+}
+
+void DualEyeDisplay::powerUp() {
+    m_sink.powerUp();
+
+    // waitIdle() may be waiting on the panels
+    { std::lock_guard<std::mutex> lock(m_xfer_mutex); }
+    m_xfer_cv.notify_all();
+}
+
+bool DualEyeDisplay::writeFramebuffer(Eye eye) {
+    return writeFramebufferRegion(eye, 0, 0, WIDTH, HEIGHT);
+}
+
+bool DualEyeDisplay::writeFramebufferRegion(Eye eye, int x, int y, int w, int h) {
+    waitIdle();
+    uint64_t start_us = timebase_micros();
+    bool ok = sendRegion(eyeMask(eye), framebuffer(eye), m_palette, x, y, w, h);
+    frameDone(start_us);
+    return ok;
+}
+
+bool DualEyeDisplay::startTransferThread() {
+    if (m_xfer_thread.joinable()) {
+        return true;
+    }
+
+    m_xfer_stop = false;
+    try {
+        m_xfer_thread = std::thread(&DualEyeDisplay::transferLoop, this);
+    } catch (const std::system_error &e) {
+        std::cerr << "[Display] Failed to start transfer thread: " << e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void DualEyeDisplay::stopTransferThread() {
+    if (!m_xfer_thread.joinable()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_xfer_mutex);
+        m_xfer_stop = true;
+    }
+    m_xfer_cv.notify_all();
+    m_xfer_thread.join();
+}
+
+void DualEyeDisplay::presentFrame(const Region &left, const Region &right) {
+    const Region regions[2] = {left, right};
+    queueFrame(regions, false);
+}
+
+void DualEyeDisplay::presentShared(const Region &region) {
+    const Region regions[2] = {region, Region()};
+    queueFrame(regions, true);
+}
+
+void DualEyeDisplay::queueFrame(const Region regions[2], bool shared) {
+    if (!m_xfer_thread.joinable()) {
+        m_sink.powerUp();
+        uint64_t start_us = timebase_micros();
+        for (int i = 0; i < 2; i++) {
+            const Region &r = regions[i];
+            unsigned eyes = shared ? DisplaySink::EYE_MASK_BOTH : eyeMask(eyeAt(i));
+            sendRegion(eyes, m_fb[i][m_back[i]], m_palette, r.x, r.y, r.w, r.h);
+        }
+        frameDone(start_us);
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(m_xfer_mutex);
+    m_xfer_cv.wait(lock, [this] { return !m_xfer_pending; });
+
+    bool queued = false;
+    for (int i = 0; i < 2; i++) {
+        const Region &r = regions[i];
+        m_xfer_region[i] = r;
+        m_xfer_fb[i] = nullptr;
+        if (r.w > 0 && r.h > 0) {
+            // The drawn buffer becomes the front; the next frame goes into the other
+            m_xfer_fb[i] = m_fb[i][m_back[i]];
+            m_back[i] ^= 1;
+            queued = true;
+        }
+    }
+    m_xfer_shared = shared;
+
+    if (queued) {
+        std::memcpy(m_xfer_palette, m_palette, sizeof(m_xfer_palette));
+        m_xfer_pending = true;
+        lock.unlock();
+        m_xfer_cv.notify_all();
+    }
+}
+
+void DualEyeDisplay::waitIdle() {
+    if (!m_xfer_thread.joinable()) {
+        m_sink.powerUp();
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(m_xfer_mutex);
+    m_xfer_cv.wait(lock, [this] { return !m_xfer_pending && !poweringUp(); });
+}
+
+void DualEyeDisplay::transferLoop() {
+    powerUp();
+
+    std::unique_lock<std::mutex> lock(m_xfer_mutex);
+
+    while (true) {
+        m_xfer_cv.wait(lock, [this] { return m_xfer_pending || m_xfer_stop; });
+        if (!m_xfer_pending) {
+            break;  // Stopping with nothing queued
+        }
+
+        // The front buffers are not touched by the caller until pending clears
+        Region regions[2] = {m_xfer_region[0], m_xfer_region[1]};
+        const uint8_t *fbs[2] = {m_xfer_fb[0], m_xfer_fb[1]};
+        bool shared = m_xfer_shared;
+        lock.unlock();
+
+        uint64_t start_us = timebase_micros();
+        for (int i = 0; i < 2; i++) {
+            if (fbs[i]) {
+                unsigned eyes = shared ? DisplaySink::EYE_MASK_BOTH : eyeMask(eyeAt(i));
+                sendRegion(eyes, fbs[i], m_xfer_palette, regions[i].x, regions[i].y,
+                           regions[i].w, regions[i].h);
+            }
+        }
+        frameDone(start_us);
+
+        lock.lock();
+        m_xfer_pending = false;
+        m_xfer_cv.notify_all();
+    }
+}
+
+void DualEyeDisplay::frameDone(uint64_t start_us) {
+    m_sink.frameDone();
+
+    // Only the thread sending frames writes these
+    uint32_t us = static_cast<uint32_t>(timebase_micros() - start_us);
+    uint32_t avg = m_frame_us_avg.load(std::memory_order_relaxed);
+    m_frame_us.store(us, std::memory_order_relaxed);
+    m_frame_us_avg.store(avg ? avg - avg / 8 + us / 8 : us, std::memory_order_relaxed);
+    if (us > m_frame_us_max.load(std::memory_order_relaxed)) {
+        m_frame_us_max.store(us, std::memory_order_relaxed);
+    }
+    m_frames_sent.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool DualEyeDisplay::sendRegion(unsigned eyes, const uint8_t *fb, const uint16_t *palette,
+                                int x, int y, int w, int h) {
+    const Rgb565Kernels &k = rgb565Kernels();
+    return streamRegion(eyes, x, y, w, h, [&](uint16_t *dst, size_t offset, size_t n) {
+        k.expand(dst, fb + offset, palette, n);
+    });
+}
+
+template <typename Expand>
+bool DualEyeDisplay::streamRegion(unsigned eyes, int x, int y, int w, int h, Expand expand) {
+    // Clip to the panel
+    if (x < 0) { w += x; x = 0; }
+    if (y < 0) { h += y; y = 0; }
+    if (x + w > WIDTH) w = WIDTH - x;
+    if (y + h > HEIGHT) h = HEIGHT - y;
+    if (w <= 0 || h <= 0) {
+        return true;
+    }
+    if (!m_sink.begin(eyes, x, y, w, h)) {
+        return false;
+    }
+
+    // Pixels are expanded straight into the sink's staging memory, one
+    // chunk at a time, so no 16-bit copy of the window is ever built
+    auto queuePixels = [&](size_t offset, size_t n) {
+        while (n > 0) {
+            size_t chunk = 0;
+            uint16_t *dst = m_sink.stage(n, chunk);
+            expand(dst, offset, chunk);
+            m_sink.commit(chunk);
+            offset += chunk;
+            n -= chunk;
+        }
+    };
+    if (w == WIDTH) {
+        // Full-width rows are contiguous
+        queuePixels(static_cast<size_t>(y) * WIDTH, static_cast<size_t>(h) * WIDTH);
+    } else {
+        for (int row = 0; row < h; row++) {
+            queuePixels(static_cast<size_t>(y + row) * WIDTH + x, static_cast<size_t>(w));
+        }
+    }
+    m_bytes_sent.fetch_add(static_cast<uint64_t>(w) * h * 2, std::memory_order_relaxed);
+    return m_sink.end();
+}
+
+bool DualEyeDisplay::writeFramebuffer(Eye eye, const uint16_t *buffer) {
+    waitIdle();
+    uint64_t start_us = timebase_micros();
+    const Rgb565Kernels &k = rgb565Kernels();
+    bool ok = streamRegion(eyeMask(eye), 0, 0, WIDTH, HEIGHT, [&](uint16_t *dst, size_t offset, size_t n) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        k.byteSwap(dst, buffer + offset, n);
+#else
+        (void)k;
+        std::memcpy(dst, buffer + offset, n * 2);
+#endif
+    });
+    frameDone(start_us);
+    return ok;
+}
+
+void DualEyeDisplay::fill(Eye eye, uint16_t color) {
+    waitIdle();
+    uint64_t start_us = timebase_micros();
+    const Rgb565Kernels &k = rgb565Kernels();
+    uint16_t panel = toPanel(color);
+    streamRegion(eyeMask(eye), 0, 0, WIDTH, HEIGHT, [&](uint16_t *dst, size_t, size_t n) {
+        k.fill(dst, panel, n);
+    });
+    frameDone(start_us);
+}
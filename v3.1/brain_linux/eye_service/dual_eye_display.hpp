@@ -0,0 +1,208 @@
+#ifndef DUAL_EYE_DISPLAY_HPP
+#define DUAL_EYE_DISPLAY_HPP
+
+#include "display_sink.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+/**
+ * DualEyeDisplay - Framebuffers and frame pacing for the two 160x160 eyes
+ *
+ * The display owns two 8-bit indexed framebuffers per eye and one
+ * 256-entry palette. Draw palette indices into framebuffer(), set the
+ * colors with setPalette() and call writeFramebuffer(eye) or
+ * presentFrame(): the pixels are looked up in the palette, already in
+ * the panel's big-endian RGB565 byte order, chunk by chunk as they are
+ * handed to the DisplaySink, so no 16-bit frame is ever held.
+ *
+ * With startTransferThread(), presentFrame() only queues the frame: a
+ * dedicated thread streams it from the front buffers while the caller
+ * draws the next frame into the back buffers.
+ *
+ * The sink decides where the pixels go (the GC9D01 panels over SPI,
+ * nowhere, or image files) and must outlive the display.
+ */
+class DualEyeDisplay {
+public:
+    static constexpr int WIDTH = 160;
+    static constexpr int HEIGHT = 160;
+    static constexpr int PIXELS = WIDTH * HEIGHT;
+    static constexpr int BUFFER_SIZE = PIXELS * 2;  // RGB565 = 2 bytes/pixel on the wire
+    static constexpr int PALETTE_SIZE = 256;
+
+    enum class Eye {
+        LEFT,
+        RIGHT
+    };
+
+    // Window of an eye's framebuffer to send; w or h of 0 sends nothing
+    struct Region {
+        int x = 0;
+        int y = 0;
+        int w = 0;
+        int h = 0;
+    };
+
+    /**
+     * RGB565 value as laid out for the panel (MSB first in memory).
+     */
+    static constexpr uint16_t toPanel(uint16_t rgb565) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        return static_cast<uint16_t>((rgb565 << 8) | (rgb565 >> 8));
+#else
+        return rgb565;
+#endif
+    }
+
+    explicit DualEyeDisplay(DisplaySink &sink);
+    ~DualEyeDisplay();
+
+    DualEyeDisplay(const DualEyeDisplay &) = delete;
+    DualEyeDisplay &operator=(const DualEyeDisplay &) = delete;
+
+    DisplaySink &sink() { return m_sink; }
+
+    /**
+     * Bring the panels up now (blocking). Without the transfer thread the
+     * first frame does it otherwise.
+     */
+    void powerUp();
+
+    /**
+     * True until the sink's panels are up. Nothing should be presented
+     * meanwhile; waitIdle() also waits for it.
+     */
+    bool poweringUp() const { return m_sink.poweringUp(); }
+
+    /**
+     * Indexed back buffer for an eye (PIXELS entries): where the next
+     * frame is drawn. Never the buffer a queued transfer is reading.
+     */
+    uint8_t *framebuffer(Eye eye) {
+        int idx = eyeIndex(eye);
+        return m_fb[idx][m_back[idx]];
+    }
+
+    /**
+     * Which of the eye's two buffers framebuffer() returns (0 or 1), so a
+     * caller can tell whether the back buffer still holds what it drew
+     * there two frames ago.
+     */
+    int backBuffer(Eye eye) const { return m_back[eyeIndex(eye)]; }
+
+    /**
+     * Color of a palette index (native RGB565), used from the next frame
+     * sent on. A frame already queued keeps the palette it was queued with.
+     */
+    void setPalette(uint8_t index, uint16_t rgb565) { m_palette[index] = toPanel(rgb565); }
+
+    /**
+     * Send the eye's back buffer now. Waits for a queued frame to finish
+     * first.
+     */
+    bool writeFramebuffer(Eye eye);
+
+    /**
+     * Send only the window x..x+w-1, y..y+h-1 of the eye's back buffer.
+     * The window is clipped to the panel. Waits for a queued frame first.
+     */
+    bool writeFramebufferRegion(Eye eye, int x, int y, int w, int h);
+
+    /**
+     * Start the transfer thread; presentFrame() becomes asynchronous.
+     * If the panels are still in reset, the thread powers them up first.
+     * Stopped by stopTransferThread() or the destructor.
+     */
+    bool startTransferThread();
+    void stopTransferThread();
+
+    /**
+     * Show the back buffers: send the given window of each eye. Without the
+     * transfer thread this sends in place. With it, this waits only for the
+     * previous frame, swaps the back and front buffer of each eye that has
+     * a window, and returns while the thread streams them.
+     */
+    void presentFrame(const Region &left, const Region &right);
+
+    /**
+     * Like presentFrame(), but for a frame where both eyes are the same
+     * image: the left back buffer's window goes to both panels in one
+     * transfer. The right back buffer is left alone.
+     */
+    void presentShared(const Region &region);
+
+    /**
+     * Block until no queued frame is left and the panels are up.
+     */
+    void waitIdle();
+
+    /**
+     * Send a whole native-order RGB565 frame, byte-swapped as it is
+     * streamed. The eye's framebuffers are not touched.
+     */
+    bool writeFramebuffer(Eye eye, const uint16_t *buffer);
+
+    /**
+     * Fill display with solid color (framebuffers untouched).
+     */
+    void fill(Eye eye, uint16_t color);
+
+    /**
+     * Frames and pixel bytes handed to the sink so far (a window sent to
+     * both eyes at once counts once, as it does on the wire).
+     */
+    uint64_t framesSent() const { return m_frames_sent.load(std::memory_order_relaxed); }
+    uint64_t bytesSent() const { return m_bytes_sent.load(std::memory_order_relaxed); }
+
+    /**
+     * How long handing frames to the sink took, in microseconds: from the
+     * first window of a frame to frameDone(). Last frame, running average
+     * (1/8 weight per frame) and the worst so far.
+     */
+    uint32_t frameMicros() const { return m_frame_us.load(std::memory_order_relaxed); }
+    uint32_t frameMicrosAvg() const { return m_frame_us_avg.load(std::memory_order_relaxed); }
+    uint32_t frameMicrosMax() const { return m_frame_us_max.load(std::memory_order_relaxed); }
+
+private:
+    static int eyeIndex(Eye eye) { return (eye == Eye::LEFT) ? 0 : 1; }
+    static Eye eyeAt(int idx) { return (idx == 0) ? Eye::LEFT : Eye::RIGHT; }
+    static unsigned eyeMask(Eye eye) {
+        return (eye == Eye::LEFT) ? DisplaySink::EYE_MASK_LEFT : DisplaySink::EYE_MASK_RIGHT;
+    }
+
+    bool sendRegion(unsigned eyes, const uint8_t *fb, const uint16_t *palette, int x, int y, int w, int h);
+    template <typename Expand>
+    bool streamRegion(unsigned eyes, int x, int y, int w, int h, Expand expand);
+    void frameDone(uint64_t start_us);
+    void queueFrame(const Region regions[2], bool shared);
+    void transferLoop();
+
+    DisplaySink &m_sink;
+
+    alignas(64) uint8_t m_fb[2][2][PIXELS];        // [eye][buffer], palette indices
+    int m_back[2] = {0, 0};                         // Buffer drawn into, per eye
+    uint16_t m_palette[PALETTE_SIZE] = {};          // Panel order
+
+    std::atomic<uint64_t> m_frames_sent{0};
+    std::atomic<uint64_t> m_bytes_sent{0};
+    std::atomic<uint32_t> m_frame_us{0};
+    std::atomic<uint32_t> m_frame_us_avg{0};
+    std::atomic<uint32_t> m_frame_us_max{0};
+
+    // Transfer thread; the queued frame is guarded by m_xfer_mutex
+    std::thread m_xfer_thread;
+    std::mutex m_xfer_mutex;
+    std::condition_variable m_xfer_cv;
+    bool m_xfer_pending = false;
+    bool m_xfer_stop = false;
+    Region m_xfer_region[2];
+    const uint8_t *m_xfer_fb[2] = {nullptr, nullptr};
+    uint16_t m_xfer_palette[PALETTE_SIZE];          // m_palette when the frame was queued
+    bool m_xfer_shared = false;                     // Send [0] to both panels
+};
+
+#endif // DUAL_EYE_DISPLAY_HPP
@@ -3,140 +3,125 @@
  */
 
 #include "eye_animator.hpp"
+#include "eye_clips.hpp"
 #include <cstdlib>
-#include <cmath>
 
-// Timing (in ticks at 30 Hz)
-#define BLINK_CLOSE_TICKS   3   // ~100ms
-#define BLINK_HOLD_TICKS    2   // ~66ms
-#define BLINK_OPEN_TICKS    3   // ~100ms
-#define IDLE_BLINK_MIN      90  // ~3 seconds
-#define IDLE_BLINK_MAX      180 // ~6 seconds
-#define IDLE_LOOK_MIN       60  // ~2 seconds
-#define IDLE_LOOK_MAX       150 // ~5 seconds
+extern "C" {
+#include "timebase.h"
+}
+
+// Timing (ms)
+#define IDLE_BLINK_MIN_MS   3000
+#define IDLE_BLINK_MAX_MS   6000
+#define IDLE_LOOK_MIN_MS    2000
+#define IDLE_LOOK_MAX_MS    5000
+
+#define LOOK_TWEEN_MS       250     // Retargeting mid-glide starts from where the gaze is
+#define IDLE_LOOK_TWEEN_MS  600
+#define COLOR_FADE_MS       150
+
+#define IRIS_COLOR_DEFAULT  0x001F  // Blue, as EyeRenderer starts
+
+static uint64_t randomDelayUs(uint32_t min_ms, uint32_t max_ms) {
+    return (uint64_t)(min_ms + rand() % (max_ms - min_ms)) * 1000ULL;
+}
 
 EyeAnimator::EyeAnimator(EyeRenderer &renderer)
     : m_renderer(renderer) {
-    m_next_blink_time = IDLE_BLINK_MIN + rand() % (IDLE_BLINK_MAX - IDLE_BLINK_MIN);
-    m_next_look_time = IDLE_LOOK_MIN + rand() % (IDLE_LOOK_MAX - IDLE_LOOK_MIN);
+    m_values[EYE_CH_LOOK_X] = 0.0f;
+    m_values[EYE_CH_LOOK_Y] = 0.0f;
+    m_values[EYE_CH_LID_LEFT] = 0.0f;
+    m_values[EYE_CH_LID_RIGHT] = 0.0f;
+    m_values[EYE_CH_IRIS] = IRIS_COLOR_DEFAULT;
 }
 
-void EyeAnimator::tick() {
-    m_tick_count++;
-
-    updateBlink();
+bool EyeAnimator::tick() {
+    uint64_t now_us = timebase_micros();
 
     if (m_idle_enabled) {
-        updateIdle();
+        updateIdle(now_us);
     }
 
-    // Smooth interpolation towards target look position
-    float lerp_speed = 0.1f;
-    m_current_x += (m_target_x - m_current_x) * lerp_speed;
-    m_current_y += (m_target_y - m_current_y) * lerp_speed;
-    m_renderer.setEyePosition(m_current_x, m_current_y);
+    uint32_t changed = m_timeline.sample(now_us, m_values);
+    if (changed & ((1u << EYE_CH_LOOK_X) | (1u << EYE_CH_LOOK_Y))) {
+        m_renderer.setEyePosition(m_values[EYE_CH_LOOK_X], m_values[EYE_CH_LOOK_Y]);
+    }
+    if (changed & (1u << EYE_CH_LID_LEFT)) {
+        m_renderer.setBlink(DualEyeDisplay::Eye::LEFT, m_values[EYE_CH_LID_LEFT]);
+    }
+    if (changed & (1u << EYE_CH_LID_RIGHT)) {
+        m_renderer.setBlink(DualEyeDisplay::Eye::RIGHT, m_values[EYE_CH_LID_RIGHT]);
+    }
+    if (changed & (1u << EYE_CH_IRIS)) {
+        m_renderer.setIrisColor((uint16_t)m_values[EYE_CH_IRIS]);
+    }
 
-    // Render
+    // Also picks up changes made by commands since the last tick
+    if (!m_renderer.needsRender()) {
+        return false;
+    }
     m_renderer.render();
+    return true;
+}
+
+bool EyeAnimator::isActive() const {
+    return m_idle_enabled || m_timeline.playing();
+}
+
+void EyeAnimator::play(const EyeClip &clip) {
+    m_timeline.play(clip, timebase_micros(), m_values);
 }
 
 void EyeAnimator::blink() {
-    m_blink_state = BlinkState::CLOSING;
-    m_blink_timer = 0;
-    m_is_wink = false;
+    play(EYE_CLIP_BLINK);
 }
 
-void EyeAnimator::wink(GC9D01DualEyeSpi::Eye eye) {
-    m_blink_state = BlinkState::CLOSING;
-    m_blink_timer = 0;
-    m_is_wink = true;
-    m_wink_eye = eye;
+void EyeAnimator::wink(DualEyeDisplay::Eye eye) {
+    play(eye == DualEyeDisplay::Eye::LEFT ? EYE_CLIP_WINK_LEFT : EYE_CLIP_WINK_RIGHT);
 }
 
 void EyeAnimator::lookAt(float x, float y) {
-    m_target_x = x;
-    m_target_y = y;
+    uint64_t now_us = timebase_micros();
+    m_timeline.tween(EYE_CH_LOOK_X, m_values[EYE_CH_LOOK_X], x, LOOK_TWEEN_MS, Ease::OUT, now_us);
+    m_timeline.tween(EYE_CH_LOOK_Y, m_values[EYE_CH_LOOK_Y], y, LOOK_TWEEN_MS, Ease::OUT, now_us);
+}
+
+void EyeAnimator::setIrisColor(uint16_t color) {
+    m_timeline.tween(EYE_CH_IRIS, m_values[EYE_CH_IRIS], color, COLOR_FADE_MS, Ease::LINEAR, timebase_micros());
 }
 
 void EyeAnimator::setMood(EyeRenderer::Mood mood) {
     m_renderer.setMood(mood);
 }
 
-void EyeAnimator::updateBlink() {
-    switch (m_blink_state) {
-        case BlinkState::OPEN:
-            // Nothing to do
-            break;
-
-        case BlinkState::CLOSING:
-            m_blink_timer++;
-            {
-                float openness = 1.0f - (float)m_blink_timer / BLINK_CLOSE_TICKS;
-                float blink_amount = 1.0f - openness;  // setBlink: 0=open, 1=closed
-                if (m_is_wink) {
-                    m_renderer.setBlink(m_wink_eye, blink_amount);
-                } else {
-                    m_renderer.setBlink(GC9D01DualEyeSpi::Eye::LEFT, blink_amount);
-                    m_renderer.setBlink(GC9D01DualEyeSpi::Eye::RIGHT, blink_amount);
-                }
-            }
-            if (m_blink_timer >= BLINK_CLOSE_TICKS) {
-                m_blink_state = BlinkState::CLOSED;
-                m_blink_timer = 0;
-            }
-            break;
-
-        case BlinkState::CLOSED:
-            m_blink_timer++;
-            if (m_blink_timer >= BLINK_HOLD_TICKS) {
-                m_blink_state = BlinkState::OPENING;
-                m_blink_timer = 0;
-            }
-            break;
-
-        case BlinkState::OPENING:
-            m_blink_timer++;
-            {
-                float openness = (float)m_blink_timer / BLINK_OPEN_TICKS;
-                float blink_amount = 1.0f - openness;  // setBlink: 0=open, 1=closed
-                if (m_is_wink) {
-                    m_renderer.setBlink(m_wink_eye, blink_amount);
-                } else {
-                    m_renderer.setBlink(GC9D01DualEyeSpi::Eye::LEFT, blink_amount);
-                    m_renderer.setBlink(GC9D01DualEyeSpi::Eye::RIGHT, blink_amount);
-                }
-            }
-            if (m_blink_timer >= BLINK_OPEN_TICKS) {
-                m_blink_state = BlinkState::OPEN;
-                if (m_is_wink) {
-                    m_renderer.setBlink(m_wink_eye, 0.0f);  // 0 = open
-                } else {
-                    m_renderer.setBlink(GC9D01DualEyeSpi::Eye::LEFT, 0.0f);
-                    m_renderer.setBlink(GC9D01DualEyeSpi::Eye::RIGHT, 0.0f);
-                }
-            }
-            break;
+void EyeAnimator::setIdleEnabled(bool enabled) {
+    if (enabled && !m_idle_enabled) {
+        m_idle_armed = false;
     }
+    m_idle_enabled = enabled;
 }
 
-void EyeAnimator::updateIdle() {
-    m_idle_timer++;
+void EyeAnimator::updateIdle(uint64_t now_us) {
+    // Count from now, not from when idle was last running
+    if (!m_idle_armed) {
+        m_next_blink_us = now_us + randomDelayUs(IDLE_BLINK_MIN_MS, IDLE_BLINK_MAX_MS);
+        m_next_look_us = now_us + randomDelayUs(IDLE_LOOK_MIN_MS, IDLE_LOOK_MAX_MS);
+        m_idle_armed = true;
+    }
 
     // Random blink
-    if (m_idle_timer >= m_next_blink_time && m_blink_state == BlinkState::OPEN) {
-        blink();
-        m_next_blink_time = m_idle_timer + IDLE_BLINK_MIN +
-                            rand() % (IDLE_BLINK_MAX - IDLE_BLINK_MIN);
+    if (now_us >= m_next_blink_us &&
+        !m_timeline.playing(EYE_CH_LID_LEFT) && !m_timeline.playing(EYE_CH_LID_RIGHT)) {
+        m_timeline.play(EYE_CLIP_BLINK, now_us, m_values);
+        m_next_blink_us = now_us + randomDelayUs(IDLE_BLINK_MIN_MS, IDLE_BLINK_MAX_MS);
     }
 
-    // Random look direction
-    if (m_idle_timer >= m_next_look_time) {
-        m_target_x = ((float)rand() / RAND_MAX) * 2.0f - 1.0f;
-        m_target_y = ((float)rand() / RAND_MAX) * 2.0f - 1.0f;
-        // Keep within reasonable range
-        m_target_x *= 0.5f;
-        m_target_y *= 0.3f;
-        m_next_look_time = m_idle_timer + IDLE_LOOK_MIN +
-                           rand() % (IDLE_LOOK_MAX - IDLE_LOOK_MIN);
+    // Random look direction, kept within a reasonable range
+    if (now_us >= m_next_look_us) {
+        float x = (((float)rand() / RAND_MAX) * 2.0f - 1.0f) * 0.5f;
+        float y = (((float)rand() / RAND_MAX) * 2.0f - 1.0f) * 0.3f;
+        m_timeline.tween(EYE_CH_LOOK_X, m_values[EYE_CH_LOOK_X], x, IDLE_LOOK_TWEEN_MS, Ease::SMOOTH, now_us);
+        m_timeline.tween(EYE_CH_LOOK_Y, m_values[EYE_CH_LOOK_Y], y, IDLE_LOOK_TWEEN_MS, Ease::SMOOTH, now_us);
+        m_next_look_us = now_us + randomDelayUs(IDLE_LOOK_MIN_MS, IDLE_LOOK_MAX_MS);
     }
 }
@@ -2,6 +2,7 @@
 #define EYE_ANIMATOR_HPP
 
 #include "eye_renderer.hpp"
+#include "eye_timeline.hpp"
 #include <cstdint>
 
 /**
@@ -11,16 +12,39 @@
  * - Blink animation
  * - Wink animation
  * - Look (follow direction)
+ * - Iris colour fades
  * - Idle random movement
+ *
+ * Everything moves on an EyeTimeline (eye_timeline.hpp) against the
+ * monotonic clock, so speeds hold when the frame rate drops or frames are
+ * skipped. Canned expressions live in eye_clips.hpp.
  */
 class EyeAnimator {
 public:
     explicit EyeAnimator(EyeRenderer &renderer);
 
     /**
-     * Tick the animator (call at ~30 Hz).
+     * Tick the animator (call at ~30 Hz). Returns true if the scene changed
+     * and a frame was rendered.
+     */
+    bool tick();
+
+    /**
+     * True while there is something to animate: a clip or tween still
+     * running, or idle animation (which needs ticks for its timers). When
+     * false, ticking can stop until the next command.
+     */
+    bool isActive() const;
+
+    /**
+     * Play a clip from now; it takes over the channels it has tracks for.
      */
-    void tick();
+    void play(const EyeClip &clip);
+
+    /**
+     * True until every running clip and tween has finished.
+     */
+    bool playing() const { return m_timeline.playing(); }
 
     /**
      * Trigger a blink on both eyes.
@@ -30,13 +54,18 @@ public:
     /**
      * Trigger a wink on one eye.
      */
-    void wink(GC9D01DualEyeSpi::Eye eye);
+    void wink(DualEyeDisplay::Eye eye);
 
     /**
-     * Set look direction (immediate).
+     * Glide to a look direction from wherever the gaze is now.
      */
     void lookAt(float x, float y);
 
+    /**
+     * Fade the iris to a colour (native RGB565).
+     */
+    void setIrisColor(uint16_t color);
+
     /**
      * Set mood.
      */
@@ -45,37 +74,20 @@ public:
     /**
      * Enable/disable idle animation.
      */
-    void setIdleEnabled(bool enabled) { m_idle_enabled = enabled; }
+    void setIdleEnabled(bool enabled);
 
 private:
-    void updateBlink();
-    void updateIdle();
+    void updateIdle(uint64_t now_us);
 
     EyeRenderer &m_renderer;
-
-    // Blink state
-    enum class BlinkState {
-        OPEN,
-        CLOSING,
-        CLOSED,
-        OPENING
-    };
-    BlinkState m_blink_state = BlinkState::OPEN;
-    uint32_t m_blink_timer = 0;
-    GC9D01DualEyeSpi::Eye m_wink_eye;
-    bool m_is_wink = false;
+    EyeTimeline m_timeline;
+    float m_values[EYE_CH_COUNT];
 
     // Idle state
     bool m_idle_enabled = true;
-    uint32_t m_idle_timer = 0;
-    uint32_t m_next_blink_time = 0;
-    uint32_t m_next_look_time = 0;
-    float m_target_x = 0.0f;
-    float m_target_y = 0.0f;
-    float m_current_x = 0.0f;
-    float m_current_y = 0.0f;
-
-    uint32_t m_tick_count = 0;
+    bool m_idle_armed = false;      // Timers run from the first tick after enabling
+    uint64_t m_next_blink_us = 0;
+    uint64_t m_next_look_us = 0;
 };
 
 #endif // EYE_ANIMATOR_HPP
@@ -0,0 +1,93 @@
+#ifndef EYE_CLIPS_HPP
+#define EYE_CLIPS_HPP
+
+#include "eye_timeline.hpp"
+
+/**
+ * Expressions as data: the clips the animator and the boot sequence play.
+ * Times are milliseconds from the start of the clip; see eye_timeline.hpp.
+ */
+
+// Blink: 100 ms down, 66 ms held, 100 ms up
+inline constexpr EyeKey EYE_KEYS_BLINK[] = {
+    {   0, EYE_KEY_CURRENT, Ease::STEP },
+    { 100, 1.0f, Ease::IN },
+    { 166, 1.0f, Ease::LINEAR },
+    { 266, 0.0f, Ease::OUT },
+};
+
+inline constexpr EyeTrack EYE_TRACKS_BLINK[] = {
+    EYE_TRACK(EYE_CH_LID_LEFT, EYE_KEYS_BLINK),
+    EYE_TRACK(EYE_CH_LID_RIGHT, EYE_KEYS_BLINK),
+};
+inline constexpr EyeClip EYE_CLIP_BLINK = EYE_CLIP("blink", EYE_TRACKS_BLINK);
+
+inline constexpr EyeTrack EYE_TRACKS_WINK_LEFT[] = {
+    EYE_TRACK(EYE_CH_LID_LEFT, EYE_KEYS_BLINK),
+};
+inline constexpr EyeClip EYE_CLIP_WINK_LEFT = EYE_CLIP("wink_left", EYE_TRACKS_WINK_LEFT);
+
+inline constexpr EyeTrack EYE_TRACKS_WINK_RIGHT[] = {
+    EYE_TRACK(EYE_CH_LID_RIGHT, EYE_KEYS_BLINK),
+};
+inline constexpr EyeClip EYE_CLIP_WINK_RIGHT = EYE_CLIP("wink_right", EYE_TRACKS_WINK_RIGHT);
+
+// Boot, part 1 (sleepy): lids closed, then open over half a second
+inline constexpr EyeKey EYE_KEYS_BOOT_WAKE_LID[] = {
+    {   0, 1.0f, Ease::STEP },
+    { 100, 1.0f, Ease::LINEAR },
+    { 600, 0.0f, Ease::LINEAR },
+};
+inline constexpr EyeKey EYE_KEYS_BOOT_CENTER[] = {
+    {   0, 0.0f, Ease::STEP },
+};
+
+inline constexpr EyeTrack EYE_TRACKS_BOOT_WAKE[] = {
+    EYE_TRACK(EYE_CH_LID_LEFT, EYE_KEYS_BOOT_WAKE_LID),
+    EYE_TRACK(EYE_CH_LID_RIGHT, EYE_KEYS_BOOT_WAKE_LID),
+    EYE_TRACK(EYE_CH_LOOK_X, EYE_KEYS_BOOT_CENTER),
+    EYE_TRACK(EYE_CH_LOOK_Y, EYE_KEYS_BOOT_CENTER),
+};
+inline constexpr EyeClip EYE_CLIP_BOOT_WAKE = EYE_CLIP("boot_wake", EYE_TRACKS_BOOT_WAKE);
+
+// Boot, part 2 (normal): look left, right, up, down, centre, then blink twice
+inline constexpr EyeKey EYE_KEYS_BOOT_LOOK_X[] = {
+    {    0,  0.0f, Ease::STEP },
+    {  100,  0.0f, Ease::LINEAR },
+    {  366, -0.7f, Ease::SMOOTH },
+    {  433, -0.7f, Ease::LINEAR },
+    {  766,  0.7f, Ease::SMOOTH },
+    {  833,  0.7f, Ease::LINEAR },
+    { 1100,  0.0f, Ease::SMOOTH },
+};
+inline constexpr EyeKey EYE_KEYS_BOOT_LOOK_Y[] = {
+    {    0,  0.0f, Ease::STEP },
+    {  833,  0.0f, Ease::LINEAR },
+    { 1100, -0.4f, Ease::SMOOTH },
+    { 1166, -0.4f, Ease::LINEAR },
+    { 1433,  0.4f, Ease::SMOOTH },
+    { 1500,  0.4f, Ease::LINEAR },
+    { 1700,  0.0f, Ease::SMOOTH },
+};
+inline constexpr EyeKey EYE_KEYS_BOOT_LOOK_LID[] = {
+    {    0, 0.0f, Ease::STEP },
+    { 1766, 0.0f, Ease::LINEAR },
+    { 1866, 1.0f, Ease::IN },
+    { 1933, 1.0f, Ease::LINEAR },
+    { 2033, 0.0f, Ease::OUT },
+    { 2133, 0.0f, Ease::LINEAR },
+    { 2233, 1.0f, Ease::IN },
+    { 2300, 1.0f, Ease::LINEAR },
+    { 2400, 0.0f, Ease::OUT },
+    { 2500, 0.0f, Ease::LINEAR },
+};
+
+inline constexpr EyeTrack EYE_TRACKS_BOOT_LOOK[] = {
+    EYE_TRACK(EYE_CH_LOOK_X, EYE_KEYS_BOOT_LOOK_X),
+    EYE_TRACK(EYE_CH_LOOK_Y, EYE_KEYS_BOOT_LOOK_Y),
+    EYE_TRACK(EYE_CH_LID_LEFT, EYE_KEYS_BOOT_LOOK_LID),
+    EYE_TRACK(EYE_CH_LID_RIGHT, EYE_KEYS_BOOT_LOOK_LID),
+};
+inline constexpr EyeClip EYE_CLIP_BOOT_LOOK = EYE_CLIP("boot_look", EYE_TRACKS_BOOT_LOOK);
+
+#endif // EYE_CLIPS_HPP
@@ -1,14 +1,20 @@
 #include "eye_renderer.hpp"
-#include <cstring>
 #include <cmath>
+#include <cstring>
 #include <algorithm>
 
-// Colors (RGB565)
+// Colors (native RGB565)
 static constexpr uint16_t COLOR_BACKGROUND = 0xFFFF;  // White
 static constexpr uint16_t COLOR_SCLERA     = 0xF79E;  // Light gray
 static constexpr uint16_t COLOR_PUPIL      = 0x0000;  // Black
 static constexpr uint16_t COLOR_LID        = 0x0000;  // Black
-static constexpr uint16_t COLOR_IRIS_DEFAULT = 0x001F; // Blue
+
+// Palette indices the framebuffers hold; the colors live in the driver's palette
+static constexpr uint8_t PAL_BACKGROUND = 0;
+static constexpr uint8_t PAL_SCLERA     = 1;
+static constexpr uint8_t PAL_IRIS       = 2;
+static constexpr uint8_t PAL_PUPIL      = 3;
+static constexpr uint8_t PAL_LID        = 4;
 
 // Eye geometry
 static constexpr int EYE_CENTER_X    = 80;
@@ -18,10 +24,72 @@ static constexpr int IRIS_RADIUS     = 35;
 static constexpr int PUPIL_RADIUS    = 15;
 static constexpr int MAX_OFFSET      = 25;
 
-EyeRenderer::EyeRenderer(GC9D01DualEyeSpi &display)
-    : m_display(display), m_iris_color(COLOR_IRIS_DEFAULT) {
-    std::memset(m_fb_left, 0xFF, sizeof(m_fb_left));
-    std::memset(m_fb_right, 0xFF, sizeof(m_fb_right));
+// Rows the angry eyebrow covers (see drawAngryEyebrow)
+static constexpr int BROW_TOP        = 10;
+static constexpr int BROW_THICKNESS  = 8;
+static constexpr int BROW_SLOPE      = 25;
+static constexpr int BROW_BOTTOM     = BROW_TOP + BROW_THICKNESS + BROW_SLOPE;
+
+EyeRenderer::EyeRenderer(DualEyeDisplay &display)
+    : m_display(display) {
+    m_display.setPalette(PAL_BACKGROUND, COLOR_BACKGROUND);
+    m_display.setPalette(PAL_SCLERA, COLOR_SCLERA);
+    m_display.setPalette(PAL_IRIS, m_iris_color);
+    m_display.setPalette(PAL_PUPIL, COLOR_PUPIL);
+    m_display.setPalette(PAL_LID, COLOR_LID);
+    buildTables();
+}
+
+void EyeRenderer::CircleSpans::build(int r) {
+    radius = r;
+    half_width.resize(2 * r + 1);
+    for (int dy = -r; dy <= r; dy++) {
+        half_width[dy + r] = static_cast<int>(std::sqrt(r * r - dy * dy));
+    }
+}
+
+void EyeRenderer::buildTables() {
+    m_iris_spans.build(IRIS_RADIUS);
+    m_pupil_spans.build(PUPIL_RADIUS);
+
+    CircleSpans sclera;
+    sclera.build(SCLERA_RADIUS);
+    std::memset(m_base, PAL_BACKGROUND, sizeof(m_base));
+    drawFilledCircle(m_base, EYE_CENTER_X, EYE_CENTER_Y, sclera, PAL_SCLERA);
+
+    // Angry lid: column x is covered on rows above height - drop(x), where
+    // drop rises toward the inner corner. Count the columns with drop < v;
+    // they form a prefix (left eye) or suffix (right eye) of the row.
+    for (int v = 0; v <= ANGRY_LID_SLOPE + 1; v++) {
+        int left = 0, right = 0;
+        for (int px = 0; px < WIDTH; px++) {
+            if (px * ANGRY_LID_SLOPE / WIDTH < v) left++;
+            if ((WIDTH - px) * ANGRY_LID_SLOPE / WIDTH < v) right++;
+        }
+        m_angry_lid_cols[0][v] = left;
+        m_angry_lid_cols[1][v] = right;
+    }
+
+    // Happy lid: a parabola, so the columns covered v rows into the lid
+    // form one centred run
+    for (int v = 0; v <= SMILE_DEPTH; v++) {
+        int lo = WIDTH, hi = 0;
+        for (int px = 0; px < WIDTH; px++) {
+            float dx = px - (WIDTH / 2.0f);
+            int curve = static_cast<int>((dx * dx) / (WIDTH * 2.0f));
+            if (curve <= v) {
+                lo = std::min(lo, px);
+                hi = std::max(hi, px + 1);
+            }
+        }
+        m_smile_lo[v] = lo;
+        m_smile_hi[v] = std::max(lo, hi);
+    }
+
+    for (int px = 0; px < WIDTH; px++) {
+        m_brow_drop[0][px] = px * BROW_SLOPE / WIDTH;             // Slopes down toward the nose (right)
+        m_brow_drop[1][px] = (WIDTH - px) * BROW_SLOPE / WIDTH;   // Slopes down toward the nose (left)
+    }
 }
 
 void EyeRenderer::setEyePosition(float x, float y) {
@@ -33,63 +101,169 @@ void EyeRenderer::setEyePosition(Eye eye, float x, float y) {
     x = std::clamp(x, -1.0f, 1.0f);
     y = std::clamp(y, -1.0f, 1.0f);
 
-    if (eye == Eye::LEFT) {
-        m_pos_x_left = x;
-        m_pos_y_left = y;
-    } else {
-        m_pos_x_right = x;
-        m_pos_y_right = y;
+    float &pos_x = (eye == Eye::LEFT) ? m_pos_x_left : m_pos_x_right;
+    float &pos_y = (eye == Eye::LEFT) ? m_pos_y_left : m_pos_y_right;
+    if (pos_x != x || pos_y != y) {
+        pos_x = x;
+        pos_y = y;
+        m_scene_version++;
     }
 }
 
 void EyeRenderer::setMood(Mood mood) {
-    m_mood = mood;
+    if (m_mood != mood) {
+        m_mood = mood;
+        m_scene_version++;
+    }
 }
 
 void EyeRenderer::setBlink(Eye eye, float amount) {
     amount = std::clamp(amount, 0.0f, 1.0f);
-    if (eye == Eye::LEFT) {
-        m_blink_left = amount;
-    } else {
-        m_blink_right = amount;
+    float &blink = (eye == Eye::LEFT) ? m_blink_left : m_blink_right;
+    if (blink != amount) {
+        blink = amount;
+        m_scene_version++;
     }
 }
 
 void EyeRenderer::setIrisColor(uint16_t color) {
-    m_iris_color = color;
+    if (m_iris_color != color) {
+        // The panel stores RGB565, so the iris box is still re-sent
+        m_iris_color = color;
+        m_display.setPalette(PAL_IRIS, color);
+        m_scene_version++;
+    }
+}
+
+void EyeRenderer::invalidate() {
+    m_shown_valid[0] = false;
+    m_shown_valid[1] = false;
+    m_scene_version++;
 }
 
 void EyeRenderer::render() {
-    renderEye(Eye::LEFT);
-    renderEye(Eye::RIGHT);
-    m_display.writeFramebuffer(Eye::LEFT, m_fb_left);
-    m_display.writeFramebuffer(Eye::RIGHT, m_fb_right);
+    // Panels still coming out of reset: keep the change for the first real frame
+    if (m_display.poweringUp()) return;
+
+    // Nothing was set since the last frame: no state to compare, nothing to send
+    if (m_rendered_version == m_scene_version) return;
+    m_rendered_version = m_scene_version;
+
+    // Drawn straight into the driver's back buffers, then sent without a copy
+    EyeState next[2] = {computeState(Eye::LEFT), computeState(Eye::RIGHT)};
+    Rect dirty[2];
+    for (int idx = 0; idx < 2; idx++) {
+        dirty[idx] = m_shown_valid[idx] ? dirtyRect(m_shown[idx], next[idx])
+                                        : Rect{0, 0, WIDTH, HEIGHT};
+    }
+
+    // Redrawing a whole buffer is cheap, and it means the back buffer never
+    // holds a stale frame (renderEye() skips it when the indices match);
+    // the SPI transfer is what we limit
+    if (sameImage(next[0], next[1])) {
+        if (dirty[0].empty() && dirty[1].empty()) return;
+
+        // Both panels get the same pixels: draw once, send once to both
+        Rect both = dirty[0];
+        both.unite(dirty[1].x0, dirty[1].y0, dirty[1].x1, dirty[1].y1);
+        renderEye(Eye::LEFT, next[0]);
+        m_display.presentShared({both.x0, both.y0, both.x1 - both.x0, both.y1 - both.y0});
+        for (int idx = 0; idx < 2; idx++) {
+            m_shown[idx] = next[idx];
+            m_shown_valid[idx] = true;
+        }
+        return;
+    }
+
+    DualEyeDisplay::Region regions[2];
+    for (Eye eye : {Eye::LEFT, Eye::RIGHT}) {
+        int idx = (eye == Eye::LEFT) ? 0 : 1;
+        const Rect &r = dirty[idx];
+        if (r.empty()) continue;
+
+        renderEye(eye, next[idx]);
+        regions[idx] = {r.x0, r.y0, r.x1 - r.x0, r.y1 - r.y0};
+        m_shown[idx] = next[idx];
+        m_shown_valid[idx] = true;
+    }
+
+    m_display.presentFrame(regions[0], regions[1]);
 }
 
-void EyeRenderer::renderEye(Eye eye) {
-    uint16_t *fb = (eye == Eye::LEFT) ? m_fb_left : m_fb_right;
-    float pos_x = (eye == Eye::LEFT) ? m_pos_x_left : m_pos_x_right;
-    float pos_y = (eye == Eye::LEFT) ? m_pos_y_left : m_pos_y_right;
-    float blink = (eye == Eye::LEFT) ? m_blink_left : m_blink_right;
-    bool isLeft = (eye == Eye::LEFT);
+bool EyeRenderer::sameImage(const EyeState &left, const EyeState &right) {
+    // Only the angry lid and brow are drawn differently per side
+    return left.iris_x == right.iris_x && left.iris_y == right.iris_y &&
+           left.upper_lid == right.upper_lid && left.lower_lid == right.lower_lid &&
+           left.angry == right.angry && left.happy == right.happy &&
+           left.iris_color == right.iris_color && !left.angry;
+}
 
-    // Clear to background
-    for (int i = 0; i < WIDTH * HEIGHT; i++) {
-        fb[i] = COLOR_BACKGROUND;
+bool EyeRenderer::sameIndices(const EyeState &a, const EyeState &b) {
+    // The iris color is a palette entry, not part of the buffer
+    return a.iris_x == b.iris_x && a.iris_y == b.iris_y &&
+           a.upper_lid == b.upper_lid && a.lower_lid == b.lower_lid &&
+           a.angry == b.angry && a.happy == b.happy;
+}
+
+void EyeRenderer::Rect::unite(int ax0, int ay0, int ax1, int ay1) {
+    ax0 = std::max(ax0, 0);
+    ay0 = std::max(ay0, 0);
+    ax1 = std::min(ax1, WIDTH);
+    ay1 = std::min(ay1, HEIGHT);
+    if (ax0 >= ax1 || ay0 >= ay1) return;
+
+    if (empty()) {
+        x0 = ax0; y0 = ay0; x1 = ax1; y1 = ay1;
+    } else {
+        x0 = std::min(x0, ax0);
+        y0 = std::min(y0, ay0);
+        x1 = std::max(x1, ax1);
+        y1 = std::max(y1, ay1);
     }
+}
 
-    // Draw sclera (white of eye)
-    drawFilledCircle(fb, EYE_CENTER_X, EYE_CENTER_Y, SCLERA_RADIUS, COLOR_SCLERA);
+/**
+ * Pixels that can differ between two states. Each layer only ever draws
+ * inside its own bounds, so a layer that did not change contributes
+ * nothing, even where another layer covers it.
+ */
+EyeRenderer::Rect EyeRenderer::dirtyRect(const EyeState &prev, const EyeState &next) {
+    Rect r;
+
+    if (prev.iris_x != next.iris_x || prev.iris_y != next.iris_y ||
+        prev.iris_color != next.iris_color) {
+        r.unite(prev.iris_x - IRIS_RADIUS, prev.iris_y - IRIS_RADIUS,
+                prev.iris_x + IRIS_RADIUS + 1, prev.iris_y + IRIS_RADIUS + 1);
+        r.unite(next.iris_x - IRIS_RADIUS, next.iris_y - IRIS_RADIUS,
+                next.iris_x + IRIS_RADIUS + 1, next.iris_y + IRIS_RADIUS + 1);
+    }
 
-    // Calculate iris/pupil position based on look direction
-    int iris_x = EYE_CENTER_X + static_cast<int>(pos_x * MAX_OFFSET);
-    int iris_y = EYE_CENTER_Y + static_cast<int>(pos_y * MAX_OFFSET);
+    if (prev.upper_lid != next.upper_lid || prev.angry != next.angry) {
+        r.unite(0, 0, WIDTH, std::max(prev.upper_lid, next.upper_lid));
+    }
 
-    // Draw iris
-    drawFilledCircle(fb, iris_x, iris_y, IRIS_RADIUS, m_iris_color);
+    if (prev.lower_lid != next.lower_lid || prev.happy != next.happy) {
+        r.unite(0, HEIGHT - std::max(prev.lower_lid, next.lower_lid), WIDTH, HEIGHT);
+    }
 
-    // Draw pupil
-    drawFilledCircle(fb, iris_x, iris_y, PUPIL_RADIUS, COLOR_PUPIL);
+    if (prev.angry != next.angry) {
+        r.unite(0, BROW_TOP, WIDTH, BROW_BOTTOM);
+    }
+
+    return r;
+}
+
+EyeRenderer::EyeState EyeRenderer::computeState(Eye eye) const {
+    float pos_x = (eye == Eye::LEFT) ? m_pos_x_left : m_pos_x_right;
+    float pos_y = (eye == Eye::LEFT) ? m_pos_y_left : m_pos_y_right;
+    float blink = (eye == Eye::LEFT) ? m_blink_left : m_blink_right;
+
+    EyeState state;
+    state.iris_color = m_iris_color;
+
+    // Calculate iris/pupil position based on look direction
+    state.iris_x = EYE_CENTER_X + static_cast<int>(pos_x * MAX_OFFSET);
+    state.iris_y = EYE_CENTER_Y + static_cast<int>(pos_y * MAX_OFFSET);
 
     // Apply mood-specific lid shapes
     int upper_lid = 0;
@@ -124,39 +298,67 @@ void EyeRenderer::renderEye(Eye eye) {
         lower_lid = std::max(lower_lid, blink_lid);
     }
 
+    state.upper_lid = std::min(upper_lid, HEIGHT);
+    state.lower_lid = std::min(lower_lid, HEIGHT);
+    state.angry = angry_brow;
+    state.happy = happy_lower;
+    return state;
+}
+
+void EyeRenderer::renderEye(Eye eye, const EyeState &state) {
+    int idx = (eye == Eye::LEFT) ? 0 : 1;
+    int buf = m_display.backBuffer(eye);
+    if (m_drawn_valid[idx][buf] && sameIndices(m_drawn[idx][buf], state)) {
+        return;
+    }
+    m_drawn[idx][buf] = state;
+    m_drawn_valid[idx][buf] = true;
+
+    uint8_t *fb = m_display.framebuffer(eye);
+    bool isLeft = (eye == Eye::LEFT);
+
+    // Background and sclera (white of eye)
+    std::memcpy(fb, m_base, sizeof(m_base));
+
+    // Draw iris
+    drawFilledCircle(fb, state.iris_x, state.iris_y, m_iris_spans, PAL_IRIS);
+
+    // Draw pupil
+    drawFilledCircle(fb, state.iris_x, state.iris_y, m_pupil_spans, PAL_PUPIL);
+
     // Draw upper eyelid
-    if (upper_lid > 0) {
-        drawUpperLid(fb, upper_lid, angry_brow, isLeft);
+    if (state.upper_lid > 0) {
+        drawUpperLid(fb, state.upper_lid, state.angry, isLeft);
     }
 
     // Draw lower eyelid
-    if (lower_lid > 0) {
-        drawLowerLid(fb, lower_lid, happy_lower);
+    if (state.lower_lid > 0) {
+        drawLowerLid(fb, state.lower_lid, state.happy);
     }
 
     // Draw angry eyebrow on top
-    if (angry_brow) {
+    if (state.angry) {
         drawAngryEyebrow(fb, isLeft);
     }
 }
 
-void EyeRenderer::drawFilledCircle(uint16_t *buffer, int cx, int cy, int r, uint16_t color) {
-    int r2 = r * r;
+void EyeRenderer::drawFilledCircle(uint8_t *buffer, int cx, int cy, const CircleSpans &spans,
+                                   uint8_t color) {
+    int r = spans.radius;
     for (int dy = -r; dy <= r; dy++) {
         int py = cy + dy;
         if (py < 0 || py >= HEIGHT) continue;
 
-        int dx_max = static_cast<int>(std::sqrt(r2 - dy * dy));
+        int dx_max = spans.half_width[dy + r];
         int x_start = std::max(0, cx - dx_max);
         int x_end = std::min(WIDTH - 1, cx + dx_max);
+        if (x_start > x_end) continue;
 
-        for (int px = x_start; px <= x_end; px++) {
-            buffer[py * WIDTH + px] = color;
-        }
+        std::memset(buffer + py * WIDTH + x_start, color, x_end - x_start + 1);
     }
 }
 
-void EyeRenderer::drawCircle(uint16_t *buffer, int cx, int cy, int r, uint16_t color) {
+void EyeRenderer::drawCircle(uint8_t *buffer, int cx, int cy, int r, uint8_t color) {
     int x = r;
     int y = 0;
     int err = 1 - r;
@@ -187,78 +389,54 @@ void EyeRenderer::drawCircle(uint16_t *buffer, int cx, int cy, int r, uint16_t c
     }
 }
 
-void EyeRenderer::drawFilledRect(uint16_t *buffer, int x, int y, int w, int h, uint16_t color) {
+void EyeRenderer::drawFilledRect(uint8_t *buffer, int x, int y, int w, int h, uint8_t color) {
     int x_start = std::max(0, x);
     int y_start = std::max(0, y);
     int x_end = std::min(WIDTH, x + w);
     int y_end = std::min(HEIGHT, y + h);
+    if (x_start >= x_end) return;
 
     for (int py = y_start; py < y_end; py++) {
-        for (int px = x_start; px < x_end; px++) {
-            buffer[py * WIDTH + px] = color;
-        }
+        std::memset(buffer + py * WIDTH + x_start, color, x_end - x_start);
     }
 }
 
-void EyeRenderer::drawUpperLid(uint16_t *buffer, int height, bool angry, bool isLeft) {
+void EyeRenderer::drawUpperLid(uint8_t *buffer, int height, bool angry, bool isLeft) {
     if (angry) {
-        // Diagonal lid for angry expression
-        for (int py = 0; py < height + 30; py++) {
-            for (int px = 0; px < WIDTH; px++) {
-                // Slope: higher on outer edge, lower on inner
-                int threshold;
-                if (isLeft) {
-                    threshold = height - (px * 20 / WIDTH);
-                } else {
-                    threshold = height - ((WIDTH - px) * 20 / WIDTH);
-                }
-                if (py < threshold && py < HEIGHT) {
-                    buffer[py * WIDTH + px] = COLOR_LID;
-                }
-            }
+        // Diagonal lid for angry expression: higher on outer edge, lower on inner
+        const int *cols = m_angry_lid_cols[isLeft ? 0 : 1];
+        for (int py = 0; py < std::min(height, HEIGHT); py++) {
+            int v = std::min(height - py, ANGRY_LID_SLOPE + 1);
+            int n = cols[v];
+            uint8_t *row = buffer + py * WIDTH;
+            std::memset(isLeft ? row : row + WIDTH - n, PAL_LID, n);
         }
     } else {
         // Straight horizontal lid
-        drawFilledRect(buffer, 0, 0, WIDTH, height, COLOR_LID);
+        drawFilledRect(buffer, 0, 0, WIDTH, height, PAL_LID);
     }
 }
 
-void EyeRenderer::drawLowerLid(uint16_t *buffer, int height, bool happy) {
+void EyeRenderer::drawLowerLid(uint8_t *buffer, int height, bool happy) {
     if (happy) {
         // Curved lower lid (smile shape)
         for (int py = HEIGHT - height; py < HEIGHT; py++) {
-            for (int px = 0; px < WIDTH; px++) {
-                // Parabola: y = a*(x-center)^2 + base
-                float dx = px - (WIDTH / 2.0f);
-                float curve = (dx * dx) / (WIDTH * 2.0f);
-                int threshold = HEIGHT - height + static_cast<int>(curve);
-                if (py >= threshold) {
-                    buffer[py * WIDTH + px] = COLOR_LID;
-                }
-            }
+            int v = std::min(py - (HEIGHT - height), SMILE_DEPTH);
+            std::memset(buffer + py * WIDTH + m_smile_lo[v], PAL_LID, m_smile_hi[v] - m_smile_lo[v]);
         }
     } else {
         // Straight horizontal lid
-        drawFilledRect(buffer, 0, HEIGHT - height, WIDTH, height, COLOR_LID);
+        drawFilledRect(buffer, 0, HEIGHT - height, WIDTH, height, PAL_LID);
     }
 }
 
-void EyeRenderer::drawAngryEyebrow(uint16_t *buffer, bool isLeft) {
+void EyeRenderer::drawAngryEyebrow(uint8_t *buffer, bool isLeft) {
     // Draw thick diagonal eyebrow line
-    int thickness = 8;
-    for (int t = 0; t < thickness; t++) {
-        for (int px = 0; px < WIDTH; px++) {
-            int py;
-            if (isLeft) {
-                // Left eye: brow slopes down toward center (right side)
-                py = 10 + t + (px * 25 / WIDTH);
-            } else {
-                // Right eye: brow slopes down toward center (left side)
-                py = 10 + t + ((WIDTH - px) * 25 / WIDTH);
-            }
-            if (py >= 0 && py < HEIGHT && px >= 0 && px < WIDTH) {
-                buffer[py * WIDTH + px] = COLOR_LID;
-            }
+    const int *drop = m_brow_drop[isLeft ? 0 : 1];
+    for (int px = 0; px < WIDTH; px++) {
+        int top = BROW_TOP + drop[px];
+        for (int py = top; py < std::min(top + BROW_THICKNESS, HEIGHT); py++) {
+            buffer[py * WIDTH + px] = PAL_LID;
         }
     }
 }
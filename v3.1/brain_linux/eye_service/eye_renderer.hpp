@@ -1,12 +1,13 @@
 #ifndef EYE_RENDERER_HPP
 #define EYE_RENDERER_HPP
 
-#include "gc9d01_dualeye_spi.hpp"
+#include "dual_eye_display.hpp"
 #include <cstdint>
+#include <vector>
 
 class EyeRenderer {
 public:
-    using Eye = GC9D01DualEyeSpi::Eye;
+    using Eye = DualEyeDisplay::Eye;
 
     enum class Mood {
         NORMAL,
@@ -16,28 +17,87 @@ public:
         BLINK
     };
 
-    explicit EyeRenderer(GC9D01DualEyeSpi &display);
+    explicit EyeRenderer(DualEyeDisplay &display);
 
     void setEyePosition(Eye eye, float x, float y);
     void setEyePosition(float x, float y);
     void setMood(Mood mood);
     void setBlink(Eye eye, float amount);
-    void setIrisColor(uint16_t color);
+    void setIrisColor(uint16_t color);      // Native RGB565, a palette entry
+
+    /**
+     * Redraw and send what changed since the last render(): only the
+     * bounding box of the moved iris, lids or brow goes over SPI, and an
+     * eye whose state is unchanged is skipped entirely. When both eyes come
+     * out pixel-identical (any mood but angry, no wink) one transfer feeds
+     * both panels. A back buffer that already holds the indices of the
+     * new state is not redrawn, so an iris color change only re-sends
+     * the iris box. Returns once the frame is queued if the driver's
+     * transfer thread is running. Costs nothing when no setter changed
+     * anything since the last call. While the display is powering up
+     * nothing is drawn and needsRender() stays true.
+     */
     void render();
 
+    /**
+     * Bumped by every setter call that changes the scene and by invalidate().
+     */
+    uint32_t sceneVersion() const { return m_scene_version; }
+
+    /**
+     * True if the scene changed since the last render().
+     */
+    bool needsRender() const { return m_rendered_version != m_scene_version; }
+
+    /**
+     * Send both eyes in full on the next render() (e.g. after a display reset).
+     */
+    void invalidate();
+
 private:
-    void renderEye(Eye eye);
-    void drawFilledCircle(uint16_t *buffer, int cx, int cy, int r, uint16_t color);
-    void drawCircle(uint16_t *buffer, int cx, int cy, int r, uint16_t color);
-    void drawFilledRect(uint16_t *buffer, int x, int y, int w, int h, uint16_t color);
-    void drawUpperLid(uint16_t *buffer, int height, bool angry, bool isLeft);
-    void drawLowerLid(uint16_t *buffer, int height, bool happy);
-    void drawAngryEyebrow(uint16_t *buffer, bool isLeft);
+    // Everything that decides an eye's pixels
+    struct EyeState {
+        int iris_x = 0;
+        int iris_y = 0;
+        int upper_lid = 0;
+        int lower_lid = 0;
+        bool angry = false;
+        bool happy = false;
+        uint16_t iris_color = 0;                // Not in the indices, only in what is sent
+    };
+
+    // Half-width of each scanline of a filled circle, from dy = -r to r
+    struct CircleSpans {
+        int radius = 0;
+        std::vector<int> half_width;
 
-    GC9D01DualEyeSpi &m_display;
+        void build(int r);
+    };
 
-    static constexpr int WIDTH = GC9D01DualEyeSpi::WIDTH;
-    static constexpr int HEIGHT = GC9D01DualEyeSpi::HEIGHT;
+    struct Rect {
+        int x0 = 0, y0 = 0, x1 = 0, y1 = 0;     // Half-open
+
+        bool empty() const { return x0 >= x1 || y0 >= y1; }
+        void unite(int ax0, int ay0, int ax1, int ay1);
+    };
+
+    EyeState computeState(Eye eye) const;
+    static Rect dirtyRect(const EyeState &prev, const EyeState &next);
+    static bool sameImage(const EyeState &left, const EyeState &right);
+    static bool sameIndices(const EyeState &a, const EyeState &b);
+    void renderEye(Eye eye, const EyeState &state);
+    void buildTables();
+    void drawFilledCircle(uint8_t *buffer, int cx, int cy, const CircleSpans &spans, uint8_t color);
+    void drawCircle(uint8_t *buffer, int cx, int cy, int r, uint8_t color);
+    void drawFilledRect(uint8_t *buffer, int x, int y, int w, int h, uint8_t color);
+    void drawUpperLid(uint8_t *buffer, int height, bool angry, bool isLeft);
+    void drawLowerLid(uint8_t *buffer, int height, bool happy);
+    void drawAngryEyebrow(uint8_t *buffer, bool isLeft);
+
+    DualEyeDisplay &m_display;
+
+    static constexpr int WIDTH = DualEyeDisplay::WIDTH;
+    static constexpr int HEIGHT = DualEyeDisplay::HEIGHT;
 
     float m_pos_x_left = 0.0f;
     float m_pos_y_left = 0.0f;
@@ -48,8 +108,28 @@ private:
     Mood m_mood = Mood::NORMAL;
     uint16_t m_iris_color = 0x001F;
 
-    uint16_t m_fb_left[GC9D01DualEyeSpi::PIXELS];
-    uint16_t m_fb_right[GC9D01DualEyeSpi::PIXELS];
+    // Built once at construction: a frame is a copy of m_base (background
+    // and sclera, the same in every mood) plus span fills from these tables
+    static constexpr int ANGRY_LID_SLOPE = 20;      // Rows the angry lid drops across the eye
+    static constexpr int SMILE_DEPTH = 20;          // Rows the happy lid curves up at the edges
+    alignas(64) uint8_t m_base[WIDTH * HEIGHT];
+    CircleSpans m_iris_spans;
+    CircleSpans m_pupil_spans;
+    int m_angry_lid_cols[2][ANGRY_LID_SLOPE + 2];   // [side][v]: columns covered v rows above the lid edge
+    int m_smile_lo[SMILE_DEPTH + 1];                // [v]: covered columns are [lo, hi) ...
+    int m_smile_hi[SMILE_DEPTH + 1];                // ... v rows into the happy lid
+    int m_brow_drop[2][WIDTH];                      // [side][x]: brow offset below BROW_TOP
+
+    uint32_t m_scene_version = 1;
+    uint32_t m_rendered_version = 0;
+
+    // What each panel currently shows
+    EyeState m_shown[2];
+    bool m_shown_valid[2] = {false, false};
+
+    // What was last drawn into each of the driver's buffers, [eye][buffer]
+    EyeState m_drawn[2][2];
+    bool m_drawn_valid[2][2] = {{false, false}, {false, false}};
 };
 
 #endif // EYE_RENDERER_HPP
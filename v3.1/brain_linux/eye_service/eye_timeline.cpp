@@ -0,0 +1,98 @@
+/**
+ * EyeTimeline Implementation
+ */
+
+#include "eye_timeline.hpp"
+#include <cmath>
+
+float easeApply(Ease ease, float t) {
+    switch (ease) {
+        case Ease::STEP:    return t < 1.0f ? 0.0f : 1.0f;
+        case Ease::LINEAR:  return t;
+        case Ease::IN:      return t * t;
+        case Ease::OUT:     return t * (2.0f - t);
+        case Ease::SMOOTH:  return t * t * (3.0f - 2.0f * t);
+    }
+    return t;
+}
+
+// Per-component blend, so a colour fade does not wander through other hues
+static float blendRgb565(float a, float b, float t) {
+    uint32_t ca = (uint32_t)a;
+    uint32_t cb = (uint32_t)b;
+    uint32_t out = 0;
+    static const uint32_t shifts[3] = { 11, 5, 0 };
+    static const uint32_t masks[3] = { 0x1F, 0x3F, 0x1F };
+    for (int i = 0; i < 3; i++) {
+        float va = (float)((ca >> shifts[i]) & masks[i]);
+        float vb = (float)((cb >> shifts[i]) & masks[i]);
+        out |= (uint32_t)std::lround(va + (vb - va) * t) << shifts[i];
+    }
+    return (float)out;
+}
+
+void EyeTimeline::play(const EyeClip &clip, uint64_t now_us, const float *current) {
+    for (int i = 0; i < clip.count; i++) {
+        const EyeTrack &track = clip.tracks[i];
+        if (track.channel >= EYE_CH_COUNT || track.count == 0) continue;
+
+        Lane &lane = m_lanes[track.channel];
+        lane.start_us = now_us;
+        lane.count = track.count < MAX_KEYS ? track.count : MAX_KEYS;
+        for (int k = 0; k < lane.count; k++) {
+            lane.keys[k] = track.keys[k];
+            if (std::isnan(lane.keys[k].value)) {
+                lane.keys[k].value = current[track.channel];
+            }
+        }
+        m_running |= 1u << track.channel;
+    }
+}
+
+void EyeTimeline::tween(EyeChannel ch, float from, float to, uint32_t ms, Ease ease, uint64_t now_us) {
+    if (ch >= EYE_CH_COUNT) return;
+
+    Lane &lane = m_lanes[ch];
+    lane.start_us = now_us;
+    lane.count = 2;
+    lane.keys[0] = { 0, from, Ease::STEP };
+    lane.keys[1] = { (uint16_t)(ms < 0xFFFF ? ms : 0xFFFF), to, ease };
+    m_running |= 1u << ch;
+}
+
+uint32_t EyeTimeline::sample(uint64_t now_us, float *values) {
+    uint32_t written = m_running;
+    for (int ch = 0; ch < EYE_CH_COUNT; ch++) {
+        if (!playing((EyeChannel)ch)) continue;
+
+        const Lane &lane = m_lanes[ch];
+        float elapsed_ms = now_us > lane.start_us ? (float)(now_us - lane.start_us) / 1000.0f : 0.0f;
+        values[ch] = sampleLane((EyeChannel)ch, lane, elapsed_ms);
+        if (elapsed_ms >= lane.keys[lane.count - 1].t_ms) {
+            stop((EyeChannel)ch);
+        }
+    }
+    return written;
+}
+
+float EyeTimeline::sampleLane(EyeChannel ch, const Lane &lane, float elapsed_ms) const {
+    if (elapsed_ms <= lane.keys[0].t_ms) {
+        return lane.keys[0].value;
+    }
+
+    int k = 1;
+    while (k < lane.count && lane.keys[k].t_ms <= elapsed_ms) {
+        k++;
+    }
+    if (k == lane.count) {
+        return lane.keys[k - 1].value;
+    }
+
+    const EyeKey &a = lane.keys[k - 1];
+    const EyeKey &b = lane.keys[k];
+    float t = easeApply(b.ease, (elapsed_ms - a.t_ms) / (float)(b.t_ms - a.t_ms));
+    if (ch == EYE_CH_IRIS) {
+        return blendRgb565(a.value, b.value, t);
+    }
+    return a.value + (b.value - a.value) * t;
+}
@@ -0,0 +1,100 @@
+#ifndef EYE_TIMELINE_HPP
+#define EYE_TIMELINE_HPP
+
+#include <cstdint>
+#include <limits>
+
+/**
+ * EyeTimeline - Keyframed tracks for the eye animator
+ *
+ * Every animated value (gaze, each lid, iris colour) is a channel. A clip
+ * is plain data: per channel, a list of keys at millisecond offsets, each
+ * with the easing of the segment that arrives at it. Sampling works from
+ * elapsed wall time, so a clip lasts as long as it says however many
+ * frames are dropped along the way.
+ */
+
+enum class Ease : uint8_t {
+    STEP,       // Hold the previous key, jump on arrival
+    LINEAR,
+    IN,         // Quadratic, slow start
+    OUT,        // Quadratic, slow finish
+    SMOOTH      // Smoothstep, slow at both ends
+};
+
+float easeApply(Ease ease, float t);
+
+enum EyeChannel : uint8_t {
+    EYE_CH_LOOK_X,
+    EYE_CH_LOOK_Y,
+    EYE_CH_LID_LEFT,        // 0 = open, 1 = closed
+    EYE_CH_LID_RIGHT,
+    EYE_CH_IRIS,            // RGB565, blended per component
+    EYE_CH_COUNT
+};
+
+// Stands for the channel's value when the clip starts
+static constexpr float EYE_KEY_CURRENT = std::numeric_limits<float>::quiet_NaN();
+
+struct EyeKey {
+    uint16_t t_ms;          // From the start of the clip
+    float value;
+    Ease ease;              // Shape of the segment ending at this key
+};
+
+struct EyeTrack {
+    EyeChannel channel;
+    const EyeKey *keys;
+    uint8_t count;
+};
+
+struct EyeClip {
+    const char *name;
+    const EyeTrack *tracks;
+    uint8_t count;
+};
+
+#define EYE_TRACK(ch, keys)     { ch, keys, (uint8_t)(sizeof(keys) / sizeof((keys)[0])) }
+#define EYE_CLIP(name, tracks)  { name, tracks, (uint8_t)(sizeof(tracks) / sizeof((tracks)[0])) }
+
+class EyeTimeline {
+public:
+    static constexpr int MAX_KEYS = 12;     // Longer tracks are cut short
+
+    /**
+     * Start a clip at now_us. It takes over the channels it has tracks
+     * for; others keep running. current holds every channel's present
+     * value, for EYE_KEY_CURRENT keys.
+     */
+    void play(const EyeClip &clip, uint64_t now_us, const float *current);
+
+    /**
+     * Start a two-key track on one channel: from -> to over ms.
+     */
+    void tween(EyeChannel ch, float from, float to, uint32_t ms, Ease ease, uint64_t now_us);
+
+    /**
+     * Write each running channel's value at now_us into values and return
+     * a bitmask (1 << channel) of those written. A track past its last
+     * key writes that key once more and stops.
+     */
+    uint32_t sample(uint64_t now_us, float *values);
+
+    bool playing() const { return m_running != 0; }
+    bool playing(EyeChannel ch) const { return (m_running >> ch) & 1; }
+    void stop(EyeChannel ch) { m_running &= ~(1u << ch); }
+
+private:
+    struct Lane {
+        uint64_t start_us = 0;
+        uint8_t count = 0;
+        EyeKey keys[MAX_KEYS];
+    };
+
+    float sampleLane(EyeChannel ch, const Lane &lane, float elapsed_ms) const;
+
+    Lane m_lanes[EYE_CH_COUNT];
+    uint32_t m_running = 0;
+};
+
+#endif // EYE_TIMELINE_HPP
@@ -0,0 +1,148 @@
+/**
+ * FileSink Implementation
+ */
+
+#include "file_sink.hpp"
+
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+FileSink::FileSink(const std::string &dir, Format format, unsigned every)
+    : m_dir(dir), m_format(format), m_every(every ? every : 1) {
+    std::memset(m_panel, 0, sizeof(m_panel));
+}
+
+bool FileSink::begin(unsigned eyes, int x, int y, int w, int h) {
+    (void)h;
+    m_eyes = eyes;
+    m_x = x;
+    m_y = y;
+    m_w = w;
+    m_cursor = 0;
+    return true;
+}
+
+uint16_t *FileSink::stage(size_t want, size_t &n) {
+    n = want < (size_t)WIDTH ? want : (size_t)WIDTH;
+    return m_stage;
+}
+
+void FileSink::commit(size_t n) {
+    // Lay the pixels into the window row by row, as the panel would
+    for (size_t i = 0; i < n; i++, m_cursor++) {
+        size_t pos = (size_t)(m_y + (int)(m_cursor / m_w)) * WIDTH + m_x + (int)(m_cursor % m_w);
+        if (m_eyes & EYE_MASK_LEFT) m_panel[0][pos] = m_stage[i];
+        if (m_eyes & EYE_MASK_RIGHT) m_panel[1][pos] = m_stage[i];
+    }
+}
+
+void FileSink::frameDone() {
+    if (m_frames++ % m_every != 0) {
+        return;
+    }
+
+    char path[512];
+    snprintf(path, sizeof(path), "%s/eyes_%06u.%s", m_dir.c_str(), m_frames - 1,
+             m_format == Format::PNG ? "png" : "rgb565");
+    bool ok = (m_format == Format::PNG) ? writePng(path) : writeRaw(path);
+    if (ok) {
+        m_files++;
+    } else if (!m_error_logged) {
+        std::cerr << "[Display] Cannot write " << path << std::endl;
+        m_error_logged = true;
+    }
+}
+
+bool FileSink::writeRaw(const char *path) const {
+    FILE *f = fopen(path, "wb");
+    if (!f) return false;
+    bool ok = fwrite(m_panel, sizeof(m_panel), 1, f) == 1;
+    return fclose(f) == 0 && ok;
+}
+
+static uint32_t crc32Update(uint32_t crc, const uint8_t *data, size_t len) {
+    static uint32_t table[256];
+    if (table[1] == 0) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+    }
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static void putBe32(std::vector<uint8_t> &out, uint32_t v) {
+    out.push_back((uint8_t)(v >> 24));
+    out.push_back((uint8_t)(v >> 16));
+    out.push_back((uint8_t)(v >> 8));
+    out.push_back((uint8_t)v);
+}
+
+static void putChunk(std::vector<uint8_t> &out, const char type[4], const std::vector<uint8_t> &data) {
+    putBe32(out, (uint32_t)data.size());
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    putBe32(out, crc32Update(0, out.data() + start, out.size() - start));
+}
+
+bool FileSink::writePng(const char *path) const {
+    const int width = 2 * WIDTH;
+
+    // Scanlines: filter byte 0, then RGB888 with the left eye on the left
+    std::vector<uint8_t> raw;
+    raw.reserve((size_t)HEIGHT * (1 + width * 3));
+    for (int y = 0; y < HEIGHT; y++) {
+        raw.push_back(0);
+        for (int eye = 0; eye < 2; eye++) {
+            for (int x = 0; x < WIDTH; x++) {
+                uint16_t v = DualEyeDisplay::toPanel(m_panel[eye][y * WIDTH + x]);  // Back to native
+                uint8_t r = (v >> 11) & 0x1F, g = (v >> 5) & 0x3F, b = v & 0x1F;
+                raw.push_back((uint8_t)((r << 3) | (r >> 2)));
+                raw.push_back((uint8_t)((g << 2) | (g >> 4)));
+                raw.push_back((uint8_t)((b << 3) | (b >> 2)));
+            }
+        }
+    }
+
+    // zlib stream of stored deflate blocks
+    std::vector<uint8_t> idat = {0x78, 0x01};
+    uint32_t a = 1, b = 0;
+    for (uint8_t c : raw) {
+        a = (a + c) % 65521;
+        b = (b + a) % 65521;
+    }
+    for (size_t off = 0; off < raw.size();) {
+        size_t len = std::min<size_t>(raw.size() - off, 65535);
+        bool last = off + len == raw.size();
+        idat.push_back(last ? 1 : 0);
+        idat.push_back((uint8_t)len);
+        idat.push_back((uint8_t)(len >> 8));
+        idat.push_back((uint8_t)~len);
+        idat.push_back((uint8_t)(~len >> 8));
+        idat.insert(idat.end(), raw.begin() + off, raw.begin() + off + len);
+        off += len;
+    }
+    putBe32(idat, (b << 16) | a);
+
+    std::vector<uint8_t> ihdr;
+    putBe32(ihdr, width);
+    putBe32(ihdr, HEIGHT);
+    ihdr.insert(ihdr.end(), {8, 2, 0, 0, 0});      // 8-bit RGB, no interlace
+
+    std::vector<uint8_t> png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    putChunk(png, "IHDR", ihdr);
+    putChunk(png, "IDAT", idat);
+    putChunk(png, "IEND", {});
+
+    FILE *f = fopen(path, "wb");
+    if (!f) return false;
+    bool ok = fwrite(png.data(), png.size(), 1, f) == 1;
+    return fclose(f) == 0 && ok;
+}
@@ -0,0 +1,61 @@
+#ifndef FILE_SINK_HPP
+#define FILE_SINK_HPP
+
+#include "display_sink.hpp"
+#include "dual_eye_display.hpp"
+
+#include <cstdint>
+#include <string>
+
+/**
+ * FileSink - Eye frames to image files, for running without panels
+ *
+ * Keeps what each panel would show and, every Nth presented frame, writes
+ * both eyes side by side (320x160) to DIR/eyes_NNNNNN.png or .rgb565.
+ * Raw files hold the left then the right panel image in panel order
+ * (big-endian RGB565, as the GC9D01 receives it). PNGs are stored
+ * uncompressed, so no zlib is needed.
+ */
+class FileSink : public DisplaySink {
+public:
+    enum class Format {
+        PNG,
+        RAW
+    };
+
+    FileSink(const std::string &dir, Format format, unsigned every);
+
+    const char *name() const override { return m_format == Format::PNG ? "png" : "raw"; }
+
+    bool begin(unsigned eyes, int x, int y, int w, int h) override;
+    uint16_t *stage(size_t want, size_t &n) override;
+    void commit(size_t n) override;
+    bool end() override { return true; }
+    void frameDone() override;
+
+    unsigned filesWritten() const { return m_files; }
+
+private:
+    static constexpr int WIDTH = DualEyeDisplay::WIDTH;
+    static constexpr int HEIGHT = DualEyeDisplay::HEIGHT;
+
+    bool writePng(const char *path) const;
+    bool writeRaw(const char *path) const;
+
+    std::string m_dir;
+    Format m_format;
+    unsigned m_every;
+    unsigned m_frames = 0;
+    unsigned m_files = 0;
+    bool m_error_logged = false;
+
+    // Window being written and how far into it
+    unsigned m_eyes = 0;
+    int m_x = 0, m_y = 0, m_w = 0;
+    size_t m_cursor = 0;
+
+    uint16_t m_stage[WIDTH];
+    uint16_t m_panel[2][WIDTH * HEIGHT];           // Panel order, as shown
+};
+
+#endif // FILE_SINK_HPP
@@ -8,17 +8,26 @@
 #include "gpio/gpio_backend.hpp"
 
 #include <iostream>
+#include <fstream>
+#include <cerrno>
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
 #include <linux/spi/spidev.h>
 #include <cstring>
+#include <algorithm>
+
+extern "C" {
+#include "timebase.h"
+}
 
 // SPI settings
 #define SPI_DEVICE    "/dev/spidev0.0"
-#define SPI_SPEED_HZ  20000000  // 20 MHz
+#define SPI_READ_HZ   5000000   // Readback is rated far slower than writes
 #define SPI_MODE      SPI_MODE_0
 #define SPI_BITS      8
+#define SPI_BUFSIZ_PATH     "/sys/module/spidev/parameters/bufsiz"
+#define SPI_BUFSIZ_DEFAULT  4096    // spidev's default bounce buffer
 
 // GPIO pin assignments (from PINOUT.md)
 #define GPIO_DC        506  // J2-27 XGPIOA[26]
@@ -33,12 +42,30 @@
 #define CMD_CASET     0x2A
 #define CMD_RASET     0x2B
 #define CMD_RAMWR     0x2C
+#define CMD_RAMRD     0x2E
 #define CMD_MADCTL    0x36
 #define CMD_COLMOD    0x3A
 
+// Clock calibration: a pattern written at the candidate clock must read
+// back (at SPI_READ_HZ) as it does when written slowly
+#define CAL_PIXELS      16              // Top-left corner, outside the round glass
+#define CAL_READ_BYTES  (1 + CAL_PIXELS * 3)   // Dummy byte, then 3 bytes per pixel
+#define CAL_TRIALS      3               // Per eye and clock step
+
 static GpioBackend *s_gpio = nullptr;
 
-GC9D01DualEyeSpi::GC9D01DualEyeSpi() {
+// Bytes spidev accepts per message (its bounce buffer), from the module parameter
+static size_t probeSpiBufsiz() {
+    std::ifstream f(SPI_BUFSIZ_PATH);
+    unsigned long bufsiz = 0;
+    if (f >> bufsiz && bufsiz > 0) {
+        return static_cast<size_t>(bufsiz);
+    }
+    return SPI_BUFSIZ_DEFAULT;
+}
+
+GC9D01DualEyeSpi::GC9D01DualEyeSpi()
+    : m_spi_hz(SPI_HZ_DEFAULT), m_spi_max_hz(SPI_MAX_HZ_DEFAULT) {
     s_gpio = createGpioBackend();
 }
 
@@ -95,32 +122,52 @@ bool GC9D01DualEyeSpi::init() {
         return false;
     }
 
-    // Configure SPI
+    // Configure SPI; each transfer then asks for m_spi_hz itself, up to the
+    // device maximum set here
     uint8_t mode = SPI_MODE;
     uint8_t bits = SPI_BITS;
-    uint32_t speed = SPI_SPEED_HZ;
+    uint32_t speed = std::max(m_spi_hz.load(), m_spi_max_hz);
 
-    ioctl(m_spi_fd, SPI_IOC_WR_MODE, &mode);
-    ioctl(m_spi_fd, SPI_IOC_WR_BITS_PER_WORD, &bits);
-    ioctl(m_spi_fd, SPI_IOC_WR_MAX_SPEED_HZ, &speed);
-
-    // Reset and initialize both displays
-    if (!initDisplay(Eye::LEFT)) {
-        return false;
-    }
-    if (!initDisplay(Eye::RIGHT)) {
+    if (ioctl(m_spi_fd, SPI_IOC_WR_MODE, &mode) < 0 ||
+        ioctl(m_spi_fd, SPI_IOC_WR_BITS_PER_WORD, &bits) < 0 ||
+        ioctl(m_spi_fd, SPI_IOC_WR_MAX_SPEED_HZ, &speed) < 0) {
+        std::cerr << "[Display] Failed to configure " << SPI_DEVICE << ": " << strerror(errno) << std::endl;
+        close(m_spi_fd);
+        m_spi_fd = -1;
         return false;
     }
 
-    std::cout << "[Display] Initialized dual GC9D01 displays" << std::endl;
+    m_spi_bufsiz = probeSpiBufsiz();
+    size_t messages = (BUFFER_SIZE + m_spi_bufsiz - 1) / m_spi_bufsiz;
+    std::cout << "[Display] spidev bufsiz " << m_spi_bufsiz << " bytes, "
+              << messages << " ioctl(s) per full frame" << std::endl;
+    if (messages > 1) {
+        std::cout << "[Display] Boot with spidev.bufsiz=" << BUFFER_SIZE
+                  << " for one data ioctl per frame" << std::endl;
+    }
+    // Pixels are expanded into this as each message is built
+    m_stage.assign(std::min<size_t>(m_spi_bufsiz, BUFFER_SIZE) / 2, 0);
+    m_stage_used = 0;
+
+    // Hold both panels in reset; powerUp() finishes the pulse
+    m_powering.store(true, std::memory_order_release);
+    m_window[0] = Window();
+    m_window[1] = Window();
+    s_gpio->write(GPIO_RST_LEFT, 0);
+    s_gpio->write(GPIO_RST_RIGHT, 0);
+    m_reset_start_us = timebase_micros();
     return true;
 }
 
-bool GC9D01DualEyeSpi::initDisplay(Eye eye) {
-    // Reset display
-    reset(eye);
+void GC9D01DualEyeSpi::powerUp() {
+    if (!poweringUp()) {
+        return;
+    }
 
-    selectEye(eye);
+    // Both panels share SPI and DC, so with both CS low every command below
+    // reaches the pair and each wait is paid once
+    reset(EYE_MASK_BOTH);
+    selectEyes(EYE_MASK_BOTH);
 
     // Sleep out
     sendCommand(CMD_SLPOUT);
@@ -135,98 +182,299 @@ bool GC9D01DualEyeSpi::initDisplay(Eye eye) {
     sendCommand(CMD_DISPON);
     usleep(20000);
 
-    return true;
+    std::cout << "[Display] Initialized dual GC9D01 displays" << std::endl;
+
+    if (m_spi_max_hz > m_spi_hz) {
+        calibrateClock();
+    }
+    std::cout << "[Display] SPI clock " << m_spi_hz / 1000 << " kHz" << std::endl;
+    m_powering.store(false, std::memory_order_release);
+}
+
+void GC9D01DualEyeSpi::setSpiClock(uint32_t hz, uint32_t max_hz) {
+    m_spi_hz = hz;
+    m_spi_max_hz = max_hz;
+}
+
+bool GC9D01DualEyeSpi::writePattern(unsigned eye, const uint16_t *pixels) {
+    selectEyes(eye);
+    setWindow(eye, 0, 0, CAL_PIXELS, 1);
+    return sendCommand(CMD_RAMWR) &&
+           sendData(reinterpret_cast<const uint8_t *>(pixels), CAL_PIXELS * 2);
 }
 
-void GC9D01DualEyeSpi::selectEye(Eye eye) {
+bool GC9D01DualEyeSpi::readPattern(unsigned eye, uint8_t *out) {
+    uint32_t hz = m_spi_hz;
+    m_spi_hz = std::min<uint32_t>(hz, SPI_READ_HZ);
+    selectEyes(eye);
+    setWindow(eye, 0, 0, CAL_PIXELS, 1);
+    bool ok = sendCommand(CMD_RAMRD);
+    s_gpio->write(GPIO_DC, 1);
+
+    // SDA is the panel's only data line: turn it around for the read
+    uint32_t mode = SPI_MODE | SPI_3WIRE;
+    if (ok && ioctl(m_spi_fd, SPI_IOC_WR_MODE32, &mode) < 0) {
+        ok = false;
+    } else if (ok) {
+        struct spi_ioc_transfer xfer = {};
+        xfer.rx_buf = reinterpret_cast<unsigned long>(out);
+        xfer.len = CAL_READ_BYTES;
+        xfer.speed_hz = m_spi_hz;
+        xfer.bits_per_word = SPI_BITS;
+        ok = ioctl(m_spi_fd, SPI_IOC_MESSAGE(1), &xfer) >= 0;
+
+        mode = SPI_MODE;
+        if (ioctl(m_spi_fd, SPI_IOC_WR_MODE32, &mode) < 0) {
+            std::cerr << "[Display] Cannot leave 3-wire mode: " << strerror(errno) << std::endl;
+            ok = false;
+        }
+    }
+    m_spi_hz = hz;
+    return ok;
+}
+
+/**
+ * Step the clock up from m_spi_hz by a quarter at a time, to at most
+ * m_spi_max_hz, and keep the fastest step at which every trial on both
+ * panels passes: pattern A written slowly, then pattern B at the step's
+ * clock (window commands included), must read back as B did when it was
+ * written slowly. Reading needs the controller to do 3-wire transfers on
+ * the shared SDA line; without that the configured clock is kept.
+ */
+void GC9D01DualEyeSpi::calibrateClock() {
+    uint16_t pattern_a[CAL_PIXELS], pattern_b[CAL_PIXELS];
+    for (int i = 0; i < CAL_PIXELS; i++) {
+        pattern_a[i] = (i & 1) ? 0x5555 : 0xAAAA;
+        pattern_b[i] = static_cast<uint16_t>(0x0FF0 ^ (i * 0x1111));
+    }
+
+    const uint32_t base = m_spi_hz;
+    uint8_t ref[2][CAL_READ_BYTES];
+    for (int i = 0; i < 2; i++) {
+        unsigned eye = eyeMask(eyeAt(i));
+        uint8_t got_a[CAL_READ_BYTES];
+        if (!writePattern(eye, pattern_a) || !readPattern(eye, got_a) ||
+            !writePattern(eye, pattern_b) || !readPattern(eye, ref[i]) ||
+            std::memcmp(got_a, ref[i], CAL_READ_BYTES) == 0) {
+            std::cout << "[Display] No panel readback, SPI clock not calibrated" << std::endl;
+            return;
+        }
+    }
+
+    uint32_t best = base;
+    for (uint32_t hz = base; hz < m_spi_max_hz;) {
+        hz = std::min(hz + hz / 4, m_spi_max_hz);
+        bool ok = true;
+        for (int trial = 0; trial < CAL_TRIALS && ok; trial++) {
+            for (int i = 0; i < 2 && ok; i++) {
+                unsigned eye = eyeMask(eyeAt(i));
+                uint8_t got[CAL_READ_BYTES];
+                m_spi_hz = base;
+                ok = writePattern(eye, pattern_a);
+                m_spi_hz = hz;
+                ok = ok && writePattern(eye, pattern_b);
+                m_spi_hz = base;
+                ok = ok && readPattern(eye, got) && std::memcmp(got, ref[i], CAL_READ_BYTES) == 0;
+            }
+        }
+        if (!ok) {
+            break;
+        }
+        best = hz;
+    }
+    m_spi_hz = best;
+    std::cout << "[Display] SPI clock calibrated between " << base / 1000 << " and "
+              << m_spi_max_hz / 1000 << " kHz" << std::endl;
+}
+
+void GC9D01DualEyeSpi::selectEyes(unsigned eyes) {
     // Deselect both (CS high = inactive)
     s_gpio->write(GPIO_CS_LEFT, 1);
     s_gpio->write(GPIO_CS_RIGHT, 1);
 
-    // Select target (CS low = active)
-    if (eye == Eye::LEFT) {
+    // Select targets (CS low = active); with both low, both panels latch the same bytes
+    if (eyes & EYE_MASK_LEFT) {
         s_gpio->write(GPIO_CS_LEFT, 0);
-    } else {
+    }
+    if (eyes & EYE_MASK_RIGHT) {
         s_gpio->write(GPIO_CS_RIGHT, 0);
     }
 }
 
-void GC9D01DualEyeSpi::sendCommand(uint8_t cmd) {
+bool GC9D01DualEyeSpi::sendCommand(uint8_t cmd) {
     // DC low for command
     s_gpio->write(GPIO_DC, 0);
 
     struct spi_ioc_transfer xfer = {};
     xfer.tx_buf = reinterpret_cast<unsigned long>(&cmd);
     xfer.len = 1;
-    xfer.speed_hz = SPI_SPEED_HZ;
+    xfer.speed_hz = m_spi_hz.load(std::memory_order_relaxed);
     xfer.bits_per_word = SPI_BITS;
 
-    ioctl(m_spi_fd, SPI_IOC_MESSAGE(1), &xfer);
+    if (ioctl(m_spi_fd, SPI_IOC_MESSAGE(1), &xfer) < 0) {
+        spiFailed();
+        return false;
+    }
+    return true;
 }
 
-void GC9D01DualEyeSpi::sendData(const uint8_t *data, size_t len) {
+void GC9D01DualEyeSpi::spiFailed() {
+    if (!m_spi_error_logged) {
+        std::cerr << "[Display] SPI transfer failed: " << strerror(errno) << std::endl;
+        m_spi_error_logged = true;
+    }
+    // The panel's address window is unknown now
+    m_window[0] = Window();
+    m_window[1] = Window();
+}
+
+bool GC9D01DualEyeSpi::sendData(const uint8_t *data, size_t len) {
     // DC high for data
     s_gpio->write(GPIO_DC, 1);
 
-    struct spi_ioc_transfer xfer = {};
-    xfer.tx_buf = reinterpret_cast<unsigned long>(data);
-    xfer.len = static_cast<uint32_t>(len);
-    xfer.speed_hz = SPI_SPEED_HZ;
-    xfer.bits_per_word = SPI_BITS;
+    queueData(data, len);
+    return flushData();
+}
 
-    ioctl(m_spi_fd, SPI_IOC_MESSAGE(1), &xfer);
+void GC9D01DualEyeSpi::queueData(const uint8_t *data, size_t len) {
+    while (len > 0) {
+        size_t room = m_spi_bufsiz - m_seg_bytes;
+        if (room == 0 || m_seg_count == MAX_SEGMENTS) {
+            flushData();
+            continue;
+        }
+
+        // cs_change stays 0: CS is held across the whole message, no gaps
+        size_t chunk = std::min(len, room);
+        struct spi_ioc_transfer &xfer = m_segs[m_seg_count++];
+        xfer = {};
+        xfer.tx_buf = reinterpret_cast<unsigned long>(data);
+        xfer.len = static_cast<uint32_t>(chunk);
+        xfer.speed_hz = m_spi_hz.load(std::memory_order_relaxed);
+        xfer.bits_per_word = SPI_BITS;
+
+        m_seg_bytes += chunk;
+        data += chunk;
+        len -= chunk;
+    }
 }
 
-void GC9D01DualEyeSpi::reset(Eye eye) {
-    int rst_pin = (eye == Eye::LEFT) ? GPIO_RST_LEFT : GPIO_RST_RIGHT;
+bool GC9D01DualEyeSpi::flushData() {
+    if (m_seg_count == 0) {
+        return true;
+    }
 
-    // Pull reset low
-    s_gpio->write(rst_pin, 0);
-    usleep(10000);  // 10ms low pulse
+    int ret = ioctl(m_spi_fd, SPI_IOC_MESSAGE(m_seg_count), m_segs);
+    m_seg_count = 0;
+    m_seg_bytes = 0;
+    m_stage_used = 0;
 
-    // Release reset (high)
-    s_gpio->write(rst_pin, 1);
-    usleep(120000);  // 120ms recovery
+    if (ret < 0) {
+        spiFailed();
+        return false;
+    }
+    return true;
 }
 
-bool GC9D01DualEyeSpi::writeFramebuffer(Eye eye, const uint16_t *buffer) {
-    selectEye(eye);
+void GC9D01DualEyeSpi::setWindow(unsigned eyes, int x, int y, int w, int h) {
+    bool current = true;
+    for (int i = 0; i < 2; i++) {
+        const Window &win = m_window[i];
+        if ((eyes & eyeMask(eyeAt(i))) &&
+            !(win.x == x && win.y == y && win.w == w && win.h == h)) {
+            current = false;
+        }
+    }
+    if (current) {
+        return;
+    }
+
+    // Set column address (x to x+w-1)
+    uint8_t caset[] = {0, static_cast<uint8_t>(x), 0, static_cast<uint8_t>(x + w - 1)};
+    bool ok = sendCommand(CMD_CASET) && sendData(caset, 4);
+
+    // Set row address (y to y+h-1)
+    uint8_t raset[] = {0, static_cast<uint8_t>(y), 0, static_cast<uint8_t>(y + h - 1)};
+    ok = sendCommand(CMD_RASET) && sendData(raset, 4) && ok;
+    if (!ok) {
+        return;
+    }
 
-    // Set column address (0 to WIDTH-1)
-    sendCommand(CMD_CASET);
-    uint8_t caset[] = {0, 0, 0, WIDTH - 1};
-    sendData(caset, 4);
+    for (int i = 0; i < 2; i++) {
+        if (eyes & eyeMask(eyeAt(i))) {
+            m_window[i] = Window{x, y, w, h};
+        }
+    }
+}
 
-    // Set row address (0 to HEIGHT-1)
-    sendCommand(CMD_RASET);
-    uint8_t raset[] = {0, 0, 0, HEIGHT - 1};
-    sendData(raset, 4);
+void GC9D01DualEyeSpi::reset(unsigned eyes) {
+    // Pull reset low, unless init() already did and the pulse is under way
+    bool held = m_reset_start_us != 0;
+    uint64_t low_us = held ? timebase_micros() - m_reset_start_us : 0;
+    m_reset_start_us = 0;
+    for (int i = 0; i < 2; i++) {
+        if (eyes & eyeMask(eyeAt(i))) {
+            m_window[i] = Window();
+            if (!held) {
+                s_gpio->write(i == 0 ? GPIO_RST_LEFT : GPIO_RST_RIGHT, 0);
+            }
+        }
+    }
+    if (low_us < 10000) {
+        usleep(10000 - low_us);  // 10ms low pulse
+    }
 
-    // Write memory
-    sendCommand(CMD_RAMWR);
+    // Release reset (high)
+    for (int i = 0; i < 2; i++) {
+        if (eyes & eyeMask(eyeAt(i))) {
+            s_gpio->write(i == 0 ? GPIO_RST_LEFT : GPIO_RST_RIGHT, 1);
+        }
+    }
+    usleep(120000);  // 120ms recovery
+}
 
-    // Swap bytes for RGB565 big-endian (display expects MSB first)
-    uint8_t *swapped = new uint8_t[BUFFER_SIZE];
-    for (int i = 0; i < PIXELS; i++) {
-        swapped[i * 2] = (buffer[i] >> 8) & 0xFF;      // High byte first
-        swapped[i * 2 + 1] = buffer[i] & 0xFF;         // Low byte second
+bool GC9D01DualEyeSpi::begin(unsigned eyes, int x, int y, int w, int h) {
+    // Not initialized: nothing to send to
+    if (m_spi_fd < 0) {
+        return false;
     }
-    sendData(swapped, BUFFER_SIZE);
-    delete[] swapped;
 
+    selectEyes(eyes);
+    setWindow(eyes, x, y, w, h);
+
+    // Write memory. DC is a GPIO and cannot change inside a message, so
+    // RAMWR goes first on its own and every pixel follows in as few ioctls
+    // as bufsiz allows.
+    if (!sendCommand(CMD_RAMWR)) {
+        return false;
+    }
+    s_gpio->write(GPIO_DC, 1);
+    m_region_ok = true;
     return true;
 }
 
+uint16_t *GC9D01DualEyeSpi::stage(size_t want, size_t &n) {
+    // The staging buffer holds one message: send it before reusing it
+    size_t room = m_stage.size() - m_stage_used;
+    if (room == 0 || m_seg_count == MAX_SEGMENTS) {
+        m_region_ok = flushData() && m_region_ok;
+        room = m_stage.size();
+    }
+    n = std::min(want, room);
+    return m_stage.data() + m_stage_used;
+}
+
+void GC9D01DualEyeSpi::commit(size_t n) {
+    queueData(reinterpret_cast<const uint8_t *>(m_stage.data() + m_stage_used), n * 2);
+    m_stage_used += n;
+}
+
+bool GC9D01DualEyeSpi::end() {
+    return flushData() && m_region_ok;
+}
+
 void GC9D01DualEyeSpi::setBacklight(Eye eye, uint8_t brightness) {
     // TODO: Implement PWM backlight control
     (void)eye;
     (void)brightness;
 }
-
-void GC9D01DualEyeSpi::fill(Eye eye, uint16_t color) {
-    uint16_t buffer[PIXELS];
-    for (int i = 0; i < PIXELS; i++) {
-        buffer[i] = color;
-    }
-    writeFramebuffer(eye, buffer);
-}
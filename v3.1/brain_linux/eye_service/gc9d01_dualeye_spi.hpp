@@ -1,21 +1,44 @@
 #ifndef GC9D01_DUALEYE_SPI_HPP
 #define GC9D01_DUALEYE_SPI_HPP
 
+#include "display_sink.hpp"
+
+#include <atomic>
 #include <cstdint>
-#include <string>
+#include <vector>
+#include <linux/spi/spidev.h>
 
 /**
  * GC9D01DualEyeSpi - Dual GC9D01 display driver via SPI
  *
- * Two 160x160 RGB565 displays for left and right eyes.
- * Uses spidev for SPI communication and GPIO for control signals.
+ * Two 160x160 RGB565 displays for left and right eyes, as the DisplaySink
+ * behind DualEyeDisplay. Uses spidev for SPI communication and GPIO for
+ * control signals.
+ *
+ * Pixel data is batched into SPI_IOC_MESSAGEs no larger than spidev's
+ * bufsiz (probed at init): the display expands pixels into a staging
+ * buffer of that size and each full buffer goes out as one ioctl, so a
+ * full frame is one data ioctl when the module is loaded with
+ * spidev.bufsiz >= BUFFER_SIZE.
+ *
+ * init() only sets up GPIO and SPI and starts the reset pulse. The panels
+ * are brought up together by powerUp(), which DualEyeDisplay's transfer
+ * thread runs before its first frame, so the caller is free within
+ * milliseconds.
+ *
+ * The SPI clock starts at setSpiClock()'s rate (20 MHz by default). When
+ * a higher ceiling is given, powerUp() then calibrates: it steps the
+ * clock up while a pattern written at each step still reads back intact
+ * (RAMRD over 3-wire SDA, at a slow read clock) and keeps the fastest
+ * step that passed.
  */
-class GC9D01DualEyeSpi {
+class GC9D01DualEyeSpi : public DisplaySink {
 public:
     static constexpr int WIDTH = 160;
     static constexpr int HEIGHT = 160;
-    static constexpr int PIXELS = WIDTH * HEIGHT;
-    static constexpr int BUFFER_SIZE = PIXELS * 2;  // RGB565 = 2 bytes/pixel
+    static constexpr int BUFFER_SIZE = WIDTH * HEIGHT * 2;  // RGB565 = 2 bytes/pixel
+    static constexpr uint32_t SPI_HZ_DEFAULT = 20000000;
+    static constexpr uint32_t SPI_MAX_HZ_DEFAULT = 40000000;   // The panels' rated clock
 
     enum class Eye {
         LEFT,
@@ -23,41 +46,104 @@ public:
     };
 
     GC9D01DualEyeSpi();
-    ~GC9D01DualEyeSpi();
+    ~GC9D01DualEyeSpi() override;
+
+    /**
+     * Clock for pixel and command transfers, and the ceiling powerUp()
+     * may calibrate up to (no calibration unless max_hz > hz). Call
+     * before init().
+     */
+    void setSpiClock(uint32_t hz, uint32_t max_hz);
 
     /**
-     * Initialize both displays.
+     * Set up GPIO and SPI and put both panels into reset. powerUp() next.
+     * False if spidev cannot be opened or configured.
      */
     bool init();
 
+    const char *name() const override { return "spi"; }
+
     /**
-     * Write framebuffer to specified eye.
+     * Bring both panels out of reset and switch them on, in lockstep:
+     * one reset, one SLPOUT wait and one DISPON wait for the pair
+     * (~270 ms, blocking).
      */
-    bool writeFramebuffer(Eye eye, const uint16_t *buffer);
+    void powerUp() override;
 
     /**
-     * Set backlight brightness (0-255).
+     * True from init() until the panels are up.
      */
-    void setBacklight(Eye eye, uint8_t brightness);
+    bool poweringUp() const override { return m_powering.load(std::memory_order_acquire); }
 
     /**
-     * Fill display with solid color.
+     * SPI clock in use; final once powerUp() has returned.
      */
-    void fill(Eye eye, uint16_t color);
+    uint32_t clockHz() const override { return m_spi_hz.load(std::memory_order_relaxed); }
+
+    /**
+     * CASET/RASET set to the window (skipped when unchanged), then RAMWR.
+     * False before init().
+     */
+    bool begin(unsigned eyes, int x, int y, int w, int h) override;
+    uint16_t *stage(size_t want, size_t &n) override;
+    void commit(size_t n) override;
+    bool end() override;
+
+    /**
+     * Set backlight brightness (0-255).
+     */
+    void setBacklight(Eye eye, uint8_t brightness);
 
 private:
-    bool initDisplay(Eye eye);
-    void selectEye(Eye eye);
-    void sendCommand(uint8_t cmd);
-    void sendData(const uint8_t *data, size_t len);
-    void reset(Eye eye);
+    static int eyeIndex(Eye eye) { return (eye == Eye::LEFT) ? 0 : 1; }
+    static Eye eyeAt(int idx) { return (idx == 0) ? Eye::LEFT : Eye::RIGHT; }
+    static unsigned eyeMask(Eye eye) { return (eye == Eye::LEFT) ? EYE_MASK_LEFT : EYE_MASK_RIGHT; }
+
+    void selectEyes(unsigned eyes);
+    bool sendCommand(uint8_t cmd);
+    bool sendData(const uint8_t *data, size_t len);
+    void queueData(const uint8_t *data, size_t len);
+    bool flushData();
+    void spiFailed();
+    void setWindow(unsigned eyes, int x, int y, int w, int h);
+    void reset(unsigned eyes);
+    bool writePattern(unsigned eye, const uint16_t *pixels);
+    bool readPattern(unsigned eye, uint8_t *out);
+    void calibrateClock();
 
     int m_spi_fd = -1;
+    std::atomic<uint32_t> m_spi_hz;                 // Per transfer; read by status
+    uint32_t m_spi_max_hz;                          // Calibration ceiling
     int m_gpio_dc = -1;
     int m_gpio_cs_left = -1;
     int m_gpio_cs_right = -1;
     int m_gpio_rst_left = -1;
     int m_gpio_rst_right = -1;
+
+    // Expanded pixels of the SPI message being built, m_spi_bufsiz bytes
+    std::vector<uint16_t> m_stage;
+    size_t m_stage_used = 0;                        // Pixels queued from m_stage
+    bool m_region_ok = true;                        // No message of the window failed
+    // Pixel data goes out as few SPI_IOC_MESSAGEs as spidev's bounce buffer
+    // allows: each message carries at most m_spi_bufsiz bytes in total
+    static constexpr int MAX_SEGMENTS = HEIGHT;     // Transfers per message
+    size_t m_spi_bufsiz = 4096;                     // Probed at init()
+    struct spi_ioc_transfer m_segs[MAX_SEGMENTS];
+    int m_seg_count = 0;
+    size_t m_seg_bytes = 0;
+    bool m_spi_error_logged = false;
+
+    // Last CASET/RASET window per eye, so an unchanged window is not resent
+    struct Window {
+        int x = -1;
+        int y = -1;
+        int w = 0;
+        int h = 0;
+    };
+    Window m_window[2];
+
+    std::atomic<bool> m_powering{false};
+    uint64_t m_reset_start_us = 0;                  // RST went low
 };
 
 #endif // GC9D01_DUALEYE_SPI_HPP
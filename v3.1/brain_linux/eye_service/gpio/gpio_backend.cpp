@@ -0,0 +1,42 @@
+#include "gpio_backend.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+GpioBackend *createGpioBackend() {
+    typedef GpioBackend *(*Factory)();
+    struct Candidate {
+        const char *name;
+        Factory create;
+    };
+
+    // Fastest first; mmio has to be asked for
+    const Candidate candidates[] = {
+        {"mmio",    createGpioMmio},
+        {"chardev", createGpioChardev},
+        {"sysfs",   createGpioSysfs},
+    };
+
+    const char *wanted = getenv("EYE_GPIO_BACKEND");
+    if (wanted && *wanted == '\0') {
+        wanted = nullptr;
+    }
+
+    // Requested backend first, then the automatic order
+    for (int pass = 0; pass < 2; pass++) {
+        for (const Candidate &c : candidates) {
+            bool requested = wanted && strcmp(wanted, c.name) == 0;
+            if (pass == 0 && !requested) continue;
+            if (pass == 1 && (requested || strcmp(c.name, "mmio") == 0)) continue;
+
+            GpioBackend *backend = c.create();
+            if (backend->init()) {
+                std::cout << "[GPIO] Using " << backend->name() << " backend" << std::endl;
+                return backend;
+            }
+            std::cerr << "[GPIO] " << c.name << " backend unavailable" << std::endl;
+            delete backend;
+        }
+    }
+    return nullptr;
+}
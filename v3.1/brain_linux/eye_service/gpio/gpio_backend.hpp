@@ -7,7 +7,7 @@
  * GPIO Backend Interface
  *
  * Abstract interface for GPIO control.
- * Implementations: wiringx, gpiod, sysfs
+ * Implementations: mmio (CV181x registers), chardev (GPIO uAPI v2), sysfs
  */
 class GpioBackend {
 public:
@@ -25,7 +25,12 @@ public:
     };
 
     /**
-     * Initialize GPIO subsystem.
+     * Backend name for logs.
+     */
+    virtual const char *name() const = 0;
+
+    /**
+     * Initialize GPIO subsystem. Calling it again once it succeeded is a no-op.
      */
     virtual bool init() = 0;
 
@@ -51,8 +56,16 @@ public:
 };
 
 /**
- * Create platform-specific GPIO backend.
+ * Create the fastest GPIO backend whose init() succeeds, already
+ * initialized: chardev, then sysfs. The EYE_GPIO_BACKEND environment
+ * variable (mmio, chardev or sysfs) puts that backend first; mmio is
+ * only tried when asked for, since it bypasses the kernel's GPIO driver.
  */
 GpioBackend *createGpioBackend();
 
+// Individual backends (not initialized)
+GpioBackend *createGpioMmio();
+GpioBackend *createGpioChardev();
+GpioBackend *createGpioSysfs();
+
 #endif // GPIO_BACKEND_HPP
@@ -0,0 +1,164 @@
+#include "gpio_backend.hpp"
+#include "gpio_chip.hpp"
+#include <linux/gpio.h>
+#include <sys/ioctl.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <cstdio>
+#include <map>
+
+#define GPIO_CONSUMER "eye_service"
+
+/**
+ * GPIO character device backend (uAPI v2, the interface libgpiod v2 wraps).
+ *
+ * Each pin is requested once and its line fd held open, so a write is a
+ * single ioctl instead of the sysfs open/write/close.
+ */
+class GpioChardev : public GpioBackend {
+public:
+    GpioChardev() = default;
+    ~GpioChardev() override { cleanup(); }
+
+    const char *name() const override { return "chardev"; }
+
+    bool init() override {
+        if (initialized_) return true;
+
+        // Kernels before 5.10 only have the v1 uAPI
+        int fd = open("/dev/gpiochip0", O_RDWR | O_CLOEXEC);
+        if (fd < 0) {
+            return false;
+        }
+        struct gpio_v2_line_info info;
+        memset(&info, 0, sizeof(info));
+        bool ok = ioctl(fd, GPIO_V2_GET_LINEINFO_IOCTL, &info) == 0;
+        close(fd);
+
+        initialized_ = ok;
+        return ok;
+    }
+
+    bool configurePin(int pin, Direction dir, Pull pull) override {
+        if (!initialized_) return false;
+
+        GpioLineInfo line;
+        if (!gpioLookupLine(pin, line) || line.chip < 0) {
+            return false;
+        }
+
+        int fd = requestLine(line, dir, pull);
+        if (fd < 0 && errno == EBUSY && releaseSysfsExport(pin)) {
+            // Left exported by an earlier sysfs run
+            fd = requestLine(line, dir, pull);
+        }
+        if (fd < 0) {
+            return false;
+        }
+
+        auto it = lines_.find(pin);
+        if (it != lines_.end()) {
+            close(it->second);
+        }
+        lines_[pin] = fd;
+        return true;
+    }
+
+    bool write(int pin, int value) override {
+        auto it = lines_.find(pin);
+        if (it == lines_.end()) {
+            return false;
+        }
+
+        struct gpio_v2_line_values values;
+        values.bits = (value != 0) ? 1 : 0;
+        values.mask = 1;
+        return ioctl(it->second, GPIO_V2_LINE_SET_VALUES_IOCTL, &values) == 0;
+    }
+
+    int read(int pin) override {
+        auto it = lines_.find(pin);
+        if (it == lines_.end()) {
+            return -1;
+        }
+
+        struct gpio_v2_line_values values;
+        values.bits = 0;
+        values.mask = 1;
+        if (ioctl(it->second, GPIO_V2_LINE_GET_VALUES_IOCTL, &values) != 0) {
+            return -1;
+        }
+        return (values.bits & 1) ? 1 : 0;
+    }
+
+    void cleanup() override {
+        for (auto &entry : lines_) {
+            close(entry.second);
+        }
+        lines_.clear();
+        initialized_ = false;
+    }
+
+private:
+    bool initialized_ = false;
+    std::map<int, int> lines_;      // sysfs pin number -> line request fd
+
+    static int requestLine(const GpioLineInfo &line, Direction dir, Pull pull) {
+        char path[32];
+        snprintf(path, sizeof(path), "/dev/gpiochip%d", line.chip);
+        int chip_fd = open(path, O_RDWR | O_CLOEXEC);
+        if (chip_fd < 0) {
+            return -1;
+        }
+
+        struct gpio_v2_line_request req;
+        memset(&req, 0, sizeof(req));
+        req.offsets[0] = static_cast<__u32>(line.offset);
+        req.num_lines = 1;
+        strncpy(req.consumer, GPIO_CONSUMER, sizeof(req.consumer) - 1);
+
+        if (dir == Direction::OUTPUT) {
+            req.config.flags = GPIO_V2_LINE_FLAG_OUTPUT;
+        } else {
+            req.config.flags = GPIO_V2_LINE_FLAG_INPUT;
+            if (pull == Pull::UP) {
+                req.config.flags |= GPIO_V2_LINE_FLAG_BIAS_PULL_UP;
+            } else if (pull == Pull::DOWN) {
+                req.config.flags |= GPIO_V2_LINE_FLAG_BIAS_PULL_DOWN;
+            }
+        }
+
+        int ret = ioctl(chip_fd, GPIO_V2_GET_LINE_IOCTL, &req);
+        int saved = errno;
+        close(chip_fd);
+        errno = saved;
+
+        return (ret == 0) ? req.fd : -1;
+    }
+
+    static bool releaseSysfsExport(int pin) {
+        char path[64];
+        snprintf(path, sizeof(path), "/sys/class/gpio/gpio%d", pin);
+        if (access(path, F_OK) != 0) {
+            return false;
+        }
+
+        int fd = open("/sys/class/gpio/unexport", O_WRONLY);
+        if (fd < 0) {
+            return false;
+        }
+
+        char buf[16];
+        int len = snprintf(buf, sizeof(buf), "%d", pin);
+        ssize_t written = ::write(fd, buf, len);
+        close(fd);
+
+        return written == len;
+    }
+};
+
+GpioBackend *createGpioChardev() {
+    return new GpioChardev();
+}
@@ -0,0 +1,92 @@
+#include "gpio_chip.hpp"
+#include <dirent.h>
+#include <unistd.h>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+
+#define GPIO_CLASS_DIR "/sys/class/gpio"
+
+static bool readInt(const char *path, int &value) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        return false;
+    }
+    bool ok = fscanf(f, "%d", &value) == 1;
+    fclose(f);
+    return ok;
+}
+
+// Index N of the gpiochipN child under a controller's device directory
+static int findChardevIndex(const char *deviceDir) {
+    DIR *dir = opendir(deviceDir);
+    if (!dir) {
+        return -1;
+    }
+
+    int index = -1;
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != nullptr) {
+        char *end = nullptr;
+        if (strncmp(ent->d_name, "gpiochip", 8) == 0) {
+            long n = strtol(ent->d_name + 8, &end, 10);
+            if (end != ent->d_name + 8 && *end == '\0') {
+                index = static_cast<int>(n);
+                break;
+            }
+        }
+    }
+    closedir(dir);
+    return index;
+}
+
+// ".../3020000.gpio" -> 0x3020000
+static uint64_t parsePhysBase(const char *deviceLink) {
+    char target[256];
+    ssize_t n = readlink(deviceLink, target, sizeof(target) - 1);
+    if (n <= 0) {
+        return 0;
+    }
+    target[n] = '\0';
+
+    const char *name = strrchr(target, '/');
+    name = name ? name + 1 : target;
+
+    char *end = nullptr;
+    unsigned long long base = strtoull(name, &end, 16);
+    if (end == name || *end != '.') {
+        return 0;
+    }
+    return base;
+}
+
+bool gpioLookupLine(int pin, GpioLineInfo &info) {
+    DIR *dir = opendir(GPIO_CLASS_DIR);
+    if (!dir) {
+        return false;
+    }
+
+    bool found = false;
+    struct dirent *ent;
+    while (!found && (ent = readdir(dir)) != nullptr) {
+        if (strncmp(ent->d_name, "gpiochip", 8) != 0) {
+            continue;
+        }
+
+        char path[320];
+        int base = 0, ngpio = 0;
+        snprintf(path, sizeof(path), GPIO_CLASS_DIR "/%s/base", ent->d_name);
+        if (!readInt(path, base)) continue;
+        snprintf(path, sizeof(path), GPIO_CLASS_DIR "/%s/ngpio", ent->d_name);
+        if (!readInt(path, ngpio)) continue;
+        if (pin < base || pin >= base + ngpio) continue;
+
+        snprintf(path, sizeof(path), GPIO_CLASS_DIR "/%s/device", ent->d_name);
+        info.chip = findChardevIndex(path);
+        info.offset = pin - base;
+        info.phys_base = parsePhysBase(path);
+        found = true;
+    }
+    closedir(dir);
+    return found;
+}
@@ -0,0 +1,23 @@
+#ifndef GPIO_CHIP_HPP
+#define GPIO_CHIP_HPP
+
+#include <cstdint>
+
+/**
+ * GPIO chip lookup
+ *
+ * Maps a sysfs GPIO number (as used in PINOUT.md, e.g. 506) to the
+ * controller that owns it, using /sys/class/gpio/gpiochip<base>:
+ * the character device /dev/gpiochipN, the line offset within it, and
+ * the register base parsed from the platform device name
+ * ("3020000.gpio" -> 0x03020000).
+ */
+struct GpioLineInfo {
+    int chip = -1;              // N of /dev/gpiochipN, -1 if not found
+    int offset = -1;            // Line within the chip
+    uint64_t phys_base = 0;     // Controller registers, 0 if unknown
+};
+
+bool gpioLookupLine(int pin, GpioLineInfo &info);
+
+#endif // GPIO_CHIP_HPP
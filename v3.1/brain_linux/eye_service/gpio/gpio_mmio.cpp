@@ -0,0 +1,150 @@
+#include "gpio_backend.hpp"
+#include "gpio_chip.hpp"
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdint>
+#include <map>
+#include <mutex>
+
+// CV181x GPIO controllers (DesignWare APB GPIO, one 32-line port each)
+static const uint64_t kCv181xGpioBases[] = {
+    0x03020000,     // XGPIOA
+    0x03021000,     // XGPIOB
+    0x03022000,     // XGPIOC
+    0x03023000,     // XGPIOD
+    0x05021000,     // PWR_GPIO
+};
+
+#define GPIO_MMIO_MAP_SIZE  0x1000
+
+// DesignWare APB GPIO port A registers (32-bit word offsets)
+#define DW_GPIO_SWPORTA_DR   (0x00 / 4)
+#define DW_GPIO_SWPORTA_DDR  (0x04 / 4)
+#define DW_GPIO_EXT_PORTA    (0x50 / 4)
+
+/**
+ * Direct register backend for the CV181x GPIO block via /dev/mem.
+ *
+ * A write is one load and one store to the data register, no syscall.
+ * Needs root, and the pins must already be muxed to GPIO. The data
+ * register is shared with every other line of the bank, so writes are
+ * read-modify-write: only use this when nothing else (kernel driver or
+ * another process) drives lines of the same banks.
+ */
+class GpioMmio : public GpioBackend {
+public:
+    GpioMmio() = default;
+    ~GpioMmio() override { cleanup(); }
+
+    const char *name() const override { return "mmio"; }
+
+    bool init() override {
+        if (mem_fd_ >= 0) return true;
+        mem_fd_ = open("/dev/mem", O_RDWR | O_SYNC | O_CLOEXEC);
+        return mem_fd_ >= 0;
+    }
+
+    bool configurePin(int pin, Direction dir, Pull /*pull*/) override {
+        if (mem_fd_ < 0) return false;
+
+        GpioLineInfo line;
+        if (!gpioLookupLine(pin, line) || !isKnownBank(line.phys_base) ||
+            line.offset < 0 || line.offset >= 32) {
+            return false;
+        }
+
+        volatile uint32_t *regs = mapBank(line.phys_base);
+        if (!regs) {
+            return false;
+        }
+
+        uint32_t mask = 1u << line.offset;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (dir == Direction::OUTPUT) {
+                regs[DW_GPIO_SWPORTA_DDR] |= mask;
+            } else {
+                regs[DW_GPIO_SWPORTA_DDR] &= ~mask;
+            }
+        }
+
+        pins_[pin] = Line{regs, mask};
+        return true;
+    }
+
+    bool write(int pin, int value) override {
+        auto it = pins_.find(pin);
+        if (it == pins_.end()) {
+            return false;
+        }
+
+        const Line &line = it->second;
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (value != 0) {
+            line.regs[DW_GPIO_SWPORTA_DR] |= line.mask;
+        } else {
+            line.regs[DW_GPIO_SWPORTA_DR] &= ~line.mask;
+        }
+        return true;
+    }
+
+    int read(int pin) override {
+        auto it = pins_.find(pin);
+        if (it == pins_.end()) {
+            return -1;
+        }
+        return (it->second.regs[DW_GPIO_EXT_PORTA] & it->second.mask) ? 1 : 0;
+    }
+
+    void cleanup() override {
+        pins_.clear();
+        for (auto &entry : banks_) {
+            munmap(const_cast<uint32_t *>(entry.second), GPIO_MMIO_MAP_SIZE);
+        }
+        banks_.clear();
+        if (mem_fd_ >= 0) {
+            close(mem_fd_);
+            mem_fd_ = -1;
+        }
+    }
+
+private:
+    struct Line {
+        volatile uint32_t *regs;
+        uint32_t mask;
+    };
+
+    int mem_fd_ = -1;
+    std::mutex mutex_;                                  // Serializes read-modify-write
+    std::map<uint64_t, volatile uint32_t *> banks_;     // Physical base -> mapping
+    std::map<int, Line> pins_;
+
+    static bool isKnownBank(uint64_t base) {
+        for (uint64_t known : kCv181xGpioBases) {
+            if (base == known) return true;
+        }
+        return false;
+    }
+
+    volatile uint32_t *mapBank(uint64_t base) {
+        auto it = banks_.find(base);
+        if (it != banks_.end()) {
+            return it->second;
+        }
+
+        void *p = mmap(nullptr, GPIO_MMIO_MAP_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED,
+                       mem_fd_, static_cast<off_t>(base));
+        if (p == MAP_FAILED) {
+            return nullptr;
+        }
+
+        volatile uint32_t *regs = static_cast<volatile uint32_t *>(p);
+        banks_[base] = regs;
+        return regs;
+    }
+};
+
+GpioBackend *createGpioMmio() {
+    return new GpioMmio();
+}
@@ -10,6 +10,8 @@ public:
     GpioSysfs() = default;
     ~GpioSysfs() override { cleanup(); }
 
+    const char *name() const override { return "sysfs"; }
+
     bool init() override {
         initialized_ = true;
         return true;
@@ -134,6 +136,6 @@ private:
     }
 };
 
-GpioBackend *createGpioBackend() {
+GpioBackend *createGpioSysfs() {
     return new GpioSysfs();
 }
@@ -2,210 +2,587 @@
  * Spider Robot v3.1 - Eye Service (Linux)
  *
  * Standalone service for DualEye display control.
- * Receives events from Brain Daemon via Unix socket.
- * Renders eye animations on two GC9D01 displays via SPI.
+ * Receives events from Brain Daemon via Unix socket: binary packets on
+ * EYE_PACKET_SOCKET_PATH, or JSON lines on EYE_SOCKET_PATH.
+ * Renders eye animations on two GC9D01 displays via SPI, or into a
+ * null or file sink to run and profile the pipeline off the robot
+ * (--sink, --bench).
  */
 
 #include <iostream>
 #include <csignal>
 #include <atomic>
+#include <sys/mman.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/un.h>
-#include <sys/select.h>
+#include <sys/timerfd.h>
+#include <poll.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <cstring>
 #include <cstdlib>
 #include <cstdio>
+#include <cerrno>
+#include <cstdint>
 #include <getopt.h>
+#include <memory>
+#include <string>
+#include <vector>
 
+#include "dual_eye_display.hpp"
+#include "file_sink.hpp"
 #include "gc9d01_dualeye_spi.hpp"
 #include "eye_renderer.hpp"
 #include "eye_animator.hpp"
+#include "eye_clips.hpp"
 
 extern "C" {
 #include "eye_event_protocol.h"
+#include "eye_state_block.h"
+#include "limits.h"
+#include "timebase.h"
 }
 
 #define RX_BUFFER_SIZE 512
-#define BOOT_FRAME_DELAY_US 33333  // ~30 Hz
 
 static std::atomic<bool> g_shutdown{false};
+static bool g_log_events = true;        // Off while --bench replays its script
 
 void signal_handler(int sig) {
     (void)sig;
     g_shutdown.store(true);
 }
 
+/**
+ * Frame clock on a periodic CLOCK_MONOTONIC timerfd. Deadlines are
+ * absolute, so render and transfer time do not stretch the period the way
+ * a sleep after each frame does; a late frame shows up as missed ticks.
+ */
+class FramePacer {
+public:
+    ~FramePacer() {
+        if (m_fd >= 0) close(m_fd);
+    }
+
+    bool start(int fps) {
+        m_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+        if (m_fd < 0) return false;
+
+        m_period_ns = 1000000000L / fps;
+        return arm(m_period_ns);
+    }
+
+    // Stop ticking while there is nothing to animate; resume() restarts
+    void pause() {
+        if (m_running && arm(0)) m_running = false;
+    }
+
+    void resume() {
+        if (!m_running) m_running = arm(m_period_ns);
+    }
+
+    bool running() const { return m_running; }
+
+    int fd() const { return m_fd; }
+
+    // Collect the ticks that have fired; call when fd() is readable
+    uint64_t consume() {
+        uint64_t ticks = 0;
+        if (read(m_fd, &ticks, sizeof(ticks)) != (ssize_t)sizeof(ticks)) {
+            return 0;
+        }
+        if (ticks > 1) m_missed += ticks - 1;
+        return ticks;
+    }
+
+    // Block for the given number of frame periods
+    void wait(int frames = 1) {
+        resume();
+        uint64_t seen = 0;
+        while (seen < (uint64_t)frames && !g_shutdown.load()) {
+            uint64_t ticks = 0;
+            if (read(m_fd, &ticks, sizeof(ticks)) == (ssize_t)sizeof(ticks)) {
+                seen += ticks;
+            } else if (errno != EINTR) {
+                return;
+            }
+        }
+    }
+
+    uint64_t missed() const { return m_missed; }
+
+private:
+    int m_fd = -1;
+    long m_period_ns = 0;
+    bool m_running = false;
+    uint64_t m_missed = 0;
+
+    bool arm(long period_ns) {
+        struct itimerspec spec;
+        memset(&spec, 0, sizeof(spec));
+        spec.it_interval.tv_nsec = period_ns;
+        spec.it_value = spec.it_interval;       // All zero disarms
+        bool ok = timerfd_settime(m_fd, 0, &spec, nullptr) == 0;
+        if (ok) m_running = (period_ns != 0);
+        return ok;
+    }
+};
+
 static bool setNonBlocking(int fd) {
     int flags = fcntl(fd, F_GETFL, 0);
     if (flags < 0) return false;
     return fcntl(fd, F_SETFL, flags | O_NONBLOCK) >= 0;
 }
 
-static void runBootAnimation(EyeRenderer& renderer, EyeAnimator& animator) {
-    std::cout << "[Eye] Running boot animation..." << std::endl;
-
-    animator.setIdleEnabled(false);
-    animator.setMood(EyeRenderer::Mood::SLEEPY);
-    renderer.setBlink(GC9D01DualEyeSpi::Eye::LEFT, 1.0f);
-    renderer.setBlink(GC9D01DualEyeSpi::Eye::RIGHT, 1.0f);
-    renderer.setEyePosition(0.0f, 0.0f);
-    renderer.render();
-    usleep(BOOT_FRAME_DELAY_US * 3);
-
-    for (int i = 0; i <= 15 && !g_shutdown.load(); i++) {
-        float openness = (float)i / 15.0f;
-        renderer.setBlink(GC9D01DualEyeSpi::Eye::LEFT, 1.0f - openness);
-        renderer.setBlink(GC9D01DualEyeSpi::Eye::RIGHT, 1.0f - openness);
-        renderer.render();
-        usleep(BOOT_FRAME_DELAY_US);
-    }
-
-    animator.setMood(EyeRenderer::Mood::NORMAL);
-    renderer.render();
-    usleep(BOOT_FRAME_DELAY_US * 3);
-
-    struct LookStep { float x; float y; int frames; };
-    LookStep lookSequence[] = {
-        { -0.7f,  0.0f, 8 },
-        {  0.7f,  0.0f, 10 },
-        {  0.0f, -0.4f, 8 },
-        {  0.0f,  0.4f, 8 },
-        {  0.0f,  0.0f, 6 },
-    };
+/**
+ * Boot animation, stepped from the frame clock so Brain events are served
+ * while it plays. It starts once the panels are up, and the first Brain
+ * event cuts it short: mood and idle go back to normal and the event
+ * applies on top, so e.g. an ESTOP is not undone when the tour ends.
+ */
+class BootSequence {
+public:
+    bool running() const { return m_stage != Stage::DONE; }
 
-    float curX = 0.0f, curY = 0.0f;
-    for (const auto& step : lookSequence) {
-        if (g_shutdown.load()) return;
-        float startX = curX, startY = curY;
-        for (int f = 1; f <= step.frames && !g_shutdown.load(); f++) {
-            float t = (float)f / step.frames;
-            float smoothT = t * t * (3.0f - 2.0f * t);
-            curX = startX + (step.x - startX) * smoothT;
-            curY = startY + (step.y - startY) * smoothT;
-            renderer.setEyePosition(curX, curY);
-            renderer.render();
-            usleep(BOOT_FRAME_DELAY_US);
-        }
-        usleep(BOOT_FRAME_DELAY_US * 2);
+    void start(EyeAnimator& animator) {
+        std::cout << "[Eye] Running boot animation..." << std::endl;
+        animator.setIdleEnabled(false);
+        animator.setMood(EyeRenderer::Mood::SLEEPY);
+        m_stage = Stage::POWER;
     }
 
-    for (int blink = 0; blink < 2 && !g_shutdown.load(); blink++) {
-        for (int i = 0; i <= 3 && !g_shutdown.load(); i++) {
-            float amt = (float)i / 3.0f;
-            renderer.setBlink(GC9D01DualEyeSpi::Eye::LEFT, amt);
-            renderer.setBlink(GC9D01DualEyeSpi::Eye::RIGHT, amt);
-            renderer.render();
-            usleep(BOOT_FRAME_DELAY_US);
-        }
-        usleep(BOOT_FRAME_DELAY_US * 2);
-        for (int i = 3; i >= 0 && !g_shutdown.load(); i--) {
-            float amt = (float)i / 3.0f;
-            renderer.setBlink(GC9D01DualEyeSpi::Eye::LEFT, amt);
-            renderer.setBlink(GC9D01DualEyeSpi::Eye::RIGHT, amt);
-            renderer.render();
-            usleep(BOOT_FRAME_DELAY_US);
+    // Call once per frame
+    void step(EyeAnimator& animator, const DualEyeDisplay& display) {
+        switch (m_stage) {
+        case Stage::POWER:
+            if (display.poweringUp()) return;
+            animator.play(EYE_CLIP_BOOT_WAKE);
+            m_stage = Stage::WAKE;
+            break;
+        case Stage::WAKE:
+            if (animator.playing()) return;
+            animator.setMood(EyeRenderer::Mood::NORMAL);
+            animator.play(EYE_CLIP_BOOT_LOOK);
+            m_stage = Stage::LOOK;
+            break;
+        case Stage::LOOK:
+            if (animator.playing()) return;
+            finish(animator);
+            std::cout << "[Eye] Boot animation complete" << std::endl;
+            break;
+        case Stage::DONE:
+            break;
         }
-        usleep(BOOT_FRAME_DELAY_US * 3);
     }
 
-    animator.setMood(EyeRenderer::Mood::NORMAL);
-    animator.lookAt(0.0f, 0.0f);
-    animator.setIdleEnabled(true);
-    renderer.render();
-
-    std::cout << "[Eye] Boot animation complete" << std::endl;
-}
+    void finish(EyeAnimator& animator) {
+        if (!running()) return;
+        animator.setMood(EyeRenderer::Mood::NORMAL);
+        animator.setIdleEnabled(true);
+        m_stage = Stage::DONE;
+    }
 
-static void parseAndHandleEvent(const char* json, EyeAnimator& animator, EyeRenderer& renderer) {
-    if (strstr(json, "\"type\":\"mood\"")) {
-        if (strstr(json, "\"mood\":\"angry\"")) {
-            animator.setMood(EyeRenderer::Mood::ANGRY);
-        } else if (strstr(json, "\"mood\":\"happy\"")) {
-            animator.setMood(EyeRenderer::Mood::HAPPY);
-        } else if (strstr(json, "\"mood\":\"sleepy\"")) {
-            animator.setMood(EyeRenderer::Mood::SLEEPY);
-        } else {
-            animator.setMood(EyeRenderer::Mood::NORMAL);
+private:
+    enum class Stage { POWER, WAKE, LOOK, DONE };
+    Stage m_stage = Stage::DONE;
+};
+
+static BootSequence g_boot;
+
+// JSON debug path: the same event as a binary packet would carry
+static bool parseEventJson(const char* json, EyeEventPacket& ev) {
+    static const struct { const char* key; uint8_t type; } types[] = {
+        { "\"type\":\"mood\"",   EYE_EV_MOOD },
+        { "\"type\":\"look\"",   EYE_EV_LOOK },
+        { "\"type\":\"blink\"",  EYE_EV_BLINK },
+        { "\"type\":\"wink\"",   EYE_EV_WINK },
+        { "\"type\":\"color\"",  EYE_EV_COLOR },
+        { "\"type\":\"idle\"",   EYE_EV_IDLE },
+        { "\"type\":\"estop\"",  EYE_EV_ESTOP },
+        { "\"type\":\"status\"", EYE_EV_STATUS },
+    };
+    ev = eye_event_make(EYE_EV_COUNT);
+    for (const auto& t : types) {
+        if (strstr(json, t.key)) {
+            ev.type = t.type;
+            break;
         }
-        std::cout << "[Eye] Mood changed" << std::endl;
-        return;
     }
 
-    if (strstr(json, "\"type\":\"look\"")) {
-        float x = 0.0f, y = 0.0f;
+    switch (ev.type) {
+    case EYE_EV_MOOD:
+        for (uint8_t i = 0; i < EYE_MOOD_ID_COUNT; i++) {
+            char key[32];
+            snprintf(key, sizeof(key), "\"mood\":\"%s\"", eye_mood_name(i));
+            if (strstr(json, key)) ev.mood = i;
+        }
+        break;
+    case EYE_EV_LOOK: {
         const char* px = strstr(json, "\"x\":");
         const char* py = strstr(json, "\"y\":");
-        if (px) x = strtof(px + 4, nullptr);
-        if (py) y = strtof(py + 4, nullptr);
-        animator.lookAt(x, y);
-        return;
+        if (px) ev.x = strtof(px + 4, nullptr);
+        if (py) ev.y = strtof(py + 4, nullptr);
+        break;
     }
+    case EYE_EV_WINK:
+        ev.eye = strstr(json, "\"eye\":\"right\"") ? EYE_ID_RIGHT : EYE_ID_LEFT;
+        break;
+    case EYE_EV_COLOR: {
+        const char* pc = strstr(json, "\"rgb565\":");
+        if (!pc) return false;
+        ev.rgb565 = (uint16_t)strtol(pc + 9, nullptr, 0);
+        break;
+    }
+    case EYE_EV_IDLE:
+        if (strstr(json, "\"enabled\":true")) ev.flags = EYE_FLAG_IDLE_ENABLED;
+        else if (!strstr(json, "\"enabled\":false")) return false;
+        break;
+    default:
+        break;
+    }
+    return ev.type != EYE_EV_COUNT;
+}
 
-    if (strstr(json, "\"type\":\"blink\"")) {
+static void handleEvent(const EyeEventPacket& ev, EyeAnimator& animator) {
+    static const EyeRenderer::Mood moods[EYE_MOOD_ID_COUNT] = {
+        EyeRenderer::Mood::NORMAL, EyeRenderer::Mood::ANGRY,
+        EyeRenderer::Mood::HAPPY, EyeRenderer::Mood::SLEEPY
+    };
+
+    if (ev.type != EYE_EV_STATUS) {
+        g_boot.finish(animator);
+    }
+
+    switch (ev.type) {
+    case EYE_EV_MOOD:
+        animator.setMood(moods[ev.mood < EYE_MOOD_ID_COUNT ? ev.mood : 0]);
+        if (g_log_events) std::cout << "[Eye] Mood changed" << std::endl;
+        break;
+    case EYE_EV_LOOK:
+        animator.lookAt(ev.x, ev.y);
+        break;
+    case EYE_EV_BLINK:
         animator.blink();
-        std::cout << "[Eye] Blink triggered" << std::endl;
-        return;
+        if (g_log_events) std::cout << "[Eye] Blink triggered" << std::endl;
+        break;
+    case EYE_EV_WINK:
+        animator.wink(ev.eye == EYE_ID_RIGHT ? DualEyeDisplay::Eye::RIGHT : DualEyeDisplay::Eye::LEFT);
+        if (g_log_events) std::cout << "[Eye] Wink triggered" << std::endl;
+        break;
+    case EYE_EV_COLOR:
+        animator.setIrisColor(ev.rgb565);
+        if (g_log_events) std::cout << "[Eye] Iris color set to 0x" << std::hex << ev.rgb565 << std::dec << std::endl;
+        break;
+    case EYE_EV_IDLE: {
+        bool enabled = ev.flags & EYE_FLAG_IDLE_ENABLED;
+        animator.setIdleEnabled(enabled);
+        if (g_log_events) std::cout << "[Eye] Idle " << (enabled ? "enabled" : "disabled") << std::endl;
+        break;
+    }
+    case EYE_EV_ESTOP:
+        animator.setMood(EyeRenderer::Mood::SLEEPY);
+        animator.setIdleEnabled(false);
+        if (g_log_events) std::cout << "[Eye] ESTOP - eyes sleepy" << std::endl;
+        break;
+    case EYE_EV_STATUS:
+        // Answered by the main loop, which has the display
+        break;
+    default:
+        break;
     }
+}
 
-    if (strstr(json, "\"type\":\"wink\"")) {
-        if (strstr(json, "\"eye\":\"right\"")) {
-            animator.wink(GC9D01DualEyeSpi::Eye::RIGHT);
-        } else {
-            animator.wink(GC9D01DualEyeSpi::Eye::LEFT);
+/**
+ * Reader side of the Brain's EyeStateBlock (common/eye_state_block.h).
+ */
+class StateBlockReader {
+public:
+    ~StateBlockReader() { detach(); }
+
+    // Takes ownership of fd
+    bool attach(int fd) {
+        detach();
+        struct stat st;
+        void* p = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(EyeStateBlock)) {
+            p = mmap(nullptr, sizeof(EyeStateBlock), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
         }
-        std::cout << "[Eye] Wink triggered" << std::endl;
-        return;
+        close(fd);
+        if (p == MAP_FAILED) return false;
+
+        m_block = (EyeStateBlock*)p;
+        EyeStateData d;
+        if (eye_state_read(m_block, &d) == -1) {
+            detach();
+            return false;
+        }
+        memset(&m_applied, 0, sizeof(m_applied));
+        return true;
     }
 
-    if (strstr(json, "\"type\":\"color\"")) {
-        const char* pc = strstr(json, "\"rgb565\":");
-        if (pc) {
-            uint16_t color = (uint16_t)strtol(pc + 9, nullptr, 0);
-            renderer.setIrisColor(color);
-            std::cout << "[Eye] Iris color set to 0x" << std::hex << color << std::dec << std::endl;
+    void detach() {
+        if (m_block) munmap(m_block, sizeof(EyeStateBlock));
+        m_block = nullptr;
+    }
+
+    bool attached() const { return m_block != nullptr; }
+
+    // Apply fields whose generation moved; true if anything did
+    bool apply(EyeAnimator& animator) {
+        EyeStateData d;
+        if (!m_block || eye_state_read(m_block, &d) != 0) return false;
+
+        bool changed = false;
+        for (int f = 0; f < EYE_STATE_FIELD_COUNT; f++) {
+            if (d.gen[f] == m_applied.gen[f]) continue;
+            EyeEventPacket ev = eye_event_make(EYE_EV_COUNT);
+            switch (f) {
+            case EYE_STATE_LOOK:  ev.type = EYE_EV_LOOK; ev.x = d.look_x; ev.y = d.look_y; break;
+            case EYE_STATE_COLOR: ev.type = EYE_EV_COLOR; ev.rgb565 = d.rgb565; break;
+            case EYE_STATE_MOOD:  ev.type = EYE_EV_MOOD; ev.mood = d.mood; break;
+            case EYE_STATE_IDLE:  ev.type = EYE_EV_IDLE; ev.flags = d.idle ? EYE_FLAG_IDLE_ENABLED : 0; break;
+            case EYE_STATE_BLINK: ev.type = EYE_EV_BLINK; break;
+            }
+            handleEvent(ev, animator);
+            changed = true;
         }
-        return;
+        m_applied = d;
+        return changed;
     }
 
-    if (strstr(json, "\"type\":\"idle\"")) {
-        if (strstr(json, "\"enabled\":true")) {
-            animator.setIdleEnabled(true);
-            std::cout << "[Eye] Idle enabled" << std::endl;
-        } else if (strstr(json, "\"enabled\":false")) {
-            animator.setIdleEnabled(false);
-            std::cout << "[Eye] Idle disabled" << std::endl;
+    // Announce that the frame clock stops, then look once more
+    bool sleep(EyeAnimator& animator) {
+        if (!m_block) return true;
+        if (++m_epoch == 0) m_epoch = 1;
+        EYE_STATE_STORE_RELEASE(&m_block->reader_sleep, m_epoch);
+        EYE_STATE_FENCE();
+        if (apply(animator)) {
+            wake();
+            return false;
         }
-        return;
+        return true;
     }
 
-    if (strstr(json, "\"type\":\"estop\"")) {
-        animator.setMood(EyeRenderer::Mood::SLEEPY);
-        animator.setIdleEnabled(false);
-        std::cout << "[Eye] ESTOP - eyes sleepy" << std::endl;
-        return;
+    void wake() {
+        if (m_block) EYE_STATE_STORE_RELEASE(&m_block->reader_sleep, 0u);
     }
 
-    if (strstr(json, "\"type\":\"status\"")) {
-        std::cout << "[Eye] Status: running" << std::endl;
-        return;
+    // For the Brain's eye status reply
+    void publishStatus(const EyeDisplayStatus& st) {
+        if (m_block) eye_display_status_write(m_block, &st);
     }
+
+private:
+    EyeStateBlock* m_block = nullptr;
+    EyeStateData m_applied;
+    uint32_t m_epoch = 0;
+};
+
+static EyeDisplayStatus displayStatus(DualEyeDisplay& display) {
+    EyeDisplayStatus st;
+    st.spi_hz = display.sink().clockHz();
+    st.frames = (uint32_t)display.framesSent();
+    st.frame_us = display.frameMicros();
+    st.frame_us_avg = display.frameMicrosAvg();
+    st.frame_us_max = display.frameMicrosMax();
+    st.kib_sent = (uint32_t)(display.bytesSent() / 1024);
+    return st;
+}
+
+static void reportStatus(DualEyeDisplay& display, StateBlockReader& state_block) {
+    EyeDisplayStatus st = displayStatus(display);
+    state_block.publishStatus(st);
+    if (g_log_events) {
+        std::cout << "[Eye] Status: running, " << display.sink().name() << " sink at "
+                  << st.spi_hz / 1000 << " kHz, " << st.frames << " frames, "
+                  << st.frame_us << " us/frame (avg " << st.frame_us_avg
+                  << ", max " << st.frame_us_max << ")" << std::endl;
+    }
+}
+
+static int listenUnix(const char* path, int type) {
+    int fd = socket(AF_UNIX, type, 0);
+    if (fd < 0) {
+        std::cerr << "[Eye] Failed to create socket for " << path << std::endl;
+        return -1;
+    }
+
+    unlink(path);
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        std::cerr << "[Eye] Failed to bind " << path << std::endl;
+        close(fd);
+        return -1;
+    }
+
+    if (listen(fd, 2) < 0) {
+        std::cerr << "[Eye] Failed to listen on " << path << std::endl;
+        close(fd);
+        return -1;
+    }
+
+    setNonBlocking(fd);
+    std::cout << "[Eye] Listening on " << path << std::endl;
+    return fd;
+}
+
+// ---- --bench ----
+
+#define BENCH_TAIL_MS   800     // Let the last event's animation finish
+
+struct BenchStep {
+    uint32_t at_ms;
+    EyeEventPacket ev;
+};
+
+// A few seconds of what the Brain sends: gaze moves, blinks, winks, moods
+// and iris fades, with idle off so every run sees the same frames
+static std::vector<BenchStep> benchScript() {
+    std::vector<BenchStep> script;
+    auto at = [&script](uint32_t ms, uint8_t type) -> EyeEventPacket& {
+        script.push_back({ms, eye_event_make(type)});
+        return script.back().ev;
+    };
+    auto look = [&at](uint32_t ms, float x, float y) {
+        EyeEventPacket& ev = at(ms, EYE_EV_LOOK);
+        ev.x = x;
+        ev.y = y;
+    };
+
+    at(0, EYE_EV_IDLE).flags = 0;
+    look(100, -0.8f, 0.0f);
+    look(600, 0.8f, 0.3f);
+    at(1100, EYE_EV_BLINK);
+    at(1500, EYE_EV_COLOR).rgb565 = 0xF800;
+    at(1900, EYE_EV_MOOD).mood = EYE_MOOD_ID_ANGRY;
+    look(2300, 0.0f, -0.6f);
+    at(2800, EYE_EV_WINK).eye = EYE_ID_LEFT;
+    at(3200, EYE_EV_MOOD).mood = EYE_MOOD_ID_HAPPY;
+    at(3600, EYE_EV_COLOR).rgb565 = 0x07E0;
+    look(4000, 0.5f, 0.5f);
+    at(4400, EYE_EV_MOOD).mood = EYE_MOOD_ID_SLEEPY;
+    at(4800, EYE_EV_BLINK);
+    at(5200, EYE_EV_MOOD).mood = EYE_MOOD_ID_NORMAL;
+    look(5400, 0.0f, 0.0f);
+    return script;
+}
+
+/**
+ * Replay benchScript() in real time once per configuration, each turning
+ * on one more of the pipeline's savings, and print what each cost: render
+ * (draw + expand + send, or queue) time per frame, pixel bytes handed to
+ * the sink and the frame rate achieved. fps 0 runs unpaced.
+ */
+static int runBench(DisplaySink& sink, int fps) {
+    struct Config {
+        const char* name;
+        bool full_redraw;       // Every tick draws and sends both eyes whole
+        bool threaded;          // Transfer thread overlaps sending with drawing
+    };
+    static const Config configs[] = {
+        { "full",     true,  false },
+        { "dirty",    false, false },   // Dirty rectangles and shared frames
+        { "threaded", false, true },
+    };
+
+    g_log_events = false;
+    std::vector<BenchStep> script = benchScript();
+    uint32_t end_ms = script.back().at_ms + BENCH_TAIL_MS;
+    char pace[24] = "unpaced";
+    if (fps > 0) snprintf(pace, sizeof(pace), "%d fps", fps);
+    printf("[Eye] Bench: %.1f s script, sink %s, %s\n", end_ms / 1000.0, sink.name(), pace);
+    printf("%-10s %7s %7s %9s %8s %10s %9s %7s\n",
+           "config", "frames", "fps", "ms/frame", "max ms", "KiB sent", "KiB/frm", "missed");
+
+    for (const Config& cfg : configs) {
+        if (g_shutdown.load()) break;
+
+        DualEyeDisplay display(sink);
+        if (cfg.threaded && !display.startTransferThread()) {
+            continue;
+        }
+        display.powerUp();
+        display.waitIdle();
+        EyeRenderer renderer(display);
+        EyeAnimator animator(renderer);
+        FramePacer pacer;
+        if (fps > 0 && !pacer.start(fps)) {
+            std::cerr << "[Eye] Failed to create frame timer: " << strerror(errno) << std::endl;
+            return 1;
+        }
+
+        size_t next = 0;
+        uint64_t frames = 0, render_us = 0, max_us = 0;
+        uint64_t start_us = timebase_micros();
+        while (!g_shutdown.load()) {
+            uint64_t t_ms = (timebase_micros() - start_us) / 1000;
+            if (t_ms >= end_ms) break;
+            while (next < script.size() && script[next].at_ms <= t_ms) {
+                handleEvent(script[next++].ev, animator);
+            }
+            if (cfg.full_redraw) renderer.invalidate();
+
+            uint64_t t0 = timebase_micros();
+            if (animator.tick()) {
+                uint64_t us = timebase_micros() - t0;
+                frames++;
+                render_us += us;
+                if (us > max_us) max_us = us;
+            }
+            if (fps > 0) pacer.consume();
+        }
+        display.waitIdle();
+        double wall_s = (timebase_micros() - start_us) / 1e6;
+
+        double kib = display.bytesSent() / 1024.0;
+        printf("%-10s %7llu %7.1f %9.3f %8.3f %10.1f %9.2f %7llu\n", cfg.name,
+               (unsigned long long)frames, frames / wall_s,
+               frames ? render_us / 1000.0 / frames : 0.0, max_us / 1000.0,
+               kib, frames ? kib / frames : 0.0, (unsigned long long)pacer.missed());
+        fflush(stdout);
+    }
+    return 0;
 }
 
 static void printUsage(const char* progname) {
     std::cout << "Usage: " << progname << " [OPTIONS]\n"
               << "Options:\n"
-              << "  --skip-boot    Skip boot animation\n"
-              << "  --help         Show this help\n";
+              << "  --skip-boot        Skip boot animation\n"
+              << "  --sink SINK        spi (default), null, png:DIR or raw:DIR\n"
+              << "  --dump-every N     File sinks: write every Nth frame (default " << EYE_RENDER_FPS << ")\n"
+              << "  --fps N            Frame rate (default " << EYE_RENDER_FPS << "; 0 = unpaced, --bench only)\n"
+              << "  --spi-hz N         Panel SPI clock (default " << GC9D01DualEyeSpi::SPI_HZ_DEFAULT << ")\n"
+              << "  --spi-max-hz N     Calibrate the clock up to N at power-up (default "
+              << GC9D01DualEyeSpi::SPI_MAX_HZ_DEFAULT << "; 0 = no calibration)\n"
+              << "  --bench            Replay a scripted event timeline and report per-frame\n"
+              << "                     cost for each optimization (default sink: null)\n"
+              << "  --help             Show this help\n";
 }
 
 int main(int argc, char *argv[]) {
     bool skipBoot = false;
+    bool bench = false;
+    const char* sink_arg = nullptr;
+    unsigned dump_every = EYE_RENDER_FPS;
+    int fps = EYE_RENDER_FPS;
+    uint32_t spi_hz = GC9D01DualEyeSpi::SPI_HZ_DEFAULT;
+    uint32_t spi_max_hz = GC9D01DualEyeSpi::SPI_MAX_HZ_DEFAULT;
 
     static struct option long_options[] = {
-        {"skip-boot", no_argument, 0, 's'},
-        {"help",      no_argument, 0, 'h'},
+        {"skip-boot",  no_argument,       0, 's'},
+        {"sink",       required_argument, 0, 'o'},
+        {"dump-every", required_argument, 0, 'd'},
+        {"fps",        required_argument, 0, 'f'},
+        {"spi-hz",     required_argument, 0, 'z'},
+        {"spi-max-hz", required_argument, 0, 'm'},
+        {"bench",      no_argument,       0, 'b'},
+        {"help",       no_argument,       0, 'h'},
         {0, 0, 0, 0}
     };
 
@@ -215,6 +592,24 @@ int main(int argc, char *argv[]) {
             case 's':
                 skipBoot = true;
                 break;
+            case 'o':
+                sink_arg = optarg;
+                break;
+            case 'd':
+                dump_every = (unsigned)atoi(optarg);
+                break;
+            case 'f':
+                fps = atoi(optarg);
+                break;
+            case 'z':
+                spi_hz = (uint32_t)strtoul(optarg, nullptr, 0);
+                break;
+            case 'm':
+                spi_max_hz = (uint32_t)strtoul(optarg, nullptr, 0);
+                break;
+            case 'b':
+                bench = true;
+                break;
             case 'h':
                 printUsage(argv[0]);
                 return 0;
@@ -224,72 +619,157 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    if (fps < 0 || (fps == 0 && !bench) || spi_hz == 0) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
     std::cout << "[Eye] Spider Robot v3.1 Eye Service starting..." << std::endl;
 
     std::signal(SIGINT, signal_handler);
     std::signal(SIGTERM, signal_handler);
 
-    GC9D01DualEyeSpi display;
-    if (!display.init()) {
-        std::cerr << "[Eye] Failed to initialize display" << std::endl;
+    // Where frames go: the panels, or somewhere that needs no hardware
+    std::string sink_name = sink_arg ? sink_arg : (bench ? "null" : "spi");
+    std::unique_ptr<DisplaySink> sink;
+    if (sink_name == "spi") {
+        auto panels = std::make_unique<GC9D01DualEyeSpi>();
+        panels->setSpiClock(spi_hz, spi_max_hz);
+        if (!panels->init()) {
+            std::cerr << "[Eye] Failed to initialize display" << std::endl;
+            return 1;
+        }
+        sink = std::move(panels);
+    } else if (sink_name == "null") {
+        sink = std::make_unique<NullSink>();
+    } else if (sink_name.compare(0, 4, "png:") == 0 || sink_name.compare(0, 4, "raw:") == 0) {
+        FileSink::Format format = sink_name[0] == 'p' ? FileSink::Format::PNG : FileSink::Format::RAW;
+        sink = std::make_unique<FileSink>(sink_name.substr(4), format, dump_every);
+    } else {
+        printUsage(argv[0]);
         return 1;
     }
 
-    EyeRenderer renderer(display);
-    EyeAnimator animator(renderer);
+    if (bench) {
+        return runBench(*sink, fps);
+    }
 
-    if (!skipBoot) {
-        runBootAnimation(renderer, animator);
+    DualEyeDisplay display(*sink);
+
+    // Frame N streams from the front buffers while frame N+1 is rendered.
+    // The thread powers the panels up first, so startup does not wait for it
+    if (!display.startTransferThread()) {
+        std::cerr << "[Eye] Transfer thread unavailable, sending inline" << std::endl;
+        display.powerUp();
     }
 
-    int server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
-    if (server_fd < 0) {
-        std::cerr << "[Eye] Failed to create socket" << std::endl;
+    FramePacer pacer;
+    if (!pacer.start(fps)) {
+        std::cerr << "[Eye] Failed to create frame timer: " << strerror(errno) << std::endl;
         return 1;
     }
 
-    unlink(EYE_SOCKET_PATH);
-
-    struct sockaddr_un addr;
-    memset(&addr, 0, sizeof(addr));
-    addr.sun_family = AF_UNIX;
-    strncpy(addr.sun_path, EYE_SOCKET_PATH, sizeof(addr.sun_path) - 1);
+    EyeRenderer renderer(display);
+    EyeAnimator animator(renderer);
 
-    if (bind(server_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
-        std::cerr << "[Eye] Failed to bind socket" << std::endl;
-        close(server_fd);
+    // Listen while the panels power up and the boot animation plays
+    int server_fd = listenUnix(EYE_SOCKET_PATH, SOCK_STREAM);
+    int packet_fd = listenUnix(EYE_PACKET_SOCKET_PATH, SOCK_SEQPACKET);
+    if (server_fd < 0 && packet_fd < 0) {
         return 1;
     }
 
-    if (listen(server_fd, 2) < 0) {
-        std::cerr << "[Eye] Failed to listen" << std::endl;
-        close(server_fd);
-        return 1;
+    if (!skipBoot) {
+        g_boot.start(animator);
     }
 
-    setNonBlocking(server_fd);
-    std::cout << "[Eye] Listening on " << EYE_SOCKET_PATH << std::endl;
-
     int client_fd = -1;
+    bool client_binary = false;
+    StateBlockReader state_block;
+    uint64_t published_frames = 0;
     char rx_buffer[RX_BUFFER_SIZE];
     size_t rx_len = 0;
 
     while (!g_shutdown.load()) {
+        // Sleep until the next frame deadline or socket activity.
+        // One Brain at a time, on whichever socket it picked
+        struct pollfd fds[3];
+        fds[0].fd = pacer.fd();
+        fds[0].events = POLLIN;
+        fds[1].fd = (client_fd >= 0) ? client_fd : server_fd;
+        fds[1].events = POLLIN;
+        fds[2].fd = (client_fd >= 0) ? -1 : packet_fd;
+        fds[2].events = POLLIN;
+        fds[1].revents = fds[2].revents = 0;
+
+        int ready = poll(fds, 3, -1);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "[Eye] poll error: " << strerror(errno) << std::endl;
+            break;
+        }
+
         // Accept new client if none connected
-        if (client_fd < 0) {
-            struct sockaddr_un client_addr;
-            socklen_t client_len = sizeof(client_addr);
-            int new_fd = accept(server_fd, (struct sockaddr*)&client_addr, &client_len);
+        if (client_fd < 0 && ((fds[1].revents | fds[2].revents) & POLLIN)) {
+            client_binary = (fds[2].revents & POLLIN) != 0;
+            int new_fd = accept(client_binary ? packet_fd : server_fd, nullptr, nullptr);
             if (new_fd >= 0) {
                 setNonBlocking(new_fd);
                 client_fd = new_fd;
                 rx_len = 0;
-                std::cout << "[Eye] Brain connected" << std::endl;
+                std::cout << "[Eye] Brain connected (" << (client_binary ? "binary" : "JSON") << ")" << std::endl;
             }
-        }
-
-        // Read and process events from client
-        if (client_fd >= 0) {
+        } else if (client_fd >= 0 && client_binary && (fds[1].revents & (POLLIN | POLLHUP | POLLERR))) {
+            // One event per datagram; only the hello carries an fd
+            EyeEventPacket ev;
+            ssize_t n;
+            for (;;) {
+                struct iovec iov = { &ev, sizeof(ev) };
+                union {
+                    char buf[CMSG_SPACE(sizeof(int))];
+                    struct cmsghdr align;
+                } ctrl;
+                struct msghdr msg = {};
+                msg.msg_iov = &iov;
+                msg.msg_iovlen = 1;
+                msg.msg_control = ctrl.buf;
+                msg.msg_controllen = sizeof(ctrl.buf);
+                n = recvmsg(client_fd, &msg, MSG_CMSG_CLOEXEC);
+                if (n <= 0) break;
+
+                int fd = -1;
+                struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+                if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+                    memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+                }
+                bool valid = n == (ssize_t)sizeof(ev) && ev.magic == EYE_PACKET_MAGIC;
+                if (valid && ev.type == EYE_EV_HELLO) {
+                    // Answer with our version; the Brain falls back to JSON on a mismatch
+                    EyeEventPacket hello = eye_event_make(EYE_EV_HELLO);
+                    if (fd >= 0 && (ev.flags & EYE_HELLO_FLAG_STATE_BLOCK) && state_block.attach(fd)) {
+                        hello.flags = EYE_HELLO_FLAG_STATE_BLOCK;
+                        std::cout << "[Eye] Reading state from shared memory" << std::endl;
+                    } else if (fd >= 0) {
+                        close(fd);
+                    }
+                    fd = -1;
+                    send(client_fd, &hello, sizeof(hello), MSG_NOSIGNAL);
+                } else if (valid && ev.version == EYE_PACKET_VERSION) {
+                    if (ev.type == EYE_EV_STATUS) reportStatus(display, state_block);
+                    if (ev.type != EYE_EV_WAKE) handleEvent(ev, animator);
+                    state_block.wake();
+                    pacer.resume();
+                }
+                if (fd >= 0) close(fd);
+            }
+            if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+                std::cout << "[Eye] Brain disconnected" << std::endl;
+                state_block.detach();
+                close(client_fd);
+                client_fd = -1;
+            }
+        } else if (client_fd >= 0 && (fds[1].revents & (POLLIN | POLLHUP | POLLERR))) {
+            // Read and process events from client
             ssize_t n = recv(client_fd, rx_buffer + rx_len, sizeof(rx_buffer) - rx_len - 1, 0);
             if (n > 0) {
                 rx_len += n;
@@ -300,8 +780,11 @@ int main(int argc, char *argv[]) {
                 char* newline;
                 while ((newline = strchr(line_start, '\n')) != nullptr) {
                     *newline = '\0';
-                    if (strlen(line_start) > 0) {
-                        parseAndHandleEvent(line_start, animator, renderer);
+                    EyeEventPacket ev;
+                    if (strlen(line_start) > 0 && parseEventJson(line_start, ev)) {
+                        if (ev.type == EYE_EV_STATUS) reportStatus(display, state_block);
+                        handleEvent(ev, animator);
+                        pacer.resume();
                     }
                     line_start = newline + 1;
                 }
@@ -325,17 +808,38 @@ int main(int argc, char *argv[]) {
             }
         }
 
-        animator.tick();
-        usleep(33333);  // ~30 Hz
+        // One frame per deadline; if we fell behind, skip rather than catch up.
+        // A tick with no visible change renders and sends nothing, and once
+        // nothing is left to animate the clock stops until the next event.
+        if ((fds[0].revents & POLLIN) && pacer.consume() > 0) {
+            state_block.apply(animator);
+            g_boot.step(animator, display);
+            animator.tick();
+            if (display.framesSent() != published_frames) {
+                published_frames = display.framesSent();
+                state_block.publishStatus(displayStatus(display));
+            }
+            if (!animator.isActive() && !renderer.needsRender() && !g_boot.running() &&
+                state_block.sleep(animator)) {
+                pacer.pause();
+            }
+        }
     }
 
-    std::cout << "[Eye] Shutting down..." << std::endl;
+    std::cout << "[Eye] Shutting down (" << pacer.missed() << " frames missed)..." << std::endl;
+    display.stopTransferThread();
 
     if (client_fd >= 0) {
         close(client_fd);
     }
-    close(server_fd);
-    unlink(EYE_SOCKET_PATH);
+    if (server_fd >= 0) {
+        close(server_fd);
+        unlink(EYE_SOCKET_PATH);
+    }
+    if (packet_fd >= 0) {
+        close(packet_fd);
+        unlink(EYE_PACKET_SOCKET_PATH);
+    }
 
     return 0;
 }
@@ -0,0 +1,102 @@
+/**
+ * RGB565 Kernels - portable implementations and runtime selection
+ */
+
+#include "rgb565_kernels.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#if defined(__linux__) && defined(__riscv)
+#include <sys/auxv.h>
+#endif
+
+// Four pixels per 64-bit word; the C906 has no unaligned fast path, so
+// the head is stored pixel by pixel up to an 8-byte boundary
+static void scalarFill(uint16_t *dst, uint16_t value, size_t n) {
+    while (n > 0 && (reinterpret_cast<uintptr_t>(dst) & 7) != 0) {
+        *dst++ = value;
+        n--;
+    }
+
+    uint64_t word = value * 0x0001000100010001ULL;
+    for (; n >= 4; n -= 4, dst += 4) {
+        std::memcpy(dst, &word, sizeof(word));
+    }
+
+    while (n-- > 0) {
+        *dst++ = value;
+    }
+}
+
+static void scalarFillMasked(uint16_t *dst, uint16_t value, const uint8_t *mask, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        dst[i] = mask[i] ? value : dst[i];
+    }
+}
+
+static void scalarByteSwap(uint16_t *dst, const uint16_t *src, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        uint64_t word;
+        std::memcpy(&word, src + i, sizeof(word));
+        word = ((word & 0x00FF00FF00FF00FFULL) << 8) | ((word >> 8) & 0x00FF00FF00FF00FFULL);
+        std::memcpy(dst + i, &word, sizeof(word));
+    }
+    for (; i < n; i++) {
+        dst[i] = static_cast<uint16_t>((src[i] << 8) | (src[i] >> 8));
+    }
+}
+
+// Four lookups per 64-bit store; the loads are what it costs
+static void scalarExpand(uint16_t *dst, const uint8_t *src, const uint16_t *lut, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        uint16_t px[4] = {lut[src[i]], lut[src[i + 1]], lut[src[i + 2]], lut[src[i + 3]]};
+        std::memcpy(dst + i, px, sizeof(px));
+    }
+    for (; i < n; i++) {
+        dst[i] = lut[src[i]];
+    }
+}
+
+static const Rgb565Kernels s_scalar = {
+    "scalar",
+    scalarFill,
+    scalarFillMasked,
+    scalarByteSwap,
+    scalarExpand,
+};
+
+static bool cpuHasVector() {
+#if defined(__linux__) && defined(__riscv)
+    // Single-letter extensions are bits of AT_HWCAP ('A' = bit 0)
+    return (getauxval(AT_HWCAP) & (1UL << ('V' - 'A'))) != 0;
+#else
+    return false;
+#endif
+}
+
+const Rgb565Kernels &rgb565ScalarKernels() {
+    return s_scalar;
+}
+
+const Rgb565Kernels *rgb565VectorKernels() {
+    const Rgb565Kernels *rvv = rgb565RvvKernelsIfBuilt();
+    return (rvv && cpuHasVector()) ? rvv : nullptr;
+}
+
+static const Rgb565Kernels &selectKernels() {
+    const char *forced = getenv("EYE_PIXEL_KERNELS");
+    const Rgb565Kernels *vec = rgb565VectorKernels();
+
+    const Rgb565Kernels &chosen = (vec && !(forced && strcmp(forced, "scalar") == 0)) ? *vec : s_scalar;
+    std::cout << "[Eye] Pixel kernels: " << chosen.name << std::endl;
+    return chosen;
+}
+
+const Rgb565Kernels &rgb565Kernels() {
+    static const Rgb565Kernels &kernels = selectKernels();
+    return kernels;
+}
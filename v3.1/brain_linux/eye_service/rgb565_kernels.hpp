@@ -0,0 +1,48 @@
+#ifndef RGB565_KERNELS_HPP
+#define RGB565_KERNELS_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * RGB565 span kernels for the eye renderer
+ *
+ * Solid fill, masked fill and byte swap over runs of 16-bit pixels, and
+ * the palette lookup that turns 8-bit indexed pixels into them. A
+ * portable scalar set (word-at-a-time) is always built. An RVV set is
+ * built when rgb565_kernels_rvv.cpp is compiled for the vector extension
+ * (EYE_RVV_KERNELS) and used only if the CPU reports V in AT_HWCAP.
+ * Set EYE_PIXEL_KERNELS=scalar to force the portable set.
+ */
+struct Rgb565Kernels {
+    const char *name;
+
+    // dst[0..n) = value
+    void (*fill)(uint16_t *dst, uint16_t value, size_t n);
+
+    // dst[i] = value where mask[i] != 0
+    void (*fillMasked)(uint16_t *dst, uint16_t value, const uint8_t *mask, size_t n);
+
+    // dst[i] = src[i] with its two bytes exchanged (dst may equal src)
+    void (*byteSwap)(uint16_t *dst, const uint16_t *src, size_t n);
+
+    // dst[i] = lut[src[i]], lut holding 256 entries
+    void (*expand)(uint16_t *dst, const uint8_t *src, const uint16_t *lut, size_t n);
+};
+
+/**
+ * The set in use: the fastest one this build and CPU support.
+ */
+const Rgb565Kernels &rgb565Kernels();
+
+/**
+ * Individual sets, for benchmarks. The vector set is nullptr when it was
+ * not built or the CPU cannot run it.
+ */
+const Rgb565Kernels &rgb565ScalarKernels();
+const Rgb565Kernels *rgb565VectorKernels();
+
+// Defined in rgb565_kernels_rvv.cpp; nullptr unless built for RVV
+const Rgb565Kernels *rgb565RvvKernelsIfBuilt();
+
+#endif // RGB565_KERNELS_HPP
@@ -0,0 +1,92 @@
+/**
+ * RGB565 Kernels - RISC-V Vector implementations
+ *
+ * Built for RVV when the compiler targets it (EYE_RVV_KERNELS, see
+ * CMakeLists.txt), otherwise this file only reports that the set is
+ * missing. Uses LMUL=8 so one vsetvl covers as many pixels as the
+ * hardware allows per instruction group.
+ */
+
+#include "rgb565_kernels.hpp"
+
+#if defined(__riscv_vector)
+
+#include <riscv_vector.h>
+
+// Intrinsics gained the __riscv_ prefix in v0.11; older toolchains
+// (including the vendor RVV 0.7.1 one) only have the bare names
+#if defined(__riscv_v_intrinsic) && __riscv_v_intrinsic >= 11000
+#define RVV(name) __riscv_##name
+#else
+#define RVV(name) name
+#endif
+
+static void rvvFill(uint16_t *dst, uint16_t value, size_t n) {
+    vuint16m8_t v = RVV(vmv_v_x_u16m8)(value, RVV(vsetvlmax_e16m8)());
+    while (n > 0) {
+        size_t vl = RVV(vsetvl_e16m8)(n);
+        RVV(vse16_v_u16m8)(dst, v, vl);
+        dst += vl;
+        n -= vl;
+    }
+}
+
+static void rvvFillMasked(uint16_t *dst, uint16_t value, const uint8_t *mask, size_t n) {
+    vuint16m8_t v = RVV(vmv_v_x_u16m8)(value, RVV(vsetvlmax_e16m8)());
+    while (n > 0) {
+        // e8m4 has the same element count as e16m8
+        size_t vl = RVV(vsetvl_e8m4)(n);
+        vuint8m4_t m = RVV(vle8_v_u8m4)(mask, vl);
+        vbool2_t sel = RVV(vmsne_vx_u8m4_b2)(m, 0, vl);
+        RVV(vse16_v_u16m8_m)(sel, dst, v, vl);
+        dst += vl;
+        mask += vl;
+        n -= vl;
+    }
+}
+
+static void rvvByteSwap(uint16_t *dst, const uint16_t *src, size_t n) {
+    while (n > 0) {
+        size_t vl = RVV(vsetvl_e16m8)(n);
+        vuint16m8_t x = RVV(vle16_v_u16m8)(src, vl);
+        vuint16m8_t hi = RVV(vsll_vx_u16m8)(x, 8, vl);
+        vuint16m8_t lo = RVV(vsrl_vx_u16m8)(x, 8, vl);
+        RVV(vse16_v_u16m8)(dst, RVV(vor_vv_u16m8)(hi, lo, vl), vl);
+        src += vl;
+        dst += vl;
+        n -= vl;
+    }
+}
+
+// Indices widened to byte offsets, then one indexed load from the LUT
+static void rvvExpand(uint16_t *dst, const uint8_t *src, const uint16_t *lut, size_t n) {
+    while (n > 0) {
+        size_t vl = RVV(vsetvl_e8m4)(n);
+        vuint8m4_t idx = RVV(vle8_v_u8m4)(src, vl);
+        vuint16m8_t off = RVV(vsll_vx_u16m8)(RVV(vzext_vf2_u16m8)(idx, vl), 1, vl);
+        RVV(vse16_v_u16m8)(dst, RVV(vluxei16_v_u16m8)(lut, off, vl), vl);
+        src += vl;
+        dst += vl;
+        n -= vl;
+    }
+}
+
+static const Rgb565Kernels s_rvv = {
+    "rvv",
+    rvvFill,
+    rvvFillMasked,
+    rvvByteSwap,
+    rvvExpand,
+};
+
+const Rgb565Kernels *rgb565RvvKernelsIfBuilt() {
+    return &s_rvv;
+}
+
+#else
+
+const Rgb565Kernels *rgb565RvvKernelsIfBuilt() {
+    return nullptr;
+}
+
+#endif
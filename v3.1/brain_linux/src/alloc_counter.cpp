@@ -0,0 +1,49 @@
+/**
+ * Spider Robot v3.1 - Heap Allocation Counter Implementation
+ *
+ * Only the daemon links this; the tests and benchmarks keep their own
+ * allocators.
+ */
+
+#include "alloc_counter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<uint64_t> g_allocs{0};
+static thread_local uint64_t t_allocs = 0;
+
+uint64_t alloc_count() {
+    return g_allocs.load(std::memory_order_relaxed);
+}
+
+uint64_t alloc_count_thread() {
+    return t_allocs;
+}
+
+void* operator new(size_t size) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    t_allocs++;
+    if (void* p = malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    t_allocs++;
+    return malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept {
+    return operator new(size, tag);
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
@@ -0,0 +1,26 @@
+/**
+ * Spider Robot v3.1 - Heap Allocation Counter
+ *
+ * The daemon replaces the global operator new with one that counts
+ * calls, so /metrics can show whether steady-state command handling
+ * reaches the heap (bench/ws_loadgen --metrics reports it per command).
+ * One relaxed atomic add per allocation, from any thread, plus a
+ * thread-local count for attributing allocations to code (CpuScope).
+ */
+
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include <cstdint>
+
+/**
+ * operator new / new[] calls since the process started.
+ */
+uint64_t alloc_count();
+
+/**
+ * operator new / new[] calls made by the calling thread.
+ */
+uint64_t alloc_count_thread();
+
+#endif // ALLOC_COUNTER_H
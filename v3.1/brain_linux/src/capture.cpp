@@ -0,0 +1,250 @@
+/**
+ * Spider Robot v3.1 - Command Capture Implementation
+ */
+
+#include "capture.h"
+#include "logger.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static const char* TAG = "Capture";
+
+#define CAPTURE_HDR_BYTES   sizeof(CaptureRecordHeader)
+
+static inline size_t align8(size_t n) {
+    return (n + 7) & ~(size_t)7;
+}
+
+const char* capture_kind_name(uint8_t kind) {
+    static const char* const names[CAPTURE_KIND_COUNT] = {
+        "pad", "ws_text", "ws_binary", "serial_rx", "pose_tx"
+    };
+    return kind < CAPTURE_KIND_COUNT ? names[kind] : "unknown";
+}
+
+// ---- Recorder ----
+
+CaptureRecorder::~CaptureRecorder() {
+    close();
+}
+
+bool CaptureRecorder::open(const char* path, size_t capacity) {
+    close();
+
+    capacity &= ~(size_t)7;
+    if (capacity < CAPTURE_MIN_BYTES) {
+        capacity = CAPTURE_MIN_BYTES;
+    }
+    size_t total = sizeof(CaptureFileHeader) + capacity;
+
+    int fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        LOG_ERROR(TAG, "Cannot create %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    // Reserve the blocks now: a full disk must fail here, not as SIGBUS mid-session
+    int err = posix_fallocate(fd, 0, (off_t)total);
+    if (err != 0) {
+        LOG_ERROR(TAG, "Cannot allocate %zu bytes for %s: %s", total, path, strerror(err));
+        ::close(fd);
+        return false;
+    }
+
+    void* ptr = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (ptr == MAP_FAILED) {
+        LOG_ERROR(TAG, "mmap %s failed: %s", path, strerror(errno));
+        return false;
+    }
+
+    m_map = ptr;
+    m_map_len = total;
+    m_hdr = (CaptureFileHeader*)ptr;
+    m_area = (uint8_t*)ptr + sizeof(CaptureFileHeader);
+
+    memset(m_hdr, 0, sizeof(*m_hdr));
+    m_hdr->version = CAPTURE_VERSION;
+    m_hdr->header_size = sizeof(CaptureFileHeader);
+    m_hdr->capacity = capacity;
+    // Magic last: a reader never takes a half-written header for a capture
+    __atomic_store_n(&m_hdr->magic, CAPTURE_MAGIC, __ATOMIC_RELEASE);
+
+    LOG_INFO(TAG, "Recording to %s (%zu KB, rotating)", path, capacity / 1024);
+    return true;
+}
+
+void CaptureRecorder::close() {
+    if (m_map) {
+        msync(m_map, m_map_len, MS_ASYNC);
+        munmap(m_map, m_map_len);
+    }
+    m_map = nullptr;
+    m_map_len = 0;
+    m_hdr = nullptr;
+    m_area = nullptr;
+}
+
+/**
+ * Drop the oldest record (or the skipped end of the area) from the log.
+ */
+void CaptureRecorder::advanceTail() {
+    uint64_t cap = m_hdr->capacity;
+    uint64_t pos = m_hdr->tail % cap;
+    if (cap - pos < CAPTURE_HDR_BYTES) {
+        m_hdr->tail += cap - pos;
+        return;
+    }
+    const CaptureRecordHeader* rec = (const CaptureRecordHeader*)(m_area + pos);
+    m_hdr->tail += rec->size;
+}
+
+bool CaptureRecorder::record(CaptureKind kind, uint16_t source, uint64_t t_us,
+                             const void* data, size_t len) {
+    if (!m_hdr) return false;
+
+    uint64_t cap = m_hdr->capacity;
+    size_t size = align8(CAPTURE_HDR_BYTES + len);
+    if (size > cap) {
+        m_hdr->dropped++;
+        return false;
+    }
+
+    uint64_t head = m_hdr->head;
+    uint64_t pos = head % cap;
+    uint64_t skip = (cap - pos < size) ? cap - pos : 0;
+
+    // Make room first, while the headers being stepped over are intact
+    while (m_hdr->tail < head && head + skip + size - m_hdr->tail > cap) {
+        advanceTail();
+    }
+
+    if (head + skip + size - m_hdr->tail > cap) {
+        // Over half the area: the record overlaps even the skipped end
+        m_hdr->tail = head + skip;
+    } else if (skip >= CAPTURE_HDR_BYTES) {
+        CaptureRecordHeader* pad = (CaptureRecordHeader*)(m_area + pos);
+        memset(pad, 0, CAPTURE_HDR_BYTES);
+        pad->size = (uint32_t)skip;
+        pad->kind = CAPTURE_PAD;
+    }
+    head += skip;
+    pos = head % cap;
+
+    CaptureRecordHeader* rec = (CaptureRecordHeader*)(m_area + pos);
+    rec->size = (uint32_t)size;
+    rec->len = (uint32_t)len;
+    rec->t_us = t_us;
+    rec->kind = kind;
+    rec->reserved0 = 0;
+    rec->source = source;
+    rec->reserved1 = 0;
+    if (len) {
+        memcpy(rec + 1, data, len);
+    }
+
+    m_hdr->records++;
+    __atomic_store_n(&m_hdr->head, head + size, __ATOMIC_RELEASE);
+    if (m_hdr->start_us == 0) {
+        m_hdr->start_us = t_us;
+    }
+    return true;
+}
+
+// ---- Reader ----
+
+CaptureReader::~CaptureReader() {
+    close();
+}
+
+bool CaptureReader::open(const char* path) {
+    close();
+
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        LOG_ERROR(TAG, "Cannot open %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(CaptureFileHeader)) {
+        LOG_ERROR(TAG, "%s is not a capture", path);
+        ::close(fd);
+        return false;
+    }
+
+    void* ptr = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (ptr == MAP_FAILED) {
+        LOG_ERROR(TAG, "mmap %s failed: %s", path, strerror(errno));
+        return false;
+    }
+
+    m_map = ptr;
+    m_map_len = (size_t)st.st_size;
+    const CaptureFileHeader* hdr = (const CaptureFileHeader*)ptr;
+    if (hdr->magic != CAPTURE_MAGIC || hdr->version != CAPTURE_VERSION ||
+        hdr->header_size != sizeof(CaptureFileHeader) || hdr->capacity % 8 != 0 ||
+        hdr->capacity < CAPTURE_MIN_BYTES ||
+        hdr->capacity > m_map_len - sizeof(CaptureFileHeader) ||
+        hdr->tail > hdr->head || hdr->head - hdr->tail > hdr->capacity) {
+        LOG_ERROR(TAG, "%s failed validation", path);
+        close();
+        return false;
+    }
+
+    m_hdr = hdr;
+    m_area = (const uint8_t*)ptr + sizeof(CaptureFileHeader);
+    rewind();
+    return true;
+}
+
+void CaptureReader::close() {
+    if (m_map) {
+        munmap(m_map, m_map_len);
+    }
+    m_map = nullptr;
+    m_map_len = 0;
+    m_hdr = nullptr;
+    m_area = nullptr;
+    m_pos = 0;
+    m_corrupt = false;
+}
+
+bool CaptureReader::next(CaptureRecordView& out) {
+    if (!m_hdr) return false;
+
+    uint64_t cap = m_hdr->capacity;
+    uint64_t head = __atomic_load_n(&m_hdr->head, __ATOMIC_ACQUIRE);
+    while (m_pos < head) {
+        uint64_t pos = m_pos % cap;
+        if (cap - pos < CAPTURE_HDR_BYTES) {
+            m_pos += cap - pos;
+            continue;
+        }
+
+        const CaptureRecordHeader* rec = (const CaptureRecordHeader*)(m_area + pos);
+        if (rec->size < CAPTURE_HDR_BYTES || rec->size % 8 != 0 || rec->size > cap - pos ||
+            rec->size > head - m_pos ||
+            (rec->kind != CAPTURE_PAD && CAPTURE_HDR_BYTES + (uint64_t)rec->len > rec->size)) {
+            m_corrupt = true;
+            m_pos = head;
+            return false;
+        }
+        m_pos += rec->size;
+        if (rec->kind == CAPTURE_PAD) continue;
+
+        out.kind = rec->kind;
+        out.source = rec->source;
+        out.t_us = rec->t_us;
+        out.data = (const uint8_t*)(rec + 1);
+        out.len = rec->len;
+        return true;
+    }
+    return false;
+}
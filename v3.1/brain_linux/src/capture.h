@@ -0,0 +1,169 @@
+/**
+ * Spider Robot v3.1 - Command Capture
+ *
+ * Records what the daemon receives (WebSocket messages, raw serial input)
+ * and the PosePacket31s it writes to the ring, each stamped with
+ * timebase_micros(), so a field session can be replayed with its exact
+ * input timing (bench/capture_replay).
+ *
+ * The capture is a file of fixed size, preallocated and mapped shared,
+ * used as a rotating log: once it is full the oldest records are
+ * overwritten. Records reach the page cache as they are written, so a
+ * capture survives the daemon crashing or being killed.
+ *
+ * Layout (little-endian, read on the host that wrote it):
+ * ┌────────────────────────────────────────┐
+ * │ CaptureFileHeader (64 bytes)           │
+ * ├────────────────────────────────────────┤
+ * │ Record area (capacity bytes)           │
+ * └────────────────────────────────────────┘
+ *
+ * Positions count bytes since recording began; a record at position p
+ * starts at p % capacity in the area. Each record is a
+ * CaptureRecordHeader and its payload, padded to 8 bytes, and never
+ * wraps: the rest of the area is skipped instead, as a CAPTURE_PAD
+ * record or, when less than a header is left, implicitly.
+ */
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <cstddef>
+#include <cstdint>
+
+extern "C" {
+#include "protocol_posepacket31.h"
+}
+
+#define CAPTURE_MAGIC           0x50414353  // "SCAP"
+#define CAPTURE_VERSION         0x0100      // v1.0
+#define CAPTURE_DEFAULT_BYTES   (16u << 20)
+#define CAPTURE_MIN_BYTES       4096
+
+enum CaptureKind : uint8_t {
+    CAPTURE_PAD = 0,            // Skipped to the end of the area
+    CAPTURE_WS_TEXT = 1,        // Text message, source = client fd
+    CAPTURE_WS_BINARY = 2,      // Binary message (pose frame), source = client fd
+    CAPTURE_SERIAL_RX = 3,      // Bytes as read from the serial port
+    CAPTURE_POSE_TX = 4,        // CapturePose, t_us = ring written
+    CAPTURE_KIND_COUNT
+};
+
+struct CaptureFileHeader {
+    uint32_t magic;             // CAPTURE_MAGIC
+    uint16_t version;           // CAPTURE_VERSION
+    uint16_t header_size;       // sizeof(CaptureFileHeader)
+    uint64_t capacity;          // Record area bytes, multiple of 8
+    uint64_t head;              // Position after the newest record
+    uint64_t tail;              // Position of the oldest record
+    uint64_t start_us;          // timebase_micros() when recording began
+    uint32_t records;           // Ever written, overwritten ones included
+    uint32_t dropped;           // Not recorded: too large, or the packet queue was full
+    uint32_t reserved[4];
+};
+
+struct CaptureRecordHeader {
+    uint32_t size;              // Whole record, header and padding included
+    uint32_t len;               // Payload bytes
+    uint64_t t_us;              // timebase_micros()
+    uint8_t  kind;              // CaptureKind
+    uint8_t  reserved0;
+    uint16_t source;            // Client fd for WebSocket records, else 0
+    uint32_t reserved1;
+};
+
+// Payload of CAPTURE_POSE_TX: the full packet, before any delta encoding
+struct CapturePose {
+    uint64_t exec_at_us;        // timebase_shared_us() deadline, 0 = on arrival
+    PosePacket31 pkt;
+};
+
+static_assert(sizeof(CaptureFileHeader) == 64, "CaptureFileHeader must be 64 bytes");
+static_assert(sizeof(CaptureRecordHeader) == 24, "CaptureRecordHeader must be 24 bytes");
+
+const char* capture_kind_name(uint8_t kind);
+
+/**
+ * Writer side, one thread only. open() creates (or truncates) the file
+ * and reserves its blocks up front, so recording never extends it.
+ */
+class CaptureRecorder {
+public:
+    CaptureRecorder() = default;
+    ~CaptureRecorder();
+    CaptureRecorder(const CaptureRecorder&) = delete;
+    CaptureRecorder& operator=(const CaptureRecorder&) = delete;
+
+    /**
+     * @param capacity record area bytes (rounded down to 8, at least
+     *        CAPTURE_MIN_BYTES)
+     */
+    bool open(const char* path, size_t capacity);
+    void close();
+    bool isOpen() const { return m_hdr != nullptr; }
+
+    /**
+     * Append one record, overwriting the oldest ones if needed. A record
+     * larger than the whole area is counted as dropped.
+     */
+    bool record(CaptureKind kind, uint16_t source, uint64_t t_us, const void* data, size_t len);
+    void addDropped(uint32_t n) { if (m_hdr && n) m_hdr->dropped += n; }
+
+    uint32_t records() const { return m_hdr ? m_hdr->records : 0; }
+    uint32_t dropped() const { return m_hdr ? m_hdr->dropped : 0; }
+    uint64_t bytesHeld() const { return m_hdr ? m_hdr->head - m_hdr->tail : 0; }
+
+private:
+    void advanceTail();
+
+    void* m_map = nullptr;
+    size_t m_map_len = 0;
+    CaptureFileHeader* m_hdr = nullptr;
+    uint8_t* m_area = nullptr;
+};
+
+/**
+ * One record, pointing into the reader's mapping.
+ */
+struct CaptureRecordView {
+    uint8_t kind;
+    uint16_t source;
+    uint64_t t_us;
+    const uint8_t* data;
+    size_t len;
+};
+
+/**
+ * Reads a capture oldest record first. Meant for a finished capture (or
+ * a copy): records being written while it reads may come out torn.
+ */
+class CaptureReader {
+public:
+    CaptureReader() = default;
+    ~CaptureReader();
+    CaptureReader(const CaptureReader&) = delete;
+    CaptureReader& operator=(const CaptureReader&) = delete;
+
+    bool open(const char* path);
+    void close();
+
+    /**
+     * Next record, pads skipped. Returns false at the end, or at the
+     * first record that does not fit the area (see corrupt()).
+     */
+    bool next(CaptureRecordView& out);
+    void rewind() { m_pos = m_hdr ? m_hdr->tail : 0; }
+    bool corrupt() const { return m_corrupt; }
+
+    const CaptureFileHeader* header() const { return m_hdr; }
+
+private:
+    void* m_map = nullptr;
+    size_t m_map_len = 0;
+    const CaptureFileHeader* m_hdr = nullptr;
+    const uint8_t* m_area = nullptr;
+    uint64_t m_pos = 0;
+    bool m_corrupt = false;
+};
+
+#endif // CAPTURE_H
@@ -3,82 +3,488 @@
  */
 
 #include "distance_sensor.h"
+#include <algorithm>
 #include <iostream>
 #include <fcntl.h>
+#include <pthread.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
 #include <linux/i2c-dev.h>
+#include <linux/i2c.h>
+#include <cstdio>
 #include <cstring>
 #include <cerrno>
 
+extern "C" {
+#include "timebase.h"
+}
+
 // VL53L0X registers
 #define REG_IDENTIFICATION_MODEL_ID  0xC0
 #define REG_SYSRANGE_START          0x00
 #define REG_RESULT_RANGE_STATUS     0x14
 #define REG_RESULT_INTERRUPT_STATUS 0x13
 #define REG_SYSTEM_INTERRUPT_CLEAR  0x0B
+#define REG_I2C_SLAVE_DEVICE_ADDRESS 0x8A
+
+// Timing configuration registers
+#define REG_SYSTEM_SEQUENCE_CONFIG              0x01
+#define REG_ALGO_PHASECAL_CONFIG_TIMEOUT        0x30
+#define REG_ALGO_PHASECAL_LIM                   0x30    // Page 1
+#define REG_GLOBAL_CONFIG_VCSEL_WIDTH           0x32
+#define REG_FINAL_RANGE_MIN_COUNT_RATE_RTN_LIMIT 0x44
+#define REG_MSRC_CONFIG_TIMEOUT_MACROP          0x46
+#define REG_FINAL_RANGE_VALID_PHASE_LOW         0x47
+#define REG_FINAL_RANGE_VALID_PHASE_HIGH        0x48
+#define REG_PRE_RANGE_VCSEL_PERIOD              0x50
+#define REG_PRE_RANGE_TIMEOUT_MACROP_HI         0x51
+#define REG_PRE_RANGE_VALID_PHASE_LOW           0x56
+#define REG_PRE_RANGE_VALID_PHASE_HIGH          0x57
+#define REG_FINAL_RANGE_VCSEL_PERIOD            0x70
+#define REG_FINAL_RANGE_TIMEOUT_MACROP_HI       0x71
+
+// Power-on measurement timing budget
+#define VL53L0X_DEFAULT_BUDGET_US   33000
+
+// SYSRANGE_START modes
+#define SYSRANGE_MODE_SINGLESHOT    0x01
+#define SYSRANGE_MODE_BACKTOBACK    0x02
+
+// Budgets from ST's ranging profile examples; VCSEL periods are the
+// power-on ones (longer periods only help the long-range profile)
+static const DistanceSensor::ProfileConfig s_profiles[] = {
+    { 20000,  0.25f, 14, 10 },  // HIGH_SPEED
+    { 33000,  0.25f, 14, 10 },  // DEFAULT
+    { 200000, 0.25f, 14, 10 },  // HIGH_ACCURACY
+};
+
+static const char* const s_profile_names[] = {
+    "high_speed",
+    "default",
+    "high_accuracy",
+};
+
+static inline uint8_t decodeVcselPeriod(uint8_t reg) { return (uint8_t)((reg + 1) << 1); }
+static inline uint8_t encodeVcselPeriod(uint8_t pclks) { return (uint8_t)((pclks >> 1) - 1); }
+
+// Macro period in ns for a VCSEL period in PCLKs
+static inline uint32_t macroPeriodNs(uint8_t vcsel_pclks) {
+    return ((uint32_t)2304 * vcsel_pclks * 1655 + 500) / 1000;
+}
+
+static uint16_t decodeTimeout(uint16_t reg) {
+    // LSB * 2^MSB + 1
+    return (uint16_t)((reg & 0x00FF) << ((reg & 0xFF00) >> 8)) + 1;
+}
+
+static uint16_t encodeTimeout(uint32_t mclks) {
+    if (mclks == 0) return 0;
+    uint32_t lsb = mclks - 1;
+    uint16_t msb = 0;
+    while (lsb & 0xFFFFFF00) {
+        lsb >>= 1;
+        msb++;
+    }
+    return (uint16_t)((msb << 8) | (lsb & 0xFF));
+}
+
+static uint32_t mclksToUs(uint16_t mclks, uint8_t vcsel_pclks) {
+    uint32_t period_ns = macroPeriodNs(vcsel_pclks);
+    return (mclks * period_ns + 500) / 1000;
+}
+
+static uint32_t usToMclks(uint32_t us, uint8_t vcsel_pclks) {
+    uint32_t period_ns = macroPeriodNs(vcsel_pclks);
+    return (us * 1000 + period_ns / 2) / period_ns;
+}
+
+const DistanceSensor::ProfileConfig& DistanceSensor::profileConfig(Profile profile) {
+    return s_profiles[(int)profile];
+}
+
+const char* DistanceSensor::profileName(Profile profile) {
+    return s_profile_names[(int)profile];
+}
+
+bool DistanceSensor::parseProfile(const char* name, Profile& out) {
+    for (int i = 0; i < (int)(sizeof(s_profile_names) / sizeof(s_profile_names[0])); i++) {
+        if (strcmp(name, s_profile_names[i]) == 0) {
+            out = (Profile)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// sysfs GPIO as an output at value, exporting it on first use
+static bool gpioSet(int gpio, int value) {
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/class/gpio/gpio%d/value", gpio);
+    if (access(path, F_OK) != 0) {
+        int fd = open("/sys/class/gpio/export", O_WRONLY);
+        if (fd < 0) return false;
+        char num[16];
+        int n = snprintf(num, sizeof(num), "%d", gpio);
+        bool ok = write(fd, num, n) == n;
+        close(fd);
+        if (!ok) return false;
+    }
+
+    char dir_path[64];
+    snprintf(dir_path, sizeof(dir_path), "/sys/class/gpio/gpio%d/direction", gpio);
+    int fd = open(dir_path, O_WRONLY);
+    if (fd < 0) return false;
+    // "low"/"high" set the direction and the level in one glitch-free write
+    const char* dir = value ? "high" : "low";
+    bool ok = write(fd, dir, strlen(dir)) == (ssize_t)strlen(dir);
+    close(fd);
+    return ok;
+}
+
+void DistanceSensor::Slot::store(const Sample& s) {
+    uint32_t v = version.load(std::memory_order_relaxed);
+    version.store(v + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    packed.store((uint64_t)s.seq
+                 | ((uint64_t)(uint8_t)s.status << 32)
+                 | ((uint64_t)s.sensor << 40)
+                 | ((uint64_t)s.distance_mm << 48), std::memory_order_relaxed);
+    timestamp_us.store(s.timestamp_us, std::memory_order_relaxed);
+
+    version.store(v + 2, std::memory_order_release);
+}
+
+bool DistanceSensor::Slot::load(Sample& s) const {
+    uint32_t v1 = version.load(std::memory_order_acquire);
+    if (v1 & 1) {
+        return false;
+    }
+
+    uint64_t p = packed.load(std::memory_order_relaxed);
+    uint64_t ts = timestamp_us.load(std::memory_order_relaxed);
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (version.load(std::memory_order_relaxed) != v1) {
+        return false;
+    }
+
+    s.seq = (uint32_t)p;
+    s.status = (Status)((p >> 32) & 0xFF);
+    s.sensor = (uint8_t)(p >> 40);
+    s.distance_mm = (uint16_t)(p >> 48);
+    s.timestamp_us = ts;
+    return true;
+}
 
 DistanceSensor::DistanceSensor()
     : m_fd(-1)
     , m_initialized(false)
     , m_last_distance(VL53L0X_MAX_MM)
+    , m_timing_budget_us(VL53L0X_DEFAULT_BUDGET_US)
+    , m_budget_ms(VL53L0X_DEFAULT_BUDGET_US / 1000)
 {
+    m_mounts[0] = { VL53L0X_ADDR, -1, VL53L0X_MOUNT_SCAN };
 }
 
 DistanceSensor::~DistanceSensor() {
-    if (m_fd >= 0) {
-        close(m_fd);
-        m_fd = -1;
-    }
+    stop();
+}
+
+// Write out, then read in after a repeated start, addressed to m_addr
+bool DistanceSensor::transfer(const uint8_t* out, size_t out_len, uint8_t* in, size_t in_len) {
+    struct i2c_msg msgs[2];
+    msgs[0] = { m_addr, 0, (uint16_t)out_len, const_cast<uint8_t*>(out) };
+    msgs[1] = { m_addr, I2C_M_RD, (uint16_t)in_len, in };
+    struct i2c_rdwr_ioctl_data data = { msgs, in_len ? 2u : 1u };
+    return ioctl(m_fd, I2C_RDWR, &data) == (int)data.nmsgs;
 }
 
 bool DistanceSensor::writeReg8(uint8_t reg, uint8_t value) {
     uint8_t buf[2] = {reg, value};
-    return write(m_fd, buf, 2) == 2;
+    return transfer(buf, 2, nullptr, 0);
 }
 
 bool DistanceSensor::readReg8(uint8_t reg, uint8_t& value) {
-    if (write(m_fd, &reg, 1) != 1) return false;
-    return read(m_fd, &value, 1) == 1;
+    return transfer(&reg, 1, &value, 1);
 }
 
 bool DistanceSensor::readReg16(uint8_t reg, uint16_t& value) {
-    if (write(m_fd, &reg, 1) != 1) return false;
     uint8_t buf[2];
-    if (read(m_fd, buf, 2) != 2) return false;
+    if (!transfer(&reg, 1, buf, 2)) return false;
     value = (buf[0] << 8) | buf[1];
     return true;
 }
 
-bool DistanceSensor::init() {
-    m_fd = open(VL53L0X_I2C_BUS, O_RDWR);
-    if (m_fd < 0) {
-        std::cerr << "[VL53L0X] Failed to open " << VL53L0X_I2C_BUS 
-                  << ": " << strerror(errno) << std::endl;
+bool DistanceSensor::writeReg16(uint8_t reg, uint16_t value) {
+    uint8_t buf[3] = {reg, (uint8_t)(value >> 8), (uint8_t)value};
+    return transfer(buf, 3, nullptr, 0);
+}
+
+bool DistanceSensor::getSequenceSteps(SequenceSteps& steps) {
+    uint8_t config;
+    if (!readReg8(REG_SYSTEM_SEQUENCE_CONFIG, config)) return false;
+    steps.tcc         = (config >> 4) & 0x1;
+    steps.dss         = (config >> 3) & 0x1;
+    steps.msrc        = (config >> 2) & 0x1;
+    steps.pre_range   = (config >> 6) & 0x1;
+    steps.final_range = (config >> 7) & 0x1;
+    return true;
+}
+
+bool DistanceSensor::getSequenceTimeouts(const SequenceSteps& steps, SequenceTimeouts& t) {
+    uint8_t pre_vcsel, final_vcsel, msrc;
+    uint16_t pre_reg, final_reg;
+    if (!readReg8(REG_PRE_RANGE_VCSEL_PERIOD, pre_vcsel) ||
+        !readReg8(REG_FINAL_RANGE_VCSEL_PERIOD, final_vcsel) ||
+        !readReg8(REG_MSRC_CONFIG_TIMEOUT_MACROP, msrc) ||
+        !readReg16(REG_PRE_RANGE_TIMEOUT_MACROP_HI, pre_reg) ||
+        !readReg16(REG_FINAL_RANGE_TIMEOUT_MACROP_HI, final_reg)) {
         return false;
     }
 
-    if (ioctl(m_fd, I2C_SLAVE, VL53L0X_ADDR) < 0) {
-        std::cerr << "[VL53L0X] Failed to set I2C address: " << strerror(errno) << std::endl;
-        close(m_fd);
-        m_fd = -1;
+    t.pre_range_vcsel_pclks = decodeVcselPeriod(pre_vcsel);
+    t.msrc_dss_tcc_mclks = (uint16_t)(msrc + 1);
+    t.msrc_dss_tcc_us = mclksToUs(t.msrc_dss_tcc_mclks, t.pre_range_vcsel_pclks);
+    t.pre_range_mclks = decodeTimeout(pre_reg);
+    t.pre_range_us = mclksToUs(t.pre_range_mclks, t.pre_range_vcsel_pclks);
+
+    // The final range timeout register includes the pre-range time
+    t.final_range_vcsel_pclks = decodeVcselPeriod(final_vcsel);
+    t.final_range_mclks = decodeTimeout(final_reg);
+    if (steps.pre_range) {
+        t.final_range_mclks -= t.pre_range_mclks;
+    }
+    t.final_range_us = mclksToUs(t.final_range_mclks, t.final_range_vcsel_pclks);
+    return true;
+}
+
+bool DistanceSensor::setSignalRateLimit(float limit_mcps) {
+    if (limit_mcps < 0.0f || limit_mcps > 511.99f) return false;
+    // Q9.7 fixed point
+    return writeReg16(REG_FINAL_RANGE_MIN_COUNT_RATE_RTN_LIMIT, (uint16_t)(limit_mcps * (1 << 7)));
+}
+
+bool DistanceSensor::setTimingBudget(uint32_t budget_us) {
+    // Per-step overheads from the VL53L0X API, in us
+    const uint32_t START_OVERHEAD = 1910;
+    const uint32_t END_OVERHEAD = 960;
+    const uint32_t MSRC_OVERHEAD = 660;
+    const uint32_t TCC_OVERHEAD = 590;
+    const uint32_t DSS_OVERHEAD = 690;
+    const uint32_t PRE_RANGE_OVERHEAD = 660;
+    const uint32_t FINAL_RANGE_OVERHEAD = 550;
+
+    SequenceSteps steps;
+    SequenceTimeouts t;
+    if (!getSequenceSteps(steps) || !getSequenceTimeouts(steps, t)) {
+        return false;
+    }
+
+    uint32_t used_us = START_OVERHEAD + END_OVERHEAD;
+    if (steps.tcc) {
+        used_us += t.msrc_dss_tcc_us + TCC_OVERHEAD;
+    }
+    if (steps.dss) {
+        used_us += 2 * (t.msrc_dss_tcc_us + DSS_OVERHEAD);
+    } else if (steps.msrc) {
+        used_us += t.msrc_dss_tcc_us + MSRC_OVERHEAD;
+    }
+    if (steps.pre_range) {
+        used_us += t.pre_range_us + PRE_RANGE_OVERHEAD;
+    }
+
+    if (steps.final_range) {
+        used_us += FINAL_RANGE_OVERHEAD;
+        if (used_us > budget_us) {
+            return false;   // Budget too small for the enabled steps
+        }
+
+        // Whatever is left goes to the final range step
+        uint32_t final_mclks = usToMclks(budget_us - used_us, t.final_range_vcsel_pclks);
+        if (steps.pre_range) {
+            final_mclks += t.pre_range_mclks;
+        }
+        if (!writeReg16(REG_FINAL_RANGE_TIMEOUT_MACROP_HI, encodeTimeout(final_mclks))) {
+            return false;
+        }
+    }
+
+    m_timing_budget_us = budget_us;
+    return true;
+}
+
+bool DistanceSensor::setVcselPeriod(bool final_range, uint8_t period_pclks) {
+    SequenceSteps steps;
+    SequenceTimeouts t;
+    if (!getSequenceSteps(steps) || !getSequenceTimeouts(steps, t)) {
         return false;
     }
 
-    // Verify device ID
+    uint8_t reg = encodeVcselPeriod(period_pclks);
+
+    if (!final_range) {
+        uint8_t phase_high;
+        switch (period_pclks) {
+        case 12: phase_high = 0x18; break;
+        case 14: phase_high = 0x30; break;
+        case 16: phase_high = 0x40; break;
+        case 18: phase_high = 0x50; break;
+        default: return false;
+        }
+        writeReg8(REG_PRE_RANGE_VALID_PHASE_HIGH, phase_high);
+        writeReg8(REG_PRE_RANGE_VALID_PHASE_LOW, 0x08);
+        writeReg8(REG_PRE_RANGE_VCSEL_PERIOD, reg);
+
+        // Keep the step timeouts in us across the period change
+        uint32_t pre_mclks = usToMclks(t.pre_range_us, period_pclks);
+        writeReg16(REG_PRE_RANGE_TIMEOUT_MACROP_HI, encodeTimeout(pre_mclks));
+
+        uint32_t msrc_mclks = usToMclks(t.msrc_dss_tcc_us, period_pclks);
+        writeReg8(REG_MSRC_CONFIG_TIMEOUT_MACROP, (uint8_t)((msrc_mclks > 256) ? 255 : (msrc_mclks - 1)));
+    } else {
+        uint8_t phase_high, vcsel_width, phasecal_timeout, phasecal_lim;
+        switch (period_pclks) {
+        case 8:  phase_high = 0x10; vcsel_width = 0x02; phasecal_timeout = 0x0C; phasecal_lim = 0x30; break;
+        case 10: phase_high = 0x28; vcsel_width = 0x03; phasecal_timeout = 0x09; phasecal_lim = 0x20; break;
+        case 12: phase_high = 0x38; vcsel_width = 0x03; phasecal_timeout = 0x08; phasecal_lim = 0x20; break;
+        case 14: phase_high = 0x48; vcsel_width = 0x03; phasecal_timeout = 0x07; phasecal_lim = 0x20; break;
+        default: return false;
+        }
+        writeReg8(REG_FINAL_RANGE_VALID_PHASE_HIGH, phase_high);
+        writeReg8(REG_FINAL_RANGE_VALID_PHASE_LOW, 0x08);
+        writeReg8(REG_GLOBAL_CONFIG_VCSEL_WIDTH, vcsel_width);
+        writeReg8(REG_ALGO_PHASECAL_CONFIG_TIMEOUT, phasecal_timeout);
+        writeReg8(0xFF, 0x01);
+        writeReg8(REG_ALGO_PHASECAL_LIM, phasecal_lim);
+        writeReg8(0xFF, 0x00);
+        writeReg8(REG_FINAL_RANGE_VCSEL_PERIOD, reg);
+
+        uint32_t final_mclks = usToMclks(t.final_range_us, period_pclks);
+        if (steps.pre_range) {
+            final_mclks += t.pre_range_mclks;
+        }
+        writeReg16(REG_FINAL_RANGE_TIMEOUT_MACROP_HI, encodeTimeout(final_mclks));
+    }
+
+    // The final range timeout depends on both periods: redo the budget
+    if (!setTimingBudget(m_timing_budget_us)) {
+        return false;
+    }
+
+    // Phase calibration has to be redone after a period change
+    uint8_t config;
+    if (!readReg8(REG_SYSTEM_SEQUENCE_CONFIG, config)) return false;
+    writeReg8(REG_SYSTEM_SEQUENCE_CONFIG, 0x02);
+    bool ok = singleRefCalibration(0x00);
+    writeReg8(REG_SYSTEM_SEQUENCE_CONFIG, config);
+    return ok;
+}
+
+bool DistanceSensor::singleRefCalibration(uint8_t vhv_init_byte) {
+    if (!writeReg8(REG_SYSRANGE_START, SYSRANGE_MODE_SINGLESHOT | vhv_init_byte)) {
+        return false;
+    }
+
+    uint8_t status = 0;
+    int polls = VL53L0X_TIMEOUT_MS * 1000 / VL53L0X_POLL_US;
+    while (!readReg8(REG_RESULT_INTERRUPT_STATUS, status) || (status & 0x07) == 0) {
+        if (--polls <= 0) {
+            return false;
+        }
+        usleep(VL53L0X_POLL_US);
+    }
+
+    writeReg8(REG_SYSTEM_INTERRUPT_CLEAR, 0x01);
+    writeReg8(REG_SYSRANGE_START, 0x00);
+    return true;
+}
+
+bool DistanceSensor::applyProfile(Profile profile) {
+    const ProfileConfig& cfg = profileConfig(profile);
+
+    // Periods first: each one rescales the budget it was given
+    bool ok = setSignalRateLimit(cfg.signal_rate_limit_mcps)
+           && setVcselPeriod(false, cfg.pre_range_vcsel_pclks)
+           && setVcselPeriod(true, cfg.final_range_vcsel_pclks)
+           && setTimingBudget(cfg.timing_budget_us);
+
+    if (!ok) {
+        std::cerr << "[VL53L0X] Failed to apply profile " << profileName(profile) << std::endl;
+        return false;
+    }
+
+    m_budget_ms.store(m_timing_budget_us / 1000, std::memory_order_relaxed);
+    std::cout << "[VL53L0X] Profile " << profileName(profile) << " ("
+              << cfg.timing_budget_us / 1000 << " ms budget)" << std::endl;
+    return true;
+}
+
+bool DistanceSensor::setMounts(const Mount* mounts, size_t count) {
+    if (count == 0 || count > VL53L0X_MAX_SENSORS || m_initialized) {
+        return false;
+    }
+    int unwired = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (mounts[i].addr < 0x08 || mounts[i].addr > 0x77) return false;
+        if (mounts[i].xshut_gpio < 0) unwired++;
+        for (size_t j = 0; j < i; j++) {
+            if (mounts[j].addr == mounts[i].addr) return false;
+        }
+    }
+    if (count > 1 && unwired > 1) {
+        return false;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        m_mounts[i] = mounts[i];
+    }
+    m_sensor_count = count;
+    return true;
+}
+
+bool DistanceSensor::assignAddresses() {
+    // Everyone with an XSHUT line into reset; the one without, if any,
+    // is then alone at VL53L0X_ADDR
+    for (size_t i = 0; i < m_sensor_count; i++) {
+        if (m_mounts[i].xshut_gpio >= 0 && !gpioSet(m_mounts[i].xshut_gpio, 0)) {
+            std::cerr << "[VL53L0X] Failed to drive XSHUT GPIO " << m_mounts[i].xshut_gpio << std::endl;
+            return false;
+        }
+    }
+    usleep(VL53L0X_BOOT_US);
+
+    // Unwired sensor first, then release the others one by one
+    for (int pass = 0; pass < 2; pass++) {
+        for (size_t i = 0; i < m_sensor_count; i++) {
+            const Mount& m = m_mounts[i];
+            if ((m.xshut_gpio >= 0) != (pass == 1)) continue;
+            if (m.xshut_gpio >= 0) {
+                gpioSet(m.xshut_gpio, 1);
+                usleep(VL53L0X_BOOT_US);
+            }
+            m_addr = VL53L0X_ADDR;
+            if (m.addr != VL53L0X_ADDR && !writeReg8(REG_I2C_SLAVE_DEVICE_ADDRESS, m.addr & 0x7F)) {
+                std::cerr << "[VL53L0X] Sensor " << i << " did not take address 0x"
+                          << std::hex << (int)m.addr << std::dec << std::endl;
+            }
+        }
+    }
+    return true;
+}
+
+// Identify and wake the sensor at m_addr
+bool DistanceSensor::initDevice() {
     uint8_t model_id = 0;
     if (!readReg8(REG_IDENTIFICATION_MODEL_ID, model_id)) {
-        std::cerr << "[VL53L0X] Failed to read model ID" << std::endl;
-        close(m_fd);
-        m_fd = -1;
+        std::cerr << "[VL53L0X] 0x" << std::hex << (int)m_addr
+                  << ": failed to read model ID" << std::dec << std::endl;
         return false;
     }
 
     if (model_id != 0xEE) {
-        std::cerr << "[VL53L0X] Invalid model ID: 0x" << std::hex << (int)model_id 
-                  << " (expected 0xEE)" << std::dec << std::endl;
-        close(m_fd);
-        m_fd = -1;
+        std::cerr << "[VL53L0X] 0x" << std::hex << (int)m_addr << ": invalid model ID: 0x"
+                  << (int)model_id << " (expected 0xEE)" << std::dec << std::endl;
         return false;
     }
 
@@ -91,67 +497,302 @@ bool DistanceSensor::init() {
     writeReg8(0x00, 0x01);
     writeReg8(0xFF, 0x00);
     writeReg8(0x80, 0x00);
+    return true;
+}
+
+bool DistanceSensor::init() {
+    m_fd = open(VL53L0X_I2C_BUS, O_RDWR);
+    if (m_fd < 0) {
+        std::cerr << "[VL53L0X] Failed to open " << VL53L0X_I2C_BUS 
+                  << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    bool readdress = m_sensor_count > 1 || m_mounts[0].addr != VL53L0X_ADDR;
+    if (readdress && !assignAddresses()) {
+        close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+
+    m_active = 0;
+    for (size_t i = 0; i < m_sensor_count; i++) {
+        select(i);
+        if (initDevice()) {
+            m_active |= 1u << i;
+        }
+    }
+    if (m_active == 0) {
+        close(m_fd);
+        m_fd = -1;
+        return false;
+    }
 
     m_initialized = true;
-    std::cout << "[VL53L0X] Initialized (model_id=0x" << std::hex << (int)model_id 
-              << std::dec << ")" << std::endl;
+    std::cout << "[VL53L0X] Initialized " << __builtin_popcount(m_active) << " of "
+              << m_sensor_count << " sensor(s)" << std::endl;
+
+    m_running.store(true);
+    m_thread = std::thread(&DistanceSensor::threadMain, this);
     return true;
 }
 
-DistanceSensor::Status DistanceSensor::readRange(uint16_t& distance_mm) {
-    if (!m_initialized || m_fd < 0) {
-        return Status::NOT_INITIALIZED;
+void DistanceSensor::stop() {
+    if (m_running.exchange(false) && m_thread.joinable()) {
+        m_thread.join();
+    }
+
+    if (m_fd >= 0) {
+        close(m_fd);
+        m_fd = -1;
+    }
+    m_initialized = false;
+}
+
+void DistanceSensor::setProfile(Profile profile) {
+    m_profile_requested.store((int)profile, std::memory_order_relaxed);
+}
+
+bool DistanceSensor::startContinuous() {
+    writeReg8(REG_SYSTEM_INTERRUPT_CLEAR, 0x01);
+    return writeReg8(REG_SYSRANGE_START, SYSRANGE_MODE_BACKTOBACK);
+}
+
+void DistanceSensor::stopAll() {
+    for (size_t i = 0; i < m_sensor_count; i++) {
+        if (!(m_active & (1u << i))) continue;
+        select(i);
+        writeReg8(REG_SYSRANGE_START, SYSRANGE_MODE_SINGLESHOT);
     }
 
-    // Start single-shot measurement
-    if (!writeReg8(REG_SYSRANGE_START, 0x01)) {
-        return Status::ERROR;
+    // Let the measurements in flight finish before touching the timing
+    usleep(m_timing_budget_us + 5000);
+    for (size_t i = 0; i < m_sensor_count; i++) {
+        if (!(m_active & (1u << i))) continue;
+        select(i);
+        writeReg8(REG_SYSTEM_INTERRUPT_CLEAR, 0x01);
     }
+}
 
-    // Wait for measurement to complete
-    uint8_t status;
-    int timeout = VL53L0X_TIMEOUT_MS;
-    while (timeout > 0) {
-        if (!readReg8(REG_SYSRANGE_START, status)) {
-            return Status::ERROR;
+/**
+ * For every sensor in mask: read two bytes at reg into out[i], and with
+ * clear acknowledge the result. One I2C_RDWR for all of them; if the
+ * bus rejects the batch (a sensor NACKed), sensor by sensor to find out
+ * which. Returns the sensors that answered.
+ */
+uint32_t DistanceSensor::batchRead(uint32_t mask, uint8_t reg, bool clear, uint8_t (*out)[2]) {
+    static uint8_t clear_buf[2] = { REG_SYSTEM_INTERRUPT_CLEAR, 0x01 };
+    struct i2c_msg msgs[VL53L0X_MAX_SENSORS * 3];
+    uint8_t regs[VL53L0X_MAX_SENSORS];
+    uint32_t n = 0;
+
+    const size_t count = std::min(m_sensor_count, (size_t)VL53L0X_MAX_SENSORS);
+    for (size_t i = 0; i < count; i++) {
+        if (!(mask & (1u << i))) continue;
+        uint16_t addr = m_mounts[i].addr;
+        regs[i] = reg;
+        msgs[n++] = { addr, 0, 1, &regs[i] };
+        msgs[n++] = { addr, I2C_M_RD, 2, out[i] };
+        if (clear) {
+            msgs[n++] = { addr, 0, 2, clear_buf };
         }
-        if ((status & 0x01) == 0) break;
-        usleep(1000);
-        timeout--;
     }
+    if (n == 0) return 0;
 
-    if (timeout == 0) {
-        return Status::TIMEOUT;
+    struct i2c_rdwr_ioctl_data data = { msgs, n };
+    if (ioctl(m_fd, I2C_RDWR, &data) == (int)n) {
+        return mask;
+    }
+    if (__builtin_popcount(mask) == 1) {
+        return 0;
     }
 
-    // Wait for result ready
-    timeout = VL53L0X_TIMEOUT_MS;
-    while (timeout > 0) {
-        if (!readReg8(REG_RESULT_RANGE_STATUS, status)) {
-            return Status::ERROR;
+    uint32_t ok = 0;
+    for (size_t i = 0; i < m_sensor_count; i++) {
+        if (mask & (1u << i)) {
+            ok |= batchRead(mask & (1u << i), reg, clear, out);
         }
-        if (status & 0x01) break;
-        usleep(1000);
-        timeout--;
     }
+    return ok;
+}
 
-    if (timeout == 0) {
-        return Status::TIMEOUT;
+void DistanceSensor::publish(size_t sensor, Status status, uint16_t distance_mm) {
+    SensorState& st = m_sensors[sensor];
+    Sample s;
+    s.seq = st.published.load(std::memory_order_relaxed) + 1;
+    s.distance_mm = distance_mm;
+    s.status = status;
+    s.sensor = (uint8_t)sensor;
+    s.timestamp_us = timebase_micros();
+
+    st.history[s.seq & (VL53L0X_HISTORY_LEN - 1)].store(s);
+    if (status == Status::OK && sensor == 0) {
+        m_last_distance.store(distance_mm, std::memory_order_relaxed);
     }
+    st.published.store(s.seq, std::memory_order_release);
+}
+
+void DistanceSensor::threadMain() {
+    pthread_setname_np(pthread_self(), "range");
+    Ranging r[VL53L0X_MAX_SENSORS] = {};
+
+    while (m_running.load(std::memory_order_relaxed)) {
+        int wanted = m_profile_requested.load(std::memory_order_relaxed);
+        if (wanted != m_profile_applied) {
+            bool any_on = false;
+            for (size_t i = 0; i < m_sensor_count; i++) {
+                any_on = any_on || r[i].on;
+                r[i].on = false;
+            }
+            if (any_on) {
+                stopAll();
+            }
+            // On failure a sensor keeps its previous timing; do not retry
+            // every sample
+            for (size_t i = 0; i < m_sensor_count; i++) {
+                if (!(m_active & (1u << i))) continue;
+                select(i);
+                applyProfile((Profile)wanted);
+            }
+            m_profile_applied = wanted;
+        }
+
+        // Two timing budgets, but never less than VL53L0X_TIMEOUT_MS
+        uint64_t limit_us = (uint64_t)m_timing_budget_us * 2;
+        if (limit_us < VL53L0X_TIMEOUT_MS * 1000) limit_us = VL53L0X_TIMEOUT_MS * 1000;
+
+        uint64_t now = timebase_micros();
+        uint32_t live = 0;
+        for (size_t i = 0; i < m_sensor_count; i++) {
+            if (!(m_active & (1u << i))) continue;
+            if (!r[i].on && now >= r[i].retry_us) {
+                select(i);
+                r[i].on = startContinuous();
+                r[i].since_us = now;
+                if (!r[i].on) {
+                    std::cerr << "[VL53L0X] Sensor " << i << ": failed to start continuous ranging" << std::endl;
+                    r[i].retry_us = now + VL53L0X_TIMEOUT_MS * 1000;
+                }
+            }
+            if (r[i].on) live |= 1u << i;
+        }
+
+        // The sensors range on their own; one pass polls them all
+        uint8_t status[VL53L0X_MAX_SENSORS][2] = {};
+        uint8_t range[VL53L0X_MAX_SENSORS][2] = {};
+        uint32_t answered = batchRead(live, REG_RESULT_INTERRUPT_STATUS, false, status);
+        uint32_t ready = 0;
+        for (size_t i = 0; i < m_sensor_count; i++) {
+            if ((answered & (1u << i)) && (status[i][0] & 0x07)) ready |= 1u << i;
+        }
+        // Range value at +10 from the status register, then clear the
+        // interrupt so the next result can be flagged
+        uint32_t read = batchRead(ready, REG_RESULT_RANGE_STATUS + 10, true, range);
+
+        if (!m_running.load(std::memory_order_relaxed)) {
+            break;
+        }
+
+        now = timebase_micros();
+        for (size_t i = 0; i < m_sensor_count; i++) {
+            uint32_t bit = 1u << i;
+            if (!(live & bit)) continue;
+
+            if (!(answered & bit) || ((ready & bit) && !(read & bit))) {
+                publish(i, Status::ERROR, 0);
+            } else if (ready & bit) {
+                uint16_t distance_mm = (uint16_t)((range[i][0] << 8) | range[i][1]);
+                bool in_range = distance_mm >= VL53L0X_MIN_MM && distance_mm <= VL53L0X_MAX_MM;
+                m_range_latency.record(now - r[i].since_us);
+                r[i].since_us = now;
+                publish(i, in_range ? Status::OK : Status::OUT_OF_RANGE, distance_mm);
+                continue;
+            } else if (now - r[i].since_us > limit_us) {
+                publish(i, Status::TIMEOUT, 0);
+            } else {
+                continue;
+            }
 
-    // Read range value (offset +10 from status register)
-    if (!readReg16(REG_RESULT_RANGE_STATUS + 10, distance_mm)) {
-        return Status::ERROR;
+            // Sensor may have dropped out of continuous mode; re-arm it
+            // later without spinning on a dead bus
+            r[i].on = false;
+            r[i].retry_us = now + VL53L0X_TIMEOUT_MS * 1000;
+        }
+
+        if (ready == 0) {
+            usleep(VL53L0X_POLL_US);
+        }
     }
 
-    // Clear interrupt
-    writeReg8(REG_SYSTEM_INTERRUPT_CLEAR, 0x01);
+    for (size_t i = 0; i < m_sensor_count; i++) {
+        if (!(m_active & (1u << i))) continue;
+        select(i);
+        writeReg8(REG_SYSRANGE_START, SYSRANGE_MODE_SINGLESHOT);
+    }
+}
+
+bool DistanceSensor::readSlot(const SensorState& st, uint32_t seq, Sample& out) const {
+    const Slot& slot = st.history[seq & (VL53L0X_HISTORY_LEN - 1)];
+    // A failed load means the writer is in the slot right now; it takes
+    // a few stores, so a couple of retries is plenty
+    for (int attempt = 0; attempt < 4; attempt++) {
+        if (slot.load(out)) {
+            return out.seq == seq;
+        }
+    }
+    return false;
+}
+
+bool DistanceSensor::latestSample(size_t sensor, Sample& out) const {
+    if (sensor >= m_sensor_count) {
+        return false;
+    }
+    const SensorState& st = m_sensors[sensor];
+    // Retry once if the ring lapped the slot between the two loads
+    for (int attempt = 0; attempt < 2; attempt++) {
+        uint32_t seq = st.published.load(std::memory_order_acquire);
+        if (seq == 0) {
+            return false;
+        }
+        if (readSlot(st, seq, out)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t DistanceSensor::history(size_t sensor, Sample* out, size_t max) const {
+    if (sensor >= m_sensor_count) {
+        return 0;
+    }
+    const SensorState& st = m_sensors[sensor];
+    uint32_t seq = st.published.load(std::memory_order_acquire);
+    size_t count = 0;
+    while (count < max && count < VL53L0X_HISTORY_LEN && seq != 0) {
+        if (!readSlot(st, seq, out[count])) {
+            break;  // Overwritten by a newer sample: the rest is gone too
+        }
+        count++;
+        seq--;
+    }
+    return count;
+}
+
+DistanceSensor::Status DistanceSensor::readRange(uint16_t& distance_mm) const {
+    if (!m_initialized) {
+        return Status::NOT_INITIALIZED;
+    }
 
-    // Check range validity
-    if (distance_mm < VL53L0X_MIN_MM || distance_mm > VL53L0X_MAX_MM) {
-        return Status::OUT_OF_RANGE;
+    Sample s;
+    if (!latestSample(s)) {
+        return Status::TIMEOUT;
+    }
+    uint64_t stale_ms = (uint64_t)m_budget_ms.load(std::memory_order_relaxed) * 3;
+    if (stale_ms < VL53L0X_STALE_MS) stale_ms = VL53L0X_STALE_MS;
+    if (timebase_micros() - s.timestamp_us > stale_ms * 1000) {
+        return Status::TIMEOUT;
     }
 
-    m_last_distance = distance_mm;
-    return Status::OK;
+    distance_mm = s.distance_mm;
+    return s.status;
 }
@@ -3,22 +3,54 @@
  * 
  * Time-of-Flight laser ranging sensor on I2C2.
  * Provides obstacle detection for autonomous navigation.
+ *
+ * The sensor runs in back-to-back continuous mode, drained by a ranging
+ * thread that publishes timestamped samples into a small history ring.
+ * Readers never touch the bus: readRange() returns the newest sample
+ * without blocking, so the I/O loop is not stalled by a measurement.
+ *
+ * Ranging profiles trade speed for noise by changing the measurement
+ * timing budget, signal rate limit and VCSEL pulse periods. A profile
+ * change is applied by the ranging thread between two measurements.
+ *
+ * Up to VL53L0X_MAX_SENSORS sensors can share the bus. Each Mount names
+ * the address it is given at init, its XSHUT GPIO and where it looks:
+ * all XSHUT lines are pulled low, then each sensor is released in turn
+ * and moved off the 0x29 power-on address. Every sensor ranges
+ * continuously; the thread checks all of them with one combined I2C
+ * transfer and reads every ready result with a second, so N sensors
+ * cost two bus transactions per pass, not 2N. Samples are published per
+ * sensor. Sensor 0 is the primary one behind the single-sensor calls.
  */
 
 #ifndef DISTANCE_SENSOR_H
 #define DISTANCE_SENSOR_H
 
+#include <cstddef>
 #include <cstdint>
 #include <atomic>
+#include <thread>
+
+#include "latency_histogram.h"
 
 #define VL53L0X_I2C_BUS     "/dev/i2c-2"
-#define VL53L0X_ADDR        0x29
+#define VL53L0X_ADDR        0x29    // Power-on address
+
+// Several sensors
+#define VL53L0X_MAX_SENSORS 4
+#define VL53L0X_MOUNT_SCAN  (-1)    // Mount angle: on the scan servo
+#define VL53L0X_BOOT_US     2000    // XSHUT release to first I2C access
 
 // Range limits
 #define VL53L0X_MIN_MM      30
 #define VL53L0X_MAX_MM      2000
 #define VL53L0X_TIMEOUT_MS  100
 
+// Ranging thread
+#define VL53L0X_POLL_US         2000    // Result-ready poll interval
+#define VL53L0X_STALE_MS        300     // Newest sample older than this -> TIMEOUT
+#define VL53L0X_HISTORY_LEN     16      // Samples kept, power of two
+
 // Obstacle thresholds
 #define OBSTACLE_CLOSE_MM   150
 #define OBSTACLE_MEDIUM_MM  400
@@ -34,46 +66,231 @@ public:
         NOT_INITIALIZED
     };
 
+    enum class Profile {
+        HIGH_SPEED,         // ~20 ms budget, for sweeps while walking
+        DEFAULT,            // ~33 ms budget, sensor power-on setting
+        HIGH_ACCURACY       // ~200 ms budget, for stationary readings
+    };
+
+    /**
+     * Register-level settings behind a profile.
+     */
+    struct ProfileConfig {
+        uint32_t timing_budget_us;
+        float signal_rate_limit_mcps;
+        uint8_t pre_range_vcsel_pclks;     // 12, 14, 16 or 18
+        uint8_t final_range_vcsel_pclks;   // 8, 10, 12 or 14
+    };
+
+    static const ProfileConfig& profileConfig(Profile profile);
+    static const char* profileName(Profile profile);
+    static bool parseProfile(const char* name, Profile& out);
+
+    /**
+     * One measurement. seq counts up from 1 per sensor; timestamp_us is
+     * CLOCK_MONOTONIC at the time the result was read.
+     */
+    struct Sample {
+        uint32_t seq;
+        uint16_t distance_mm;
+        Status status;
+        uint8_t sensor;
+        uint64_t timestamp_us;
+    };
+
+    /**
+     * A sensor on the bus. angle_deg uses the scan servo's convention
+     * (90 ahead, larger to the left), or VL53L0X_MOUNT_SCAN.
+     */
+    struct Mount {
+        uint8_t addr;           // Assigned at init (VL53L0X_ADDR to keep it)
+        int xshut_gpio;         // sysfs GPIO number, -1 = not wired
+        int angle_deg;
+    };
+
     DistanceSensor();
     ~DistanceSensor();
 
     /**
-     * Initialize the VL53L0X sensor.
+     * Sensors to bring up, before init(). Default: one at VL53L0X_ADDR
+     * on the scan servo, no XSHUT. With several, addresses must differ
+     * and at most one may lack an XSHUT line (it is readdressed first,
+     * while the others are held in reset).
+     * @return false (and nothing changed) if the list is not usable
+     */
+    bool setMounts(const Mount* mounts, size_t count);
+
+    size_t sensorCount() const { return m_sensor_count; }
+    const Mount& mount(size_t sensor) const { return m_mounts[sensor]; }
+
+    /**
+     * Sensors that answered at init, as a bit mask.
+     */
+    uint32_t activeMask() const { return m_active; }
+
+    /**
+     * Assign addresses, initialize every sensor and start continuous
+     * ranging. True if at least one sensor came up.
      */
     bool init();
 
     /**
-     * Perform a single-shot range measurement.
+     * Stop the ranging thread and the sensor. Called by the destructor.
+     */
+    void stop();
+
+    /**
+     * Request a ranging profile. Takes effect after the measurement in
+     * progress; may be called from any thread.
+     */
+    void setProfile(Profile profile);
+
+    /**
+     * Profile last requested (and applied, once the thread gets to it).
+     */
+    Profile getProfile() const { return (Profile)m_profile_requested.load(std::memory_order_relaxed); }
+
+    /**
+     * Measurement timing budget in effect, in ms. A sample's measurement
+     * started about this long before its timestamp.
+     */
+    uint32_t getTimingBudgetMs() const { return m_budget_ms.load(std::memory_order_relaxed); }
+
+    /**
+     * Newest measurement, non-blocking.
      * @param distance_mm Output distance in millimeters
-     * @return Status code
+     * @return Status of the newest sample; TIMEOUT if there is none yet
+     *         or it is older than VL53L0X_STALE_MS (or three timing
+     *         budgets, whichever is longer)
+     */
+    Status readRange(uint16_t& distance_mm) const;
+
+    /**
+     * Newest sample as published, without the staleness check.
+     * Returns false if nothing has been measured yet.
+     */
+    bool latestSample(Sample& out) const { return latestSample(0, out); }
+    bool latestSample(size_t sensor, Sample& out) const;
+
+    /**
+     * Copy up to max recent samples, newest first. Returns the count.
      */
-    Status readRange(uint16_t& distance_mm);
+    size_t history(Sample* out, size_t max) const { return history(0, out, max); }
+    size_t history(size_t sensor, Sample* out, size_t max) const;
 
     /**
      * Get last valid distance reading.
      */
-    uint16_t getLastDistance() const { return m_last_distance; }
+    uint16_t getLastDistance() const { return m_last_distance.load(std::memory_order_relaxed); }
 
     /**
      * Check if obstacle is within threshold.
      */
-    bool isObstacleClose() const { return m_last_distance < OBSTACLE_CLOSE_MM; }
-    bool isObstacleMedium() const { return m_last_distance < OBSTACLE_MEDIUM_MM; }
-    bool isObstacleFar() const { return m_last_distance < OBSTACLE_FAR_MM; }
+    bool isObstacleClose() const { return getLastDistance() < OBSTACLE_CLOSE_MM; }
+    bool isObstacleMedium() const { return getLastDistance() < OBSTACLE_MEDIUM_MM; }
+    bool isObstacleFar() const { return getLastDistance() < OBSTACLE_FAR_MM; }
 
     /**
      * Check if sensor is initialized.
      */
     bool isInitialized() const { return m_initialized; }
 
+    /**
+     * Duration of each completed measurement as seen by the ranging
+     * thread (result wait plus the I2C reads), in us, all sensors.
+     * readRange() itself never blocks, so this is what a reading costs.
+     */
+    const LatencyHistogram& rangeLatency() const { return m_range_latency; }
+
 private:
+    static_assert((VL53L0X_HISTORY_LEN & (VL53L0X_HISTORY_LEN - 1)) == 0,
+                  "VL53L0X_HISTORY_LEN must be a power of two");
+
+    /**
+     * Seqlock-protected sample. The ranging thread is the only writer;
+     * fields are atomics so torn reads are detected, not undefined.
+     */
+    struct Slot {
+        std::atomic<uint32_t> version{0};   // Odd while being written
+        std::atomic<uint64_t> packed{0};    // seq | status << 32 | sensor << 40 | distance << 48
+        std::atomic<uint64_t> timestamp_us{0};
+
+        void store(const Sample& s);
+        bool load(Sample& s) const;
+    };
+
+    // Per-sensor ring of published samples
+    struct SensorState {
+        Slot history[VL53L0X_HISTORY_LEN];
+        std::atomic<uint32_t> published{0};     // seq of the newest sample
+    };
+
+    // Ranging thread's view of one sensor
+    struct Ranging {
+        bool on;
+        uint64_t since_us;      // Last result or start of ranging
+        uint64_t retry_us;      // Re-arm after a failure, not before
+    };
+
+    bool transfer(const uint8_t* out, size_t out_len, uint8_t* in, size_t in_len);
     bool writeReg8(uint8_t reg, uint8_t value);
     bool readReg8(uint8_t reg, uint8_t& value);
     bool readReg16(uint8_t reg, uint16_t& value);
+    bool writeReg16(uint8_t reg, uint16_t value);
+
+    // Timing configuration, after the VL53L0X API (sequence steps,
+    // macro periods and their 8.8 timeout encoding)
+    struct SequenceSteps {
+        bool tcc, msrc, dss, pre_range, final_range;
+    };
+    struct SequenceTimeouts {
+        uint8_t pre_range_vcsel_pclks;
+        uint8_t final_range_vcsel_pclks;
+        uint16_t msrc_dss_tcc_mclks;
+        uint16_t pre_range_mclks;
+        uint16_t final_range_mclks;
+        uint32_t msrc_dss_tcc_us;
+        uint32_t pre_range_us;
+        uint32_t final_range_us;
+    };
+
+    bool getSequenceSteps(SequenceSteps& steps);
+    bool getSequenceTimeouts(const SequenceSteps& steps, SequenceTimeouts& t);
+    bool setSignalRateLimit(float limit_mcps);
+    bool setTimingBudget(uint32_t budget_us);
+    bool setVcselPeriod(bool final_range, uint8_t period_pclks);
+    bool singleRefCalibration(uint8_t vhv_init_byte);
+    bool applyProfile(Profile profile);
+
+    bool assignAddresses();
+    bool initDevice();
+    void select(size_t sensor) { m_addr = m_mounts[sensor].addr; }
+    bool startContinuous();
+    void stopAll();
+    uint32_t batchRead(uint32_t mask, uint8_t reg, bool clear, uint8_t (*out)[2]);
+    void publish(size_t sensor, Status status, uint16_t distance_mm);
+    bool readSlot(const SensorState& st, uint32_t seq, Sample& out) const;
+    void threadMain();
 
     int m_fd;
+    uint8_t m_addr = VL53L0X_ADDR;          // Target of the register helpers
     bool m_initialized;
-    uint16_t m_last_distance;
+    Mount m_mounts[VL53L0X_MAX_SENSORS];
+    size_t m_sensor_count = 1;
+    uint32_t m_active = 0;
+    std::atomic<uint16_t> m_last_distance;
+    uint32_t m_timing_budget_us;            // Ranging thread only
+    std::atomic<uint32_t> m_budget_ms;      // Applied budget, for timeouts
+
+    std::atomic<int> m_profile_requested{(int)Profile::DEFAULT};
+    int m_profile_applied = -1;             // Ranging thread only
+
+    std::thread m_thread;
+    std::atomic<bool> m_running{false};
+
+    SensorState m_sensors[VL53L0X_MAX_SENSORS];
+
+    LatencyHistogram m_range_latency;
 };
 
 #endif // DISTANCE_SENSOR_H
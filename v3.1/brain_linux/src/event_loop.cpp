@@ -0,0 +1,150 @@
+/**
+ * Spider Robot v3.1 - Event Loop Implementation
+ */
+
+#include "event_loop.h"
+#include "logger.h"
+
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+extern "C" {
+#include "timebase.h"
+}
+
+static const char* TAG = "Loop";
+
+EventLoop::EventLoop() : m_timers(timebase_millis64()) {
+}
+
+EventLoop::~EventLoop() {
+    close();
+}
+
+bool EventLoop::init() {
+    if (m_epoll_fd >= 0) {
+        return true;
+    }
+
+    m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (m_epoll_fd < 0) {
+        LOG_ERROR(TAG, "epoll_create1 failed: %s", strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+void EventLoop::close() {
+    m_handlers.clear();
+    for (int id = 0; id < m_timers.count(); id++) {
+        m_timers.remove(id);
+    }
+
+    if (m_epoll_fd >= 0) {
+        ::close(m_epoll_fd);
+        m_epoll_fd = -1;
+    }
+}
+
+bool EventLoop::addFd(int fd, uint32_t events, FdCallback cb) {
+    if (m_epoll_fd < 0 || fd < 0) {
+        return false;
+    }
+
+    struct epoll_event ev = {};
+    ev.events = events;
+    ev.data.fd = fd;
+
+    if (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        LOG_ERROR(TAG, "epoll_ctl(ADD, fd=%d) failed: %s", fd, strerror(errno));
+        return false;
+    }
+
+    m_handlers[fd] = std::move(cb);
+    return true;
+}
+
+bool EventLoop::modifyFd(int fd, uint32_t events) {
+    if (m_epoll_fd < 0 || m_handlers.find(fd) == m_handlers.end()) {
+        return false;
+    }
+
+    struct epoll_event ev = {};
+    ev.events = events;
+    ev.data.fd = fd;
+
+    if (epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, fd, &ev) < 0) {
+        LOG_ERROR(TAG, "epoll_ctl(MOD, fd=%d) failed: %s", fd, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+void EventLoop::removeFd(int fd) {
+    auto it = m_handlers.find(fd);
+    if (it == m_handlers.end()) {
+        return;
+    }
+
+    // Fails harmlessly with EBADF if the caller already closed the fd
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    m_handlers.erase(it);
+}
+
+int EventLoop::addTimer(const char* name, uint32_t interval_ms, TimerCallback cb) {
+    return m_timers.add(name, interval_ms, std::move(cb));
+}
+
+bool EventLoop::setTimerInterval(int timer_id, uint32_t interval_ms) {
+    if (timer_id < 0 || timer_id >= m_timers.count()) {
+        return false;
+    }
+    m_timers.setInterval(timer_id, interval_ms);
+    return true;
+}
+
+void EventLoop::removeTimer(int timer_id) {
+    m_timers.remove(timer_id);
+}
+
+int EventLoop::runOnce(int timeout_ms) {
+    if (m_epoll_fd < 0) {
+        return -1;
+    }
+
+    // Sleep no further than the next timer, counted from the last wakeup's clock read
+    uint64_t deadline = m_timers.nextDeadline();
+    if (deadline != UINT64_MAX) {
+        uint64_t now = m_timers.now();
+        uint64_t wait = deadline > now ? deadline - now : 0;
+        // Never more than one top-level block (2^24 ms) away, so it fits
+        if (timeout_ms < 0 || wait < (uint64_t)timeout_ms) {
+            timeout_ms = (int)wait;
+        }
+    }
+
+    struct epoll_event events[MAX_EVENTS];
+    int n = epoll_wait(m_epoll_fd, events, MAX_EVENTS, timeout_ms);
+    if (n < 0) {
+        if (errno != EINTR) {
+            LOG_ERROR(TAG, "epoll_wait failed: %s", strerror(errno));
+            return -1;
+        }
+        n = 0;
+    }
+    // Timers first, so fd callbacks arm theirs from this wakeup's time
+    int timers = m_timers.advance(timebase_millis64());
+
+    for (int i = 0; i < n; i++) {
+        // A previous callback in this batch may have removed this fd
+        auto it = m_handlers.find(events[i].data.fd);
+        if (it == m_handlers.end()) {
+            continue;
+        }
+        // Copy so the handler may safely remove itself while running
+        FdCallback cb = it->second;
+        cb(events[i].events);
+    }
+    return n + timers;
+}
@@ -0,0 +1,74 @@
+/**
+ * Spider Robot v3.1 - Event Loop
+ *
+ * Minimal epoll reactor for the Brain daemon.
+ * File descriptors sit in one epoll set; periodic timers live in a
+ * TimerWheel whose next deadline becomes the epoll_wait() timeout, so the
+ * daemon sleeps in the kernel until there is real work to do and reads
+ * the clock once per wakeup however many timers are armed.
+ */
+
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+
+#include <sys/epoll.h>
+
+#include "timer_wheel.h"
+
+class EventLoop {
+public:
+    using FdCallback = std::function<void(uint32_t events)>;
+    using TimerCallback = TimerWheel::Callback;
+
+    EventLoop();
+    ~EventLoop();
+
+    bool init();
+    void close();
+
+    /**
+     * Watch a file descriptor. events is an EPOLL* mask.
+     */
+    bool addFd(int fd, uint32_t events, FdCallback cb);
+    bool modifyFd(int fd, uint32_t events);
+    void removeFd(int fd);
+
+    /**
+     * Create a periodic timer on the shared timebase. interval_ms == 0
+     * creates it disarmed. name labels its statistics.
+     * @return timer id
+     */
+    int addTimer(const char* name, uint32_t interval_ms, TimerCallback cb);
+
+    /**
+     * Re-arm a timer with a new period (0 = disarm).
+     */
+    bool setTimerInterval(int timer_id, uint32_t interval_ms);
+    void removeTimer(int timer_id);
+
+    /**
+     * Per-timer run counts and lateness.
+     */
+    const TimerWheel& timers() const { return m_timers; }
+
+    /**
+     * Wait for events or the next timer, then run the timers that are
+     * due followed by the fd callbacks.
+     * @param timeout_ms -1 blocks until an event, timer or signal
+     * @return number of dispatched events and timers, -1 on error
+     */
+    int runOnce(int timeout_ms = -1);
+
+private:
+    static constexpr int MAX_EVENTS = 32;
+
+    int m_epoll_fd = -1;
+    std::unordered_map<int, FdCallback> m_handlers;
+    TimerWheel m_timers;
+};
+
+#endif // EVENT_LOOP_H
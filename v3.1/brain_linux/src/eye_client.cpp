@@ -3,27 +3,31 @@
  */
 
 #include "eye_client.h"
+#include <algorithm>
 #include <iostream>
+#include <poll.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <cerrno>
 #include <cstring>
-#include <ctime>
 #include <cstdio>
 
 extern "C" {
-#include "eye_event_protocol.h"
+#include "limits.h"
+#include "timebase.h"
 }
 
-static uint64_t get_time_ms_ec() {
-    struct timespec ts;
-    clock_gettime(CLOCK_MONOTONIC, &ts);
-    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
-}
+// Queued bytes before state waits; edge events are always queued
+#define EYE_TX_STATE_LIMIT   4096
+#define EYE_FRAME_US         (1000000 / EYE_RENDER_FPS)
+#define EYE_TX_BATCH         16      // Datagrams per sendmmsg()
 
-EyeClient::EyeClient() : m_fd(-1), m_connect_attempted(false), m_last_connect_attempt(0) {
+EyeClient::EyeClient()
+    : m_state_sent_us(0), m_coalesced(0), m_json_only(false), m_binary(false),
+      m_block(nullptr), m_block_data(), m_woken_epoch(0), m_fd(-1), m_connect_attempted(false), m_last_connect_attempt(0) {
 }
 
 EyeClient::~EyeClient() {
@@ -35,105 +39,349 @@ bool EyeClient::connect() {
         return true;
     }
 
-    uint64_t now = get_time_ms_ec();
+    uint64_t now = timebase_millis64();
     if (m_connect_attempted && (now - m_last_connect_attempt) < 5000) {
         return false;
     }
     m_connect_attempted = true;
     m_last_connect_attempt = now;
 
-    m_fd = socket(AF_UNIX, SOCK_STREAM, 0);
-    if (m_fd < 0) {
-        std::cerr << "[EyeClient] socket() failed: " << strerror(errno) << std::endl;
-        return false;
+    if (!m_json_only && connectPacket()) {
+        m_binary = true;
+        std::cout << "[EyeClient] Connected to " << EYE_PACKET_SOCKET_PATH
+                  << (m_block ? " (binary, state block)" : " (binary)") << std::endl;
+        return true;
     }
+    if (connectStream()) {
+        m_binary = false;
+        std::cout << "[EyeClient] Connected to " << EYE_SOCKET_PATH << " (JSON)" << std::endl;
+        return true;
+    }
+    return false;
+}
 
-    int flags = fcntl(m_fd, F_GETFL, 0);
-    fcntl(m_fd, F_SETFL, flags | O_NONBLOCK);
-
+static bool connect_unix(int fd, const char* path) {
     struct sockaddr_un addr;
     memset(&addr, 0, sizeof(addr));
     addr.sun_family = AF_UNIX;
-    strncpy(addr.sun_path, EYE_SOCKET_PATH, sizeof(addr.sun_path) - 1);
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    return ::connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0 || errno == EINPROGRESS;
+}
+
+bool EyeClient::connectPacket() {
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if (fd < 0) {
+        return false;
+    }
+    if (!connect_unix(fd, EYE_PACKET_SOCKET_PATH)) {
+        close(fd);
+        return false;
+    }
+
+    // Offer a state block; an Eye Service without support just does not map it
+    EyeEventPacket hello = eye_event_make(EYE_EV_HELLO);
+    int block_fd = memfd_create("spider_eye_state", MFD_CLOEXEC);
+    void* block = MAP_FAILED;
+    if (block_fd >= 0 && ftruncate(block_fd, sizeof(EyeStateBlock)) == 0) {
+        block = mmap(nullptr, sizeof(EyeStateBlock), PROT_READ | PROT_WRITE, MAP_SHARED, block_fd, 0);
+    }
+    if (block != MAP_FAILED) {
+        eye_state_init((EyeStateBlock*)block);
+        hello.flags = EYE_HELLO_FLAG_STATE_BLOCK;
+    }
+
+    struct iovec iov = { &hello, sizeof(hello) };
+    struct msghdr msg = {};
+    union {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } ctrl;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    if (hello.flags & EYE_HELLO_FLAG_STATE_BLOCK) {
+        msg.msg_control = ctrl.buf;
+        msg.msg_controllen = sizeof(ctrl.buf);
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &block_fd, sizeof(int));
+    }
 
-    if (::connect(m_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
-        if (errno != EINPROGRESS) {
-            close(m_fd);
-            m_fd = -1;
-            return false;
+    // The Eye Service echoes the hello if it speaks this version
+    EyeEventPacket reply;
+    struct pollfd pfd = { fd, POLLIN, 0 };
+    bool ok = sendmsg(fd, &msg, MSG_NOSIGNAL) == (ssize_t)sizeof(hello) &&
+              poll(&pfd, 1, EYE_HELLO_TIMEOUT_MS) == 1 &&
+              recv(fd, &reply, sizeof(reply), 0) == (ssize_t)sizeof(reply) &&
+              reply.magic == EYE_PACKET_MAGIC && reply.version == EYE_PACKET_VERSION &&
+              reply.type == EYE_EV_HELLO;
+    if (block_fd >= 0) {
+        close(block_fd);        // The mappings keep it alive
+    }
+    if (block != MAP_FAILED && (!ok || !(reply.flags & EYE_HELLO_FLAG_STATE_BLOCK))) {
+        munmap(block, sizeof(EyeStateBlock));
+        block = MAP_FAILED;
+    }
+    if (!ok) {
+        close(fd);
+        return false;
+    }
+
+    int flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    m_fd = fd;
+
+    if (block != MAP_FAILED) {
+        m_block = (EyeStateBlock*)block;
+        m_block_data = EyeStateData();
+        m_woken_epoch = 0;
+        // Replay the latest state into the new block
+        for (State& st : m_state) {
+            if (st.set) applyToBlock(st.ev);
+            st.dirty = false;
         }
+        publishBlock();
+    }
+    return true;
+}
+
+void EyeClient::closeBlock() {
+    if (m_block) {
+        munmap(m_block, sizeof(EyeStateBlock));
+        m_block = nullptr;
+    }
+}
+
+void EyeClient::applyToBlock(const EyeEventPacket& ev) {
+    EyeStateData& d = m_block_data;
+    switch (ev.type) {
+    case EYE_EV_LOOK:
+        d.look_x = ev.x;
+        d.look_y = ev.y;
+        d.gen[EYE_STATE_LOOK]++;
+        break;
+    case EYE_EV_COLOR:
+        d.rgb565 = ev.rgb565;
+        d.gen[EYE_STATE_COLOR]++;
+        break;
+    case EYE_EV_MOOD:
+        d.mood = ev.mood;
+        d.gen[EYE_STATE_MOOD]++;
+        break;
+    case EYE_EV_IDLE:
+        d.idle = (ev.flags & EYE_FLAG_IDLE_ENABLED) ? 1 : 0;
+        d.gen[EYE_STATE_IDLE]++;
+        break;
+    case EYE_EV_BLINK:
+        d.gen[EYE_STATE_BLINK]++;
+        break;
+    default:
+        break;
+    }
+}
+
+void EyeClient::publishBlock() {
+    eye_state_write(m_block, &m_block_data);
+
+    // Pairs with the Eye Service's store of reader_sleep before its last read
+    EYE_STATE_FENCE();
+    uint32_t epoch = EYE_STATE_LOAD_ACQUIRE(&m_block->reader_sleep);
+    if (epoch != 0 && epoch != m_woken_epoch) {
+        m_woken_epoch = epoch;
+        m_edges.push_back(eye_event_make(EYE_EV_WAKE));
+        send(false);
+    }
+}
+
+bool EyeClient::connectStream() {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        std::cerr << "[EyeClient] socket() failed: " << strerror(errno) << std::endl;
+        return false;
     }
 
-    std::cout << "[EyeClient] Connected to " << EYE_SOCKET_PATH << std::endl;
+    int flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+
+    if (!connect_unix(fd, EYE_SOCKET_PATH)) {
+        close(fd);
+        return false;
+    }
+    m_fd = fd;
     return true;
 }
 
 void EyeClient::disconnect() {
+    closeBlock();
     if (m_fd >= 0) {
         close(m_fd);
         m_fd = -1;
         std::cout << "[EyeClient] Disconnected" << std::endl;
     }
+
+    // A restarted Eye Service gets the latest state again, but no stale edges
+    m_edges.clear();
+    m_tx.clear();
+    m_tx_packets.clear();
+    for (State& st : m_state) {
+        st.dirty = st.set;
+    }
 }
 
-bool EyeClient::sendEvent(const std::string& json) {
-    if (m_fd < 0) {
-        if (!connect()) {
-            return false;
+bool EyeClient::sendEvent(const EyeEventPacket& ev) {
+    if (m_fd < 0 && !connect()) {
+        return false;
+    }
+    m_edges.push_back(ev);
+    send(false);
+    return m_fd >= 0;
+}
+
+bool EyeClient::setState(StateSlot slot, const EyeEventPacket& ev) {
+    if (m_fd < 0 && !connect()) {
+        return false;
+    }
+    State& st = m_state[slot];
+    st.ev = ev;
+    st.set = true;
+    if (m_block) {
+        applyToBlock(ev);
+        publishBlock();
+        return m_fd >= 0;
+    }
+    if (st.dirty) m_coalesced++;
+    st.dirty = true;
+
+    // Sparse updates go out at once, a fast stream once per frame
+    if (timebase_micros() - m_state_sent_us >= EYE_FRAME_US) {
+        send(true);
+    }
+    return m_fd >= 0;
+}
+
+bool EyeClient::hasPending() const {
+    for (const State& st : m_state) {
+        if (st.dirty) return true;
+    }
+    return !m_edges.empty();
+}
+
+void EyeClient::flush() {
+    send(true);
+}
+
+void EyeClient::queue(const EyeEventPacket& ev) {
+    if (m_binary) {
+        m_tx_packets.push_back(ev);
+        return;
+    }
+    char line[EYE_EVENT_MAX_SIZE];
+    int len = eye_event_format_json(&ev, line, sizeof(line) - 1);
+    if (len <= 0) return;
+    line[len++] = '\n';
+    m_tx.append(line, (size_t)len);
+}
+
+void EyeClient::send(bool with_state) {
+    if (m_fd < 0) return;
+
+    // Behind whatever the socket has not taken yet: edges, then state
+    while (!m_edges.empty()) {
+        queue(m_edges.front());
+        m_edges.pop_front();
+    }
+    size_t backlog = m_tx.size() + m_tx_packets.size() * sizeof(EyeEventPacket);
+    if (with_state && backlog < EYE_TX_STATE_LIMIT) {
+        for (State& st : m_state) {
+            if (!st.dirty) continue;
+            queue(st.ev);
+            st.dirty = false;
         }
+        m_state_sent_us = timebase_micros();
     }
+    if (!wantsWrite()) return;
 
-    std::string msg = json + "\n";
-    ssize_t n = send(m_fd, msg.c_str(), msg.length(), MSG_NOSIGNAL);
-    if (n < 0) {
-        if (errno == EPIPE || errno == ECONNRESET) {
-            std::cerr << "[EyeClient] Connection lost" << std::endl;
-            disconnect();
+    uint64_t start_us = timebase_micros();
+    ssize_t n;
+    if (m_binary) {
+        // One datagram per event, all in one call
+        struct mmsghdr msgs[EYE_TX_BATCH];
+        struct iovec iov[EYE_TX_BATCH];
+        size_t count = std::min(m_tx_packets.size(), (size_t)EYE_TX_BATCH);
+        for (size_t i = 0; i < count; i++) {
+            iov[i].iov_base = &m_tx_packets[i];
+            iov[i].iov_len = sizeof(EyeEventPacket);
+            memset(&msgs[i], 0, sizeof(msgs[i]));
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
         }
-        return false;
+        n = sendmmsg(m_fd, msgs, (unsigned)count, MSG_NOSIGNAL);
+        if (n > 0) m_tx_packets.erase(m_tx_packets.begin(), m_tx_packets.begin() + n);
+    } else {
+        n = ::send(m_fd, m_tx.data(), m_tx.size(), MSG_NOSIGNAL);
+        if (n > 0) m_tx.erase(0, (size_t)n);
     }
+    m_send_latency.record(timebase_micros() - start_us);
 
-    return (size_t)n == msg.length();
+    // EAGAIN: everything stays queued until the socket drains
+    if (n < 0 && (errno == EPIPE || errno == ECONNRESET)) {
+        std::cerr << "[EyeClient] Connection lost" << std::endl;
+        disconnect();
+    }
 }
 
 bool EyeClient::setMood(const std::string& mood) {
-    char buf[EYE_EVENT_MAX_SIZE];
-    snprintf(buf, sizeof(buf), "{\"type\":\"mood\",\"mood\":\"%s\"}", mood.c_str());
-    return sendEvent(buf);
+    EyeEventPacket ev = eye_event_make(EYE_EV_MOOD);
+    for (uint8_t i = 0; i < EYE_MOOD_ID_COUNT; i++) {
+        if (mood == eye_mood_name(i)) ev.mood = i;
+    }
+    return setState(SLOT_MOOD, ev);
 }
 
 bool EyeClient::lookAt(float x, float y) {
-    char buf[EYE_EVENT_MAX_SIZE];
-    snprintf(buf, sizeof(buf), "{\"type\":\"look\",\"x\":%.3f,\"y\":%.3f}", x, y);
-    return sendEvent(buf);
+    EyeEventPacket ev = eye_event_make(EYE_EV_LOOK);
+    ev.x = x;
+    ev.y = y;
+    return setState(SLOT_LOOK, ev);
 }
 
 bool EyeClient::blink() {
-    return sendEvent("{\"type\":\"blink\"}");
+    EyeEventPacket ev = eye_event_make(EYE_EV_BLINK);
+    if (m_block && m_fd >= 0) {
+        applyToBlock(ev);
+        publishBlock();
+        return true;
+    }
+    return sendEvent(ev);
 }
 
 bool EyeClient::wink(const std::string& eye) {
-    char buf[EYE_EVENT_MAX_SIZE];
-    snprintf(buf, sizeof(buf), "{\"type\":\"wink\",\"eye\":\"%s\"}", eye.c_str());
-    return sendEvent(buf);
+    EyeEventPacket ev = eye_event_make(EYE_EV_WINK);
+    ev.eye = (eye == EYE_RIGHT) ? EYE_ID_RIGHT : EYE_ID_LEFT;
+    return sendEvent(ev);
 }
 
 bool EyeClient::setIrisColor(uint16_t rgb565) {
-    char buf[EYE_EVENT_MAX_SIZE];
-    snprintf(buf, sizeof(buf), "{\"type\":\"color\",\"rgb565\":%u}", rgb565);
-    return sendEvent(buf);
+    EyeEventPacket ev = eye_event_make(EYE_EV_COLOR);
+    ev.rgb565 = rgb565;
+    return setState(SLOT_COLOR, ev);
 }
 
 bool EyeClient::setIdleEnabled(bool enabled) {
-    char buf[EYE_EVENT_MAX_SIZE];
-    snprintf(buf, sizeof(buf), "{\"type\":\"idle\",\"enabled\":%s}", enabled ? "true" : "false");
-    return sendEvent(buf);
+    EyeEventPacket ev = eye_event_make(EYE_EV_IDLE);
+    ev.flags = enabled ? EYE_FLAG_IDLE_ENABLED : 0;
+    return setState(SLOT_IDLE, ev);
 }
 
 bool EyeClient::sendEstop() {
-    return sendEvent("{\"type\":\"estop\"}");
+    return sendEvent(eye_event_make(EYE_EV_ESTOP));
 }
 
 bool EyeClient::requestStatus() {
-    return sendEvent("{\"type\":\"status\"}");
+    return sendEvent(eye_event_make(EYE_EV_STATUS));
+}
+
+bool EyeClient::displayStatus(EyeDisplayStatus* out) const {
+    return m_block && eye_display_status_read(m_block, out) == 0;
 }
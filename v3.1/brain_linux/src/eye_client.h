@@ -2,13 +2,32 @@
  * Spider Robot v3.1 - Eye Client
  * 
  * Brain Daemon → Eye Service Unix socket client.
+ *
+ * State events (look, color, mood, idle) only keep their latest value
+ * and go out at most once per eye frame (EYE_RENDER_FPS), so a client
+ * streaming gaze targets faster than the panels render does not flood
+ * the Eye Service. Edge events (blink, wink, estop, status) are queued
+ * in order, are never coalesced, and are sent first.
+ *
+ * Events go out as EyeEventPacket datagrams when the Eye Service accepts
+ * the hello on its SOCK_SEQPACKET socket, as JSON lines otherwise. If it
+ * also maps the EyeStateBlock passed with the hello, state and blinks
+ * are written there instead, without a syscall.
  */
 
 #ifndef EYE_CLIENT_H
 #define EYE_CLIENT_H
 
+#include <cstdint>
+#include <deque>
 #include <string>
-#include <atomic>
+
+#include "latency_histogram.h"
+
+extern "C" {
+#include "eye_event_protocol.h"
+#include "eye_state_block.h"
+}
 
 class EyeClient {
 public:
@@ -31,9 +50,43 @@ public:
     bool isConnected() const { return m_fd >= 0; }
 
     /**
-     * Send raw JSON event.
+     * Skip negotiation and always use the JSON socket (debugging).
+     */
+    void setJsonOnly(bool json_only) { m_json_only = json_only; }
+
+    /**
+     * Connected over the binary packet socket.
+     */
+    bool isBinary() const { return m_fd >= 0 && m_binary; }
+
+    /**
+     * State goes through the shared EyeStateBlock.
      */
-    bool sendEvent(const std::string& json);
+    bool hasStateBlock() const { return m_block != nullptr; }
+
+    /**
+     * Socket fd for event loop registration (-1 when disconnected).
+     */
+    int getFd() const { return m_fd; }
+
+    /**
+     * Queue an edge event and try to send it.
+     * @return false if not connected
+     */
+    bool sendEvent(const EyeEventPacket& ev);
+
+    /**
+     * Send what is queued, the latest state included. Call once per eye
+     * frame while hasPending(), and when the socket is writable again.
+     */
+    void flush();
+
+    // Coalesced state waiting for the next frame
+    bool hasPending() const;
+    // Socket full: wait for EPOLLOUT before flushing again
+    bool wantsWrite() const { return !m_tx.empty() || !m_tx_packets.empty(); }
+    // State updates replaced before they were sent
+    uint32_t coalescedCount() const { return m_coalesced; }
 
     // High-level API
     bool setMood(const std::string& mood);
@@ -45,10 +98,54 @@ public:
     bool sendEstop();
     bool requestStatus();
 
+    /**
+     * The Eye Service's latest display status (SPI clock, frame timing)
+     * from the state block. False without a block or before the first
+     * status was published.
+     */
+    bool displayStatus(EyeDisplayStatus* out) const;
+
+    /**
+     * Time spent in send() per event, in us. The Eye Service does not
+     * reply, so this is the Brain's side of an eye command.
+     */
+    const LatencyHistogram& sendLatency() const { return m_send_latency; }
+
 private:
+    enum StateSlot { SLOT_LOOK, SLOT_COLOR, SLOT_MOOD, SLOT_IDLE, SLOT_COUNT };
+
+    struct State {
+        EyeEventPacket ev;      // Latest value
+        bool set = false;
+        bool dirty = false;
+    };
+
+    bool connectPacket();
+    bool connectStream();
+    bool setState(StateSlot slot, const EyeEventPacket& ev);
+    void applyToBlock(const EyeEventPacket& ev);
+    void publishBlock();
+    void closeBlock();
+    void send(bool with_state);
+    void queue(const EyeEventPacket& ev);
+
+    State m_state[SLOT_COUNT];
+    std::deque<EyeEventPacket> m_edges;
+    std::string m_tx;                           // JSON: bytes not yet accepted
+    std::deque<EyeEventPacket> m_tx_packets;    // Binary: datagrams not yet accepted
+    uint64_t m_state_sent_us;
+    uint32_t m_coalesced;
+    bool m_json_only;
+    bool m_binary;
+
+    EyeStateBlock* m_block;     // Mapped memfd, nullptr when not negotiated
+    EyeStateData m_block_data;  // What the block holds
+    uint32_t m_woken_epoch;     // Last reader_sleep answered with EYE_EV_WAKE
+
     int m_fd;
     bool m_connect_attempted;
     uint64_t m_last_connect_attempt;
+    LatencyHistogram m_send_latency;
 };
 
 #endif // EYE_CLIENT_H
@@ -0,0 +1,228 @@
+/**
+ * Spider Robot v3.1 - Gait Engine Implementation
+ */
+
+#include "gait_engine.h"
+
+#include <cmath>
+#include <cstring>
+
+extern "C" {
+#include "limits.h"
+}
+
+// Gait tables: cycle phase at which each leg starts its swing, and the
+// fraction of the cycle it spends on the ground
+struct GaitShape {
+    float offset[GAIT_LEG_COUNT];
+    float duty;
+};
+
+static const GaitShape s_shapes[] = {
+    { { 0.0f, 0.5f, 0.5f, 0.0f }, 0.5f },       // TRIPOD: FR+RL, then FL+RR
+    { { 0.75f, 0.5f, 0.25f, 0.0f }, 0.75f },    // WAVE: RL, RR, FL, FR
+    { { 0.0f, 0.5f, 0.75f, 0.25f }, 0.625f },   // RIPPLE: FR, RL, FL, RR, swings overlapping
+};
+
+// Body motion per cycle at stride factor 1.0 and full dir or turn. The
+// coxa sweep moves each foot GAIT_FOOT_REACH_MM * sweep along an arc
+// about its hip; with the hips at 45 degrees that is cos(45) of it along
+// x, and the whole of it around the body centre.
+static const float s_sweep_rad = GAIT_STRIDE_US * (float)M_PI / (SERVO_PWM_MAX_US - SERVO_PWM_MIN_US);
+static const float s_foot_x_mm = SpiderModel::HIP_X_MM + GAIT_FOOT_REACH_MM * (float)M_SQRT1_2;
+static const float s_foot_y_mm = SpiderModel::HIP_Y_MM + GAIT_FOOT_REACH_MM * (float)M_SQRT1_2;
+static const float s_cycle_mm = GAIT_FOOT_REACH_MM * s_sweep_rad * (float)M_SQRT1_2;
+static const float s_cycle_rad = GAIT_FOOT_REACH_MM * s_sweep_rad /
+                                 std::sqrt(s_foot_x_mm * s_foot_x_mm + s_foot_y_mm * s_foot_y_mm);
+
+static float clampf(float v, float lo, float hi) {
+    if (v < lo) return lo;
+    if (v > hi) return hi;
+    return v;
+}
+
+const char* GaitEngine::gaitName(Gait gait) {
+    switch (gait) {
+        case Gait::TRIPOD: return "tripod";
+        case Gait::WAVE:   return "wave";
+        case Gait::RIPPLE: return "ripple";
+    }
+    return "unknown";
+}
+
+bool GaitEngine::parseGait(const char* name, Gait& out) {
+    if (strcmp(name, "tripod") == 0) out = Gait::TRIPOD;
+    else if (strcmp(name, "wave") == 0) out = Gait::WAVE;
+    else if (strcmp(name, "ripple") == 0) out = Gait::RIPPLE;
+    else return false;
+    return true;
+}
+
+void GaitEngine::setParams(const Params& params) {
+    float dir = clampf(params.dir, -1.0f, 1.0f);
+    float turn = clampf(params.turn, -1.0f, 1.0f);
+
+    // Stopping keeps gait and speed so the last keyframe is paced like the others
+    if (std::fabs(dir) < 0.01f && std::fabs(turn) < 0.01f) {
+        m_params.dir = 0.0f;
+        m_params.turn = 0.0f;
+        if (m_state == State::WALKING) m_state = State::STOPPING;
+        return;
+    }
+
+    m_params.gait = params.gait;
+    m_params.dir = dir;
+    m_params.turn = turn;
+    m_params.speed = clampf(params.speed, GAIT_SPEED_MIN, GAIT_SPEED_MAX);
+    m_params.stride = clampf(params.stride, STRIDE_FACTOR_MIN, STRIDE_FACTOR_MAX);
+
+    // Blend from the cycle the legs are in, unless they are at rest
+    uint32_t key = cycleKey(m_params);
+    if (m_state == State::WALKING && key != m_key) {
+        m_blend_key = m_key;
+        m_blend_left = GAIT_BLEND_KEYFRAMES;
+    } else if (m_state != State::WALKING) {
+        m_blend_left = 0;
+    }
+    m_key = key;
+
+    if (m_state == State::IDLE) m_step = 0;
+    m_state = State::WALKING;
+}
+
+void GaitEngine::reset() {
+    m_state = State::IDLE;
+    m_step = 0;
+    m_blend_left = 0;
+    m_params.dir = 0.0f;
+    m_params.turn = 0.0f;
+}
+
+void GaitEngine::legPose(Gait gait, int leg, float phase, float amplitude, uint16_t& coxa, uint16_t& femur) {
+    const GaitShape& shape = s_shapes[(int)gait];
+    float swing = 1.0f - shape.duty;
+
+    float local = phase - shape.offset[leg];
+    local -= std::floor(local);
+
+    // Swing carries the coxa from -1/2 to +1/2 of the stride with the femur
+    // lifted; stance pushes it back on the ground
+    float pos;
+    float lift = 0.0f;
+    if (local < swing) {
+        float s = local / swing;
+        pos = s - 0.5f;
+        lift = std::sin((float)M_PI * s);
+    } else {
+        pos = 0.5f - (local - swing) / shape.duty;
+    }
+
+    coxa = clamp_servo_us((uint16_t)std::lround(SERVO_PWM_NEUTRAL_US + amplitude * pos));
+    femur = clamp_servo_us((uint16_t)std::lround(SERVO_PWM_NEUTRAL_US - GAIT_LIFT_US * lift));
+}
+
+// Gait, quantized dir and turn (offset to stay positive) and stride, in
+// a byte each; never 0, which marks an empty entry
+uint32_t GaitEngine::cycleKey(const Params& params) {
+    uint32_t dir = (uint32_t)std::lround(params.dir / GAIT_CACHE_QUANTUM + 100.0f);
+    uint32_t turn = (uint32_t)std::lround(params.turn / GAIT_CACHE_QUANTUM + 100.0f);
+    uint32_t stride = (uint32_t)std::lround(params.stride / GAIT_CACHE_QUANTUM);
+    return ((uint32_t)params.gait + 1) << 24 | dir << 16 | turn << 8 | stride;
+}
+
+// Cache entry for key, computing it over the least recently used one on a miss
+int GaitEngine::cycle(uint32_t key) {
+    int victim = 0;
+    for (int i = 0; i < GAIT_CACHE_CYCLES; i++) {
+        if (m_cache[i].key == key) {
+            m_cache[i].used = ++m_cache_clock;
+            m_cache_hits++;
+            return i;
+        }
+        if (m_cache[i].used < m_cache[victim].used) victim = i;
+    }
+
+    Cycle& c = m_cache[victim];
+    c.key = key;
+    c.used = ++m_cache_clock;
+    fillCycle(c);
+    m_cache_misses++;
+    return victim;
+}
+
+void GaitEngine::fillCycle(Cycle& c) const {
+    Gait gait = (Gait)((c.key >> 24) - 1);
+    float dir = ((int)((c.key >> 16) & 0xFF) - 100) * GAIT_CACHE_QUANTUM;
+    float turn = ((int)((c.key >> 8) & 0xFF) - 100) * GAIT_CACHE_QUANTUM;
+    float stride = (c.key & 0xFF) * GAIT_CACHE_QUANTUM;
+
+    // Right legs (0, 2) shorten their stride to turn right, left legs (1, 3) lengthen it
+    float right = clampf(dir - turn, -1.0f, 1.0f);
+    float left = clampf(dir + turn, -1.0f, 1.0f);
+    for (uint32_t step = 0; step < GAIT_KEYFRAMES_PER_CYCLE; step++) {
+        float phase = (float)step / GAIT_KEYFRAMES_PER_CYCLE;
+        uint16_t* us = c.leg_us[step];
+        for (int leg = 0; leg < GAIT_LEG_COUNT; leg++) {
+            float side = SpiderModel::isLeft(leg) ? left : right;
+            float amplitude = GAIT_STRIDE_US * stride * side;
+            legPose(gait, leg, phase, amplitude, us[SpiderModel::channel(leg, SpiderModel::COXA)],
+                    us[SpiderModel::channel(leg, SpiderModel::FEMUR)]);
+        }
+    }
+}
+
+// One keyframe's share of the cycle, side amplitudes as in next()
+void GaitEngine::advanceOdometry(float right, float left) {
+    float share = m_params.stride / GAIT_KEYFRAMES_PER_CYCLE;
+    float forward = (right + left) * 0.5f * s_cycle_mm * share;
+    float yaw = (right - left) * 0.5f * s_cycle_rad * share;
+
+    // Midpoint heading: a turning walk follows the arc, not its chord
+    float mid = m_odometry.heading_rad + yaw * 0.5f;
+    m_odometry.x_mm += forward * std::cos(mid);
+    m_odometry.y_mm += forward * std::sin(mid);
+    m_odometry.heading_rad = std::remainder(m_odometry.heading_rad + yaw, 2.0f * (float)M_PI);
+}
+
+bool GaitEngine::next(uint16_t* leg_us, uint32_t& t_ms) {
+    uint32_t step_ms = (uint32_t)std::lround(GAIT_CYCLE_MS / m_params.speed / GAIT_KEYFRAMES_PER_CYCLE);
+
+    switch (m_state) {
+        case State::IDLE:
+            return false;
+
+        case State::STOPPING:
+            for (int i = 0; i < GAIT_LEG_CHANNELS; i++) {
+                leg_us[i] = SERVO_PWM_NEUTRAL_US;
+            }
+            t_ms = step_ms * 2;
+            m_state = State::IDLE;
+            m_step = 0;
+            return true;
+
+        case State::WALKING:
+            break;
+    }
+
+    if (m_blend_left > 0) {
+        // Look both up before reading either: a miss may evict
+        int from = cycle(m_blend_key);
+        int to = cycle(m_key);
+        const uint16_t* old_us = m_cache[from].leg_us[m_step];
+        const uint16_t* new_us = m_cache[to].leg_us[m_step];
+        float w = (float)(GAIT_BLEND_KEYFRAMES - m_blend_left + 1) / (GAIT_BLEND_KEYFRAMES + 1);
+        for (int i = 0; i < GAIT_LEG_CHANNELS; i++) {
+            leg_us[i] = (uint16_t)std::lround(old_us[i] + w * ((int)new_us[i] - (int)old_us[i]));
+        }
+        m_blend_left--;
+    } else {
+        memcpy(leg_us, m_cache[cycle(m_key)].leg_us[m_step], sizeof(uint16_t) * GAIT_LEG_CHANNELS);
+    }
+
+    float right = clampf(m_params.dir - m_params.turn, -1.0f, 1.0f);
+    float left = clampf(m_params.dir + m_params.turn, -1.0f, 1.0f);
+    advanceOdometry(right, left);
+    t_ms = step_ms;
+    m_step = (m_step + 1) % GAIT_KEYFRAMES_PER_CYCLE;
+    return true;
+}
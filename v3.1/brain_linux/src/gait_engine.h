@@ -0,0 +1,150 @@
+#ifndef GAIT_ENGINE_H
+#define GAIT_ENGINE_H
+
+#include <cstdint>
+
+#include "robot_model.h"
+
+/**
+ * GaitEngine - Keyframe generator for walking gaits
+ *
+ * Produces leg keyframes (coxa and femur of the four legs, channels 0-7)
+ * for tripod, wave and ripple gaits. Each gait is a set of per-leg phase
+ * offsets plus a duty factor: during its swing a leg lifts its femur
+ * and carries the coxa forward across the stride, during stance it holds
+ * the femur down and pushes the coxa back. Sampling the cycle at fixed
+ * steps gives keyframes the Muscle joins with Hermite segments, so a
+ * handful per cycle is enough for smooth motion.
+ *
+ * A cycle's keyframes depend only on gait, dir, turn and stride (speed
+ * just spaces them), so each distinct cycle is computed once into a
+ * small LRU cache and steady walking copies keyframes out of it. dir,
+ * turn and stride are keyed in GAIT_CACHE_QUANTUM steps, under a
+ * microsecond of coxa sweep. A change of cycle mid-walk blends from the
+ * old cycle to the new one over GAIT_BLEND_KEYFRAMES keyframes, both
+ * read from the cache.
+ *
+ * Owned by the motion thread, which schedules the keyframes in the
+ * shared ring ahead of time; nothing here touches the clock or the bus.
+ *
+ * Leg layout (top view), as in python/gait_library.py:
+ *     FL(1)  FR(0)
+ *     RL(3)  RR(2)
+ */
+#define GAIT_LEG_COUNT          SpiderModel::LEGS
+#define GAIT_LEG_CHANNELS       SpiderModel::PAIR_CHANNELS
+#define GAIT_LEG_MASK           ((uint16_t)SpiderModel::PAIR_MASK)
+
+#define GAIT_CYCLE_MS           1200    // One full cycle at speed 1.0
+#define GAIT_KEYFRAMES_PER_CYCLE 16
+#define GAIT_STRIDE_US          150     // Coxa sweep at stride factor 1.0
+#define GAIT_LIFT_US            200     // Femur lift at mid-swing
+#define GAIT_SPEED_MIN          0.5f
+#define GAIT_SPEED_MAX          2.0f
+#define GAIT_CACHE_CYCLES       8       // Distinct cycles kept
+#define GAIT_CACHE_QUANTUM      0.01f   // Key step of dir, turn and stride
+#define GAIT_BLEND_KEYFRAMES    4       // Old to new cycle after a change
+#define GAIT_FOOT_REACH_MM      (SpiderModel::COXA_MM + SpiderModel::FEMUR_MM)  // Coxa axis to foot, tibia upright
+
+class GaitEngine {
+public:
+    enum class Gait {
+        TRIPOD,     // Diagonal pairs, fastest
+        WAVE,       // One leg at a time, most stable
+        RIPPLE      // Staggered, two legs overlapping in swing
+    };
+
+    /**
+     * dir and turn are -1..1: dir > 0 walks forward, turn > 0 turns
+     * clockwise (right). Both 0 stops. speed scales the cycle rate
+     * (GAIT_SPEED_MIN..MAX), stride the step length
+     * (STRIDE_FACTOR_MIN..MAX); out-of-range values are clamped.
+     */
+    struct Params {
+        Gait gait = Gait::TRIPOD;
+        float dir = 0.0f;
+        float turn = 0.0f;
+        float speed = 1.0f;
+        float stride = 1.0f;
+    };
+
+    /**
+     * Dead-reckoned body pose since the last resetOdometry(), integrated
+     * from the commanded strides of every walking keyframe (no slip, no
+     * sensing). Frame as in robot_model.h: x forward, y left, heading
+     * counter-clockwise in radians from the initial heading.
+     */
+    struct Odometry {
+        float x_mm = 0.0f;
+        float y_mm = 0.0f;
+        float heading_rad = 0.0f;
+    };
+
+    static const char* gaitName(Gait gait);
+    static bool parseGait(const char* name, Gait& out);
+
+    /**
+     * Apply new parameters from the next keyframe on. Starting from
+     * rest begins a new cycle; stopping (dir = turn = 0, other fields
+     * ignored) finishes with one keyframe back to the neutral stance.
+     */
+    void setParams(const Params& params);
+
+    /**
+     * Drop the gait immediately (E-STOP, manual leg pose).
+     */
+    void reset();
+
+    const Params& params() const { return m_params; }
+
+    /**
+     * Pose reached at the end of the last keyframe returned by next().
+     */
+    const Odometry& odometry() const { return m_odometry; }
+    void resetOdometry() { m_odometry = Odometry(); }
+
+    // Cycle cache: walking keyframes copied out, cycles computed
+    uint32_t cacheHits() const { return m_cache_hits; }
+    uint32_t cacheMisses() const { return m_cache_misses; }
+
+    /**
+     * True while keyframes remain, including the final stand keyframe.
+     */
+    bool active() const { return m_state != State::IDLE; }
+
+    /**
+     * Next keyframe: servo pulse widths for channels 0..GAIT_LEG_CHANNELS-1
+     * and the time to reach them. Returns false when idle.
+     */
+    bool next(uint16_t* leg_us, uint32_t& t_ms);
+
+private:
+    enum class State { IDLE, WALKING, STOPPING };
+
+    static void legPose(Gait gait, int leg, float phase, float amplitude, uint16_t& coxa, uint16_t& femur);
+    void advanceOdometry(float right, float left);
+
+    struct Cycle {
+        uint32_t key;           // 0 = empty
+        uint32_t used;          // LRU stamp
+        uint16_t leg_us[GAIT_KEYFRAMES_PER_CYCLE][GAIT_LEG_CHANNELS];
+    };
+
+    static uint32_t cycleKey(const Params& params);
+    int cycle(uint32_t key);
+    void fillCycle(Cycle& c) const;
+
+    Params m_params;
+    Cycle m_cache[GAIT_CACHE_CYCLES] = {};
+    uint32_t m_cache_clock = 0;
+    uint32_t m_cache_hits = 0;
+    uint32_t m_cache_misses = 0;
+    uint32_t m_key = 0;         // Current params' cycle
+    uint32_t m_blend_key = 0;   // Cycle blended from, 0 = none
+    int m_blend_left = 0;
+    Odometry m_odometry;
+    State m_state = State::IDLE;
+    uint32_t m_step = 0;        // Keyframe index within the cycle
+};
+
+#endif // GAIT_ENGINE_H
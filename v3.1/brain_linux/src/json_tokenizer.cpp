@@ -0,0 +1,274 @@
+/**
+ * Spider Robot v3.1 - JSON Tokenizer Implementation
+ */
+
+#include "json_tokenizer.h"
+
+#include <cstdlib>
+#include <cstring>
+
+static const char* skip_ws(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) p++;
+    return p;
+}
+
+// p points at the opening quote; returns one past the closing quote
+static const char* scan_string(const char* p, const char* end) {
+    p++;
+    while (p < end) {
+        if (*p == '\\') {
+            p += 2;
+        } else if (*p == '"') {
+            return p + 1;
+        } else {
+            p++;
+        }
+    }
+    return nullptr;
+}
+
+// p points at '['; returns one past the matching ']'
+static const char* scan_array(const char* p, const char* end) {
+    int depth = 0;
+    while (p < end) {
+        if (*p == '"') {
+            p = scan_string(p, end);
+            if (!p) return nullptr;
+            continue;
+        }
+        if (*p == '[') depth++;
+        else if (*p == ']' && --depth == 0) return p + 1;
+        p++;
+    }
+    return nullptr;
+}
+
+// p points at '{'; returns one past the matching '}'
+static const char* scan_object(const char* p, const char* end) {
+    int depth = 0;
+    while (p < end) {
+        if (*p == '"') {
+            p = scan_string(p, end);
+            if (!p) return nullptr;
+            continue;
+        }
+        if (*p == '{') depth++;
+        else if (*p == '}' && --depth == 0) return p + 1;
+        p++;
+    }
+    return nullptr;
+}
+
+bool JsonTokens::parse(const char* data, size_t len) {
+    m_count = 0;
+    if (len > UINT32_MAX) return false;     // Spans would not fit a token
+    const char* p = data;
+    const char* end = data + len;
+
+    p = skip_ws(p, end);
+    if (p >= end || *p != '{') return false;
+    p++;
+    int depth = 1;
+
+    while (true) {
+        p = skip_ws(p, end);
+        if (p >= end) return false;
+
+        if (*p == '}') {
+            p++;
+            if (--depth == 0) return true;
+            p = skip_ws(p, end);
+            if (p < end && *p == ',') p++;
+            continue;
+        }
+
+        if (*p != '"') return false;
+        JsonToken tok;
+        tok.key = p + 1;
+        p = scan_string(p, end);
+        if (!p) return false;
+        tok.key_len = (uint32_t)(p - 1 - tok.key);
+
+        p = skip_ws(p, end);
+        if (p >= end || *p != ':') return false;
+        p = skip_ws(p + 1, end);
+        if (p >= end) return false;
+
+        tok.val = p;
+        if (*p == '"') {
+            tok.type = JsonType::STRING;
+            tok.val = p + 1;
+            p = scan_string(p, end);
+            if (!p) return false;
+            tok.val_len = (uint32_t)(p - 1 - tok.val);
+        } else if (*p == '{') {
+            tok.type = JsonType::OBJECT;
+            tok.val_len = 0;
+            if (m_count < MAX_TOKENS) m_tokens[m_count++] = tok;
+            p++;
+            depth++;
+            continue;
+        } else if (*p == '[') {
+            tok.type = JsonType::ARRAY;
+            p = scan_array(p, end);
+            if (!p) return false;
+            tok.val_len = (uint32_t)(p - tok.val);
+        } else {
+            while (p < end && *p != ',' && *p != '}' && *p != ']' &&
+                   *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') {
+                p++;
+            }
+            tok.val_len = (uint32_t)(p - tok.val);
+            if (tok.val_len == 0) return false;
+            if (tok.val[0] == 't' || tok.val[0] == 'f') tok.type = JsonType::BOOL;
+            else if (tok.val[0] == 'n') tok.type = JsonType::NUL;
+            else tok.type = JsonType::NUMBER;
+        }
+
+        if (m_count < MAX_TOKENS) m_tokens[m_count++] = tok;
+
+        p = skip_ws(p, end);
+        if (p >= end) return false;
+        if (*p == ',') {
+            p++;
+        } else if (*p != '}') {
+            return false;
+        }
+    }
+}
+
+const JsonToken* JsonTokens::find(const char* key) const {
+    size_t key_len = strlen(key);
+    for (int i = 0; i < m_count; i++) {
+        const JsonToken& t = m_tokens[i];
+        if (t.key_len == key_len && memcmp(t.key, key, key_len) == 0) {
+            return &t;
+        }
+    }
+    return nullptr;
+}
+
+bool JsonTokens::isString(const char* key, const char* value) const {
+    const JsonToken* t = find(key);
+    if (!t || t->type != JsonType::STRING) return false;
+    size_t len = strlen(value);
+    return t->val_len == len && memcmp(t->val, value, len) == 0;
+}
+
+int JsonTokens::getInt(const char* key, int default_val) const {
+    const JsonToken* t = find(key);
+    if (!t || t->type != JsonType::NUMBER) return default_val;
+
+    const char* p = t->val;
+    const char* end = t->val + t->val_len;
+    bool neg = false;
+    if (*p == '-') { neg = true; p++; }
+    int val = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        val = val * 10 + (*p - '0');
+        p++;
+    }
+    return neg ? -val : val;
+}
+
+float JsonTokens::getFloat(const char* key, float default_val) const {
+    const JsonToken* t = find(key);
+    if (!t || t->type != JsonType::NUMBER) return default_val;
+
+    char buf[32];
+    size_t len = t->val_len < sizeof(buf) - 1 ? t->val_len : sizeof(buf) - 1;
+    memcpy(buf, t->val, len);
+    buf[len] = '\0';
+    return strtof(buf, nullptr);
+}
+
+bool JsonTokens::getBool(const char* key, bool default_val) const {
+    const JsonToken* t = find(key);
+    if (!t || t->type != JsonType::BOOL) return default_val;
+    return t->val[0] == 't';
+}
+
+bool JsonTokens::getString(const char* key, char* out, size_t out_size) const {
+    const JsonToken* t = find(key);
+    if (!t || t->type != JsonType::STRING || out_size == 0) return false;
+    size_t len = t->val_len < out_size - 1 ? t->val_len : out_size - 1;
+    memcpy(out, t->val, len);
+    out[len] = '\0';
+    return true;
+}
+
+int JsonTokens::getUintArray(const char* key, uint16_t* out, int max_count) const {
+    const JsonToken* t = find(key);
+    if (!t || t->type != JsonType::ARRAY) return 0;
+
+    const char* p = t->val + 1;
+    const char* end = t->val + t->val_len;
+    int count = 0;
+    while (p < end && count < max_count) {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == ',')) p++;
+        if (p >= end || *p < '0' || *p > '9') break;
+        int val = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+            val = val * 10 + (*p - '0');
+            p++;
+        }
+        out[count++] = (uint16_t)val;
+    }
+    return count;
+}
+
+int JsonTokens::getFloatArray(const char* key, float* out, int max_count) const {
+    const JsonToken* t = find(key);
+    if (!t || t->type != JsonType::ARRAY) return 0;
+
+    const char* p = t->val + 1;
+    const char* end = t->val + t->val_len;
+    int count = 0;
+    while (p < end && count < max_count) {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == ',')) p++;
+        const char* start = p;
+        while (p < end && ((*p >= '0' && *p <= '9') || *p == '-' || *p == '+' ||
+                           *p == '.' || *p == 'e' || *p == 'E')) {
+            p++;
+        }
+        size_t len = (size_t)(p - start);
+        if (len == 0 || len >= 32) break;
+
+        char buf[32];
+        memcpy(buf, start, len);
+        buf[len] = '\0';
+        char* parsed;
+        out[count] = strtof(buf, &parsed);
+        if (parsed != buf + len) break;
+        count++;
+    }
+    return count;
+}
+
+bool JsonTokens::nextObject(const JsonToken& array, const char*& cursor,
+                            const char*& obj, size_t& obj_len) {
+    if (array.type != JsonType::ARRAY) return false;
+    // Inside the brackets
+    const char* end = array.val + array.val_len - 1;
+    const char* p = skip_ws(cursor ? cursor : array.val + 1, end);
+    if (cursor && p < end && *p == ',') {
+        p = skip_ws(p + 1, end);
+    } else if (cursor && p < end) {
+        cursor = p;
+        return false;
+    }
+    if (p >= end) {
+        cursor = nullptr;
+        return false;
+    }
+
+    const char* close = *p == '{' ? scan_object(p, end) : nullptr;
+    if (!close) {
+        cursor = p;
+        return false;
+    }
+    obj = p;
+    obj_len = (size_t)(close - p);
+    cursor = close;
+    return true;
+}
@@ -0,0 +1,110 @@
+/**
+ * Spider Robot v3.1 - JSON Tokenizer
+ *
+ * Single-pass, allocation-free scanner for the WebSocket command
+ * protocol. One parse() walks the message once and records key/value
+ * spans into a fixed array. Nested objects are flattened, so
+ * {"profile":{"min_deg":30}} is found with find("min_deg"), which
+ * matches the old substring-based lookups.
+ *
+ * Spans point into the caller's buffer, which must outlive the tokens.
+ */
+
+#ifndef JSON_TOKENIZER_H
+#define JSON_TOKENIZER_H
+
+#include <cstddef>
+#include <cstdint>
+
+enum class JsonType : uint8_t {
+    STRING,     // span excludes quotes, escapes left as-is
+    NUMBER,
+    BOOL,
+    NUL,
+    ARRAY,      // span includes brackets
+    OBJECT      // members follow as their own tokens
+};
+
+// Spans are 32-bit: a batch may carry more than 64 KB of commands
+struct JsonToken {
+    const char* key;
+    uint32_t key_len;
+    JsonType type;
+    const char* val;
+    uint32_t val_len;
+};
+
+class JsonTokens {
+public:
+    static constexpr int MAX_TOKENS = 32;
+
+    /**
+     * Tokenize one JSON object. Keys beyond MAX_TOKENS are ignored.
+     * @return false on malformed input or len over UINT32_MAX
+     */
+    bool parse(const char* data, size_t len);
+
+    int count() const { return m_count; }
+    const JsonToken& at(int i) const { return m_tokens[i]; }
+
+    /**
+     * First token with the given key, or nullptr.
+     */
+    const JsonToken* find(const char* key) const;
+
+    bool isString(const char* key, const char* value) const;
+    int getInt(const char* key, int default_val) const;
+    float getFloat(const char* key, float default_val) const;
+    bool getBool(const char* key, bool default_val) const;
+
+    /**
+     * Copy a string value into out (NUL-terminated, truncated to fit).
+     */
+    bool getString(const char* key, char* out, size_t out_size) const;
+
+    /**
+     * Parse an array of unsigned integers.
+     * @return number of values written
+     */
+    int getUintArray(const char* key, uint16_t* out, int max_count) const;
+
+    /**
+     * Parse an array of numbers (sign, fraction and exponent allowed).
+     * @return number of values written
+     */
+    int getFloatArray(const char* key, float* out, int max_count) const;
+
+    /**
+     * Step through the objects of an ARRAY token: start with cursor
+     * nullptr; each call sets the span of the next element.
+     * @return false at the end (cursor nullptr) or at an element that
+     *         is not an object (cursor left pointing at it)
+     */
+    static bool nextObject(const JsonToken& array, const char*& cursor,
+                           const char*& obj, size_t& obj_len);
+
+private:
+    JsonToken m_tokens[MAX_TOKENS];
+    int m_count = 0;
+};
+
+/**
+ * FNV-1a, usable at compile time for dispatch tables.
+ */
+constexpr uint32_t json_hash(const char* s, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ (uint8_t)s[i]) * 16777619u;
+    }
+    return h;
+}
+
+constexpr size_t json_strlen(const char* s) {
+    return *s ? 1 + json_strlen(s + 1) : 0;
+}
+
+constexpr uint32_t json_hash(const char* s) {
+    return json_hash(s, json_strlen(s));
+}
+
+#endif // JSON_TOKENIZER_H
@@ -0,0 +1,118 @@
+/**
+ * Spider Robot v3.1 - Latency Histogram
+ *
+ * HDR-style log-linear histogram of microsecond latencies: every power
+ * of two is split into 16 linear buckets, so any reported value is
+ * within 1/16 (about 6%) of the true one from 1 us up to over an hour,
+ * in under 2 KB. record() is a couple of relaxed atomic adds, safe from
+ * any thread including the RT motion thread; readers take a Snapshot
+ * and compute percentiles from it. Snapshots subtract, so a periodic
+ * reader can report the last interval without resetting the histogram.
+ */
+
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#define LATENCY_SUB_BITS    4
+#define LATENCY_SUB_COUNT   (1u << LATENCY_SUB_BITS)
+#define LATENCY_BUCKETS     ((32 - LATENCY_SUB_BITS + 1) * LATENCY_SUB_COUNT)
+
+class LatencyHistogram {
+public:
+    struct Snapshot {
+        uint32_t counts[LATENCY_BUCKETS] = {};
+        uint64_t count = 0;
+        uint64_t sum_us = 0;
+        uint32_t max_us = 0;
+
+        /**
+         * Value at quantile q (0..1): the highest value of the bucket
+         * holding that rank, capped at max_us. 0 when empty.
+         */
+        uint32_t percentile(double q) const {
+            if (count == 0) return 0;
+            uint64_t rank = (uint64_t)(q * (double)count + 0.5);
+            if (rank < 1) rank = 1;
+            if (rank > count) rank = count;
+
+            uint64_t seen = 0;
+            for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+                seen += counts[i];
+                if (seen >= rank) {
+                    uint32_t v = bucketHigh(i);
+                    return (max_us != 0 && v > max_us) ? max_us : v;
+                }
+            }
+            return max_us;
+        }
+
+        /**
+         * This snapshot minus an earlier one of the same histogram. The
+         * interval's maximum is not tracked, so max_us becomes the top
+         * of its highest non-empty bucket.
+         */
+        Snapshot since(const Snapshot& earlier) const {
+            Snapshot d;
+            for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+                d.counts[i] = counts[i] - earlier.counts[i];
+                if (d.counts[i] != 0) d.max_us = bucketHigh(i);
+            }
+            d.count = count - earlier.count;
+            d.sum_us = sum_us - earlier.sum_us;
+            if (d.max_us > max_us) d.max_us = max_us;
+            return d;
+        }
+    };
+
+    void record(uint64_t us) {
+        uint32_t v = (us > UINT32_MAX) ? UINT32_MAX : (uint32_t)us;
+        m_counts[bucketOf(v)].fetch_add(1, std::memory_order_relaxed);
+        m_sum.fetch_add(v, std::memory_order_relaxed);
+
+        uint32_t prev = m_max.load(std::memory_order_relaxed);
+        while (v > prev && !m_max.compare_exchange_weak(prev, v, std::memory_order_relaxed)) {
+        }
+    }
+
+    void snapshot(Snapshot& out) const {
+        // count is the bucket sum, so percentiles stay consistent with a concurrent record()
+        uint64_t total = 0;
+        for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+            out.counts[i] = m_counts[i].load(std::memory_order_relaxed);
+            total += out.counts[i];
+        }
+        out.count = total;
+        out.sum_us = m_sum.load(std::memory_order_relaxed);
+        out.max_us = m_max.load(std::memory_order_relaxed);
+    }
+
+    static size_t bucketOf(uint32_t v) {
+        if (v < LATENCY_SUB_COUNT) return v;
+        int msb = 31 - __builtin_clz(v);
+        int shift = msb - LATENCY_SUB_BITS;
+        return (size_t)(shift + 1) * LATENCY_SUB_COUNT + ((v >> shift) - LATENCY_SUB_COUNT);
+    }
+
+    static uint32_t bucketLow(size_t i) {
+        if (i < LATENCY_SUB_COUNT) return (uint32_t)i;
+        int shift = (int)(i / LATENCY_SUB_COUNT) - 1;
+        return (uint32_t)(LATENCY_SUB_COUNT + i % LATENCY_SUB_COUNT) << shift;
+    }
+
+    static uint32_t bucketHigh(size_t i) {
+        if (i < LATENCY_SUB_COUNT) return (uint32_t)i;
+        int shift = (int)(i / LATENCY_SUB_COUNT) - 1;
+        return bucketLow(i) + ((1u << shift) - 1);
+    }
+
+private:
+    std::atomic<uint32_t> m_counts[LATENCY_BUCKETS] = {};
+    std::atomic<uint64_t> m_sum{0};
+    std::atomic<uint32_t> m_max{0};
+};
+
+#endif // LATENCY_HISTOGRAM_H
@@ -0,0 +1,166 @@
+/**
+ * Spider Robot v3.1 - Leg Inverse Kinematics Implementation
+ */
+
+#include "leg_kinematics.h"
+
+#include <cmath>
+
+extern "C" {
+#include "limits.h"
+}
+
+static const float PI_F = 3.14159265358979f;
+static const float HALF_PI_F = 1.57079632679490f;
+
+// 0..180 degrees spans the full PWM range
+static const float US_PER_RAD = (float)(SERVO_PWM_MAX_US - SERVO_PWM_MIN_US) / PI_F;
+
+// Smallest hip-to-foot distance solved for, keeps the law of cosines finite
+static const float MIN_REACH_MM = 1.0f;
+
+// atan(t) for t = i / 2^IK_LUT_BITS, in Q16 radians (atan(1) * 65536 fits 16 bits)
+struct AtanTable {
+    uint16_t q16[IK_LUT_SIZE];
+
+    AtanTable() {
+        for (int i = 0; i < IK_LUT_SIZE; i++) {
+            q16[i] = (uint16_t)std::lround(std::atan((double)i / (1 << IK_LUT_BITS)) * 65536.0);
+        }
+    }
+};
+
+static const AtanTable s_atan;
+
+LegKinematics::Config::Config() {
+    for (int leg = 0; leg < IK_LEG_COUNT; leg++) {
+        SpiderModel::Hip hip = SpiderModel::hip(leg);
+        hip_x[leg] = hip.x;
+        hip_y[leg] = hip.y;
+        hip_angle[leg] = hip.angle;
+
+        for (int j = 0; j < IK_JOINTS_PER_LEG; j++) {
+            int ch = SpiderModel::channel(leg, j);
+            channel[leg][j] = (uint8_t)ch;
+            neutral_us[leg][j] = SERVO_PWM_NEUTRAL_US;
+            dir[leg][j] = 1;
+            min_us[leg][j] = SpiderModel::limits(ch).min_us;
+            max_us[leg][j] = SpiderModel::limits(ch).max_us;
+        }
+    }
+}
+
+LegKinematics::LegKinematics() {
+    setConfig(Config());
+}
+
+void LegKinematics::setConfig(const Config& config) {
+    m_config = config;
+    for (int leg = 0; leg < IK_LEG_COUNT; leg++) {
+        m_hip_cos[leg] = std::cos(config.hip_angle[leg]);
+        m_hip_sin[leg] = std::sin(config.hip_angle[leg]);
+    }
+}
+
+float LegKinematics::atan2Lut(float y, float x) {
+    float ax = std::fabs(x);
+    float ay = std::fabs(y);
+    if (ax == 0.0f && ay == 0.0f) return 0.0f;
+
+    // Reduce to the first octant, t in [0, 1]
+    bool swap = ay > ax;
+    float t = swap ? ax / ay : ay / ax;
+    float pos = t * (float)(1 << IK_LUT_BITS);
+    int i = (int)pos;
+    if (i >= (1 << IK_LUT_BITS)) i = (1 << IK_LUT_BITS) - 1;
+    float frac = pos - (float)i;
+
+    int lo = s_atan.q16[i];
+    int hi = s_atan.q16[i + 1];
+    float a = ((float)lo + (float)(hi - lo) * frac) * (1.0f / 65536.0f);
+
+    if (swap) a = HALF_PI_F - a;
+    if (x < 0.0f) a = PI_F - a;
+    return (y < 0.0f) ? -a : a;
+}
+
+float LegKinematics::acosLut(float c) {
+    // Through atan2 the steep ends near +-1 stay as accurate as the middle
+    if (c > 1.0f) c = 1.0f;
+    if (c < -1.0f) c = -1.0f;
+    return atan2Lut(std::sqrt(1.0f - c * c), c);
+}
+
+uint8_t LegKinematics::solve(const FootTargets& feet, JointAngles& out) const {
+    const Config& c = m_config;
+    float f = c.femur_mm;
+    float t = c.tibia_mm;
+    float max_reach = f + t;
+    float min_reach = std::fabs(f - t);
+    if (min_reach < MIN_REACH_MM) min_reach = MIN_REACH_MM;
+
+    uint8_t unreachable = 0;
+    for (int leg = 0; leg < IK_LEG_COUNT; leg++) {
+        // Into the leg frame
+        float dx = feet.x[leg] - c.hip_x[leg];
+        float dy = feet.y[leg] - c.hip_y[leg];
+        float lx = dx * m_hip_cos[leg] + dy * m_hip_sin[leg];
+        float ly = dy * m_hip_cos[leg] - dx * m_hip_sin[leg];
+        float lz = feet.z[leg];
+
+        out.coxa[leg] = atan2Lut(ly, lx);
+
+        // Femur/tibia plane, from the femur joint
+        float r = std::sqrt(lx * lx + ly * ly) - c.coxa_mm;
+        float d = std::sqrt(r * r + lz * lz);
+        if (d > max_reach) {
+            d = max_reach;
+            unreachable |= (uint8_t)(1u << leg);
+        } else if (d < min_reach) {
+            d = min_reach;
+            unreachable |= (uint8_t)(1u << leg);
+        }
+        float d2 = d * d;
+
+        // Knee up: femur above the hip-to-foot line by the triangle's hip angle
+        out.femur[leg] = atan2Lut(lz, r) + acosLut((f * f + d2 - t * t) / (2.0f * f * d));
+        out.tibia[leg] = acosLut((f * f + t * t - d2) / (2.0f * f * t)) - HALF_PI_F;
+    }
+    return unreachable;
+}
+
+uint16_t LegKinematics::toServoUs(const JointAngles& angles, uint16_t* servo_us) const {
+    const float* joints[IK_JOINTS_PER_LEG] = { angles.coxa, angles.femur, angles.tibia };
+
+    uint16_t mask = 0;
+    for (int leg = 0; leg < IK_LEG_COUNT; leg++) {
+        for (int j = 0; j < IK_JOINTS_PER_LEG; j++) {
+            float us = m_config.neutral_us[leg][j] + m_config.dir[leg][j] * joints[j][leg] * US_PER_RAD;
+            if (us < m_config.min_us[leg][j]) us = m_config.min_us[leg][j];
+            if (us > m_config.max_us[leg][j]) us = m_config.max_us[leg][j];
+
+            uint8_t ch = m_config.channel[leg][j];
+            servo_us[ch] = (uint16_t)std::lround(us);
+            mask |= (uint16_t)(1u << ch);
+        }
+    }
+    return mask;
+}
+
+uint16_t LegKinematics::feetToServoUs(const FootTargets& feet, uint16_t* servo_us,
+                                      uint8_t* unreachable) const {
+    JointAngles angles;
+    uint8_t missed = solve(feet, angles);
+    if (unreachable) *unreachable = missed;
+    return toServoUs(angles, servo_us);
+}
+
+void LegKinematics::neutralFeet(FootTargets& out) const {
+    const Config& c = m_config;
+    float lx = c.coxa_mm + c.femur_mm;
+    for (int leg = 0; leg < IK_LEG_COUNT; leg++) {
+        out.x[leg] = c.hip_x[leg] + lx * m_hip_cos[leg];
+        out.y[leg] = c.hip_y[leg] + lx * m_hip_sin[leg];
+        out.z[leg] = -c.tibia_mm;
+    }
+}
@@ -0,0 +1,129 @@
+#ifndef LEG_KINEMATICS_H
+#define LEG_KINEMATICS_H
+
+#include <cstdint>
+
+#include "robot_model.h"
+
+/**
+ * LegKinematics - Closed-form inverse kinematics for the four legs
+ *
+ * Maps body-frame foot positions to coxa (yaw), femur and tibia (pitch)
+ * joint angles, then to calibrated servo pulse widths. The trig runs on
+ * Q16 lookup tables (atan on [0, 1], acos derived from it), so solving
+ * all four legs costs a few table reads and square roots and fits in the
+ * motion thread's 20 ms cycle with plenty to spare.
+ *
+ * Batches are structure-of-arrays: one array per coordinate or joint,
+ * one element per leg, so the per-leg loop stays in a few cache lines.
+ *
+ * Body frame: x forward, y left, z up, in mm from the body centre.
+ * Leg frame: x outward along the coxa at neutral, y counter-clockwise,
+ * z up, from the coxa joint. Neutral (all servos at SERVO_PWM_NEUTRAL_US)
+ * is coxa straight out, femur horizontal and tibia vertical.
+ *
+ * Leg layout (top view), as in gait_engine.h:
+ *     FL(1)  FR(0)
+ *     RL(3)  RR(2)
+ *
+ * Leg count, geometry, channels and joint limits come from SpiderModel
+ * (robot_model.h), so the per-leg loops have constant trip counts.
+ */
+#define IK_LEG_COUNT        SpiderModel::LEGS
+#define IK_JOINTS_PER_LEG   SpiderModel::JOINTS_PER_LEG
+#define IK_LUT_BITS         8       // atan table: 2^8 segments on [0, 1]
+#define IK_LUT_SIZE         ((1 << IK_LUT_BITS) + 1)
+
+// Default geometry (mm)
+#define IK_COXA_MM          SpiderModel::COXA_MM
+#define IK_FEMUR_MM         SpiderModel::FEMUR_MM
+#define IK_TIBIA_MM         SpiderModel::TIBIA_MM
+#define IK_HIP_X_MM         SpiderModel::HIP_X_MM   // Coxa joints sit at (+-x, +-y)
+#define IK_HIP_Y_MM         SpiderModel::HIP_Y_MM
+
+struct FootTargets {
+    alignas(16) float x[IK_LEG_COUNT];
+    alignas(16) float y[IK_LEG_COUNT];
+    alignas(16) float z[IK_LEG_COUNT];
+};
+
+/**
+ * Joint angles in radians, relative to neutral. Positive coxa swings the
+ * foot counter-clockwise, positive femur raises the knee, positive tibia
+ * swings the foot outward.
+ */
+struct JointAngles {
+    alignas(16) float coxa[IK_LEG_COUNT];
+    alignas(16) float femur[IK_LEG_COUNT];
+    alignas(16) float tibia[IK_LEG_COUNT];
+};
+
+class LegKinematics {
+public:
+    enum Joint { COXA = 0, FEMUR = 1, TIBIA = 2 };
+
+    struct Config {
+        float coxa_mm = IK_COXA_MM;
+        float femur_mm = IK_FEMUR_MM;
+        float tibia_mm = IK_TIBIA_MM;
+
+        // Coxa joint position and neutral heading per leg, body frame
+        float hip_x[IK_LEG_COUNT];
+        float hip_y[IK_LEG_COUNT];
+        float hip_angle[IK_LEG_COUNT];
+
+        // Per joint: output channel, pulse width at neutral, +1/-1 for
+        // servos mounted mirrored, and the pulse range the joint may use
+        uint8_t channel[IK_LEG_COUNT][IK_JOINTS_PER_LEG];
+        uint16_t neutral_us[IK_LEG_COUNT][IK_JOINTS_PER_LEG];
+        int8_t dir[IK_LEG_COUNT][IK_JOINTS_PER_LEG];
+        uint16_t min_us[IK_LEG_COUNT][IK_JOINTS_PER_LEG];
+        uint16_t max_us[IK_LEG_COUNT][IK_JOINTS_PER_LEG];
+
+        /**
+         * Defaults from SpiderModel: hips on the IK_HIP_* corners at 45
+         * degrees, coxa and femur on channels 2i/2i+1, tibia on aux
+         * channel 8+i, soft angle limits, no trim.
+         */
+        Config();
+    };
+
+    LegKinematics();
+
+    void setConfig(const Config& config);
+    const Config& config() const { return m_config; }
+
+    /**
+     * Solve all legs. Targets out of reach are pulled onto the edge of
+     * the workspace along the line from the femur joint.
+     * @return bitmask of legs whose target was out of reach
+     */
+    uint8_t solve(const FootTargets& feet, JointAngles& out) const;
+
+    /**
+     * Pulse widths for every leg joint, within each joint's limits. Writes servo_us[channel] for the configured channels.
+     * @return mask of channels written
+     */
+    uint16_t toServoUs(const JointAngles& angles, uint16_t* servo_us) const;
+
+    /**
+     * solve() then toServoUs().
+     */
+    uint16_t feetToServoUs(const FootTargets& feet, uint16_t* servo_us, uint8_t* unreachable = nullptr) const;
+
+    /**
+     * Foot positions with every joint at neutral.
+     */
+    void neutralFeet(FootTargets& out) const;
+
+    // Table-driven trig, exposed for tests. Max error about 2e-5 rad.
+    static float atan2Lut(float y, float x);
+    static float acosLut(float c);
+
+private:
+    Config m_config;
+    float m_hip_cos[IK_LEG_COUNT];
+    float m_hip_sin[IK_LEG_COUNT];
+};
+
+#endif // LEG_KINEMATICS_H
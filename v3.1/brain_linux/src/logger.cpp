@@ -0,0 +1,223 @@
+/**
+ * Spider Robot v3.1 - Logger
+ */
+
+#include "logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <pthread.h>
+
+#define LOG_WRITER_IDLE_MS 100
+
+static const char* levelToString(uint8_t level) {
+    switch ((LogLevel)level) {
+        case LogLevel::DEBUG: return "DEBUG";
+        case LogLevel::INFO:  return "INFO ";
+        case LogLevel::WARN:  return "WARN ";
+        case LogLevel::ERROR: return "ERROR";
+        default: return "?????";
+    }
+}
+
+// Drops the ring back into the pool when its thread exits
+struct LogRingOwner {
+    std::atomic<bool>* in_use = nullptr;
+    ~LogRingOwner() {
+        if (in_use) in_use->store(false, std::memory_order_release);
+    }
+};
+
+Logger::Logger() : m_level((int)LogLevel::INFO) {
+    m_writer = std::thread(&Logger::writerMain, this);
+}
+
+Logger::~Logger() {
+    {
+        std::lock_guard<std::mutex> lock(m_wake_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_one();
+    if (m_writer.joinable()) {
+        m_writer.join();
+    }
+    closeFile();
+}
+
+bool Logger::openFile(const std::string& path) {
+    std::lock_guard<std::mutex> lock(m_file_mutex);
+    if (m_file.is_open()) {
+        m_file.close();
+    }
+    m_file.open(path, std::ios::app);
+    if (!m_file.is_open()) {
+        std::cerr << "[Logger] Failed to open log file: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void Logger::closeFile() {
+    std::lock_guard<std::mutex> lock(m_file_mutex);
+    if (m_file.is_open()) {
+        m_file.close();
+    }
+}
+
+Logger::Ring* Logger::threadRing() {
+    thread_local Ring* ring = nullptr;
+    thread_local LogRingOwner owner;
+    if (ring) return ring;
+
+    std::lock_guard<std::mutex> lock(m_rings_mutex);
+    for (auto& r : m_rings) {
+        // Only reuse a ring the writer has emptied, so records keep their order
+        if (!r->in_use.load(std::memory_order_acquire) && r->records.empty()) {
+            r->in_use.store(true, std::memory_order_relaxed);
+            ring = r.get();
+            break;
+        }
+    }
+    if (!ring) {
+        m_rings.push_back(std::unique_ptr<Ring>(new Ring()));
+        ring = m_rings.back().get();
+    }
+    owner.in_use = &ring->in_use;
+    return ring;
+}
+
+void Logger::log(LogLevel level, const char* tag, const char* fmt, ...) {
+    if (!enabled(level)) return;
+
+    Record rec;
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    rec.time_ns = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    rec.level = (uint8_t)level;
+    strncpy(rec.tag, tag, sizeof(rec.tag) - 1);
+    rec.tag[sizeof(rec.tag) - 1] = '\0';
+
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(rec.msg, sizeof(rec.msg), fmt, args);
+    va_end(args);
+
+    Ring* ring = threadRing();
+    if (!ring->records.push(rec)) {
+        ring->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    if (!m_pending.exchange(true, std::memory_order_acq_rel)) {
+        m_wake.notify_one();
+    }
+}
+
+void Logger::flush() {
+    std::unique_lock<std::mutex> lock(m_wake_mutex);
+    uint64_t gen = ++m_flush_req;
+    m_wake.notify_one();
+    m_flushed.wait(lock, [&] { return m_flush_done >= gen || m_stop; });
+}
+
+size_t Logger::drain(std::string& out) {
+    std::vector<Record> batch;
+    uint32_t dropped = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_rings_mutex);
+        for (auto& r : m_rings) {
+            Record rec;
+            while (r->records.pop(rec)) {
+                batch.push_back(rec);
+            }
+            dropped += r->dropped.exchange(0, std::memory_order_relaxed);
+        }
+    }
+
+    // Interleave the threads' records in time order
+    std::stable_sort(batch.begin(), batch.end(),
+        [](const Record& a, const Record& b) { return a.time_ns < b.time_ns; });
+
+    time_t cached_sec = 0;
+    char date[24] = "";
+    for (const Record& rec : batch) {
+        time_t sec = (time_t)(rec.time_ns / 1000000000ULL);
+        if (sec != cached_sec || date[0] == '\0') {
+            struct tm tm_info;
+            localtime_r(&sec, &tm_info);
+            strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", &tm_info);
+            cached_sec = sec;
+        }
+
+        char prefix[64];
+        snprintf(prefix, sizeof(prefix), "%s.%03d [%s] [", date,
+                 (int)(rec.time_ns / 1000000ULL % 1000), levelToString(rec.level));
+        out += prefix;
+        out += rec.tag;
+        out += "] ";
+        out += rec.msg;
+        out += '\n';
+    }
+
+    if (dropped > 0) {
+        if (date[0] == '\0') {
+            time_t now = time(nullptr);
+            struct tm tm_info;
+            localtime_r(&now, &tm_info);
+            strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", &tm_info);
+        }
+        char line[96];
+        snprintf(line, sizeof(line), "%s     [WARN ] [Logger] %u messages dropped (ring full)\n",
+                 date, dropped);
+        out += line;
+    }
+    return batch.size();
+}
+
+void Logger::writerMain() {
+    pthread_setname_np(pthread_self(), "logger");
+    std::string out;
+    for (;;) {
+        uint64_t flush_gen;
+        bool stop;
+        {
+            std::unique_lock<std::mutex> lock(m_wake_mutex);
+            // The timeout covers a notify that lands between the check and the wait
+            m_wake.wait_for(lock, std::chrono::milliseconds(LOG_WRITER_IDLE_MS), [&] {
+                return m_stop || m_flush_req != m_flush_done ||
+                       m_pending.load(std::memory_order_acquire);
+            });
+            flush_gen = m_flush_req;
+            stop = m_stop;
+        }
+
+        // Producers that queue after this point will notify again
+        m_pending.exchange(false, std::memory_order_acq_rel);
+
+        out.clear();
+        drain(out);
+        if (!out.empty()) {
+            std::cout.write(out.data(), out.size());
+            std::cout.flush();
+
+            std::lock_guard<std::mutex> lock(m_file_mutex);
+            if (m_file.is_open()) {
+                m_file.write(out.data(), out.size());
+                m_file.flush();
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_wake_mutex);
+            m_flush_done = flush_gen;
+        }
+        m_flushed.notify_all();
+
+        if (stop) break;
+    }
+}
@@ -1,20 +1,41 @@
 /**
  * Spider Robot v3.1 - Logger
- * 
- * Simple logging with levels, timestamps, and optional file output.
+ *
+ * Levelled logging with timestamps and optional file output.
+ *
+ * log() only formats the message into a per-thread lock-free ring; a
+ * background writer thread adds the wall-clock timestamp and writes
+ * batches to stdout and the log file. Callers (including the RT motion
+ * thread) never block on the console or the file. If a thread's ring is
+ * full the record is dropped and counted.
+ *
+ * LOG_MIN_LEVEL (0 = DEBUG .. 3 = ERROR) removes lower levels at compile
+ * time; Release builds set it to 1, so LOG_DEBUG costs nothing there.
+ * Arguments of a disabled LOG_* macro are not evaluated.
  */
 
 #ifndef LOGGER_H
 #define LOGGER_H
 
-#include <iostream>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
 #include <fstream>
-#include <ctime>
-#include <cstdio>
-#include <cstdarg>
-#include <cstring>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
+
+#include "spsc_ring.h"
+
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL 0
+#endif
+
+#define LOG_RING_SLOTS   128     // Records per thread
+#define LOG_MSG_MAX      480     // Longer messages are truncated
+#define LOG_TAG_MAX      16
 
 enum class LogLevel {
     DEBUG = 0,
@@ -31,100 +52,84 @@ public:
     }
 
     void setLevel(LogLevel level) {
-        m_level = level;
+        m_level.store((int)level, std::memory_order_relaxed);
     }
 
     void setLevel(const std::string& level) {
-        if (level == "DEBUG" || level == "debug") m_level = LogLevel::DEBUG;
-        else if (level == "INFO" || level == "info") m_level = LogLevel::INFO;
-        else if (level == "WARN" || level == "warn") m_level = LogLevel::WARN;
-        else if (level == "ERROR" || level == "error") m_level = LogLevel::ERROR;
+        if (level == "DEBUG" || level == "debug") setLevel(LogLevel::DEBUG);
+        else if (level == "INFO" || level == "info") setLevel(LogLevel::INFO);
+        else if (level == "WARN" || level == "warn") setLevel(LogLevel::WARN);
+        else if (level == "ERROR" || level == "error") setLevel(LogLevel::ERROR);
     }
 
-    LogLevel getLevel() const { return m_level; }
-
-    bool openFile(const std::string& path) {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        if (m_file.is_open()) {
-            m_file.close();
-        }
-        m_file.open(path, std::ios::app);
-        if (!m_file.is_open()) {
-            std::cerr << "[Logger] Failed to open log file: " << path << std::endl;
-            return false;
-        }
-        m_file_path = path;
-        return true;
-    }
+    LogLevel getLevel() const { return (LogLevel)m_level.load(std::memory_order_relaxed); }
 
-    void closeFile() {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        if (m_file.is_open()) {
-            m_file.close();
-        }
+    bool enabled(LogLevel level) const {
+        return (int)level >= m_level.load(std::memory_order_relaxed);
     }
 
-    void log(LogLevel level, const char* tag, const char* fmt, ...) {
-        if (level < m_level) return;
-
-        char msg[1024];
-        va_list args;
-        va_start(args, fmt);
-        vsnprintf(msg, sizeof(msg), fmt, args);
-        va_end(args);
-
-        char timestamp[32];
-        getTimestamp(timestamp, sizeof(timestamp));
-
-        const char* level_str = levelToString(level);
+    bool openFile(const std::string& path);
+    void closeFile();
 
-        std::lock_guard<std::mutex> lock(m_mutex);
+    void log(LogLevel level, const char* tag, const char* fmt, ...)
+        __attribute__((format(printf, 4, 5)));
 
-        std::cout << timestamp << " [" << level_str << "] [" << tag << "] " << msg << std::endl;
-
-        if (m_file.is_open()) {
-            m_file << timestamp << " [" << level_str << "] [" << tag << "] " << msg << std::endl;
-            m_file.flush();
-        }
-    }
+    /**
+     * Block until everything logged so far has been written.
+     */
+    void flush();
 
 private:
-    Logger() : m_level(LogLevel::INFO) {}
-    ~Logger() { closeFile(); }
+    struct Record {
+        uint64_t time_ns;       // CLOCK_REALTIME
+        uint8_t level;
+        char tag[LOG_TAG_MAX];
+        char msg[LOG_MSG_MAX];
+    };
+
+    struct Ring {
+        SpscRing<Record, LOG_RING_SLOTS> records;
+        std::atomic<uint32_t> dropped{0};
+        std::atomic<bool> in_use{true};     // Cleared when the owning thread exits
+    };
+
+    Logger();
+    ~Logger();
 
     Logger(const Logger&) = delete;
     Logger& operator=(const Logger&) = delete;
 
-    static void getTimestamp(char* buf, size_t size) {
-        struct timespec ts;
-        clock_gettime(CLOCK_REALTIME, &ts);
-        struct tm tm_info;
-        localtime_r(&ts.tv_sec, &tm_info);
-        int ms = ts.tv_nsec / 1000000;
-        snprintf(buf, size, "%04d-%02d-%02d %02d:%02d:%02d.%03d",
-            tm_info.tm_year + 1900, tm_info.tm_mon + 1, tm_info.tm_mday,
-            tm_info.tm_hour, tm_info.tm_min, tm_info.tm_sec, ms);
-    }
+    Ring* threadRing();
+    void writerMain();
+    size_t drain(std::string& out);
 
-    static const char* levelToString(LogLevel level) {
-        switch (level) {
-            case LogLevel::DEBUG: return "DEBUG";
-            case LogLevel::INFO:  return "INFO ";
-            case LogLevel::WARN:  return "WARN ";
-            case LogLevel::ERROR: return "ERROR";
-            default: return "?????";
-        }
-    }
+    std::atomic<int> m_level;
 
-    LogLevel m_level;
+    std::mutex m_file_mutex;
     std::ofstream m_file;
-    std::string m_file_path;
-    std::mutex m_mutex;
+
+    std::mutex m_rings_mutex;
+    std::vector<std::unique_ptr<Ring>> m_rings;
+
+    // Producers only notify when they are first to queue since the last drain
+    std::mutex m_wake_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_flushed;
+    std::atomic<bool> m_pending{false};
+    uint64_t m_flush_req = 0;       // Guarded by m_wake_mutex
+    uint64_t m_flush_done = 0;
+    bool m_stop = false;
+    std::thread m_writer;
 };
 
-#define LOG_DEBUG(tag, fmt, ...) Logger::instance().log(LogLevel::DEBUG, tag, fmt, ##__VA_ARGS__)
-#define LOG_INFO(tag, fmt, ...)  Logger::instance().log(LogLevel::INFO,  tag, fmt, ##__VA_ARGS__)
-#define LOG_WARN(tag, fmt, ...)  Logger::instance().log(LogLevel::WARN,  tag, fmt, ##__VA_ARGS__)
-#define LOG_ERROR(tag, fmt, ...) Logger::instance().log(LogLevel::ERROR, tag, fmt, ##__VA_ARGS__)
+#define LOG_AT(level, tag, fmt, ...) do { \
+        if ((int)(level) >= LOG_MIN_LEVEL && Logger::instance().enabled(level)) \
+            Logger::instance().log(level, tag, fmt, ##__VA_ARGS__); \
+    } while (0)
+
+#define LOG_DEBUG(tag, fmt, ...) LOG_AT(LogLevel::DEBUG, tag, fmt, ##__VA_ARGS__)
+#define LOG_INFO(tag, fmt, ...)  LOG_AT(LogLevel::INFO,  tag, fmt, ##__VA_ARGS__)
+#define LOG_WARN(tag, fmt, ...)  LOG_AT(LogLevel::WARN,  tag, fmt, ##__VA_ARGS__)
+#define LOG_ERROR(tag, fmt, ...) LOG_AT(LogLevel::ERROR, tag, fmt, ##__VA_ARGS__)
 
 #endif // LOGGER_H
@@ -19,6 +19,10 @@ bool Mailbox::open() {
     if (m_fd >= 0) {
         return true;
     }
+    if (m_hook != nullptr) {
+        std::cout << "[Mailbox] Using injected send hook" << std::endl;
+        return true;
+    }
 
     m_fd = ::open(RTOS_CMDQU_DEV, O_RDWR);
     if (m_fd < 0) {
@@ -39,6 +43,13 @@ void Mailbox::close() {
 }
 
 bool Mailbox::sendCommand(uint8_t cmd_id, uint32_t param, bool blocking) {
+    if (m_hook != nullptr) {
+        if (!m_hook(m_hook_ctx, cmd_id, param)) {
+            return false;
+        }
+        m_tx_count++;
+        return true;
+    }
     if (m_fd < 0) {
         return false;
     }
@@ -74,3 +85,7 @@ bool Mailbox::sendEstop() {
 bool Mailbox::sendHeartbeat() {
     return sendCommand(CMD_HEARTBEAT, 0, false);
 }
+
+bool Mailbox::sendPing(uint32_t seq) {
+    return sendCommand(CMD_PING, seq, false);
+}
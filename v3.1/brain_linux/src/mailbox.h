@@ -8,6 +8,7 @@
 #ifndef MAILBOX_H
 #define MAILBOX_H
 
+#include <atomic>
 #include <cstdint>
 #include <cstddef>
 
@@ -20,6 +21,7 @@
 #define CMD_MOTION_ACK      0x21
 #define CMD_HEARTBEAT       0x22
 #define CMD_ESTOP           0x23
+#define CMD_PING            0x24    // param = probe seq, answered in shared_probe.h
 
 union resv_t {
     struct {
@@ -39,24 +41,39 @@ struct cmdqu_t {
 
 class Mailbox {
 public:
+    /**
+     * Delivers a command in place of the cmdqu ioctl (host simulator).
+     * Returns false if the command was not accepted.
+     */
+    using SendHook = bool (*)(void* ctx, uint8_t cmd_id, uint32_t param);
+
     Mailbox() = default;
     ~Mailbox();
 
+    /**
+     * Send through hook instead of RTOS_CMDQU_DEV; open() then succeeds
+     * without the device. Must be called before open().
+     */
+    void setSendHook(SendHook hook, void* ctx) { m_hook = hook; m_hook_ctx = ctx; }
+
     bool open();
     void close();
-    bool isOpen() const { return m_fd >= 0; }
+    bool isOpen() const { return m_fd >= 0 || m_hook != nullptr; }
 
     bool sendCommand(uint8_t cmd_id, uint32_t param = 0, bool blocking = false);
     bool notifyPacketReady(uint32_t write_idx);
     bool sendEstop();
     bool sendHeartbeat();
+    bool sendPing(uint32_t seq);
 
     int getFd() const { return m_fd; }
-    uint32_t getTxCount() const { return m_tx_count; }
+    uint32_t getTxCount() const { return m_tx_count.load(std::memory_order_relaxed); }
 
 private:
     int m_fd = -1;
-    uint32_t m_tx_count = 0;
+    std::atomic<uint32_t> m_tx_count{0};     // E-STOP is sent from the I/O thread too
+    SendHook m_hook = nullptr;
+    void* m_hook_ctx = nullptr;
 };
 
 #endif // MAILBOX_H
@@ -8,61 +8,206 @@
  * - Mailbox communication via /dev/cvi-rtos-cmdqu
  * - Shared memory ring buffer at 0x83F00000 for PosePacket31
  * - Send motion packets to FreeRTOS Muscle Runtime
+ *
+ * All I/O and periodic work is driven by a single epoll/timerfd loop,
+ * so the daemon sleeps until a socket, the serial port or a timer fires.
+ * Packets and heartbeats are produced by a separate real-time
+ * MotionThread fed through a lock-free queue.
  */
 
 #include <iostream>
 #include <csignal>
 #include <atomic>
 #include <unistd.h>
+#include <cstdarg>
+#include <cstdio>
 #include <cstring>
+#include <cmath>
 #include <ctime>
 #include <sys/socket.h>
-#include <sys/select.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <fcntl.h>
+#include <sys/signalfd.h>
+#include <sys/uio.h>
 #include <vector>
+#include <deque>
+#include <memory>
 #include <algorithm>
 #include <getopt.h>
+#include <future>
+#include <system_error>
+#ifdef SPIDER_SIM
+#include <sys/mman.h>
+#endif
 
-#include "mailbox.h"
-#include "shared_memory.h"
+#include "alloc_counter.h"
+#include "capture.h"
+#include "motion_pack.h"
+#include "motion_thread.h"
 #include "eye_client.h"
 #include "distance_sensor.h"
 #include "serial_control.h"
 #include "scan_controller.h"
+#include "obstacle_avoider.h"
+#include "occupancy_grid.h"
+#include "profiler.h"
+#include "reply_arena.h"
+#include "event_loop.h"
+#include "json_tokenizer.h"
+#include "latency_histogram.h"
 #include "logger.h"
+#include "robot_model.h"
+#include "slot_table.h"
+#include "trace.h"
+#include "tunables.h"
+#include "udp_teleop.h"
+#include "ws_deflate.h"
+#include "ws_frame.h"
+#include "ws_rx_buffer.h"
 
 extern "C" {
 #include "protocol_posepacket31.h"
 #include "crc16_ccitt_false.h"
 #include "eye_event_protocol.h"
+#include "ws_pose_binary.h"
+#include "ws_stream_binary.h"
+#include "timebase.h"
+#ifdef SPIDER_SIM
+#include "muscle_sim.h"
+#endif
 }
 
 #define WS_PORT                   9000
-#define HEARTBEAT_INTERVAL_MS     100
 #define MAX_CLIENTS               8
-#define RX_BUFFER_SIZE            4096
 #define EYE_RECONNECT_INTERVAL_MS 5000
 #define WATCHDOG_LOG_INTERVAL_MS  10000
 #define STATS_LOG_INTERVAL_MS     30000
+#define MUSCLE_LOG_INTERVAL_MS    250
+#define MUSCLE_LOG_BATCH          32
+#define TELEMETRY_MIN_INTERVAL_MS 20      // One Muscle output tick
+#define SCAN_TICK_INTERVAL_MS     10
+#define WS_STREAM_TICK_MS         10      // Subscription push granularity
+#define AVOID_POLL_MS             5       // Well inside one ranging period
+#define WS_TX_HIGH_WATER_BYTES    16384   // Above this, stale telemetry is dropped
+#define WS_TX_MAX_QUEUE_BYTES     262144  // Above this, the client is disconnected
+#define WS_TX_POOL_IDLE           64      // Queued-frame buffers kept for reuse
+#define WS_RX_MAX_MESSAGE_BYTES   262144  // Reassembled message cap, see --ws-max-message
+#define TRACE_DUMP_INLINE_MAX     500     // Events per inline trace_dump reply
+#define METRICS_BUF_SIZE          24576   // Whole /metrics response, formatted in place
+#define METRICS_HEADER_RESERVE    160     // Room for the HTTP header ahead of the body
+#define MUSCLE_JSON_SIZE          1152    // formatMuscleTelemetry() with load, every field at its widest: 1101
+#define STATUS_JSON_SIZE          3072    // status reply, every field at its widest: 2785
+#define TRACE_DUMP_WINDOW_MS      10000   // Default age limit of dumped records
+#define WS_CMD_ID_MAX             10      // Digits of an echoed "id" (uint32)
+#define WS_ESTOP_PRESCAN_MAX      125     // Longest text frame checked for an estop ahead of its turn
+#define CAPTURE_DRAIN_MS          20      // Written packets move to the capture file this often
+#define BATCH_MAX_COMMANDS        16      // Commands in one batch message
+#define BATCH_REPLY_MAX           8192    // Aggregated batch reply
+#define COMMAND_MAX               48      // Entries of s_commands, for per-command CPU counters
+#define CPU_LOG_TOP_COMMANDS      5       // Costliest commands in each stats log line
+#define PROFILE_DEFAULT_SECONDS   10
+#define PROFILE_DEFAULT_PATH      "/tmp/spider_profile.folded"
+
+// Latency histograms reported by status and the stats log, in this order
+enum {
+    LATENCY_METRIC_CMD,         // Command received -> ring written, Muscle notified
+    LATENCY_METRIC_CONSUME,     // Ring written -> Muscle dequeued
+    LATENCY_METRIC_RANGE,       // One VL53L0X measurement
+    LATENCY_METRIC_EYE,         // Eye event send
+    LATENCY_METRIC_IPC_RTT,     // CMD_PING sent -> Muscle answered
+    LATENCY_METRIC_IPC_UP,      // CMD_PING sent -> Muscle mailbox interrupt
+    LATENCY_METRIC_IPC_ECHO,    // Muscle interrupt -> motion task answered
+    LATENCY_METRIC_AVOID,       // Range sample taken -> avoidance gait change queued
+    LATENCY_METRIC_ESTOP,       // estop decoded -> Muscle drove the servos neutral
+    LATENCY_METRIC_COUNT
+};
+static const char* const s_latency_names[LATENCY_METRIC_COUNT] = {
+    "cmd", "consume", "range", "eye", "ipc_rtt", "ipc_up", "ipc_echo", "avoid", "estop"
+};
+
+// Event loop time by subsystem, reported by cpu_stats, the stats log and /metrics
+enum {
+    LOOP_COST_WS,               // Accepts, client sockets (with their commands), streams, telemetry
+    LOOP_COST_SERIAL,           // Serial control port, with its commands
+    LOOP_COST_UDP,              // UDP teleop datagrams and the deadman
+    LOOP_COST_EYE,              // Eye socket, coalesced flushes, reconnects
+    LOOP_COST_SCAN,             // Sweep steps and obstacle avoidance
+    LOOP_COST_OTHER,            // Logs, capture drain, profiler
+    LOOP_COST_COUNT
+};
+static const char* const s_loop_cost_names[LOOP_COST_COUNT] = {
+    "ws", "serial", "udp", "eye", "scan", "other"
+};
+#define SCHEDULE_LEAD_US          20000   // Scheduled trajectories start this far ahead
 #define DEFAULT_SERIAL_PORT       "/dev/ttyS0"
 #define DEFAULT_SERIAL_BAUD       115200
+#define DEFAULT_MOTION_PACK       "/root/motions.smp"
+#define DEFAULT_SERVO_CALIB       "/root/servo_calib.bin"
+#define DEFAULT_TUNABLES          "/root/tunables.conf"
 
 static std::atomic<bool> g_shutdown{false};
 static std::atomic<bool> g_estop{false};
 static std::atomic<bool> g_estop_prev{false};
 
-void signal_handler(int sig) {
-    (void)sig;
-    g_shutdown.store(true);
+// SIGINT and SIGTERM reach the event loop through a signalfd
+static sigset_t stop_signals() {
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGINT);
+    sigaddset(&set, SIGTERM);
+    return set;
 }
 
+struct WsTxFrame {
+    uint8_t header[10];
+    uint8_t header_len = 0;
+    bool droppable = false;     // Telemetry: may be discarded under backpressure
+    size_t sent = 0;            // Bytes of header+payload already written
+    std::vector<uint8_t> payload;   // From the daemon's TX WsBufferPool
+    
+    size_t size() const { return header_len + payload.size(); }
+};
+
 struct WsClient {
     int fd = -1;
     bool handshake_done = false;
-    uint8_t rx_buffer[RX_BUFFER_SIZE];
-    size_t rx_len = 0;
+    bool closing = false;       // Reaped after the current dispatch
+    bool close_after_tx = false;// Plain HTTP request: close once the reply is out
+    bool want_write = false;    // EPOLLOUT armed
+    WsRxBuffer rx;
+    
+    // Message being reassembled: fragmented, or one frame too big for rx.
+    // Payload is unmasked and appended as it arrives, never held whole in rx
+    uint8_t msg_opcode = 0;             // 0x01/0x02 while a message is open
+    bool msg_compressed = false;        // RSV1 on its first frame
+    std::vector<uint8_t> msg;           // From the daemon's large WsBufferPool
+    uint64_t frame_remaining = 0;       // Payload bytes of the current frame still to come
+    bool frame_fin = false;
+    bool frame_masked = false;
+    uint8_t frame_mask[4] = {};
+    uint32_t frame_offset = 0;          // Mask phase
+    
+    std::deque<WsTxFrame> tx_queue;
+    size_t tx_bytes = 0;
+    uint32_t tx_dropped = 0;
+    
+    // permessage-deflate, if the handshake negotiated it
+    std::unique_ptr<WsDeflate> deflate;
+    
+    // Stream subscriptions, see common/ws_stream_binary.h
+    uint8_t sub_mask = 0;                               // 1 << WS_STREAM_TOPIC_*
+    uint32_t sub_interval_ms[WS_STREAM_TOPIC_COUNT] = {};
+    uint64_t sub_last_ms[WS_STREAM_TOPIC_COUNT] = {};
+    uint16_t sub_seq[WS_STREAM_TOPIC_COUNT] = {};
+    WsStreamScanPoint scan_pending[WS_STREAM_MAX_POINTS];
+    size_t scan_pending_count = 0;
+    uint32_t distance_seq = 0;                          // Last sample sent
+    SharedTelemetryData telemetry_last;                 // Delta base
+    uint32_t telemetry_frames = 0;                      // 0 = next one is a keyframe
+    
+    // estop frames already acted on by the pre-scan, still to be dispatched
+    uint32_t estop_ahead = 0;
 };
 
 class BrainDaemon {
@@ -73,32 +218,198 @@ public:
     
     void setSerialPort(const std::string& port) { m_serial_port = port; }
     void setSerialBaud(int baud) { m_serial_baud = baud; }
+    void setRealtime(int priority, int cpu) { m_motion.setRealtime(priority, cpu); }
+    void setRingSlots(uint32_t max_slots) { m_motion.setRingSlots(max_slots); }
+    void setFlowPolicy(FlowPolicy policy) { m_motion.setFlowPolicy(policy); }
+    void setPosePolicy(FlowPolicy policy) { m_motion.setPosePolicy(policy); }
+    void setShmCached(bool cached) { m_motion.setShmCached(cached); }
+    void setSimBackend(void* region, Mailbox::SendHook hook, void* ctx) {
+        m_motion.setSimBackend(region, hook, ctx);
+    }
+    void setMotionPack(const std::string& path) { m_motion_pack_path = path; }
+    void setServoCalib(const std::string& path) { m_servo_calib_path = path; }
+    void setTunables(const std::string& path) { m_tunables_path = path; }
+    void setEyeJsonOnly(bool json_only) { m_eye_client.setJsonOnly(json_only); }
+    void setWsQueueLimits(size_t high_water, size_t max_queue) {
+        m_ws_high_water = high_water;
+        m_ws_max_queue = max_queue;
+    }
+    void setWsMaxMessage(size_t bytes) { m_ws_max_message = bytes; }
+    void setWsDeflate(int level, size_t min_bytes) {
+        m_ws_deflate_level = level;
+        m_ws_deflate_min = min_bytes;
+    }
+    bool setRangeSensors(const DistanceSensor::Mount* mounts, size_t count) {
+        return m_distance_sensor.setMounts(mounts, count);
+    }
+    void setCapture(const std::string& path, size_t bytes) {
+        m_capture_path = path;
+        m_capture_bytes = bytes;
+    }
+    void setUdpTeleop(uint16_t port, const std::string& key_path) {
+        m_udp_port = port;
+        m_udp_key_path = key_path;
+    }
 
 private:
     bool initWebSocket();
     bool initSerialControl();
+    bool initUdpTeleop();
+    bool initEventLoop();
+    void drainCapture();
     void acceptClients();
-    void processClients();
+    void onClientEvent(int idx, uint32_t gen, int fd, uint32_t events);
+    void processClient(WsClient& client);
     void removeClient(int idx);
+    void reapClients();
+    void syncEyeWatch();
+    void syncStreamTimer();
+    void startScan();
+    void stopScan();
     
     bool wsHandshake(WsClient& client);
+    void serveMetrics(WsClient& client);
+    size_t formatMetrics(char* buf, size_t len);
+    void wsReply(const char* msg) { wsReply(msg, strlen(msg)); }
+    void wsReply(const char* msg, size_t len);
+    void wsReply(JsonWriter& w);
     void wsProcessFrame(WsClient& client);
-    void wsSendFrame(int fd, const uint8_t* data, size_t len, uint8_t opcode = 0x01);
-    void wsBroadcast(const std::string& msg);
+    bool wsBeginStreamed(WsClient& client, const WsFrameHeader& hdr);
+    void wsStreamPayload(WsClient& client);
+    void wsDispatch(WsClient& client, uint8_t opcode, const uint8_t* payload, size_t len);
+    void wsDispatchMessage(WsClient& client);
+    bool wsInflate(WsClient& client, const uint8_t*& payload, size_t& len);
+    void wsEndMessage(WsClient& client);
+    void wsFail(WsClient& client, uint16_t code, const char* reason);
+    void wsSendFrame(WsClient& client, const uint8_t* data, size_t len,
+                     uint8_t opcode = 0x01, bool droppable = false);
+    void wsSendPrepared(WsClient& client, const uint8_t* frame, size_t len, bool droppable = false);
+    void wsTransmit(WsClient& client, const uint8_t* head, size_t head_len,
+                    const uint8_t* body, size_t body_len, bool droppable);
+    bool wsSendDeflated(WsClient& client, uint8_t opcode, const uint8_t* a, size_t a_len,
+                        const uint8_t* b, size_t b_len, bool droppable);
+    void wsSendRaw(WsClient& client, const char* data, size_t len);
+    void wsEnqueue(WsClient& client, WsTxFrame&& frame);
+    void wsFlush(WsClient& client);
+    void wsBroadcast(const char* msg, size_t len, bool droppable = false);
+    void wsBroadcast(const char* msg) { wsBroadcast(msg, strlen(msg)); }
+    void wsBroadcast(JsonWriter& w, bool droppable = false);
+    bool wsReplyTagged(const char* msg, size_t len);
     
-    void handleCommand(const std::string& cmd);
-    void sendPosePacket(const PosePacket31& pkt);
-    void tickHeartbeat();
+    void handleCommand(const char* data, size_t len);
+    void handleBinaryPose(WsClient& client, const uint8_t* data, size_t len);
+    bool submitPoseFrame(const uint8_t* data, size_t len, WsPoseAck& ack);
+    bool queuePose(uint32_t t_ms, uint16_t extra_flags, uint16_t mask,
+                   const uint16_t* servos, uint32_t* out_seq = nullptr);
+    const char* requestWalk(const GaitEngine::Params& params);
+    void onUdpTeleop();
+    void tickUdpDeadman();
     void tickEyeReconnect();
     void tickWatchdogLog();
     void tickStatsLog();
+    void tickMuscleLog();
+    void collectMuscleLatency();
+    void snapshotLatencies(LatencyHistogram::Snapshot* out) const;
+    void tickTelemetry();
+    void tickStreams();
+    void streamSend(WsClient& client, int topic, uint8_t msg, uint8_t count,
+                    const void* body, size_t body_len);
+    void streamScanPoint(const ScanController::ScanPoint& point);
+    void streamEstop(bool active);
+    void streamAvoid(WsClient* only = nullptr);
+    void tickAvoid();
+    void tickScan();
+    int formatMuscleTelemetry(char* buf, size_t len, bool servos, bool load = false);
     void checkEstopStateChange();
+    void triggerEstop(uint64_t rx_us);
+    void wsPrescanEstop(WsClient& client);
+    
+    // Text command handlers, dispatched through s_commands
+    using CommandHandler = void (BrainDaemon::*)(const JsonTokens& msg);
+    struct CommandEntry {
+        uint32_t hash;
+        const char* name;
+        CommandHandler handler;
+        bool motion;            // Drives the motion thread other than through queuePose()
+    };
+    static const CommandEntry s_commands[];
+    const CommandEntry* findCommand(const JsonTokens& msg) const;
+    void runCommand(const CommandEntry* e, const JsonTokens& msg);
     
-    PosePacket31 buildPosePacket(uint32_t t_ms, uint16_t flags, const uint16_t* servos);
+    /**
+     * A batch message being run: replies are collected into one, and
+     * the immediate poses of consecutive servo commands are merged into
+     * one packet, sent before the next motion command and at the end.
+     */
+    struct BatchState {
+        JsonTokens cmds[BATCH_MAX_COMMANDS];
+        const CommandEntry* entries[BATCH_MAX_COMMANDS];
+        char reply[BATCH_REPLY_MAX];
+        size_t reply_len;
+        int replies;
+        bool shared;            // A reply that would have been broadcast
+        bool truncated;
+        bool pose_pending;
+        uint32_t pose_t_ms;
+        uint16_t pose_flags;
+        uint16_t pose_mask;
+        uint16_t pose_us[SERVO_COUNT_TOTAL];
+        int packets;
+    };
+    void cmdBatch(const JsonTokens& msg);
+    void batchAppend(const char* msg, size_t len, bool shared);
+    void batchFlushPose();
     
-    void handleEyeCommand(const std::string& cmd);
-    void handleDistanceCommand(const std::string& cmd);
-    void handleScanCommand(const std::string& cmd);
+    void cmdEstop(const JsonTokens& msg);
+    void cmdStop(const JsonTokens& msg);
+    void cmdResume(const JsonTokens& msg);
+    void cmdPose(const JsonTokens& msg);
+    void cmdStatus(const JsonTokens& msg);
+    void cmdTelemetry(const JsonTokens& msg);
+    void cmdServo(const JsonTokens& msg);
+    void cmdServos(const JsonTokens& msg);
+    void cmdGetServos(const JsonTokens& msg);
+    void cmdMove(const JsonTokens& msg);
+    void cmdWalk(const JsonTokens& msg);
+    void cmdAvoid(const JsonTokens& msg);
+    void cmdFeet(const JsonTokens& msg);
+    void cmdPlay(const JsonTokens& msg);
+    void cmdMotions(const JsonTokens& msg);
+    void cmdCalibReload(const JsonTokens& msg);
+    void cmdTunables(const JsonTokens& msg);
+    void cmdSetTunable(const JsonTokens& msg);
+    void cmdTunablesReload(const JsonTokens& msg);
+    void applyTunables(const Tunables& next);
+    void replyTunables();
+    void cmdLook(const JsonTokens& msg);
+    void cmdBlink(const JsonTokens& msg);
+    void cmdWink(const JsonTokens& msg);
+    void cmdMood(const JsonTokens& msg);
+    void cmdEye(const JsonTokens& msg);
+    void cmdDistance(const JsonTokens& msg);
+    void cmdDistanceProfile(const JsonTokens& msg);
+    void cmdScan(const JsonTokens& msg);
+    void cmdScanStart(const JsonTokens& msg);
+    void cmdScanStop(const JsonTokens& msg);
+    void cmdScanStatus(const JsonTokens& msg);
+    void cmdScanGetData(const JsonTokens& msg);
+    void cmdMapGet(const JsonTokens& msg);
+    OccupancyGrid::Pose mapPose() const {
+        GaitEngine::Odometry o = m_motion.getOdometry();
+        OccupancyGrid::Pose pose;
+        pose.x_mm = o.x_mm;
+        pose.y_mm = o.y_mm;
+        pose.heading_rad = o.heading_rad;
+        return pose;
+    }
+    void cmdMapClear(const JsonTokens& msg);
+    void cmdSubscribe(const JsonTokens& msg);
+    void cmdUnsubscribe(const JsonTokens& msg);
+    void cmdTraceDump(const JsonTokens& msg);
+    void cmdCpuStats(const JsonTokens& msg);
+    void cmdProfile(const JsonTokens& msg);
+    void finishProfile();
+    void eyeCommandFailed();
     
     void initScanController();
     void setScanServoAngle(int angle_deg);
@@ -112,91 +423,234 @@ private:
     std::string onSerialStatus();
     int onSerialDistance();
     
-    Mailbox m_mailbox;
-    SharedMemory m_shared_mem;
+    // Declared before m_motion: the motion thread plays straight from the mapping
+    MotionPack m_motion_pack;
+    std::string m_motion_pack_path = DEFAULT_MOTION_PACK;
+    std::string m_servo_calib_path = DEFAULT_SERVO_CALIB;
+    std::string m_tunables_path = DEFAULT_TUNABLES;
+    Tunables m_tunables;                // In effect; the Muscle's share as last published
+    MotionThread m_motion;
     EyeClient m_eye_client;
     DistanceSensor m_distance_sensor;
     SerialControl m_serial_control;
     ScanController m_scan_controller;
+    ObstacleAvoider m_avoider;
+    OccupancyGrid m_map;                // Scan evidence in the gait's odometry frame
+    uint8_t m_map_frame[sizeof(WsStreamHeader) + OCC_SNAPSHOT_MAX];
+    EventLoop m_loop;
+    
+    // Command capture (--capture): inbound commands and written packets
+    CaptureRecorder m_capture;
+    std::string m_capture_path;
+    size_t m_capture_bytes = CAPTURE_DEFAULT_BYTES;
+    uint32_t m_capture_drops_seen = 0;
     
     std::string m_serial_port = DEFAULT_SERIAL_PORT;
     int m_serial_baud = DEFAULT_SERIAL_BAUD;
+    uint32_t m_serial_tx_dropped_logged = 0;
+    uint32_t m_estop_transitions = 0;
+    char m_metrics_buf[METRICS_BUF_SIZE];
+    
+    // Ring write -> Muscle dequeue, from the Muscle's trace records
+    LatencyHistogram m_consume_latency;
+    std::vector<SharedTraceRecord> m_trace_scratch;
+    uint32_t m_trace_cursor = 0;
+    uint32_t m_consumed_seq = 0;
+    LatencyHistogram m_estop_latency;
+    uint64_t m_estop_rx_us = 0;         // Oldest E-STOP not yet seen stopped by the Muscle, 0 = none
+    bool m_muscle_estop_seen = false;   // SHARED_FLAG_ESTOP at the last check
+    LatencyHistogram::Snapshot m_latency_logged[LATENCY_METRIC_COUNT];
+    
+    // Reactive avoidance: the walk asked for, steered by m_avoider
+    LatencyHistogram m_avoid_latency;
+    GaitEngine::Params m_walk_request;
+    GaitEngine::Params m_walk_steered;  // Last handed to the gait, the scan's motion hint
+    bool m_walk_requested = false;
+    bool m_avoid_halted = false;        // The requested walk is steered to a standstill
+    bool m_avoid_enabled = false;
+    uint32_t m_avoid_sample_seq[VL53L0X_MAX_SENSORS] = {};
+    uint32_t m_avoid_changes = 0;
+    
+    // UDP teleop (--udp-port): the walk it started stops when its walks stop coming
+    UdpTeleop m_udp;
+    uint16_t m_udp_port = 0;
+    std::string m_udp_key_path;
+    bool m_udp_walking = false;
+    uint32_t m_udp_walk_ms = 0;
+    uint32_t m_udp_pose_seq = 0;
     
     int m_server_fd = -1;
-    std::vector<WsClient> m_clients;
+    int m_signal_fd = -1;
+    // Stable slots: a WsClient never moves while connected
+    SlotTable<WsClient, MAX_CLIENTS> m_clients;
+    WsBufferPool m_rx_small_pool{MAX_CLIENTS};      // RX_BUFFER_SIZE, one per connected client
+    WsBufferPool m_rx_pool;                         // Large frames and reassembled messages
+    WsBufferPool m_tx_pool{WS_TX_POOL_IDLE};        // Payloads queued under backpressure
+    size_t m_ws_high_water = WS_TX_HIGH_WATER_BYTES;
+    size_t m_ws_max_queue = WS_TX_MAX_QUEUE_BYTES;
+    size_t m_ws_max_message = WS_RX_MAX_MESSAGE_BYTES;
+    int m_ws_deflate_level = -1;        // permessage-deflate level, -1 = not offered
+    size_t m_ws_deflate_min = WS_DEFLATE_MIN_DEFAULT;
+    std::vector<uint8_t> m_deflate_buf; // Last compressed frame, reused
+    std::vector<uint8_t> m_inflate_buf; // Last inflated message, reused
+    uint64_t m_deflate_in = 0;          // Payload bytes before and after compression
+    uint64_t m_deflate_out = 0;
+    ReplyArena m_arena;                 // Rewound after every loop iteration
+    uint64_t m_tx_direct = 0;           // Frames the socket took at once
+    uint64_t m_tx_queued = 0;           // Frames, or their tails, copied to a TX queue
+    
+    // End of the last scheduled trajectory on timebase_shared_us()
+    uint64_t m_sched_end_us = 0;
+    
+    int m_eye_watch_fd = -1;
+    bool m_eye_watch_out = false;   // EPOLLOUT armed: Eye socket full
+    int m_eye_flush_timer = -1;     // Armed while coalesced eye state is waiting
+    bool m_eye_flush_armed = false;
+    int m_scan_timer = -1;
+    int m_telemetry_timer = -1;
+    int m_stream_timer = -1;
+    int m_avoid_timer = -1;
+    int m_udp_deadman_timer = -1;
+    int m_profile_timer = -1;       // Armed while the sampling profiler runs
+    
+    // Where the loop's time goes: per subsystem, and per command within them
+    CpuCost m_loop_cost[LOOP_COST_COUNT];
+    CpuCost m_cmd_cost[COMMAND_MAX];
+    CpuCost m_loop_cost_logged[LOOP_COST_COUNT];    // As of the last stats log
+    CpuCost m_cmd_cost_logged[COMMAND_MAX];
+    SamplingProfiler m_profiler;
+    std::string m_profile_path;
+    
+    // Client whose text command is being dispatched, for direct replies
+    WsClient* m_cmd_client = nullptr;
+    // Its "id", echoed in every reply to the command; empty if it had none
+    char m_cmd_id[WS_CMD_ID_MAX + 1] = {};
+    size_t m_cmd_id_len = 0;
+    
+    BatchState m_batch;
+    bool m_batch_active = false;
+    
+    // Decode time of the frame being dispatched, for the cmd_decoded probe
+    uint64_t m_cmd_rx_us = 0;
     
-    uint32_t m_seq = 0;
-    uint64_t m_last_heartbeat_ms = 0;
-    uint64_t m_last_eye_reconnect_ms = 0;
-    uint64_t m_last_watchdog_log_ms = 0;
-    uint64_t m_last_stats_log_ms = 0;
     uint64_t m_start_time_ms = 0;
     
-    uint32_t m_packets_sent = 0;
     bool m_eye_connected = false;
     bool m_distance_available = false;
     bool m_serial_available = false;
-    
-    uint16_t m_current_servos[SERVO_COUNT_TOTAL];
 };
 
-static uint64_t get_time_ms() {
-    struct timespec ts;
-    clock_gettime(CLOCK_MONOTONIC, &ts);
-    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+// Run an init probe on a thread of its own, or inline when get() is called
+// if no thread can be had
+template <typename F>
+static std::future<bool> startProbe(F fn) {
+    try {
+        return std::async(std::launch::async, fn);
+    } catch (const std::system_error&) {
+        return std::async(std::launch::deferred, fn);
+    }
 }
 
 bool BrainDaemon::init() {
-    m_start_time_ms = get_time_ms();
+    m_start_time_ms = timebase_millis64();
     LOG_INFO("Brain", "Spider Robot v3.1 Brain Daemon starting...");
     
-    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) {
-        m_current_servos[i] = SERVO_PWM_NEUTRAL_US;
+    m_motion.setEstopFlag(&g_estop);
+    // Before the motion thread and serial probe start, so the first command is caught
+    if (!m_capture_path.empty()) {
+        if (m_capture.open(m_capture_path.c_str(), m_capture_bytes)) {
+            m_motion.setPacketCapture(true);
+        } else {
+            LOG_WARN("Brain", "Command capture disabled");
+        }
     }
-    
-    if (!m_mailbox.open()) {
-        LOG_ERROR("Brain", "CRITICAL: Failed to open mailbox");
+    if (!m_motion.init()) {
+        LOG_ERROR("Brain", "CRITICAL: Failed to initialize motion path");
         return false;
     }
     
-    if (!m_shared_mem.map()) {
-        LOG_ERROR("Brain", "CRITICAL: Failed to map shared memory");
-        return false;
+    ServoCalibration::Table calib;
+    if (!m_servo_calib_path.empty() && ServoCalibration::load(m_servo_calib_path.c_str(), calib)) {
+        m_motion.setCalibration(calib);
+    } else {
+        LOG_WARN("Brain", "No servo calibration table - sending pulse widths as given");
     }
     
-    if (!initWebSocket()) {
-        LOG_ERROR("Brain", "CRITICAL: Failed to start WebSocket server");
+    // Queued now, the Muscle's share is in shared memory before the first heartbeat.
+    // A missing default file just means the built-in values
+    if (!m_tunables_path.empty() &&
+        (m_tunables_path != DEFAULT_TUNABLES || access(m_tunables_path.c_str(), F_OK) == 0)) {
+        Tunables::load(m_tunables_path.c_str(), m_tunables);
+    }
+    m_motion.setMuscleTunables(m_tunables.muscleData());
+    
+    // Mailbox and shared memory are all the Muscle needs: heartbeats start
+    // now, before any of the slow optional probes below
+    if (!m_motion.start()) {
+        LOG_ERROR("Brain", "CRITICAL: Failed to start motion thread");
         return false;
     }
+    LOG_INFO("Brain", "Motion path up after %llu ms",
+             (unsigned long long)(timebase_millis64() - m_start_time_ms));
     
-    if (m_eye_client.connect()) {
-        m_eye_connected = true;
+    // Optional subsystems probe concurrently; each one only touches its own
+    // state until the event loop is set up below
+    std::future<bool> eye_ready = startProbe([this] { return m_eye_client.connect(); });
+    std::future<bool> distance_ready = startProbe([this] { return m_distance_sensor.init(); });
+    std::future<bool> serial_ready = startProbe([this] { return initSerialControl(); });
+    
+    if (!m_motion_pack_path.empty() && !m_motion_pack.open(m_motion_pack_path.c_str())) {
+        LOG_WARN("Brain", "No motion pack - play disabled");
+    }
+    
+    bool ws_ok = initWebSocket();
+    bool udp_ok = initUdpTeleop();
+    
+    m_eye_connected = eye_ready.get();
+    if (m_eye_connected) {
         LOG_INFO("Brain", "Eye Service connected");
     } else {
-        m_eye_connected = false;
         LOG_WARN("Brain", "Eye Service not available (will retry every %d ms)", EYE_RECONNECT_INTERVAL_MS);
     }
     
-    if (m_distance_sensor.init()) {
-        m_distance_available = true;
+    m_distance_available = distance_ready.get();
+    if (m_distance_available) {
         LOG_INFO("Brain", "Distance sensor initialized");
     } else {
-        m_distance_available = false;
         LOG_WARN("Brain", "Distance sensor not available - continuing without it");
     }
     
-    if (initSerialControl()) {
-        m_serial_available = true;
+    m_serial_available = serial_ready.get();
+    if (m_serial_available) {
         LOG_INFO("Brain", "Serial control initialized on %s", m_serial_port.c_str());
     } else {
-        m_serial_available = false;
         LOG_WARN("Brain", "Serial control not available - continuing without it");
     }
     
+    if (!ws_ok) {
+        LOG_ERROR("Brain", "CRITICAL: Failed to start WebSocket server");
+        return false;
+    }
+    if (!udp_ok) {
+        LOG_ERROR("Brain", "CRITICAL: Failed to start UDP teleop");
+        return false;
+    }
+    
     // Initialize scan controller
     initScanController();
+    ObstacleAvoider::Config avoid = m_avoider.getConfig();
+    avoid.critical_mm = m_tunables.get(Tunables::AVOID_CRITICAL_MM);
+    avoid.warning_mm = m_tunables.get(Tunables::AVOID_WARNING_MM);
+    avoid.safe_mm = m_tunables.get(Tunables::AVOID_SAFE_MM);
+    m_avoider.setConfig(avoid);
+    
+    if (!initEventLoop()) {
+        LOG_ERROR("Brain", "CRITICAL: Failed to set up event loop");
+        return false;
+    }
     
-    LOG_INFO("Brain", "All systems initialized");
+    LOG_INFO("Brain", "All systems initialized in %llu ms",
+             (unsigned long long)(timebase_millis64() - m_start_time_ms));
     return true;
 }
 
@@ -236,6 +690,13 @@ bool BrainDaemon::initWebSocket() {
     return true;
 }
 
+bool BrainDaemon::initUdpTeleop() {
+    if (m_udp_port == 0) {
+        return true;
+    }
+    return m_udp.loadKey(m_udp_key_path.c_str()) && m_udp.open(m_udp_port);
+}
+
 bool BrainDaemon::initSerialControl() {
     m_serial_control.setPort(m_serial_port);
     m_serial_control.setBaudRate(m_serial_baud);
@@ -249,29 +710,197 @@ bool BrainDaemon::initSerialControl() {
     m_serial_control.setResumeCallback([this]() { onSerialResume(); });
     m_serial_control.setStatusCallback([this]() { return onSerialStatus(); });
     m_serial_control.setDistanceCallback([this]() { return onSerialDistance(); });
+    m_serial_control.setPoseFrameCallback([this](const uint8_t* data, size_t len, WsPoseAck& ack) {
+        return submitPoseFrame(data, len, ack);
+    });
+    if (m_capture.isOpen()) {
+        m_serial_control.setRxTapCallback([this](const uint8_t* data, size_t len) {
+            m_capture.record(CAPTURE_SERIAL_RX, 0, m_cmd_rx_us, data, len);
+        });
+    }
+    m_serial_control.setWriteInterestCallback([this](bool want_write) {
+        m_loop.modifyFd(m_serial_control.getFd(), want_write ? (EPOLLIN | EPOLLOUT) : EPOLLIN);
+    });
     
     return m_serial_control.init();
 }
 
-void BrainDaemon::run() {
-    uint64_t now = get_time_ms();
-    m_last_heartbeat_ms = now;
-    m_last_eye_reconnect_ms = now;
-    m_last_watchdog_log_ms = now;
-    m_last_stats_log_ms = now;
+bool BrainDaemon::initEventLoop() {
+    if (!m_loop.init()) {
+        return false;
+    }
     
-    while (!g_shutdown.load()) {
-        acceptClients();
-        processClients();
-        m_serial_control.tick();
-        m_scan_controller.tick();
-        tickHeartbeat();
+    // main() blocked these in every thread, so only this fd sees them
+    sigset_t stop = stop_signals();
+    m_signal_fd = signalfd(-1, &stop, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (m_signal_fd < 0 || !m_loop.addFd(m_signal_fd, EPOLLIN, [this](uint32_t) {
+            struct signalfd_siginfo si;
+            while (read(m_signal_fd, &si, sizeof(si)) == (ssize_t)sizeof(si)) {
+                LOG_INFO("Brain", "Caught %s", strsignal((int)si.ssi_signo));
+                g_shutdown.store(true);
+            }
+        })) {
+        LOG_ERROR("Brain", "Cannot watch SIGINT/SIGTERM: %s", strerror(errno));
+        return false;
+    }
+    
+    // Every fd and timer callback runs under a CpuScope for its subsystem
+    if (!m_loop.addFd(m_server_fd, EPOLLIN, [this](uint32_t) {
+            CpuScope cpu(m_loop_cost[LOOP_COST_WS]);
+            acceptClients();
+        })) {
+        return false;
+    }
+    
+    if (m_serial_available) {
+        // The greeting may already be waiting for EPOLLOUT
+        uint32_t events = m_serial_control.wantsWrite() ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+        m_loop.addFd(m_serial_control.getFd(), events, [this](uint32_t ev) {
+            CpuScope cpu(m_loop_cost[LOOP_COST_SERIAL]);
+            if (ev & EPOLLOUT) m_serial_control.flushTx();
+            if (ev & ~(uint32_t)EPOLLOUT) {
+                m_cmd_rx_us = timebase_micros();
+                m_serial_control.tick();
+                m_cmd_rx_us = 0;
+            }
+        });
+    }
+    
+    if (m_udp.getFd() >= 0 &&
+        !m_loop.addFd(m_udp.getFd(), EPOLLIN, [this](uint32_t) {
+            CpuScope cpu(m_loop_cost[LOOP_COST_UDP]);
+            onUdpTeleop();
+        })) {
+        return false;
+    }
+    
+    syncEyeWatch();
+    
+    m_loop.addTimer("eye_reconnect", EYE_RECONNECT_INTERVAL_MS, [this]() {
+        CpuScope cpu(m_loop_cost[LOOP_COST_EYE]);
         tickEyeReconnect();
+    });
+    m_loop.addTimer("watchdog_log", WATCHDOG_LOG_INTERVAL_MS, [this]() {
+        CpuScope cpu(m_loop_cost[LOOP_COST_OTHER]);
         tickWatchdogLog();
+    });
+    m_loop.addTimer("stats_log", STATS_LOG_INTERVAL_MS, [this]() {
+        CpuScope cpu(m_loop_cost[LOOP_COST_OTHER]);
         tickStatsLog();
+    });
+    m_loop.addTimer("muscle_log", MUSCLE_LOG_INTERVAL_MS, [this]() {
+        CpuScope cpu(m_loop_cost[LOOP_COST_OTHER]);
+        tickMuscleLog();
+    });
+    
+    // Armed only while a sweep is running
+    m_scan_timer = m_loop.addTimer("scan", 0, [this]() {
+        CpuScope cpu(m_loop_cost[LOOP_COST_SCAN]);
+        tickScan();
+    });
+    // Armed by the telemetry command
+    m_telemetry_timer = m_loop.addTimer("telemetry", 0, [this]() {
+        CpuScope cpu(m_loop_cost[LOOP_COST_WS]);
+        tickTelemetry();
+    });
+    // Armed while any client has a polled subscription
+    m_stream_timer = m_loop.addTimer("streams", 0, [this]() {
+        CpuScope cpu(m_loop_cost[LOOP_COST_WS]);
+        tickStreams();
+    });
+    // Armed while obstacle avoidance is enabled
+    m_avoid_timer = m_loop.addTimer("avoid", 0, [this]() {
+        CpuScope cpu(m_loop_cost[LOOP_COST_SCAN]);
+        tickAvoid();
+    });
+    // Armed by syncEyeWatch() while eye state is coalesced
+    m_eye_flush_timer = m_loop.addTimer("eye_flush", 0, [this]() {
+        CpuScope cpu(m_loop_cost[LOOP_COST_EYE]);
+        m_eye_client.flush();
+    });
+    // Armed while a UDP walk is running
+    m_udp_deadman_timer = m_loop.addTimer("udp_deadman", 0, [this]() {
+        CpuScope cpu(m_loop_cost[LOOP_COST_UDP]);
+        tickUdpDeadman();
+    });
+    // Armed by the profile command for its duration
+    m_profile_timer = m_loop.addTimer("profile", 0, [this]() {
+        CpuScope cpu(m_loop_cost[LOOP_COST_OTHER]);
+        finishProfile();
+    });
+    if (m_capture.isOpen()) {
+        m_loop.addTimer("capture_drain", CAPTURE_DRAIN_MS, [this]() {
+            CpuScope cpu(m_loop_cost[LOOP_COST_OTHER]);
+            drainCapture();
+        });
+    }
+    return true;
+}
+
+/**
+ * Move packets the motion thread wrote into the capture file. They arrive
+ * up to CAPTURE_DRAIN_MS late, so they sit slightly out of time order
+ * among the commands; each keeps its own write time.
+ */
+void BrainDaemon::drainCapture() {
+    SentPacket sent;
+    while (m_motion.popSentPacket(sent)) {
+        CapturePose pose = { sent.exec_at_us, sent.pkt };
+        m_capture.record(CAPTURE_POSE_TX, 0, sent.time_us, &pose, sizeof(pose));
+    }
+    uint32_t drops = m_motion.getCaptureDrops();
+    m_capture.addDropped(drops - m_capture_drops_seen);
+    m_capture_drops_seen = drops;
+}
+
+void BrainDaemon::run() {
+    while (!g_shutdown.load()) {
+        if (m_loop.runOnce(-1) < 0) {
+            break;
+        }
+        reapClients();
+        syncEyeWatch();
         checkEstopStateChange();
+        m_arena.reset();
+    }
+}
+
+void BrainDaemon::syncEyeWatch() {
+    // EyeClient may drop or replace its socket inside any send
+    int fd = m_eye_client.getFd();
+    if (fd != m_eye_watch_fd) {
+        if (m_eye_watch_fd >= 0) {
+            m_loop.removeFd(m_eye_watch_fd);
+        }
+        m_eye_watch_fd = -1;
+        m_eye_watch_out = false;
         
-        usleep(1000);
+        if (fd >= 0 && m_loop.addFd(fd, EPOLLRDHUP, [this](uint32_t ev) {
+                CpuScope cpu(m_loop_cost[LOOP_COST_EYE]);
+                if (ev & EPOLLOUT) {
+                    m_eye_client.flush();
+                }
+                if (!(ev & (EPOLLRDHUP | EPOLLHUP | EPOLLERR))) return;
+                LOG_WARN("Eye", "Eye Service closed the connection, will attempt reconnection");
+                m_loop.removeFd(m_eye_watch_fd);
+                m_eye_watch_fd = -1;
+                m_eye_client.disconnect();
+                m_eye_connected = false;
+            })) {
+            m_eye_watch_fd = fd;
+        }
+    }
+    
+    // A full socket is drained on EPOLLOUT; otherwise coalesced state goes out once per eye frame
+    bool want_out = m_eye_watch_fd >= 0 && m_eye_client.wantsWrite();
+    if (want_out != m_eye_watch_out) {
+        m_eye_watch_out = want_out;
+        m_loop.modifyFd(m_eye_watch_fd, EPOLLRDHUP | (want_out ? (uint32_t)EPOLLOUT : 0u));
+    }
+    bool flush = m_eye_watch_fd >= 0 && !want_out && m_eye_client.hasPending();
+    if (flush != m_eye_flush_armed) {
+        m_eye_flush_armed = flush;
+        m_loop.setTimerInterval(m_eye_flush_timer, flush ? 1000 / EYE_RENDER_FPS : 0);
     }
 }
 
@@ -284,7 +913,8 @@ void BrainDaemon::acceptClients() {
         return;
     }
     
-    if (m_clients.size() >= MAX_CLIENTS) {
+    int idx = m_clients.acquire();
+    if (idx < 0) {
         LOG_WARN("WS", "Max clients (%d) reached, rejecting connection", MAX_CLIENTS);
         close(client_fd);
         return;
@@ -293,52 +923,100 @@ void BrainDaemon::acceptClients() {
     int flags = fcntl(client_fd, F_GETFL, 0);
     fcntl(client_fd, F_SETFL, flags | O_NONBLOCK);
     
-    WsClient client;
+    uint32_t gen = m_clients.generation(idx);
+    if (!m_loop.addFd(client_fd, EPOLLIN | EPOLLRDHUP,
+                      [this, idx, gen, client_fd](uint32_t ev) {
+                          CpuScope cpu(m_loop_cost[LOOP_COST_WS]);
+                          onClientEvent(idx, gen, client_fd, ev);
+                      })) {
+        m_clients.release(idx);
+        close(client_fd);
+        return;
+    }
+    
+    WsClient& client = m_clients[idx];
     client.fd = client_fd;
-    client.handshake_done = false;
-    client.rx_len = 0;
-    m_clients.push_back(client);
+    client.rx.attach(m_rx_small_pool);
     
     char ip[INET_ADDRSTRLEN];
     inet_ntop(AF_INET, &client_addr.sin_addr, ip, sizeof(ip));
     LOG_INFO("WS", "Client connected from %s (total: %zu)", ip, m_clients.size());
 }
 
-void BrainDaemon::processClients() {
-    for (size_t i = 0; i < m_clients.size(); ) {
-        WsClient& client = m_clients[i];
-        
-        ssize_t n = recv(client.fd, client.rx_buffer + client.rx_len,
-                         sizeof(client.rx_buffer) - client.rx_len, 0);
+void BrainDaemon::onClientEvent(int idx, uint32_t gen, int fd, uint32_t events) {
+    WsClient* c = m_clients.get(idx, gen);
+    if (!c) {
+        m_loop.removeFd(fd);
+        return;
+    }
+    
+    WsClient& client = *c;
+    if (client.closing) return;
+    
+    if (events & EPOLLOUT) {
+        wsFlush(client);
+    }
+    if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+        processClient(client);
+    }
+}
+
+void BrainDaemon::processClient(WsClient& client) {
+    if (client.rx.tailSpace() == 0) {
+        client.rx.compact();
+    }
+    // The handshake is parsed as a string, so keep room for a terminator
+    size_t space = client.rx.tailSpace() - (client.handshake_done ? 0 : 1);
+    if (space == 0) {
+        LOG_WARN("WS", "Handshake over %d bytes, closing fd=%d", RX_BUFFER_SIZE, client.fd);
+        client.closing = true;
+        return;
+    }
+    ssize_t n = recv(client.fd, client.rx.tail(), space, 0);
+    
+    if (n > 0) {
+        client.rx.commit(n);
         
-        if (n > 0) {
-            client.rx_len += n;
-            
-            if (!client.handshake_done) {
-                if (!wsHandshake(client)) {
-                    removeClient(i);
-                    continue;
-                }
-            } else {
-                wsProcessFrame(client);
+        if (!client.handshake_done) {
+            *client.rx.tail() = '\0';
+            if (!wsHandshake(client)) {
+                client.closing = true;
             }
-        } else if (n == 0) {
-            LOG_INFO("WS", "Client disconnected (remaining: %zu)", m_clients.size() - 1);
-            removeClient(i);
-            continue;
-        } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
-            LOG_ERROR("WS", "recv error: %s", strerror(errno));
-            removeClient(i);
-            continue;
+        } else {
+            wsProcessFrame(client);
         }
-        
-        i++;
+    } else if (n == 0) {
+        LOG_INFO("WS", "Client disconnected (remaining: %zu)", m_clients.size() - 1);
+        client.closing = true;
+    } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        LOG_ERROR("WS", "recv error: %s", strerror(errno));
+        client.closing = true;
     }
 }
 
 void BrainDaemon::removeClient(int idx) {
-    close(m_clients[idx].fd);
-    m_clients.erase(m_clients.begin() + idx);
+    WsClient& client = m_clients[idx];
+    client.rx.detach(m_rx_small_pool, m_rx_pool);
+    wsEndMessage(client);
+    for (WsTxFrame& frame : client.tx_queue) {
+        m_tx_pool.release(std::move(frame.payload));
+    }
+    m_loop.removeFd(client.fd);
+    close(client.fd);
+    bool subscribed = client.sub_mask != 0;
+    m_clients.release(idx);
+    if (subscribed) {
+        syncStreamTimer();
+    }
+}
+
+void BrainDaemon::reapClients() {
+    // Slots are only released here, so nothing is freed under a dispatch
+    for (int i = 0; i < m_clients.capacity(); i++) {
+        if (m_clients.inUse(i) && m_clients[i].closing) {
+            removeClient(i);
+        }
+    }
 }
 
 static const char* ws_find_header(const char* headers, const char* name) {
@@ -367,12 +1045,19 @@ static void base64_encode(const uint8_t* in, size_t len, char* out) {
 #include "sha1.h"
 
 bool BrainDaemon::wsHandshake(WsClient& client) {
-    const char* end = strstr((char*)client.rx_buffer, "\r\n\r\n");
+    const char* request = (const char*)client.rx.data();
+    const char* end = strstr(request, "\r\n\r\n");
     if (!end) {
         return true;
     }
     
-    const char* key_header = ws_find_header((char*)client.rx_buffer, "Sec-WebSocket-Key");
+    // Scrapers share the port; anything asking for /metrics is not a WebSocket
+    if (strncmp(request, "GET /metrics", 12) == 0 && (request[12] == ' ' || request[12] == '?')) {
+        serveMetrics(client);
+        return true;
+    }
+    
+    const char* key_header = ws_find_header(request, "Sec-WebSocket-Key");
     if (!key_header) {
         LOG_ERROR("WS", "Missing Sec-WebSocket-Key in handshake");
         return false;
@@ -394,503 +1079,1836 @@ bool BrainDaemon::wsHandshake(WsClient& client) {
     char accept[32];
     base64_encode(sha1_hash, 20, accept);
     
-    char response[256];
+    // permessage-deflate only when enabled, and only if zlib is built in
+    char extensions[160] = "";
+    const char* offers = ws_find_header(request, "Sec-WebSocket-Extensions");
+    if (offers && m_ws_deflate_level >= 0 && WsDeflate::available()) {
+        WsDeflateParams params;
+        char accepted[120];
+        if (ws_deflate_negotiate(offers, params, accepted, sizeof(accepted))) {
+            client.deflate = std::make_unique<WsDeflate>(params, m_ws_deflate_level);
+            snprintf(extensions, sizeof(extensions), "Sec-WebSocket-Extensions: %s\r\n", accepted);
+            LOG_DEBUG("WS", "fd=%d negotiated %s", client.fd, accepted);
+        }
+    }
+    
+    char response[384];
     snprintf(response, sizeof(response),
         "HTTP/1.1 101 Switching Protocols\r\n"
         "Upgrade: websocket\r\n"
         "Connection: Upgrade\r\n"
         "Sec-WebSocket-Accept: %s\r\n"
-        "\r\n", accept);
+        "%s"
+        "\r\n", accept, extensions);
     
-    send(client.fd, response, strlen(response), 0);
+    wsSendRaw(client, response, strlen(response));
     
-    size_t consumed = (end - (char*)client.rx_buffer) + 4;
-    if (consumed < client.rx_len) {
-        memmove(client.rx_buffer, client.rx_buffer + consumed, client.rx_len - consumed);
-        client.rx_len -= consumed;
-    } else {
-        client.rx_len = 0;
-    }
+    client.rx.consume((end - request) + 4);
     
     client.handshake_done = true;
     LOG_DEBUG("WS", "Handshake complete");
     
-    wsSendFrame(client.fd, (const uint8_t*)"{\"status\":\"connected\",\"version\":\"3.1\"}", 38);
+    wsSendFrame(client, (const uint8_t*)"{\"status\":\"connected\",\"version\":\"3.1\"}", 38);
     
     return true;
 }
 
+// True for a text command handleCommand() would hand to cmdEstop
+static bool isEstopCommand(const char* data, size_t len) {
+    if (!memmem(data, len, "estop", 5)) return false;
+    
+    JsonTokens msg;
+    if (!msg.parse(data, len)) return false;
+    const JsonToken* name = msg.find("cmd");
+    if (!name || name->type != JsonType::STRING) {
+        name = msg.find("type");
+    }
+    return name && name->type == JsonType::STRING && name->val_len == 5 &&
+           strncmp(name->val, "estop", 5) == 0;
+}
+
+/**
+ * Act on any estop among the complete frames in rx before dispatching
+ * the frames ahead of it. Its reply still goes out in order, from
+ * cmdEstop(). Frames stay masked in rx; they are checked on a copy.
+ */
+void BrainDaemon::wsPrescanEstop(WsClient& client) {
+    const uint8_t* data = client.rx.data();
+    size_t size = client.rx.size();
+    size_t off = (size_t)std::min<uint64_t>(client.frame_remaining, size);
+    if (off < client.frame_remaining) return;
+    
+    while (off < size) {
+        WsFrameHeader hdr;
+        if (!ws_frame_parse(data + off, size - off, hdr)) break;
+        size_t len = (size_t)hdr.payload_len;
+        if (hdr.opcode == 0x01 && hdr.fin && len <= WS_ESTOP_PRESCAN_MAX) {
+            char text[WS_ESTOP_PRESCAN_MAX];
+            memcpy(text, data + off + hdr.header_len, len);
+            if (hdr.masked) {
+                ws_unmask((uint8_t*)text, len, data + off + hdr.header_len - 4);
+            }
+            if (isEstopCommand(text, len)) {
+                triggerEstop(timebase_micros());
+                client.estop_ahead++;
+            }
+        }
+        off += hdr.header_len + len;
+    }
+}
+
 void BrainDaemon::wsProcessFrame(WsClient& client) {
-    while (client.rx_len >= 2) {
-        uint8_t* buf = client.rx_buffer;
+    wsPrescanEstop(client);
+    
+    while (!client.closing && !client.close_after_tx) {
+        if (client.frame_remaining > 0) {
+            if (client.rx.size() == 0) break;
+            wsStreamPayload(client);
+            continue;
+        }
         
-        bool fin = buf[0] & 0x80;
-        uint8_t opcode = buf[0] & 0x0F;
-        bool masked = buf[1] & 0x80;
-        uint64_t payload_len = buf[1] & 0x7F;
+        WsFrameHeader hdr;
+        bool complete = ws_frame_parse(client.rx.data(), client.rx.size(), hdr);
+        if (hdr.header_len == 0) break;
         
-        size_t header_len = 2;
-        if (payload_len == 126) {
-            if (client.rx_len < 4) return;
-            payload_len = (buf[2] << 8) | buf[3];
-            header_len = 4;
-        } else if (payload_len == 127) {
-            if (client.rx_len < 10) return;
-            payload_len = 0;
-            for (int i = 0; i < 8; i++) {
-                payload_len = (payload_len << 8) | buf[2 + i];
-            }
-            header_len = 10;
+        bool control = hdr.opcode & 0x08;
+        bool open = client.msg_opcode != 0;
+        // RSV1 marks a compressed message, on its first frame only
+        if ((control ? (!hdr.fin || hdr.payload_len > 125)
+                     : (hdr.opcode == 0x00) != open || hdr.opcode > 0x02) ||
+            (hdr.rsv1 && (!client.deflate || hdr.opcode == 0x00 || control))) {
+            wsFail(client, 1002, "protocol error");
+            break;
         }
         
-        if (masked) header_len += 4;
+        // Fragments, and frames rx cannot hold, are reassembled as they arrive.
+        // Control frames may come between fragments and are handled in place
+        if (!control && (open || !hdr.fin || hdr.header_len + hdr.payload_len > WS_RX_LARGE_BYTES)) {
+            if (!wsBeginStreamed(client, hdr)) break;
+            continue;
+        }
         
-        if (client.rx_len < header_len + payload_len) {
-            return;
+        if (!complete) {
+            // Make sure the rest of the frame has somewhere to go
+            client.rx.reserve(hdr.header_len + hdr.payload_len, m_rx_pool);
+            break;
         }
         
-        uint8_t* payload = buf + header_len;
-        if (masked) {
-            uint8_t* mask = buf + header_len - 4;
-            for (size_t i = 0; i < payload_len; i++) {
-                payload[i] ^= mask[i % 4];
-            }
+        uint8_t* payload = client.rx.data() + hdr.header_len;
+        size_t payload_len = hdr.payload_len;
+        if (hdr.masked) {
+            ws_unmask(payload, payload_len, payload - 4);
         }
         
-        if (opcode == 0x01 && fin) {
-            std::string msg((char*)payload, payload_len);
-            handleCommand(msg);
-        } else if (opcode == 0x08) {
+        if (hdr.opcode == 0x08) {
             LOG_DEBUG("WS", "Client sent close frame");
-            wsSendFrame(client.fd, nullptr, 0, 0x08);
-        } else if (opcode == 0x09) {
-            wsSendFrame(client.fd, payload, payload_len, 0x0A);
+            wsSendFrame(client, nullptr, 0, 0x08);
+        } else if (hdr.opcode == 0x09) {
+            wsSendFrame(client, payload, payload_len, 0x0A);
+        } else if (!control) {
+            const uint8_t* message = payload;
+            size_t message_len = payload_len;
+            if (hdr.rsv1 && !wsInflate(client, message, message_len)) break;
+            wsDispatch(client, hdr.opcode, message, message_len);
         }
         
-        size_t frame_len = header_len + payload_len;
-        if (frame_len < client.rx_len) {
-            memmove(client.rx_buffer, client.rx_buffer + frame_len, client.rx_len - frame_len);
-            client.rx_len -= frame_len;
-        } else {
-            client.rx_len = 0;
-        }
+        client.rx.consume(hdr.header_len + payload_len);
     }
+    // Every frame the pre-scan counted was dispatched, unless the client is going;
+    // a stale count must never swallow a later estop
+    client.estop_ahead = 0;
+    client.rx.shrink(m_rx_pool);
 }
 
-void BrainDaemon::wsSendFrame(int fd, const uint8_t* data, size_t len, uint8_t opcode) {
-    uint8_t header[10];
-    size_t header_len;
-    
-    header[0] = 0x80 | opcode;
-    
-    if (len < 126) {
-        header[1] = len;
-        header_len = 2;
-    } else if (len < 65536) {
-        header[1] = 126;
-        header[2] = (len >> 8) & 0xFF;
-        header[3] = len & 0xFF;
-        header_len = 4;
-    } else {
-        header[1] = 127;
-        for (int i = 0; i < 8; i++) {
-            header[2 + i] = (len >> ((7 - i) * 8)) & 0xFF;
-        }
-        header_len = 10;
+bool BrainDaemon::wsBeginStreamed(WsClient& client, const WsFrameHeader& hdr) {
+    if (client.msg.size() + hdr.payload_len > m_ws_max_message) {
+        LOG_WARN("WS", "Message from fd=%d is over %zu bytes, closing", client.fd, m_ws_max_message);
+        wsFail(client, 1009, "message too big");
+        return false;
+    }
+    if (hdr.opcode != 0x00) {
+        client.msg_opcode = hdr.opcode;
+        client.msg_compressed = hdr.rsv1;
+        client.msg = m_rx_pool.acquire(0);
     }
     
-    send(fd, header, header_len, 0);
-    if (len > 0 && data) {
-        send(fd, data, len, 0);
+    client.frame_remaining = hdr.payload_len;
+    client.frame_fin = hdr.fin;
+    client.frame_masked = hdr.masked;
+    client.frame_offset = 0;
+    if (hdr.masked) {
+        memcpy(client.frame_mask, client.rx.data() + hdr.header_len - 4, 4);
     }
+    client.msg.reserve(client.msg.size() + hdr.payload_len);
+    client.rx.consume(hdr.header_len);
+    
+    if (hdr.payload_len == 0 && hdr.fin) {
+        wsDispatchMessage(client);
+    }
+    return true;
 }
 
-void BrainDaemon::wsBroadcast(const std::string& msg) {
-    for (auto& client : m_clients) {
-        if (client.handshake_done) {
-            wsSendFrame(client.fd, (const uint8_t*)msg.c_str(), msg.size());
+void BrainDaemon::wsStreamPayload(WsClient& client) {
+    size_t n = (size_t)std::min<uint64_t>(client.rx.size(), client.frame_remaining);
+    uint8_t* chunk = client.rx.data();
+    if (client.frame_masked) {
+        // Rotate the key to where this chunk starts in the frame
+        uint8_t mask[4];
+        for (int i = 0; i < 4; i++) {
+            mask[i] = client.frame_mask[(client.frame_offset + i) % 4];
         }
+        ws_unmask(chunk, n, mask);
+    }
+    client.msg.insert(client.msg.end(), chunk, chunk + n);
+    client.rx.consume(n);
+    client.frame_remaining -= n;
+    client.frame_offset += (uint32_t)n;
+    
+    if (client.frame_remaining == 0 && client.frame_fin) {
+        wsDispatchMessage(client);
     }
 }
 
-static int parseJsonInt(const std::string& json, const char* key, int default_val) {
-    std::string search = std::string("\"") + key + "\":";
-    size_t pos = json.find(search);
-    if (pos == std::string::npos) return default_val;
-    pos += search.length();
-    while (pos < json.size() && (json[pos] == ' ' || json[pos] == '\t')) pos++;
-    if (pos >= json.size()) return default_val;
-    bool neg = false;
-    if (json[pos] == '-') { neg = true; pos++; }
-    int val = 0;
-    while (pos < json.size() && json[pos] >= '0' && json[pos] <= '9') {
-        val = val * 10 + (json[pos] - '0');
-        pos++;
-    }
-    return neg ? -val : val;
+// The reassembled message is complete
+void BrainDaemon::wsDispatchMessage(WsClient& client) {
+    const uint8_t* payload = client.msg.data();
+    size_t len = client.msg.size();
+    if (client.msg_compressed && !wsInflate(client, payload, len)) return;
+    wsDispatch(client, client.msg_opcode, payload, len);
+    wsEndMessage(client);
 }
 
-static int parseJsonIntArray(const std::string& json, const char* key, uint16_t* out, int max_count) {
-    std::string search = std::string("\"") + key + "\":[";
-    size_t pos = json.find(search);
-    if (pos == std::string::npos) {
-        search = std::string("\"") + key + "\": [";
-        pos = json.find(search);
-        if (pos == std::string::npos) return 0;
+/**
+ * Inflate a compressed message into m_inflate_buf and point payload at
+ * it. On failure the client is failed and false returned.
+ */
+bool BrainDaemon::wsInflate(WsClient& client, const uint8_t*& payload, size_t& len) {
+    int code = client.deflate->decompress(payload, len, m_ws_max_message, m_inflate_buf);
+    if (code != 0) {
+        LOG_WARN("WS", "Compressed message from fd=%d rejected (%d), closing", client.fd, code);
+        wsFail(client, (uint16_t)code, code == 1009 ? "message too big" : "bad compressed message");
+        return false;
     }
-    pos = json.find('[', pos);
-    if (pos == std::string::npos) return 0;
-    pos++;
-    
-    int count = 0;
-    while (pos < json.size() && count < max_count) {
-        while (pos < json.size() && (json[pos] == ' ' || json[pos] == '\t' || json[pos] == ',')) pos++;
-        if (pos >= json.size() || json[pos] == ']') break;
-        int val = 0;
-        while (pos < json.size() && json[pos] >= '0' && json[pos] <= '9') {
-            val = val * 10 + (json[pos] - '0');
-            pos++;
-        }
-        out[count++] = (uint16_t)val;
-    }
-    return count;
-}
-
-static bool parseJsonString(const std::string& json, const char* key, char* out, size_t out_size) {
-    std::string search = std::string("\"") + key + "\":\"";
-    size_t pos = json.find(search);
-    if (pos == std::string::npos) {
-        search = std::string("\"") + key + "\": \"";
-        pos = json.find(search);
-        if (pos == std::string::npos) return false;
-    }
-    pos = json.find('"', pos + strlen(key) + 2);
-    if (pos == std::string::npos) return false;
-    pos++;
-    size_t end = json.find('"', pos);
-    if (end == std::string::npos) return false;
-    size_t len = std::min(end - pos, out_size - 1);
-    memcpy(out, json.c_str() + pos, len);
-    out[len] = '\0';
+    payload = m_inflate_buf.data();
+    len = m_inflate_buf.size();
     return true;
 }
 
-static int servoNameToChannel(const char* name) {
-    static const char* names[] = {
-        "leg0_coxa", "leg0_femur",
-        "leg1_coxa", "leg1_femur",
-        "leg2_coxa", "leg2_femur",
-        "leg3_coxa", "leg3_femur",
-        "aux0", "aux1", "aux2", "aux3",
-        "scan"
-    };
-    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) {
-        if (strcmp(name, names[i]) == 0) return i;
+void BrainDaemon::wsDispatch(WsClient& client, uint8_t opcode, const uint8_t* payload, size_t len) {
+    m_cmd_rx_us = timebase_micros();
+    if (m_capture.isOpen()) {
+        m_capture.record(opcode == 0x01 ? CAPTURE_WS_TEXT : CAPTURE_WS_BINARY,
+                         (uint16_t)client.fd, m_cmd_rx_us, payload, len);
     }
-    return -1;
+    if (opcode == 0x01) {
+        m_cmd_client = &client;
+        handleCommand((const char*)payload, len);
+        m_cmd_client = nullptr;
+    } else {
+        handleBinaryPose(client, payload, len);
+    }
+    m_cmd_rx_us = 0;
 }
 
-// Helper to check if JSON contains a type field with given value
-static bool hasType(const std::string& json, const char* type_value) {
-    // Match both "type":"value" and "type": "value" (with optional space)
-    std::string pattern1 = std::string("\"type\":\"") + type_value + "\"";
-    std::string pattern2 = std::string("\"type\": \"") + type_value + "\"";
-    return json.find(pattern1) != std::string::npos || 
-           json.find(pattern2) != std::string::npos;
+void BrainDaemon::wsEndMessage(WsClient& client) {
+    if (client.msg.capacity() != 0) {
+        m_rx_pool.release(std::move(client.msg));
+        client.msg = std::vector<uint8_t>();
+    }
+    client.msg_opcode = 0;
+    client.msg_compressed = false;
+    client.frame_remaining = 0;
 }
 
-static bool hasCmd(const std::string& json, const char* cmd_value) {
-    std::string pattern1 = std::string("\"cmd\":\"") + cmd_value + "\"";
-    std::string pattern2 = std::string("\"cmd\": \"") + cmd_value + "\"";
-    return json.find(pattern1) != std::string::npos || 
-           json.find(pattern2) != std::string::npos;
+void BrainDaemon::wsFail(WsClient& client, uint16_t code, const char* reason) {
+    LOG_DEBUG("WS", "Closing fd=%d: %d %s", client.fd, code, reason);
+    uint8_t body[2] = { (uint8_t)(code >> 8), (uint8_t)code };
+    client.close_after_tx = true;
+    client.rx.clear(m_rx_pool);
+    wsEndMessage(client);
+    wsSendFrame(client, body, sizeof(body), 0x08);
 }
 
-void BrainDaemon::handleCommand(const std::string& cmd) {
-    LOG_DEBUG("Brain", "Received: %s", cmd.c_str());
-    
-    if (hasCmd(cmd, "estop") || hasType(cmd, "estop")) {
-        g_estop.store(true);
-        m_mailbox.sendEstop();
-        wsBroadcast("{\"status\":\"estop_activated\"}");
+void BrainDaemon::wsSendFrame(WsClient& client, const uint8_t* data, size_t len,
+                              uint8_t opcode, bool droppable) {
+    if (client.deflate && len >= m_ws_deflate_min &&
+        wsSendDeflated(client, opcode, data, len, nullptr, 0, droppable)) {
         return;
     }
-    
-    if (hasCmd(cmd, "stop") || hasType(cmd, "stop")) {
-        g_estop.store(false);
-        wsBroadcast("{\"status\":\"stopped\"}");
+    uint8_t header[WS_FRAME_HEADER_MAX];
+    size_t header_len = ws_frame_header(header, opcode, len);
+    wsTransmit(client, header, header_len, data, data ? len : 0, droppable);
+}
+
+// A frame whose header is already in front of the payload (JsonWriter::frame())
+void BrainDaemon::wsSendPrepared(WsClient& client, const uint8_t* frame, size_t len, bool droppable) {
+    WsFrameHeader hdr;
+    if (client.deflate && len >= m_ws_deflate_min && ws_frame_parse(frame, len, hdr) &&
+        wsSendDeflated(client, hdr.opcode, frame + hdr.header_len, (size_t)hdr.payload_len,
+                       nullptr, 0, droppable)) {
         return;
     }
+    wsTransmit(client, frame, len, nullptr, 0, droppable);
+}
+
+/**
+ * Send a + b as one compressed data frame, if the client negotiated
+ * permessage-deflate and the payload is at least --ws-deflate-min bytes;
+ * command acks and other small frames go out as they are, the large
+ * topic frames (map snapshots, status and telemetry JSON) compressed.
+ * @return false if the frame was not handled and should be sent plain
+ */
+bool BrainDaemon::wsSendDeflated(WsClient& client, uint8_t opcode, const uint8_t* a, size_t a_len,
+                                 const uint8_t* b, size_t b_len, bool droppable) {
+    if (!client.deflate || opcode > 0x02 || a_len + b_len < m_ws_deflate_min) return false;
+    if (client.closing) return true;
     
-    if (hasCmd(cmd, "resume") || hasCmd(cmd, "clear_estop") || hasType(cmd, "resume")) {
-        g_estop.store(false);
-        wsBroadcast("{\"status\":\"resumed\"}");
-        return;
+    // With context takeover each compressed frame depends on the ones before
+    // it and cannot be dropped once queued: under backpressure, drop it here
+    if (droppable && client.deflate->contextTakeover()) {
+        if (client.tx_bytes + a_len + b_len > m_ws_high_water) {
+            client.tx_dropped++;
+            return true;
+        }
+        droppable = false;
     }
     
-    if (hasType(cmd, "pose")) {
-        uint16_t flags = FLAG_CLAMP_ENABLE;
-        if (g_estop.load()) flags |= FLAG_ESTOP;
-        
-        PosePacket31 pkt = buildPosePacket(100, flags, m_current_servos);
-        sendPosePacket(pkt);
-        
-        wsBroadcast("{\"status\":\"pose_sent\",\"seq\":" + std::to_string(pkt.seq) + "}");
-        return;
+    if (!client.deflate->compress(a, a_len, b, b_len, m_deflate_buf)) {
+        LOG_WARN("WS", "Compression failed on fd=%d, closing", client.fd);
+        client.closing = true;
+        return true;
     }
+    m_deflate_in += a_len + b_len;
+    m_deflate_out += m_deflate_buf.size();
     
-    if (hasType(cmd, "status") || hasCmd(cmd, "status")) {
-        char status[256];
-        snprintf(status, sizeof(status),
-            "{\"status\":\"ok\",\"seq\":%u,\"tx_count\":%u,\"ring_w\":%u,\"ring_r\":%u,\"clients\":%zu}",
-            m_seq, m_mailbox.getTxCount(),
-            m_shared_mem.getWriteIdx(), m_shared_mem.getReadIdx(),
-            m_clients.size());
-        wsBroadcast(status);
-        return;
-    }
+    uint8_t header[WS_FRAME_HEADER_MAX];
+    size_t header_len = ws_frame_header(header, opcode, m_deflate_buf.size());
+    header[0] |= WS_FRAME_RSV1;
+    wsTransmit(client, header, header_len, m_deflate_buf.data(), m_deflate_buf.size(), droppable);
+    return true;
+}
+
+void BrainDaemon::wsTransmit(WsClient& client, const uint8_t* head, size_t head_len,
+                             const uint8_t* body, size_t body_len, bool droppable) {
+    if (client.closing) return;
     
-    if (hasType(cmd, "servo")) {
-        int channel = -1;
-        char name[32] = {0};
-        if (parseJsonString(cmd, "name", name, sizeof(name))) {
-            channel = servoNameToChannel(name);
-        } else {
-            channel = parseJsonInt(cmd, "channel", -1);
-        }
-        
-        if (channel < 0 || channel >= SERVO_COUNT_TOTAL) {
-            wsBroadcast("{\"error\":\"invalid_channel\"}");
+    // Nothing queued: write straight from the caller's buffer, so a reply
+    // only reaches the heap when the socket cannot take all of it
+    size_t sent = 0;
+    if (client.tx_queue.empty()) {
+        struct iovec iov[2] = { { (void*)head, head_len }, { (void*)body, body_len } };
+        struct msghdr msg = {};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = body_len > 0 ? 2 : 1;
+        ssize_t n;
+        do {
+            n = sendmsg(client.fd, &msg, MSG_NOSIGNAL);
+        } while (n < 0 && errno == EINTR);
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            LOG_WARN("WS", "send error on fd=%d: %s", client.fd, strerror(errno));
+            client.closing = true;
             return;
         }
-        
-        int us = parseJsonInt(cmd, "us", -1);
-        if (us < 0) {
-            wsBroadcast("{\"error\":\"missing_us\"}");
+        sent = n > 0 ? (size_t)n : 0;
+        if (sent == head_len + body_len) {
+            m_tx_direct++;
+            if (client.close_after_tx) client.closing = true;
             return;
         }
-        
-        uint16_t clamped = clamp_servo_us((uint16_t)us);
-        m_current_servos[channel] = clamped;
-        
-        uint16_t flags = FLAG_CLAMP_ENABLE;
-        if (g_estop.load()) flags |= FLAG_ESTOP;
-        PosePacket31 pkt = buildPosePacket(0, flags, m_current_servos);
-        sendPosePacket(pkt);
-        
-        char resp[64];
-        snprintf(resp, sizeof(resp), "{\"status\":\"ok\",\"channel\":%d,\"us\":%u}", channel, clamped);
-        wsBroadcast(resp);
+    }
+    
+    // Queue what the socket did not take. A frame that is partly on the
+    // wire has to be finished, so it can no longer be dropped
+    WsTxFrame frame;
+    frame.droppable = droppable && sent == 0;
+    const uint8_t* parts[2] = { head, body };
+    size_t lens[2] = { head_len, body_len };
+    if (sent < head_len && head_len - sent <= sizeof(frame.header)) {
+        frame.header_len = (uint8_t)(head_len - sent);
+        memcpy(frame.header, head + sent, frame.header_len);
+        lens[0] = 0;
+        sent = 0;
+    }
+    size_t rest = lens[0] + lens[1] - sent;
+    frame.payload = m_tx_pool.acquire(rest);
+    uint8_t* out = frame.payload.data();
+    for (int i = 0; i < 2; i++) {
+        size_t skip = std::min(sent, lens[i]);
+        memcpy(out, parts[i] + skip, lens[i] - skip);
+        out += lens[i] - skip;
+        sent -= skip;
+    }
+    m_tx_queued++;
+    wsEnqueue(client, std::move(frame));
+}
+
+void BrainDaemon::wsSendRaw(WsClient& client, const char* data, size_t len) {
+    WsTxFrame frame;
+    frame.payload = m_tx_pool.acquire(len);
+    memcpy(frame.payload.data(), data, len);
+    wsEnqueue(client, std::move(frame));
+}
+
+void BrainDaemon::wsEnqueue(WsClient& client, WsTxFrame&& frame) {
+    if (client.closing) {
+        m_tx_pool.release(std::move(frame.payload));
         return;
     }
     
-    if (hasType(cmd, "servos")) {
-        uint16_t values[SERVO_COUNT_TOTAL];
-        int count = parseJsonIntArray(cmd, "us", values, SERVO_COUNT_TOTAL);
-        
-        if (count != SERVO_COUNT_TOTAL) {
-            char err[64];
-            snprintf(err, sizeof(err), "{\"error\":\"expected_%d_servos\",\"got\":%d}", SERVO_COUNT_TOTAL, count);
-            wsBroadcast(err);
+    if (frame.droppable && client.tx_bytes + frame.size() > m_ws_high_water) {
+        // Under backpressure, drop queued telemetry that has not started sending
+        for (auto it = client.tx_queue.begin(); it != client.tx_queue.end() &&
+             client.tx_bytes + frame.size() > m_ws_high_water; ) {
+            if (it->droppable && it->sent == 0) {
+                client.tx_bytes -= it->size();
+                client.tx_dropped++;
+                m_tx_pool.release(std::move(it->payload));
+                it = client.tx_queue.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        if (client.tx_bytes + frame.size() > m_ws_high_water) {
+            client.tx_dropped++;
+            m_tx_pool.release(std::move(frame.payload));
             return;
         }
-        
-        for (int i = 0; i < SERVO_COUNT_TOTAL; i++) {
-            m_current_servos[i] = clamp_servo_us(values[i]);
+    }
+    
+    if (client.tx_bytes + frame.size() > m_ws_max_queue) {
+        LOG_WARN("WS", "Client fd=%d TX queue over %zu bytes, disconnecting", client.fd, m_ws_max_queue);
+        client.closing = true;
+        m_tx_pool.release(std::move(frame.payload));
+        return;
+    }
+    
+    client.tx_bytes += frame.size();
+    client.tx_queue.push_back(std::move(frame));
+    
+    if (!client.want_write) {
+        wsFlush(client);
+    }
+}
+
+void BrainDaemon::wsFlush(WsClient& client) {
+    while (!client.tx_queue.empty()) {
+        WsTxFrame& frame = client.tx_queue.front();
+        
+        struct iovec iov[2];
+        int iovcnt = 0;
+        size_t off = frame.sent;
+        if (off < frame.header_len) {
+            iov[iovcnt].iov_base = frame.header + off;
+            iov[iovcnt].iov_len = frame.header_len - off;
+            iovcnt++;
+            off = 0;
+        } else {
+            off -= frame.header_len;
+        }
+        if (off < frame.payload.size()) {
+            iov[iovcnt].iov_base = &frame.payload[off];
+            iov[iovcnt].iov_len = frame.payload.size() - off;
+            iovcnt++;
         }
         
-        uint16_t flags = FLAG_CLAMP_ENABLE;
-        if (g_estop.load()) flags |= FLAG_ESTOP;
-        PosePacket31 pkt = buildPosePacket(0, flags, m_current_servos);
-        sendPosePacket(pkt);
+        // sendmsg() is writev() for sockets, plus MSG_NOSIGNAL
+        struct msghdr msg = {};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iovcnt;
+        ssize_t n = sendmsg(client.fd, &msg, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            if (errno == EINTR) continue;
+            LOG_WARN("WS", "send error on fd=%d: %s", client.fd, strerror(errno));
+            client.closing = true;
+            return;
+        }
         
-        char resp[48];
-        snprintf(resp, sizeof(resp), "{\"status\":\"ok\",\"count\":%d}", SERVO_COUNT_TOTAL);
-        wsBroadcast(resp);
+        frame.sent += n;
+        client.tx_bytes -= n;
+        if (frame.sent < frame.size()) break;
+        
+        m_tx_pool.release(std::move(frame.payload));
+        client.tx_queue.pop_front();
+    }
+    
+    if (client.close_after_tx && client.tx_queue.empty()) {
+        client.closing = true;
         return;
     }
     
-    if (hasType(cmd, "get_servos")) {
-        std::string resp = "{\"servos\":[";
-        for (int i = 0; i < SERVO_COUNT_TOTAL; i++) {
-            if (i > 0) resp += ",";
-            resp += std::to_string(m_current_servos[i]);
+    bool want_write = !client.tx_queue.empty();
+    if (want_write != client.want_write) {
+        client.want_write = want_write;
+        uint32_t events = EPOLLIN | EPOLLRDHUP;
+        if (want_write) events |= EPOLLOUT;
+        m_loop.modifyFd(client.fd, events);
+    }
+}
+
+void BrainDaemon::serveMetrics(WsClient& client) {
+    // Body first, then the header written just in front of it, so both go out in one send
+    char* body = m_metrics_buf + METRICS_HEADER_RESERVE;
+    size_t body_len = formatMetrics(body, sizeof(m_metrics_buf) - METRICS_HEADER_RESERVE);
+    
+    char header[METRICS_HEADER_RESERVE];
+    int header_len = snprintf(header, sizeof(header),
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: text/plain; version=0.0.4\r\n"
+        "Content-Length: %zu\r\n"
+        "Connection: close\r\n"
+        "\r\n", body_len);
+    char* response = body - header_len;
+    memcpy(response, header, header_len);
+    size_t len = header_len + body_len;
+    
+    client.rx.clear(m_rx_pool);
+    client.close_after_tx = true;
+    
+    // Usually fits the socket buffer; only a remainder is queued
+    ssize_t n = send(client.fd, response, len, MSG_NOSIGNAL);
+    if (n < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            client.closing = true;
+            return;
         }
-        resp += "]}";
-        wsBroadcast(resp);
+        n = 0;
+    }
+    if ((size_t)n < len) {
+        wsSendRaw(client, response + n, len - n);
+    } else {
+        client.closing = true;
+    }
+}
+
+namespace {
+
+// Appends to a fixed buffer; output past the end is dropped and remembered
+struct TextWriter {
+    char* buf;
+    size_t cap;
+    size_t len = 0;
+    bool overflow = false;
+    
+    TextWriter(char* b, size_t c) : buf(b), cap(c) {}
+    
+    void printf(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+        if (len >= cap) return;
+        va_list args;
+        va_start(args, fmt);
+        int n = vsnprintf(buf + len, cap - len, fmt, args);
+        va_end(args);
+        if (n < 0 || (size_t)n >= cap - len) overflow = true;
+        if (n > 0) len += std::min((size_t)n, cap - len - 1);
+    }
+    
+    bool ok() const { return !overflow; }
+    
+    
+    void metric(const char* name, const char* type, const char* help, unsigned long long value) {
+        printf("# HELP %s %s\n# TYPE %s %s\n%s %llu\n", name, help, name, type, name, value);
+    }
+};
+
+}  // namespace
+
+size_t BrainDaemon::formatMetrics(char* buf, size_t len) {
+    TextWriter w(buf, len);
+    
+    size_t ws_clients = 0;
+    for (const auto& client : m_clients) {
+        if (client.handshake_done && !client.closing) ws_clients++;
+    }
+    uint32_t ring_w = m_motion.getWriteIdx();
+    uint32_t ring_r = m_motion.getReadIdx();
+    
+    w.metric("spider_uptime_seconds", "gauge", "Seconds since the daemon started",
+             (timebase_millis64() - m_start_time_ms) / 1000);
+    w.metric("spider_packets_sent_total", "counter", "Pose packets written to the shared ring",
+             m_motion.getPacketsSent());
+    w.metric("spider_mailbox_tx_total", "counter", "Mailbox commands sent to the Muscle",
+             m_motion.getTxCount());
+    w.metric("spider_ring_slots", "gauge", "Shared ring capacity in slots", m_motion.getRingSlots());
+    w.metric("spider_ring_occupancy", "gauge", "Slots written but not yet consumed by the Muscle",
+             ring_w - ring_r);
+    w.metric("spider_motion_queue_drops_total", "counter", "Poses dropped because the motion queue was full",
+             m_motion.getQueueDrops());
+    w.metric("spider_ring_drops_total", "counter", "Packets given up by flow control while the shared ring was full",
+             m_motion.getRingDrops());
+    
+    DeliveryStats d = m_motion.getDeliveryStats();
+    w.metric("spider_delivery_acked_total", "counter", "Packets the Muscle acknowledged as applied", d.acked);
+    w.printf("# HELP spider_delivery_nacked_total Packets the Muscle rejected\n"
+             "# TYPE spider_delivery_nacked_total counter\n");
+    for (int i = 1; i < SHARED_NACK_COUNT; i++) {
+        w.printf("spider_delivery_nacked_total{reason=\"%s\"} %u\n",
+                 shared_ack_status_name((uint8_t)i), d.nacked[i]);
+    }
+    w.metric("spider_delivery_ack_lost_total", "counter", "ACK records overwritten before the Brain read them",
+             d.ack_lost);
+    w.metric("spider_delivery_backlog", "gauge", "Packets waiting for shared ring credit", d.backlog);
+    w.metric("spider_delivery_skipped_total", "counter", "Packets the Muscle superseded by a newer immediate one",
+             d.skipped);
+    w.metric("spider_delivery_coalesced_total", "counter", "Waiting poses replaced by a newer one", d.coalesced);
+    w.metric("spider_delivery_blocked_total", "counter", "Flushes that waited for ring credit", d.blocked);
+    w.metric("spider_delivery_overwritten_total", "counter", "Unread ring slots replaced by a newer pose",
+             d.overwritten);
+    w.metric("spider_delivery_deltas_total", "counter", "Packets written as sparse PosePacketDelta", d.deltas);
+    w.metric("spider_avoid_enabled", "gauge", "1 while reactive obstacle avoidance is on", m_avoid_enabled ? 1 : 0);
+    w.metric("spider_avoid_changes_total", "counter", "Obstacle avoidance action changes", m_avoid_changes);
+    w.metric("spider_estop_active", "gauge", "1 while E-STOP is latched", g_estop.load() ? 1 : 0);
+    w.metric("spider_estop_transitions_total", "counter", "E-STOP triggers and clears", m_estop_transitions);
+    w.metric("spider_ws_clients", "gauge", "Connected WebSocket clients", ws_clients);
+    w.printf("# HELP spider_ws_tx_frames_total Outbound frames by path\n"
+             "# TYPE spider_ws_tx_frames_total counter\n"
+             "spider_ws_tx_frames_total{path=\"direct\"} %llu\n"
+             "spider_ws_tx_frames_total{path=\"queued\"} %llu\n",
+             (unsigned long long)m_tx_direct, (unsigned long long)m_tx_queued);
+    w.printf("# HELP spider_ws_deflate_bytes_total Payload bytes of compressed frames, before and after\n"
+             "# TYPE spider_ws_deflate_bytes_total counter\n"
+             "spider_ws_deflate_bytes_total{stage=\"in\"} %llu\n"
+             "spider_ws_deflate_bytes_total{stage=\"out\"} %llu\n",
+             (unsigned long long)m_deflate_in, (unsigned long long)m_deflate_out);
+    w.metric("spider_reply_arena_high_water_bytes", "gauge", "Most reply arena bytes used in one loop iteration",
+             m_arena.highWater());
+    w.metric("spider_reply_arena_overflows_total", "counter", "Replies that did not fit the reply arena",
+             m_arena.overflows());
+    w.metric("spider_heap_allocs_total", "counter", "operator new calls since start, all threads", alloc_count());
+    w.printf("# HELP spider_loop_seconds_total Event loop time spent in callbacks, by subsystem\n"
+             "# TYPE spider_loop_seconds_total counter\n");
+    for (int i = 0; i < LOOP_COST_COUNT; i++) {
+        w.printf("spider_loop_seconds_total{subsystem=\"%s\"} %.6f\n",
+                 s_loop_cost_names[i], m_loop_cost[i].total_us / 1e6);
+    }
+    w.printf("# HELP spider_loop_callbacks_total Event loop callbacks run, by subsystem\n"
+             "# TYPE spider_loop_callbacks_total counter\n");
+    for (int i = 0; i < LOOP_COST_COUNT; i++) {
+        w.printf("spider_loop_callbacks_total{subsystem=\"%s\"} %llu\n",
+                 s_loop_cost_names[i], (unsigned long long)m_loop_cost[i].calls);
+    }
+    w.printf("# HELP spider_loop_callback_seconds_max Longest event loop callback, by subsystem\n"
+             "# TYPE spider_loop_callback_seconds_max gauge\n");
+    for (int i = 0; i < LOOP_COST_COUNT; i++) {
+        w.printf("spider_loop_callback_seconds_max{subsystem=\"%s\"} %.6f\n",
+                 s_loop_cost_names[i], m_loop_cost[i].max_us / 1e6);
+    }
+    w.printf("# HELP spider_loop_allocs_total operator new calls made in event loop callbacks, by subsystem\n"
+             "# TYPE spider_loop_allocs_total counter\n");
+    for (int i = 0; i < LOOP_COST_COUNT; i++) {
+        w.printf("spider_loop_allocs_total{subsystem=\"%s\"} %llu\n",
+                 s_loop_cost_names[i], (unsigned long long)m_loop_cost[i].allocs);
+    }
+    
+    const TimerWheel& timers = m_loop.timers();
+    w.printf("# HELP spider_timer_runs_total Periodic job runs\n"
+             "# TYPE spider_timer_runs_total counter\n");
+    for (int id = 0; id < timers.count(); id++) {
+        if (const TimerWheel::Stats* t = timers.stats(id)) {
+            w.printf("spider_timer_runs_total{job=\"%s\"} %llu\n", t->name, (unsigned long long)t->runs);
+        }
+    }
+    w.printf("# HELP spider_timer_missed_total Periodic job runs dropped because a run started a period late\n"
+             "# TYPE spider_timer_missed_total counter\n");
+    for (int id = 0; id < timers.count(); id++) {
+        if (const TimerWheel::Stats* t = timers.stats(id)) {
+            w.printf("spider_timer_missed_total{job=\"%s\"} %llu\n", t->name, (unsigned long long)t->missed);
+        }
+    }
+    w.printf("# HELP spider_timer_late_seconds_total Time periodic job runs started after their deadline\n"
+             "# TYPE spider_timer_late_seconds_total counter\n");
+    for (int id = 0; id < timers.count(); id++) {
+        if (const TimerWheel::Stats* t = timers.stats(id)) {
+            w.printf("spider_timer_late_seconds_total{job=\"%s\"} %.3f\n", t->name, t->late_total_ms / 1000.0);
+        }
+    }
+    w.printf("# HELP spider_timer_late_seconds_max Latest start of a periodic job run\n"
+             "# TYPE spider_timer_late_seconds_max gauge\n");
+    for (int id = 0; id < timers.count(); id++) {
+        if (const TimerWheel::Stats* t = timers.stats(id)) {
+            w.printf("spider_timer_late_seconds_max{job=\"%s\"} %.3f\n", t->name, t->late_max_ms / 1000.0);
+        }
+    }
+    w.metric("spider_eye_connected", "gauge", "1 while the Eye Service is connected", m_eye_connected ? 1 : 0);
+    w.metric("spider_distance_available", "gauge", "1 if the VL53L0X is present", m_distance_available ? 1 : 0);
+    w.metric("spider_serial_available", "gauge", "1 if the serial control port is open", m_serial_available ? 1 : 0);
+    if (m_udp.getFd() >= 0) {
+        const UdpTeleop::Stats& u = m_udp.stats();
+        w.printf("# HELP spider_udp_datagrams_total Teleop datagrams by outcome\n"
+                 "# TYPE spider_udp_datagrams_total counter\n");
+        const struct { const char* name; uint32_t count; } outcomes[] = {
+            { "accepted", u.accepted }, { "superseded", u.superseded }, { "malformed", u.malformed },
+            { "bad_tag", u.bad_tag }, { "out_of_order", u.out_of_order }, { "stale", u.stale },
+            { "busy", u.busy }
+        };
+        for (const auto& o : outcomes) {
+            w.printf("spider_udp_datagrams_total{result=\"%s\"} %u\n", o.name, o.count);
+        }
+    }
+    
+    SharedTelemetryData t;
+    if (m_motion.readMuscleTelemetry(t)) {
+        w.metric("spider_muscle_rx_total", "counter", "Packets the Muscle accepted", t.rx_count);
+        w.metric("spider_muscle_drops_total", "counter", "Packets the Muscle rejected", t.drop_count);
+        w.metric("spider_muscle_skipped_total", "counter", "Immediate packets the Muscle merged into a newer one",
+                 t.skip_count);
+        w.metric("spider_muscle_overruns_total", "counter", "Ring slots the Muscle found overwritten",
+                 t.overrun_count);
+        w.metric("spider_muscle_faults", "gauge", "Muscle fault flag bitmap", t.fault_flags);
+    }
+    w.metric("spider_ipc_pings_lost_total", "counter", "Latency probes the Muscle never answered",
+             m_motion.getPingsLost());
+    
+    // Power-of-two bounds line up with the histogram's bucket groups, so counts are exact
+    LatencyHistogram::Snapshot lat[LATENCY_METRIC_COUNT];
+    snapshotLatencies(lat);
+    w.printf("# HELP spider_latency_seconds Latency along the command path\n"
+             "# TYPE spider_latency_seconds histogram\n");
+    for (int m = 0; m < LATENCY_METRIC_COUNT; m++) {
+        const LatencyHistogram::Snapshot& s = lat[m];
+        uint64_t cumulative = 0;
+        size_t bucket = 0;
+        for (int shift = 6; shift <= 24; shift += 2) {
+            uint32_t bound_us = 1u << shift;
+            while (bucket < LATENCY_BUCKETS && LatencyHistogram::bucketHigh(bucket) < bound_us) {
+                cumulative += s.counts[bucket++];
+            }
+            w.printf("spider_latency_seconds_bucket{path=\"%s\",le=\"%g\"} %llu\n",
+                     s_latency_names[m], bound_us / 1e6, (unsigned long long)cumulative);
+        }
+        w.printf("spider_latency_seconds_bucket{path=\"%s\",le=\"+Inf\"} %llu\n"
+                 "spider_latency_seconds_sum{path=\"%s\"} %.6f\n"
+                 "spider_latency_seconds_count{path=\"%s\"} %llu\n",
+                 s_latency_names[m], (unsigned long long)s.count,
+                 s_latency_names[m], s.sum_us / 1e6,
+                 s_latency_names[m], (unsigned long long)s.count);
+    }
+    
+    return w.len;
+}
+
+void BrainDaemon::wsBroadcast(const char* msg, size_t len, bool droppable) {
+    if (m_batch_active) {
+        batchAppend(msg, len, true);
         return;
     }
+    if (wsReplyTagged(msg, len)) {
+        return;
+    }
+    for (auto& client : m_clients) {
+        if (client.handshake_done && !client.closing) {
+            wsSendFrame(client, (const uint8_t*)msg, len, 0x01, droppable);
+        }
+    }
+}
+
+void BrainDaemon::wsBroadcast(JsonWriter& w, bool droppable) {
+    if (!w.ok()) {
+        wsBroadcast("{\"error\":\"reply_too_large\"}");
+        return;
+    }
+    if (m_batch_active) {
+        batchAppend(w.data(), w.size(), true);
+        return;
+    }
+    if (wsReplyTagged(w.data(), w.size())) {
+        return;
+    }
+    // Framed once in the arena, then the same bytes go to every client
+    size_t len;
+    const uint8_t* frame = w.frame(len);
+    for (auto& client : m_clients) {
+        if (client.handshake_done && !client.closing) {
+            wsSendPrepared(client, frame, len, droppable);
+        }
+    }
+}
+
+#define COMMAND(name, fn) { json_hash(name), name, &BrainDaemon::fn, false }
+#define MOTION_COMMAND(name, fn) { json_hash(name), name, &BrainDaemon::fn, true }
+
+// "cmd" takes precedence over "type"; both accept any command name
+constexpr BrainDaemon::CommandEntry BrainDaemon::s_commands[] = {
+    MOTION_COMMAND("estop",  cmdEstop),
+    MOTION_COMMAND("stop",   cmdStop),
+    COMMAND("resume",        cmdResume),
+    COMMAND("clear_estop",   cmdResume),
+    COMMAND("pose",          cmdPose),
+    COMMAND("status",        cmdStatus),
+    COMMAND("telemetry",     cmdTelemetry),
+    COMMAND("servo",         cmdServo),
+    COMMAND("servos",        cmdServos),
+    COMMAND("get_servos",    cmdGetServos),
+    MOTION_COMMAND("move",   cmdMove),
+    MOTION_COMMAND("walk",   cmdWalk),
+    COMMAND("avoid",         cmdAvoid),
+    MOTION_COMMAND("feet",   cmdFeet),
+    MOTION_COMMAND("play",   cmdPlay),
+    COMMAND("motions",       cmdMotions),
+    COMMAND("calib_reload",  cmdCalibReload),
+    COMMAND("tunables",      cmdTunables),
+    COMMAND("set_tunable",   cmdSetTunable),
+    COMMAND("tunables_reload", cmdTunablesReload),
+    COMMAND("look",          cmdLook),
+    COMMAND("blink",         cmdBlink),
+    COMMAND("wink",          cmdWink),
+    COMMAND("mood",          cmdMood),
+    COMMAND("eye",           cmdEye),
+    COMMAND("distance",      cmdDistance),
+    COMMAND("distance_profile", cmdDistanceProfile),
+    COMMAND("scan",          cmdScan),
+    COMMAND("scan_start",    cmdScanStart),
+    COMMAND("scan_stop",     cmdScanStop),
+    COMMAND("scan_status",   cmdScanStatus),
+    COMMAND("scan_get_data", cmdScanGetData),
+    COMMAND("map_get",       cmdMapGet),
+    COMMAND("map_clear",     cmdMapClear),
+    COMMAND("subscribe",     cmdSubscribe),
+    COMMAND("unsubscribe",   cmdUnsubscribe),
+    COMMAND("trace_dump",    cmdTraceDump),
+    COMMAND("batch",         cmdBatch),
+    COMMAND("cpu_stats",     cmdCpuStats),
+    COMMAND("profile",       cmdProfile),
+    { 0, nullptr, nullptr, false }
+};
+
+#undef COMMAND
+#undef MOTION_COMMAND
+
+const BrainDaemon::CommandEntry* BrainDaemon::findCommand(const JsonTokens& msg) const {
+    const JsonToken* name = msg.find("cmd");
+    if (!name || name->type != JsonType::STRING) {
+        name = msg.find("type");
+    }
+    if (!name || name->type != JsonType::STRING) {
+        return nullptr;
+    }
     
-    if (hasType(cmd, "move")) {
-        int t_ms = parseJsonInt(cmd, "t_ms", 0);
-        if (t_ms < 0) t_ms = 0;
-        
-        uint16_t values[SERVO_COUNT_TOTAL];
-        int count = parseJsonIntArray(cmd, "us", values, SERVO_COUNT_TOTAL);
-        
-        if (count != SERVO_COUNT_TOTAL) {
-            char err[64];
-            snprintf(err, sizeof(err), "{\"error\":\"expected_%d_servos\",\"got\":%d}", SERVO_COUNT_TOTAL, count);
-            wsBroadcast(err);
-            return;
+    uint32_t hash = json_hash(name->val, name->val_len);
+    for (const CommandEntry* e = s_commands; e->name; e++) {
+        if (e->hash == hash && strncmp(e->name, name->val, name->val_len) == 0 &&
+            e->name[name->val_len] == '\0') {
+            return e;
         }
-        
+    }
+    return nullptr;
+}
+
+// A batch is counted as a whole and each of its commands again on its own
+void BrainDaemon::runCommand(const CommandEntry* e, const JsonTokens& msg) {
+    static_assert(sizeof(s_commands) / sizeof(s_commands[0]) <= COMMAND_MAX + 1, "raise COMMAND_MAX");
+    CpuScope cpu(m_cmd_cost[e - s_commands]);
+    (this->*e->handler)(msg);
+}
+
+void BrainDaemon::handleCommand(const char* data, size_t len) {
+    LOG_DEBUG("Brain", "Received: %.*s", (int)len, data);
+    
+    JsonTokens msg;
+    if (!msg.parse(data, len)) {
+        wsBroadcast("{\"error\":\"invalid_json\"}");
+        return;
+    }
+    
+    // A command with an id is answered to its sender only, tagged, so a
+    // client can pipeline requests and match the replies
+    const JsonToken* id = msg.find("id");
+    m_cmd_id_len = 0;
+    if (m_cmd_client && id && id->type == JsonType::NUMBER && id->val_len <= WS_CMD_ID_MAX &&
+        strspn(id->val, "0123456789") >= id->val_len) {
+        memcpy(m_cmd_id, id->val, id->val_len);
+        m_cmd_id_len = id->val_len;
+    }
+    
+    const CommandEntry* e = findCommand(msg);
+    if (!e) {
+        wsBroadcast("{\"error\":\"unknown_command\"}");
+    } else {
+        runCommand(e, msg);
+    }
+    m_cmd_id_len = 0;
+}
+
+/**
+ * {"cmd":"batch","cmds":[{"cmd":"servo",...},{"cmd":"look",...},...]}
+ * Runs the commands in order with nothing in between and answers once:
+ * {"status":"batch","count":N,"packets":P,"results":[...replies in order]}.
+ * The whole batch is refused, with the index of the culprit, if any
+ * element is not a known command.
+ */
+void BrainDaemon::cmdBatch(const JsonTokens& msg) {
+    if (m_batch_active) {
+        wsBroadcast("{\"error\":\"nested_batch\"}");
+        return;
+    }
+    const JsonToken* cmds = msg.find("cmds");
+    if (!cmds || cmds->type != JsonType::ARRAY) {
+        wsBroadcast("{\"error\":\"missing_cmds\"}");
+        return;
+    }
+    
+    // Everything is parsed and looked up before anything runs
+    BatchState& b = m_batch;
+    const char* cursor = nullptr;
+    const char* obj;
+    size_t obj_len;
+    int count = 0;
+    bool ok = true;
+    while (JsonTokens::nextObject(*cmds, cursor, obj, obj_len)) {
+        ok = count < BATCH_MAX_COMMANDS && b.cmds[count].parse(obj, obj_len) &&
+             (b.entries[count] = findCommand(b.cmds[count])) != nullptr &&
+             b.entries[count]->handler != &BrainDaemon::cmdBatch;
+        if (!ok) break;
+        count++;
+    }
+    if (!ok || cursor != nullptr || count == 0) {
+        char err[64];
+        snprintf(err, sizeof(err), "{\"error\":\"invalid_batch\",\"index\":%d}", count);
+        wsBroadcast(err);
+        return;
+    }
+    
+    b.reply_len = (size_t)snprintf(b.reply, sizeof(b.reply), "{\"status\":\"batch\",\"count\":%d,\"results\":[", count);
+    b.replies = 0;
+    b.shared = false;
+    b.truncated = false;
+    b.pose_pending = false;
+    b.packets = 0;
+    
+    m_batch_active = true;
+    for (int i = 0; i < count; i++) {
+        if (b.entries[i]->motion) batchFlushPose();
+        runCommand(b.entries[i], b.cmds[i]);
+    }
+    batchFlushPose();
+    m_batch_active = false;
+    
+    // Room for the tail was kept back by batchAppend()
+    b.reply_len += (size_t)snprintf(b.reply + b.reply_len, sizeof(b.reply) - b.reply_len,
+                                    "],\"packets\":%d%s}", b.packets, b.truncated ? ",\"truncated\":true" : "");
+    if (wsReplyTagged(b.reply, b.reply_len)) {
+        return;
+    }
+    if (b.shared || !m_cmd_client) {
+        wsBroadcast(b.reply, b.reply_len);
+    } else {
+        wsSendFrame(*m_cmd_client, (const uint8_t*)b.reply, b.reply_len);
+    }
+}
+
+void BrainDaemon::batchAppend(const char* msg, size_t len, bool shared) {
+    static const size_t tail = 48;
+    BatchState& b = m_batch;
+    b.shared = b.shared || shared;
+    if (b.reply_len + 1 + len + tail > sizeof(b.reply)) {
+        b.truncated = true;
+        return;
+    }
+    if (b.replies++ > 0) b.reply[b.reply_len++] = ',';
+    memcpy(b.reply + b.reply_len, msg, len);
+    b.reply_len += len;
+}
+
+void BrainDaemon::batchFlushPose() {
+    BatchState& b = m_batch;
+    if (!b.pose_pending) return;
+    b.pose_pending = false;
+    
+    uint16_t flags = FLAG_CLAMP_ENABLE | b.pose_flags;
+    if (g_estop.load()) flags |= FLAG_ESTOP;
+    uint32_t seq = 0;
+    if (!m_motion.submitPose(b.pose_t_ms, flags, b.pose_mask, b.pose_us, &seq, 0, m_cmd_rx_us)) {
+        static const char err[] = "{\"error\":\"motion_queue_full\"}";
+        batchAppend(err, sizeof(err) - 1, true);
+        return;
+    }
+    if (m_cmd_rx_us) trace_point_at(SHARED_TRACE_CMD_DECODED, m_cmd_rx_us, seq);
+    b.packets++;
+}
+
+void BrainDaemon::cmdEstop(const JsonTokens&) {
+    // Seen by the pre-scan and acted on already; only the reply waited its turn
+    if (m_cmd_client && m_cmd_client->estop_ahead > 0) {
+        m_cmd_client->estop_ahead--;
+    } else {
+        triggerEstop(m_cmd_rx_us);
+    }
+    wsBroadcast("{\"status\":\"estop_activated\"}");
+}
+
+void BrainDaemon::triggerEstop(uint64_t rx_us) {
+    g_estop.store(true);
+    m_sched_end_us = 0;
+    // CMD_ESTOP leaves from here, before any reply or broadcast
+    m_motion.submitEstop();
+    if (m_estop_rx_us == 0) {
+        m_estop_rx_us = rx_us;
+    }
+}
+
+void BrainDaemon::cmdStop(const JsonTokens&) {
+    g_estop.store(false);
+    m_walk_requested = false;
+    m_motion.stopWalk();
+    m_motion.stopPlayback();
+    wsBroadcast("{\"status\":\"stopped\"}");
+}
+
+void BrainDaemon::cmdResume(const JsonTokens&) {
+    g_estop.store(false);
+    wsBroadcast("{\"status\":\"resumed\"}");
+}
+
+void BrainDaemon::cmdPose(const JsonTokens&) {
+    uint32_t seq = 0;
+    if (!queuePose(100, 0, 0, nullptr, &seq)) return;
+    
+    char resp[64];
+    snprintf(resp, sizeof(resp), "{\"status\":\"pose_sent\",\"seq\":%u}", seq);
+    wsBroadcast(resp);
+}
+
+void BrainDaemon::cmdStatus(const JsonTokens&) {
+    char status[STATUS_JSON_SIZE];
+    TextWriter w(status, sizeof(status));
+    w.printf("{\"status\":\"ok\",\"seq\":%u,\"tx_count\":%u,\"ring_w\":%u,\"ring_r\":%u,\"ring_slots\":%u,\"clients\":%zu,\"walking\":%s,\"playing\":%s,\"moving\":%s,\"ipc_lost\":%u",
+        m_motion.getSeq(), m_motion.getTxCount(),
+        m_motion.getWriteIdx(), m_motion.getReadIdx(), m_motion.getRingSlots(),
+        m_clients.size(), m_motion.isWalking() ? "true" : "false",
+        m_motion.isPlaying() ? "true" : "false", m_motion.isMoving() ? "true" : "false",
+        m_motion.getPingsLost());
+    
+    char muscle[MUSCLE_JSON_SIZE];
+    if (formatMuscleTelemetry(muscle, sizeof(muscle), false, true) > 0) {
+        w.printf(",\"muscle\":%s", muscle);
+    }
+    
+    DeliveryStats d = m_motion.getDeliveryStats();
+    w.printf(
+        ",\"delivery\":{\"policy\":\"%s\",\"pose_policy\":\"%s\",\"written\":%u,\"acked\":%u,\"nacked\":{",
+        flowPolicyName(m_motion.getFlowPolicy()), flowPolicyName(m_motion.getPosePolicy()), d.written, d.acked);
+    for (int i = 1; i < SHARED_NACK_COUNT; i++) {
+        w.printf("%s\"%s\":%u", i > 1 ? "," : "",
+                 shared_ack_status_name((uint8_t)i), d.nacked[i]);
+    }
+    w.printf(
+        "},\"skipped\":%u,\"ack_lost\":%u,\"backlog\":%u,\"backlog_max\":%u,\"coalesced\":%u,\"dropped\":%u,"
+        "\"overwritten\":%u,\"blocked\":%u,\"deltas\":%u}",
+        d.skipped, d.ack_lost, d.backlog, d.backlog_max, d.coalesced, d.dropped, d.overwritten, d.blocked,
+        d.deltas);
+    
+    const ObstacleAvoider::Decision& avoid = m_avoider.decision();
+    w.printf(
+        ",\"avoid\":{\"enabled\":%s,\"action\":\"%s\",\"front_mm\":%d,\"heading_deg\":%d}",
+        m_avoid_enabled ? "true" : "false", ObstacleAvoider::actionName(avoid.action),
+        avoid.front_mm, avoid.heading_deg);
+    
+    LatencyHistogram::Snapshot lat[LATENCY_METRIC_COUNT];
+    snapshotLatencies(lat);
+    w.printf(",\"latency_us\":{");
+    for (int i = 0; i < LATENCY_METRIC_COUNT; i++) {
+        w.printf(
+            "%s\"%s\":{\"n\":%llu,\"p50\":%u,\"p99\":%u,\"p999\":%u,\"max\":%u}",
+            i > 0 ? "," : "", s_latency_names[i], (unsigned long long)lat[i].count,
+            lat[i].percentile(0.5), lat[i].percentile(0.99), lat[i].percentile(0.999), lat[i].max_us);
+    }
+    w.printf("}}");
+    if (!w.ok()) {
+        wsBroadcast("{\"error\":\"reply_too_large\"}");
+        return;
+    }
+    wsBroadcast(status);
+}
+
+// telemetry: {"cmd":"telemetry","rate_ms":100} streams Muscle telemetry; rate_ms 0 stops it
+void BrainDaemon::cmdTelemetry(const JsonTokens& msg) {
+    int rate_ms = msg.getInt("rate_ms", 0);
+    if (rate_ms > 0 && rate_ms < TELEMETRY_MIN_INTERVAL_MS) {
+        rate_ms = TELEMETRY_MIN_INTERVAL_MS;
+    }
+    if (rate_ms < 0) {
+        rate_ms = 0;
+    }
+    m_loop.setTimerInterval(m_telemetry_timer, (uint32_t)rate_ms);
+    
+    char resp[64];
+    snprintf(resp, sizeof(resp), "{\"status\":\"ok\",\"telemetry_ms\":%d}", rate_ms);
+    wsBroadcast(resp);
+}
+
+/**
+ * Muscle telemetry as a JSON object, with the load monitor's figures
+ * under "load" if asked. Returns its length, or 0 if the Muscle has not
+ * published (or the snapshot raced every try).
+ */
+int BrainDaemon::formatMuscleTelemetry(char* buf, size_t len, bool servos, bool load) {
+    SharedTelemetryData t;
+    if (!m_motion.readMuscleTelemetry(t)) {
+        return 0;
+    }
+    
+    uint64_t now_us = timebase_shared_us();
+    uint64_t age_ms = (now_us > t.time_us) ? (now_us - t.time_us) / 1000 : 0;
+    TextWriter w(buf, len);
+    w.printf("{\"age_ms\":%llu,\"ticks\":%u,\"rx\":%u,\"drop\":%u,\"skip\":%u,\"overrun\":%u,\"seq\":%u,\"faults\":%u,"
+        "\"unknown_cmds\":%u,\"watchdog\":%u,\"estop\":%s,\"moving\":%s,"
+        "\"tick_us\":%u,\"tick_max_us\":%u,\"work_us\":%u,\"work_max_us\":%u",
+        (unsigned long long)age_ms, t.ticks, t.rx_count, t.drop_count, t.skip_count, t.overrun_count, t.last_seq,
+        t.fault_flags, t.unknown_cmds, (unsigned)t.watchdog_state,
+        t.estop ? "true" : "false", t.interp_active ? "true" : "false",
+        t.tick_period_us, t.tick_period_max_us, t.tick_work_us, t.tick_work_max_us);
+    
+    if (servos) {
+        w.printf(",\"servos\":[");
         for (int i = 0; i < SERVO_COUNT_TOTAL; i++) {
-            m_current_servos[i] = clamp_servo_us(values[i]);
+            w.printf(i > 0 ? ",%u" : "%u", t.servo_us[i]);
         }
-        
-        uint16_t flags = FLAG_CLAMP_ENABLE;
-        if (g_estop.load()) flags |= FLAG_ESTOP;
-        PosePacket31 pkt = buildPosePacket((uint32_t)t_ms, flags, m_current_servos);
-        sendPosePacket(pkt);
-        
-        char resp[64];
-        snprintf(resp, sizeof(resp), "{\"status\":\"ok\",\"t_ms\":%d,\"seq\":%u}", t_ms, pkt.seq);
-        wsBroadcast(resp);
+        w.printf("]");
+    }
+    if (load) {
+        // Stage timings stay in cycles; cycles_per_us converts
+        w.printf(",\"load\":{\"cycles_per_us\":%u,\"stages\":{", t.cycles_per_us);
+        for (int i = 0; i < SHARED_LOAD_STAGE_COUNT; i++) {
+            const SharedLoadStage& st = t.stage[i];
+            w.printf("%s\"%s\":{\"n\":%u,\"min\":%u,\"avg\":%u,\"max\":%u}",
+                     i > 0 ? "," : "", shared_load_stage_name(i), st.count, st.min_cycles,
+                     st.avg_cycles, st.max_cycles);
+        }
+        w.printf("},\"tasks\":{");
+        for (int i = 0; i < SHARED_LOAD_TASK_COUNT; i++) {
+            w.printf("%s\"%s\":{\"load_permille\":%u,\"stack_free_words\":%u}",
+                     i > 0 ? "," : "", shared_load_task_name(i), t.task_load_permille[i],
+                     t.stack_free_words[i]);
+        }
+        w.printf("},\"jitter_us\":{");
+        for (int i = 0; i < SHARED_JITTER_BINS; i++) {
+            uint32_t edge = shared_jitter_edge_us(i);
+            if (edge == UINT32_MAX) {
+                w.printf("%s\"inf\":%u", i > 0 ? "," : "", t.jitter_hist[i]);
+            } else {
+                w.printf("%s\"%u\":%u", i > 0 ? "," : "", edge, t.jitter_hist[i]);
+            }
+        }
+        w.printf("}}");
+    }
+    w.printf("}");
+    return w.ok() ? (int)w.len : 0;
+}
+
+void BrainDaemon::cmdServo(const JsonTokens& msg) {
+    int channel = -1;
+    char name[32] = {0};
+    if (msg.getString("name", name, sizeof(name))) {
+        channel = SpiderModel::channelOf(name);
+    } else {
+        channel = msg.getInt("channel", -1);
+    }
+    
+    if (channel < 0 || channel >= SERVO_COUNT_TOTAL) {
+        wsBroadcast("{\"error\":\"invalid_channel\"}");
+        return;
+    }
+    
+    int us = msg.getInt("us", -1);
+    if (us < 0) {
+        wsBroadcast("{\"error\":\"missing_us\"}");
+        return;
+    }
+    
+    uint16_t clamped = clamp_servo_us((uint16_t)us);
+    uint16_t values[SERVO_COUNT_TOTAL] = {};
+    values[channel] = clamped;
+    if (!queuePose(0, 0, (uint16_t)(1u << channel), values)) return;
+    
+    char resp[64];
+    snprintf(resp, sizeof(resp), "{\"status\":\"ok\",\"channel\":%d,\"us\":%u}", channel, clamped);
+    wsBroadcast(resp);
+}
+
+void BrainDaemon::cmdServos(const JsonTokens& msg) {
+    uint16_t values[SERVO_COUNT_TOTAL];
+    int count = msg.getUintArray("us", values, SERVO_COUNT_TOTAL);
+    
+    if (count != SERVO_COUNT_TOTAL) {
+        char err[64];
+        snprintf(err, sizeof(err), "{\"error\":\"expected_%d_servos\",\"got\":%d}", SERVO_COUNT_TOTAL, count);
+        wsBroadcast(err);
         return;
     }
     
-    // Eye commands - forward to Eye Service
-    if (hasType(cmd, "eye") || hasType(cmd, "look") || hasType(cmd, "blink") ||
-        hasType(cmd, "wink") || hasType(cmd, "mood")) {
-        handleEyeCommand(cmd);
+    if (!queuePose(0, 0, MOTION_MASK_ALL, values)) return;
+    
+    char resp[48];
+    snprintf(resp, sizeof(resp), "{\"status\":\"ok\",\"count\":%d}", SERVO_COUNT_TOTAL);
+    wsBroadcast(resp);
+}
+
+void BrainDaemon::cmdGetServos(const JsonTokens&) {
+    uint16_t servos[SERVO_COUNT_TOTAL];
+    m_motion.getServos(servos);
+    
+    JsonWriter w(m_arena);
+    w.beginObject().beginArray("servos");
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) {
+        w.value(servos[i]);
+    }
+    w.endArray().endObject();
+    wsBroadcast(w);
+}
+
+// Joint move: {"cmd":"move","us":[...13],"t_ms":500,"profile":"trapezoid"}
+// With t_ms > 0 the move is planned ("trapezoid" or "scurve") and may take longer
+// than t_ms to stay within the joint limits; "linear" leaves it to the Muscle
+void BrainDaemon::cmdMove(const JsonTokens& msg) {
+    int t_ms = msg.getInt("t_ms", 0);
+    if (t_ms < 0) t_ms = 0;
+    
+    uint16_t values[SERVO_COUNT_TOTAL];
+    int count = msg.getUintArray("us", values, SERVO_COUNT_TOTAL);
+    
+    if (count != SERVO_COUNT_TOTAL) {
+        char err[64];
+        snprintf(err, sizeof(err), "{\"error\":\"expected_%d_servos\",\"got\":%d}", SERVO_COUNT_TOTAL, count);
+        wsBroadcast(err);
         return;
     }
     
-    // Distance sensor command
-    if (hasType(cmd, "distance")) {
-        handleDistanceCommand(cmd);
+    TrajectoryPlanner::Profile profile =
+        (t_ms > 0) ? TrajectoryPlanner::Profile::TRAPEZOID : TrajectoryPlanner::Profile::NONE;
+    char name[16];
+    if (msg.getString("profile", name, sizeof(name)) && !TrajectoryPlanner::parseProfile(name, profile)) {
+        wsBroadcast("{\"error\":\"unknown_profile\"}");
         return;
     }
+    if (g_estop.load()) profile = TrajectoryPlanner::Profile::NONE;
     
-    // Scan servo manual command (CH12): {"type":"scan","us":1500}
-    if (hasType(cmd, "scan")) {
-        int us = parseJsonInt(cmd, "us", -1);
-        if (us < 0) {
-            wsBroadcast("{\"error\":\"missing_us\"}");
+    uint32_t seq = 0;
+    uint32_t duration_ms = (uint32_t)t_ms;
+    if (profile == TrajectoryPlanner::Profile::NONE) {
+        if (!queuePose((uint32_t)t_ms, 0, MOTION_MASK_ALL, values, &seq)) return;
+    } else {
+        // Same plan as the motion thread's, from the last applied pose
+        uint16_t current[SERVO_COUNT_TOTAL];
+        m_motion.getServos(current);
+        TrajectoryPlanner estimate;
+        duration_ms = estimate.start(current, values, MOTION_MASK_ALL, (uint32_t)t_ms, profile);
+        
+        if (!m_motion.submitMove((uint32_t)t_ms, FLAG_CLAMP_ENABLE, MOTION_MASK_ALL, values,
+                                 profile, &seq, m_cmd_rx_us)) {
+            wsBroadcast("{\"error\":\"motion_queue_full\"}");
             return;
         }
-        
-        uint16_t clamped = clamp_servo_us((uint16_t)us);
-        m_current_servos[SERVO_CHANNEL_SCAN] = clamped;
-        
-        uint16_t flags = FLAG_CLAMP_ENABLE | FLAG_SCAN_ENABLE;
-        if (g_estop.load()) flags |= FLAG_ESTOP;
-        PosePacket31 pkt = buildPosePacket(0, flags, m_current_servos);
-        sendPosePacket(pkt);
-        
+        if (m_cmd_rx_us) trace_point_at(SHARED_TRACE_CMD_DECODED, m_cmd_rx_us, seq);
+    }
+    
+    char resp[128];
+    snprintf(resp, sizeof(resp),
+             "{\"status\":\"ok\",\"t_ms\":%d,\"seq\":%u,\"profile\":\"%s\",\"duration_ms\":%u}",
+             t_ms, seq, TrajectoryPlanner::profileName(profile), duration_ms);
+    wsBroadcast(resp);
+}
+
+// Gait engine: {"cmd":"walk","dir":1.0,"turn":0.0,"speed":1.0,"stride":1.0,"gait":"tripod"}
+// dir and turn are -1..1; both 0 (or omitted) stops at the neutral stance
+void BrainDaemon::cmdWalk(const JsonTokens& msg) {
+    GaitEngine::Params params;
+    params.dir = msg.getFloat("dir", 0.0f);
+    params.turn = msg.getFloat("turn", 0.0f);
+    params.speed = msg.getFloat("speed", 1.0f);
+    params.stride = msg.getFloat("stride", 1.0f);
+    
+    char name[16];
+    if (msg.getString("gait", name, sizeof(name)) && !GaitEngine::parseGait(name, params.gait)) {
+        wsBroadcast("{\"error\":\"unknown_gait\"}");
+        return;
+    }
+    
+    if (const char* error = requestWalk(params)) {
         char resp[64];
-        snprintf(resp, sizeof(resp), "{\"status\":\"ok\",\"scan_us\":%u}", clamped);
+        snprintf(resp, sizeof(resp), "{\"error\":\"%s\"}", error);
         wsBroadcast(resp);
         return;
     }
+    m_udp_walking = false;              // This walk is not the UDP deadman's to stop
     
-    // Autonomous scan controller commands
-    if (hasType(cmd, "scan_start") || hasType(cmd, "scan_stop") ||
-        hasType(cmd, "scan_status") || hasType(cmd, "scan_get_data")) {
-        handleScanCommand(cmd);
+    if (!m_walk_requested) {
+        wsBroadcast("{\"status\":\"walk_stopped\"}");
         return;
     }
     
-    wsBroadcast("{\"error\":\"unknown_command\"}");
+    char resp[192];
+    int n = snprintf(resp, sizeof(resp),
+        "{\"status\":\"walking\",\"gait\":\"%s\",\"dir\":%.2f,\"turn\":%.2f,\"speed\":%.2f,\"stride\":%.2f",
+        GaitEngine::gaitName(params.gait), params.dir, params.turn, params.speed, params.stride);
+    if (m_avoid_enabled) {
+        n += snprintf(resp + n, sizeof(resp) - n, ",\"avoid\":\"%s\"",
+                      ObstacleAvoider::actionName(m_avoider.decision().action));
+    }
+    snprintf(resp + n, sizeof(resp) - n, "}");
+    wsBroadcast(resp);
 }
 
-void BrainDaemon::handleEyeCommand(const std::string& cmd) {
-    auto eyeCommandFailed = [this]() {
-        if (m_eye_connected) {
-            m_eye_connected = false;
-            LOG_WARN("Eye", "Eye Service disconnected, will attempt reconnection");
-        }
-        wsBroadcast("{\"error\":\"eye_service_unavailable\"}");
-    };
+/**
+ * Hand a walk to the gait, steered by the avoider if it is on. Returns
+ * the error token if it was refused, nullptr once it is queued.
+ */
+const char* BrainDaemon::requestWalk(const GaitEngine::Params& params) {
+    bool stopping = params.dir == 0.0f && params.turn == 0.0f;
+    if (!stopping && g_estop.load()) {
+        return "estop_active";
+    }
     
-    // look: {"type":"look","x":0.0,"y":0.0} or {"type":"eye","look":{"x":0.0,"y":0.0}}
-    if (hasType(cmd, "look")) {
-        float x = 0.0f, y = 0.0f;
-        const char* px = strstr(cmd.c_str(), "\"x\":");
-        const char* py = strstr(cmd.c_str(), "\"y\":");
-        if (px) x = strtof(px + 4, nullptr);
-        if (py) y = strtof(py + 4, nullptr);
-        
-        if (m_eye_client.lookAt(x, y)) {
-            wsBroadcast("{\"status\":\"ok\",\"eye\":\"look\"}");
+    // The avoider steers what was asked for, not what it last made of it
+    GaitEngine::Params steered = m_avoid_enabled ? m_avoider.steer(params) : params;
+    if (!m_motion.setWalk(steered)) {
+        return "walk_queue_full";
+    }
+    m_walk_request = params;
+    m_walk_steered = steered;
+    m_walk_requested = !stopping;
+    m_avoid_halted = !stopping && steered.dir == 0.0f && steered.turn == 0.0f;
+    return nullptr;
+}
+
+/**
+ * Datagrams on the teleop port. Only the newest walk and pose of the
+ * whole backlog are acted on; the sender gets one status back.
+ */
+void BrainDaemon::onUdpTeleop() {
+    uint32_t now_ms = timebase_millis();
+    m_cmd_rx_us = timebase_micros();
+    UdpTeleop::Latest latest;
+    if (m_udp.drain(now_ms, latest) == 0) {
+        m_cmd_rx_us = 0;
+        return;
+    }
+    
+    uint8_t result = UDP_TELEOP_RESULT_OK;
+    if (latest.pose) {
+        const WsPoseEntry& entry = latest.pose_msg;
+        uint16_t flags = FLAG_CLAMP_ENABLE | (entry.flags & (FLAG_HOLD | FLAG_INTERP_Q16 | FLAG_SCAN_ENABLE));
+        if (g_estop.load()) flags |= FLAG_ESTOP;
+        uint16_t servos[SERVO_COUNT_TOTAL];
+        memcpy(servos, entry.servo_us, sizeof(servos));
+        if (m_motion.submitPose(entry.t_ms, flags, MOTION_MASK_ALL, servos, &m_udp_pose_seq, 0, m_cmd_rx_us)) {
+            trace_point_at(SHARED_TRACE_CMD_DECODED, m_cmd_rx_us, m_udp_pose_seq);
         } else {
-            eyeCommandFailed();
+            result = UDP_TELEOP_RESULT_QUEUE_FULL;
         }
-        return;
     }
     
-    // blink: {"type":"blink"}
-    if (hasType(cmd, "blink")) {
-        if (m_eye_client.blink()) {
-            wsBroadcast("{\"status\":\"ok\",\"eye\":\"blink\"}");
+    if (latest.walk) {
+        const UdpTeleopWalk& w = latest.walk_msg;
+        GaitEngine::Params params;
+        params.dir = w.dir / 1000.0f;
+        params.turn = w.turn / 1000.0f;
+        params.speed = w.speed / 1000.0f;
+        params.stride = w.stride / 1000.0f;
+        static const GaitEngine::Gait gaits[] = {
+            GaitEngine::Gait::TRIPOD, GaitEngine::Gait::WAVE, GaitEngine::Gait::RIPPLE
+        };
+        const char* error = nullptr;
+        if (w.gait >= sizeof(gaits) / sizeof(gaits[0])) {
+            result = UDP_TELEOP_RESULT_BAD_GAIT;
         } else {
-            eyeCommandFailed();
+            params.gait = gaits[w.gait];
+            error = requestWalk(params);
         }
+        if (error) {
+            result = g_estop.load() ? UDP_TELEOP_RESULT_ESTOP : UDP_TELEOP_RESULT_QUEUE_FULL;
+        } else if (result != UDP_TELEOP_RESULT_BAD_GAIT) {
+            bool walking = m_walk_requested;
+            if (walking != m_udp_walking) {
+                m_loop.setTimerInterval(m_udp_deadman_timer, walking ? UDP_TELEOP_DEADMAN_MS / 5 : 0);
+            }
+            m_udp_walking = walking;
+            m_udp_walk_ms = now_ms;
+        }
+    }
+    m_cmd_rx_us = 0;
+    
+    UdpTeleopStatus status = {};
+    status.state = (g_estop.load() ? UDP_TELEOP_STATE_ESTOP : 0) |
+                   (m_motion.isWalking() ? UDP_TELEOP_STATE_WALKING : 0) |
+                   (m_avoid_halted ? UDP_TELEOP_STATE_HALTED : 0);
+    status.result = result;
+    status.dropped = m_udp.dropped();
+    status.pose_seq = m_udp_pose_seq;
+    GaitEngine::Odometry odom = m_motion.getOdometry();
+    status.x_mm = (int32_t)std::lround(odom.x_mm);
+    status.y_mm = (int32_t)std::lround(odom.y_mm);
+    status.heading_cdeg = (int16_t)std::lround(odom.heading_rad * 18000.0f / (float)M_PI);
+    int front = m_avoid_enabled ? m_avoider.decision().front_mm : -1;
+    status.nearest_mm = (int16_t)std::min(front, (int)INT16_MAX);
+    m_udp.sendStatus(latest.last, status);
+}
+
+// The UDP client went quiet mid-walk: assume it is gone, not holding the stick
+void BrainDaemon::tickUdpDeadman() {
+    uint32_t now_ms = timebase_millis();
+    if (m_udp_walking && now_ms - m_udp_walk_ms < UDP_TELEOP_DEADMAN_MS) {
+        return;
+    }
+    m_loop.setTimerInterval(m_udp_deadman_timer, 0);
+    if (!m_udp_walking) {
         return;
     }
+    m_udp_walking = false;
     
-    // wink: {"type":"wink","eye":"left|right"}
-    if (hasType(cmd, "wink")) {
-        std::string eye = "left";
-        if (cmd.find("\"eye\":\"right\"") != std::string::npos) {
-            eye = "right";
-        }
-        if (m_eye_client.wink(eye)) {
-            wsBroadcast("{\"status\":\"ok\",\"eye\":\"wink\",\"which\":\"" + eye + "\"}");
-        } else {
-            eyeCommandFailed();
+    GaitEngine::Params stop = m_walk_request;
+    stop.dir = 0.0f;
+    stop.turn = 0.0f;
+    if (requestWalk(stop)) {
+        // Retry on the next tick rather than leave it walking
+        m_udp_walking = true;
+        m_loop.setTimerInterval(m_udp_deadman_timer, UDP_TELEOP_DEADMAN_MS / 5);
+        return;
+    }
+    LOG_WARN("UDP", "No walk for %d ms, stopping", UDP_TELEOP_DEADMAN_MS);
+    wsBroadcast("{\"status\":\"walk_stopped\",\"reason\":\"udp_timeout\"}");
+}
+
+// Reactive obstacle avoidance: {"cmd":"avoid","enable":true,"critical_mm":120,"warning_mm":250,"safe_mm":400}
+// Forward walks are slowed, turned or backed off on every new VL53L0X sample; thresholds are optional
+void BrainDaemon::cmdAvoid(const JsonTokens& msg) {
+    bool enable = msg.getBool("enable", true);
+    if (enable && !m_distance_available) {
+        wsBroadcast("{\"error\":\"distance_sensor_not_available\"}");
+        return;
+    }
+    
+    ObstacleAvoider::Config config = m_avoider.getConfig();
+    config.critical_mm = msg.getInt("critical_mm", config.critical_mm);
+    config.warning_mm = msg.getInt("warning_mm", config.warning_mm);
+    config.safe_mm = msg.getInt("safe_mm", config.safe_mm);
+    if (config.critical_mm <= 0 || config.warning_mm < config.critical_mm ||
+        config.safe_mm < config.warning_mm) {
+        wsBroadcast("{\"error\":\"invalid_thresholds\"}");
+        return;
+    }
+    m_avoider.setConfig(config);
+    
+    if (enable != m_avoid_enabled) {
+        m_avoid_enabled = enable;
+        m_avoider.reset();
+        memset(m_avoid_sample_seq, 0, sizeof(m_avoid_sample_seq));
+        m_loop.setTimerInterval(m_avoid_timer, enable ? AVOID_POLL_MS : 0);
+        // Hand an unsteered walk back as it was asked for
+        if (!enable && m_walk_requested && (m_motion.isWalking() || m_avoid_halted) &&
+            m_motion.setWalk(m_walk_request)) {
+            m_walk_steered = m_walk_request;
         }
+        m_avoid_halted = false;
+        streamAvoid();
+        LOG_INFO("Avoid", "Obstacle avoidance %s (critical %d, warning %d, safe %d mm)",
+                 enable ? "enabled" : "disabled", config.critical_mm, config.warning_mm, config.safe_mm);
+    }
+    
+    char resp[128];
+    snprintf(resp, sizeof(resp),
+        "{\"status\":\"ok\",\"avoid\":%s,\"critical_mm\":%d,\"warning_mm\":%d,\"safe_mm\":%d}",
+        enable ? "true" : "false", config.critical_mm, config.warning_mm, config.safe_mm);
+    wsBroadcast(resp);
+}
+
+// Foot positions: {"cmd":"feet","t_ms":100,"pos":[x0,y0,z0, ..., x3,y3,z3]}
+// Body frame in mm (x forward, y left, z up), solved to joint angles on the motion thread
+void BrainDaemon::cmdFeet(const JsonTokens& msg) {
+    int t_ms = msg.getInt("t_ms", 0);
+    if (t_ms < 0) t_ms = 0;
+    
+    float pos[IK_LEG_COUNT * 3];
+    int count = msg.getFloatArray("pos", pos, IK_LEG_COUNT * 3);
+    if (count != IK_LEG_COUNT * 3) {
+        char err[64];
+        snprintf(err, sizeof(err), "{\"error\":\"expected_%d_coords\",\"got\":%d}", IK_LEG_COUNT * 3, count);
+        wsBroadcast(err);
         return;
     }
     
-    // mood: {"type":"mood","mood":"normal|angry|happy|sleepy"}
-    if (hasType(cmd, "mood")) {
-        std::string mood = "normal";
-        if (cmd.find("\"mood\":\"angry\"") != std::string::npos) mood = "angry";
-        else if (cmd.find("\"mood\":\"happy\"") != std::string::npos) mood = "happy";
-        else if (cmd.find("\"mood\":\"sleepy\"") != std::string::npos) mood = "sleepy";
-        
-        if (m_eye_client.setMood(mood)) {
-            wsBroadcast("{\"status\":\"ok\",\"eye\":\"mood\",\"mood\":\"" + mood + "\"}");
-        } else {
-            eyeCommandFailed();
+    FootTargets feet;
+    for (int leg = 0; leg < IK_LEG_COUNT; leg++) {
+        feet.x[leg] = pos[leg * 3];
+        feet.y[leg] = pos[leg * 3 + 1];
+        feet.z[leg] = pos[leg * 3 + 2];
+    }
+    
+    uint16_t flags = FLAG_CLAMP_ENABLE;
+    if (g_estop.load()) flags |= FLAG_ESTOP;
+    
+    uint32_t seq = 0;
+    if (!m_motion.submitFeet((uint32_t)t_ms, flags, feet, &seq, 0, m_cmd_rx_us)) {
+        wsBroadcast("{\"error\":\"motion_queue_full\"}");
+        return;
+    }
+    if (m_cmd_rx_us) trace_point_at(SHARED_TRACE_CMD_DECODED, m_cmd_rx_us, seq);
+    
+    char resp[64];
+    snprintf(resp, sizeof(resp), "{\"status\":\"ok\",\"t_ms\":%d,\"seq\":%u}", t_ms, seq);
+    wsBroadcast(resp);
+}
+
+// Motion pack playback: {"cmd":"play","name":"wave","loops":1,"blend_ms":300}
+// loops 0 repeats until stop; no name stops playback
+void BrainDaemon::cmdPlay(const JsonTokens& msg) {
+    char name[MOTION_PACK_NAME_LEN];
+    if (!msg.getString("name", name, sizeof(name))) {
+        m_motion.stopPlayback();
+        wsBroadcast("{\"status\":\"play_stopped\"}");
+        return;
+    }
+    
+    if (!m_motion_pack.isOpen()) {
+        wsBroadcast("{\"error\":\"no_motion_pack\"}");
+        return;
+    }
+    const MotionPackEntry* entry = m_motion_pack.find(name);
+    if (!entry) {
+        wsBroadcast("{\"error\":\"unknown_sequence\"}");
+        return;
+    }
+    if (g_estop.load()) {
+        wsBroadcast("{\"error\":\"estop_active\"}");
+        return;
+    }
+    
+    MotionPlayer::Request req;
+    req.entry = entry;
+    req.frames = m_motion_pack.frames(*entry);
+    int loops = msg.getInt("loops", 1);
+    int blend_ms = msg.getInt("blend_ms", 0);
+    req.loops = loops > 0 ? (uint32_t)loops : 0;
+    req.blend_ms = blend_ms > 0 ? (uint32_t)blend_ms : 0;
+    
+    if (!m_motion.play(req)) {
+        wsBroadcast("{\"error\":\"play_queue_full\"}");
+        return;
+    }
+    
+    char resp[128];
+    snprintf(resp, sizeof(resp),
+        "{\"status\":\"playing\",\"name\":\"%s\",\"frames\":%u,\"duration_ms\":%u,\"loops\":%u}",
+        entry->name, entry->frame_count, entry->duration_ms, req.loops);
+    wsBroadcast(resp);
+}
+
+// motions: {"cmd":"motions"} lists the motion pack's sequences
+void BrainDaemon::cmdMotions(const JsonTokens&) {
+    JsonWriter w(m_arena);
+    w.beginObject().field("type", "motions").beginArray("sequences");
+    for (size_t i = 0; i < m_motion_pack.sequenceCount(); i++) {
+        const MotionPackEntry* e = m_motion_pack.entry(i);
+        w.beginObject()
+         .field("name", e->name)
+         .field("frames", e->frame_count)
+         .field("duration_ms", e->duration_ms)
+         .endObject();
+    }
+    w.endArray().endObject();
+    wsBroadcast(w);
+}
+
+// calib_reload: {"cmd":"calib_reload","path":"/root/servo_calib.bin"}
+// Re-reads the calibration table (default: the --servo-calib file) without a restart
+void BrainDaemon::cmdCalibReload(const JsonTokens& msg) {
+    char path[256];
+    if (!msg.getString("path", path, sizeof(path))) {
+        snprintf(path, sizeof(path), "%s", m_servo_calib_path.c_str());
+    }
+    
+    ServoCalibration::Table table;
+    if (!ServoCalibration::load(path, table)) {
+        wsBroadcast("{\"error\":\"calib_load_failed\"}");
+        return;
+    }
+    if (!m_motion.setCalibration(table)) {
+        wsBroadcast("{\"error\":\"calib_queue_full\"}");
+        return;
+    }
+    wsBroadcast("{\"status\":\"calib_loaded\"}");
+}
+
+// Hand a validated set to its users. The Muscle's share is only republished when
+// it changed; the Muscle applies it at its next output tick
+void BrainDaemon::applyTunables(const Tunables& next) {
+    if (next.muscleDiffers(m_tunables) && !m_motion.setMuscleTunables(next.muscleData())) {
+        wsBroadcast("{\"error\":\"tunables_queue_full\"}");
+        return;
+    }
+    m_tunables = next;
+    
+    // avoid and scan_start adjust these live until the next tunables change
+    ObstacleAvoider::Config config = m_avoider.getConfig();
+    config.critical_mm = m_tunables.get(Tunables::AVOID_CRITICAL_MM);
+    config.warning_mm = m_tunables.get(Tunables::AVOID_WARNING_MM);
+    config.safe_mm = m_tunables.get(Tunables::AVOID_SAFE_MM);
+    m_avoider.setConfig(config);
+    
+    ScanController::ScanProfile profile = m_scan_controller.getProfile();
+    profile.min_deg = m_tunables.get(Tunables::SCAN_MIN_DEG);
+    profile.max_deg = m_tunables.get(Tunables::SCAN_MAX_DEG);
+    profile.step_deg = m_tunables.get(Tunables::SCAN_STEP_DEG);
+    profile.dwell_ms = m_tunables.get(Tunables::SCAN_DWELL_MS);
+    profile.servo_deg_per_s = m_tunables.get(Tunables::SCAN_SERVO_DEG_PER_S);
+    m_scan_controller.setProfile(profile);
+    
+    replyTunables();
+}
+
+void BrainDaemon::replyTunables() {
+    JsonWriter w(m_arena);
+    w.beginObject().field("type", "tunables")
+     .field("generation", m_motion.getTunablesGeneration())
+     .beginObject("values");
+    for (int i = 0; i < Tunables::COUNT; i++) {
+        w.field(Tunables::info((Tunables::Id)i).name, m_tunables.get((Tunables::Id)i));
+    }
+    w.endObject();
+    
+    // generation 0 = the Muscle still runs its built-in values
+    SharedTunablesApplied applied;
+    if (m_motion.readMuscleTunables(applied)) {
+        w.beginObject("muscle")
+         .field("generation", applied.generation)
+         .field("output_hz", applied.data.output_hz)
+         .field("interp_substeps", applied.data.interp_substeps)
+         .field("heartbeat_timeout_ms", applied.data.heartbeat_timeout_ms)
+         .field("clamped", applied.clamped)
+         .endObject();
+    }
+    w.endObject();
+    wsReply(w);
+}
+
+// tunables: {"cmd":"tunables"}
+// Values in effect, with what the Muscle reports it applied
+void BrainDaemon::cmdTunables(const JsonTokens& msg) {
+    (void)msg;
+    replyTunables();
+}
+
+// set_tunable: {"cmd":"set_tunable","output_hz":40,"heartbeat_timeout_ms":300}
+// Any tunable names, checked and applied together (see tunables.h)
+void BrainDaemon::cmdSetTunable(const JsonTokens& msg) {
+    Tunables::Id ids[Tunables::COUNT];
+    int32_t values[Tunables::COUNT];
+    size_t count = 0;
+    for (int i = 0; i < Tunables::COUNT; i++) {
+        const char* name = Tunables::info((Tunables::Id)i).name;
+        if (msg.find(name)) {
+            ids[count] = (Tunables::Id)i;
+            values[count] = msg.getInt(name, 0);
+            count++;
         }
+    }
+    if (count == 0) {
+        wsBroadcast("{\"error\":\"missing_tunable\"}");
         return;
     }
     
-    // generic eye command: {"type":"eye","action":"..."}
-    if (hasType(cmd, "eye")) {
-        if (cmd.find("\"action\":\"idle_on\"") != std::string::npos) {
-            if (m_eye_client.setIdleEnabled(true)) {
-                wsBroadcast("{\"status\":\"ok\",\"eye\":\"idle_on\"}");
-            } else {
-                eyeCommandFailed();
+    Tunables next = m_tunables;
+    if (!next.set(ids, values, count)) {
+        wsBroadcast("{\"error\":\"invalid_tunable\"}");
+        return;
+    }
+    applyTunables(next);
+}
+
+// tunables_reload: {"cmd":"tunables_reload","path":"/root/tunables.conf"}
+// Re-reads the file (default: --tunables) over the built-in values
+void BrainDaemon::cmdTunablesReload(const JsonTokens& msg) {
+    char path[256];
+    if (!msg.getString("path", path, sizeof(path))) {
+        snprintf(path, sizeof(path), "%s", m_tunables_path.c_str());
+    }
+    
+    Tunables next;
+    if (!Tunables::load(path, next)) {
+        wsBroadcast("{\"error\":\"tunables_load_failed\"}");
+        return;
+    }
+    applyTunables(next);
+}
+
+// Scan servo manual command (CH12): {"type":"scan","us":1500}
+void BrainDaemon::cmdScan(const JsonTokens& msg) {
+    int us = msg.getInt("us", -1);
+    if (us < 0) {
+        wsBroadcast("{\"error\":\"missing_us\"}");
+        return;
+    }
+    
+    uint16_t clamped = clamp_servo_us((uint16_t)us);
+    uint16_t values[SERVO_COUNT_TOTAL] = {};
+    values[SERVO_CHANNEL_SCAN] = clamped;
+    if (!queuePose(0, FLAG_SCAN_ENABLE, (uint16_t)(1u << SERVO_CHANNEL_SCAN), values)) return;
+    
+    char resp[64];
+    snprintf(resp, sizeof(resp), "{\"status\":\"ok\",\"scan_us\":%u}", clamped);
+    wsBroadcast(resp);
+}
+
+void BrainDaemon::handleBinaryPose(WsClient& client, const uint8_t* data, size_t len) {
+    WsPoseAck ack = {};
+    ack.msg = WS_POSE_MSG_ACK;
+    
+    if (submitPoseFrame(data, len, ack)) {
+        wsSendFrame(client, (const uint8_t*)&ack, sizeof(ack), 0x02);
+    }
+}
+
+// WsPoseHeader + entries, from WebSocket or serial; returns true if the ack must be sent
+bool BrainDaemon::submitPoseFrame(const uint8_t* data, size_t len, WsPoseAck& ack) {
+    ack.status = WS_POSE_STATUS_OK;
+    
+    WsPoseHeader hdr;
+    if (len < sizeof(hdr)) {
+        ack.status = WS_POSE_STATUS_MALFORMED;
+        return true;
+    }
+    memcpy(&hdr, data, sizeof(hdr));
+    
+    if (hdr.msg != WS_POSE_MSG_POSE || hdr.count == 0 || hdr.count > WS_POSE_MAX_BATCH ||
+        len != sizeof(hdr) + (size_t)hdr.count * sizeof(WsPoseEntry)) {
+        LOG_DEBUG("Brain", "Malformed binary pose frame (msg=0x%02X count=%u len=%zu)",
+            hdr.msg, hdr.count, len);
+        ack.status = WS_POSE_STATUS_MALFORMED;
+    } else {
+        uint16_t flags = FLAG_CLAMP_ENABLE;
+        if (g_estop.load()) flags |= FLAG_ESTOP;
+        
+        // Scheduled batches play back to back, continuing the previous one if it is still running
+        uint64_t exec_at = 0;
+        if (hdr.req_flags & WS_POSE_REQ_SCHEDULE) {
+            exec_at = timebase_shared_us() + SCHEDULE_LEAD_US;
+            if (m_sched_end_us > exec_at) exec_at = m_sched_end_us;
+        }
+        
+        uint32_t last_seq = 0;
+        const uint8_t* p = data + sizeof(hdr);
+        for (uint8_t i = 0; i < hdr.count; i++, p += sizeof(WsPoseEntry)) {
+            // Payload is unaligned inside the frame buffer
+            WsPoseEntry entry;
+            memcpy(&entry, p, sizeof(entry));
+            uint16_t servos[SERVO_COUNT_TOTAL];
+            memcpy(servos, entry.servo_us, sizeof(servos));
+            
+            uint16_t entry_flags = flags | (entry.flags & (FLAG_HOLD | FLAG_INTERP_Q16 | FLAG_SCAN_ENABLE));
+            if (!m_motion.submitPose(entry.t_ms, entry_flags, MOTION_MASK_ALL, servos, &last_seq, exec_at,
+                                     m_cmd_rx_us)) {
+                ack.status = WS_POSE_STATUS_QUEUE_FULL;
+                break;
             }
-        } else if (cmd.find("\"action\":\"idle_off\"") != std::string::npos) {
-            if (m_eye_client.setIdleEnabled(false)) {
-                wsBroadcast("{\"status\":\"ok\",\"eye\":\"idle_off\"}");
-            } else {
-                eyeCommandFailed();
+            ack.accepted++;
+            if (m_cmd_rx_us) trace_point_at(SHARED_TRACE_CMD_DECODED, m_cmd_rx_us, last_seq);
+            if (exec_at) {
+                exec_at += (uint64_t)entry.t_ms * 1000;
+                m_sched_end_us = exec_at;
             }
-        } else if (cmd.find("\"action\":\"status\"") != std::string::npos) {
-            if (m_eye_client.requestStatus()) {
-                wsBroadcast("{\"status\":\"ok\",\"eye\":\"status_requested\"}");
+        }
+        ack.seq = last_seq;
+    }
+    
+    return (hdr.req_flags & WS_POSE_REQ_ACK) || ack.status != WS_POSE_STATUS_OK;
+}
+
+void BrainDaemon::eyeCommandFailed() {
+    if (m_eye_connected) {
+        m_eye_connected = false;
+        LOG_WARN("Eye", "Eye Service disconnected, will attempt reconnection");
+    }
+    wsBroadcast("{\"error\":\"eye_service_unavailable\"}");
+}
+
+// look: {"type":"look","x":0.0,"y":0.0} or {"type":"eye","look":{"x":0.0,"y":0.0}}
+void BrainDaemon::cmdLook(const JsonTokens& msg) {
+    float x = msg.getFloat("x", 0.0f);
+    float y = msg.getFloat("y", 0.0f);
+    
+    if (m_eye_client.lookAt(x, y)) {
+        wsBroadcast("{\"status\":\"ok\",\"eye\":\"look\"}");
+    } else {
+        eyeCommandFailed();
+    }
+}
+
+// blink: {"type":"blink"}
+void BrainDaemon::cmdBlink(const JsonTokens&) {
+    if (m_eye_client.blink()) {
+        wsBroadcast("{\"status\":\"ok\",\"eye\":\"blink\"}");
+    } else {
+        eyeCommandFailed();
+    }
+}
+
+// wink: {"type":"wink","eye":"left|right"}
+void BrainDaemon::cmdWink(const JsonTokens& msg) {
+    const char* eye = msg.isString("eye", "right") ? "right" : "left";
+    
+    if (m_eye_client.wink(eye)) {
+        char resp[64];
+        snprintf(resp, sizeof(resp), "{\"status\":\"ok\",\"eye\":\"wink\",\"which\":\"%s\"}", eye);
+        wsBroadcast(resp);
+    } else {
+        eyeCommandFailed();
+    }
+}
+
+// mood: {"type":"mood","mood":"normal|angry|happy|sleepy"}
+void BrainDaemon::cmdMood(const JsonTokens& msg) {
+    const char* mood = "normal";
+    if (msg.isString("mood", "angry")) mood = "angry";
+    else if (msg.isString("mood", "happy")) mood = "happy";
+    else if (msg.isString("mood", "sleepy")) mood = "sleepy";
+    
+    if (m_eye_client.setMood(mood)) {
+        char resp[64];
+        snprintf(resp, sizeof(resp), "{\"status\":\"ok\",\"eye\":\"mood\",\"mood\":\"%s\"}", mood);
+        wsBroadcast(resp);
+    } else {
+        eyeCommandFailed();
+    }
+}
+
+// generic eye command: {"type":"eye","action":"..."}
+void BrainDaemon::cmdEye(const JsonTokens& msg) {
+    if (msg.isString("action", "idle_on")) {
+        if (m_eye_client.setIdleEnabled(true)) {
+            wsBroadcast("{\"status\":\"ok\",\"eye\":\"idle_on\"}");
+        } else {
+            eyeCommandFailed();
+        }
+    } else if (msg.isString("action", "idle_off")) {
+        if (m_eye_client.setIdleEnabled(false)) {
+            wsBroadcast("{\"status\":\"ok\",\"eye\":\"idle_off\"}");
+        } else {
+            eyeCommandFailed();
+        }
+    } else if (msg.isString("action", "status")) {
+        if (m_eye_client.requestStatus()) {
+            // The display figures are as of the Eye Service's last frame
+            EyeDisplayStatus st;
+            if (m_eye_client.displayStatus(&st)) {
+                char buf[256];
+                snprintf(buf, sizeof(buf),
+                         "{\"status\":\"ok\",\"eye\":\"status_requested\",\"display\":{\"spi_hz\":%u,"
+                         "\"frames\":%u,\"frame_us\":%u,\"frame_us_avg\":%u,\"frame_us_max\":%u,"
+                         "\"kib_sent\":%u}}",
+                         st.spi_hz, st.frames, st.frame_us, st.frame_us_avg, st.frame_us_max, st.kib_sent);
+                wsBroadcast(buf);
             } else {
-                eyeCommandFailed();
+                wsBroadcast("{\"status\":\"ok\",\"eye\":\"status_requested\"}");
             }
         } else {
-            wsBroadcast("{\"error\":\"unknown_eye_action\"}");
+            eyeCommandFailed();
         }
-        return;
+    } else if (msg.find("look")) {
+        cmdLook(msg);
+    } else {
+        wsBroadcast("{\"error\":\"unknown_eye_action\"}");
     }
-    
-    wsBroadcast("{\"error\":\"unknown_eye_command\"}");
 }
 
-void BrainDaemon::handleDistanceCommand(const std::string& cmd) {
-    (void)cmd;
-    
+void BrainDaemon::cmdDistance(const JsonTokens&) {
     if (!m_distance_available) {
         LOG_DEBUG("Distance", "Distance command received but sensor unavailable");
         wsBroadcast("{\"error\":\"distance_sensor_not_available\"}");
@@ -924,111 +2942,578 @@ void BrainDaemon::handleDistanceCommand(const std::string& cmd) {
         break;
     }
     
-    wsBroadcast(resp);
+    if (m_distance_sensor.sensorCount() < 2) {
+        wsBroadcast(resp);
+        return;
+    }
+    
+    // Several sensors: every one's newest sample, angle -1 on the scan servo
+    static const char* status_names[] = { "ok", "timeout", "out_of_range", "error", "not_initialized" };
+    char out[128 + VL53L0X_MAX_SENSORS * 96];
+    size_t len = strlen(resp) - 1;
+    memcpy(out, resp, len);
+    len += snprintf(out + len, sizeof(out) - len, ",\"sensors\":[");
+    for (size_t i = 0; i < m_distance_sensor.sensorCount(); i++) {
+        DistanceSensor::Sample s;
+        bool have = m_distance_sensor.latestSample(i, s);
+        len += snprintf(out + len, sizeof(out) - len,
+            "%s{\"sensor\":%zu,\"addr\":%u,\"angle\":%d,\"distance_mm\":%u,\"status\":\"%s\"}",
+            i ? "," : "", i, m_distance_sensor.mount(i).addr, m_distance_sensor.mount(i).angle_deg,
+            have ? s.distance_mm : 0, have ? status_names[(int)s.status] : "timeout");
+    }
+    snprintf(out + len, sizeof(out) - len, "]}");
+    wsBroadcast(out);
+}
+
+// distance_profile: {"type":"distance_profile","profile":"high_accuracy","scan":"high_speed"}
+// "profile" applies while no scan runs, "scan" during sweeps; both optional
+void BrainDaemon::cmdDistanceProfile(const JsonTokens& msg) {
+    ScanController::ScanProfile scan = m_scan_controller.getProfile();
+    DistanceSensor::Profile resting = m_scan_controller.getRestingRanging();
+
+    char name[32];
+    if (msg.getString("profile", name, sizeof(name)) &&
+        !DistanceSensor::parseProfile(name, resting)) {
+        wsBroadcast("{\"error\":\"invalid_distance_profile\"}");
+        return;
+    }
+    if (msg.getString("scan", name, sizeof(name)) &&
+        !DistanceSensor::parseProfile(name, scan.ranging)) {
+        wsBroadcast("{\"error\":\"invalid_distance_profile\"}");
+        return;
+    }
+
+    m_scan_controller.setRestingRanging(resting);
+    m_scan_controller.setProfile(scan);
+    if (m_distance_available) {
+        m_distance_sensor.setProfile(m_scan_controller.isRunning() ? scan.ranging : resting);
+    }
+
+    char resp[160];
+    snprintf(resp, sizeof(resp),
+        "{\"type\":\"distance_profile\",\"active\":\"%s\",\"profile\":\"%s\",\"scan\":\"%s\"}",
+        DistanceSensor::profileName(m_distance_sensor.getProfile()),
+        DistanceSensor::profileName(resting),
+        DistanceSensor::profileName(scan.ranging));
+    wsBroadcast(resp);
+}
+
+bool BrainDaemon::queuePose(uint32_t t_ms, uint16_t extra_flags, uint16_t mask,
+                            const uint16_t* servos, uint32_t* out_seq) {
+    // In a batch, masked poses with the same timing merge into one packet;
+    // a caller that reports the seq gets its own
+    if (m_batch_active) {
+        BatchState& b = m_batch;
+        if (b.pose_pending && (out_seq || !servos || b.pose_t_ms != t_ms)) {
+            batchFlushPose();
+        }
+        if (!out_seq && servos) {
+            if (!b.pose_pending) {
+                b.pose_pending = true;
+                b.pose_t_ms = t_ms;
+                b.pose_flags = 0;
+                b.pose_mask = 0;
+            }
+            for (int ch = 0; ch < SERVO_COUNT_TOTAL; ch++) {
+                if (mask & (1u << ch)) b.pose_us[ch] = servos[ch];
+            }
+            b.pose_mask |= mask;
+            b.pose_flags |= extra_flags;
+            return true;
+        }
+    }
+    
+    uint16_t flags = FLAG_CLAMP_ENABLE | extra_flags;
+    if (g_estop.load()) flags |= FLAG_ESTOP;
+    
+    uint32_t seq = 0;
+    if (!m_motion.submitPose(t_ms, flags, mask, servos, &seq, 0, m_cmd_rx_us)) {
+        wsBroadcast("{\"error\":\"motion_queue_full\"}");
+        return false;
+    }
+    if (m_cmd_rx_us) trace_point_at(SHARED_TRACE_CMD_DECODED, m_cmd_rx_us, seq);
+    if (out_seq) *out_seq = seq;
+    return true;
+}
+
+void BrainDaemon::tickEyeReconnect() {
+    if (m_eye_connected) return;
+    
+    if (m_eye_client.connect()) {
+        m_eye_connected = true;
+        syncEyeWatch();
+        LOG_INFO("Eye", "Reconnected to Eye Service");
+    } else {
+        LOG_INFO("Eye", "Reconnection attempt failed, will retry");
+    }
+}
+
+void BrainDaemon::tickWatchdogLog() {
+    uint32_t heartbeats = m_motion.getTxCount();
+    LOG_DEBUG("Watchdog", "Heartbeat tx_count=%u skipped=%u, estop=%s", 
+        heartbeats, m_motion.getHeartbeatsSkipped(), g_estop.load() ? "ACTIVE" : "clear");
+}
+
+void BrainDaemon::tickStatsLog() {
+    uint64_t now = timebase_millis64();
+    uint64_t uptime_s = (now - m_start_time_ms) / 1000;
+    uint32_t uptime_h = uptime_s / 3600;
+    uint32_t uptime_m = (uptime_s % 3600) / 60;
+    uint32_t uptime_sec = uptime_s % 60;
+    
+    LOG_INFO("Stats", "uptime=%02u:%02u:%02u packets_sent=%u clients=%zu eye=%s dist=%s serial=%s",
+        uptime_h, uptime_m, uptime_sec,
+        m_motion.getPacketsSent(), m_clients.size(),
+        m_eye_connected ? "connected" : "disconnected",
+        m_distance_available ? "available" : "unavailable",
+        m_serial_available ? "available" : "unavailable");
+    
+    // Percentiles over the last interval only, so a regression shows up right away
+    LatencyHistogram::Snapshot lat[LATENCY_METRIC_COUNT];
+    snapshotLatencies(lat);
+    char line[512];
+    int n = 0;
+    for (int i = 0; i < LATENCY_METRIC_COUNT; i++) {
+        LatencyHistogram::Snapshot d = lat[i].since(m_latency_logged[i]);
+        n += snprintf(line + n, sizeof(line) - n, " %s=%u/%u/%u(n=%llu)", s_latency_names[i],
+            d.percentile(0.5), d.percentile(0.99), d.percentile(0.999), (unsigned long long)d.count);
+        m_latency_logged[i] = lat[i];
+    }
+    LOG_INFO("Stats", "latency_us p50/p99/p999:%s", line);
+    
+    // CPU over the interval: loop callbacks by subsystem, then the costliest commands
+    n = 0;
+    for (int i = 0; i < LOOP_COST_COUNT; i++) {
+        n += snprintf(line + n, sizeof(line) - n, " %s=%.1f", s_loop_cost_names[i],
+            (m_loop_cost[i].total_us - m_loop_cost_logged[i].total_us) / 1000.0);
+        m_loop_cost_logged[i] = m_loop_cost[i];
+    }
+    LOG_INFO("Stats", "loop_ms%s", line);
+    
+    int order[COMMAND_MAX];
+    int ran = 0;
+    for (int i = 0; s_commands[i].name; i++) {
+        if (m_cmd_cost[i].calls != m_cmd_cost_logged[i].calls) order[ran++] = i;
+    }
+    auto spent = [this](int i) { return m_cmd_cost[i].total_us - m_cmd_cost_logged[i].total_us; };
+    int top = std::min(ran, CPU_LOG_TOP_COMMANDS);
+    std::partial_sort(order, order + top, order + ran, [&](int a, int b) { return spent(a) > spent(b); });
+    n = 0;
+    for (int k = 0; k < top; k++) {
+        int i = order[k];
+        n += snprintf(line + n, sizeof(line) - n, " %s=%.1fms/%llu(allocs=%llu)", s_commands[i].name,
+            spent(i) / 1000.0, (unsigned long long)(m_cmd_cost[i].calls - m_cmd_cost_logged[i].calls),
+            (unsigned long long)(m_cmd_cost[i].allocs - m_cmd_cost_logged[i].allocs));
+    }
+    if (top > 0) {
+        LOG_INFO("Stats", "cmd_cpu ms/calls:%s", line);
+    }
+    memcpy(m_cmd_cost_logged, m_cmd_cost, sizeof(m_cmd_cost));
+    
+    if (m_avoid_enabled) {
+        const ObstacleAvoider::Decision& avoid = m_avoider.decision();
+        LOG_INFO("Stats", "avoid action=%s front=%dmm heading=%ddeg changes=%u",
+            ObstacleAvoider::actionName(avoid.action), avoid.front_mm, avoid.heading_deg, m_avoid_changes);
+    }
+    
+    DeliveryStats d = m_motion.getDeliveryStats();
+    uint32_t nacked = 0;
+    for (int i = 1; i < SHARED_NACK_COUNT; i++) {
+        nacked += d.nacked[i];
+    }
+    LOG_INFO("Stats", "delivery written=%u (deltas %u) acked=%u skipped=%u nacked=%u ack_lost=%u backlog=%u(max %u) coalesced=%u dropped=%u overwritten=%u",
+        d.written, d.deltas, d.acked, d.skipped, nacked, d.ack_lost, d.backlog, d.backlog_max, d.coalesced, d.dropped,
+        d.overwritten);
+    
+    uint32_t serial_dropped = m_serial_control.getTxDropped();
+    if (serial_dropped != m_serial_tx_dropped_logged) {
+        LOG_WARN("Stats", "serial TX ring full: %u replies dropped (%zu bytes queued)",
+            serial_dropped - m_serial_tx_dropped_logged, m_serial_control.getTxQueued());
+        m_serial_tx_dropped_logged = serial_dropped;
+    }
+}
+
+void BrainDaemon::snapshotLatencies(LatencyHistogram::Snapshot* out) const {
+    m_motion.cmdLatency().snapshot(out[LATENCY_METRIC_CMD]);
+    m_consume_latency.snapshot(out[LATENCY_METRIC_CONSUME]);
+    m_distance_sensor.rangeLatency().snapshot(out[LATENCY_METRIC_RANGE]);
+    m_eye_client.sendLatency().snapshot(out[LATENCY_METRIC_EYE]);
+    m_motion.pingRtt().snapshot(out[LATENCY_METRIC_IPC_RTT]);
+    m_motion.pingUplink().snapshot(out[LATENCY_METRIC_IPC_UP]);
+    m_motion.pingEcho().snapshot(out[LATENCY_METRIC_IPC_ECHO]);
+    m_avoid_latency.snapshot(out[LATENCY_METRIC_AVOID]);
+    m_estop_latency.snapshot(out[LATENCY_METRIC_ESTOP]);
+}
+
+// Pairs the Muscle's trace records with the Brain's ring-write and E-STOP times; both are on the shared timebase
+void BrainDaemon::collectMuscleLatency() {
+    if (m_trace_scratch.empty()) {
+        m_trace_scratch.resize(SHARED_TRACE_RECORDS);
+    }
+    size_t n = m_motion.readMuscleTraceSince(m_trace_cursor, m_trace_scratch.data(), m_trace_scratch.size());
+    
+    for (size_t i = 0; i < n; i++) {
+        const SharedTraceRecord& r = m_trace_scratch[i];
+        if (r.probe == SHARED_TRACE_ESTOP_STOPPED && m_estop_rx_us != 0 && r.time_us >= m_estop_rx_us) {
+            uint64_t us = r.time_us - m_estop_rx_us;
+            m_estop_latency.record(us);
+            LOG_INFO("ESTOP", "Servos neutral %llu us after the estop was decoded (%u us on the Muscle)",
+                     (unsigned long long)us, r.arg2);
+            m_estop_rx_us = 0;
+            continue;
+        }
+        // A slot retried after a full output queue is dequeued twice; the first read counts
+        if (r.probe != SHARED_TRACE_MUSCLE_DEQUEUED || r.arg == m_consumed_seq) continue;
+        m_consumed_seq = r.arg;
+        
+        uint64_t written_us = m_motion.ringWriteTime(r.arg);
+        if (written_us != 0 && r.time_us >= written_us) {
+            m_consume_latency.record(r.time_us - written_us);
+        }
+    }
 }
 
-PosePacket31 BrainDaemon::buildPosePacket(uint32_t t_ms, uint16_t flags, const uint16_t* servos) {
-    PosePacket31 pkt;
-    pkt.magic = SPIDER_MAGIC;
-    pkt.ver_major = SPIDER_VERSION_MAJOR;
-    pkt.ver_minor = SPIDER_VERSION_MINOR;
-    pkt.seq = ++m_seq;
-    pkt.t_ms = t_ms;
-    pkt.flags = flags;
+void BrainDaemon::tickMuscleLog() {
+    collectMuscleLatency();
     
-    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) {
-        pkt.servo_us[i] = clamp_servo_us(servos[i]);
+    SharedLogRecord recs[MUSCLE_LOG_BATCH];
+    uint32_t lost = 0;
+    size_t n = m_motion.readMuscleLog(recs, MUSCLE_LOG_BATCH, lost);
+
+    if (lost > 0) {
+        LOG_WARN("Muscle", "%u event log records overwritten before they were read", lost);
     }
+
+    uint64_t now_us = timebase_shared_us();
+    for (size_t i = 0; i < n; i++) {
+        const SharedLogRecord& r = recs[i];
+        char msg[160];
+        snprintf(msg, sizeof(msg), shared_log_format(r.event),
+                 (unsigned long)r.args[0], (unsigned long)r.args[1],
+                 (unsigned long)r.args[2], (unsigned long)r.args[3]);
+
+        uint64_t age_ms = (now_us > r.time_us) ? (now_us - r.time_us) / 1000 : 0;
+        LogLevel level = static_cast<LogLevel>(shared_log_level(r.event));
+        if (r.count > 1) {
+            Logger::instance().log(level, "Muscle", "%s (x%u, %llu ms ago)", msg,
+                                   (unsigned)r.count, (unsigned long long)age_ms);
+        } else {
+            Logger::instance().log(level, "Muscle", "%s (%llu ms ago)", msg,
+                                   (unsigned long long)age_ms);
+        }
+    }
+}
+
+void BrainDaemon::tickTelemetry() {
+    char muscle[MUSCLE_JSON_SIZE];
+    if (formatMuscleTelemetry(muscle, sizeof(muscle), true) == 0) return;
     
-    pkt.crc16 = crc16_ccitt_false((const uint8_t*)&pkt, sizeof(pkt) - 2);
+    // Stale frames are worthless; drop them for clients that cannot keep up
+    char msg[MUSCLE_JSON_SIZE + 64];
+    int n = snprintf(msg, sizeof(msg), "{\"type\":\"telemetry\",\"muscle\":%s}", muscle);
+    wsBroadcast(msg, (size_t)n, true);
+}
+
+void BrainDaemon::checkEstopStateChange() {
+    // The Muscle latched by itself (its E-STOP input): follow it. Only the
+    // flag's rising edge counts, so a later resume is not undone
+    bool muscle = m_motion.muscleEstop();
+    if (muscle && !m_muscle_estop_seen && !g_estop.load()) {
+        LOG_WARN("ESTOP", "Muscle latched an E-STOP on its own");
+        g_estop.store(true);
+        m_sched_end_us = 0;
+    }
+    m_muscle_estop_seen = muscle;
+
+    bool current = g_estop.load();
+    bool prev = g_estop_prev.load();
     
-    return pkt;
+    if (current != prev) {
+        g_estop_prev.store(current);
+        m_estop_transitions++;
+        if (current) {
+            // Resuming must not pick the old walk back up
+            m_walk_requested = false;
+            LOG_WARN("ESTOP", "Emergency stop TRIGGERED");
+        } else {
+            LOG_INFO("ESTOP", "Emergency stop CLEARED");
+        }
+        streamEstop(current);
+    }
 }
 
-void BrainDaemon::sendPosePacket(const PosePacket31& pkt) {
-    if (g_estop.load() && !(pkt.flags & FLAG_ESTOP)) {
-        LOG_DEBUG("Brain", "E-STOP active, dropping packet seq=%u", pkt.seq);
+void BrainDaemon::wsReply(const char* msg, size_t len) {
+    if (m_batch_active) {
+        batchAppend(msg, len, m_cmd_client == nullptr);
         return;
     }
-    
-    uint32_t write_idx;
-    if (!m_shared_mem.writePacket(&pkt, write_idx)) {
-        LOG_ERROR("Brain", "Failed to write to shared memory");
+    // Only the requester has to see subscription acks
+    if (wsReplyTagged(msg, len)) {
         return;
     }
-    
-    if (!m_mailbox.notifyPacketReady(write_idx)) {
-        LOG_ERROR("Brain", "Failed to notify via mailbox");
+    if (m_cmd_client) {
+        wsSendFrame(*m_cmd_client, (const uint8_t*)msg, len);
+    } else {
+        wsBroadcast(msg, len);
+    }
+}
+
+void BrainDaemon::wsReply(JsonWriter& w) {
+    if (!w.ok()) {
+        wsReply("{\"error\":\"reply_too_large\"}");
+        return;
+    }
+    if (!m_cmd_client) {
+        wsBroadcast(w);
+        return;
+    }
+    if (m_batch_active) {
+        batchAppend(w.data(), w.size(), false);
+        return;
+    }
+    if (wsReplyTagged(w.data(), w.size())) {
         return;
     }
+    size_t len;
+    const uint8_t* frame = w.frame(len);
+    wsSendPrepared(*m_cmd_client, frame, len);
+}
+
+/**
+ * Send a reply to the command's sender with its "id" as the first member,
+ * if the command had one: the frame header and {"id":N, go out ahead of
+ * the reply's own bytes, after its opening brace.
+ * @return false if the reply is not for a tagged command
+ */
+bool BrainDaemon::wsReplyTagged(const char* msg, size_t len) {
+    if (m_cmd_id_len == 0 || !m_cmd_client || m_batch_active || len < 2 || msg[0] != '{') {
+        return false;
+    }
+    char prefix[WS_CMD_ID_MAX + 8];
+    bool empty = msg[1] == '}';
+    int prefix_len = snprintf(prefix, sizeof(prefix), "{\"id\":%.*s%s",
+                              (int)m_cmd_id_len, m_cmd_id, empty ? "" : ",");
+    if (wsSendDeflated(*m_cmd_client, 0x01, (const uint8_t*)prefix, (size_t)prefix_len,
+                       (const uint8_t*)msg + 1, len - 1, false)) {
+        return true;
+    }
     
-    m_packets_sent++;
+    uint8_t head[WS_FRAME_HEADER_MAX + sizeof(prefix)];
+    size_t head_len = ws_frame_header(head, 0x01, (size_t)prefix_len + len - 1);
+    memcpy(head + head_len, prefix, (size_t)prefix_len);
+    wsTransmit(*m_cmd_client, head, head_len + (size_t)prefix_len, (const uint8_t*)msg + 1, len - 1, false);
+    return true;
 }
 
-void BrainDaemon::tickHeartbeat() {
-    uint64_t now = get_time_ms();
-    if (now - m_last_heartbeat_ms >= HEARTBEAT_INTERVAL_MS) {
-        m_mailbox.sendHeartbeat();
-        m_last_heartbeat_ms = now;
+void BrainDaemon::syncStreamTimer() {
+    // ESTOP and AVOID are pushed on change and need no timer
+    const uint8_t polled = (1u << WS_STREAM_TOPIC_SCAN) | (1u << WS_STREAM_TOPIC_DISTANCE) |
+                           (1u << WS_STREAM_TOPIC_TELEMETRY);
+    bool any = false;
+    for (const auto& client : m_clients) {
+        if (client.sub_mask & polled) {
+            any = true;
+            break;
+        }
     }
+    m_loop.setTimerInterval(m_stream_timer, any ? WS_STREAM_TICK_MS : 0);
 }
 
-void BrainDaemon::tickEyeReconnect() {
-    if (m_eye_connected) return;
+void BrainDaemon::streamSend(WsClient& client, int topic, uint8_t msg, uint8_t count,
+                             const void* body, size_t body_len) {
+    uint8_t frame[sizeof(WsStreamHeader) + WS_STREAM_MAX_POINTS * sizeof(WsStreamScanPoint)];
+    if (sizeof(WsStreamHeader) + body_len > sizeof(frame)) return;
     
-    uint64_t now = get_time_ms();
-    if (now - m_last_eye_reconnect_ms >= EYE_RECONNECT_INTERVAL_MS) {
-        m_last_eye_reconnect_ms = now;
-        
-        if (m_eye_client.connect()) {
-            m_eye_connected = true;
-            LOG_INFO("Eye", "Reconnected to Eye Service");
-        } else {
-            LOG_INFO("Eye", "Reconnection attempt failed, will retry");
+    WsStreamHeader hdr;
+    hdr.msg = msg;
+    hdr.count = count;
+    hdr.seq = client.sub_seq[topic]++;
+    memcpy(frame, &hdr, sizeof(hdr));
+    memcpy(frame + sizeof(hdr), body, body_len);
+    wsSendFrame(client, frame, sizeof(hdr) + body_len, 0x02);
+}
+
+void BrainDaemon::streamScanPoint(const ScanController::ScanPoint& point) {
+    WsStreamScanPoint p;
+    p.angle_deg = (int16_t)point.angle_deg;
+    p.distance_mm = (int16_t)std::min(point.distance_mm, 0x7FFF);
+    p.timestamp_ms = (uint32_t)point.timestamp_ms;
+    
+    for (auto& client : m_clients) {
+        if (!(client.sub_mask & (1u << WS_STREAM_TOPIC_SCAN))) continue;
+        if (client.scan_pending_count == WS_STREAM_MAX_POINTS) {
+            // Behind by a full frame: lose the oldest point
+            memmove(client.scan_pending, client.scan_pending + 1,
+                    (WS_STREAM_MAX_POINTS - 1) * sizeof(WsStreamScanPoint));
+            client.scan_pending_count--;
         }
+        client.scan_pending[client.scan_pending_count++] = p;
     }
 }
 
-void BrainDaemon::tickWatchdogLog() {
-    uint64_t now = get_time_ms();
-    if (now - m_last_watchdog_log_ms >= WATCHDOG_LOG_INTERVAL_MS) {
-        m_last_watchdog_log_ms = now;
-        
-        uint32_t heartbeats = m_mailbox.getTxCount();
-        LOG_DEBUG("Watchdog", "Heartbeat tx_count=%u, estop=%s", 
-            heartbeats, g_estop.load() ? "ACTIVE" : "clear");
+void BrainDaemon::streamEstop(bool active) {
+    WsStreamEstop e = {};
+    e.active = active ? 1 : 0;
+    for (auto& client : m_clients) {
+        if (client.sub_mask & (1u << WS_STREAM_TOPIC_ESTOP)) {
+            streamSend(client, WS_STREAM_TOPIC_ESTOP, WS_STREAM_MSG_ESTOP, 1, &e, sizeof(e));
+        }
     }
 }
 
-void BrainDaemon::tickStatsLog() {
-    uint64_t now = get_time_ms();
-    if (now - m_last_stats_log_ms >= STATS_LOG_INTERVAL_MS) {
-        m_last_stats_log_ms = now;
+// Decision as a WS_STREAM_MSG_AVOID frame, to one client or every subscriber
+void BrainDaemon::streamAvoid(WsClient* only) {
+    const ObstacleAvoider::Decision& d = m_avoider.decision();
+    WsStreamAvoid a = {};
+    a.action = m_avoid_enabled ? (uint8_t)d.action : WS_STREAM_AVOID_OFF;
+    a.front_mm = (int16_t)std::min(d.front_mm, 0x7FFF);
+    a.heading_deg = (int16_t)d.heading_deg;
+    a.heading_mm = (int16_t)std::min(d.heading_mm, 0x7FFF);
+    for (auto& client : m_clients) {
+        if (only && &client != only) continue;
+        if (client.sub_mask & (1u << WS_STREAM_TOPIC_AVOID)) {
+            streamSend(client, WS_STREAM_TOPIC_AVOID, WS_STREAM_MSG_AVOID, 1, &a, sizeof(a));
+        }
+    }
+}
+
+// Every new sample is judged as soon as the ranging thread publishes it.
+// The sensor on the scan servo reads where the servo pointed, fixed ones
+// at their mount angle; those also feed the polar map the sweep builds.
+void BrainDaemon::tickAvoid() {
+    uint64_t sample_us = 0;     // Newest sample judged
+    for (size_t i = 0; i < m_distance_sensor.sensorCount(); i++) {
+        DistanceSensor::Sample s;
+        if (!m_distance_sensor.latestSample(i, s) || s.seq == m_avoid_sample_seq[i]) continue;
+        m_avoid_sample_seq[i] = s.seq;
         
-        uint64_t uptime_s = (now - m_start_time_ms) / 1000;
-        uint32_t uptime_h = uptime_s / 3600;
-        uint32_t uptime_m = (uptime_s % 3600) / 60;
-        uint32_t uptime_sec = uptime_s % 60;
+        // The servo may have moved on since: use where it pointed mid-measurement
+        uint64_t end_ms = s.timestamp_us / 1000;
+        uint32_t budget_ms = m_distance_sensor.getTimingBudgetMs();
+        int mount_deg = m_distance_sensor.mount(i).angle_deg;
+        bool on_servo = mount_deg == VL53L0X_MOUNT_SCAN;
+        int angle = on_servo ? m_scan_controller.getAngleAt(end_ms > budget_ms / 2 ? end_ms - budget_ms / 2 : 0)
+                             : mount_deg;
+        int distance_mm = -1;
+        if (s.status == DistanceSensor::Status::OK) {
+            distance_mm = s.distance_mm;
+        } else if (s.status == DistanceSensor::Status::OUT_OF_RANGE) {
+            distance_mm = VL53L0X_MAX_MM;
+        }
         
-        LOG_INFO("Stats", "uptime=%02u:%02u:%02u packets_sent=%u clients=%zu eye=%s dist=%s serial=%s",
-            uptime_h, uptime_m, uptime_sec,
-            m_packets_sent, m_clients.size(),
-            m_eye_connected ? "connected" : "disconnected",
-            m_distance_available ? "available" : "unavailable",
-            m_serial_available ? "available" : "unavailable");
+        if (!on_servo) {
+            m_scan_controller.recordFixed(angle, distance_mm, end_ms);
+            m_map.update(mapPose(), angle, distance_mm, VL53L0X_MAX_MM);
+        }
+        m_avoider.onSample(angle, distance_mm, end_ms);
+        sample_us = std::max(sample_us, s.timestamp_us);
+    }
+    if (sample_us == 0) return;
+    
+    uint64_t now = timebase_millis64();
+    ObstacleAvoider::Action prev = m_avoider.decision().action;
+    // Recent sweeps, plus what the map has accumulated where they say nothing
+    // or see less clearance
+    int sector_mm[SCAN_SECTOR_COUNT];
+    int map_mm[SCAN_SECTOR_COUNT];
+    m_avoider.freshSectors(m_scan_controller, now, sector_mm);
+    m_map.sectorClearance(mapPose(), VL53L0X_MAX_MM, map_mm);
+    for (int i = 0; i < SCAN_SECTOR_COUNT; i++) {
+        if (map_mm[i] >= 0 && (sector_mm[i] < 0 || map_mm[i] < sector_mm[i])) sector_mm[i] = map_mm[i];
     }
+    const ObstacleAvoider::Decision& d = m_avoider.evaluate(sector_mm, now);
+    if (d.action == prev) return;
+    
+    m_avoid_changes++;
+    LOG_DEBUG("Avoid", "%s -> %s (front %d mm, heading %d deg)", ObstacleAvoider::actionName(prev),
+              ObstacleAvoider::actionName(d.action), d.front_mm, d.heading_deg);
+    
+    // Playback or a planned move may have taken over since; a walk steered
+    // to a standstill is still ours to restart
+    bool ours = m_walk_requested && (m_motion.isWalking() || m_avoid_halted);
+    GaitEngine::Params steered = m_avoider.steer(m_walk_request);
+    if (ours && !g_estop.load() && m_motion.setWalk(steered)) {
+        m_walk_steered = steered;
+        m_avoid_halted = steered.dir == 0.0f && steered.turn == 0.0f;
+        uint64_t now_us = timebase_micros();
+        m_avoid_latency.record(now_us > sample_us ? now_us - sample_us : 0);
+    }
+    streamAvoid();
 }
 
-void BrainDaemon::checkEstopStateChange() {
-    bool current = g_estop.load();
-    bool prev = g_estop_prev.load();
+// The sweep follows the walk the gait is actually running
+void BrainDaemon::tickScan() {
+    ScanController::MotionHint hint;
+    if (m_motion.isWalking()) {
+        hint.dir = m_walk_steered.dir;
+        hint.turn = m_walk_steered.turn;
+        hint.speed = m_walk_steered.speed;
+    }
+    m_scan_controller.setMotionHint(hint);
+    m_scan_controller.tick();
+}
+
+void BrainDaemon::tickStreams() {
+    uint64_t now = timebase_millis64();
     
-    if (current != prev) {
-        g_estop_prev.store(current);
-        if (current) {
-            LOG_WARN("ESTOP", "Emergency stop TRIGGERED");
-        } else {
-            LOG_INFO("ESTOP", "Emergency stop CLEARED");
+    // Sources are read at most once per tick, however many clients are due
+    bool have_sample = false, sample_read = false;
+    DistanceSensor::Sample sample;
+    bool have_telemetry = false, telemetry_read = false;
+    SharedTelemetryData telemetry;
+    
+    for (auto& client : m_clients) {
+        if (!client.handshake_done || client.closing) continue;
+        // Skipping (rather than dropping queued frames) keeps deltas valid
+        if (client.tx_bytes > m_ws_high_water) continue;
+        
+        auto due = [&](int topic) {
+            return (client.sub_mask & (1u << topic)) &&
+                   now - client.sub_last_ms[topic] >= client.sub_interval_ms[topic];
+        };
+        
+        if (due(WS_STREAM_TOPIC_SCAN) && client.scan_pending_count > 0) {
+            streamSend(client, WS_STREAM_TOPIC_SCAN, WS_STREAM_MSG_SCAN,
+                       (uint8_t)client.scan_pending_count, client.scan_pending,
+                       client.scan_pending_count * sizeof(WsStreamScanPoint));
+            client.scan_pending_count = 0;
+            client.sub_last_ms[WS_STREAM_TOPIC_SCAN] = now;
+        }
+        
+        if (due(WS_STREAM_TOPIC_DISTANCE)) {
+            if (!sample_read) {
+                sample_read = true;
+                have_sample = m_distance_available && m_distance_sensor.latestSample(sample);
+            }
+            if (have_sample && sample.seq != client.distance_seq) {
+                WsStreamDistance d;
+                d.distance_mm = sample.distance_mm;
+                d.status = (uint8_t)sample.status;
+                d.profile = (uint8_t)m_distance_sensor.getProfile();
+                d.sample_seq = sample.seq;
+                streamSend(client, WS_STREAM_TOPIC_DISTANCE, WS_STREAM_MSG_DISTANCE, 1, &d, sizeof(d));
+                client.distance_seq = sample.seq;
+                client.sub_last_ms[WS_STREAM_TOPIC_DISTANCE] = now;
+            }
+        }
+        
+        if (due(WS_STREAM_TOPIC_TELEMETRY)) {
+            if (!telemetry_read) {
+                telemetry_read = true;
+                have_telemetry = m_motion.readMuscleTelemetry(telemetry);
+            }
+            if (have_telemetry) {
+                bool key = client.telemetry_frames % WS_STREAM_KEYFRAME_INTERVAL == 0;
+                uint8_t body[WS_STREAM_TELEMETRY_MAX];
+                size_t len = ws_stream_telemetry_encode(body, &telemetry, key ? nullptr : &client.telemetry_last);
+                if (len > WS_STREAM_TELEMETRY_MASK_LEN) {
+                    streamSend(client, WS_STREAM_TOPIC_TELEMETRY, WS_STREAM_MSG_TELEMETRY,
+                               key ? 1 : 0, body, len);
+                    client.telemetry_last = telemetry;
+                    client.telemetry_frames++;
+                }
+                client.sub_last_ms[WS_STREAM_TOPIC_TELEMETRY] = now;
+            }
         }
     }
 }
@@ -1037,67 +3522,71 @@ void BrainDaemon::shutdown() {
     LOG_INFO("Brain", "Shutting down...");
     
     for (auto& client : m_clients) {
-        wsSendFrame(client.fd, nullptr, 0, 0x08);
+        wsSendFrame(client, nullptr, 0, 0x08);
         close(client.fd);
     }
     m_clients.clear();
+    m_loop.close();
     
     if (m_server_fd >= 0) {
         close(m_server_fd);
         m_server_fd = -1;
     }
+    if (m_signal_fd >= 0) {
+        close(m_signal_fd);
+        m_signal_fd = -1;
+    }
     
     m_serial_control.shutdown();
     m_eye_client.disconnect();
-    m_shared_mem.unmap();
-    m_mailbox.close();
+    m_distance_sensor.stop();
+    m_motion.stop();
+    
+    if (m_capture.isOpen()) {
+        drainCapture();
+        LOG_INFO("Brain", "Capture: %u records, %u dropped, %llu KB held",
+                 m_capture.records(), m_capture.dropped(),
+                 (unsigned long long)(m_capture.bytesHeld() / 1024));
+        m_capture.close();
+    }
     
     LOG_INFO("Brain", "Shutdown complete");
 }
 
 void BrainDaemon::onSerialServo(int channel, uint16_t us) {
-    m_current_servos[channel] = clamp_servo_us(us);
-    
-    uint16_t flags = FLAG_CLAMP_ENABLE;
-    if (g_estop.load()) flags |= FLAG_ESTOP;
-    PosePacket31 pkt = buildPosePacket(0, flags, m_current_servos);
-    sendPosePacket(pkt);
+    uint16_t values[SERVO_COUNT_TOTAL] = {};
+    values[channel] = us;
+    queuePose(0, 0, (uint16_t)(1u << channel), values);
 }
 
 void BrainDaemon::onSerialServos(const uint16_t* us, int count) {
+    uint16_t values[SERVO_COUNT_TOTAL] = {};
+    uint16_t mask = 0;
     for (int i = 0; i < count && i < SERVO_COUNT_TOTAL; i++) {
-        m_current_servos[i] = clamp_servo_us(us[i]);
+        values[i] = us[i];
+        mask |= (uint16_t)(1u << i);
     }
-    
-    uint16_t flags = FLAG_CLAMP_ENABLE;
-    if (g_estop.load()) flags |= FLAG_ESTOP;
-    PosePacket31 pkt = buildPosePacket(0, flags, m_current_servos);
-    sendPosePacket(pkt);
+    queuePose(0, 0, mask, values);
 }
 
 void BrainDaemon::onSerialMove(uint32_t t_ms, const uint16_t* us, int count) {
+    uint16_t values[SERVO_COUNT_TOTAL] = {};
+    uint16_t mask = 0;
     for (int i = 0; i < count && i < SERVO_COUNT_TOTAL; i++) {
-        m_current_servos[i] = clamp_servo_us(us[i]);
+        values[i] = us[i];
+        mask |= (uint16_t)(1u << i);
     }
-    
-    uint16_t flags = FLAG_CLAMP_ENABLE;
-    if (g_estop.load()) flags |= FLAG_ESTOP;
-    PosePacket31 pkt = buildPosePacket(t_ms, flags, m_current_servos);
-    sendPosePacket(pkt);
+    queuePose(t_ms, 0, mask, values);
 }
 
 void BrainDaemon::onSerialScan(uint16_t us) {
-    m_current_servos[SERVO_CHANNEL_SCAN] = clamp_servo_us(us);
-    
-    uint16_t flags = FLAG_CLAMP_ENABLE | FLAG_SCAN_ENABLE;
-    if (g_estop.load()) flags |= FLAG_ESTOP;
-    PosePacket31 pkt = buildPosePacket(0, flags, m_current_servos);
-    sendPosePacket(pkt);
+    uint16_t values[SERVO_COUNT_TOTAL] = {};
+    values[SERVO_CHANNEL_SCAN] = us;
+    queuePose(0, FLAG_SCAN_ENABLE, (uint16_t)(1u << SERVO_CHANNEL_SCAN), values);
 }
 
 void BrainDaemon::onSerialEstop() {
-    g_estop.store(true);
-    m_mailbox.sendEstop();
+    triggerEstop(timebase_micros());
 }
 
 void BrainDaemon::onSerialResume() {
@@ -1108,8 +3597,8 @@ std::string BrainDaemon::onSerialStatus() {
     char status[128];
     snprintf(status, sizeof(status),
         "seq=%u tx=%u ring_w=%u ring_r=%u clients=%zu estop=%s",
-        m_seq, m_mailbox.getTxCount(),
-        m_shared_mem.getWriteIdx(), m_shared_mem.getReadIdx(),
+        m_motion.getSeq(), m_motion.getTxCount(),
+        m_motion.getWriteIdx(), m_motion.getReadIdx(),
         m_clients.size(), g_estop.load() ? "active" : "clear");
     return std::string(status);
 }
@@ -1131,11 +3620,13 @@ int BrainDaemon::onSerialDistance() {
 void BrainDaemon::initScanController() {
     // Configure scan profile
     ScanController::ScanProfile profile;
-    profile.min_deg = 20;
-    profile.max_deg = 160;
-    profile.step_deg = 10;
-    profile.rate_hz = 5;
-    profile.dwell_ms = 80;
+    profile.min_deg = m_tunables.get(Tunables::SCAN_MIN_DEG);
+    profile.max_deg = m_tunables.get(Tunables::SCAN_MAX_DEG);
+    profile.step_deg = m_tunables.get(Tunables::SCAN_STEP_DEG);
+    profile.rate_hz = 0;            // Pipelined: step as soon as a sample is in
+    profile.dwell_ms = m_tunables.get(Tunables::SCAN_DWELL_MS);
+    profile.servo_deg_per_s = m_tunables.get(Tunables::SCAN_SERVO_DEG_PER_S);
+    profile.adaptive = true;        // Follow the walk, park when still
     m_scan_controller.setProfile(profile);
     
     // Set callback to move scan servo
@@ -1143,25 +3634,52 @@ void BrainDaemon::initScanController() {
         setScanServoAngle(angle_deg);
     });
     
-    // Set callback to read distance
-    m_scan_controller.setDistanceCallback([this]() -> int {
-        if (!m_distance_available) return -1;
-        uint16_t distance_mm = 0;
-        DistanceSensor::Status status = m_distance_sensor.readRange(distance_mm);
-        if (status == DistanceSensor::Status::OK) {
-            return (int)distance_mm;
+    // Newest sample of the sensor on the servo, with its measurement window
+    m_scan_controller.setSampleCallback([this](ScanController::RangeSample& out) -> bool {
+        if (!m_distance_available) {
+            return false;
+        }
+        size_t sensor = 0;
+        while (sensor < m_distance_sensor.sensorCount() &&
+               m_distance_sensor.mount(sensor).angle_deg != VL53L0X_MOUNT_SCAN) {
+            sensor++;
+        }
+        DistanceSensor::Sample sample;
+        if (!m_distance_sensor.latestSample(sensor, sample)) {
+            return false;
+        }
+        uint32_t budget_ms = m_distance_sensor.getTimingBudgetMs();
+        out.seq = sample.seq;
+        out.distance_mm = (sample.status == DistanceSensor::Status::OK) ? (int)sample.distance_mm : -1;
+        out.end_ms = sample.timestamp_us / 1000;
+        out.start_ms = (out.end_ms > budget_ms) ? out.end_ms - budget_ms : 0;
+        return true;
+    });
+    
+    // Fast, noisier ranging while sweeping; resting profile afterwards
+    m_scan_controller.setRangingCallback([this](DistanceSensor::Profile ranging) {
+        if (m_distance_available) {
+            m_distance_sensor.setProfile(ranging);
         }
-        return -1;
     });
     
     // Set callback for new scan data (optional: broadcast to clients)
     m_scan_controller.setDataCallback([this](const ScanController::ScanPoint& point) {
-        // Optionally broadcast scan data to WebSocket clients
+        streamScanPoint(point);
+        m_map.update(mapPose(), point.angle_deg, point.distance_mm, VL53L0X_MAX_MM);
+        
+        // JSON for clients without a scan_point subscription; dropped for
+        // clients that cannot keep up
         char msg[128];
-        snprintf(msg, sizeof(msg),
+        int n = snprintf(msg, sizeof(msg),
             "{\"type\":\"scan_data\",\"angle\":%d,\"distance\":%d}",
             point.angle_deg, point.distance_mm);
-        wsBroadcast(msg);
+        for (auto& client : m_clients) {
+            if (client.handshake_done && !client.closing &&
+                !(client.sub_mask & (1u << WS_STREAM_TOPIC_SCAN))) {
+                wsSendFrame(client, (const uint8_t*)msg, (size_t)n, 0x01, true);
+            }
+        }
     });
     
     LOG_INFO("Scan", "Controller initialized (not started)");
@@ -1173,75 +3691,382 @@ void BrainDaemon::setScanServoAngle(int angle_deg) {
     if (us < SERVO_PWM_MIN_US) us = SERVO_PWM_MIN_US;
     if (us > SERVO_PWM_MAX_US) us = SERVO_PWM_MAX_US;
     
-    m_current_servos[SERVO_CHANNEL_SCAN] = (uint16_t)us;
+    uint16_t values[SERVO_COUNT_TOTAL] = {};
+    values[SERVO_CHANNEL_SCAN] = (uint16_t)us;
+    queuePose(0, FLAG_SCAN_ENABLE, (uint16_t)(1u << SERVO_CHANNEL_SCAN), values);
+}
+
+void BrainDaemon::startScan() {
+    m_scan_controller.start();
+    m_loop.setTimerInterval(m_scan_timer, SCAN_TICK_INTERVAL_MS);
+}
+
+void BrainDaemon::stopScan() {
+    m_loop.setTimerInterval(m_scan_timer, 0);
+    m_scan_controller.stop();
+}
+
+// scan_start: {"type":"scan_start"} or {"type":"scan_start","profile":{...}}
+void BrainDaemon::cmdScanStart(const JsonTokens& msg) {
+    // Optionally update profile from command
+    int min_deg = msg.getInt("min_deg", -1);
+    int max_deg = msg.getInt("max_deg", -1);
+    int step_deg = msg.getInt("step_deg", -1);
+    int rate_hz = msg.getInt("rate_hz", -1);
+    ScanController::ScanProfile profile = m_scan_controller.getProfile();
+    bool adaptive = msg.getBool("adaptive", profile.adaptive);
     
-    uint16_t flags = FLAG_CLAMP_ENABLE | FLAG_SCAN_ENABLE;
-    if (g_estop.load()) flags |= FLAG_ESTOP;
-    PosePacket31 pkt = buildPosePacket(0, flags, m_current_servos);
-    sendPosePacket(pkt);
-}
-
-void BrainDaemon::handleScanCommand(const std::string& cmd) {
-    // scan_start: {"type":"scan_start"} or {"type":"scan_start","profile":{...}}
-    if (hasType(cmd, "scan_start")) {
-        // Optionally update profile from command
-        int min_deg = parseJsonInt(cmd, "min_deg", -1);
-        int max_deg = parseJsonInt(cmd, "max_deg", -1);
-        int step_deg = parseJsonInt(cmd, "step_deg", -1);
-        int rate_hz = parseJsonInt(cmd, "rate_hz", -1);
-        
-        if (min_deg >= 0 || max_deg >= 0 || step_deg >= 0 || rate_hz >= 0) {
-            ScanController::ScanProfile profile = m_scan_controller.getProfile();
-            if (min_deg >= 0) profile.min_deg = min_deg;
-            if (max_deg >= 0) profile.max_deg = max_deg;
-            if (step_deg >= 0) profile.step_deg = step_deg;
-            if (rate_hz >= 0) profile.rate_hz = rate_hz;
-            m_scan_controller.setProfile(profile);
+    if (min_deg >= 0 || max_deg >= 0 || step_deg >= 0 || rate_hz >= 0 || adaptive != profile.adaptive) {
+        if (min_deg >= 0) profile.min_deg = min_deg;
+        if (max_deg >= 0) profile.max_deg = max_deg;
+        if (step_deg >= 0) profile.step_deg = step_deg;
+        if (rate_hz >= 0) profile.rate_hz = rate_hz;
+        profile.adaptive = adaptive;
+        m_scan_controller.setProfile(profile);
+    }
+    
+    startScan();
+    wsBroadcast("{\"status\":\"ok\",\"scan\":\"started\"}");
+}
+
+// scan_stop: {"type":"scan_stop"}
+void BrainDaemon::cmdScanStop(const JsonTokens&) {
+    stopScan();
+    wsBroadcast("{\"status\":\"ok\",\"scan\":\"stopped\"}");
+}
+
+// scan_status: {"type":"scan_status"}
+void BrainDaemon::cmdScanStatus(const JsonTokens&) {
+    char msg[256];
+    snprintf(msg, sizeof(msg),
+        "{\"scan_running\":%s,\"angle\":%d,\"closest_dist\":%d,\"closest_angle\":%d,\"points\":%zu,\"sweep_ms\":%u,"
+        "\"holding\":%s,\"window\":[%d,%d],\"travel_deg\":%u}",
+        m_scan_controller.isRunning() ? "true" : "false",
+        m_scan_controller.getCurrentAngle(),
+        m_scan_controller.getClosestDistance(),
+        m_scan_controller.getClosestAngle(),
+        m_scan_controller.getPointCount(),
+        m_scan_controller.getLastSweepMs(),
+        m_scan_controller.isHolding() ? "true" : "false",
+        m_scan_controller.getWindowMin(),
+        m_scan_controller.getWindowMax(),
+        m_scan_controller.getTravelDeg());
+    wsBroadcast(msg);
+}
+
+// scan_get_data: {"type":"scan_get_data"} - get full scan data
+void BrainDaemon::cmdScanGetData(const JsonTokens&) {
+    JsonWriter w(m_arena);
+    w.beginObject().beginArray("scan_data");
+    for (size_t i = 0; i < m_scan_controller.getSlotCount(); i++) {
+        const ScanController::ScanPoint& p = m_scan_controller.getSlot(i);
+        if (p.timestamp_ms == 0) continue;
+        w.beginObject().field("a", p.angle_deg).field("d", p.distance_mm).endObject();
+    }
+    w.endArray().endObject();
+    wsBroadcast(w);
+}
+
+// map_get: {"type":"map_get"} - occupancy grid as one WS_STREAM_MSG_MAP
+// binary frame, to the requester only
+void BrainDaemon::cmdMapGet(const JsonTokens&) {
+    WsStreamHeader hdr = {};
+    hdr.msg = WS_STREAM_MSG_MAP;
+    size_t len = sizeof(hdr) + m_map.snapshot(mapPose(), m_map_frame + sizeof(hdr), hdr.count);
+    memcpy(m_map_frame, &hdr, sizeof(hdr));
+    
+    if (m_cmd_client) {
+        wsSendFrame(*m_cmd_client, m_map_frame, len, 0x02);
+        return;
+    }
+    for (auto& client : m_clients) {
+        if (client.handshake_done && !client.closing) {
+            wsSendFrame(client, m_map_frame, len, 0x02);
         }
-        
-        m_scan_controller.start();
-        wsBroadcast("{\"status\":\"ok\",\"scan\":\"started\"}");
+    }
+}
+
+// map_clear: {"type":"map_clear"} - forget the accumulated map
+void BrainDaemon::cmdMapClear(const JsonTokens&) {
+    m_map.clear();
+    wsReply("{\"status\":\"ok\",\"map\":\"cleared\"}");
+}
+
+static const char* const s_stream_topics[WS_STREAM_TOPIC_COUNT] = {
+    "scan_point",
+    "distance",
+    "muscle_telemetry",
+    "estop",
+    "avoid",
+};
+
+// "scan_point,distance" -> topic bits; "all" is every topic. Returns -1
+// on an unknown name.
+static int parseStreamTopics(const char* list) {
+    int mask = 0;
+    const char* p = list;
+    while (*p) {
+        const char* end = strchr(p, ',');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+        int bit = -1;
+        if (len == 3 && strncmp(p, "all", 3) == 0) {
+            mask |= (1 << WS_STREAM_TOPIC_COUNT) - 1;
+            bit = 0;
+        }
+        for (int i = 0; bit < 0 && i < WS_STREAM_TOPIC_COUNT; i++) {
+            if (strlen(s_stream_topics[i]) == len && strncmp(p, s_stream_topics[i], len) == 0) {
+                bit = i;
+                mask |= 1 << i;
+            }
+        }
+        if (bit < 0) return -1;
+        p += len;
+        if (*p == ',') p++;
+    }
+    return mask;
+}
+
+static void formatStreamTopics(char* out, size_t len, uint8_t mask) {
+    int n = snprintf(out, len, "[");
+    for (int i = 0; i < WS_STREAM_TOPIC_COUNT; i++) {
+        if (mask & (1u << i)) {
+            n += snprintf(out + n, len - n, "%s\"%s\"", n > 1 ? "," : "", s_stream_topics[i]);
+        }
+    }
+    snprintf(out + n, len - n, "]");
+}
+
+// subscribe: {"cmd":"subscribe","topic":"scan_point,distance","rate_ms":100}
+// Binary frames per common/ws_stream_binary.h, to this client only
+void BrainDaemon::cmdSubscribe(const JsonTokens& msg) {
+    if (!m_cmd_client) return;
+    WsClient& client = *m_cmd_client;
+    
+    char list[96];
+    int mask = msg.getString("topic", list, sizeof(list)) ? parseStreamTopics(list) : -1;
+    if (mask <= 0) {
+        wsReply("{\"error\":\"invalid_topic\"}");
         return;
     }
     
-    // scan_stop: {"type":"scan_stop"}
-    if (hasType(cmd, "scan_stop")) {
-        m_scan_controller.stop();
-        wsBroadcast("{\"status\":\"ok\",\"scan\":\"stopped\"}");
+    int rate_ms = std::max(0, msg.getInt("rate_ms", 0));
+    for (int i = 0; i < WS_STREAM_TOPIC_COUNT; i++) {
+        if (!(mask & (1 << i))) continue;
+        uint32_t interval = (uint32_t)rate_ms;
+        if (i == WS_STREAM_TOPIC_TELEMETRY && interval < TELEMETRY_MIN_INTERVAL_MS) {
+            interval = TELEMETRY_MIN_INTERVAL_MS;
+        }
+        client.sub_interval_ms[i] = interval;
+        client.sub_last_ms[i] = 0;
+        if (!(client.sub_mask & (1u << i))) {
+            client.sub_seq[i] = 0;
+        }
+    }
+    
+    uint8_t added = (uint8_t)(mask & ~client.sub_mask);
+    client.sub_mask |= (uint8_t)mask;
+    if (added & (1u << WS_STREAM_TOPIC_SCAN)) client.scan_pending_count = 0;
+    if (added & (1u << WS_STREAM_TOPIC_DISTANCE)) client.distance_seq = 0;
+    if (added & (1u << WS_STREAM_TOPIC_TELEMETRY)) client.telemetry_frames = 0;
+    syncStreamTimer();
+    
+    char topics[96];
+    char resp[160];
+    formatStreamTopics(topics, sizeof(topics), client.sub_mask);
+    snprintf(resp, sizeof(resp), "{\"type\":\"subscribed\",\"topics\":%s,\"rate_ms\":%d}", topics, rate_ms);
+    wsReply(resp);
+    
+    // Current state right away, so the client does not wait for a change
+    if (added & (1u << WS_STREAM_TOPIC_ESTOP)) {
+        WsStreamEstop e = {};
+        e.active = g_estop.load() ? 1 : 0;
+        streamSend(client, WS_STREAM_TOPIC_ESTOP, WS_STREAM_MSG_ESTOP, 1, &e, sizeof(e));
+    }
+    if (added & (1u << WS_STREAM_TOPIC_AVOID)) {
+        streamAvoid(&client);
+    }
+}
+
+// unsubscribe: {"cmd":"unsubscribe","topic":"distance"} ("all" or no topic = everything)
+void BrainDaemon::cmdUnsubscribe(const JsonTokens& msg) {
+    if (!m_cmd_client) return;
+    WsClient& client = *m_cmd_client;
+    
+    char list[96];
+    int mask = msg.getString("topic", list, sizeof(list)) ? parseStreamTopics(list)
+                                                          : (1 << WS_STREAM_TOPIC_COUNT) - 1;
+    if (mask < 0) {
+        wsReply("{\"error\":\"invalid_topic\"}");
         return;
     }
     
-    // scan_status: {"type":"scan_status"}
-    if (hasType(cmd, "scan_status")) {
-        const auto& data = m_scan_controller.getScanData();
-        char msg[256];
-        snprintf(msg, sizeof(msg),
-            "{\"scan_running\":%s,\"angle\":%d,\"closest_dist\":%d,\"closest_angle\":%d,\"points\":%zu}",
-            m_scan_controller.isRunning() ? "true" : "false",
-            m_scan_controller.getCurrentAngle(),
-            m_scan_controller.getClosestDistance(),
-            m_scan_controller.getClosestAngle(),
-            data.size());
-        wsBroadcast(msg);
+    client.sub_mask &= (uint8_t)~mask;
+    syncStreamTimer();
+    
+    char topics[96];
+    char resp[160];
+    formatStreamTopics(topics, sizeof(topics), client.sub_mask);
+    snprintf(resp, sizeof(resp), "{\"type\":\"subscribed\",\"topics\":%s}", topics);
+    wsReply(resp);
+}
+
+/**
+ * trace_dump: {"cmd":"trace_dump","path":"/tmp/trace.json","window_ms":10000,"max":500}
+ *
+ * Merges the Brain's and the Muscle's trace records from the last
+ * window_ms (0 = everything still buffered) into Chrome trace JSON for
+ * chrome://tracing or ui.perfetto.dev. With "path" the full trace is
+ * written to that file; otherwise the newest "max" records are sent
+ * inline under "trace".
+ */
+void BrainDaemon::cmdTraceDump(const JsonTokens& msg) {
+    std::vector<SharedTraceRecord> recs(TRACE_BRAIN_RECORDS + SHARED_TRACE_RECORDS);
+    size_t brain = trace_snapshot(recs.data(), TRACE_BRAIN_RECORDS);
+    size_t muscle = m_motion.readMuscleTrace(recs.data() + brain, SHARED_TRACE_RECORDS);
+    recs.resize(brain + muscle);
+    
+    // Muscle records can predate this Brain run, whose seqs restart at 1
+    int window_ms = msg.getInt("window_ms", TRACE_DUMP_WINDOW_MS);
+    if (window_ms > 0) {
+        uint64_t now_us = timebase_micros();
+        uint64_t window_us = (uint64_t)window_ms * 1000;
+        uint64_t cutoff = (now_us > window_us) ? now_us - window_us : 0;
+        recs.erase(std::remove_if(recs.begin(), recs.end(),
+            [cutoff](const SharedTraceRecord& r) { return r.time_us < cutoff; }), recs.end());
+    }
+    
+    char path[256];
+    if (msg.getString("path", path, sizeof(path))) {
+        std::string json = trace_export_json(recs.data(), recs.size());
+        FILE* f = fopen(path, "w");
+        bool ok = f && fwrite(json.data(), 1, json.size(), f) == json.size();
+        if (f && fclose(f) != 0) ok = false;
+        if (!ok) {
+            LOG_WARN("Brain", "trace_dump: cannot write %s", path);
+            wsReply("{\"error\":\"trace_write_failed\"}");
+            return;
+        }
+        
+        char resp[128];
+        snprintf(resp, sizeof(resp), "{\"type\":\"trace_dump\",\"events\":%zu,\"bytes\":%zu}",
+                 recs.size(), json.size());
+        wsReply(resp);
         return;
     }
     
-    // scan_data: {"type":"scan_data"} - get full scan data
-    if (hasType(cmd, "scan_get_data")) {
-        const auto& data = m_scan_controller.getScanData();
-        std::string msg = "{\"scan_data\":[";
-        for (size_t i = 0; i < data.size(); i++) {
-            if (i > 0) msg += ",";
-            char pt[48];
-            snprintf(pt, sizeof(pt), "{\"a\":%d,\"d\":%d}",
-                data[i].angle_deg, data[i].distance_mm);
-            msg += pt;
+    int max = msg.getInt("max", TRACE_DUMP_INLINE_MAX);
+    if (max < 1) max = 1;
+    if (max > TRACE_DUMP_INLINE_MAX) max = TRACE_DUMP_INLINE_MAX;
+    if (recs.size() > (size_t)max) {
+        std::sort(recs.begin(), recs.end(),
+            [](const SharedTraceRecord& a, const SharedTraceRecord& b) { return a.time_us < b.time_us; });
+        recs.erase(recs.begin(), recs.end() - max);
+    }
+    
+    std::string resp = "{\"type\":\"trace_dump\",\"events\":" + std::to_string(recs.size()) +
+                       ",\"trace\":" + trace_export_json(recs.data(), recs.size()) + "}";
+    wsReply(resp.c_str());
+}
+
+static void write_cpu_cost(JsonWriter& w, const char* key, const CpuCost& c) {
+    w.beginObject(key)
+     .field("calls", c.calls)
+     .field("total_us", c.total_us)
+     .field("max_us", c.max_us)
+     .field("allocs", c.allocs)
+     .endObject();
+}
+
+// cpu_stats: {"cmd":"cpu_stats"}
+// Event loop time by subsystem and time per command since start; commands
+// that never ran are left out. A command's time is also in its subsystem's
+void BrainDaemon::cmdCpuStats(const JsonTokens& msg) {
+    (void)msg;
+    JsonWriter w(m_arena);
+    w.beginObject()
+     .field("type", "cpu_stats")
+     .field("uptime_ms", timebase_millis64() - m_start_time_ms)
+     .beginObject("loop");
+    for (int i = 0; i < LOOP_COST_COUNT; i++) {
+        write_cpu_cost(w, s_loop_cost_names[i], m_loop_cost[i]);
+    }
+    w.endObject().beginObject("commands");
+    for (int i = 0; s_commands[i].name; i++) {
+        if (m_cmd_cost[i].calls > 0) {
+            write_cpu_cost(w, s_commands[i].name, m_cmd_cost[i]);
         }
-        msg += "]}";
-        wsBroadcast(msg);
+    }
+    w.endObject().endObject();
+    wsReply(w);
+}
+
+// profile: {"cmd":"profile","seconds":10,"hz":99,"path":"/tmp/spider_profile.folded"}
+// Answers at once, samples every thread's stack for the given time, then
+// writes folded stacks and broadcasts {"type":"profile",...} (see profiler.h)
+void BrainDaemon::cmdProfile(const JsonTokens& msg) {
+    if (m_profiler.running()) {
+        wsReply("{\"error\":\"profile_running\"}");
+        return;
+    }
+    int seconds = msg.getInt("seconds", PROFILE_DEFAULT_SECONDS);
+    int hz = msg.getInt("hz", PROFILE_DEFAULT_HZ);
+    if (seconds < 1 || seconds > PROFILE_MAX_SECONDS || hz < 1 || hz > PROFILE_MAX_HZ) {
+        wsReply("{\"error\":\"invalid_profile\"}");
+        return;
+    }
+    char path[256];
+    if (!msg.getString("path", path, sizeof(path))) {
+        snprintf(path, sizeof(path), "%s", PROFILE_DEFAULT_PATH);
+    }
+    
+    if (!m_profiler.start((uint32_t)hz)) {
+        wsReply("{\"error\":\"profile_failed\"}");
         return;
     }
+    m_profile_path = path;
+    m_loop.setTimerInterval(m_profile_timer, (uint32_t)seconds * 1000);
+    
+    JsonWriter w(m_arena);
+    w.beginObject()
+     .field("status", "profiling")
+     .field("seconds", seconds)
+     .field("hz", hz)
+     .field("path", path)
+     .endObject();
+    wsReply(w);
+}
+
+void BrainDaemon::finishProfile() {
+    m_loop.setTimerInterval(m_profile_timer, 0);
+    size_t samples = m_profiler.stop();
+    size_t stacks = 0;
+    bool ok = m_profiler.writeFolded(m_profile_path.c_str(), &stacks);
+    uint32_t dropped = m_profiler.dropped();
+    m_profiler.reset();
+    
+    JsonWriter w(m_arena);
+    w.beginObject();
+    if (ok) {
+        w.field("type", "profile")
+         .field("path", m_profile_path.c_str())
+         .field("samples", samples)
+         .field("stacks", stacks)
+         .field("dropped", dropped);
+    } else {
+        w.field("error", "profile_write_failed")
+         .field("path", m_profile_path.c_str());
+    }
+    w.endObject();
+    wsBroadcast(w);
+}
+
+#ifdef SPIDER_SIM
+// brain_sim: mailbox commands go straight to the in-process Muscle
+static bool sim_mailbox_send(void*, uint8_t cmd_id, uint32_t param) {
+    muscle_sim_mailbox(cmd_id, param);
+    return true;
 }
+#endif
 
 static void print_usage(const char* prog) {
     std::cout << "Usage: " << prog << " [options]\n"
@@ -1249,7 +4074,28 @@ static void print_usage(const char* prog) {
               << "  --log-level LEVEL   Set log level: DEBUG, INFO, WARN, ERROR (default: INFO)\n"
               << "  --log-file PATH     Log to file (in addition to stdout)\n"
               << "  --serial-port PORT  Serial port for control (default: " << DEFAULT_SERIAL_PORT << ")\n"
-              << "  --serial-baud BAUD  Serial baud rate (default: " << DEFAULT_SERIAL_BAUD << ")\n"
+              << "  --serial-baud BAUD  Serial baud rate, up to 3000000 (default: " << DEFAULT_SERIAL_BAUD << ")\n"
+              << "  --rt-priority PRIO  SCHED_FIFO priority of the motion thread, 0 = off (default: " << MOTION_RT_PRIORITY << ")\n"
+              << "  --rt-cpu CPU        Pin the motion thread to CPU (default: no pinning)\n"
+              << "  --ws-high-water N   Per-client TX bytes before telemetry is dropped (default: " << WS_TX_HIGH_WATER_BYTES << ")\n"
+              << "  --ws-max-queue N    Per-client TX bytes before disconnect (default: " << WS_TX_MAX_QUEUE_BYTES << ")\n"
+              << "  --ws-max-message N  Largest fragmented or streamed message (default: " << WS_RX_MAX_MESSAGE_BYTES << ")\n"
+              << "  --ws-deflate LEVEL  Accept permessage-deflate offers, zlib level 0-9 (default: off)\n"
+              << "  --ws-deflate-min N  Smallest frame payload worth compressing (default: " << WS_DEFLATE_MIN_DEFAULT << ")\n"
+              << "  --ring-slots N      Cap on shared-memory ring slots, power of 2 (default: fill region)\n"
+              << "  --shm-cached        Map ring slots cacheable, cleaning each written line\n"
+              << "  --flow-policy P     Packets finding the ring full: drop, queue, coalesce, block, overwrite (default: coalesce)\n"
+              << "  --pose-policy P     The same for immediate poses only, e.g. overwrite for teleoperation (default: --flow-policy)\n"
+              << "  --motion-pack PATH  Precompiled motion sequences for play (default: " << DEFAULT_MOTION_PACK << ")\n"
+              << "  --servo-calib PATH  Servo calibration table (default: " << DEFAULT_SERVO_CALIB << ")\n"
+              << "  --tunables PATH     Runtime tunables, name = value lines (default: " << DEFAULT_TUNABLES << " if present)\n"
+              << "  --eye-json          Send eye events as JSON lines instead of binary packets\n"
+              << "  --capture PATH      Record commands and packets for capture_replay (rotating file)\n"
+              << "  --capture-mb N      Capture file size in MB (default: " << (CAPTURE_DEFAULT_BYTES >> 20) << ")\n"
+              << "  --range-sensor A:G:D  VL53L0X at I2C address A, XSHUT on GPIO G (-1 = none), facing D degrees\n"
+              << "                      or \"scan\" on the scan servo; repeat for up to " << VL53L0X_MAX_SENSORS << " (default: one on the servo)\n"
+              << "  --udp-port PORT     Accept UDP teleop datagrams on PORT (default: off)\n"
+              << "  --udp-key PATH      Shared secret for UDP teleop, 1-" << UDP_TELEOP_KEY_MAX << " bytes (required with --udp-port)\n"
               << "  -h, --help          Show this help\n";
 }
 
@@ -1259,6 +4105,26 @@ int main(int argc, char* argv[]) {
         {"log-file",    required_argument, 0, 'f'},
         {"serial-port", required_argument, 0, 's'},
         {"serial-baud", required_argument, 0, 'b'},
+        {"rt-priority", required_argument, 0, 'p'},
+        {"rt-cpu",      required_argument, 0, 'c'},
+        {"ws-high-water", required_argument, 0, 'w'},
+        {"ws-max-queue",  required_argument, 0, 'q'},
+        {"ws-max-message", required_argument, 0, 'M'},
+        {"ws-deflate",    required_argument, 0, 'D'},
+        {"ws-deflate-min", required_argument, 0, 'd'},
+        {"ring-slots",    required_argument, 0, 'r'},
+        {"shm-cached",    no_argument,       0, 'C'},
+        {"flow-policy",   required_argument, 0, 'F'},
+        {"pose-policy",   required_argument, 0, 'P'},
+        {"motion-pack",   required_argument, 0, 'm'},
+        {"servo-calib",   required_argument, 0, 'k'},
+        {"tunables",      required_argument, 0, 'T'},
+        {"eye-json",      no_argument,       0, 'j'},
+        {"capture",       required_argument, 0, 'x'},
+        {"capture-mb",    required_argument, 0, 'X'},
+        {"range-sensor",  required_argument, 0, 'V'},
+        {"udp-port",      required_argument, 0, 'u'},
+        {"udp-key",       required_argument, 0, 'K'},
         {"help",        no_argument,       0, 'h'},
         {0, 0, 0, 0}
     };
@@ -1267,9 +4133,31 @@ int main(int argc, char* argv[]) {
     std::string log_file;
     std::string serial_port = DEFAULT_SERIAL_PORT;
     int serial_baud = DEFAULT_SERIAL_BAUD;
+    int rt_priority = MOTION_RT_PRIORITY;
+    int rt_cpu = -1;
+    size_t ws_high_water = WS_TX_HIGH_WATER_BYTES;
+    size_t ws_max_queue = WS_TX_MAX_QUEUE_BYTES;
+    size_t ws_max_message = WS_RX_MAX_MESSAGE_BYTES;
+    int ws_deflate_level = -1;
+    size_t ws_deflate_min = WS_DEFLATE_MIN_DEFAULT;
+    uint32_t ring_slots = 0;
+    bool shm_cached = false;
+    FlowPolicy flow_policy = FlowPolicy::COALESCE;
+    FlowPolicy pose_policy = flow_policy;
+    bool pose_policy_set = false;
+    std::string motion_pack = DEFAULT_MOTION_PACK;
+    std::string servo_calib = DEFAULT_SERVO_CALIB;
+    std::string tunables = DEFAULT_TUNABLES;
+    bool eye_json = false;
+    std::string capture_path;
+    size_t capture_bytes = CAPTURE_DEFAULT_BYTES;
+    DistanceSensor::Mount range_sensors[VL53L0X_MAX_SENSORS];
+    size_t range_sensor_count = 0;
+    long udp_port = 0;
+    std::string udp_key;
     
     int opt;
-    while ((opt = getopt_long(argc, argv, "l:f:s:b:h", long_options, nullptr)) != -1) {
+    while ((opt = getopt_long(argc, argv, "l:f:s:b:p:c:w:q:M:D:d:r:CF:P:m:k:T:jx:X:V:u:K:h", long_options, nullptr)) != -1) {
         switch (opt) {
         case 'l':
             log_level = optarg;
@@ -1283,6 +4171,99 @@ int main(int argc, char* argv[]) {
         case 'b':
             serial_baud = atoi(optarg);
             break;
+        case 'p':
+            rt_priority = atoi(optarg);
+            break;
+        case 'c':
+            rt_cpu = atoi(optarg);
+            break;
+        case 'w':
+            ws_high_water = strtoul(optarg, nullptr, 10);
+            break;
+        case 'q':
+            ws_max_queue = strtoul(optarg, nullptr, 10);
+            break;
+        case 'M':
+            ws_max_message = strtoul(optarg, nullptr, 10);
+            break;
+        case 'D':
+            ws_deflate_level = atoi(optarg);
+            if (ws_deflate_level < 0 || ws_deflate_level > 9) {
+                std::cerr << "Invalid --ws-deflate level: " << optarg << " (0-9)" << std::endl;
+                return 1;
+            }
+            break;
+        case 'd':
+            ws_deflate_min = strtoul(optarg, nullptr, 10);
+            break;
+        case 'r':
+            ring_slots = (uint32_t)strtoul(optarg, nullptr, 10);
+            break;
+        case 'C':
+            shm_cached = true;
+            break;
+        case 'F':
+            if (!parseFlowPolicy(optarg, flow_policy)) {
+                std::cerr << "Unknown flow policy: " << optarg << std::endl;
+                print_usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'P':
+            if (!parseFlowPolicy(optarg, pose_policy)) {
+                std::cerr << "Unknown flow policy: " << optarg << std::endl;
+                print_usage(argv[0]);
+                return 1;
+            }
+            pose_policy_set = true;
+            break;
+        case 'm':
+            motion_pack = optarg;
+            break;
+        case 'k':
+            servo_calib = optarg;
+            break;
+        case 'T':
+            tunables = optarg;
+            break;
+        case 'j':
+            eye_json = true;
+            break;
+        case 'x':
+            capture_path = optarg;
+            break;
+        case 'X':
+            capture_bytes = (size_t)strtoul(optarg, nullptr, 10) << 20;
+            break;
+        case 'V': {
+            // ADDR:GPIO:ANGLE, e.g. 0x30:17:scan or 0x31:27:45
+            char* end = nullptr;
+            long addr = strtol(optarg, &end, 0);
+            long gpio = (*end == ':') ? strtol(end + 1, &end, 0) : -2;
+            long angle = -2;
+            if (*end == ':') {
+                angle = strcmp(end + 1, "scan") == 0 ? VL53L0X_MOUNT_SCAN : strtol(end + 1, &end, 10);
+                if (angle != VL53L0X_MOUNT_SCAN && *end != '\0') angle = -2;
+            }
+            if (range_sensor_count == VL53L0X_MAX_SENSORS || addr < 0 || addr > 0x7F || gpio < -1 || angle < VL53L0X_MOUNT_SCAN || angle > 180) {
+                std::cerr << "Invalid range sensor: " << optarg << std::endl;
+                print_usage(argv[0]);
+                return 1;
+            }
+            range_sensors[range_sensor_count++] = { (uint8_t)addr, (int)gpio, (int)angle };
+            break;
+        }
+        case 'u':
+            udp_port = strtol(optarg, nullptr, 10);
+            if (udp_port <= 0 || udp_port > 65535) {
+                std::cerr << "Invalid UDP port: " << optarg << std::endl;
+                print_usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'K':
+            udp_key = optarg;
+            break;
         case 'h':
             print_usage(argv[0]);
             return 0;
@@ -1292,6 +4273,10 @@ int main(int argc, char* argv[]) {
         }
     }
     
+    // Before the first thread (the logger's) starts, so every thread inherits the mask
+    sigset_t stop = stop_signals();
+    pthread_sigmask(SIG_BLOCK, &stop, nullptr);
+    
     Logger::instance().setLevel(log_level);
     if (!log_file.empty()) {
         if (!Logger::instance().openFile(log_file)) {
@@ -1299,12 +4284,48 @@ int main(int argc, char* argv[]) {
         }
     }
     
-    std::signal(SIGINT, signal_handler);
-    std::signal(SIGTERM, signal_handler);
-    
     BrainDaemon daemon;
     daemon.setSerialPort(serial_port);
     daemon.setSerialBaud(serial_baud);
+    daemon.setRealtime(rt_priority, rt_cpu);
+    daemon.setWsQueueLimits(ws_high_water, ws_max_queue);
+    daemon.setWsMaxMessage(ws_max_message);
+    if (ws_deflate_level >= 0 && !WsDeflate::available()) {
+        std::cerr << "Warning: --ws-deflate ignored, built without zlib" << std::endl;
+    }
+    daemon.setWsDeflate(ws_deflate_level, ws_deflate_min);
+    daemon.setRingSlots(ring_slots);
+    daemon.setShmCached(shm_cached);
+    daemon.setFlowPolicy(flow_policy);
+    if (pose_policy_set) {
+        daemon.setPosePolicy(pose_policy);
+    }
+    daemon.setMotionPack(motion_pack);
+    daemon.setServoCalib(servo_calib);
+    daemon.setTunables(tunables);
+    daemon.setEyeJsonOnly(eye_json);
+    daemon.setCapture(capture_path, capture_bytes);
+    if (range_sensor_count > 0 && !daemon.setRangeSensors(range_sensors, range_sensor_count)) {
+        std::cerr << "Invalid range sensor set: unique addresses 0x08-0x77, at most one without XSHUT" << std::endl;
+        return 1;
+    }
+    if (udp_port > 0 && udp_key.empty()) {
+        std::cerr << "--udp-port needs --udp-key: teleop datagrams are always authenticated" << std::endl;
+        return 1;
+    }
+    daemon.setUdpTeleop((uint16_t)udp_port, udp_key);
+    
+#ifdef SPIDER_SIM
+    // Anonymous memory stands in for the reserved DRAM; the Muscle attaches once we publish
+    void* sim_region = mmap(nullptr, SHARED_MEM_SIZE, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (sim_region == MAP_FAILED || muscle_sim_start(sim_region) != 0) {
+        LOG_ERROR("Brain", "Failed to start the Muscle simulator");
+        return 1;
+    }
+    daemon.setSimBackend(sim_region, sim_mailbox_send, nullptr);
+    LOG_INFO("Brain", "Running against the simulated Muscle");
+#endif
     
     if (!daemon.init()) {
         LOG_ERROR("Brain", "Initialization failed");
@@ -1313,6 +4334,10 @@ int main(int argc, char* argv[]) {
     
     daemon.run();
     daemon.shutdown();
+#ifdef SPIDER_SIM
+    muscle_sim_stop();
+    munmap(sim_region, SHARED_MEM_SIZE);
+#endif
     
     LOG_INFO("Brain", "Exited cleanly");
     return 0;
@@ -0,0 +1,102 @@
+/**
+ * Spider Robot v3.1 - Motion Pack Implementation
+ */
+
+#include "motion_pack.h"
+#include "logger.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static const char* TAG = "MotionPack";
+
+MotionPack::~MotionPack() {
+    close();
+}
+
+bool MotionPack::open(const char* path) {
+    close();
+
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        LOG_WARN(TAG, "Cannot open %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(MotionPackHeader)) {
+        LOG_ERROR(TAG, "%s is not a motion pack", path);
+        ::close(fd);
+        return false;
+    }
+
+    void* ptr = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    ::close(fd);
+    if (ptr == MAP_FAILED) {
+        LOG_ERROR(TAG, "mmap %s failed: %s", path, strerror(errno));
+        return false;
+    }
+
+    m_base = (const uint8_t*)ptr;
+    m_size = (size_t)st.st_size;
+    m_mapped = true;
+
+    if (motion_pack_validate(m_base, m_size) != 0) {
+        LOG_ERROR(TAG, "%s failed validation", path);
+        close();
+        return false;
+    }
+
+    const MotionPackHeader* hdr = (const MotionPackHeader*)m_base;
+    LOG_INFO(TAG, "Loaded %s: %u sequences, %u frames", path, hdr->sequence_count, hdr->frame_count);
+    return true;
+}
+
+bool MotionPack::openBuffer(const void* data, size_t size) {
+    close();
+    if (motion_pack_validate(data, size) != 0) {
+        return false;
+    }
+    m_base = (const uint8_t*)data;
+    m_size = size;
+    m_mapped = false;
+    return true;
+}
+
+void MotionPack::close() {
+    if (m_base && m_mapped) {
+        munmap((void*)m_base, m_size);
+    }
+    m_base = nullptr;
+    m_size = 0;
+    m_mapped = false;
+}
+
+size_t MotionPack::sequenceCount() const {
+    return m_base ? ((const MotionPackHeader*)m_base)->sequence_count : 0;
+}
+
+const MotionPackEntry* MotionPack::entry(size_t i) const {
+    if (i >= sequenceCount()) return nullptr;
+    return &motion_pack_index(m_base)[i];
+}
+
+const MotionPackEntry* MotionPack::find(const char* name) const {
+    uint32_t hash = motion_pack_hash(name);
+    size_t count = sequenceCount();
+    const MotionPackEntry* index = count ? motion_pack_index(m_base) : nullptr;
+    for (size_t i = 0; i < count; i++) {
+        if (index[i].name_hash == hash && strcmp(index[i].name, name) == 0) {
+            return &index[i];
+        }
+    }
+    return nullptr;
+}
+
+const MotionPackFrame* MotionPack::frames(const MotionPackEntry& entry) const {
+    return motion_pack_frames(m_base) + entry.first_frame;
+}
@@ -0,0 +1,62 @@
+/**
+ * Spider Robot v3.1 - Motion Pack
+ *
+ * Read-only mmap of a precompiled motion pack (common/motion_pack_format.h).
+ * The file is validated once when opened; after that lookups and frame
+ * access are plain pointers into the mapping, safe to hand to the motion
+ * thread. The motion thread's mlockall(MCL_FUTURE) locks the pages, so
+ * playback never faults.
+ */
+
+#ifndef MOTION_PACK_H
+#define MOTION_PACK_H
+
+#include <cstddef>
+#include <cstdint>
+
+extern "C" {
+#include "motion_pack_format.h"
+}
+
+class MotionPack {
+public:
+    MotionPack() = default;
+    ~MotionPack();
+
+    MotionPack(const MotionPack&) = delete;
+    MotionPack& operator=(const MotionPack&) = delete;
+
+    /**
+     * Map and validate a pack file, replacing any open one. Must not be
+     * called while the motion thread may still play from the old one.
+     */
+    bool open(const char* path);
+
+    /**
+     * Use a pack already in memory (not copied, must outlive this object).
+     */
+    bool openBuffer(const void* data, size_t size);
+
+    void close();
+    bool isOpen() const { return m_base != nullptr; }
+
+    size_t sequenceCount() const;
+    const MotionPackEntry* entry(size_t i) const;
+
+    /**
+     * Sequence by name, or nullptr.
+     */
+    const MotionPackEntry* find(const char* name) const;
+
+    /**
+     * First frame of a sequence; entry must come from this pack.
+     */
+    const MotionPackFrame* frames(const MotionPackEntry& entry) const;
+
+private:
+    const uint8_t* m_base = nullptr;
+    size_t m_size = 0;
+    bool m_mapped = false;
+};
+
+#endif // MOTION_PACK_H
@@ -0,0 +1,42 @@
+/**
+ * Spider Robot v3.1 - Motion Player Implementation
+ */
+
+#include "motion_player.h"
+
+void MotionPlayer::start(const Request& request) {
+    m_request = request;
+    m_frame = 0;
+    m_loops_done = 0;
+    if (m_request.entry && (!m_request.frames || m_request.entry->frame_count == 0)) {
+        m_request.entry = nullptr;
+    }
+}
+
+void MotionPlayer::stop() {
+    m_request = Request();
+    m_frame = 0;
+}
+
+bool MotionPlayer::next(uint16_t* servo_us, uint32_t& t_ms, uint16_t& flags) {
+    if (!active()) return false;
+
+    const MotionPackFrame& f = m_request.frames[m_frame];
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) {
+        servo_us[i] = f.servo_us[i];
+    }
+    flags = f.flags;
+    t_ms = f.t_ms;
+    if (m_frame == 0 && m_loops_done == 0 && m_request.blend_ms != 0) {
+        t_ms = m_request.blend_ms;
+    }
+
+    if (++m_frame == m_request.entry->frame_count) {
+        m_frame = 0;
+        m_loops_done++;
+        if (m_request.loops != 0 && m_loops_done >= m_request.loops) {
+            m_request.entry = nullptr;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,52 @@
+#ifndef MOTION_PLAYER_H
+#define MOTION_PLAYER_H
+
+#include <cstdint>
+
+extern "C" {
+#include "motion_pack_format.h"
+}
+
+/**
+ * MotionPlayer - Keyframe source for motion pack sequences
+ *
+ * Walks the frames of one MotionPackEntry, optionally looping. The first
+ * frame can be given its own blend-in time, so a sequence starts smoothly
+ * from whatever pose the robot is in; later loops join the last frame to
+ * the first with the first frame's own t_ms.
+ *
+ * Owned by the motion thread like GaitEngine, which schedules its
+ * keyframes in the ring ahead of time.
+ */
+class MotionPlayer {
+public:
+    struct Request {
+        const MotionPackEntry* entry = nullptr;     // nullptr = stop
+        const MotionPackFrame* frames = nullptr;
+        uint32_t loops = 1;         // Times to play, 0 = until stopped
+        uint32_t blend_ms = 0;      // t_ms of the first frame, 0 = as stored
+    };
+
+    void start(const Request& request);
+    void stop();
+
+    bool active() const { return m_request.entry != nullptr; }
+    uint16_t mask() const { return active() ? m_request.entry->mask : 0; }
+
+    /**
+     * Next frame's pulse widths (all SERVO_COUNT_TOTAL channels, only
+     * mask() meaningful), time to reach it and flags. Returns false when
+     * the sequence has finished.
+     */
+    bool next(uint16_t* servo_us, uint32_t& t_ms, uint16_t& flags);
+
+    uint32_t frameIndex() const { return m_frame; }
+    uint32_t loopsDone() const { return m_loops_done; }
+
+private:
+    Request m_request;
+    uint32_t m_frame = 0;
+    uint32_t m_loops_done = 0;
+};
+
+#endif // MOTION_PLAYER_H
@@ -0,0 +1,833 @@
+/**
+ * Spider Robot v3.1 - Motion Thread Implementation
+ */
+
+#include "motion_thread.h"
+#include "logger.h"
+#include "trace.h"
+
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/timerfd.h>
+
+extern "C" {
+#include "protocol_posepacket31.h"
+#include "protocol_posedelta.h"
+#include "crc16_ccitt_false.h"
+#include "timebase.h"
+}
+
+static const char* TAG = "Motion";
+
+MotionThread::MotionThread() {
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) {
+        m_current_servos[i] = SERVO_PWM_NEUTRAL_US;
+        m_applied_servos[i].store(SERVO_PWM_NEUTRAL_US, std::memory_order_relaxed);
+        m_sent_us[i] = SERVO_PWM_NEUTRAL_US;
+    }
+}
+
+MotionThread::~MotionThread() {
+    stop();
+}
+
+bool MotionThread::init() {
+    if (!m_mailbox.open()) {
+        LOG_ERROR(TAG, "Failed to open mailbox");
+        return false;
+    }
+
+    if (!m_shared_mem.map(m_ring_max_slots)) {
+        LOG_ERROR(TAG, "Failed to map shared memory");
+        return false;
+    }
+    m_ring_slots.store(m_shared_mem.getSlotCount(), std::memory_order_relaxed);
+
+    m_wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_wake_fd < 0) {
+        LOG_ERROR(TAG, "eventfd failed: %s", strerror(errno));
+        return false;
+    }
+
+    m_heartbeat_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (m_heartbeat_fd < 0) {
+        LOG_ERROR(TAG, "timerfd_create failed: %s", strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+bool MotionThread::start() {
+    if (m_running.load()) {
+        return true;
+    }
+
+    // Page faults in the motion path would defeat SCHED_FIFO
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        LOG_WARN(TAG, "mlockall failed: %s (continuing unlocked)", strerror(errno));
+    }
+
+    struct itimerspec spec = {};
+    spec.it_interval.tv_sec = MOTION_HEARTBEAT_MS / 1000;
+    spec.it_interval.tv_nsec = (long)(MOTION_HEARTBEAT_MS % 1000) * 1000000L;
+    spec.it_value = spec.it_interval;
+    if (timerfd_settime(m_heartbeat_fd, 0, &spec, nullptr) < 0) {
+        LOG_ERROR(TAG, "timerfd_settime failed: %s", strerror(errno));
+        return false;
+    }
+
+    m_running.store(true);
+    m_thread = std::thread(&MotionThread::threadMain, this);
+    return true;
+}
+
+void MotionThread::stop() {
+    if (m_running.exchange(false)) {
+        wake();
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+    }
+
+    if (m_heartbeat_fd >= 0) {
+        close(m_heartbeat_fd);
+        m_heartbeat_fd = -1;
+    }
+    if (m_wake_fd >= 0) {
+        close(m_wake_fd);
+        m_wake_fd = -1;
+    }
+
+    m_shared_mem.unmap();
+    m_mailbox.close();
+}
+
+bool MotionThread::submitPose(uint32_t t_ms, uint16_t flags, uint16_t mask,
+                              const uint16_t* servo_us, uint32_t* out_seq,
+                              uint64_t exec_at_us, uint64_t rx_us) {
+    MotionIntent intent;
+    intent.exec_at_us = exec_at_us;
+    intent.rx_us = rx_us;
+    intent.t_ms = t_ms;
+    intent.flags = flags;
+    intent.mask = mask & MOTION_MASK_ALL;
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) {
+        intent.servo_us[i] = servo_us ? servo_us[i] : SERVO_PWM_NEUTRAL_US;
+    }
+    intent.has_feet = false;
+    intent.profile = TrajectoryPlanner::Profile::NONE;
+    return enqueue(intent, out_seq);
+}
+
+bool MotionThread::submitFeet(uint32_t t_ms, uint16_t flags, const FootTargets& feet,
+                              uint32_t* out_seq, uint64_t exec_at_us, uint64_t rx_us) {
+    MotionIntent intent;
+    intent.exec_at_us = exec_at_us;
+    intent.rx_us = rx_us;
+    intent.t_ms = t_ms;
+    intent.flags = flags;
+    intent.mask = 0;
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) {
+        intent.servo_us[i] = SERVO_PWM_NEUTRAL_US;
+    }
+    intent.has_feet = true;
+    intent.feet = feet;
+    intent.profile = TrajectoryPlanner::Profile::NONE;
+    return enqueue(intent, out_seq);
+}
+
+bool MotionThread::submitMove(uint32_t t_ms, uint16_t flags, uint16_t mask,
+                              const uint16_t* servo_us, TrajectoryPlanner::Profile profile,
+                              uint32_t* out_seq, uint64_t rx_us) {
+    MotionIntent intent;
+    intent.exec_at_us = 0;
+    intent.rx_us = rx_us;
+    intent.t_ms = t_ms;
+    intent.flags = flags;
+    intent.mask = mask & MOTION_MASK_ALL;
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) {
+        intent.servo_us[i] = clamp_servo_us(servo_us[i]);
+    }
+    intent.has_feet = false;
+    intent.profile = profile;
+    return enqueue(intent, out_seq);
+}
+
+bool MotionThread::enqueue(MotionIntent& intent, uint32_t* out_seq) {
+    // Single producer: with a free slot now, the push below cannot fail
+    if (m_queue.size() >= MOTION_QUEUE_DEPTH) {
+        m_queue_drops++;
+        LOG_WARN(TAG, "Motion queue full, dropping pose (drops=%u)", m_queue_drops);
+        return false;
+    }
+
+    intent.seq = m_seq.fetch_add(1, std::memory_order_acq_rel) + 1;
+    m_queue.push(intent);
+
+    if (out_seq) {
+        *out_seq = intent.seq;
+    }
+    wake();
+    return true;
+}
+
+void MotionThread::submitEstop() {
+    uint32_t count = m_estops_sent.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (!m_mailbox.sendEstop()) {
+        m_estop_pending.store(true, std::memory_order_release);
+    }
+    trace_point(SHARED_TRACE_ESTOP_SENT, count);
+    wake();
+}
+
+bool MotionThread::setWalk(const GaitEngine::Params& params) {
+    if (!m_gait_queue.push(params)) {
+        LOG_WARN(TAG, "Gait queue full, dropping walk command");
+        return false;
+    }
+    wake();
+    return true;
+}
+
+bool MotionThread::stopWalk() {
+    return setWalk(GaitEngine::Params());
+}
+
+bool MotionThread::play(const MotionPlayer::Request& request) {
+    if (!m_play_queue.push(request)) {
+        LOG_WARN(TAG, "Playback queue full, dropping play command");
+        return false;
+    }
+    wake();
+    return true;
+}
+
+bool MotionThread::stopPlayback() {
+    return play(MotionPlayer::Request());
+}
+
+bool MotionThread::setCalibration(const ServoCalibration::Table& table) {
+    if (!m_calib_queue.push(table)) {
+        LOG_WARN(TAG, "Calibration queue full, keeping current table");
+        return false;
+    }
+    wake();
+    return true;
+}
+
+bool MotionThread::setMuscleTunables(const SharedTunablesData& data) {
+    if (!m_tunables_queue.push(data)) {
+        LOG_WARN(TAG, "Tunables queue full, keeping current set");
+        return false;
+    }
+    wake();
+    return true;
+}
+
+void MotionThread::getServos(uint16_t* out) const {
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) {
+        out[i] = m_applied_servos[i].load(std::memory_order_relaxed);
+    }
+}
+
+void MotionThread::wake() {
+    uint64_t one = 1;
+    if (m_wake_fd >= 0) {
+        ssize_t n = write(m_wake_fd, &one, sizeof(one));
+        (void)n;
+    }
+}
+
+void MotionThread::applyRealtime() {
+    if (m_rt_cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(m_rt_cpu, &set);
+        int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (err != 0) {
+            LOG_WARN(TAG, "Could not pin to CPU %d: %s", m_rt_cpu, strerror(err));
+        }
+    }
+
+    if (m_rt_priority > 0) {
+        struct sched_param sp = {};
+        sp.sched_priority = m_rt_priority;
+        int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp);
+        if (err != 0) {
+            LOG_WARN(TAG, "SCHED_FIFO priority %d unavailable: %s (running as SCHED_OTHER)",
+                     m_rt_priority, strerror(err));
+            return;
+        }
+    }
+
+    LOG_INFO(TAG, "Motion thread running (prio=%d, cpu=%d)", m_rt_priority, m_rt_cpu);
+}
+
+void MotionThread::threadMain() {
+    pthread_setname_np(pthread_self(), "brain_motion");   // Its root in profile stacks
+    applyRealtime();
+
+    struct pollfd fds[2];
+    fds[0].fd = m_wake_fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = m_heartbeat_fd;
+    fds[1].events = POLLIN;
+
+    while (m_running.load(std::memory_order_acquire)) {
+        int timeout_ms = -1;
+        if (!m_backlog.empty()) {
+            timeout_ms = MOTION_FLOW_POLL_MS;
+        } else if (scheduling()) {
+            timeout_ms = MOTION_SCHED_POLL_MS;
+        }
+        int n = poll(fds, 2, timeout_ms);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            LOG_ERROR(TAG, "poll failed: %s", strerror(errno));
+            break;
+        }
+
+        uint64_t count;
+        if (fds[0].revents & POLLIN) {
+            ssize_t r = read(m_wake_fd, &count, sizeof(count));
+            (void)r;
+        }
+
+        // E-STOP first, then heartbeat, then queued poses
+        if (m_estop_pending.exchange(false, std::memory_order_acq_rel)) {
+            m_mailbox.sendEstop();
+        }
+
+        if (fds[1].revents & POLLIN) {
+            ssize_t r = read(m_heartbeat_fd, &count, sizeof(count));
+            (void)r;
+            tickHeartbeat();
+        }
+
+        ServoCalibration::Table calib;
+        while (m_calib_queue.pop(calib)) {
+            m_calib = calib;
+        }
+
+        SharedTunablesData tunables;
+        while (m_tunables_queue.pop(tunables)) {
+            m_tunables_gen.store(m_shared_mem.writeTunables(tunables), std::memory_order_relaxed);
+        }
+
+        // Walking, playback and planned moves exclude each other; the newest request wins
+        GaitEngine::Params params;
+        while (m_gait_queue.pop(params)) {
+            m_gait.setParams(params);
+            if (m_gait.active()) {
+                m_player.stop();
+                m_planner.stop();
+            }
+        }
+        MotionPlayer::Request play;
+        while (m_play_queue.pop(play)) {
+            m_player.start(play);
+            if (m_player.active()) {
+                m_gait.reset();
+                m_planner.stop();
+            }
+        }
+        if (m_estop && m_estop->load()) {
+            m_gait.reset();
+            m_player.stop();
+            m_planner.stop();
+            m_ring_drops.fetch_add((uint32_t)m_backlog.retainEstop(), std::memory_order_relaxed);
+            m_delta_synced = false;
+        }
+
+        // Drain in batches: one publish and one notify each
+        PosePacket31 batch[MOTION_BATCH_MAX];
+        uint64_t exec_at[MOTION_BATCH_MAX];
+        uint64_t rx_us[MOTION_BATCH_MAX];
+        size_t batch_len = 0;
+        MotionIntent intent;
+        while (m_queue.pop(intent)) {
+            m_handled_seq = intent.seq;
+            if (intent.has_feet) solveFeet(intent);
+
+            // Poses on the scheduled source's channels, planned moves and E-STOP take
+            // over from it; anything else rides on its keyframes
+            bool planned = intent.profile != TrajectoryPlanner::Profile::NONE;
+            if (scheduling()) {
+                if ((intent.flags & FLAG_ESTOP) || planned || (intent.mask & scheduledMask())) {
+                    m_gait.reset();
+                    m_player.stop();
+                    m_planner.stop();
+                } else {
+                    applyServos(intent);
+                    continue;
+                }
+            }
+
+            // Planned moves start from wherever the servos were last sent
+            if (planned && !(intent.flags & FLAG_ESTOP)) {
+                m_planner.start(m_current_servos, intent.servo_us, intent.mask, intent.t_ms,
+                                intent.profile);
+                continue;
+            }
+
+            // Only the groups the pose addresses restart on the Muscle, so a scan step
+            // leaves a leg move running; keyframes and E-STOP address every group
+            if (!(intent.flags & FLAG_ESTOP)) {
+                intent.flags = posepacket31_set_groups(intent.flags,
+                                                       servo_groups_for_channels(intent.mask));
+            }
+            if (!buildPacket(intent, batch[batch_len])) continue;
+            exec_at[batch_len] = intent.exec_at_us;
+            rx_us[batch_len] = intent.rx_us;
+            if (++batch_len == MOTION_BATCH_MAX) {
+                flushBatch(batch, exec_at, rx_us, batch_len);
+                batch_len = 0;
+            }
+        }
+        batch_len += fillScheduled(batch + batch_len, exec_at + batch_len, rx_us + batch_len,
+                                   MOTION_BATCH_MAX - batch_len);
+        flushBatch(batch, exec_at, rx_us, batch_len);
+        m_walking.store(m_gait.active(), std::memory_order_relaxed);
+        m_playing.store(m_player.active(), std::memory_order_relaxed);
+        m_moving.store(m_planner.active(), std::memory_order_relaxed);
+
+        publishStats();
+    }
+}
+
+void MotionThread::solveFeet(MotionIntent& intent) {
+    uint8_t unreachable = 0;
+    intent.mask = m_kinematics.feetToServoUs(intent.feet, intent.servo_us, &unreachable);
+    if (unreachable) {
+        m_ik_unreachable++;
+        LOG_DEBUG(TAG, "Foot targets out of reach (legs 0x%X, seq=%u, total=%u)",
+                  unreachable, intent.seq, m_ik_unreachable);
+    }
+}
+
+void MotionThread::applyServos(const MotionIntent& intent) {
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) {
+        if (intent.mask & (1u << i)) {
+            m_current_servos[i] = clamp_servo_us(intent.servo_us[i]);
+            m_applied_servos[i].store(m_current_servos[i], std::memory_order_relaxed);
+        }
+    }
+}
+
+uint16_t MotionThread::scheduledMask() const {
+    if (m_gait.active()) return GAIT_LEG_MASK;
+    if (m_player.active()) return m_player.mask();
+    return m_planner.mask();
+}
+
+void MotionThread::encodePacket(const MotionIntent& intent, const uint16_t* logical_us,
+                                const ServoCalibration::Table& calib, PosePacket31& pkt) {
+    pkt.magic = SPIDER_MAGIC;
+    pkt.ver_major = SPIDER_VERSION_MAJOR;
+    pkt.ver_minor = SPIDER_VERSION_MINOR;
+    pkt.seq = intent.seq;
+    pkt.t_ms = intent.t_ms;
+    pkt.flags = intent.flags;
+    uint16_t physical[SERVO_COUNT_TOTAL];
+    ServoCalibration::apply(calib, logical_us, physical);
+    memcpy(pkt.servo_us, physical, sizeof(physical));
+    pkt.crc16 = crc16_ccitt_false((const uint8_t*)&pkt, sizeof(pkt) - 2);
+}
+
+bool MotionThread::buildPacket(const MotionIntent& intent, PosePacket31& pkt) {
+    applyServos(intent);
+    encodePacket(intent, m_current_servos, m_calib, pkt);
+
+    if (m_estop && m_estop->load() && !(pkt.flags & FLAG_ESTOP)) {
+        LOG_DEBUG(TAG, "E-STOP active, dropping packet seq=%u", pkt.seq);
+        return false;
+    }
+    trace_point(SHARED_TRACE_PACKET_BUILT, pkt.seq);
+    return true;
+}
+
+size_t MotionThread::fillScheduled(PosePacket31* pkts, uint64_t* exec_at_us, uint64_t* rx_us,
+                                   size_t count) {
+    if (!scheduling()) return 0;
+
+    // Keyframes play back to back; after a pause the next one starts a little ahead
+    uint64_t now = timebase_shared_us();
+    if (m_sched_end_us < now + MOTION_SCHED_START_US) {
+        m_sched_end_us = now + MOTION_SCHED_START_US;
+    }
+
+    size_t n = 0;
+    while (n < count && scheduling() &&
+           m_sched_end_us < now + MOTION_SCHED_LEAD_US) {
+        // The ring needs rising seqs: only take one while no submitted pose is still queued
+        uint32_t seq = m_seq.load(std::memory_order_acquire);
+        if (seq != m_handled_seq ||
+            !m_seq.compare_exchange_strong(seq, seq + 1, std::memory_order_acq_rel)) {
+            break;
+        }
+        m_handled_seq = seq + 1;
+
+        MotionIntent intent;
+        intent.exec_at_us = m_sched_end_us;
+        intent.rx_us = 0;
+        intent.seq = seq + 1;
+        intent.flags = FLAG_CLAMP_ENABLE;
+        intent.has_feet = false;
+        intent.profile = TrajectoryPlanner::Profile::NONE;
+        intent.mask = scheduledMask();
+        if (m_gait.active()) {
+            m_gait.next(intent.servo_us, intent.t_ms);
+            publishOdometry();
+        } else if (m_planner.active()) {
+            m_planner.next(intent.servo_us, intent.t_ms);
+        } else {
+            uint16_t frame_flags = 0;
+            m_player.next(intent.servo_us, intent.t_ms, frame_flags);
+            intent.flags |= frame_flags & (FLAG_HOLD | FLAG_INTERP_Q16);
+        }
+        m_sched_end_us += (uint64_t)intent.t_ms * 1000;
+
+        if (!buildPacket(intent, pkts[n])) continue;
+        exec_at_us[n] = intent.exec_at_us;
+        rx_us[n] = 0;
+        n++;
+    }
+    return n;
+}
+
+void MotionThread::flushBatch(const PosePacket31* pkts, const uint64_t* exec_at_us,
+                              const uint64_t* rx_us, size_t count) {
+    if (count == 0 && m_backlog.empty()) return;
+
+    // Waiting packets go first; new ones only pass them once the backlog is empty
+    drainBacklog();
+    size_t done = m_backlog.empty() ? writeRing(pkts, exec_at_us, rx_us, count) : 0;
+
+    if (done < count && policyFor(exec_at_us[done]) == FlowPolicy::BLOCK) {
+        m_flow_blocked.fetch_add(1, std::memory_order_relaxed);
+        uint64_t deadline = timebase_micros() + MOTION_FLOW_BLOCK_US;
+        // An E-STOP ends the wait: what is left is about to be purged anyway
+        while (done < count && timebase_micros() < deadline && !(m_estop && m_estop->load())) {
+            usleep(MOTION_FLOW_RETRY_US);
+            // Each credit returned is an ACK; keep up so none are overwritten
+            readAcks();
+            drainBacklog();
+            if (m_backlog.empty()) {
+                done += writeRing(pkts + done, exec_at_us + done, rx_us + done, count - done);
+            }
+        }
+    }
+
+    uint32_t dropped = 0;
+    for (size_t i = done; i < count; i++) {
+        FlowPolicy policy = policyFor(exec_at_us[i]);
+
+        // Nothing older is waiting: the newest poses go straight in, over the oldest unread ones
+        if (policy == FlowPolicy::OVERWRITE && m_backlog.empty()) {
+            size_t run = 1;
+            while (i + run < count && policyFor(exec_at_us[i + run]) == FlowPolicy::OVERWRITE) {
+                run++;
+            }
+            size_t written = writeRing(pkts + i, exec_at_us + i, rx_us + i, run, true);
+            if (written > 0) {
+                i += written - 1;
+                continue;
+            }
+        }
+
+        switch (m_backlog.push(pkts[i], exec_at_us[i], rx_us[i], policy)) {
+            case PacketBacklog<MOTION_BACKLOG_DEPTH>::Result::QUEUED:
+                break;
+            case PacketBacklog<MOTION_BACKLOG_DEPTH>::Result::COALESCED:
+                m_coalesced.fetch_add(1, std::memory_order_relaxed);
+                break;
+            case PacketBacklog<MOTION_BACKLOG_DEPTH>::Result::DROPPED:
+            case PacketBacklog<MOTION_BACKLOG_DEPTH>::Result::EVICTED:
+                dropped++;
+                break;
+        }
+    }
+    if (dropped > 0) {
+        LOG_WARN(TAG, "Shared memory ring full (%s/%s), dropped %u packets",
+                 flowPolicyName(m_flow_policy), flowPolicyName(m_pose_policy), dropped);
+        m_ring_drops.fetch_add(dropped, std::memory_order_relaxed);
+    }
+    m_backlog_len.store((uint32_t)m_backlog.size(), std::memory_order_relaxed);
+    m_backlog_max.store((uint32_t)m_backlog.highWater(), std::memory_order_relaxed);
+}
+
+void MotionThread::drainBacklog() {
+    if (m_backlog.empty()) return;
+    m_backlog.pop(writeRing(m_backlog.packets(), m_backlog.execAt(), m_backlog.rxUs(),
+                            m_backlog.size()));
+}
+
+size_t MotionThread::writeRing(const PosePacket31* pkts, const uint64_t* exec_at_us,
+                              const uint64_t* rx_us, size_t count, bool overwrite) {
+    if (count == 0) return 0;
+    if (count > MOTION_BACKLOG_DEPTH) count = MOTION_BACKLOG_DEPTH;
+
+    // The Muscle loses what gets overwritten, so a delta could miss its base: send full packets
+    if (overwrite) {
+        m_shared_mem.refreshReadIdx();
+        if (m_shared_mem.available() < count) m_delta_synced = false;
+    }
+
+    PosePacket31 wire[MOTION_BACKLOG_DEPTH];
+    encodeWire(pkts, count, wire);
+
+    uint32_t write_idx;
+    uint32_t overwritten = 0;
+    size_t written = overwrite
+        ? m_shared_mem.overwritePackets(wire, count, write_idx, exec_at_us, overwritten)
+        : m_shared_mem.writePackets(wire, count, write_idx, exec_at_us);
+    if (written == 0) return 0;
+    commitWire(pkts, wire, written);
+    m_overwritten.fetch_add(overwritten, std::memory_order_relaxed);
+
+    uint64_t written_us = timebase_micros();
+    for (size_t i = 0; i < written; i++) {
+        trace_point_at(SHARED_TRACE_RING_WRITTEN, written_us, pkts[i].seq,
+                       write_idx - (uint32_t)(written - 1 - i));
+
+        // Scheduled slots are held by the Muscle on purpose; only time immediate ones
+        WriteStamp& ws = m_write_stamps[pkts[i].seq & (MOTION_WRITE_STAMPS - 1)];
+        ws.seq.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        if (exec_at_us[i] == 0) {
+            ws.time_us.store(written_us, std::memory_order_relaxed);
+            ws.seq.store(pkts[i].seq, std::memory_order_release);
+        }
+    }
+
+    if (m_capture) {
+        for (size_t i = 0; i < written; i++) {
+            if (!m_capture_queue.push({written_us, exec_at_us[i], pkts[i]})) {
+                m_capture_drops.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // The Muscle re-checks write_idx after clearing the flag, so skipping is safe
+    if (!m_shared_mem.notifySuppressed()) {
+        if (m_mailbox.notifyPacketReady(write_idx)) {
+            trace_point(SHARED_TRACE_MAILBOX_SENT, pkts[written - 1].seq, write_idx);
+        } else {
+            LOG_ERROR(TAG, "Failed to notify via mailbox");
+        }
+    }
+
+    m_packets_sent.fetch_add((uint32_t)written, std::memory_order_relaxed);
+
+    uint64_t sent_us = timebase_micros();
+    for (size_t i = 0; i < written; i++) {
+        if (rx_us[i] != 0 && sent_us >= rx_us[i]) {
+            m_cmd_latency.record(sent_us - rx_us[i]);
+        }
+    }
+    return written;
+}
+
+/**
+ * Ring form of pkts: a pose that differs from the one before it in at
+ * most POSEDELTA_MAX_CHANNELS calibrated channels goes as a delta. It is
+ * decided here, on what is actually written, so flow control can drop
+ * and coalesce full packets without breaking the chain.
+ */
+void MotionThread::encodeWire(const PosePacket31* pkts, size_t count, PosePacket31* wire) const {
+    bool synced = m_delta_synced;
+    uint32_t run = m_delta_run;
+    const uint16_t* prev = m_sent_us;
+
+    for (size_t i = 0; i < count; i++) {
+        const PosePacket31& pkt = pkts[i];
+        uint16_t changed = 0;
+        for (int ch = 0; ch < SERVO_COUNT_TOTAL; ch++) {
+            if (pkt.servo_us[ch] != prev[ch]) changed |= (uint16_t)(1u << ch);
+        }
+
+        if (synced && run < MOTION_DELTA_REFRESH && !(pkt.flags & FLAG_ESTOP) &&
+            posedelta_channels(changed) <= POSEDELTA_MAX_CHANNELS) {
+            PosePacketDelta* d = reinterpret_cast<PosePacketDelta*>(&wire[i]);
+            posedelta_init(d, pkt.seq, pkt.t_ms, pkt.flags, changed, pkt.servo_us);
+            posedelta_set_crc(d, crc16_ccitt_false((const uint8_t*)d, posedelta_crc_len(changed)));
+            run++;
+        } else {
+            wire[i] = pkt;
+            synced = !(pkt.flags & FLAG_ESTOP);
+            run = 0;
+        }
+        prev = pkt.servo_us;
+    }
+}
+
+/**
+ * Advance the delta state past the written prefix of encodeWire()'s output.
+ */
+void MotionThread::commitWire(const PosePacket31* pkts, const PosePacket31* wire, size_t written) {
+    uint32_t deltas = 0;
+    for (size_t i = 0; i < written; i++) {
+        if (wire[i].magic == SPIDER_DELTA_MAGIC) {
+            m_delta_run++;
+            deltas++;
+        } else {
+            m_delta_synced = !(wire[i].flags & FLAG_ESTOP);
+            m_delta_run = 0;
+        }
+    }
+    memcpy(m_sent_us, pkts[written - 1].servo_us, sizeof(m_sent_us));
+    m_deltas_sent.fetch_add(deltas, std::memory_order_relaxed);
+}
+
+uint64_t MotionThread::ringWriteTime(uint32_t seq) const {
+    if (seq == 0) return 0;
+
+    const WriteStamp& ws = m_write_stamps[seq & (MOTION_WRITE_STAMPS - 1)];
+    if (ws.seq.load(std::memory_order_acquire) != seq) return 0;
+    uint64_t t = ws.time_us.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return (ws.seq.load(std::memory_order_relaxed) == seq) ? t : 0;
+}
+
+void MotionThread::tickHeartbeat() {
+    bool watched = m_shared_mem.bumpAlive();
+
+    // Packets the Muscle consumed since the last period already fed its
+    // watchdog; the interrupt is only needed on an idle channel. Worst case
+    // is two periods between feeds, still inside HEARTBEAT_TIMEOUT_MS.
+    uint32_t read_idx = m_shared_mem.refreshReadIdx();
+    bool consumed = read_idx != m_heartbeat_read_idx;
+    m_heartbeat_read_idx = read_idx;
+
+    if (watched || consumed) {
+        m_heartbeats_skipped.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        m_mailbox.sendHeartbeat();
+    }
+
+    tickPing();
+}
+
+void MotionThread::tickPing() {
+    // The answer is a few us away but never waited for: the Muscle's
+    // stamps hold every leg, so any later heartbeat can collect it
+    if (m_ping_seq != 0) collectPing();
+    if (++m_ping_periods < MOTION_PING_PERIODS) return;
+    m_ping_periods = 0;
+
+    if (m_ping_seq != 0) {
+        m_ping_seq = 0;
+        m_pings_lost.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (++m_pings_sent == 0) m_pings_sent = 1;
+    m_ping_seq = m_pings_sent;
+    uint64_t tx_us = timebase_shared_us();
+    m_shared_mem.writeProbe(m_ping_seq, tx_us);
+    if (!m_mailbox.sendPing(m_ping_seq)) {
+        m_ping_seq = 0;
+        m_pings_lost.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void MotionThread::collectPing() {
+    uint64_t tx_us, rx_us, echo_us;
+    if (m_shared_mem.readProbe(tx_us, rx_us, echo_us) != m_ping_seq) return;
+
+    if (echo_us >= tx_us) m_ping_rtt.record(echo_us - tx_us);
+    if (rx_us >= tx_us) m_ping_up.record(rx_us - tx_us);
+    if (echo_us >= rx_us) m_ping_echo.record(echo_us - rx_us);
+    m_ping_seq = 0;
+}
+
+void MotionThread::readAcks() {
+    SharedAckRecord acks[64];
+    uint32_t lost = 0;
+    size_t n;
+    do {
+        n = m_shared_mem.readAcks(acks, 64, lost);
+        for (size_t i = 0; i < n; i++) {
+            uint8_t status = acks[i].status;
+            if (status == SHARED_ACK_OK) {
+                m_acked.fetch_add(1, std::memory_order_relaxed);
+            } else if (status == SHARED_ACK_SKIPPED) {
+                // Merged on the Muscle, so the delta baseline still holds
+                m_skipped.fetch_add(1, std::memory_order_relaxed);
+            } else if (status < SHARED_ACK_STATUS_COUNT) {
+                m_nacked[status].fetch_add(1, std::memory_order_relaxed);
+                m_delta_synced = false;
+                LOG_DEBUG(TAG, "Muscle rejected seq=%u (%s)", acks[i].seq,
+                          shared_ack_status_name(status));
+            }
+        }
+    } while (n == 64);
+    if (lost > 0) {
+        m_ack_lost.fetch_add(lost, std::memory_order_relaxed);
+        m_delta_synced = false;
+    }
+}
+
+DeliveryStats MotionThread::getDeliveryStats() const {
+    DeliveryStats d;
+    d.written = m_packets_sent.load(std::memory_order_relaxed);
+    d.acked = m_acked.load(std::memory_order_relaxed);
+    d.skipped = m_skipped.load(std::memory_order_relaxed);
+    for (int i = 0; i < SHARED_ACK_STATUS_COUNT; i++) {
+        d.nacked[i] = m_nacked[i].load(std::memory_order_relaxed);
+    }
+    d.ack_lost = m_ack_lost.load(std::memory_order_relaxed);
+    d.backlog = m_backlog_len.load(std::memory_order_relaxed);
+    d.backlog_max = m_backlog_max.load(std::memory_order_relaxed);
+    d.coalesced = m_coalesced.load(std::memory_order_relaxed);
+    d.dropped = m_ring_drops.load(std::memory_order_relaxed);
+    d.overwritten = m_overwritten.load(std::memory_order_relaxed);
+    d.blocked = m_flow_blocked.load(std::memory_order_relaxed);
+    d.deltas = m_deltas_sent.load(std::memory_order_relaxed);
+    return d;
+}
+
+// Seqlock: the motion thread is the only writer
+void MotionThread::publishOdometry() {
+    const GaitEngine::Odometry& o = m_gait.odometry();
+    uint32_t v = m_odom_version.load(std::memory_order_relaxed);
+    m_odom_version.store(v + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_odom[0].store(o.x_mm, std::memory_order_relaxed);
+    m_odom[1].store(o.y_mm, std::memory_order_relaxed);
+    m_odom[2].store(o.heading_rad, std::memory_order_relaxed);
+    m_odom_version.store(v + 2, std::memory_order_release);
+}
+
+GaitEngine::Odometry MotionThread::getOdometry() const {
+    GaitEngine::Odometry o;
+    for (;;) {
+        uint32_t v = m_odom_version.load(std::memory_order_acquire);
+        if (v & 1) continue;
+        o.x_mm = m_odom[0].load(std::memory_order_relaxed);
+        o.y_mm = m_odom[1].load(std::memory_order_relaxed);
+        o.heading_rad = m_odom[2].load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (m_odom_version.load(std::memory_order_relaxed) == v) return o;
+    }
+}
+
+void MotionThread::publishStats() {
+    readAcks();
+    m_tx_count.store(m_mailbox.getTxCount(), std::memory_order_relaxed);
+    m_ring_w.store(m_shared_mem.getWriteIdx(), std::memory_order_relaxed);
+    m_ring_r.store(m_shared_mem.getReadIdx(), std::memory_order_relaxed);
+    m_muscle_estop.store(m_shared_mem.muscleEstop(), std::memory_order_relaxed);
+
+    if (!m_layout_warned && m_shared_mem.layoutRejected()) {
+        LOG_ERROR(TAG, "Muscle rejected shared layout v%d.%d - update the FreeRTOS image",
+                  SHARED_LAYOUT_VERSION >> 8, SHARED_LAYOUT_VERSION & 0xFF);
+        m_layout_warned = true;
+    }
+}
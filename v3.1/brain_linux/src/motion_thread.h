@@ -0,0 +1,496 @@
+/**
+ * Spider Robot v3.1 - Motion Thread
+ *
+ * Real-time thread that owns the Brain → Muscle path: the mailbox, the
+ * shared-memory ring, the current servo pose and heartbeat generation.
+ * The I/O thread (WebSocket, serial, scan) hands it pose intents through
+ * a lock-free SPSC ring, so a blocking sensor read or a slow client can
+ * no longer delay heartbeats or packets.
+ */
+
+#ifndef MOTION_THREAD_H
+#define MOTION_THREAD_H
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#include "gait_engine.h"
+#include "latency_histogram.h"
+#include "leg_kinematics.h"
+#include "mailbox.h"
+#include "motion_player.h"
+#include "packet_backlog.h"
+#include "servo_calibration.h"
+#include "shared_memory.h"
+#include "spsc_ring.h"
+#include "trajectory_planner.h"
+
+extern "C" {
+#include "limits.h"
+}
+
+#define MOTION_QUEUE_DEPTH        64
+#define MOTION_RT_PRIORITY        80
+#define MOTION_HEARTBEAT_MS       100
+#define MOTION_BATCH_MAX          16
+#define MOTION_WRITE_STAMPS       256     // Recent ring-write times kept, power of 2
+#define MOTION_SCHED_LEAD_US      150000  // Gait, playback and planned keyframes are scheduled this far ahead
+#define MOTION_SCHED_START_US     20000   // First keyframe after a pause starts this far out
+#define MOTION_SCHED_POLL_MS      20      // Refill period while a scheduled source is active
+#define MOTION_GAIT_QUEUE_DEPTH   4
+#define MOTION_PLAY_QUEUE_DEPTH   4
+#define MOTION_CALIB_QUEUE_DEPTH  2
+#define MOTION_TUNABLES_QUEUE_DEPTH 2
+#define MOTION_BACKLOG_DEPTH      64      // Packets held for ring credit
+#define MOTION_FLOW_POLL_MS       5       // Retry period while packets wait for credit
+#define MOTION_FLOW_BLOCK_US      20000   // Longest a BLOCK flush waits for credit
+#define MOTION_FLOW_RETRY_US      500
+#define MOTION_DELTA_REFRESH      32      // At most this many deltas between full packets
+#define MOTION_PING_PERIODS       10      // Latency probe every this many heartbeat periods (1 s)
+#define MOTION_CAPTURE_DEPTH      256     // Written packets awaiting the capture file
+
+/**
+ * One pose update. Channels whose bit is set in mask are taken from
+ * servo_us; the others keep their current value. exec_at_us is a
+ * timebase_shared_us() deadline for the Muscle (0 = on arrival); rx_us
+ * is when the command that caused it was received (0 = not timed).
+ * With has_feet set, the leg channels come from solving feet instead.
+ * A profile other than NONE plans a move to servo_us over at least t_ms
+ * instead of sending it as one packet.
+ */
+struct MotionIntent {
+    uint64_t exec_at_us;
+    uint64_t rx_us;
+    uint32_t seq;
+    uint32_t t_ms;
+    uint16_t flags;
+    uint16_t mask;
+    uint16_t servo_us[SERVO_COUNT_TOTAL];
+    bool has_feet;
+    FootTargets feet;
+    TrajectoryPlanner::Profile profile;
+};
+
+/**
+ * End-to-end delivery counters since start(). Packets written but not
+ * yet acked, nacked or lost are still in the ring. The Muscle acks a
+ * scheduled packet when it prefetches it, well before its deadline.
+ */
+struct DeliveryStats {
+    uint32_t written;                           // Packets written to the ring
+    uint32_t acked;                             // Applied by the Muscle
+    uint32_t skipped;                           // Applied, but superseded before the Muscle output it
+    uint32_t nacked[SHARED_ACK_STATUS_COUNT];   // Rejected, by SHARED_NACK_* ([0] unused)
+    uint32_t ack_lost;                          // ACK records overwritten before they were read
+    uint32_t backlog;                           // Waiting for ring credit now
+    uint32_t backlog_max;
+    uint32_t coalesced;                         // Replaced in the backlog by a newer pose
+    uint32_t dropped;                           // Given up by flow control
+    uint32_t overwritten;                       // Unread ring slots replaced under OVERWRITE (never acked)
+    uint32_t blocked;                           // BLOCK flushes that had to wait
+    uint32_t deltas;                            // Of written, sent as PosePacketDelta
+};
+
+/**
+ * A packet as written to the ring (full form, before delta encoding),
+ * for the command capture.
+ */
+struct SentPacket {
+    uint64_t time_us;           // timebase_micros() when written
+    uint64_t exec_at_us;
+    PosePacket31 pkt;
+};
+
+#define MOTION_MASK_ALL     ((uint16_t)((1u << SERVO_COUNT_TOTAL) - 1))
+
+class MotionThread {
+public:
+    MotionThread();
+    ~MotionThread();
+
+    /**
+     * E-STOP state shared with the I/O side. Non-ESTOP packets are
+     * dropped while it is set.
+     */
+    void setEstopFlag(const std::atomic<bool>* estop) { m_estop = estop; }
+
+    /**
+     * SCHED_FIFO priority (0 = keep default policy) and CPU to pin to
+     * (-1 = no affinity). Must be called before start().
+     */
+    void setRealtime(int priority, int cpu) { m_rt_priority = priority; m_rt_cpu = cpu; }
+
+    /**
+     * Cap on shared ring slots (0 = fill the reserved region). Must be
+     * called before init().
+     */
+    void setRingSlots(uint32_t max_slots) { m_ring_max_slots = max_slots; }
+
+    /**
+     * What to do with packets that find the ring full (see
+     * packet_backlog.h), for scheduled keyframes and, unless
+     * setPosePolicy() says otherwise, immediate poses. Must be called
+     * before start().
+     */
+    void setFlowPolicy(FlowPolicy policy) { m_flow_policy = policy; m_pose_policy = policy; }
+    FlowPolicy getFlowPolicy() const { return m_flow_policy; }
+
+    /**
+     * Policy for immediate poses only (exec_at_us 0: servo, pose and
+     * scan commands), so a teleoperation stream can overwrite while
+     * trajectories still queue. Call after setFlowPolicy().
+     */
+    void setPosePolicy(FlowPolicy policy) { m_pose_policy = policy; }
+    FlowPolicy getPosePolicy() const { return m_pose_policy; }
+
+    /**
+     * Map ring slots cacheable with explicit line cleans (see SharedMemory).
+     * Must be called before init().
+     */
+    void setShmCached(bool cached) { m_shared_mem.setCached(cached); }
+
+    /**
+     * Talk to an in-process Muscle instead of the hardware: region
+     * replaces /dev/mem and hook the cmdqu device (see sim/). Must be
+     * called before init().
+     */
+    void setSimBackend(void* region, Mailbox::SendHook hook, void* ctx) {
+        m_shared_mem.setRegion(region);
+        m_mailbox.setSendHook(hook, ctx);
+    }
+
+    /**
+     * Keep a copy of every packet written to the ring for
+     * popSentPacket(). Must be called before start().
+     */
+    void setPacketCapture(bool enabled) { m_capture = enabled; }
+
+    bool init();
+    bool start();
+    void stop();
+
+    /**
+     * Fill pkt for intent with logical_us calibrated through calib, CRC
+     * included. The packet half of buildPacket(), exposed for the benchmarks.
+     */
+    static void encodePacket(const MotionIntent& intent, const uint16_t* logical_us,
+                             const ServoCalibration::Table& calib, PosePacket31& pkt);
+
+    // ---- I/O thread API (single producer) ----
+
+    /**
+     * Queue a pose update for the motion thread.
+     * @param out_seq receives the packet sequence number (optional)
+     * @param exec_at_us when the Muscle should apply it (0 = on arrival)
+     * @param rx_us timebase_micros() at command receipt, for cmdLatency()
+     * @return false if the queue is full
+     */
+    bool submitPose(uint32_t t_ms, uint16_t flags, uint16_t mask,
+                    const uint16_t* servo_us, uint32_t* out_seq = nullptr,
+                    uint64_t exec_at_us = 0, uint64_t rx_us = 0);
+
+    /**
+     * Queue body-frame foot positions; the motion thread solves them
+     * into leg joint pulse widths (see LegKinematics). Other channels
+     * keep their current value. Parameters as for submitPose().
+     */
+    bool submitFeet(uint32_t t_ms, uint16_t flags, const FootTargets& feet,
+                    uint32_t* out_seq = nullptr, uint64_t exec_at_us = 0, uint64_t rx_us = 0);
+
+    /**
+     * Queue a planned move: the motion thread samples a velocity and
+     * acceleration limited profile from the current pose to servo_us and
+     * schedules it like the gait. t_ms is the minimum duration; poses on
+     * the moved channels or E-STOP cancel it. Profile::NONE is the same as
+     * submitPose(). A planned move stops walking and playback.
+     */
+    bool submitMove(uint32_t t_ms, uint16_t flags, uint16_t mask, const uint16_t* servo_us,
+                    TrajectoryPlanner::Profile profile, uint32_t* out_seq = nullptr,
+                    uint64_t rx_us = 0);
+
+    /**
+     * Replace the per-channel move limits. Must be called before start().
+     */
+    void setMoveLimits(const TrajectoryPlanner::Limits& limits) { m_planner.setLimits(limits); }
+
+    /**
+     * Replace the leg geometry and joint calibration. Must be called
+     * before start().
+     */
+    void setLegKinematics(const LegKinematics::Config& config) { m_kinematics.setConfig(config); }
+
+    /**
+     * Send the E-STOP mailbox command from the calling thread, then wake
+     * the motion thread to drop what it has queued. Bypasses the pose
+     * queue and the motion thread (which may be waiting for ring credit)
+     * so it can never be dropped or held back; a failed send is retried
+     * by the motion thread.
+     */
+    void submitEstop();
+
+    /**
+     * Start, steer or stop (dir = turn = 0) the gait engine. Keyframes
+     * are generated on the motion thread and scheduled in the ring up to
+     * MOTION_SCHED_LEAD_US ahead. Starting a walk stops playback. Poses that set leg channels or
+     * E-STOP cancel the gait; other poses are merged into its keyframes.
+     * @return false if the gait queue is full
+     */
+    bool setWalk(const GaitEngine::Params& params);
+    bool stopWalk();
+    bool isWalking() const { return m_walking.load(std::memory_order_relaxed); }
+
+    /**
+     * The gait's dead-reckoned pose (see GaitEngine::Odometry), as of
+     * the last keyframe scheduled, so up to MOTION_SCHED_LEAD_US ahead
+     * of the legs. Safe from any thread.
+     */
+    GaitEngine::Odometry getOdometry() const;
+
+    /**
+     * Play a motion pack sequence (entry == nullptr stops), scheduled like
+     * the gait. Poses on the sequence's channels or E-STOP stop it; other
+     * poses merge. Starting playback stops walking. The frames must stay
+     * mapped while the motion thread runs.
+     * @return false if the playback queue is full
+     */
+    bool play(const MotionPlayer::Request& request);
+    bool stopPlayback();
+    bool isPlaying() const { return m_playing.load(std::memory_order_relaxed); }
+    bool isMoving() const { return m_moving.load(std::memory_order_relaxed); }
+
+    /**
+     * The Muscle has latched an E-STOP (SHARED_FLAG_ESTOP), refreshed with
+     * the other shared-header stats on every pass of the motion thread.
+     */
+    bool muscleEstop() const { return m_muscle_estop.load(std::memory_order_relaxed); }
+
+    /**
+     * Swap in a new calibration table. The motion thread takes it between
+     * packets, so every packet uses exactly one table; poses and
+     * getServos() stay in logical pulse widths.
+     * @return false if a previous table has not been taken yet
+     */
+    bool setCalibration(const ServoCalibration::Table& table);
+
+    /**
+     * Publish the Muscle's tunables (see shared_tunables.h). The motion
+     * thread writes them on its next pass; the Muscle applies them at
+     * its next output tick.
+     * @return false if a previous set has not been taken yet
+     */
+    bool setMuscleTunables(const SharedTunablesData& data);
+    uint32_t getTunablesGeneration() const { return m_tunables_gen.load(std::memory_order_relaxed); }
+
+    /**
+     * The tunables the Muscle reports running with, read straight from
+     * shared memory. False before map() or mid-rewrite.
+     */
+    bool readMuscleTunables(SharedTunablesApplied& out) const {
+        return m_shared_mem.readTunablesApplied(out);
+    }
+
+    void getServos(uint16_t* out) const;
+    uint32_t getSeq() const { return m_seq.load(std::memory_order_relaxed); }
+    uint32_t getTxCount() const { return m_tx_count.load(std::memory_order_relaxed); }
+    uint32_t getWriteIdx() const { return m_ring_w.load(std::memory_order_relaxed); }
+    uint32_t getReadIdx() const { return m_ring_r.load(std::memory_order_relaxed); }
+    uint32_t getRingSlots() const { return m_ring_slots.load(std::memory_order_relaxed); }
+    uint32_t getPacketsSent() const { return m_packets_sent.load(std::memory_order_relaxed); }
+    // Heartbeat periods covered by packet traffic or brain_alive instead of a mailbox interrupt
+    uint32_t getHeartbeatsSkipped() const { return m_heartbeats_skipped.load(std::memory_order_relaxed); }
+    uint32_t getQueueDrops() const { return m_queue_drops; }
+    uint32_t getRingDrops() const { return m_ring_drops.load(std::memory_order_relaxed); }
+
+    /**
+     * Delivery counters, from the motion thread's flow control and the
+     * Muscle's ACK records (see shared_ack.h). Safe from any thread.
+     */
+    DeliveryStats getDeliveryStats() const;
+
+    /**
+     * Pull new Muscle event log records (I/O thread only). Reading the
+     * log never writes shared memory, so it does not disturb the ring.
+     */
+    size_t readMuscleLog(SharedLogRecord* out, size_t max, uint32_t& lost) {
+        return m_shared_mem.readLog(out, max, lost);
+    }
+
+    /**
+     * Latest Muscle telemetry, read straight from shared memory. Returns
+     * false until the Muscle has published it.
+     */
+    bool readMuscleTelemetry(SharedTelemetryData& out) const {
+        return m_shared_mem.readTelemetry(out);
+    }
+
+    /**
+     * Newest Muscle trace records, read straight from shared memory.
+     */
+    size_t readMuscleTrace(SharedTraceRecord* out, size_t max) const {
+        return m_shared_mem.readTrace(out, max);
+    }
+
+    /**
+     * Muscle trace records newer than cursor (I/O thread only).
+     */
+    size_t readMuscleTraceSince(uint32_t& cursor, SharedTraceRecord* out, size_t max) const {
+        return m_shared_mem.readTraceSince(cursor, out, max);
+    }
+
+    /**
+     * Command receipt to ring written and Muscle notified, per packet, in us.
+     */
+    const LatencyHistogram& cmdLatency() const { return m_cmd_latency; }
+
+    /**
+     * Inter-core latency probe (see shared_probe.h), in us: CMD_PING sent
+     * to the Muscle's answer, mailbox send to the Muscle's interrupt, and
+     * that interrupt to the motion task's answer, all from the Muscle's
+     * stamps. The answer is picked up on a later heartbeat rather than
+     * waited for; pings not answered by the next one count as lost.
+     */
+    const LatencyHistogram& pingRtt() const { return m_ping_rtt; }
+    const LatencyHistogram& pingUplink() const { return m_ping_up; }
+    const LatencyHistogram& pingEcho() const { return m_ping_echo; }
+    uint32_t getPingsLost() const { return m_pings_lost.load(std::memory_order_relaxed); }
+
+    /**
+     * timebase_micros() at which seq was written to the ring, or 0 if it
+     * was scheduled or is no longer among the last MOTION_WRITE_STAMPS.
+     */
+    uint64_t ringWriteTime(uint32_t seq) const;
+
+    /**
+     * Oldest packet written since the last call, with setPacketCapture()
+     * on (I/O thread only). Packets that found the queue full are counted
+     * by getCaptureDrops().
+     */
+    bool popSentPacket(SentPacket& out) { return m_capture_queue.pop(out); }
+    uint32_t getCaptureDrops() const { return m_capture_drops.load(std::memory_order_relaxed); }
+
+private:
+    void threadMain();
+    void applyRealtime();
+    void wake();
+    bool enqueue(MotionIntent& intent, uint32_t* out_seq);
+    void solveFeet(MotionIntent& intent);
+    void applyServos(const MotionIntent& intent);
+    bool scheduling() const { return m_gait.active() || m_player.active() || m_planner.active(); }
+    uint16_t scheduledMask() const;
+    bool buildPacket(const MotionIntent& intent, PosePacket31& pkt);
+    size_t fillScheduled(PosePacket31* pkts, uint64_t* exec_at_us, uint64_t* rx_us,
+                         size_t count);
+    void flushBatch(const PosePacket31* pkts, const uint64_t* exec_at_us,
+                    const uint64_t* rx_us, size_t count);
+    size_t writeRing(const PosePacket31* pkts, const uint64_t* exec_at_us,
+                     const uint64_t* rx_us, size_t count, bool overwrite = false);
+    FlowPolicy policyFor(uint64_t exec_at_us) const {
+        return exec_at_us == 0 ? m_pose_policy : m_flow_policy;
+    }
+    void encodeWire(const PosePacket31* pkts, size_t count, PosePacket31* wire) const;
+    void commitWire(const PosePacket31* pkts, const PosePacket31* wire, size_t written);
+    void drainBacklog();
+    void readAcks();
+    void tickHeartbeat();
+    void tickPing();
+    void collectPing();
+    void publishStats();
+    void publishOdometry();
+
+    Mailbox m_mailbox;
+    SharedMemory m_shared_mem;
+    SpscRing<MotionIntent, MOTION_QUEUE_DEPTH> m_queue;
+    SpscRing<GaitEngine::Params, MOTION_GAIT_QUEUE_DEPTH> m_gait_queue;
+    SpscRing<MotionPlayer::Request, MOTION_PLAY_QUEUE_DEPTH> m_play_queue;
+    SpscRing<ServoCalibration::Table, MOTION_CALIB_QUEUE_DEPTH> m_calib_queue;
+    SpscRing<SharedTunablesData, MOTION_TUNABLES_QUEUE_DEPTH> m_tunables_queue;
+
+    std::thread m_thread;
+    std::atomic<bool> m_running{false};
+    std::atomic<bool> m_estop_pending{false};     // submitEstop() could not send; retry here
+    std::atomic<uint32_t> m_estops_sent{0};
+    const std::atomic<bool>* m_estop = nullptr;
+
+    int m_wake_fd = -1;
+    int m_heartbeat_fd = -1;
+    int m_rt_priority = MOTION_RT_PRIORITY;
+    int m_rt_cpu = -1;
+    uint32_t m_ring_max_slots = 0;
+    FlowPolicy m_flow_policy = FlowPolicy::COALESCE;
+    FlowPolicy m_pose_policy = FlowPolicy::COALESCE;
+    bool m_layout_warned = false;
+
+    // Last seq handed out; the producer takes seqs for poses, the motion
+    // thread for gait keyframes only while no pose is in flight (m_handled_seq)
+    std::atomic<uint32_t> m_seq{0};
+
+    // Producer-owned
+    uint32_t m_queue_drops = 0;
+
+    // Motion thread owned; published for status queries
+    uint16_t m_current_servos[SERVO_COUNT_TOTAL];
+    GaitEngine m_gait;
+    MotionPlayer m_player;
+    TrajectoryPlanner m_planner;
+    LegKinematics m_kinematics;
+    ServoCalibration::Table m_calib;
+    uint32_t m_ik_unreachable = 0;
+    uint64_t m_sched_end_us = 0;    // Where the next scheduled keyframe's segment starts
+    uint32_t m_handled_seq = 0;
+    std::atomic<bool> m_walking{false};
+    std::atomic<uint32_t> m_odom_version{0};    // Odd while being written
+    std::atomic<float> m_odom[3] = {};          // x_mm, y_mm, heading_rad
+    std::atomic<bool> m_playing{false};
+    std::atomic<bool> m_moving{false};
+    std::atomic<bool> m_muscle_estop{false};
+    std::atomic<uint32_t> m_tunables_gen{0};    // Last generation published
+    std::atomic<uint16_t> m_applied_servos[SERVO_COUNT_TOTAL];
+    std::atomic<uint32_t> m_tx_count{0};
+    std::atomic<uint32_t> m_heartbeats_skipped{0};
+    uint32_t m_heartbeat_read_idx = 0;      // read_idx at the last heartbeat period
+    uint32_t m_ping_periods = 0;
+    uint32_t m_pings_sent = 0;              // Also the last ping seq
+    uint32_t m_ping_seq = 0;                // Outstanding ping, 0 = answered or none
+    std::atomic<uint32_t> m_pings_lost{0};
+    std::atomic<uint32_t> m_ring_w{0};
+    std::atomic<uint32_t> m_ring_r{0};
+    std::atomic<uint32_t> m_ring_slots{0};
+    std::atomic<uint32_t> m_packets_sent{0};
+    std::atomic<uint32_t> m_ring_drops{0};
+    std::atomic<uint32_t> m_overwritten{0};
+    PacketBacklog<MOTION_BACKLOG_DEPTH> m_backlog;
+    std::atomic<uint32_t> m_backlog_len{0};
+    std::atomic<uint32_t> m_backlog_max{0};
+    std::atomic<uint32_t> m_coalesced{0};
+    std::atomic<uint32_t> m_flow_blocked{0};
+    std::atomic<uint32_t> m_acked{0};
+    std::atomic<uint32_t> m_skipped{0};
+    std::atomic<uint32_t> m_nacked[SHARED_ACK_STATUS_COUNT] = {};
+    std::atomic<uint32_t> m_ack_lost{0};
+
+    // What the Muscle merges deltas into: the last pose written, calibrated.
+    // Any packet it may not have applied forces the next one to be full.
+    uint16_t m_sent_us[SERVO_COUNT_TOTAL];
+    bool m_delta_synced = false;
+    uint32_t m_delta_run = 0;               // Deltas since the last full packet
+    std::atomic<uint32_t> m_deltas_sent{0};
+
+    // Written by the motion thread, read by the I/O thread; seq 0 while being updated
+    struct WriteStamp {
+        std::atomic<uint32_t> seq{0};
+        std::atomic<uint64_t> time_us{0};
+    };
+    WriteStamp m_write_stamps[MOTION_WRITE_STAMPS];
+    LatencyHistogram m_cmd_latency;
+
+    bool m_capture = false;
+    SpscRing<SentPacket, MOTION_CAPTURE_DEPTH> m_capture_queue;
+    std::atomic<uint32_t> m_capture_drops{0};
+
+    LatencyHistogram m_ping_rtt;
+    LatencyHistogram m_ping_up;
+    LatencyHistogram m_ping_echo;
+};
+
+#endif // MOTION_THREAD_H
@@ -0,0 +1,159 @@
+/**
+ * Spider Robot v3.1 - Obstacle Avoider Implementation
+ */
+
+#include "obstacle_avoider.h"
+
+#include <cstdlib>
+
+// find_best_direction(): neighbours add a quarter, each sector off centre costs 20 mm
+#define AVOID_NEIGHBOUR_WEIGHT  0.25f
+#define AVOID_OFF_CENTER_MM     20
+
+const char* ObstacleAvoider::actionName(Action action) {
+    switch (action) {
+        case Action::FORWARD:       return "forward";
+        case Action::SLOW:          return "slow";
+        case Action::TURN_LEFT:     return "turn_left";
+        case Action::TURN_RIGHT:    return "turn_right";
+        case Action::BACKUP:        return "backup";
+        case Action::STOP:          return "stop";
+    }
+    return "unknown";
+}
+
+void ObstacleAvoider::onSample(int angle_deg, int distance_mm, uint64_t now_ms) {
+    if (abs(angle_deg - AVOID_FRONT_DEG) > m_config.front_cone_deg / 2) return;
+    m_front_mm = distance_mm;
+    m_front_ms = now_ms;
+}
+
+void ObstacleAvoider::freshSectors(const ScanController& scan, uint64_t now_ms, int* sector_mm) const {
+    for (size_t i = 0; i < SCAN_SECTOR_COUNT; i++) {
+        const ScanController::Sector& sec = scan.getSector(i);
+        bool fresh = sec.updated_ms != 0 && now_ms - sec.updated_ms <= m_config.max_age_ms;
+        sector_mm[i] = fresh ? sec.median_mm : -1;
+    }
+}
+
+const ObstacleAvoider::Decision& ObstacleAvoider::evaluate(const ScanController& scan, uint64_t now_ms) {
+    int sector_mm[SCAN_SECTOR_COUNT];
+    freshSectors(scan, now_ms, sector_mm);
+    return evaluate(sector_mm, now_ms);
+}
+
+const ObstacleAvoider::Decision& ObstacleAvoider::evaluate(const int* sector_mm, uint64_t now_ms) {
+    int front = -1;
+    if (m_front_ms != 0 && now_ms - m_front_ms <= m_config.max_age_ms) {
+        front = m_front_mm;
+    }
+    if (front < 0) {
+        int half = m_config.front_cone_deg / 2;
+        for (int i = (AVOID_FRONT_DEG - half) / SCAN_SECTOR_DEG;
+             i <= (AVOID_FRONT_DEG + half) / SCAN_SECTOR_DEG; i++) {
+            if (sector_mm[i] >= 0 && (front < 0 || sector_mm[i] < front)) front = sector_mm[i];
+        }
+    }
+
+    int heading_deg = AVOID_FRONT_DEG;
+    int heading_mm = front;
+    Action action = decide(front, sector_mm, heading_deg, heading_mm);
+
+    // A turn or back-up runs its course unless things get worse
+    Action held = m_decision.action;
+    bool holding = (held == Action::TURN_LEFT || held == Action::TURN_RIGHT || held == Action::BACKUP) &&
+                   now_ms - m_action_ms < m_config.hold_ms;
+    if (holding && action != Action::STOP && action != Action::BACKUP) {
+        action = held;
+        heading_deg = m_decision.heading_deg;
+        heading_mm = m_decision.heading_mm;
+    }
+
+    if (action != m_decision.action) m_action_ms = now_ms;
+    m_decision = { action, front, heading_deg, heading_mm };
+    return m_decision;
+}
+
+ObstacleAvoider::Action ObstacleAvoider::decide(int front_mm, const int* sector_mm,
+                                                int& heading_deg, int& heading_mm) const {
+    // No reading at all: creep on, as the Python module does
+    if (front_mm < 0) return Action::SLOW;
+    if (front_mm <= m_config.critical_mm) return Action::BACKUP;
+
+    if (front_mm <= m_config.warning_mm) {
+        int best = bestSector(sector_mm);
+        if (best < 0) return Action::STOP;
+
+        heading_deg = best * SCAN_SECTOR_DEG + SCAN_SECTOR_DEG / 2;
+        if (heading_deg > 180) heading_deg = 180;
+        heading_mm = sector_mm[best];
+        if (heading_mm <= m_config.critical_mm) return Action::STOP;
+
+        if (heading_deg > AVOID_FRONT_DEG + 10) return Action::TURN_LEFT;
+        if (heading_deg < AVOID_FRONT_DEG - 10) return Action::TURN_RIGHT;
+        return heading_mm <= m_config.warning_mm ? Action::BACKUP : Action::SLOW;
+    }
+
+    return front_mm <= m_config.safe_mm ? Action::SLOW : Action::FORWARD;
+}
+
+int ObstacleAvoider::bestSector(const int* sector_mm) const {
+    const int center = AVOID_FRONT_DEG / SCAN_SECTOR_DEG;
+    int best = -1;
+    float best_score = 0.0f;
+
+    for (int i = 0; i < (int)SCAN_SECTOR_COUNT; i++) {
+        if (sector_mm[i] < 0) continue;
+
+        float score = (float)sector_mm[i];
+        if (i > 0 && sector_mm[i - 1] >= 0) score += sector_mm[i - 1] * AVOID_NEIGHBOUR_WEIGHT;
+        if (i + 1 < (int)SCAN_SECTOR_COUNT && sector_mm[i + 1] >= 0) {
+            score += sector_mm[i + 1] * AVOID_NEIGHBOUR_WEIGHT;
+        }
+        score -= (float)(abs(i - center) * AVOID_OFF_CENTER_MM);
+
+        if (best < 0 || score > best_score) {
+            best = i;
+            best_score = score;
+        }
+    }
+    return best;
+}
+
+GaitEngine::Params ObstacleAvoider::steer(const GaitEngine::Params& requested) const {
+    GaitEngine::Params p = requested;
+    if (requested.dir <= 0.0f) return p;
+
+    switch (m_decision.action) {
+        case Action::FORWARD:
+            break;
+        case Action::SLOW:
+            p.speed *= m_config.slow_speed;
+            break;
+        case Action::TURN_LEFT:
+            p.dir = 0.0f;
+            p.turn = -m_config.turn_rate;   // turn > 0 is clockwise
+            break;
+        case Action::TURN_RIGHT:
+            p.dir = 0.0f;
+            p.turn = m_config.turn_rate;
+            break;
+        case Action::BACKUP:
+            p.dir = m_config.backup_dir;
+            p.turn = 0.0f;
+            p.speed *= m_config.slow_speed;
+            break;
+        case Action::STOP:
+            p.dir = 0.0f;
+            p.turn = 0.0f;
+            break;
+    }
+    return p;
+}
+
+void ObstacleAvoider::reset() {
+    m_front_mm = -1;
+    m_front_ms = 0;
+    m_action_ms = 0;
+    m_decision = { Action::FORWARD, -1, AVOID_FRONT_DEG, -1 };
+}
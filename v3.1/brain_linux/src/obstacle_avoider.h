@@ -0,0 +1,114 @@
+#ifndef OBSTACLE_AVOIDER_H
+#define OBSTACLE_AVOIDER_H
+
+#include <cstdint>
+
+#include "gait_engine.h"
+#include "scan_controller.h"
+
+/**
+ * ObstacleAvoider - Reactive gating and steering of the gait
+ *
+ * The in-daemon form of python/obstacle_avoidance.py: the same distance
+ * thresholds and action rules, but fed every VL53L0X sample directly
+ * instead of polling over WebSocket, so a walk is gated or steered
+ * within one sensor period of the reading.
+ *
+ * The front distance is the newest sample taken while the sensor looked
+ * into the front cone (the scan servo's estimated angle), else the
+ * closest fresh sector median in that cone of the ScanController polar
+ * map.
+ * Below the warning distance the heading comes from the map's sector
+ * medians, scored like find_best_direction(): distance, a bonus for
+ * clear neighbours, a penalty per sector off centre.
+ *
+ * Only forward walking is touched (dir > 0); turning in place and
+ * backing up pass through. Turn and back-up actions are held for
+ * hold_ms so a noisy reading does not make the gait chatter.
+ */
+#define AVOID_FRONT_DEG         90      // Scan angle straight ahead
+
+class ObstacleAvoider {
+public:
+    enum class Action : uint8_t {
+        FORWARD,        // Clear: walk as requested
+        SLOW,           // Something ahead, not critical
+        TURN_LEFT,      // Better clearance on the left
+        TURN_RIGHT,
+        BACKUP,         // Too close ahead
+        STOP            // No safe heading
+    };
+
+    struct Config {
+        int critical_mm = 120;
+        int warning_mm = 250;
+        int safe_mm = 400;
+        int front_cone_deg = 30;        // Width of "ahead" around AVOID_FRONT_DEG
+        uint32_t max_age_ms = 1000;     // Older map sectors and samples are ignored
+        uint32_t hold_ms = 300;         // Minimum time in a turn or back-up
+        float slow_speed = 0.5f;        // Speed factor for SLOW and BACKUP
+        float turn_rate = 0.6f;         // |turn| while turning away
+        float backup_dir = -0.5f;
+    };
+
+    struct Decision {
+        Action action;
+        int front_mm;           // -1 = unknown
+        int heading_deg;        // Chosen heading, AVOID_FRONT_DEG unless scanning found better
+        int heading_mm;         // Median there, -1 = unknown
+    };
+
+    static const char* actionName(Action action);
+
+    void setConfig(const Config& config) { m_config = config; }
+    const Config& getConfig() const { return m_config; }
+
+    /**
+     * Feed a sample taken with the sensor at angle_deg (distance_mm -1 =
+     * no valid reading). Samples outside the front cone only reach the
+     * decision through the polar map.
+     */
+    void onSample(int angle_deg, int distance_mm, uint64_t now_ms);
+
+    /**
+     * Decide from the latest front sample and the polar map of scan.
+     * Returns the decision in effect (held actions included).
+     */
+    const Decision& evaluate(const ScanController& scan, uint64_t now_ms);
+
+    /**
+     * Fresh sector medians of scan as evaluate() uses them (-1 = none),
+     * for callers that add evidence of their own.
+     */
+    void freshSectors(const ScanController& scan, uint64_t now_ms, int* sector_mm) const;
+
+    /**
+     * The same from explicit sector medians (SCAN_SECTOR_COUNT, -1 = no
+     * fresh reading), for tests and callers without a ScanController.
+     */
+    const Decision& evaluate(const int* sector_mm, uint64_t now_ms);
+
+    const Decision& decision() const { return m_decision; }
+
+    /**
+     * Gait parameters for requested under the current decision.
+     */
+    GaitEngine::Params steer(const GaitEngine::Params& requested) const;
+
+    /**
+     * Forget samples and return to FORWARD.
+     */
+    void reset();
+
+private:
+    Action decide(int front_mm, const int* sector_mm, int& heading_deg, int& heading_mm) const;
+    int bestSector(const int* sector_mm) const;
+
+    Config m_config;
+    Decision m_decision = { Action::FORWARD, -1, AVOID_FRONT_DEG, -1 };
+    int m_front_mm = -1;
+    uint64_t m_front_ms = 0;            // When m_front_mm was measured, 0 = never
+    uint64_t m_action_ms = 0;           // When the current action was taken
+};
+
+#endif // OBSTACLE_AVOIDER_H
@@ -0,0 +1,223 @@
+/**
+ * Spider Robot v3.1 - Occupancy Grid Implementation
+ */
+
+#include "occupancy_grid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+static_assert(OCC_TILES * OCC_TILES <= 64, "Tile mask is 64 bits");
+static_assert((OCC_TILES & (OCC_TILES - 1)) == 0 && (OCC_TILE_CELLS & (OCC_TILE_CELLS - 1)) == 0,
+              "Tile and window edges must be powers of two");
+
+static float bearingOf(const OccupancyGrid::Pose& pose, int angle_deg) {
+    return pose.heading_rad + (float)(angle_deg - 90) * (float)M_PI / 180.0f;
+}
+
+// World tile of a cell; cells are never far enough out to overflow
+static int tileOf(int c) {
+    return c >= 0 ? c / OCC_TILE_CELLS : -((-c + OCC_TILE_CELLS - 1) / OCC_TILE_CELLS);
+}
+
+/**
+ * Visit the cells a ray from (x0, y0) to (x1, y1) crosses, in order
+ * (Amanatides-Woo), with the distance at which the ray enters each.
+ * fn(cx, cy, t_mm, last) returns false to stop early.
+ */
+template <typename Fn>
+static void walkRay(float x0, float y0, float x1, float y1, int cx, int cy, int ex, int ey, Fn fn) {
+    const float inf = 1e30f;
+    float dx = x1 - x0;
+    float dy = y1 - y0;
+    float len = std::sqrt(dx * dx + dy * dy);
+    int sx = dx > 0 ? 1 : -1;
+    int sy = dy > 0 ? 1 : -1;
+    float tdx = dx != 0.0f ? OCC_CELL_MM / std::fabs(dx) : inf;
+    float tdy = dy != 0.0f ? OCC_CELL_MM / std::fabs(dy) : inf;
+    float tmx = dx > 0 ? ((cx + 1) * OCC_CELL_MM - x0) / dx : dx < 0 ? (cx * OCC_CELL_MM - x0) / dx : inf;
+    float tmy = dy > 0 ? ((cy + 1) * OCC_CELL_MM - y0) / dy : dy < 0 ? (cy * OCC_CELL_MM - y0) / dy : inf;
+
+    int steps = std::abs(ex - cx) + std::abs(ey - cy);
+    float t = 0.0f;
+    for (int i = 0; i < steps; i++) {
+        if (!fn(cx, cy, t * len, false)) return;
+        if (tmx < tmy) {
+            cx += sx;
+            t = tmx;
+            tmx += tdx;
+        } else {
+            cy += sy;
+            t = tmy;
+            tmy += tdy;
+        }
+    }
+    fn(cx, cy, t * len, true);
+}
+
+OccupancyGrid::OccupancyGrid() {
+    clear();
+}
+
+void OccupancyGrid::clear() {
+    memset(m_tiles, 0, sizeof(m_tiles));
+    m_used = 0;
+    m_placed = false;
+    m_updates = 0;
+}
+
+int OccupancyGrid::cellOf(float mm) {
+    return (int)std::floor(mm / OCC_CELL_MM);
+}
+
+bool OccupancyGrid::inWindow(int cx, int cy) const {
+    int ox = m_origin_tx * OCC_TILE_CELLS;
+    int oy = m_origin_ty * OCC_TILE_CELLS;
+    return cx >= ox && cx < ox + OCC_GRID_CELLS && cy >= oy && cy < oy + OCC_GRID_CELLS;
+}
+
+int8_t* OccupancyGrid::cell(int cx, int cy) {
+    return &m_tiles[slotOf(tileOf(cx), tileOf(cy))][indexOf(cx, cy)];
+}
+
+const int8_t* OccupancyGrid::cell(int cx, int cy) const {
+    return &m_tiles[slotOf(tileOf(cx), tileOf(cy))][indexOf(cx, cy)];
+}
+
+// Keep the robot in the middle two tiles each way; tiles that leave the
+// window hand their slot to the ones that enter
+void OccupancyGrid::recenter(int cx, int cy) {
+    int tx = tileOf(cx) - m_origin_tx;
+    int ty = tileOf(cy) - m_origin_ty;
+    if (m_placed && tx >= OCC_TILES / 2 - 1 && tx <= OCC_TILES / 2 &&
+        ty >= OCC_TILES / 2 - 1 && ty <= OCC_TILES / 2) {
+        return;
+    }
+
+    int nx = tileOf(cx) - OCC_TILES / 2;
+    int ny = tileOf(cy) - OCC_TILES / 2;
+    for (int y = ny; y < ny + OCC_TILES; y++) {
+        for (int x = nx; x < nx + OCC_TILES; x++) {
+            bool kept = m_placed && x >= m_origin_tx && x < m_origin_tx + OCC_TILES &&
+                        y >= m_origin_ty && y < m_origin_ty + OCC_TILES;
+            if (kept) continue;
+            int slot = slotOf(x, y);
+            if (m_used & (1ULL << slot)) {
+                memset(m_tiles[slot], 0, sizeof(m_tiles[slot]));
+                m_used &= ~(1ULL << slot);
+            }
+        }
+    }
+    m_origin_tx = nx;
+    m_origin_ty = ny;
+    m_placed = true;
+}
+
+void OccupancyGrid::addEvidence(int cx, int cy, int delta) {
+    if (!inWindow(cx, cy)) return;
+    int8_t* c = cell(cx, cy);
+    *c = (int8_t)std::max(OCC_LOGODDS_MIN, std::min(OCC_LOGODDS_MAX, *c + delta));
+    m_used |= 1ULL << slotOf(tileOf(cx), tileOf(cy));
+}
+
+void OccupancyGrid::update(const Pose& pose, int angle_deg, int distance_mm, int max_mm) {
+    if (distance_mm < 0) return;
+
+    int cx = cellOf(pose.x_mm);
+    int cy = cellOf(pose.y_mm);
+    recenter(cx, cy);
+
+    bool hit = distance_mm < max_mm;
+    float range = (float)std::min(distance_mm, max_mm);
+    float bearing = bearingOf(pose, angle_deg);
+    float x1 = pose.x_mm + range * std::cos(bearing);
+    float y1 = pose.y_mm + range * std::sin(bearing);
+
+    walkRay(pose.x_mm, pose.y_mm, x1, y1, cx, cy, cellOf(x1), cellOf(y1),
+            [&](int x, int y, float, bool last) {
+        addEvidence(x, y, last && hit ? OCC_LOGODDS_HIT : OCC_LOGODDS_MISS);
+        return true;
+    });
+    m_updates++;
+}
+
+int8_t OccupancyGrid::at(float x_mm, float y_mm) const {
+    int cx = cellOf(x_mm);
+    int cy = cellOf(y_mm);
+    return (m_placed && inWindow(cx, cy)) ? *cell(cx, cy) : 0;
+}
+
+int OccupancyGrid::clearance(const Pose& pose, int angle_deg, int max_mm) const {
+    if (!m_placed) return -1;
+
+    float bearing = bearingOf(pose, angle_deg);
+    float x1 = pose.x_mm + max_mm * std::cos(bearing);
+    float y1 = pose.y_mm + max_mm * std::sin(bearing);
+    int cx = cellOf(pose.x_mm);
+    int cy = cellOf(pose.y_mm);
+
+    int found = -1;
+    bool seen = false;
+    walkRay(pose.x_mm, pose.y_mm, x1, y1, cx, cy, cellOf(x1), cellOf(y1),
+            [&](int x, int y, float t_mm, bool) {
+        if (!inWindow(x, y)) return false;
+        // The robot's own cell says nothing about what is ahead of it
+        if (x == cx && y == cy) return true;
+        int8_t v = *cell(x, y);
+        seen = seen || v != 0;
+        if (v > OCC_OCCUPIED) {
+            found = (int)t_mm;
+            return false;
+        }
+        return true;
+    });
+
+    if (found >= 0) return found;
+    return seen ? max_mm : -1;
+}
+
+void OccupancyGrid::sectorClearance(const Pose& pose, int max_mm, int* sector_mm) const {
+    for (int i = 0; i < SCAN_SECTOR_COUNT; i++) {
+        int start = i * SCAN_SECTOR_DEG;
+        int angles[3] = { start, start + SCAN_SECTOR_DEG / 2, start + SCAN_SECTOR_DEG - 1 };
+        int best = -1;
+        for (int a : angles) {
+            int mm = clearance(pose, std::min(a, 180), max_mm);
+            if (mm >= 0 && (best < 0 || mm < best)) best = mm;
+        }
+        sector_mm[i] = best;
+    }
+}
+
+uint32_t OccupancyGrid::tilesUsed() const {
+    return (uint32_t)__builtin_popcountll(m_used);
+}
+
+size_t OccupancyGrid::snapshot(const Pose& pose, uint8_t* out, uint8_t& tiles) const {
+    WsStreamMap hdr = {};
+    hdr.origin_tx = (int16_t)m_origin_tx;
+    hdr.origin_ty = (int16_t)m_origin_ty;
+    hdr.cell_mm = OCC_CELL_MM;
+    hdr.tile_cells = OCC_TILE_CELLS;
+    hdr.tiles = OCC_TILES;
+    hdr.robot_x_mm = (int32_t)std::lround(pose.x_mm);
+    hdr.robot_y_mm = (int32_t)std::lround(pose.y_mm);
+    hdr.heading_cdeg = (int16_t)std::lround(pose.heading_rad * 18000.0f / (float)M_PI);
+    hdr.occupied = OCC_OCCUPIED;
+
+    size_t len = sizeof(hdr);
+    tiles = 0;
+    for (int ty = 0; m_placed && ty < OCC_TILES; ty++) {
+        for (int tx = 0; tx < OCC_TILES; tx++) {
+            int slot = slotOf(m_origin_tx + tx, m_origin_ty + ty);
+            if (!(m_used & (1ULL << slot))) continue;
+            hdr.tile_mask |= 1ULL << (tx + ty * OCC_TILES);
+            memcpy(out + len, m_tiles[slot], sizeof(m_tiles[slot]));
+            len += sizeof(m_tiles[slot]);
+            tiles++;
+        }
+    }
+    memcpy(out, &hdr, sizeof(hdr));
+    return len;
+}
@@ -0,0 +1,120 @@
+#ifndef OCCUPANCY_GRID_H
+#define OCCUPANCY_GRID_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "scan_controller.h"
+
+extern "C" {
+#include "ws_stream_binary.h"
+}
+
+/**
+ * OccupancyGrid - Rolling local map from range samples and gait odometry
+ *
+ * A square window of OCC_GRID_CELLS cells around the robot in the
+ * odometry frame (GaitEngine::Odometry: x forward, y left at start),
+ * each cell an int8 log-odds of being occupied in OCC_LOGODDS_UNIT
+ * steps. Every sample traces its ray from the robot: cells it crosses
+ * become more likely free, the cell it ends in more likely occupied
+ * (unless the reading was past the sensor's range). Evidence adds up
+ * over sweeps instead of being replaced by the last one.
+ *
+ * Cells are stored in OCC_TILE_CELLS square tiles of contiguous bytes,
+ * and a world tile always lives in storage slot (tx mod OCC_TILES,
+ * ty mod OCC_TILES). Recentering only moves the window origin and
+ * clears the slots of tiles that left it: nothing is copied, and a ray
+ * stays within a few tiles' worth of cache lines.
+ *
+ * Owned by the I/O thread; not thread-safe.
+ */
+#define OCC_CELL_MM         50
+#define OCC_TILE_CELLS      16      // Tile edge in cells (256 bytes)
+#define OCC_TILES           8       // Window edge in tiles, power of two
+#define OCC_GRID_CELLS      (OCC_TILE_CELLS * OCC_TILES)    // 6.4 m across
+#define OCC_LOGODDS_UNIT    0.1f    // Nats per step
+#define OCC_LOGODDS_HIT     17      // p = 0.85 for the cell a ray ends in
+#define OCC_LOGODDS_MISS    (-4)    // p = 0.4 for the cells it crosses
+#define OCC_LOGODDS_MIN     (-50)
+#define OCC_LOGODDS_MAX     80
+#define OCC_OCCUPIED        10      // Above this a cell blocks clearance queries
+#define OCC_SNAPSHOT_MAX    (sizeof(WsStreamMap) + OCC_TILES * OCC_TILES * OCC_TILE_CELLS * OCC_TILE_CELLS)
+
+class OccupancyGrid {
+public:
+    /**
+     * Robot pose in the odometry frame, as GaitEngine::Odometry.
+     */
+    struct Pose {
+        float x_mm = 0.0f;
+        float y_mm = 0.0f;
+        float heading_rad = 0.0f;
+    };
+
+    OccupancyGrid();
+
+    /**
+     * Forget everything; the window recenters on the next update.
+     */
+    void clear();
+
+    /**
+     * Add a sample taken from pose with the sensor at angle_deg (scan
+     * convention: 90 ahead, larger to the left). distance_mm -1 adds
+     * nothing; a reading at or beyond max_mm frees the ray without a hit.
+     * Recenters the window first if the robot has left its middle.
+     */
+    void update(const Pose& pose, int angle_deg, int distance_mm, int max_mm);
+
+    /**
+     * Log-odds of the cell at world position, 0 (unknown) outside the window.
+     */
+    int8_t at(float x_mm, float y_mm) const;
+
+    /**
+     * Distance from pose along angle_deg to the first occupied cell, up
+     * to max_mm. max_mm if the ray crosses only cells seen free or
+     * unknown, -1 if it crosses no observed cell at all.
+     */
+    int clearance(const Pose& pose, int angle_deg, int max_mm) const;
+
+    /**
+     * Closest clearance over each ScanController polar sector (rays at
+     * both edges and the middle), for ObstacleAvoider. -1 where the grid
+     * has no evidence.
+     */
+    void sectorClearance(const Pose& pose, int max_mm, int* sector_mm) const;
+
+    /**
+     * WsStreamMap header plus every tile with evidence (see
+     * ws_stream_binary.h) into out, which must hold OCC_SNAPSHOT_MAX
+     * bytes. Returns the length; tiles is set to the number sent.
+     */
+    size_t snapshot(const Pose& pose, uint8_t* out, uint8_t& tiles) const;
+
+    int originTileX() const { return m_origin_tx; }
+    int originTileY() const { return m_origin_ty; }
+    uint32_t tilesUsed() const;
+    uint32_t updates() const { return m_updates; }
+
+private:
+    static int cellOf(float mm);
+    static int slotOf(int tx, int ty) { return (tx & (OCC_TILES - 1)) + (ty & (OCC_TILES - 1)) * OCC_TILES; }
+    static int indexOf(int cx, int cy) { return (cx & (OCC_TILE_CELLS - 1)) + (cy & (OCC_TILE_CELLS - 1)) * OCC_TILE_CELLS; }
+
+    bool inWindow(int cx, int cy) const;
+    int8_t* cell(int cx, int cy);
+    const int8_t* cell(int cx, int cy) const;
+    void recenter(int cx, int cy);
+    void addEvidence(int cx, int cy, int delta);
+
+    int8_t m_tiles[OCC_TILES * OCC_TILES][OCC_TILE_CELLS * OCC_TILE_CELLS];
+    uint64_t m_used = 0;            // Storage slots holding evidence
+    int m_origin_tx = 0;            // World tile at the window's low corner
+    int m_origin_ty = 0;
+    bool m_placed = false;          // Window positioned since clear()
+    uint32_t m_updates = 0;
+};
+
+#endif // OCCUPANCY_GRID_H
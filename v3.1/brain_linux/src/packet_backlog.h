@@ -0,0 +1,165 @@
+/**
+ * Spider Robot v3.1 - Packet Backlog
+ *
+ * Brain-side overflow for the shared ring. The Muscle hands back ring
+ * credit by advancing read_idx; packets that find no credit wait here,
+ * in seq order, instead of being dropped, and are written first once
+ * credit returns. What happens when a packet arrives depends on the
+ * flow policy:
+ *   DROP      - no backlog: what does not fit is lost (counted)
+ *   QUEUE     - wait in order; the newest is dropped when full
+ *   COALESCE  - as QUEUE, but an immediate pose replaces an immediate
+ *               pose waiting right before it that addresses no group
+ *               it does not (both carry every channel, so the older one
+ *               would be overridden on arrival)
+ *   BLOCK     - the writer waits a bounded time for credit, then queues
+ *   OVERWRITE - the packet goes into the ring anyway, over the oldest
+ *               slot the Muscle has not read (SharedMemory::overwritePackets());
+ *               only behind other waiting packets is it held, as COALESCE
+ * E-STOP packets are never dropped; they push out the oldest entry.
+ * Motion thread only.
+ */
+
+#ifndef PACKET_BACKLOG_H
+#define PACKET_BACKLOG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+extern "C" {
+#include "protocol_posepacket31.h"
+}
+
+enum class FlowPolicy : uint8_t { DROP, QUEUE, COALESCE, BLOCK, OVERWRITE };
+
+template <size_t N>
+class PacketBacklog {
+public:
+    enum class Result { QUEUED, COALESCED, DROPPED, EVICTED };
+
+    /**
+     * Queue one packet behind the others. EVICTED means the oldest entry
+     * made room for an E-STOP packet.
+     */
+    Result push(const PosePacket31& pkt, uint64_t exec_at_us, uint64_t rx_us, FlowPolicy policy) {
+        if (policy == FlowPolicy::DROP && !(pkt.flags & FLAG_ESTOP)) {
+            return Result::DROPPED;
+        }
+
+        bool coalesce = policy == FlowPolicy::COALESCE || policy == FlowPolicy::OVERWRITE;
+        if (coalesce && m_count > 0 && coalescable(pkt, exec_at_us)) {
+            size_t last = m_count - 1;
+            uint8_t groups = posepacket31_groups(pkt.flags);
+            if (coalescable(m_pkts[last], m_exec_at_us[last]) &&
+                (posepacket31_groups(m_pkts[last].flags) & ~groups) == 0) {
+                m_pkts[last] = pkt;
+                m_rx_us[last] = rx_us;
+                return Result::COALESCED;
+            }
+        }
+
+        Result result = Result::QUEUED;
+        if (m_count == N) {
+            if (!(pkt.flags & FLAG_ESTOP)) {
+                return Result::DROPPED;
+            }
+            pop(1);
+            result = Result::EVICTED;
+        }
+        m_pkts[m_count] = pkt;
+        m_exec_at_us[m_count] = exec_at_us;
+        m_rx_us[m_count] = rx_us;
+        m_count++;
+        if (m_count > m_high_water) m_high_water = m_count;
+        return result;
+    }
+
+    /**
+     * Remove the n oldest entries (those just written to the ring).
+     */
+    void pop(size_t n) {
+        if (n >= m_count) {
+            m_count = 0;
+            return;
+        }
+        m_count -= n;
+        memmove(m_pkts, m_pkts + n, m_count * sizeof(m_pkts[0]));
+        memmove(m_exec_at_us, m_exec_at_us + n, m_count * sizeof(m_exec_at_us[0]));
+        memmove(m_rx_us, m_rx_us + n, m_count * sizeof(m_rx_us[0]));
+    }
+
+    /**
+     * Drop everything but E-STOP packets (E-STOP latched: nothing else
+     * may be applied). Returns the number dropped.
+     */
+    size_t retainEstop() {
+        size_t kept = 0;
+        for (size_t i = 0; i < m_count; i++) {
+            if (m_pkts[i].flags & FLAG_ESTOP) {
+                m_pkts[kept] = m_pkts[i];
+                m_exec_at_us[kept] = m_exec_at_us[i];
+                m_rx_us[kept] = m_rx_us[i];
+                kept++;
+            }
+        }
+        size_t dropped = m_count - kept;
+        m_count = kept;
+        return dropped;
+    }
+
+    void clear() { m_count = 0; }
+
+    // Oldest first, laid out for SharedMemory::writePackets()
+    const PosePacket31* packets() const { return m_pkts; }
+    const uint64_t* execAt() const { return m_exec_at_us; }
+    const uint64_t* rxUs() const { return m_rx_us; }
+
+    size_t size() const { return m_count; }
+    bool empty() const { return m_count == 0; }
+    size_t highWater() const { return m_high_water; }
+    static constexpr size_t capacity() { return N; }
+
+private:
+    static bool coalescable(const PosePacket31& pkt, uint64_t exec_at_us) {
+        return exec_at_us == 0 && !(pkt.flags & (FLAG_ESTOP | FLAG_HOLD));
+    }
+
+    PosePacket31 m_pkts[N];
+    uint64_t m_exec_at_us[N];
+    uint64_t m_rx_us[N];
+    size_t m_count = 0;
+    size_t m_high_water = 0;
+};
+
+/**
+ * Policy name for logs and status (lowercase, as accepted on the command line).
+ */
+inline const char* flowPolicyName(FlowPolicy policy) {
+    switch (policy) {
+        case FlowPolicy::DROP:      return "drop";
+        case FlowPolicy::QUEUE:     return "queue";
+        case FlowPolicy::COALESCE:  return "coalesce";
+        case FlowPolicy::BLOCK:     return "block";
+        case FlowPolicy::OVERWRITE: return "overwrite";
+    }
+    return "unknown";
+}
+
+/**
+ * Parse a policy name. Returns false and leaves out alone if unknown.
+ */
+inline bool parseFlowPolicy(const char* name, FlowPolicy& out) {
+    static const FlowPolicy all[] = {
+        FlowPolicy::DROP, FlowPolicy::QUEUE, FlowPolicy::COALESCE, FlowPolicy::BLOCK, FlowPolicy::OVERWRITE
+    };
+    for (FlowPolicy p : all) {
+        if (strcmp(name, flowPolicyName(p)) == 0) {
+            out = p;
+            return true;
+        }
+    }
+    return false;
+}
+
+#endif // PACKET_BACKLOG_H
@@ -0,0 +1,240 @@
+/**
+ * Spider Robot v3.1 - Sampling Profiler Implementation
+ */
+
+#include "profiler.h"
+#include "logger.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <map>
+#include <sched.h>
+#include <string>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <unwind.h>
+
+static const char* TAG = "Profiler";
+
+static std::atomic<SamplingProfiler*> s_active{nullptr};
+static std::atomic<int> s_in_handler{0};   // Raised before s_active is read
+
+struct UnwindState {
+    uintptr_t* pc;
+    uint32_t depth;
+    bool found;                 // Past the handler's own frames
+};
+
+static _Unwind_Reason_Code unwind_frame(struct _Unwind_Context* ctx, void* arg) {
+    UnwindState* s = (UnwindState*)arg;
+    int before_insn = 0;
+    uintptr_t ip = _Unwind_GetIPInfo(ctx, &before_insn);
+    if (!s->found) {
+        // The unwinder marks the frame the signal interrupted: its pc is
+        // exact, not a return address. Everything before it is ours
+        if (!before_insn) return _URC_NO_REASON;
+        s->found = true;
+    }
+    if (ip == 0) return _URC_END_OF_STACK;     // Past the outermost frame
+    s->pc[s->depth++] = ip;
+    return s->depth < PROFILE_MAX_DEPTH ? _URC_NO_REASON : _URC_END_OF_STACK;
+}
+
+void SamplingProfiler::onSignal(int, siginfo_t*, void*) {
+    s_in_handler.fetch_add(1);
+    SamplingProfiler* p = s_active.load();
+    if (!p) {
+        s_in_handler.fetch_sub(1);
+        return;
+    }
+    int saved_errno = errno;
+
+    uint32_t slot = p->m_next.fetch_add(1, std::memory_order_relaxed);
+    if (slot < p->m_samples.size()) {
+        Sample& sample = p->m_samples[slot];
+        UnwindState state = { sample.pc, 0, false };
+        _Unwind_Backtrace(unwind_frame, &state);
+        sample.tid = (int32_t)syscall(SYS_gettid);
+        sample.depth = state.depth;
+    } else {
+        p->m_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    errno = saved_errno;
+    s_in_handler.fetch_sub(1);
+}
+
+SamplingProfiler::~SamplingProfiler() {
+    if (m_running) {
+        stop();
+    }
+}
+
+static _Unwind_Reason_Code unwind_nothing(struct _Unwind_Context*, void*) {
+    return _URC_END_OF_STACK;
+}
+
+bool SamplingProfiler::start(uint32_t hz) {
+    if (m_running || hz == 0 || hz > PROFILE_MAX_HZ) {
+        return false;
+    }
+    SamplingProfiler* expected = nullptr;
+    if (!s_active.compare_exchange_strong(expected, this)) {
+        LOG_WARN(TAG, "Another profiler is running");
+        return false;
+    }
+
+    m_samples.resize(PROFILE_MAX_SAMPLES);
+    m_next.store(0, std::memory_order_relaxed);
+    m_dropped.store(0, std::memory_order_relaxed);
+
+    // The unwinder sets itself up on first use, which must not happen in the handler
+    _Unwind_Backtrace(unwind_nothing, nullptr);
+
+    struct sigaction sa = {};
+    sa.sa_sigaction = onSignal;
+    sa.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    if (sigaction(SIGPROF, &sa, &m_old_action) < 0) {
+        LOG_ERROR(TAG, "sigaction(SIGPROF) failed: %s", strerror(errno));
+        s_active.store(nullptr, std::memory_order_release);
+        return false;
+    }
+
+    struct itimerval it = {};
+    it.it_interval.tv_usec = 1000000 / hz;
+    it.it_value = it.it_interval;
+    if (setitimer(ITIMER_PROF, &it, nullptr) < 0) {
+        LOG_ERROR(TAG, "setitimer(ITIMER_PROF) failed: %s", strerror(errno));
+        sigaction(SIGPROF, &m_old_action, nullptr);
+        s_active.store(nullptr, std::memory_order_release);
+        return false;
+    }
+
+    m_running = true;
+    LOG_INFO(TAG, "Sampling at %u Hz", hz);
+    return true;
+}
+
+size_t SamplingProfiler::stop() {
+    if (!m_running) {
+        return samples();
+    }
+
+    struct itimerval it = {};
+    setitimer(ITIMER_PROF, &it, nullptr);
+    s_active.store(nullptr);
+    // A SIGPROF already delivered to another thread may still be unwinding
+    while (s_in_handler.load() > 0) {
+        sched_yield();
+    }
+    sigaction(SIGPROF, &m_old_action, nullptr);
+
+    m_running = false;
+    LOG_INFO(TAG, "Stopped: %zu samples, %u dropped", samples(), dropped());
+    return samples();
+}
+
+size_t SamplingProfiler::samples() const {
+    size_t n = m_next.load(std::memory_order_relaxed);
+    return n < m_samples.size() ? n : m_samples.size();
+}
+
+void SamplingProfiler::reset() {
+    if (m_running) return;
+    std::vector<Sample>().swap(m_samples);
+    m_next.store(0, std::memory_order_relaxed);
+}
+
+// Thread name from /proc, so the motion thread and the event loop get separate roots
+static std::string thread_name(int32_t tid) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/self/task/%d/comm", tid);
+    char name[32] = {};
+    FILE* f = fopen(path, "r");
+    if (f) {
+        if (fgets(name, sizeof(name), f)) {
+            name[strcspn(name, "\n")] = '\0';
+        }
+        fclose(f);
+    }
+    if (name[0] == '\0') {
+        snprintf(name, sizeof(name), "tid-%d", tid);
+    }
+    return name;
+}
+
+// A return address is looked up one byte back, inside its call instruction
+static std::string frame_name(uintptr_t pc) {
+    Dl_info info = {};
+    if (!dladdr((void*)pc, &info)) {
+        info = Dl_info();
+    }
+    if (info.dli_sname) {
+        int status = -1;
+        char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+        std::string name = (status == 0 && demangled) ? demangled : info.dli_sname;
+        free(demangled);
+        return name;
+    }
+
+    char buf[96];
+    if (info.dli_fname && info.dli_fname[0]) {
+        const char* base = strrchr(info.dli_fname, '/');
+        snprintf(buf, sizeof(buf), "%s+0x%lx", base ? base + 1 : info.dli_fname,
+                 (unsigned long)(pc - (uintptr_t)info.dli_fbase));
+    } else {
+        snprintf(buf, sizeof(buf), "0x%lx", (unsigned long)pc);
+    }
+    return buf;
+}
+
+bool SamplingProfiler::writeFolded(const char* path, size_t* stacks) const {
+    std::unordered_map<int32_t, std::string> threads;
+    std::unordered_map<uintptr_t, std::string> names;
+    std::map<std::string, uint32_t> folded;
+
+    size_t n = samples();
+    for (size_t i = 0; i < n; i++) {
+        const Sample& s = m_samples[i];
+        auto t = threads.find(s.tid);
+        if (t == threads.end()) {
+            t = threads.emplace(s.tid, thread_name(s.tid)).first;
+        }
+        std::string line = t->second;
+        if (s.depth == 0) {
+            line += ";[unknown]";
+        }
+        for (uint32_t d = s.depth; d-- > 0; ) {
+            uintptr_t pc = d > 0 ? s.pc[d] - 1 : s.pc[d];
+            auto it = names.find(pc);
+            if (it == names.end()) {
+                it = names.emplace(pc, frame_name(pc)).first;
+            }
+            line += ';';
+            line += it->second;
+        }
+        folded[line]++;
+    }
+
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        LOG_ERROR(TAG, "Cannot write %s: %s", path, strerror(errno));
+        return false;
+    }
+    for (const auto& entry : folded) {
+        fprintf(f, "%s %u\n", entry.first.c_str(), entry.second);
+    }
+    bool ok = fclose(f) == 0;
+    if (stacks) {
+        *stacks = folded.size();
+    }
+    LOG_INFO(TAG, "Wrote %zu samples as %zu stacks to %s", n, folded.size(), path);
+    return ok;
+}
@@ -0,0 +1,128 @@
+/**
+ * Spider Robot v3.1 - CPU Accounting and Sampling Profiler
+ *
+ * Two tools for finding where the daemon's CPU goes without perf on the
+ * robot:
+ *
+ * CpuCost / CpuScope: always-on counters. A scope adds its wall time and
+ * the heap allocations its thread made to a CpuCost. The event loop never
+ * blocks inside a handler, so wall time is the handler's CPU time unless
+ * the thread was preempted. Two clock reads per scope.
+ *
+ * SamplingProfiler: on demand. ITIMER_PROF sends SIGPROF every 1/hz
+ * seconds of process CPU time to whichever thread is running; the handler
+ * unwinds that thread's stack into a preallocated buffer. stop() disarms
+ * it and writeFolded() turns the samples into folded stacks, one
+ * "thread;outer;...;inner count" line per distinct stack, ready for
+ * flamegraph.pl. Frames without a dynamic symbol (everything in a
+ * stripped daemon) are written as "module+0xoffset" for
+ * bench/symbolize_folded.py to resolve against the unstripped build.
+ *
+ * Unwinding uses the compiler's unwind tables (_Unwind_Backtrace), so
+ * the daemon is built with -fasynchronous-unwind-tables. One profiler
+ * per process.
+ */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "alloc_counter.h"
+
+extern "C" {
+#include "timebase.h"
+}
+
+#define PROFILE_DEFAULT_HZ      99          // Off the 100 Hz of periodic work
+#define PROFILE_MAX_HZ          1000
+#define PROFILE_MAX_SECONDS     60
+#define PROFILE_MAX_SAMPLES     8192        // Later ones are counted as dropped
+#define PROFILE_MAX_DEPTH       32
+
+struct CpuCost {
+    uint64_t calls = 0;
+    uint64_t total_us = 0;
+    uint64_t max_us = 0;
+    uint64_t allocs = 0;
+
+    void add(uint64_t us, uint64_t new_allocs) {
+        calls++;
+        total_us += us;
+        if (us > max_us) max_us = us;
+        allocs += new_allocs;
+    }
+};
+
+class CpuScope {
+public:
+    explicit CpuScope(CpuCost& cost)
+        : m_cost(cost), m_start_us(timebase_micros()), m_allocs(alloc_count_thread()) {}
+    ~CpuScope() { m_cost.add(timebase_micros() - m_start_us, alloc_count_thread() - m_allocs); }
+
+    CpuScope(const CpuScope&) = delete;
+    CpuScope& operator=(const CpuScope&) = delete;
+
+private:
+    CpuCost& m_cost;
+    uint64_t m_start_us;
+    uint64_t m_allocs;
+};
+
+class SamplingProfiler {
+public:
+    SamplingProfiler() = default;
+    ~SamplingProfiler();
+
+    SamplingProfiler(const SamplingProfiler&) = delete;
+    SamplingProfiler& operator=(const SamplingProfiler&) = delete;
+
+    /**
+     * Allocate the sample buffer and start sampling at hz.
+     * @return false if already running or the timer could not be set up
+     */
+    bool start(uint32_t hz);
+
+    /**
+     * Stop sampling. Samples stay until reset() or the next start().
+     * @return samples taken
+     */
+    size_t stop();
+
+    bool running() const { return m_running; }
+    size_t samples() const;
+    uint32_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    /**
+     * Free the sample buffer (about 2 MB) once the samples are written.
+     */
+    void reset();
+
+    /**
+     * Write the samples as folded stacks.
+     * @param stacks distinct stacks written, if not null
+     * @return false if the file could not be written
+     */
+    bool writeFolded(const char* path, size_t* stacks = nullptr) const;
+
+private:
+    struct Sample {
+        int32_t tid;
+        uint32_t depth;
+        uintptr_t pc[PROFILE_MAX_DEPTH];    // Innermost first
+    };
+
+    static void onSignal(int sig, siginfo_t* info, void* ucontext);
+
+    std::vector<Sample> m_samples;
+    std::atomic<uint32_t> m_next{0};        // Slots claimed, may pass the end
+    std::atomic<uint32_t> m_dropped{0};
+    struct sigaction m_old_action = {};
+    bool m_running = false;
+};
+
+#endif // PROFILER_H
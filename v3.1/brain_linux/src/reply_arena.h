@@ -0,0 +1,208 @@
+/**
+ * Spider Robot v3.1 - Reply Arena and JSON Writer
+ *
+ * Command replies whose size depends on the robot (motion lists, scan
+ * data) are formatted by a JsonWriter straight into a ReplyArena: a
+ * fixed bump buffer the event loop rewinds after every iteration. The
+ * writer keeps WS_FRAME_HEADER_MAX bytes free in front of the payload,
+ * so frame() turns the reply into a complete WebSocket frame in place
+ * and the send path hands one contiguous buffer to sendmsg() - nothing
+ * touches the heap unless a client's socket is full.
+ *
+ * One writer may be open at a time; a second gets no room and reports
+ * !ok(). Owned by the I/O thread; not thread-safe.
+ */
+
+#ifndef REPLY_ARENA_H
+#define REPLY_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+
+#include "ws_frame.h"
+
+#define REPLY_ARENA_BYTES   (64 * 1024)
+
+class ReplyArena {
+public:
+    /**
+     * Rewind; everything handed out since the last reset() is gone.
+     */
+    void reset() {
+        if (m_used > m_high_water) m_high_water = m_used;
+        m_used = 0;
+    }
+
+    size_t used() const { return m_used; }
+    size_t highWater() const { return m_used > m_high_water ? m_used : m_high_water; }
+    uint32_t overflows() const { return m_overflows; }
+
+private:
+    friend class JsonWriter;
+
+    char m_buf[REPLY_ARENA_BYTES];
+    size_t m_used = 0;
+    size_t m_high_water = 0;
+    uint32_t m_overflows = 0;
+    bool m_open = false;            // A JsonWriter holds the free space
+};
+
+class JsonWriter {
+public:
+    explicit JsonWriter(ReplyArena& arena) : m_arena(arena) {
+        size_t avail = sizeof(arena.m_buf) - arena.m_used;
+        if (!arena.m_open && avail > WS_FRAME_HEADER_MAX) {
+            arena.m_open = true;
+            m_owner = true;
+            m_buf = arena.m_buf + arena.m_used + WS_FRAME_HEADER_MAX;
+            m_cap = avail - WS_FRAME_HEADER_MAX;
+        } else {
+            fail();
+        }
+    }
+
+    ~JsonWriter() {
+        if (m_owner) {
+            m_arena.m_used += WS_FRAME_HEADER_MAX + m_len;
+            m_arena.m_open = false;
+        }
+    }
+
+    JsonWriter(const JsonWriter&) = delete;
+    JsonWriter& operator=(const JsonWriter&) = delete;
+
+    JsonWriter& beginObject(const char* key = nullptr) { open(key, '{'); return *this; }
+    JsonWriter& endObject() { close('}'); return *this; }
+    JsonWriter& beginArray(const char* key = nullptr) { open(key, '['); return *this; }
+    JsonWriter& endArray() { close(']'); return *this; }
+
+    /**
+     * "key":value in an object; value() is the same for array elements.
+     * Strings are escaped, doubles get a fixed number of decimals.
+     */
+    JsonWriter& field(const char* key, const char* v) { member(key); string(v); return *this; }
+    JsonWriter& field(const char* key, double v, int decimals) { member(key); real(v, decimals); return *this; }
+    template <typename T, typename = std::enable_if_t<std::is_integral<T>::value>>
+    JsonWriter& field(const char* key, T v) { member(key); integer(v); return *this; }
+
+    JsonWriter& value(const char* v) { member(nullptr); string(v); return *this; }
+    JsonWriter& value(double v, int decimals) { member(nullptr); real(v, decimals); return *this; }
+    template <typename T, typename = std::enable_if_t<std::is_integral<T>::value>>
+    JsonWriter& value(T v) { member(nullptr); integer(v); return *this; }
+
+    /**
+     * False once anything did not fit; the reply is then incomplete.
+     */
+    bool ok() const { return !m_overflow; }
+    const char* data() const { return m_buf; }
+    size_t size() const { return m_len; }
+
+    /**
+     * Put the frame header in the room kept in front of the payload.
+     * Only for a writer that is ok().
+     * @return start of the frame; len gets header plus payload
+     */
+    const uint8_t* frame(size_t& len, uint8_t opcode = 0x01) {
+        uint8_t hdr[WS_FRAME_HEADER_MAX];
+        size_t hlen = ws_frame_header(hdr, opcode, m_len);
+        uint8_t* start = (uint8_t*)m_buf - hlen;
+        memcpy(start, hdr, hlen);
+        len = hlen + m_len;
+        return start;
+    }
+
+private:
+    void fail() {
+        if (!m_overflow) m_arena.m_overflows++;
+        m_overflow = true;
+    }
+
+    void put(const char* s, size_t n) {
+        if (m_overflow || m_cap - m_len < n) {
+            fail();
+            return;
+        }
+        memcpy(m_buf + m_len, s, n);
+        m_len += n;
+    }
+
+    void put(char c) { put(&c, 1); }
+
+    void member(const char* key) {
+        if (m_need_comma) put(',');
+        if (key) {
+            string(key);
+            put(':');
+        }
+        m_need_comma = true;
+    }
+
+    void open(const char* key, char c) {
+        member(key);
+        put(c);
+        m_need_comma = false;
+    }
+
+    void close(char c) {
+        put(c);
+        m_need_comma = true;
+    }
+
+    void string(const char* s) {
+        put('"');
+        for (const char* run = s; ; s++) {
+            unsigned char c = (unsigned char)*s;
+            if (c != 0 && c != '"' && c != '\\' && c >= 0x20) continue;
+            put(run, (size_t)(s - run));
+            if (c == 0) break;
+            char esc[8];
+            int n = (c == '"' || c == '\\') ? snprintf(esc, sizeof(esc), "\\%c", c)
+                                           : snprintf(esc, sizeof(esc), "\\u%04x", c);
+            put(esc, (size_t)n);
+            run = s + 1;
+        }
+        put('"');
+    }
+
+    template <typename T>
+    void integer(T v) {
+        if (std::is_same<T, bool>::value) {
+            v ? put("true", 4) : put("false", 5);
+            return;
+        }
+        char tmp[24];
+        char* p = tmp + sizeof(tmp);
+        bool neg = std::is_signed<T>::value && (long long)v < 0;
+        // Unsigned magnitude, so the most negative value does not overflow
+        unsigned long long u = neg ? 0ULL - (unsigned long long)v : (unsigned long long)v;
+        do {
+            *--p = (char)('0' + u % 10);
+            u /= 10;
+        } while (u);
+        if (neg) *--p = '-';
+        put(p, (size_t)(tmp + sizeof(tmp) - p));
+    }
+
+    void real(double v, int decimals) {
+        char tmp[32];
+        int n = snprintf(tmp, sizeof(tmp), "%.*f", decimals, v);
+        if (n < 0 || n >= (int)sizeof(tmp)) {
+            fail();
+            return;
+        }
+        put(tmp, (size_t)n);
+    }
+
+    ReplyArena& m_arena;
+    bool m_owner = false;
+    char* m_buf = nullptr;
+    size_t m_cap = 0;
+    size_t m_len = 0;
+    bool m_need_comma = false;
+    bool m_overflow = false;
+};
+
+#endif // REPLY_ARENA_H
@@ -0,0 +1,248 @@
+/**
+ * Spider Robot v3.1 - Robot Topology
+ *
+ * RobotModel<Legs, JointsPerLeg> describes a legged robot at compile
+ * time: which output channel drives each joint, the joint names accepted
+ * by the servo commands, per-channel pulse limits, the IK geometry and
+ * the packet the pose needs. Gait, IK and packet building take their
+ * loop bounds and channel numbers from it, so they compile down to
+ * constant trip counts and indices for the configured robot, and a
+ * variant is a different instantiation rather than a runtime table.
+ *
+ * Channel layout (the v3.1 wiring, generalised):
+ *   0 .. 2*Legs-1           coxa, femur of leg i on 2i, 2i+1
+ *   2*Legs .. joints-1      joint j >= 2 of leg i on 2*Legs + (j-2)*Legs + i
+ *   joints                  scan servo
+ *
+ * Legs come in right/left pairs from the front: even legs on the right,
+ * odd on the left, as in gait_engine.h.
+ */
+
+#ifndef ROBOT_MODEL_H
+#define ROBOT_MODEL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "json_tokenizer.h"
+
+extern "C" {
+#include "limits.h"
+#include "protocol_posepacketn.h"
+}
+
+// Smallest table with at least four buckets per name
+constexpr int robot_hash_bits(int names) {
+    int bits = 1;
+    while ((1 << bits) < 4 * names) bits++;
+    return bits;
+}
+
+template <int Legs, int JointsPerLeg>
+class RobotModel {
+public:
+    static_assert(Legs >= 4 && Legs <= 10 && Legs % 2 == 0, "Front and rear pairs, at most 10 legs");
+    static_assert(JointsPerLeg >= 2 && JointsPerLeg <= 4, "2 to 4 joints per leg");
+
+    enum Joint { COXA = 0, FEMUR = 1, TIBIA = 2, TARSUS = 3 };
+
+    static constexpr int LEGS = Legs;
+    static constexpr int JOINTS_PER_LEG = JointsPerLeg;
+    static constexpr int PAIR_CHANNELS = Legs * 2;              // Coxa and femur of every leg
+    static constexpr int JOINT_CHANNELS = Legs * JointsPerLeg;
+    static constexpr int SCAN_CHANNEL = JOINT_CHANNELS;
+    static constexpr int CHANNEL_COUNT = JOINT_CHANNELS + 1;
+
+    static_assert(CHANNEL_COUNT <= SERVO_CHANNEL_MAX, "More channels than a Muscle can drive");
+
+    static constexpr int channel(int leg, int joint) {
+        return joint < 2 ? leg * 2 + joint : PAIR_CHANNELS + (joint - 2) * Legs + leg;
+    }
+
+    static constexpr bool isLeft(int leg) { return leg % 2 != 0; }
+
+    static constexpr uint32_t legMask(int leg) {
+        uint32_t mask = 0;
+        for (int j = 0; j < JointsPerLeg; j++) mask |= 1u << channel(leg, j);
+        return mask;
+    }
+
+    static constexpr uint32_t PAIR_MASK = (1u << PAIR_CHANNELS) - 1;
+    static constexpr uint32_t JOINT_MASK = (1u << JOINT_CHANNELS) - 1;
+    static constexpr uint32_t SCAN_MASK = 1u << SCAN_CHANNEL;
+
+    // ---- Packet layout ----
+
+    // Past the 13 channels of PosePacket31 a pose goes out as PosePacketN
+    static constexpr bool WIDE_PACKETS = CHANNEL_COUNT > SERVO_COUNT_TOTAL;
+    static constexpr size_t PACKET_BYTES = WIDE_PACKETS
+        ? POSEPACKETN_HEADER_SIZE + 2 * CHANNEL_COUNT + 2
+        : sizeof(PosePacket31);
+    static constexpr uint32_t SLOT_SIZE = CHANNEL_COUNT <= POSEPACKETN_SLOT64_CHANNELS ? 64 : 128;
+
+    // ---- Limits ----
+
+    struct Limits {
+        uint16_t min_us;
+        uint16_t max_us;
+    };
+
+    /**
+     * Joints stay within the SERVO_ANGLE soft limits, rounded inward to
+     * whole microseconds; the scan servo may use the full PWM range.
+     */
+    static constexpr Limits limits(int ch) {
+        constexpr int span = SERVO_PWM_MAX_US - SERVO_PWM_MIN_US;
+        return ch < JOINT_CHANNELS
+            ? Limits{ (uint16_t)(SERVO_PWM_MIN_US + (SERVO_ANGLE_MIN_DEG * span + 179) / 180),
+                      (uint16_t)(SERVO_PWM_MIN_US + SERVO_ANGLE_MAX_DEG * span / 180) }
+            : Limits{ SERVO_PWM_MIN_US, SERVO_PWM_MAX_US };
+    }
+
+    // ---- IK geometry (mm, body frame: x forward, y left) ----
+
+    static constexpr float COXA_MM = 30.0f;
+    static constexpr float FEMUR_MM = 55.0f;
+    static constexpr float TIBIA_MM = 75.0f;
+    static constexpr float HIP_X_MM = 40.0f;     // Front and rear hips at +-x
+    static constexpr float HIP_Y_MM = 40.0f;     // Every hip at +-y
+
+    struct Hip {
+        float x;
+        float y;
+        float angle;                             // Coxa heading at neutral, radians
+    };
+
+    /**
+     * Pairs spread evenly from the front hips to the rear ones, headings
+     * fanning from 45 to 135 degrees off forward on each side.
+     */
+    static constexpr Hip hip(int leg) {
+        constexpr int pairs = Legs / 2;
+        constexpr float quarter_pi = 0.785398163397448f;
+        int pair = leg / 2;
+        float t = (float)pair / (float)(pairs - 1);          // 0 front .. 1 rear
+        float side = isLeft(leg) ? 1.0f : -1.0f;
+        return Hip{ HIP_X_MM * (1.0f - 2.0f * t), side * HIP_Y_MM, side * quarter_pi * (1.0f + 2.0f * t) };
+    }
+
+    // ---- Joint names ----
+
+    static constexpr size_t NAME_LEN = 16;
+    static constexpr int ALIAS_COUNT = JOINT_CHANNELS - PAIR_CHANNELS;   // "auxN", the v3.1 names
+    static constexpr int NAME_COUNT = JOINT_CHANNELS + ALIAS_COUNT + 1;
+
+    struct NameEntry {
+        char name[NAME_LEN];
+        uint8_t len;
+        uint8_t channel;
+    };
+
+    struct NameTable {
+        NameEntry entries[NAME_COUNT];
+    };
+
+    /**
+     * "leg<i>_coxa" / "_femur" / "_tibia" / "_tarsus" for every joint,
+     * "aux<k>" for the channels past the coxa/femur block and "scan".
+     */
+    static const NameTable NAMES;
+
+    // Perfect hash over NAMES: distinct buckets for every name, found at compile time
+    static constexpr int HASH_BITS = robot_hash_bits(NAME_COUNT);
+    static constexpr int HASH_SIZE = 1 << HASH_BITS;
+
+    struct HashTable {
+        uint32_t seed;
+        int8_t entry[HASH_SIZE];                 // NAMES index, -1 if empty
+    };
+
+    static const HashTable HASH;
+
+    /**
+     * Channel driving the named joint, or -1. One hash, one compare.
+     */
+    static int channelOf(const char* name) {
+        size_t len = strlen(name);
+        if (len >= NAME_LEN) return -1;
+        int i = HASH.entry[bucket(json_hash(name, len), HASH.seed)];
+        if (i < 0) return -1;
+        const NameEntry& e = NAMES.entries[i];
+        return (e.len == len && memcmp(e.name, name, len) == 0) ? e.channel : -1;
+    }
+
+private:
+    static constexpr uint32_t bucket(uint32_t hash, uint32_t seed) {
+        return (hash * seed) >> (32 - HASH_BITS);
+    }
+
+    static constexpr void append(NameEntry& e, const char* s) {
+        while (*s) e.name[e.len++] = *s++;
+    }
+
+    static constexpr void appendNum(NameEntry& e, int n) {
+        if (n >= 10) e.name[e.len++] = (char)('0' + n / 10);
+        e.name[e.len++] = (char)('0' + n % 10);
+    }
+
+    static constexpr NameTable buildNames() {
+        const char* joints[4] = { "_coxa", "_femur", "_tibia", "_tarsus" };
+        NameTable t{};
+        int n = 0;
+        for (int leg = 0; leg < Legs; leg++) {
+            for (int j = 0; j < JointsPerLeg; j++) {
+                NameEntry& e = t.entries[n++];
+                append(e, "leg");
+                appendNum(e, leg);
+                append(e, joints[j]);
+                e.channel = (uint8_t)channel(leg, j);
+            }
+        }
+        for (int k = 0; k < ALIAS_COUNT; k++) {
+            NameEntry& e = t.entries[n++];
+            append(e, "aux");
+            appendNum(e, k);
+            e.channel = (uint8_t)(PAIR_CHANNELS + k);
+        }
+        NameEntry& scan = t.entries[n];
+        append(scan, "scan");
+        scan.channel = (uint8_t)SCAN_CHANNEL;
+        return t;
+    }
+
+    static constexpr HashTable buildHash() {
+        for (uint32_t seed = 0x9E3779B1u;; seed += 2) {
+            HashTable t{};
+            t.seed = seed;
+            for (int b = 0; b < HASH_SIZE; b++) t.entry[b] = -1;
+
+            bool clash = false;
+            for (int i = 0; i < NAME_COUNT && !clash; i++) {
+                const NameEntry& e = NAMES.entries[i];
+                uint32_t b = bucket(json_hash(e.name, e.len), seed);
+                clash = t.entry[b] >= 0;
+                t.entry[b] = (int8_t)i;
+            }
+            if (!clash) return t;
+        }
+    }
+};
+
+template <int Legs, int JointsPerLeg>
+constexpr typename RobotModel<Legs, JointsPerLeg>::NameTable RobotModel<Legs, JointsPerLeg>::NAMES =
+    RobotModel<Legs, JointsPerLeg>::buildNames();
+
+template <int Legs, int JointsPerLeg>
+constexpr typename RobotModel<Legs, JointsPerLeg>::HashTable RobotModel<Legs, JointsPerLeg>::HASH =
+    RobotModel<Legs, JointsPerLeg>::buildHash();
+
+// The robot this tree drives: four legs of coxa, femur and tibia
+using SpiderModel = RobotModel<4, 3>;
+
+static_assert(SpiderModel::CHANNEL_COUNT == SERVO_COUNT_TOTAL, "Model and limits.h disagree");
+static_assert(SpiderModel::SCAN_CHANNEL == SERVO_CHANNEL_SCAN, "Model and limits.h disagree");
+static_assert(SpiderModel::PAIR_CHANNELS == SERVO_COUNT_LEGS, "Model and limits.h disagree");
+static_assert(!SpiderModel::WIDE_PACKETS, "The spider fits PosePacket31");
+
+#endif // ROBOT_MODEL_H
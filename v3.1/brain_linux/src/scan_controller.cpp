@@ -8,133 +8,349 @@
 #include "scan_controller.h"
 #include "logger.h"
 
-#include <ctime>
 #include <algorithm>
 #include <cmath>
 
 extern "C" {
 #include "limits.h"
+#include "timebase.h"
 }
 
 static const char* TAG = "Scan";
 
+// Adaptive window: closes to cone_min_deg at full dir and this cycle rate
+// (GAIT_SPEED_MAX), and swings this far off centre at full turn
+static const float HINT_SPEED_FULL = 2.0f;
+static const float HINT_TURN_DEG = 45.0f;
+
 uint64_t ScanController::now_ms() {
-    struct timespec ts;
-    clock_gettime(CLOCK_MONOTONIC, &ts);
-    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+    return timebase_millis64();
 }
 
 ScanController::ScanController() {
     // Default profile: 20° to 160° in 10° steps at 5Hz
+    layoutSlots();
+}
+
+void ScanController::setProfile(const ScanProfile& profile) {
+    m_profile = profile;
+
+    // Keep the slot index math and the step period well defined
+    m_profile.min_deg = std::max(0, std::min(m_profile.min_deg, 180));
+    m_profile.max_deg = std::max(m_profile.min_deg, std::min(m_profile.max_deg, 180));
+    m_profile.step_deg = std::max(1, m_profile.step_deg);
+    m_profile.rate_hz = std::max(0, m_profile.rate_hz);
+    m_profile.servo_deg_per_s = std::max(1, m_profile.servo_deg_per_s);
+    m_profile.dwell_ms = std::max(0, m_profile.dwell_ms);
+    m_profile.cone_min_deg = std::max(0, m_profile.cone_min_deg);
+    m_profile.fresh_ms = std::max(0, m_profile.fresh_ms);
+
+    if (m_profile.min_deg != m_slot_min_deg || m_profile.max_deg != m_slot_max_deg ||
+        m_profile.step_deg != m_slot_step_deg) {
+        layoutSlots();
+    }
+}
+
+void ScanController::layoutSlots() {
+    m_slot_min_deg = m_profile.min_deg;
+    m_slot_max_deg = m_profile.max_deg;
+    m_slot_step_deg = m_profile.step_deg;
+
+    // A max_deg off the step grid gets a slot of its own (the sweep
+    // clamps to it)
+    m_slot_count = (size_t)((m_slot_max_deg - m_slot_min_deg + m_slot_step_deg - 1) / m_slot_step_deg) + 1;
+    for (size_t i = 0; i < m_slot_count; i++) {
+        int angle = m_slot_min_deg + (int)i * m_slot_step_deg;
+        m_points[i].angle_deg = std::min(angle, m_slot_max_deg);
+    }
+    m_window_lo = 0;
+    m_window_hi = m_slot_count - 1;
+    clearScanData();
+}
+
+void ScanController::clearScanData() {
+    for (size_t i = 0; i < m_slot_count; i++) {
+        m_points[i].distance_mm = -1;
+        m_points[i].timestamp_ms = 0;
+    }
+    m_point_count = 0;
+
+    for (size_t i = 0; i < SCAN_SECTOR_COUNT; i++) {
+        SectorState& sec = m_sectors[i];
+        sec.stats.start_deg = (int)i * SCAN_SECTOR_DEG;
+        sec.stats.min_mm = -1;
+        sec.stats.median_mm = -1;
+        sec.stats.updated_ms = 0;
+        sec.count = 0;
+        sec.head = 0;
+    }
+}
+
+int ScanController::slotIndex(int angle_deg) const {
+    // Nearest slot; angles between grid points occur once sweeps are
+    // sampled off-grid
+    int idx = (angle_deg - m_slot_min_deg + m_slot_step_deg / 2) / m_slot_step_deg;
+    if (angle_deg < m_slot_min_deg || idx < 0) return 0;
+    return std::min(idx, (int)m_slot_count - 1);
+}
+
+void ScanController::record(int angle_deg, int distance_mm, uint64_t now) {
+    ScanPoint& p = m_points[slotIndex(angle_deg)];
+    if (p.timestamp_ms == 0) {
+        m_point_count++;
+    }
+    p.distance_mm = distance_mm;
+    p.timestamp_ms = now;
+
+    updateSector(angle_deg, distance_mm, now);
+}
+
+void ScanController::updateSector(int angle_deg, int distance_mm, uint64_t now) {
+    if (distance_mm <= 0) {
+        return;     // Errors neither count as obstacles nor refresh the sector
+    }
+
+    int sector = std::max(0, std::min(angle_deg, 180)) / SCAN_SECTOR_DEG;
+    SectorState& sec = m_sectors[sector];
+
+    sec.recent[sec.head] = (uint16_t)std::min(distance_mm, 0xFFFF);
+    sec.head = (uint8_t)((sec.head + 1) % SCAN_SECTOR_HISTORY);
+    if (sec.count < SCAN_SECTOR_HISTORY) sec.count++;
+
+    // Insertion sort of at most SCAN_SECTOR_HISTORY values
+    uint16_t sorted[SCAN_SECTOR_HISTORY];
+    for (uint8_t i = 0; i < sec.count; i++) {
+        uint16_t v = sec.recent[i];
+        int j = i;
+        while (j > 0 && sorted[j - 1] > v) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = v;
+    }
+
+    sec.stats.min_mm = sorted[0];
+    sec.stats.median_mm = sorted[(sec.count - 1) / 2];     // Lower median: errs closer
+    sec.stats.updated_ms = now;
 }
 
 void ScanController::start() {
     if (m_running) return;
 
     m_running = true;
-    m_current_angle = m_profile.min_deg;
     m_direction = 1;
-    m_scan_data.clear();
-    m_last_step_ms = now_ms();
-    m_dwelling = false;
+    m_travel_deg = 0;
+    clearScanData();
 
-    LOG_INFO(TAG, "Started: %d° to %d°, step=%d°, rate=%dHz",
+    LOG_INFO(TAG, "Started: %d° to %d°, step=%d°, %d°/s%s",
              m_profile.min_deg, m_profile.max_deg,
-             m_profile.step_deg, m_profile.rate_hz);
+             m_profile.step_deg, m_profile.servo_deg_per_s,
+             m_profile.adaptive ? ", adaptive" : "");
 
-    // Move to start position
-    if (m_servo_cb) {
-        m_servo_cb(m_current_angle);
+    if (m_ranging_cb) {
+        m_ranging_cb(m_profile.ranging);
     }
-    m_dwell_start_ms = now_ms();
-    m_dwelling = true;
+
+    // Move to start position
+    uint64_t now = now_ms();
+    updateWindow();
+    moveTo(m_points[m_window_lo].angle_deg, now);
+    m_sweep_start_ms = m_settled_ms;
+    m_last_sweep_ms = 0;
 }
 
 void ScanController::stop() {
     if (!m_running) return;
 
     m_running = false;
+    m_waiting_sample = false;
+    m_holding = false;
 
     // Return to center
     if (m_servo_cb) {
         m_servo_cb(90);
     }
     m_current_angle = 90;
+    m_move_from_deg = 90;
+    m_move_start_ms = m_move_end_ms = m_settled_ms = 0;
+
+    if (m_ranging_cb) {
+        m_ranging_cb(m_resting_ranging);
+    }
+
+    LOG_INFO(TAG, "Stopped, %zu points collected", m_point_count);
+}
+
+void ScanController::moveTo(int angle_deg, uint64_t now) {
+    m_move_from_deg = angleAt(now);
+    m_current_angle = angle_deg;
+    m_holding = false;
+    m_travel_deg += (uint32_t)std::abs(angle_deg - m_move_from_deg);
+
+    // Travel time scales with the distance actually moved, so the
+    // dwell adapts to step_deg (and to the longer move back from center)
+    uint64_t travel_ms = (uint64_t)std::abs(angle_deg - m_move_from_deg) * 1000 / m_profile.servo_deg_per_s;
+    m_move_start_ms = now;
+    m_move_end_ms = now + travel_ms;
+    m_settled_ms = m_move_end_ms + (uint64_t)m_profile.dwell_ms;
+
+    if (m_servo_cb) {
+        m_servo_cb(angle_deg);
+    }
+    m_last_step_ms = now;
+    m_waiting_sample = true;
+}
+
+int ScanController::angleAt(uint64_t t_ms) const {
+    if (t_ms >= m_move_end_ms || m_move_end_ms == m_move_start_ms) {
+        return m_current_angle;
+    }
+    if (t_ms <= m_move_start_ms) {
+        return m_move_from_deg;
+    }
+    int64_t span = (int64_t)(m_move_end_ms - m_move_start_ms);
+    int64_t done = (int64_t)(t_ms - m_move_start_ms);
+    int delta = m_current_angle - m_move_from_deg;
+    return m_move_from_deg + (int)((delta * done + span / 2) / span);
+}
+
+void ScanController::hold(uint64_t now) {
+    // Next sample at the current angle, no servo command
+    m_holding = true;
+    m_settled_ms = std::max(m_settled_ms, now);
+    m_last_step_ms = now;
+    m_waiting_sample = true;
+}
+
+void ScanController::updateWindow() {
+    m_window_lo = 0;
+    m_window_hi = m_slot_count - 1;
+
+    bool moving = m_hint.dir != 0.0f || m_hint.turn != 0.0f;
+    if (!m_profile.adaptive || !moving) return;
+
+    // Backing up looks nowhere in particular: only forward pace narrows
+    float pace = std::max(0.0f, m_hint.dir) * m_hint.speed / HINT_SPEED_FULL;
+    pace = std::min(pace, 1.0f);
+    float turn = std::max(-1.0f, std::min(m_hint.turn, 1.0f));
+
+    // Turning sweeps the path sideways: look wider, and toward the turn
+    // (clockwise is toward smaller angles)
+    float full = (float)(m_slot_max_deg - m_slot_min_deg);
+    float width = full - (full - (float)m_profile.cone_min_deg) * pace;
+    width = std::max(width, std::fabs(turn) * full);
+    int center = SERVO_ANGLE_CENTER - (int)std::lround(turn * HINT_TURN_DEG);
+    center = std::max(m_slot_min_deg, std::min(center, m_slot_max_deg));
+    int lo = center - (int)(width / 2.0f);
+    int hi = center + (int)(width / 2.0f);
+
+    // Slots inside [lo, hi]; a window between two slots takes the nearest
+    int lo_idx = lo <= m_slot_min_deg ? 0 : (lo - m_slot_min_deg + m_slot_step_deg - 1) / m_slot_step_deg;
+    int hi_idx = hi >= m_slot_max_deg ? (int)m_slot_count - 1 : (hi - m_slot_min_deg) / m_slot_step_deg;
+    if (lo_idx > hi_idx) {
+        lo_idx = hi_idx = slotIndex(center);
+    }
+    m_window_lo = (size_t)lo_idx;
+    m_window_hi = (size_t)std::min(hi_idx, (int)m_slot_count - 1);
+}
+
+bool ScanController::windowFresh(uint64_t now) const {
+    for (size_t i = m_window_lo; i <= m_window_hi; i++) {
+        uint64_t t = m_points[i].timestamp_ms;
+        if (t == 0 || now - t > (uint64_t)m_profile.fresh_ms) return false;
+    }
+    return true;
+}
+
+void ScanController::stepNext(uint64_t now) {
+    updateWindow();
+    int lo = (int)m_window_lo;
+    int hi = (int)m_window_hi;
+    int idx = std::min(slotIndex(m_current_angle), (int)m_slot_count - 1);
+
+    // Parked with a fresh map, or a window of one slot already reached
+    bool moving = m_hint.dir != 0.0f || m_hint.turn != 0.0f;
+    bool parked = m_profile.adaptive && !moving && windowFresh(now);
+    if (parked || (lo == hi && idx == lo)) {
+        hold(now);
+        return;
+    }
+
+    // The hint moved the window away: enter it at the nearer edge
+    if (idx < lo || idx > hi) {
+        m_direction = idx < lo ? 1 : -1;
+        moveTo(m_points[idx < lo ? lo : hi].angle_deg, now);
+        return;
+    }
+
+    // Walk the slots, so an off-grid max_deg is visited once and the
+    // way back stays on the step grid
+    int next = idx + m_direction;
+
+    // Bounce at the window edges: each one ends a sweep
+    if (next < lo || next > hi) {
+        m_last_sweep_ms = (uint32_t)(now - m_sweep_start_ms);
+        m_sweep_start_ms = now;
+        LOG_DEBUG(TAG, "Sweep done in %u ms", m_last_sweep_ms);
+
+        m_direction = -m_direction;
+        next = std::max(lo, std::min(idx + m_direction, hi));
+    }
+
+    moveTo(m_points[next].angle_deg, now);
+}
 
-    LOG_INFO(TAG, "Stopped, %zu points collected", m_scan_data.size());
+bool ScanController::capture(uint64_t now, ScanPoint& point) {
+    RangeSample s;
+    if (m_sample_cb && m_sample_cb(s) && s.seq != m_last_seq && s.start_ms >= m_settled_ms) {
+        m_last_seq = s.seq;
+        point.angle_deg = angleAt(s.start_ms + (s.end_ms - s.start_ms) / 2);
+        point.distance_mm = s.distance_mm;
+        point.timestamp_ms = s.end_ms;
+        return true;
+    }
+
+    if (now >= m_settled_ms + (uint64_t)m_profile.sample_timeout_ms) {
+        point.angle_deg = m_current_angle;
+        point.distance_mm = -1;
+        point.timestamp_ms = now;
+        return true;
+    }
+    return false;
 }
 
 void ScanController::tick() {
     if (!m_running) return;
 
     uint64_t now = now_ms();
-    uint32_t period_ms = 1000 / m_profile.rate_hz;
-
-    // Wait for dwell time before reading
-    if (m_dwelling) {
-        if (now - m_dwell_start_ms >= (uint64_t)m_profile.dwell_ms) {
-            m_dwelling = false;
-
-            // Take distance reading after servo has settled
-            int distance = -1;
-            if (m_distance_cb) {
-                distance = m_distance_cb();
-            }
-
-            // Store the reading
-            ScanPoint point;
-            point.angle_deg = m_current_angle;
-            point.distance_mm = distance;
-            point.timestamp_ms = now;
-
-            // Update or add to scan data
-            bool found = false;
-            for (auto& p : m_scan_data) {
-                if (p.angle_deg == m_current_angle) {
-                    p.distance_mm = distance;
-                    p.timestamp_ms = now;
-                    found = true;
-                    break;
-                }
-            }
-            if (!found) {
-                m_scan_data.push_back(point);
-            }
-
-            // Notify callback
-            if (m_data_cb) {
-                m_data_cb(point);
-            }
-
-            LOG_DEBUG(TAG, "Angle %d°: %dmm", m_current_angle, distance);
+    bool rate_ok = m_profile.rate_hz <= 0 ||
+                   now - m_last_step_ms >= (uint64_t)(1000 / m_profile.rate_hz);
+
+    if (!m_waiting_sample) {
+        // Captured earlier, held back by the rate cap
+        if (rate_ok) {
+            stepNext(now);
         }
         return;
     }
 
-    // Check if it's time for next step
-    if (now - m_last_step_ms >= period_ms) {
-        // Move to next angle
-        m_current_angle += m_direction * m_profile.step_deg;
-
-        // Bounce at limits
-        if (m_current_angle > m_profile.max_deg) {
-            m_current_angle = m_profile.max_deg;
-            m_direction = -1;
-        } else if (m_current_angle < m_profile.min_deg) {
-            m_current_angle = m_profile.min_deg;
-            m_direction = 1;
-        }
+    ScanPoint point;
+    if (!capture(now, point)) {
+        return;
+    }
+    m_waiting_sample = false;
 
-        // Move servo
-        if (m_servo_cb) {
-            m_servo_cb(m_current_angle);
-        }
+    // Servo first: processing the sample overlaps with the next move
+    if (rate_ok) {
+        stepNext(now);
+    }
 
-        // Start dwell period
-        m_dwell_start_ms = now;
-        m_dwelling = true;
-        m_last_step_ms = now;
+    record(point.angle_deg, point.distance_mm, point.timestamp_ms);
+    if (m_data_cb) {
+        m_data_cb(point);
     }
+
+    LOG_DEBUG(TAG, "Angle %d°: %dmm", point.angle_deg, point.distance_mm);
 }
 
 int ScanController::angleToServoUs(int angle_deg) {
@@ -150,7 +366,8 @@ int ScanController::angleToServoUs(int angle_deg) {
 
 int ScanController::getClosestDistance() const {
     int closest = 9999;
-    for (const auto& p : m_scan_data) {
+    for (size_t i = 0; i < m_slot_count; i++) {
+        const ScanPoint& p = m_points[i];
         if (p.distance_mm > 0 && p.distance_mm < closest) {
             closest = p.distance_mm;
         }
@@ -161,7 +378,8 @@ int ScanController::getClosestDistance() const {
 int ScanController::getClosestAngle() const {
     int closest_dist = 9999;
     int closest_angle = 90;
-    for (const auto& p : m_scan_data) {
+    for (size_t i = 0; i < m_slot_count; i++) {
+        const ScanPoint& p = m_points[i];
         if (p.distance_mm > 0 && p.distance_mm < closest_dist) {
             closest_dist = p.distance_mm;
             closest_angle = p.angle_deg;
@@ -171,10 +389,9 @@ int ScanController::getClosestAngle() const {
 }
 
 int ScanController::getDistanceAtAngle(int angle_deg, int tolerance_deg) const {
-    for (const auto& p : m_scan_data) {
-        if (std::abs(p.angle_deg - angle_deg) <= tolerance_deg) {
-            return p.distance_mm;
-        }
+    const ScanPoint& p = m_points[slotIndex(angle_deg)];
+    if (p.timestamp_ms != 0 && std::abs(p.angle_deg - angle_deg) <= tolerance_deg) {
+        return p.distance_mm;
     }
     return -1;
 }
@@ -183,11 +400,15 @@ int ScanController::getAverageDistanceInCone(int center_deg, int cone_width_deg)
     int sum = 0;
     int count = 0;
     int half_width = cone_width_deg / 2;
-
-    for (const auto& p : m_scan_data) {
-        if (p.distance_mm > 0 &&
-            p.angle_deg >= center_deg - half_width &&
-            p.angle_deg <= center_deg + half_width) {
+    int lo = center_deg - half_width;
+    int hi = center_deg + half_width;
+
+    // Only the slots the cone can touch
+    size_t first = (size_t)slotIndex(lo);
+    size_t last = (size_t)slotIndex(hi);
+    for (size_t i = first; i <= last; i++) {
+        const ScanPoint& p = m_points[i];
+        if (p.distance_mm > 0 && p.angle_deg >= lo && p.angle_deg <= hi) {
             sum += p.distance_mm;
             count++;
         }
@@ -195,3 +416,35 @@ int ScanController::getAverageDistanceInCone(int center_deg, int cone_width_deg)
 
     return count > 0 ? sum / count : -1;
 }
+
+template <typename Fn>
+void ScanController::forEachSectorInCone(int center_deg, int cone_width_deg,
+                                         uint32_t max_age_ms, Fn fn) const {
+    int half_width = cone_width_deg / 2;
+    int lo = std::max(0, center_deg - half_width) / SCAN_SECTOR_DEG;
+    int hi = std::min(180, center_deg + half_width) / SCAN_SECTOR_DEG;
+    uint64_t now = max_age_ms ? now_ms() : 0;
+
+    for (int i = lo; i <= hi; i++) {
+        const Sector& sec = m_sectors[i].stats;
+        if (sec.updated_ms == 0) continue;
+        if (max_age_ms && now - sec.updated_ms > max_age_ms) continue;
+        fn(sec);
+    }
+}
+
+int ScanController::getConeMinDistance(int center_deg, int cone_width_deg, uint32_t max_age_ms) const {
+    int closest = -1;
+    forEachSectorInCone(center_deg, cone_width_deg, max_age_ms, [&](const Sector& sec) {
+        if (closest < 0 || sec.min_mm < closest) closest = sec.min_mm;
+    });
+    return closest;
+}
+
+int ScanController::getConeMedianDistance(int center_deg, int cone_width_deg, uint32_t max_age_ms) const {
+    int closest = -1;
+    forEachSectorInCone(center_deg, cone_width_deg, max_age_ms, [&](const Sector& sec) {
+        if (closest < 0 || sec.median_mm < closest) closest = sec.median_mm;
+    });
+    return closest;
+}
@@ -1,10 +1,12 @@
 #ifndef SCAN_CONTROLLER_H
 #define SCAN_CONTROLLER_H
 
+#include <cstddef>
 #include <cstdint>
-#include <vector>
 #include <functional>
 
+#include "distance_sensor.h"
+
 /**
  * ScanController - Autonomous sweep of scan servo with distance readings
  *
@@ -13,39 +15,113 @@
  *
  * Architecture note: This runs on Brain (Linux) and sends servo commands
  * to Muscle (FreeRTOS) via the existing IPC mechanism.
+ *
+ * Readings live in a fixed array indexed by (angle - min_deg) / step_deg,
+ * so an update is O(1) and nothing allocates after construction. A polar
+ * map groups angles into SCAN_SECTOR_DEG sectors, each keeping the min
+ * and median of its last few readings and when it was last updated, so
+ * cone queries cost O(sectors).
+ *
+ * The sweep is pipelined against the continuously ranging sensor: the
+ * controller predicts when the servo reaches each angle from its speed,
+ * takes the first sample whose measurement started after that, and
+ * commands the next angle right away. Each sample is tagged with the
+ * servo angle interpolated at the middle of its measurement window.
+ *
+ * With an adaptive profile the sweep follows a MotionHint from the gait:
+ * walking, it covers a window around the direction of travel that
+ * narrows with speed down to cone_min_deg (a window of one slot stares
+ * straight at it without moving the servo) and widens toward the turn;
+ * stationary, it sweeps the whole profile until every slot is younger
+ * than fresh_ms, then holds still until one goes stale.
  */
+#define SCAN_MAX_POINTS       181     // 0..180 degrees in 1 degree steps
+#define SCAN_SECTOR_DEG       20
+#define SCAN_SECTOR_COUNT     (180 / SCAN_SECTOR_DEG + 1)
+#define SCAN_SECTOR_HISTORY   5       // Readings per sector for min/median
+
 class ScanController {
 public:
     struct ScanProfile {
         int min_deg = 20;       // Minimum angle (degrees from 0)
         int max_deg = 160;      // Maximum angle (degrees from 0)
         int step_deg = 10;      // Step size in degrees
-        int rate_hz = 5;        // Measurements per second
-        int dwell_ms = 80;      // Settle time at each angle before reading
+        int rate_hz = 0;        // Step rate cap, 0 = as fast as samples arrive
+        int dwell_ms = 10;      // Settle time after the predicted arrival
+        int servo_deg_per_s = 500;      // Scan servo slew rate, sets the travel time
+        int sample_timeout_ms = 250;    // Give up on an angle after this
+        DistanceSensor::Profile ranging = DistanceSensor::Profile::HIGH_SPEED;  // While sweeping
+        bool adaptive = false;  // Follow the motion hint; false = always the full sweep
+        int cone_min_deg = 10;  // Window at full speed straight ahead
+        int fresh_ms = 1000;    // Stationary: hold once every slot is younger than this
+    };
+
+    /**
+     * What the body is doing, as in GaitEngine::Params: dir and turn
+     * -1..1 (turn > 0 clockwise), speed the cycle rate factor. All zero
+     * (the default) is stationary.
+     */
+    struct MotionHint {
+        float dir = 0.0f;
+        float turn = 0.0f;
+        float speed = 0.0f;
     };
 
     struct ScanPoint {
         int angle_deg;
         int distance_mm;        // -1 = error/timeout
-        uint64_t timestamp_ms;
+        uint64_t timestamp_ms;  // 0 = no reading at this angle yet
+    };
+
+    struct Sector {
+        int start_deg;          // Covers [start_deg, start_deg + SCAN_SECTOR_DEG)
+        int min_mm;             // Over the recent readings, -1 = none valid
+        int median_mm;
+        uint64_t updated_ms;    // Last valid reading, 0 = never
+    };
+
+    /**
+     * Newest sensor sample. start_ms/end_ms bound the measurement on the
+     * CLOCK_MONOTONIC ms timeline; seq changes with every new sample.
+     */
+    struct RangeSample {
+        uint32_t seq;
+        int distance_mm;        // -1 = error/timeout
+        uint64_t start_ms;
+        uint64_t end_ms;
     };
 
     // Callback types
     using ServoCallback = std::function<void(int angle_deg)>;
-    using DistanceCallback = std::function<int()>;  // Returns distance in mm, or -1 on error
+    using SampleCallback = std::function<bool(RangeSample& out)>;  // Non-blocking; false = no sample yet
     using DataCallback = std::function<void(const ScanPoint& point)>;
+    using RangingCallback = std::function<void(DistanceSensor::Profile profile)>;
 
     ScanController();
 
-    // Configuration
-    void setProfile(const ScanProfile& profile) { m_profile = profile; }
+    // Configuration. Changing the angles while running clears the data.
+    void setProfile(const ScanProfile& profile);
     const ScanProfile& getProfile() const { return m_profile; }
 
     // Set callbacks for servo control and distance reading
     void setServoCallback(ServoCallback cb) { m_servo_cb = cb; }
-    void setDistanceCallback(DistanceCallback cb) { m_distance_cb = cb; }
+    void setSampleCallback(SampleCallback cb) { m_sample_cb = cb; }
     void setDataCallback(DataCallback cb) { m_data_cb = cb; }
 
+    // Ranging profile switching: profile.ranging while the sweep runs,
+    // the resting profile once it stops
+    void setRangingCallback(RangingCallback cb) { m_ranging_cb = cb; }
+    void setRestingRanging(DistanceSensor::Profile profile) { m_resting_ranging = profile; }
+    DistanceSensor::Profile getRestingRanging() const { return m_resting_ranging; }
+
+    // A reading from a sensor fixed at angle_deg rather than on the servo:
+    // updates the polar map only, the sweep slots stay the servo's
+    void recordFixed(int angle_deg, int distance_mm, uint64_t t_ms) { updateSector(angle_deg, distance_mm, t_ms); }
+
+    // Takes effect from the next step
+    void setMotionHint(const MotionHint& hint) { m_hint = hint; }
+    const MotionHint& getMotionHint() const { return m_hint; }
+
     // Control
     void start();
     void stop();
@@ -53,11 +129,24 @@ public:
 
     // State
     bool isRunning() const { return m_running; }
-    int getCurrentAngle() const { return m_current_angle; }
-
-    // Data access
-    const std::vector<ScanPoint>& getScanData() const { return m_scan_data; }
-    void clearScanData() { m_scan_data.clear(); }
+    int getCurrentAngle() const { return m_current_angle; }   // Commanded
+    int getEstimatedAngle() const { return angleAt(now_ms()); }
+    int getAngleAt(uint64_t t_ms) const { return angleAt(t_ms); }  // Estimated, CLOCK_MONOTONIC ms
+    uint32_t getLastSweepMs() const { return m_last_sweep_ms; }  // One direction, 0 = none yet
+    bool isHolding() const { return m_holding; }                 // Sampling without moving
+    int getWindowMin() const { return m_points[m_window_lo].angle_deg; }
+    int getWindowMax() const { return m_points[m_window_hi].angle_deg; }
+    uint32_t getTravelDeg() const { return m_travel_deg; }      // Servo travel since start()
+
+    // Data access: one slot per profile angle, in angle order
+    size_t getSlotCount() const { return m_slot_count; }
+    const ScanPoint& getSlot(size_t i) const { return m_points[i]; }
+    size_t getPointCount() const { return m_point_count; }   // Slots with a reading
+    void clearScanData();
+
+    // Polar map
+    const Sector& getSector(size_t i) const { return m_sectors[i].stats; }
+    static constexpr size_t getSectorCount() { return SCAN_SECTOR_COUNT; }
 
     // Analysis helpers
     int getClosestDistance() const;
@@ -67,25 +156,77 @@ public:
     // Get average distance in a cone (for obstacle detection)
     int getAverageDistanceInCone(int center_deg, int cone_width_deg) const;
 
+    // Closest reading / closest sector median in a cone, ignoring sectors
+    // not updated within max_age_ms (0 = any age). -1 if none qualifies.
+    int getConeMinDistance(int center_deg, int cone_width_deg, uint32_t max_age_ms = 0) const;
+    int getConeMedianDistance(int center_deg, int cone_width_deg, uint32_t max_age_ms = 0) const;
+
 private:
+    struct SectorState {
+        Sector stats;
+        uint16_t recent[SCAN_SECTOR_HISTORY];
+        uint8_t count;
+        uint8_t head;
+    };
+
     static int angleToServoUs(int angle_deg);
     static uint64_t now_ms();
 
+    void moveTo(int angle_deg, uint64_t now);
+    void hold(uint64_t now);
+    void updateWindow();
+    bool windowFresh(uint64_t now) const;
+    void stepNext(uint64_t now);
+    bool capture(uint64_t now, ScanPoint& point);
+    int angleAt(uint64_t t_ms) const;
+
+    void layoutSlots();
+    int slotIndex(int angle_deg) const;
+    void record(int angle_deg, int distance_mm, uint64_t now);
+    void updateSector(int angle_deg, int distance_mm, uint64_t now);
+    template <typename Fn>
+    void forEachSectorInCone(int center_deg, int cone_width_deg, uint32_t max_age_ms, Fn fn) const;
+
     ScanProfile m_profile;
     bool m_running = false;
 
     int m_current_angle = 90;
     int m_direction = 1;  // 1 = increasing, -1 = decreasing
 
-    uint64_t m_last_step_ms = 0;
-    uint64_t m_dwell_start_ms = 0;
-    bool m_dwelling = false;
+    // Servo motion model for the move in progress
+    int m_move_from_deg = 90;
+    uint64_t m_move_start_ms = 0;
+    uint64_t m_move_end_ms = 0;
+    uint64_t m_settled_ms = 0;          // Move end + dwell
 
-    std::vector<ScanPoint> m_scan_data;
+    uint64_t m_last_step_ms = 0;
+    bool m_waiting_sample = false;
+    uint32_t m_last_seq = 0;
+    uint64_t m_sweep_start_ms = 0;
+    uint32_t m_last_sweep_ms = 0;
+
+    // Adaptive sweep: slots [m_window_lo, m_window_hi] are visited
+    MotionHint m_hint;
+    size_t m_window_lo = 0;
+    size_t m_window_hi = 0;
+    bool m_holding = false;
+    uint32_t m_travel_deg = 0;
+
+    ScanPoint m_points[SCAN_MAX_POINTS];
+    size_t m_slot_count = 0;
+    size_t m_point_count = 0;
+    int m_slot_min_deg = 0;     // Layout the slots were built for
+    int m_slot_max_deg = 0;
+    int m_slot_step_deg = 0;
+
+    SectorState m_sectors[SCAN_SECTOR_COUNT];
 
     ServoCallback m_servo_cb;
-    DistanceCallback m_distance_cb;
+    SampleCallback m_sample_cb;
     DataCallback m_data_cb;
+    RangingCallback m_ranging_cb;
+
+    DistanceSensor::Profile m_resting_ranging = DistanceSensor::Profile::DEFAULT;
 };
 
 #endif // SCAN_CONTROLLER_H
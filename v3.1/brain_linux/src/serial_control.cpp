@@ -10,12 +10,14 @@
 #include <unistd.h>
 #include <termios.h>
 #include <cstring>
+#include <strings.h>
 #include <cerrno>
 #include <sstream>
 #include <vector>
 
 extern "C" {
 #include "limits.h"
+#include "timebase.h"
 }
 
 static const char* TAG = "Serial";
@@ -25,6 +27,16 @@ SerialControl::SerialControl()
     , m_baud(115200)
     , m_fd(-1)
     , m_rx_len(0)
+    , m_binary(false)
+    , m_frame_len(0)
+    , m_frame_overflow(false)
+    , m_frame_errors(0)
+    , m_last_rx_ms(0)
+    , m_estop_ahead(0)
+    , m_tx_head(0)
+    , m_tx_tail(0)
+    , m_want_write(false)
+    , m_tx_dropped(0)
     , m_eye_client(nullptr)
 {
 }
@@ -60,6 +72,18 @@ bool SerialControl::init() {
         case 115200: baud_code = B115200; break;
         case 230400: baud_code = B230400; break;
         case 460800: baud_code = B460800; break;
+#ifdef B3000000
+        // High rates for binary pose streaming, if the UART clock allows
+        case 500000:  baud_code = B500000;  break;
+        case 576000:  baud_code = B576000;  break;
+        case 921600:  baud_code = B921600;  break;
+        case 1000000: baud_code = B1000000; break;
+        case 1152000: baud_code = B1152000; break;
+        case 1500000: baud_code = B1500000; break;
+        case 2000000: baud_code = B2000000; break;
+        case 2500000: baud_code = B2500000; break;
+        case 3000000: baud_code = B3000000; break;
+#endif
         default:
             LOG_WARN(TAG, "Unknown baud rate %d, using 115200", m_baud);
             baud_code = B115200;
@@ -100,38 +124,166 @@ bool SerialControl::init() {
 void SerialControl::tick() {
     if (m_fd < 0) return;
 
-    ssize_t n = read(m_fd, m_rx_buffer + m_rx_len, sizeof(m_rx_buffer) - m_rx_len - 1);
-    if (n > 0) {
-        m_rx_len += n;
-        m_rx_buffer[m_rx_len] = '\0';
+    uint8_t buf[512];
+    ssize_t n;
+    while ((n = read(m_fd, buf, sizeof(buf))) > 0) {
+        uint64_t now = timebase_millis64();
+        if (m_binary && now - m_last_rx_ms > SERIAL_BIN_IDLE_MS) {
+            LOG_INFO(TAG, "Binary mode idle, back to text");
+            m_binary = false;
+            m_rx_len = 0;
+        }
+        m_last_rx_ms = now;
+        if (m_rx_tap_cb) {
+            m_rx_tap_cb(buf, (size_t)n);
+        }
 
-        char* line_start = m_rx_buffer;
-        char* newline;
-        
-        while ((newline = strchr(line_start, '\n')) != nullptr) {
-            *newline = '\0';
-            size_t len = newline - line_start;
-            if (len > 0 && line_start[len - 1] == '\r') {
-                line_start[len - 1] = '\0';
-            }
-            
-            if (strlen(line_start) > 0) {
-                processLine(line_start);
+        prescanEstop(buf, (size_t)n);
+        for (ssize_t i = 0; i < n; i++) {
+            if (m_binary) {
+                feedBinary(buf[i]);
+            } else {
+                feedText(buf[i]);
             }
-            
-            line_start = newline + 1;
         }
+        // Whatever the pre-scan counted has been handled; never carry it over
+        m_estop_ahead = 0;
+    }
+}
 
-        size_t remaining = m_rx_buffer + m_rx_len - line_start;
-        if (remaining > 0 && line_start != m_rx_buffer) {
-            memmove(m_rx_buffer, line_start, remaining);
+/**
+ * Stop at once for an ESTOP line or frame anywhere in a chunk, not when
+ * the commands ahead of it are done. Only units that start and end in
+ * this chunk are checked; handleEstop() then just sends the reply.
+ */
+void SerialControl::prescanEstop(const uint8_t* buf, size_t len) {
+    if (!m_estop_cb) return;
+
+    const uint8_t delim = m_binary ? 0 : '\n';
+    bool whole = m_binary ? (m_frame_len == 0 && !m_frame_overflow) : m_rx_len == 0;
+    size_t start = 0;
+    for (size_t i = 0; i < len; i++) {
+        // 0x00 in text switches to binary; the decoder takes it from there
+        if (!m_binary && buf[i] == 0) break;
+        if (buf[i] != delim) continue;
+        if (whole && isEstop(buf + start, i - start)) {
+            m_estop_cb();
+            m_estop_ahead++;
         }
-        m_rx_len = remaining;
+        start = i + 1;
+        whole = true;
+    }
+}
+
+bool SerialControl::isEstop(const uint8_t* unit, size_t len) const {
+    uint8_t raw[SERIAL_BIN_MAX_FRAME];
+    if (m_binary) {
+        uint8_t type = 0;
+        int n = (len <= SERIAL_BIN_MAX_ENCODED) ? serial_bin_unpack(unit, len, raw, &type) : -1;
+        if (n < 0 || type != SERIAL_BIN_MSG_TEXT) return false;
+        unit = raw + 2;
+        len = (size_t)n;
+    }
+
+    if (len > 0 && unit[len - 1] == '\r') len--;
+    const uint8_t* space = (const uint8_t*)memchr(unit, ' ', len);
+    if (space) len = (size_t)(space - unit);
+    return len == 5 && strncasecmp((const char*)unit, "ESTOP", 5) == 0;
+}
+
+void SerialControl::feedText(uint8_t byte) {
+    if (byte == 0) {
+        // Text never contains 0x00: the controller is starting binary frames
+        LOG_INFO(TAG, "Switching to binary mode");
+        m_binary = true;
+        m_rx_len = 0;
+        m_frame_len = 0;
+        m_frame_overflow = false;
+        return;
+    }
 
+    if (byte != '\n') {
         if (m_rx_len >= sizeof(m_rx_buffer) - 1) {
             LOG_WARN(TAG, "RX buffer overflow, clearing");
             m_rx_len = 0;
         }
+        m_rx_buffer[m_rx_len++] = (char)byte;
+        return;
+    }
+
+    size_t len = m_rx_len;
+    if (len > 0 && m_rx_buffer[len - 1] == '\r') {
+        len--;
+    }
+    m_rx_len = 0;
+
+    if (len > 0) {
+        processLine(std::string(m_rx_buffer, len));
+    }
+}
+
+void SerialControl::feedBinary(uint8_t byte) {
+    if (byte != 0) {
+        if (m_frame_len < sizeof(m_frame_buffer)) {
+            m_frame_buffer[m_frame_len++] = byte;
+        } else {
+            m_frame_overflow = true;
+        }
+        return;
+    }
+
+    if (m_frame_overflow) {
+        LOG_DEBUG(TAG, "Binary frame too long, dropped");
+        m_frame_errors++;
+    } else if (m_frame_len > 0) {
+        handleFrame();
+    }
+    m_frame_len = 0;
+    m_frame_overflow = false;
+}
+
+void SerialControl::handleFrame() {
+    uint8_t raw[SERIAL_BIN_MAX_FRAME];
+    uint8_t type = 0;
+    int len = serial_bin_unpack(m_frame_buffer, m_frame_len, raw, &type);
+    if (len < 0) {
+        // No reply: a corrupted frame cannot be attributed to a request
+        LOG_DEBUG(TAG, "Bad binary frame (%zu bytes)", m_frame_len);
+        m_frame_errors++;
+        return;
+    }
+    const uint8_t* payload = raw + 2;
+
+    switch (type) {
+        case SERIAL_BIN_MSG_TEXT:
+            if (len > 0) {
+                processLine(std::string((const char*)payload, len));
+            }
+            break;
+
+        case SERIAL_BIN_MSG_POSE: {
+            if (!m_pose_frame_cb) {
+                sendResponse("ERR binary poses unavailable");
+                break;
+            }
+            WsPoseAck ack = {};
+            ack.msg = WS_POSE_MSG_ACK;
+            if (m_pose_frame_cb(payload, (size_t)len, ack)) {
+                sendFrame(SERIAL_BIN_MSG_ACK, &ack, sizeof(ack));
+            }
+            break;
+        }
+
+        case SERIAL_BIN_MSG_TEXT_MODE:
+            sendResponse("OK text mode");
+            LOG_INFO(TAG, "Switching to text mode");
+            m_binary = false;
+            m_rx_len = 0;
+            break;
+
+        default:
+            sendResponse("ERR unknown frame type");
+            break;
     }
 }
 
@@ -139,6 +291,8 @@ void SerialControl::shutdown() {
     if (m_fd >= 0) {
         close(m_fd);
         m_fd = -1;
+        m_tx_head = m_tx_tail = 0;
+        m_want_write = false;
         LOG_INFO(TAG, "Closed serial port");
     }
 }
@@ -146,8 +300,71 @@ void SerialControl::shutdown() {
 void SerialControl::sendResponse(const std::string& response) {
     if (m_fd < 0) return;
     
+    if (m_binary) {
+        sendFrame(SERIAL_BIN_MSG_TEXT, response.data(), response.length());
+        return;
+    }
+    
     std::string msg = response + "\r\n";
-    write(m_fd, msg.c_str(), msg.length());
+    queueTx(msg.c_str(), msg.length());
+}
+
+void SerialControl::sendFrame(uint8_t type, const void* payload, size_t len) {
+    if (m_fd < 0) return;
+    
+    uint8_t out[SERIAL_BIN_MAX_ENCODED];
+    size_t n = serial_bin_pack(out, type, payload, len);
+    if (n == 0) {
+        LOG_WARN(TAG, "Reply too long for a binary frame (%zu bytes)", len);
+        return;
+    }
+    queueTx(out, n);
+}
+
+void SerialControl::queueTx(const void* data, size_t len) {
+    if (len > TX_RING_SIZE - getTxQueued()) {
+        // A partial reply would desync the reader, so drop all of it
+        m_tx_dropped++;
+        return;
+    }
+    
+    const uint8_t* p = (const uint8_t*)data;
+    size_t off = m_tx_head % TX_RING_SIZE;
+    size_t first = TX_RING_SIZE - off;
+    if (first > len) first = len;
+    memcpy(m_tx_ring + off, p, first);
+    memcpy(m_tx_ring, p + first, len - first);
+    m_tx_head += len;
+    
+    if (!m_want_write) {
+        flushTx();
+    }
+}
+
+void SerialControl::flushTx() {
+    while (m_fd >= 0 && m_tx_head != m_tx_tail) {
+        size_t off = m_tx_tail % TX_RING_SIZE;
+        size_t chunk = TX_RING_SIZE - off;
+        if (chunk > getTxQueued()) chunk = getTxQueued();
+        
+        ssize_t n = write(m_fd, m_tx_ring + off, chunk);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            if (errno == EINTR) continue;
+            LOG_WARN(TAG, "write error: %s, discarding %zu queued bytes", strerror(errno), getTxQueued());
+            m_tx_tail = m_tx_head;
+            break;
+        }
+        m_tx_tail += n;
+    }
+    
+    bool want_write = m_tx_head != m_tx_tail;
+    if (want_write != m_want_write) {
+        m_want_write = want_write;
+        if (m_write_interest_cb) {
+            m_write_interest_cb(want_write);
+        }
+    }
 }
 
 void SerialControl::processLine(const std::string& line) {
@@ -330,7 +547,9 @@ bool SerialControl::handleScan(const std::string& args) {
 }
 
 bool SerialControl::handleEstop() {
-    if (m_estop_cb) {
+    if (m_estop_ahead > 0) {
+        m_estop_ahead--;
+    } else if (m_estop_cb) {
         m_estop_cb();
     }
     sendResponse("OK ESTOP");
@@ -3,6 +3,10 @@
  * 
  * Text-based serial control for embedded controllers.
  * Runs alongside WebSocket server, supports same command set.
+ *
+ * A 0x00 byte switches the port to COBS-framed binary mode for streaming
+ * poses at high baud rates (see common/serial_binary.h); text commands
+ * remain available as TEXT frames.
  */
 
 #ifndef SERIAL_CONTROL_H
@@ -11,6 +15,12 @@
 #include <string>
 #include <functional>
 #include <cstdint>
+#include <cstddef>
+
+extern "C" {
+#include "serial_binary.h"
+#include "ws_pose_binary.h"
+}
 
 class EyeClient;
 
@@ -24,6 +34,15 @@ public:
     using ResumeCallback = std::function<void()>;
     using StatusCallback = std::function<std::string()>;
     using DistanceCallback = std::function<int()>;
+    // Binary pose frame (WsPoseHeader + entries); returns true if ack must be sent
+    using PoseFrameCallback = std::function<bool(const uint8_t* data, size_t len, WsPoseAck& ack)>;
+    // Output is pending (true) or drained (false): arm/disarm EPOLLOUT
+    using WriteInterestCallback = std::function<void(bool want_write)>;
+    // Every chunk read from the port, before it is parsed (command capture)
+    using RxTapCallback = std::function<void(const uint8_t* data, size_t len)>;
+
+    // Outbound buffer, about 350 ms of output at 115200 baud
+    static constexpr size_t TX_RING_SIZE = 4096;
 
     SerialControl();
     ~SerialControl();
@@ -40,14 +59,32 @@ public:
     void setResumeCallback(ResumeCallback cb) { m_resume_cb = cb; }
     void setStatusCallback(StatusCallback cb) { m_status_cb = cb; }
     void setDistanceCallback(DistanceCallback cb) { m_distance_cb = cb; }
+    void setPoseFrameCallback(PoseFrameCallback cb) { m_pose_frame_cb = cb; }
+    void setWriteInterestCallback(WriteInterestCallback cb) { m_write_interest_cb = cb; }
+    void setRxTapCallback(RxTapCallback cb) { m_rx_tap_cb = cb; }
 
     bool init();
-    void tick();
+    void tick();  // Drain pending input; call when the fd is readable
+    void flushTx();  // Write queued output; call when the fd is writable
     void shutdown();
 
+    int getFd() const { return m_fd; }
+    bool isBinaryMode() const { return m_binary; }
+    uint32_t getFrameErrors() const { return m_frame_errors; }
+    bool wantsWrite() const { return m_want_write; }
+    size_t getTxQueued() const { return m_tx_head - m_tx_tail; }
+    uint32_t getTxDropped() const { return m_tx_dropped; }  // Replies discarded, ring full
+
 private:
+    void feedText(uint8_t byte);
+    void feedBinary(uint8_t byte);
+    void prescanEstop(const uint8_t* buf, size_t len);
+    bool isEstop(const uint8_t* unit, size_t len) const;
+    void handleFrame();
     void processLine(const std::string& line);
     void sendResponse(const std::string& response);
+    void sendFrame(uint8_t type, const void* payload, size_t len);
+    void queueTx(const void* data, size_t len);
     
     bool handleStatus();
     bool handleServo(const std::string& args);
@@ -66,6 +103,22 @@ private:
     char m_rx_buffer[1024];
     size_t m_rx_len;
     
+    // Binary mode: one COBS block between 0x00 delimiters
+    bool m_binary;
+    uint8_t m_frame_buffer[SERIAL_BIN_MAX_ENCODED];
+    size_t m_frame_len;
+    bool m_frame_overflow;
+    uint32_t m_frame_errors;
+    uint64_t m_last_rx_ms;
+    uint32_t m_estop_ahead;     // ESTOPs the pre-scan already acted on, in the chunk being fed
+    
+    // Replies are queued whole or not at all; head/tail count bytes ever queued/written
+    uint8_t m_tx_ring[TX_RING_SIZE];
+    size_t m_tx_head;
+    size_t m_tx_tail;
+    bool m_want_write;
+    uint32_t m_tx_dropped;
+    
     EyeClient* m_eye_client;
     
     ServoCallback m_servo_cb;
@@ -76,6 +129,9 @@ private:
     ResumeCallback m_resume_cb;
     StatusCallback m_status_cb;
     DistanceCallback m_distance_cb;
+    PoseFrameCallback m_pose_frame_cb;
+    WriteInterestCallback m_write_interest_cb;
+    RxTapCallback m_rx_tap_cb;
 };
 
 #endif // SERIAL_CONTROL_H
@@ -0,0 +1,71 @@
+/**
+ * Spider Robot v3.1 - Servo Calibration Implementation
+ */
+
+#include "servo_calibration.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+static const char* TAG = "Calib";
+
+static const size_t CALIB_FILE_SIZE =
+    sizeof(ServoCalibHeader) + SERVO_COUNT_TOTAL * sizeof(ServoCalibChannel);
+
+ServoCalibration::Table::Table() {
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) {
+        gain_q12[i] = SERVO_CALIB_SCALE_ONE;
+        center_us[i] = SERVO_PWM_NEUTRAL_US;
+        min_us[i] = SERVO_PWM_MIN_US;
+        max_us[i] = SERVO_PWM_MAX_US;
+    }
+}
+
+bool ServoCalibration::load(const char* path, Table& out) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        LOG_WARN(TAG, "Cannot open %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    // One byte more than a valid table, so oversized files are caught
+    uint8_t buf[CALIB_FILE_SIZE + 1];
+    size_t n = fread(buf, 1, sizeof(buf), f);
+    fclose(f);
+
+    if (!parse(buf, n, out)) {
+        LOG_ERROR(TAG, "%s is not a valid calibration table", path);
+        return false;
+    }
+    LOG_INFO(TAG, "Loaded calibration from %s", path);
+    return true;
+}
+
+bool ServoCalibration::parse(const void* data, size_t size, Table& out) {
+    if (servo_calib_validate(data, size) != 0) {
+        return false;
+    }
+
+    ServoCalibChannel ch[SERVO_COUNT_TOTAL];
+    memcpy(ch, (const uint8_t*)data + sizeof(ServoCalibHeader), sizeof(ch));
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) {
+        out.gain_q12[i] = ch[i].direction * (int32_t)ch[i].scale_q12;
+        out.center_us[i] = SERVO_PWM_NEUTRAL_US + ch[i].offset_us;
+        out.min_us[i] = ch[i].min_us;
+        out.max_us[i] = ch[i].max_us;
+    }
+    return true;
+}
+
+void ServoCalibration::apply(const Table& table, const uint16_t* in, uint16_t* out) {
+    // Fixed trip count and min/max only, so the compiler can unroll or vectorize it
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) {
+        int32_t v = ((int32_t)in[i] - SERVO_PWM_NEUTRAL_US) * table.gain_q12[i];
+        v = table.center_us[i] + ((v + SERVO_CALIB_SCALE_ONE / 2) >> 12);
+        v = std::min(std::max(v, table.min_us[i]), table.max_us[i]);
+        out[i] = (uint16_t)v;
+    }
+}
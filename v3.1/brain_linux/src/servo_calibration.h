@@ -0,0 +1,49 @@
+/**
+ * Spider Robot v3.1 - Servo Calibration
+ *
+ * Brain-side per-channel calibration (common/servo_calib_format.h), so
+ * clients send logical pulse widths and no longer apply offsets and
+ * directions themselves. The file is validated and unpacked once into a
+ * structure-of-arrays table; apply() is then one branch-free pass over
+ * the 13 channels that also does clamp_servo_us().
+ */
+
+#ifndef SERVO_CALIBRATION_H
+#define SERVO_CALIBRATION_H
+
+#include <cstddef>
+#include <cstdint>
+
+extern "C" {
+#include "servo_calib_format.h"
+}
+
+class ServoCalibration {
+public:
+    struct Table {
+        int32_t gain_q12[SERVO_COUNT_TOTAL];    // direction * scale
+        int32_t center_us[SERVO_COUNT_TOTAL];   // Neutral plus offset
+        int32_t min_us[SERVO_COUNT_TOTAL];
+        int32_t max_us[SERVO_COUNT_TOTAL];
+
+        Table();        // Identity: only the PWM clamp
+    };
+
+    /**
+     * Read and validate a table file. out is left untouched on failure.
+     */
+    static bool load(const char* path, Table& out);
+
+    /**
+     * Unpack a table already in memory.
+     */
+    static bool parse(const void* data, size_t size, Table& out);
+
+    /**
+     * Logical to physical pulse widths for all channels. in and out may
+     * be the same array.
+     */
+    static void apply(const Table& table, const uint16_t* in, uint16_t* out);
+};
+
+#endif // SERVO_CALIBRATION_H
@@ -6,6 +6,8 @@
 
 #include <fcntl.h>
 #include <unistd.h>
+#include <setjmp.h>
+#include <signal.h>
 #include <sys/mman.h>
 #include <cstring>
 #include <cerrno>
@@ -13,53 +15,170 @@
 
 extern "C" {
 #include "crc16_ccitt_false.h"
+#include "cache_ops.h"
+}
+
+static sigjmp_buf s_probe_env;
+
+static void probe_sigill(int) {
+    siglongjmp(s_probe_env, 1);
+}
+
+// th.dcache.* raise SIGILL in user mode unless the firmware enabled them
+static bool cache_ops_usable() {
+    struct sigaction sa = {}, old = {};
+    sa.sa_handler = probe_sigill;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGILL, &sa, &old);
+
+    volatile uint8_t line[CACHE_LINE_SIZE] __attribute__((aligned(CACHE_LINE_SIZE))) = {};
+    bool ok = false;
+    if (sigsetjmp(s_probe_env, 1) == 0) {
+        cache_clean_range(line, sizeof(line));
+        ok = true;
+    }
+
+    sigaction(SIGILL, &old, nullptr);
+    return ok;
 }
 
 SharedMemory::~SharedMemory() {
     unmap();
 }
 
-bool SharedMemory::map() {
-    if (m_buffer != nullptr) {
+bool SharedMemory::map(uint32_t max_slots) {
+    if (m_header != nullptr) {
         return true;
     }
 
-    m_mem_fd = ::open("/dev/mem", O_RDWR | O_SYNC);
-    if (m_mem_fd < 0) {
+    void* ptr = m_region;
+    if (ptr == nullptr) {
+        m_mem_fd = ::open("/dev/mem", O_RDWR | O_SYNC);
+        if (m_mem_fd < 0) {
+            std::cerr << "[SharedMem] Failed to open /dev/mem: " << strerror(errno) << std::endl;
+            return false;
+        }
+
+        ptr = mmap(nullptr, SHARED_MEM_SIZE, PROT_READ | PROT_WRITE,
+                   MAP_SHARED, m_mem_fd, SHARED_MEM_BASE);
+
+        if (ptr == MAP_FAILED) {
+            std::cerr << "[SharedMem] mmap failed at 0x" << std::hex << SHARED_MEM_BASE 
+                      << std::dec << ": " << strerror(errno) << std::endl;
+            ::close(m_mem_fd);
+            m_mem_fd = -1;
+            return false;
+        }
+    }
+
+    m_header = static_cast<SharedRingHeader*>(ptr);
+
+    uint32_t header_size = SHARED_HEADER_SIZE;
+    if (m_want_cached && m_region == nullptr) {
+        if (mapSlotsCached(SHARED_HEADER_SIZE_PAGED)) {
+            header_size = SHARED_HEADER_SIZE_PAGED;
+        } else {
+            std::cerr << "[SharedMem] Cached mapping unavailable, using uncached slots" << std::endl;
+        }
+    }
+    if (!m_cached) {
+        m_slots = reinterpret_cast<uint8_t*>(m_header) + header_size;
+    }
+
+    m_slot_size = shared_ring_slot_size_for(m_channels);
+    uint32_t slots = shared_ring_slots_for_size(SHARED_RING_REGION_SIZE, header_size, m_slot_size);
+    while (max_slots >= SHARED_RING_MIN_SLOTS && slots > max_slots) {
+        slots >>= 1;
+    }
+    m_slot_count = slots;
+
+    // Withdraw the old layout first so the Muscle never sees a half-written header
+    SHARED_STORE_RELEASE(&m_header->brain_flags, 0u);
+    SHARED_FENCE_FULL();
+
+    m_header->magic = SHARED_LAYOUT_MAGIC;
+    m_header->version = SHARED_LAYOUT_VERSION;
+    m_header->header_size = (uint16_t)header_size;
+    m_header->slot_size = (uint16_t)m_slot_size;
+    m_header->reserved0 = 0;
+    m_header->slot_count = m_slot_count;
+    memset(m_header->reserved1, 0, sizeof(m_header->reserved1));
+    m_header->write_idx = 0;
+    m_header->brain_alive = 0;
+    m_header->read_idx = 0;
+    m_header->muscle_flags = 0;
+    shared_probe_area(m_header)->request.seq = 0;
+    shared_probe_area(m_header)->response.seq = 0;
+    m_write_idx = 0;
+    m_read_cache = 0;
+    m_alive = 0;
+    m_log_cursor = 0;
+    m_log_synced = false;
+    m_ack_synced = false;
+
+    // Slots need no clearing: only published ones are read, and each carries a CRC
+    SHARED_STORE_RELEASE(&m_header->brain_flags, SHARED_FLAG_BRAIN_READY);
+
+    std::cout << "[SharedMem] Mapped at 0x" << std::hex
+              << (m_region ? (uintptr_t)m_region : (uintptr_t)SHARED_MEM_BASE)
+              << std::dec << " (" << SHARED_MEM_SIZE << " bytes, layout v"
+              << (SHARED_LAYOUT_VERSION >> 8) << "." << (SHARED_LAYOUT_VERSION & 0xFF)
+              << ", " << m_slot_count << " x " << m_slot_size << "-byte slots, "
+              << (m_cached ? "cached" : "uncached") << ")" << std::endl;
+    return true;
+}
+
+bool SharedMemory::mapSlotsCached(uint32_t header_size) {
+    if (!cache_ops_usable()) {
+        std::cerr << "[SharedMem] D-cache maintenance not permitted in user mode" << std::endl;
+        return false;
+    }
+
+    // Without O_SYNC, /dev/mem hands out a cacheable mapping
+    m_cached_fd = ::open("/dev/mem", O_RDWR);
+    if (m_cached_fd < 0) {
         std::cerr << "[SharedMem] Failed to open /dev/mem: " << strerror(errno) << std::endl;
         return false;
     }
 
-    void* ptr = mmap(nullptr, SHARED_MEM_SIZE, PROT_READ | PROT_WRITE,
-                     MAP_SHARED, m_mem_fd, SHARED_MEM_BASE);
-    
+    // The log tail is Muscle-written and read through the uncached view
+    m_cached_len = SHARED_RING_REGION_SIZE - header_size;
+    void* ptr = mmap(nullptr, m_cached_len, PROT_READ | PROT_WRITE,
+                     MAP_SHARED, m_cached_fd, SHARED_MEM_BASE + header_size);
     if (ptr == MAP_FAILED) {
-        std::cerr << "[SharedMem] mmap failed at 0x" << std::hex << SHARED_MEM_BASE 
-                  << std::dec << ": " << strerror(errno) << std::endl;
-        ::close(m_mem_fd);
-        m_mem_fd = -1;
+        std::cerr << "[SharedMem] Cached mmap failed: " << strerror(errno) << std::endl;
+        ::close(m_cached_fd);
+        m_cached_fd = -1;
+        m_cached_len = 0;
         return false;
     }
 
-    m_buffer = static_cast<SharedMotionBuffer*>(ptr);
-
-    m_buffer->write_idx = 0;
-    m_buffer->read_idx = 0;
-    m_buffer->flags = 0;
-    m_buffer->reserved = 0;
-    memset((void*)m_buffer->packets, 0, sizeof(m_buffer->packets));
-
-    __sync_synchronize();
-
-    std::cout << "[SharedMem] Mapped at 0x" << std::hex << SHARED_MEM_BASE 
-              << std::dec << " (" << SHARED_MEM_SIZE << " bytes)" << std::endl;
+    m_cached_map = ptr;
+    m_slots = static_cast<uint8_t*>(ptr);
+    m_cached = true;
     return true;
 }
 
 void SharedMemory::unmap() {
-    if (m_buffer != nullptr) {
-        munmap(m_buffer, SHARED_MEM_SIZE);
-        m_buffer = nullptr;
+    if (m_cached_map != nullptr) {
+        munmap(m_cached_map, m_cached_len);
+        m_cached_map = nullptr;
+        m_cached_len = 0;
+    }
+    if (m_cached_fd >= 0) {
+        ::close(m_cached_fd);
+        m_cached_fd = -1;
+    }
+    m_cached = false;
+    m_slots = nullptr;
+
+    if (m_header != nullptr) {
+        SHARED_STORE_RELEASE(&m_header->brain_flags, 0u);
+        if (m_region == nullptr) {
+            munmap(m_header, SHARED_MEM_SIZE);
+        }
+        m_header = nullptr;
+        m_slot_count = 0;
     }
     if (m_mem_fd >= 0) {
         ::close(m_mem_fd);
@@ -68,48 +187,289 @@ void SharedMemory::unmap() {
 }
 
 bool SharedMemory::writePacket(const PosePacket31* pkt, uint32_t& out_write_idx) {
-    if (m_buffer == nullptr || pkt == nullptr) {
-        return false;
+    return writePackets(pkt, 1, out_write_idx) == 1;
+}
+
+size_t SharedMemory::writePackets(const PosePacket31* pkts, size_t count, uint32_t& out_write_idx,
+                                  const uint64_t* exec_at_us) {
+    if (pkts == nullptr) {
+        return 0;
+    }
+    return writeSlots(count, out_write_idx, [&](SharedRingSlot& slot, size_t i, uint32_t idx) {
+        fillSlot(slot, &pkts[i], sizeof(pkts[i]), exec_at_us ? exec_at_us[i] : 0, idx);
+    });
+}
+
+size_t SharedMemory::writePacketsN(const PosePacketN* pkts, size_t count, uint32_t& out_write_idx,
+                                   const uint64_t* exec_at_us) {
+    if (pkts == nullptr) {
+        return 0;
+    }
+    // Every packet must fit the slot size picked at map()
+    for (size_t i = 0; i < count; i++) {
+        if (!posepacketn_count_valid(pkts[i].channel_count) ||
+            posepacketn_size(pkts[i].channel_count) > m_slot_size - SHARED_SLOT_HEADER_SIZE) {
+            return 0;
+        }
     }
+    return writeSlots(count, out_write_idx, [&](SharedRingSlot& slot, size_t i, uint32_t idx) {
+        fillSlot(slot, &pkts[i], posepacketn_size(pkts[i].channel_count),
+                 exec_at_us ? exec_at_us[i] : 0, idx);
+    });
+}
 
-    uint32_t write_idx = m_buffer->write_idx;
-    uint32_t read_idx = m_buffer->read_idx;
+template <typename Fill>
+size_t SharedMemory::writeSlots(size_t count, uint32_t& out_write_idx, Fill fill) {
+    if (m_header == nullptr || count == 0) {
+        return 0;
+    }
 
-    if ((write_idx - read_idx) >= PACKET_RING_SIZE) {
-        std::cerr << "[SharedMem] Ring buffer full (w=" << write_idx 
-                  << " r=" << read_idx << ")" << std::endl;
-        return false;
+    // Only touch the consumer's line when the cached read index says we are short
+    uint32_t write_idx = m_write_idx;
+    uint32_t used = write_idx - m_read_cache;
+    if (used >= m_slot_count || m_slot_count - used < count) {     // Lapped by an overwrite, or short
+        m_read_cache = SHARED_LOAD_ACQUIRE(&m_header->read_idx);
+        used = write_idx - m_read_cache;
     }
 
-    uint32_t slot = write_idx % PACKET_RING_SIZE;
-    
-    memcpy((void*)m_buffer->packets[slot], pkt, sizeof(PosePacket31));
+    if (used >= m_slot_count) {
+        return 0;
+    }
 
-    __sync_synchronize();
+    size_t n = m_slot_count - used;
+    if (n > count) n = count;
 
-    m_buffer->write_idx = write_idx + 1;
+    uint32_t mask = m_slot_count - 1;
+    for (size_t i = 0; i < n; i++) {
+        // Build the slot locally so it lands as whole lines
+        SharedRingSlot local;
+        fill(local, i, write_idx + (uint32_t)i);
 
-    __sync_synchronize();
+        uint8_t* slot = m_slots + ((write_idx + (uint32_t)i) & mask) * m_slot_size;
+        memcpy(slot, &local, m_slot_size);
+        if (m_cached) {
+            cache_clean_range(slot, m_slot_size);
+        }
+    }
 
-    out_write_idx = write_idx + 1;
-    return true;
+    // One clean-completion and one release store per batch
+    if (m_cached) {
+        cache_sync();
+    }
+    m_write_idx = write_idx + (uint32_t)n;
+    SHARED_STORE_RELEASE(&m_header->write_idx, m_write_idx);
+
+    out_write_idx = m_write_idx;
+    return n;
+}
+
+size_t SharedMemory::overwritePackets(const PosePacket31* pkts, size_t count, uint32_t& out_write_idx,
+                                      const uint64_t* exec_at_us, uint32_t& overwritten) {
+    overwritten = 0;
+    if (m_header == nullptr || pkts == nullptr || count == 0) {
+        return 0;
+    }
+    if (count > m_slot_count) count = m_slot_count;
+
+    m_read_cache = SHARED_LOAD_ACQUIRE(&m_header->read_idx);
+    uint32_t write_idx = m_write_idx;
+    uint32_t mask = m_slot_count - 1;
+    for (size_t i = 0; i < count; i++) {
+        uint32_t idx = write_idx + (uint32_t)i;
+        SharedRingSlot local;
+        fillSlot(local, &pkts[i], sizeof(pkts[i]), exec_at_us ? exec_at_us[i] : 0, idx);
+
+        uint8_t* slot = m_slots + (idx & mask) * m_slot_size;
+        SharedRingSlot* dst = reinterpret_cast<SharedRingSlot*>(slot);
+        if (idx - m_read_cache < m_slot_count) {
+            memcpy(slot, &local, m_slot_size);
+            if (m_cached) {
+                cache_clean_range(slot, m_slot_size);
+            }
+            continue;
+        }
+
+        // The Muscle may be copying this slot right now: void its stamp
+        // first and restore it last, so a torn copy never matches
+        SHARED_STORE_RELEASE(&dst->gen, 0u);
+        if (m_cached) {
+            cache_clean_line(slot);
+            cache_sync();
+        }
+        SHARED_FENCE_FULL();
+        local.gen = 0;
+        memcpy(slot, &local, m_slot_size);
+        if (m_cached) {
+            cache_clean_range(slot, m_slot_size);
+            cache_sync();
+        }
+        SHARED_STORE_RELEASE(&dst->gen, shared_ring_slot_gen(idx));
+        if (m_cached) {
+            cache_clean_line(slot);
+        }
+        overwritten++;
+    }
+
+    if (m_cached) {
+        cache_sync();
+    }
+    m_write_idx = write_idx + (uint32_t)count;
+    SHARED_STORE_RELEASE(&m_header->write_idx, m_write_idx);
+
+    out_write_idx = m_write_idx;
+    return count;
+}
+
+void SharedMemory::fillSlot(SharedRingSlot& slot, const void* pkt, size_t len, uint64_t exec_at_us,
+                            uint32_t idx) const {
+    slot.exec_at_us = exec_at_us;
+    slot.gen = shared_ring_slot_gen(idx);
+    slot.reserved = 0;
+    memcpy(slot.bytes, pkt, len);
+    memset(slot.bytes + len, 0, m_slot_size - SHARED_SLOT_HEADER_SIZE - len);
+}
+
+bool SharedMemory::notifySuppressed() const {
+    if (m_header == nullptr) return false;
+    // Pairs with the Muscle's clear-then-recheck: write_idx must be visible before this load
+    SHARED_FENCE_FULL();
+    return (m_header->muscle_flags & SHARED_FLAG_NOTIFY_SUPPRESS) != 0;
+}
+
+bool SharedMemory::muscleAccepted() const {
+    if (m_header == nullptr) return false;
+    return (m_header->muscle_flags & SHARED_FLAG_MUSCLE_READY) != 0;
+}
+
+bool SharedMemory::layoutRejected() const {
+    if (m_header == nullptr) return false;
+    return (m_header->muscle_flags & SHARED_FLAG_LAYOUT_REJECTED) != 0;
+}
+
+bool SharedMemory::muscleEstop() const {
+    if (m_header == nullptr) return false;
+    return (m_header->muscle_flags & SHARED_FLAG_ESTOP) != 0;
+}
+
+bool SharedMemory::bumpAlive() {
+    if (m_header == nullptr) return false;
+    SHARED_STORE_RELEASE(&m_header->brain_alive, ++m_alive);
+    return (m_header->muscle_flags & SHARED_FLAG_ALIVE_WATCH) != 0;
+}
+
+uint32_t SharedMemory::refreshReadIdx() {
+    if (m_header != nullptr) {
+        m_read_cache = SHARED_LOAD_ACQUIRE(&m_header->read_idx);
+    }
+    return m_read_cache;
 }
 
 bool SharedMemory::isFull() const {
-    if (m_buffer == nullptr) return true;
-    return (m_buffer->write_idx - m_buffer->read_idx) >= PACKET_RING_SIZE;
+    if (m_header == nullptr) return true;
+    return (m_write_idx - m_read_cache) >= m_slot_count;
 }
 
 uint32_t SharedMemory::available() const {
-    if (m_buffer == nullptr) return 0;
-    uint32_t used = m_buffer->write_idx - m_buffer->read_idx;
-    return (used < PACKET_RING_SIZE) ? (PACKET_RING_SIZE - used) : 0;
+    if (m_header == nullptr) return 0;
+    uint32_t used = m_write_idx - m_read_cache;
+    return (used < m_slot_count) ? (m_slot_count - used) : 0;
+}
+
+size_t SharedMemory::readLog(SharedLogRecord* out, size_t max, uint32_t& lost) {
+    if (m_header == nullptr || out == nullptr) return 0;
+
+    volatile SharedLogHeader* log = shared_log_area(m_header);
+    if (!shared_log_valid(log)) {
+        m_log_synced = false;
+        return 0;
+    }
+
+    // Start from the oldest record still held, so events from before the Brain came up show
+    if (!m_log_synced) {
+        uint32_t w = SHARED_LOAD_ACQUIRE(&log->write_idx);
+        m_log_cursor = (w > log->record_count) ? w - log->record_count : 0;
+        m_log_synced = true;
+    }
+
+    size_t n = 0;
+    while (n < max && shared_log_read(log, &m_log_cursor, &out[n], &lost)) {
+        n++;
+    }
+    return n;
+}
+
+size_t SharedMemory::readAcks(SharedAckRecord* out, size_t max, uint32_t& lost) {
+    if (m_header == nullptr || out == nullptr) return 0;
+
+    volatile SharedAckHeader* ack = shared_ack_area(m_header);
+    if (!shared_ack_valid(ack)) {
+        m_ack_synced = false;
+        return 0;
+    }
+
+    // Records from before this mapping answer a previous Brain's seqs
+    if (!m_ack_synced) {
+        m_ack_cursor = SHARED_LOAD_ACQUIRE(&ack->write_idx);
+        m_ack_synced = true;
+    }
+
+    size_t n = 0;
+    while (n < max && shared_ack_read(ack, &m_ack_cursor, &out[n], &lost)) {
+        n++;
+    }
+    return n;
+}
+
+bool SharedMemory::readTelemetry(SharedTelemetryData& out) const {
+    if (m_header == nullptr) return false;
+    return shared_telemetry_read(shared_telemetry_area(m_header), &out) == 0;
+}
+
+size_t SharedMemory::readTrace(SharedTraceRecord* out, size_t max) const {
+    if (m_header == nullptr || out == nullptr) return 0;
+
+    volatile SharedTraceHeader* tr = shared_trace_area(m_header);
+    if (!shared_trace_valid(tr, SHARED_TRACE_RECORDS)) return 0;
+    return shared_trace_snapshot(tr, out, max);
+}
+
+size_t SharedMemory::readTraceSince(uint32_t& cursor, SharedTraceRecord* out, size_t max) const {
+    if (m_header == nullptr || out == nullptr) return 0;
+
+    volatile SharedTraceHeader* tr = shared_trace_area(m_header);
+    if (!shared_trace_valid(tr, SHARED_TRACE_RECORDS)) return 0;
+
+    uint32_t w = SHARED_LOAD_ACQUIRE(&tr->write_idx);
+    if (w < cursor) cursor = 0;
+    if (w == cursor) return 0;
+    if (w - cursor < max) max = w - cursor;
+
+    // Only touch the records not seen yet; uncached reads are slow
+    size_t n = shared_trace_snapshot(tr, out, max);
+    size_t kept = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (out[i].stamp > cursor) out[kept++] = out[i];
+    }
+    if (kept > 0) cursor = out[kept - 1].stamp;
+    return kept;
+}
+
+void SharedMemory::writeProbe(uint32_t seq, uint64_t tx_us) {
+    if (m_header == nullptr) return;
+    shared_probe_request(shared_probe_area(m_header), seq, tx_us);
+}
+
+uint32_t SharedMemory::readProbe(uint64_t& tx_us, uint64_t& rx_us, uint64_t& echo_us) const {
+    if (m_header == nullptr) return 0;
+    return shared_probe_read(shared_probe_area(m_header), &tx_us, &rx_us, &echo_us);
 }
 
-uint32_t SharedMemory::getWriteIdx() const {
-    return m_buffer ? m_buffer->write_idx : 0;
+uint32_t SharedMemory::writeTunables(const SharedTunablesData& data) {
+    if (m_header == nullptr) return 0;
+    return shared_tunables_publish(shared_tunables_area(m_header), &data);
 }
 
-uint32_t SharedMemory::getReadIdx() const {
-    return m_buffer ? m_buffer->read_idx : 0;
+bool SharedMemory::readTunablesApplied(SharedTunablesApplied& out) const {
+    if (m_header == nullptr) return false;
+    return shared_tunables_read_applied(shared_tunables_area(m_header), &out) != 0;
 }
@@ -1,8 +1,14 @@
 /**
- * Spider Robot v3.1 - Shared Memory Ring Buffer
+ * Spider Robot v3.1 - Shared Memory Trajectory Ring
  * 
- * Physical memory at 0x83F00000 shared between Linux and FreeRTOS
- * Contains PosePacket31 ring buffer for motion commands
+ * Physical memory at 0x83F00000 shared between Linux and FreeRTOS.
+ * Layout (v3.5 header + timestamped slots) lives in common/shared_motion_buffer.h.
+ *
+ * By default the whole region is mapped uncached (/dev/mem O_SYNC), so
+ * every store to a slot is a bus transaction. In cached mode the header
+ * page stays uncached and the slots are mapped cacheable; each written
+ * slot is then one 64-byte line (two for wide slots), cleaned to DRAM
+ * before publishing.
  */
 
 #ifndef SHARED_MEMORY_H
@@ -13,45 +19,205 @@
 
 extern "C" {
 #include "protocol_posepacket31.h"
+#include "protocol_posepacketn.h"
+#include "shared_motion_buffer.h"
+#include "shared_log.h"
+#include "shared_telemetry.h"
+#include "shared_trace.h"
+#include "shared_probe.h"
+#include "shared_tunables.h"
+#include "shared_ack.h"
 }
 
-#define SHARED_MEM_BASE     0x83F00000
-#define SHARED_MEM_SIZE     0x1000        // 4KB
-#define PACKET_RING_SIZE    8             // 8 slots in ring buffer
-#define PACKET_SLOT_SIZE    64            // Each slot 64 bytes (padding for alignment)
-
-struct SharedMotionBuffer {
-    volatile uint32_t write_idx;          // Linux writes, RTOS reads
-    volatile uint32_t read_idx;           // RTOS writes, Linux reads
-    volatile uint32_t flags;              // Status flags
-    volatile uint32_t reserved;           // Alignment padding
-    volatile uint8_t packets[PACKET_RING_SIZE][PACKET_SLOT_SIZE];
-};
-
-static_assert(sizeof(SharedMotionBuffer) <= SHARED_MEM_SIZE, "Buffer exceeds shared memory");
-
 class SharedMemory {
 public:
     SharedMemory() = default;
     ~SharedMemory();
 
-    bool map();
+    /**
+     * Request a cacheable slot mapping. Falls back to uncached when the
+     * CPU refuses user-mode cache maintenance. Must be called before map().
+     */
+    void setCached(bool cached) { m_want_cached = cached; }
+    bool isCached() const { return m_cached; }
+
+    /**
+     * Use region (SHARED_MEM_SIZE bytes, owned by the caller) instead of
+     * mapping /dev/mem, for the host simulator. Slots are then always
+     * uncached. Must be called before map().
+     */
+    void setRegion(void* region) { m_region = region; }
+
+    /**
+     * Size the slots for PosePacketN of up to channels channels (default
+     * SERVO_COUNT_TOTAL: 64-byte slots; above 15, 128-byte slots and half
+     * as many of them). Must be called before map().
+     */
+    void setChannels(uint32_t channels) { m_channels = channels; }
+    uint32_t getSlotSize() const { return m_slot_size; }
+
+    /**
+     * Map the region and publish a fresh header.
+     * @param max_slots cap on the ring size (0 = as many as fit)
+     */
+    bool map(uint32_t max_slots = 0);
     void unmap();
-    bool isMapped() const { return m_buffer != nullptr; }
+    bool isMapped() const { return m_header != nullptr; }
 
     bool writePacket(const PosePacket31* pkt, uint32_t& out_write_idx);
+
+    /**
+     * Copy up to count packets into free slots and publish them with a
+     * single write_idx update.
+     * @param exec_at_us per-packet deadline on timebase_shared_us()
+     *                   (nullptr = apply all on arrival)
+     * @return number of packets written (0 if the ring is full; the
+     *         caller's flow control decides what happens to the rest)
+     */
+    size_t writePackets(const PosePacket31* pkts, size_t count, uint32_t& out_write_idx,
+                        const uint64_t* exec_at_us = nullptr);
+
+    /**
+     * writePackets() for PosePacketN. Writes nothing if any packet does
+     * not fit the slots (see setChannels()).
+     */
+    size_t writePacketsN(const PosePacketN* pkts, size_t count, uint32_t& out_write_idx,
+                         const uint64_t* exec_at_us = nullptr);
+
+    /**
+     * Write all count packets (up to the slot count) whether or not the
+     * ring has credit: once it is full each one replaces the oldest slot
+     * the Muscle has not consumed, which then skips what it lost (see
+     * "Overwrite" in shared_motion_buffer.h).
+     * @param overwritten set to the number of unread slots replaced
+     * @return number of packets written
+     */
+    size_t overwritePackets(const PosePacket31* pkts, size_t count, uint32_t& out_write_idx,
+                            const uint64_t* exec_at_us, uint32_t& overwritten);
+
+    /**
+     * True while the Muscle is draining and does not need a notification.
+     */
+    bool notifySuppressed() const;
+
+    /**
+     * True once the Muscle has validated the header.
+     */
+    bool muscleAccepted() const;
+    bool layoutRejected() const;
+
+    /**
+     * True once the Muscle has latched an E-STOP, whatever raised it (its
+     * E-STOP input, a packet flag or CMD_ESTOP).
+     */
+    bool muscleEstop() const;
+
+    /**
+     * Bump brain_alive (one plain store, no interrupt). True if the
+     * Muscle's watchdog samples it, so no mailbox heartbeat is needed.
+     */
+    bool bumpAlive();
+
+    /**
+     * Re-read the Muscle's read_idx. Writes only do this when the cached
+     * copy makes the ring look full, so occupancy queries below may lag
+     * until the next refresh.
+     */
+    uint32_t refreshReadIdx();
     
     bool isFull() const;
     uint32_t available() const;
+    uint32_t getSlotCount() const { return m_slot_count; }
     
-    uint32_t getWriteIdx() const;
-    uint32_t getReadIdx() const;
+    uint32_t getWriteIdx() const { return m_write_idx; }
+    uint32_t getReadIdx() const { return m_read_cache; }
+
+    SharedRingHeader* getHeader() { return m_header; }
+
+    /**
+     * Copy up to max new Muscle event log records (see shared_log.h).
+     * Keeps its own cursor; call from one thread only.
+     * @param lost incremented by records overwritten before they were read
+     * @return number of records copied
+     */
+    size_t readLog(SharedLogRecord* out, size_t max, uint32_t& lost);
+
+    /**
+     * Copy up to max new Muscle ACK/NACK records (see shared_ack.h).
+     * Starts at the records written after map(). Call from one thread only.
+     * @param lost incremented by records overwritten before they were read
+     */
+    size_t readAcks(SharedAckRecord* out, size_t max, uint32_t& lost);
+
+    /**
+     * Snapshot the Muscle's telemetry block (see shared_telemetry.h).
+     * Safe from any thread. Returns false before the Muscle publishes it.
+     */
+    bool readTelemetry(SharedTelemetryData& out) const;
 
-    SharedMotionBuffer* getBuffer() { return m_buffer; }
+    /**
+     * Copy up to max of the Muscle's newest trace records (see
+     * shared_trace.h), oldest first. Safe from any thread.
+     */
+    size_t readTrace(SharedTraceRecord* out, size_t max) const;
+
+    /**
+     * Trace records appended after cursor (a record stamp; 0 = start),
+     * oldest first, advancing cursor past them. Resets when the Muscle
+     * restarts its trace.
+     */
+    size_t readTraceSince(uint32_t& cursor, SharedTraceRecord* out, size_t max) const;
+
+    /**
+     * Publish a latency probe request (see shared_probe.h); send CMD_PING
+     * with seq afterwards. Motion thread only.
+     */
+    void writeProbe(uint32_t seq, uint64_t tx_us);
+
+    /**
+     * Latest probe answer. Returns its seq, 0 if there is none yet or the
+     * Muscle was rewriting it.
+     */
+    uint32_t readProbe(uint64_t& tx_us, uint64_t& rx_us, uint64_t& echo_us) const;
+
+    /**
+     * Publish a tunables set for the Muscle (see shared_tunables.h).
+     * Returns its generation, 0 before map(). Motion thread only.
+     */
+    uint32_t writeTunables(const SharedTunablesData& data);
+
+    /**
+     * What the Muscle reports it runs with. False before map() or while
+     * the Muscle was rewriting it. Safe from any thread.
+     */
+    bool readTunablesApplied(SharedTunablesApplied& out) const;
 
 private:
-    SharedMotionBuffer* m_buffer = nullptr;
+    bool mapSlotsCached(uint32_t header_size);
+    template <typename Fill>
+    size_t writeSlots(size_t count, uint32_t& out_write_idx, Fill fill);
+    void fillSlot(SharedRingSlot& slot, const void* pkt, size_t len, uint64_t exec_at_us,
+                  uint32_t idx) const;
+
+    SharedRingHeader* m_header = nullptr;
+    uint8_t* m_slots = nullptr;
+    void* m_region = nullptr;
+    void* m_cached_map = nullptr;
+    size_t m_cached_len = 0;
+    uint32_t m_slot_count = 0;
+    uint32_t m_channels = SERVO_COUNT_TOTAL;
+    uint32_t m_slot_size = PACKET_SLOT_SIZE;
+    uint32_t m_write_idx = 0;       // Authoritative; we are the only writer
+    uint32_t m_read_cache = 0;      // Last read_idx seen from the Muscle
+    uint32_t m_alive = 0;
+    uint32_t m_log_cursor = 0;      // Next event log record to read
+    bool m_log_synced = false;
+    uint32_t m_ack_cursor = 0;      // Next ACK record to read
+    bool m_ack_synced = false;
+    bool m_want_cached = false;
+    bool m_cached = false;
     int m_mem_fd = -1;
+    int m_cached_fd = -1;
 };
 
 #endif // SHARED_MEMORY_H
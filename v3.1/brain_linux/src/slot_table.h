@@ -0,0 +1,123 @@
+/**
+ * Spider Robot v3.1 - Fixed-capacity Slot Table
+ *
+ * N slots of raw storage with a free list. acquire() constructs a T in a
+ * free slot and release() destroys it, so a slot's index and address
+ * stay put for as long as it is in use: references held across a
+ * dispatch and indices captured by event-loop callbacks remain valid
+ * while other entries come and go, and nothing is ever copied or moved.
+ * Each acquire() bumps the slot's generation, so a stale (index,
+ * generation) pair from an earlier occupant is recognised.
+ *
+ * Iteration visits the slots in use in index order. Not thread-safe.
+ */
+
+#ifndef SLOT_TABLE_H
+#define SLOT_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+template <typename T, int N>
+class SlotTable {
+    static_assert(N > 0 && N <= 32, "Slot mask is 32 bits");
+
+public:
+    SlotTable() {
+        for (int i = 0; i < N; i++) {
+            m_free[i] = N - 1 - i;      // Lowest index handed out first
+        }
+    }
+
+    ~SlotTable() { clear(); }
+
+    SlotTable(const SlotTable&) = delete;
+    SlotTable& operator=(const SlotTable&) = delete;
+
+    /**
+     * Construct a T in a free slot.
+     * @return its index, or -1 when all N are in use
+     */
+    int acquire() {
+        if (m_free_count == 0) return -1;
+        int idx = m_free[--m_free_count];
+        new (&m_storage[idx]) T();
+        m_used |= 1u << idx;
+        m_generation[idx]++;
+        return idx;
+    }
+
+    void release(int idx) {
+        if (!inUse(idx)) return;
+        (*this)[idx].~T();
+        m_used &= ~(1u << idx);
+        m_free[m_free_count++] = idx;
+    }
+
+    void clear() {
+        for (int i = 0; i < N; i++) {
+            release(i);
+        }
+    }
+
+    bool inUse(int idx) const { return idx >= 0 && idx < N && (m_used & (1u << idx)); }
+    uint32_t generation(int idx) const { return m_generation[idx]; }
+
+    /**
+     * The entry at idx if it is still the one acquired at generation gen.
+     */
+    T* get(int idx, uint32_t gen) {
+        return inUse(idx) && m_generation[idx] == gen ? &(*this)[idx] : nullptr;
+    }
+
+    T& operator[](int idx) { return *std::launder(reinterpret_cast<T*>(&m_storage[idx])); }
+    const T& operator[](int idx) const { return *std::launder(reinterpret_cast<const T*>(&m_storage[idx])); }
+
+    /**
+     * Index of an entry in this table.
+     */
+    int indexOf(const T& entry) const {
+        return (int)(reinterpret_cast<const Storage*>(&entry) - m_storage);
+    }
+
+    size_t size() const { return (size_t)__builtin_popcount(m_used); }
+    bool full() const { return m_free_count == 0; }
+    static constexpr int capacity() { return N; }
+
+    template <typename Table, typename Ref>
+    class Iter {
+    public:
+        Iter(Table* table, uint32_t rest) : m_table(table), m_rest(rest) {}
+        Ref operator*() const { return (*m_table)[__builtin_ctz(m_rest)]; }
+        Iter& operator++() {
+            m_rest &= m_rest - 1;
+            return *this;
+        }
+        bool operator!=(const Iter& other) const { return m_rest != other.m_rest; }
+
+    private:
+        Table* m_table;
+        uint32_t m_rest;                // Slots still to visit
+    };
+
+    // The set of slots to visit is taken when iteration starts
+    Iter<SlotTable, T&> begin() { return { this, m_used }; }
+    Iter<SlotTable, T&> end() { return { this, 0 }; }
+    Iter<const SlotTable, const T&> begin() const { return { this, m_used }; }
+    Iter<const SlotTable, const T&> end() const { return { this, 0 }; }
+
+private:
+    struct Storage {
+        alignas(T) unsigned char bytes[sizeof(T)];
+    };
+
+    Storage m_storage[N];
+    uint32_t m_generation[N] = {};
+    int m_free[N];
+    int m_free_count = N;
+    uint32_t m_used = 0;
+};
+
+#endif // SLOT_TABLE_H
@@ -0,0 +1,60 @@
+/**
+ * Spider Robot v3.1 - SPSC Ring
+ *
+ * Bounded lock-free single-producer/single-consumer queue.
+ * Exactly one thread may call push() and exactly one other thread may
+ * call pop(). Head and tail live on separate cache lines so the two
+ * sides do not contend.
+ */
+
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+
+template <typename T, size_t N>
+class SpscRing {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+public:
+    /**
+     * Producer side. Returns false if the ring is full.
+     */
+    bool push(const T& item) {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head - m_tail.load(std::memory_order_acquire) >= N) {
+            return false;
+        }
+        m_slots[head & (N - 1)] = item;
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Consumer side. Returns false if the ring is empty.
+     */
+    bool pop(T& out) {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail == m_head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        out = m_slots[tail & (N - 1)];
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t size() const {
+        return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire);
+    }
+
+    bool empty() const { return size() == 0; }
+    static constexpr size_t capacity() { return N; }
+
+private:
+    alignas(64) std::atomic<size_t> m_head{0};
+    alignas(64) std::atomic<size_t> m_tail{0};
+    alignas(64) T m_slots[N];
+};
+
+#endif // SPSC_RING_H
@@ -0,0 +1,214 @@
+/**
+ * Spider Robot v3.1 - Hierarchical Timer Wheel Implementation
+ */
+
+#include "timer_wheel.h"
+
+TimerWheel::TimerWheel(uint64_t now_ms) : m_now(now_ms), m_target(now_ms) {
+    for (int& head : m_heads) {
+        head = -1;
+    }
+}
+
+int TimerWheel::add(const char* name, uint32_t interval_ms, Callback cb) {
+    int id = (int)m_timers.size();
+    m_timers.emplace_back();
+    m_timers.back().cb = std::move(cb);
+    m_timers.back().stats.name = name;
+    setInterval(id, interval_ms);
+    return id;
+}
+
+void TimerWheel::setInterval(int id, uint32_t interval_ms) {
+    if (id < 0 || id >= count() || m_timers[id].removed) {
+        return;
+    }
+    Timer& t = m_timers[id];
+    unlink(id);
+    t.stats.interval_ms = interval_ms;
+    if (interval_ms > 0) {
+        t.expires = m_target + interval_ms;
+        place(id);
+    }
+}
+
+void TimerWheel::remove(int id) {
+    if (id < 0 || id >= count()) {
+        return;
+    }
+    // The callback is kept: the job may be the one running
+    setInterval(id, 0);
+    m_timers[id].removed = true;
+}
+
+const TimerWheel::Stats* TimerWheel::stats(int id) const {
+    if (id < 0 || id >= count() || m_timers[id].removed) {
+        return nullptr;
+    }
+    return &m_timers[id].stats;
+}
+
+void TimerWheel::link(int id, int list) {
+    Timer& t = m_timers[id];
+    t.list = list;
+    t.prev = -1;
+    t.next = m_heads[list];
+    if (t.next >= 0) {
+        m_timers[t.next].prev = id;
+    }
+    m_heads[list] = id;
+    if (list < SLOT_LISTS) {
+        m_occupied[list / TIMER_WHEEL_SLOTS] |= 1ULL << (list % TIMER_WHEEL_SLOTS);
+    }
+}
+
+void TimerWheel::unlink(int id) {
+    Timer& t = m_timers[id];
+    if (t.list < 0) {
+        return;
+    }
+    if (t.prev >= 0) {
+        m_timers[t.prev].next = t.next;
+    } else {
+        m_heads[t.list] = t.next;
+    }
+    if (t.next >= 0) {
+        m_timers[t.next].prev = t.prev;
+    }
+    if (m_heads[t.list] < 0 && t.list < SLOT_LISTS) {
+        m_occupied[t.list / TIMER_WHEEL_SLOTS] &= ~(1ULL << (t.list % TIMER_WHEEL_SLOTS));
+    }
+    t.list = t.prev = t.next = -1;
+}
+
+// Lowest level whose block still contains the deadline; expires > m_now,
+// so the slot is always ahead of the level's current one
+void TimerWheel::place(int id) {
+    uint64_t expires = m_timers[id].expires;
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        int shift = TIMER_WHEEL_BITS * (level + 1);
+        if ((expires >> shift) == (m_now >> shift)) {
+            int slot = (int)((expires >> (TIMER_WHEEL_BITS * level)) & SLOT_MASK);
+            link(id, level * TIMER_WHEEL_SLOTS + slot);
+            return;
+        }
+    }
+    link(id, OVERFLOW_LIST);
+}
+
+void TimerWheel::spread(int list) {
+    int id = m_heads[list];
+    m_heads[list] = -1;
+    if (list < SLOT_LISTS) {
+        m_occupied[list / TIMER_WHEEL_SLOTS] &= ~(1ULL << (list % TIMER_WHEEL_SLOTS));
+    }
+    while (id >= 0) {
+        int next = m_timers[id].next;
+        m_timers[id].list = -1;
+        place(id);
+        id = next;
+    }
+}
+
+// m_now just entered a new 64 ms block: bring down every higher-level slot
+// that starts here, the largest first
+void TimerWheel::cascade() {
+    int top = 1;
+    while (top < TIMER_WHEEL_LEVELS && ((m_now >> (TIMER_WHEEL_BITS * top)) & SLOT_MASK) == 0) {
+        top++;
+    }
+    if (top == TIMER_WHEEL_LEVELS) {
+        spread(OVERFLOW_LIST);
+        top--;
+    }
+    for (int level = top; level >= 1; level--) {
+        int slot = (int)((m_now >> (TIMER_WHEEL_BITS * level)) & SLOT_MASK);
+        spread(level * TIMER_WHEEL_SLOTS + slot);
+    }
+}
+
+int TimerWheel::fire(int slot) {
+    // Move the slot to the due list first; a job may disarm another due one
+    int id = m_heads[slot];
+    m_heads[slot] = -1;
+    m_occupied[0] &= ~(1ULL << slot);
+    for (int i = id; i >= 0; i = m_timers[i].next) {
+        m_timers[i].list = DUE_LIST;
+    }
+    m_heads[DUE_LIST] = id;
+
+    int ran = 0;
+    while ((id = m_heads[DUE_LIST]) >= 0) {
+        unlink(id);
+        Timer& t = m_timers[id];
+        uint64_t late = m_target - t.expires;
+        uint32_t interval = t.stats.interval_ms;
+
+        t.stats.runs++;
+        t.stats.late_total_ms += late;
+        if (late > t.stats.late_max_ms) {
+            t.stats.late_max_ms = (uint32_t)late;
+        }
+        // Re-armed before the call, so the job may change or stop its own period
+        uint64_t missed = late / interval;
+        t.stats.missed += missed;
+        t.expires += (missed + 1) * interval;
+        place(id);
+
+        t.cb();
+        ran++;
+    }
+    return ran;
+}
+
+int TimerWheel::advance(uint64_t now_ms) {
+    if (now_ms <= m_now) {
+        return 0;
+    }
+    m_target = now_ms;
+
+    int ran = 0;
+    for (;;) {
+        uint64_t idx = m_now & SLOT_MASK;
+        uint64_t ahead = idx == SLOT_MASK ? 0 : m_occupied[0] & (~0ULL << (idx + 1));
+        if (ahead) {
+            uint64_t due = (m_now & ~SLOT_MASK) + (uint64_t)__builtin_ctzll(ahead);
+            if (due > now_ms) {
+                break;
+            }
+            m_now = due;
+            ran += fire((int)(due & SLOT_MASK));
+            continue;
+        }
+        uint64_t next_block = (m_now | SLOT_MASK) + 1;
+        if (next_block > now_ms) {
+            break;
+        }
+        m_now = next_block;
+        cascade();
+        ran += fire(0);
+    }
+    m_now = now_ms;
+    return ran;
+}
+
+uint64_t TimerWheel::earliest(int list) const {
+    uint64_t first = UINT64_MAX;
+    for (int id = m_heads[list]; id >= 0; id = m_timers[id].next) {
+        if (m_timers[id].expires < first) first = m_timers[id].expires;
+    }
+    return first;
+}
+
+// Everything in the first occupied slot is due before anything in a later
+// one, so only that slot is walked
+uint64_t TimerWheel::nextDeadline() const {
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        uint64_t idx = (m_now >> (TIMER_WHEEL_BITS * level)) & SLOT_MASK;
+        uint64_t ahead = idx == SLOT_MASK ? 0 : m_occupied[level] & (~0ULL << (idx + 1));
+        if (ahead) {
+            return earliest(level * TIMER_WHEEL_SLOTS + __builtin_ctzll(ahead));
+        }
+    }
+    return earliest(OVERFLOW_LIST);
+}
@@ -0,0 +1,124 @@
+/**
+ * Spider Robot v3.1 - Hierarchical Timer Wheel
+ *
+ * The event loop's periodic jobs. Four levels of 64 slots at 1 ms
+ * resolution: level 0 holds what is due within the current 64 ms block,
+ * level 1 the rest of the current 4 s block in 64 ms slots, and so on up
+ * to about 4.6 hours; anything later waits in an overflow list. When time
+ * reaches a higher-level slot its jobs are spread over the levels below,
+ * so arming, disarming and firing cost the same however many jobs there
+ * are, and finding the next deadline takes a few bit scans and a walk of
+ * one slot.
+ *
+ * The wheel has no clock of its own. advance(now_ms) runs everything due
+ * by now_ms, and a job armed from inside a job counts from that same now.
+ * A periodic job keeps its phase; one that runs a whole period or more
+ * late has the missed runs dropped and counted rather than run back to
+ * back, as a timerfd would.
+ *
+ * Not thread-safe.
+ */
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+#define TIMER_WHEEL_BITS    6
+#define TIMER_WHEEL_SLOTS   (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS  4
+
+class TimerWheel {
+public:
+    using Callback = std::function<void()>;
+
+    struct Stats {
+        const char* name = "";
+        uint32_t interval_ms = 0;       // 0 while disarmed
+        uint64_t runs = 0;
+        uint64_t missed = 0;            // Periods dropped because a run came too late
+        uint64_t late_total_ms = 0;     // Sum of run time - deadline
+        uint32_t late_max_ms = 0;
+    };
+
+    explicit TimerWheel(uint64_t now_ms = 0);
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    /**
+     * Register a job, first due interval_ms from now (0 = disarmed).
+     * name must outlive the wheel.
+     * @return job id
+     */
+    int add(const char* name, uint32_t interval_ms, Callback cb);
+
+    /**
+     * Restart a job with a new period counted from now (0 = disarm).
+     */
+    void setInterval(int id, uint32_t interval_ms);
+
+    /**
+     * Disarm a job for good; its id is not reused.
+     */
+    void remove(int id);
+
+    /**
+     * Run every job due by now_ms, in deadline order. Time never goes back;
+     * an earlier now_ms runs nothing.
+     * @return number of jobs run
+     */
+    int advance(uint64_t now_ms);
+
+    /**
+     * When the next job is due, UINT64_MAX with none armed.
+     */
+    uint64_t nextDeadline() const;
+
+    uint64_t now() const { return m_target; }
+
+    /**
+     * Ids handed out so far, removed ones included.
+     */
+    int count() const { return (int)m_timers.size(); }
+
+    /**
+     * Statistics of a job, nullptr for an unknown or removed id.
+     */
+    const Stats* stats(int id) const;
+
+private:
+    static constexpr int SLOT_LISTS = TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS;
+    static constexpr int OVERFLOW_LIST = SLOT_LISTS;
+    static constexpr int DUE_LIST = SLOT_LISTS + 1;
+    static constexpr uint64_t SLOT_MASK = TIMER_WHEEL_SLOTS - 1;
+
+    struct Timer {
+        Callback cb;
+        Stats stats;
+        uint64_t expires = 0;
+        int list = -1;                  // Slot, overflow or due list; -1 while disarmed
+        int prev = -1;
+        int next = -1;
+        bool removed = false;
+    };
+
+    void link(int id, int list);
+    void unlink(int id);
+    void place(int id);
+    void spread(int list);
+    void cascade();
+    int fire(int slot);
+    uint64_t earliest(int list) const;
+
+    // A deque so jobs added from inside a running job leave it in place
+    std::deque<Timer> m_timers;
+    int m_heads[SLOT_LISTS + 2];
+    uint64_t m_occupied[TIMER_WHEEL_LEVELS] = {};
+    uint64_t m_now;                     // Every job due by here has run
+    uint64_t m_target;                  // now_ms of the advance() in progress
+};
+
+#endif // TIMER_WHEEL_H
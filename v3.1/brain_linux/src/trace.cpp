@@ -0,0 +1,129 @@
+/**
+ * Spider Robot v3.1 - Trace Recorder
+ */
+
+#include "trace.h"
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <map>
+#include <vector>
+
+extern "C" {
+#include "timebase.h"
+}
+
+#define TRACE_PID_BRAIN   1
+#define TRACE_PID_MUSCLE  2
+
+static_assert((TRACE_BRAIN_RECORDS & (TRACE_BRAIN_RECORDS - 1)) == 0,
+              "TRACE_BRAIN_RECORDS must be a power of two");
+
+// Same layout as the Muscle's area, so shared_trace_snapshot() reads both
+struct BrainTraceBuffer {
+    SharedTraceHeader hdr;
+    SharedTraceRecord recs[TRACE_BRAIN_RECORDS];
+};
+
+static BrainTraceBuffer s_trace = {
+    { SHARED_TRACE_MAGIC, SHARED_TRACE_VERSION, SHARED_TRACE_RECORD_SIZE, TRACE_BRAIN_RECORDS, 0, {} },
+    {}
+};
+
+void trace_point(uint16_t probe, uint32_t arg, uint32_t arg2) {
+    trace_point_at(probe, timebase_micros(), arg, arg2);
+}
+
+void trace_point_at(uint16_t probe, uint64_t time_us, uint32_t arg, uint32_t arg2) {
+    volatile SharedTraceHeader* tr = &s_trace.hdr;
+
+    // Several threads record, so slots are claimed atomically; a slot is
+    // skipped by readers until its stamp matches
+    uint32_t idx = __atomic_fetch_add(&tr->write_idx, 1, __ATOMIC_RELAXED);
+    volatile SharedTraceRecord* rec = shared_trace_record(tr, idx);
+
+    SHARED_STORE_RELEASE(&rec->stamp, 0u);
+    rec->probe = probe;
+    rec->time_us = time_us;
+    rec->arg = arg;
+    rec->arg2 = arg2;
+    SHARED_STORE_RELEASE(&rec->stamp, idx + 1);
+}
+
+size_t trace_snapshot(SharedTraceRecord* out, size_t max) {
+    return shared_trace_snapshot(&s_trace.hdr, out, max);
+}
+
+static void appendf(std::string& out, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void appendf(std::string& out, const char* fmt, ...) {
+    char buf[256];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    if (n > 0) {
+        out.append(buf, std::min((size_t)n, sizeof(buf) - 1));
+    }
+}
+
+std::string trace_export_json(const SharedTraceRecord* recs, size_t n) {
+    std::vector<SharedTraceRecord> sorted(recs, recs + n);
+    std::stable_sort(sorted.begin(), sorted.end(),
+        [](const SharedTraceRecord& a, const SharedTraceRecord& b) { return a.time_us < b.time_us; });
+
+    uint64_t base = sorted.empty() ? 0 : sorted.front().time_us;
+
+    std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    appendf(out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"Brain\"}},", TRACE_PID_BRAIN);
+    appendf(out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"Muscle\"}}", TRACE_PID_MUSCLE);
+
+    // One track per probe, ordered along the path
+    bool seen[256] = {};
+    for (const SharedTraceRecord& r : sorted) {
+        uint8_t p = (uint8_t)r.probe;
+        if (seen[p]) continue;
+        seen[p] = true;
+        int pid = (r.probe >= SHARED_TRACE_MUSCLE_FIRST) ? TRACE_PID_MUSCLE : TRACE_PID_BRAIN;
+        appendf(out, ",{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                pid, (unsigned)r.probe, shared_trace_probe_name(r.probe));
+        appendf(out, ",{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"args\":{\"sort_index\":%u}}",
+                pid, (unsigned)r.probe, (unsigned)r.probe);
+    }
+
+    struct Span { uint64_t first; uint64_t last; int hits; };
+    std::map<uint32_t, Span> spans;
+
+    for (const SharedTraceRecord& r : sorted) {
+        int pid = (r.probe >= SHARED_TRACE_MUSCLE_FIRST) ? TRACE_PID_MUSCLE : TRACE_PID_BRAIN;
+        bool has_seq = shared_trace_probe_has_seq(r.probe);
+        appendf(out, ",{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%llu,"
+                     "\"pid\":%d,\"tid\":%u,\"args\":{\"%s\":%u,\"arg2\":%u}}",
+                shared_trace_probe_name(r.probe), pid == TRACE_PID_BRAIN ? "brain" : "muscle",
+                (unsigned long long)(r.time_us - base), pid, (unsigned)r.probe,
+                has_seq ? "seq" : "arg", r.arg, r.arg2);
+
+        if (has_seq && r.arg != 0) {
+            auto it = spans.find(r.arg);
+            if (it == spans.end()) {
+                spans[r.arg] = { r.time_us, r.time_us, 1 };
+            } else {
+                it->second.last = r.time_us;
+                it->second.hits++;
+            }
+        }
+    }
+
+    // Packet lifetimes as async slices, so the gaps between probes are visible per seq
+    for (const auto& kv : spans) {
+        if (kv.second.hits < 2) continue;
+        appendf(out, ",{\"name\":\"seq %u\",\"cat\":\"packet\",\"ph\":\"b\",\"id\":%u,\"ts\":%llu,\"pid\":%d,\"tid\":0}",
+                kv.first, kv.first, (unsigned long long)(kv.second.first - base), TRACE_PID_BRAIN);
+        appendf(out, ",{\"name\":\"seq %u\",\"cat\":\"packet\",\"ph\":\"e\",\"id\":%u,\"ts\":%llu,\"pid\":%d,\"tid\":0}",
+                kv.first, kv.first, (unsigned long long)(kv.second.last - base), TRACE_PID_BRAIN);
+    }
+
+    appendf(out, "],\"otherData\":{\"base_us\":%llu,\"records\":%zu}}", (unsigned long long)base, n);
+    return out;
+}
@@ -0,0 +1,44 @@
+/**
+ * Spider Robot v3.1 - Trace Recorder
+ *
+ * Brain half of the latency trace (common/shared_trace.h). trace_point()
+ * appends one 32-byte record to an in-process ring on the shared
+ * timebase; it is lock-free and safe from any thread, including the RT
+ * motion thread. trace_export_json() merges Brain and Muscle records
+ * into Chrome trace / Perfetto JSON.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+extern "C" {
+#include "shared_trace.h"
+}
+
+#define TRACE_BRAIN_RECORDS 2048
+
+/**
+ * Record probe now / at time_us (timebase_micros()).
+ */
+void trace_point(uint16_t probe, uint32_t arg, uint32_t arg2 = 0);
+void trace_point_at(uint16_t probe, uint64_t time_us, uint32_t arg, uint32_t arg2 = 0);
+
+/**
+ * Copy up to max of the newest Brain records, oldest first.
+ */
+size_t trace_snapshot(SharedTraceRecord* out, size_t max);
+
+/**
+ * Chrome trace JSON ({"traceEvents":[...]}) for the given records, in
+ * any order. Each probe is an instant event on its own track, Brain
+ * probes under pid 1 and Muscle probes under pid 2; every packet seq
+ * seen at two or more probes also gets an async slice spanning them.
+ * Timestamps are relative to the earliest record.
+ */
+std::string trace_export_json(const SharedTraceRecord* recs, size_t n);
+
+#endif // TRACE_H
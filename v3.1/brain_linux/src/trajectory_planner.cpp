@@ -0,0 +1,123 @@
+/**
+ * Spider Robot v3.1 - Trajectory Planner Implementation
+ */
+
+#include "trajectory_planner.h"
+
+#include <cmath>
+#include <cstring>
+
+static const float PI_F = 3.14159265358979f;
+static const int MAX_STRETCH_STEPS = 64;
+
+TrajectoryPlanner::Limits::Limits() {
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) {
+        vel_us_per_s[i] = SERVO_VEL_MAX_US_PER_S;
+        acc_us_per_s2[i] = SERVO_ACC_MAX_US_PER_S2;
+    }
+}
+
+const char* TrajectoryPlanner::profileName(Profile profile) {
+    switch (profile) {
+        case Profile::NONE:      return "linear";
+        case Profile::TRAPEZOID: return "trapezoid";
+        case Profile::SCURVE:    return "scurve";
+    }
+    return "unknown";
+}
+
+bool TrajectoryPlanner::parseProfile(const char* name, Profile& out) {
+    if (strcmp(name, "linear") == 0) out = Profile::NONE;
+    else if (strcmp(name, "trapezoid") == 0) out = Profile::TRAPEZOID;
+    else if (strcmp(name, "scurve") == 0) out = Profile::SCURVE;
+    else return false;
+    return true;
+}
+
+uint32_t TrajectoryPlanner::start(const uint16_t* from_us, const uint16_t* to_us, uint16_t mask,
+                                  uint32_t min_ms, Profile profile) {
+    m_profile = (profile == Profile::SCURVE) ? Profile::SCURVE : Profile::TRAPEZOID;
+    m_mask = mask;
+    m_elapsed_ms = 0;
+
+    // Sinusoidal ramps peak at pi/2 times the acceleration of linear ones
+    float ramp_gain = (m_profile == Profile::SCURVE) ? PI_F / 2.0f : 1.0f;
+
+    // Slowest joint on its own: triangular if it never reaches full speed
+    float duration = (float)min_ms / 1000.0f;
+    float dist[SERVO_COUNT_TOTAL];
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) {
+        m_from[i] = from_us[i];
+        m_delta[i] = (mask & (1u << i)) ? (float)to_us[i] - (float)from_us[i] : 0.0f;
+        dist[i] = std::fabs(m_delta[i]);
+        if (dist[i] == 0.0f) continue;
+
+        float v = m_limits.vel_us_per_s[i];
+        float a = m_limits.acc_us_per_s2[i] / ramp_gain;
+        float t = (dist[i] <= v * v / a) ? 2.0f * std::sqrt(dist[i] / a) : dist[i] / v + v / a;
+        if (t > duration) duration = t;
+    }
+
+    // One shared shape: the ramp fraction must keep every joint under both limits
+    float alpha = 0.5f;
+    for (int step = 0; duration > 0.0f && step < MAX_STRETCH_STEPS; step++) {
+        alpha = 0.5f;
+        float need = 0.0f;
+        for (int i = 0; i < SERVO_COUNT_TOTAL; i++) {
+            if (dist[i] == 0.0f) continue;
+            float a_max = 1.0f - dist[i] / (duration * m_limits.vel_us_per_s[i]);
+            if (a_max < alpha) alpha = a_max;
+            float k = ramp_gain * dist[i] / (m_limits.acc_us_per_s2[i] * duration * duration);
+            if (k > need) need = k;
+        }
+        if (alpha >= PLANNER_MIN_ACCEL_FRAC && alpha * (1.0f - alpha) >= need * 0.9999f) break;
+        duration *= 1.05f;
+    }
+    if (alpha < PLANNER_MIN_ACCEL_FRAC) alpha = PLANNER_MIN_ACCEL_FRAC;
+
+    m_duration_s = duration;
+    m_accel_frac = alpha;
+    m_active = true;
+    return durationMs();
+}
+
+float TrajectoryPlanner::progress(float tau) const {
+    if (tau <= 0.0f) return 0.0f;
+    if (tau >= 1.0f) return 1.0f;
+
+    float a = m_accel_frac;
+    float vp = 1.0f / (1.0f - a);       // Cruise speed, in distance per duration
+    bool tail = tau > 1.0f - a;
+    float x = tail ? 1.0f - tau : tau;
+
+    float s;
+    if (x >= a) {
+        s = vp * (x - a / 2.0f);
+    } else if (m_profile == Profile::SCURVE) {
+        s = vp * (x / 2.0f - a / (2.0f * PI_F) * std::sin(PI_F * x / a));
+    } else {
+        s = vp * x * x / (2.0f * a);
+    }
+    return tail ? 1.0f - s : s;
+}
+
+bool TrajectoryPlanner::next(uint16_t* servo_us, uint32_t& t_ms) {
+    if (!m_active) return false;
+
+    // Fold a short remainder into the last keyframe rather than sending a sliver
+    uint32_t total = durationMs();
+    uint32_t left = total - m_elapsed_ms;
+    uint32_t step = (left < PLANNER_SEGMENT_MS + PLANNER_SEGMENT_MS / 2) ? left : PLANNER_SEGMENT_MS;
+    m_elapsed_ms += step;
+
+    float s = (total == 0) ? 1.0f : progress((float)m_elapsed_ms / (float)total);
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) {
+        if (m_mask & (1u << i)) {
+            servo_us[i] = (uint16_t)std::lround(m_from[i] + m_delta[i] * s);
+        }
+    }
+
+    t_ms = step;
+    if (m_elapsed_ms >= total) m_active = false;
+    return true;
+}
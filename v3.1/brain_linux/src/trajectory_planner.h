@@ -0,0 +1,85 @@
+#ifndef TRAJECTORY_PLANNER_H
+#define TRAJECTORY_PLANNER_H
+
+#include <cstdint>
+
+extern "C" {
+#include "limits.h"
+}
+
+/**
+ * TrajectoryPlanner - Velocity and acceleration limited joint moves
+ *
+ * Turns one move (start pose, target pose, minimum duration) into
+ * keyframes sampled every PLANNER_SEGMENT_MS along a trapezoidal or
+ * S-curve (sinusoidal ramp) velocity profile. All joints share the
+ * duration and profile shape, so they start and arrive together; the
+ * duration is stretched until every joint stays within its velocity and
+ * acceleration limit (SERVO_VEL_MAX / SERVO_ACC_MAX by default).
+ *
+ * Owned by the motion thread like GaitEngine and MotionPlayer, which
+ * schedules the samples in the ring; the Muscle joins them with its
+ * Hermite segments.
+ */
+#define PLANNER_SEGMENT_MS      40      // Two Muscle output ticks per keyframe
+#define PLANNER_MIN_ACCEL_FRAC  0.05f   // Shortest ramp, as a fraction of the move
+
+class TrajectoryPlanner {
+public:
+    enum class Profile : uint8_t {
+        NONE,           // Not planned: one packet, the Muscle interpolates
+        TRAPEZOID,      // Constant acceleration ramps
+        SCURVE          // Sinusoidal ramps, continuous acceleration
+    };
+
+    struct Limits {
+        float vel_us_per_s[SERVO_COUNT_TOTAL];
+        float acc_us_per_s2[SERVO_COUNT_TOTAL];
+
+        Limits();       // SERVO_VEL_MAX_US_PER_S / SERVO_ACC_MAX_US_PER_S2 on every channel
+    };
+
+    static const char* profileName(Profile profile);
+    static bool parseProfile(const char* name, Profile& out);
+
+    void setLimits(const Limits& limits) { m_limits = limits; }
+    const Limits& limits() const { return m_limits; }
+
+    /**
+     * Plan a move of the mask channels from from_us to to_us taking at
+     * least min_ms. Replaces any move in progress.
+     * @return planned duration in ms
+     */
+    uint32_t start(const uint16_t* from_us, const uint16_t* to_us, uint16_t mask,
+                   uint32_t min_ms, Profile profile);
+
+    void stop() { m_active = false; }
+    bool active() const { return m_active; }
+    uint16_t mask() const { return m_active ? m_mask : 0; }
+    uint32_t durationMs() const { return (uint32_t)(m_duration_s * 1000.0f + 0.5f); }
+
+    /**
+     * Next sample: pulse widths for the mask channels and the time to
+     * reach them. The last sample is exactly the target. Returns false
+     * once the move is complete.
+     */
+    bool next(uint16_t* servo_us, uint32_t& t_ms);
+
+    /**
+     * Fraction of the distance covered at fraction tau of the duration.
+     */
+    float progress(float tau) const;
+
+private:
+    Limits m_limits;
+    Profile m_profile = Profile::TRAPEZOID;
+    bool m_active = false;
+    uint16_t m_mask = 0;
+    float m_from[SERVO_COUNT_TOTAL];
+    float m_delta[SERVO_COUNT_TOTAL];
+    float m_duration_s = 0.0f;
+    float m_accel_frac = 0.5f;      // Ramp length as a fraction of the duration
+    uint32_t m_elapsed_ms = 0;
+};
+
+#endif // TRAJECTORY_PLANNER_H
@@ -0,0 +1,166 @@
+/**
+ * Spider Robot v3.1 - Runtime Tunables Implementation
+ */
+
+#include "tunables.h"
+#include "logger.h"
+
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+static const char* TAG = "Tunables";
+
+// Brain-side defaults are the ObstacleAvoider::Config and initScanController() ones
+static const Tunables::Info s_info[Tunables::COUNT] = {
+    { "output_hz",            TUNABLE_OUTPUT_HZ_MIN,    TUNABLE_OUTPUT_HZ_MAX,    MOTION_UPDATE_HZ,                true  },
+    { "interp_substeps",      INTERP_SUBSTEPS_MIN,      INTERP_SUBSTEPS_MAX,      TUNABLE_INTERP_SUBSTEPS_DEFAULT, true  },
+    { "heartbeat_timeout_ms", TUNABLE_HEARTBEAT_MS_MIN, TUNABLE_HEARTBEAT_MS_MAX, HEARTBEAT_TIMEOUT_MS,            true  },
+    { "avoid_critical_mm",    1,    4000, 120,  false },
+    { "avoid_warning_mm",     1,    4000, 250,  false },
+    { "avoid_safe_mm",        1,    4000, 400,  false },
+    { "scan_min_deg",         0,    180,  20,   false },
+    { "scan_max_deg",         0,    180,  160,  false },
+    { "scan_step_deg",        1,    90,   10,   false },
+    { "scan_dwell_ms",        0,    1000, 10,   false },
+    { "scan_servo_deg_per_s", 10,   5000, 500,  false },
+};
+
+const Tunables::Info& Tunables::info(Id id) {
+    return s_info[id];
+}
+
+bool Tunables::find(const char* name, Id& out) {
+    for (int i = 0; i < COUNT; i++) {
+        if (strcmp(s_info[i].name, name) == 0) {
+            out = (Id)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+Tunables::Tunables() {
+    for (int i = 0; i < COUNT; i++) {
+        m_values[i] = s_info[i].def;
+    }
+}
+
+bool Tunables::consistent() const {
+    return m_values[AVOID_CRITICAL_MM] <= m_values[AVOID_WARNING_MM] &&
+           m_values[AVOID_WARNING_MM] <= m_values[AVOID_SAFE_MM] &&
+           m_values[SCAN_MIN_DEG] < m_values[SCAN_MAX_DEG];
+}
+
+bool Tunables::set(const Id* ids, const int32_t* values, size_t count) {
+    Tunables t = *this;
+    for (size_t i = 0; i < count; i++) {
+        Id id = ids[i];
+        if (id < 0 || id >= COUNT || values[i] < s_info[id].min || values[i] > s_info[id].max) {
+            return false;
+        }
+        t.m_values[id] = values[i];
+    }
+    if (!t.consistent()) {
+        return false;
+    }
+    *this = t;
+    return true;
+}
+
+bool Tunables::muscleDiffers(const Tunables& other) const {
+    for (int i = 0; i < COUNT; i++) {
+        if (s_info[i].muscle && m_values[i] != other.m_values[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Tunables::parse(const char* text, size_t len, Tunables& out, int* bad_line) {
+    // Orderings are checked on the finished set, so a file may raise
+    // critical_mm past the old warning_mm before it raises warning_mm
+    Tunables t = out;
+    int line_no = 0;
+    size_t pos = 0;
+    while (pos < len) {
+        size_t end = pos;
+        while (end < len && text[end] != '\n') end++;
+        std::string line(text + pos, end - pos);
+        pos = end + 1;
+        line_no++;
+
+        size_t hash = line.find('#');
+        if (hash != std::string::npos) line.erase(hash);
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos) continue;
+
+        size_t eq = line.find('=');
+        if (eq == std::string::npos) {
+            if (bad_line) *bad_line = line_no;
+            return false;
+        }
+        std::string name = line.substr(0, eq);
+        name.erase(0, name.find_first_not_of(" \t"));
+        name.erase(name.find_last_not_of(" \t") + 1);
+        std::string value = line.substr(eq + 1);
+
+        Id id;
+        char* vend = nullptr;
+        errno = 0;
+        long v = strtol(value.c_str(), &vend, 0);
+        while (vend && isspace((unsigned char)*vend)) vend++;
+        if (!find(name.c_str(), id) || vend == value.c_str() || *vend != '\0' || errno != 0 ||
+            v < s_info[id].min || v > s_info[id].max) {
+            if (bad_line) *bad_line = line_no;
+            return false;
+        }
+        t.m_values[id] = (int32_t)v;
+    }
+
+    if (!t.consistent()) {
+        if (bad_line) *bad_line = 0;
+        return false;
+    }
+    out = t;
+    return true;
+}
+
+bool Tunables::load(const char* path, Tunables& out) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        LOG_WARN(TAG, "Cannot open %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    std::string text;
+    char buf[1024];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        text.append(buf, n);
+    }
+    fclose(f);
+
+    int bad_line = 0;
+    if (!parse(text.data(), text.size(), out, &bad_line)) {
+        if (bad_line > 0) {
+            LOG_ERROR(TAG, "%s:%d: unknown name or value out of range", path, bad_line);
+        } else {
+            LOG_ERROR(TAG, "%s: thresholds out of order", path);
+        }
+        return false;
+    }
+    LOG_INFO(TAG, "Loaded tunables from %s", path);
+    return true;
+}
+
+SharedTunablesData Tunables::muscleData() const {
+    SharedTunablesData d;
+    d.output_hz = (uint32_t)m_values[OUTPUT_HZ];
+    d.interp_substeps = (uint32_t)m_values[INTERP_SUBSTEPS];
+    d.heartbeat_timeout_ms = (uint32_t)m_values[HEARTBEAT_MS];
+    return d;
+}
@@ -0,0 +1,92 @@
+/**
+ * Spider Robot v3.1 - Runtime Tunables
+ *
+ * Timing and threshold constants that used to need a rebuild, as one
+ * named, range-checked set the daemon can change while it runs. The
+ * Muscle's share (output rate, interpolation substeps, heartbeat
+ * timeout) goes out through the shared tunables block
+ * (common/shared_tunables.h) and is applied at the Muscle's next tick;
+ * the rest steers the Brain's obstacle avoider and scan profile.
+ *
+ * Files are plain text, one "name = value" per line, '#' starts a
+ * comment. Names left out keep their current value.
+ */
+
+#ifndef TUNABLES_H
+#define TUNABLES_H
+
+#include <cstddef>
+#include <cstdint>
+
+extern "C" {
+#include "shared_tunables.h"
+}
+
+class Tunables {
+public:
+    enum Id {
+        OUTPUT_HZ,
+        INTERP_SUBSTEPS,
+        HEARTBEAT_MS,
+        AVOID_CRITICAL_MM,
+        AVOID_WARNING_MM,
+        AVOID_SAFE_MM,
+        SCAN_MIN_DEG,
+        SCAN_MAX_DEG,
+        SCAN_STEP_DEG,
+        SCAN_DWELL_MS,
+        SCAN_SERVO_DEG_PER_S,
+        COUNT
+    };
+
+    struct Info {
+        const char* name;
+        int32_t min;
+        int32_t max;
+        int32_t def;
+        bool muscle;            // Published to the Muscle
+    };
+
+    static const Info& info(Id id);
+    static bool find(const char* name, Id& out);
+
+    Tunables();     // All defaults
+
+    int32_t get(Id id) const { return m_values[id]; }
+
+    /**
+     * Set count values at once, checked as a whole. False, and nothing
+     * changed, if one is out of its range or the result breaks an
+     * ordering (critical <= warning <= safe, scan min < max).
+     */
+    bool set(const Id* ids, const int32_t* values, size_t count);
+    bool set(Id id, int32_t value) { return set(&id, &value, 1); }
+
+    /**
+     * True if any of the Muscle's values differ from other's.
+     */
+    bool muscleDiffers(const Tunables& other) const;
+
+    /**
+     * Apply "name = value" lines on top of out. out is left untouched on
+     * failure; bad_line (if given) gets the 1-based line at fault.
+     */
+    static bool parse(const char* text, size_t len, Tunables& out, int* bad_line = nullptr);
+
+    /**
+     * Read and parse a file on top of out, as parse().
+     */
+    static bool load(const char* path, Tunables& out);
+
+    /**
+     * The Muscle's share, for shared_tunables_publish().
+     */
+    SharedTunablesData muscleData() const;
+
+private:
+    bool consistent() const;
+
+    int32_t m_values[COUNT];
+};
+
+#endif // TUNABLES_H
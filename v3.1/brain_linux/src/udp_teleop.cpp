@@ -0,0 +1,242 @@
+/**
+ * Spider Robot v3.1 - UDP Teleoperation Endpoint Implementation
+ */
+
+#include "udp_teleop.h"
+#include "logger.h"
+#include "sha1.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+UdpTeleop::~UdpTeleop() {
+    close();
+}
+
+bool UdpTeleop::setKey(const uint8_t* key, size_t len) {
+    if (len == 0 || len > UDP_TELEOP_KEY_MAX) {
+        return false;
+    }
+    // HMAC: the key zero-padded to a block, xored with each pad
+    memset(m_ipad, 0x36, sizeof(m_ipad));
+    memset(m_opad, 0x5C, sizeof(m_opad));
+    for (size_t i = 0; i < len; i++) {
+        m_ipad[i] ^= key[i];
+        m_opad[i] ^= key[i];
+    }
+    m_keyed = true;
+    return true;
+}
+
+bool UdpTeleop::loadKey(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        LOG_ERROR("UDP", "Cannot open key file %s: %s", path, strerror(errno));
+        return false;
+    }
+    uint8_t key[UDP_TELEOP_KEY_MAX + 2];
+    size_t len = fread(key, 1, sizeof(key), f);
+    fclose(f);
+
+    if (len > 0 && key[len - 1] == '\n') len--;
+    if (len > 0 && key[len - 1] == '\r') len--;
+    if (!setKey(key, len)) {
+        LOG_ERROR("UDP", "Key in %s must be 1-%d bytes", path, UDP_TELEOP_KEY_MAX);
+        return false;
+    }
+    return true;
+}
+
+bool UdpTeleop::open(uint16_t port) {
+    if (!m_keyed) {
+        LOG_ERROR("UDP", "Teleop needs a key (--udp-key)");
+        return false;
+    }
+    m_fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m_fd < 0) {
+        LOG_ERROR("UDP", "socket() failed: %s", strerror(errno));
+        return false;
+    }
+
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons(port);
+    if (bind(m_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        LOG_ERROR("UDP", "bind() failed: %s", strerror(errno));
+        close();
+        return false;
+    }
+
+    LOG_INFO("UDP", "Teleop listening on port %u", port);
+    return true;
+}
+
+void UdpTeleop::close() {
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+void UdpTeleop::tag(const uint8_t* data, size_t len, uint8_t out[20]) const {
+    uint8_t inner[UDP_TELEOP_KEY_MAX + UDP_TELEOP_DATAGRAM_MAX];
+    memcpy(inner, m_ipad, UDP_TELEOP_KEY_MAX);
+    memcpy(inner + UDP_TELEOP_KEY_MAX, data, len);
+    uint8_t inner_hash[20];
+    sha1(inner, UDP_TELEOP_KEY_MAX + len, inner_hash);
+
+    uint8_t outer[UDP_TELEOP_KEY_MAX + 20];
+    memcpy(outer, m_opad, UDP_TELEOP_KEY_MAX);
+    memcpy(outer + UDP_TELEOP_KEY_MAX, inner_hash, 20);
+    sha1(outer, sizeof(outer), out);
+}
+
+size_t UdpTeleop::seal(const UdpTeleopHeader& hdr, const void* payload, size_t len, uint8_t* out) const {
+    size_t body = sizeof(hdr) + len;
+    memcpy(out, &hdr, sizeof(hdr));
+    memcpy(out + sizeof(hdr), payload, len);
+    uint8_t mac[20];
+    tag(out, body, mac);
+    memcpy(out + body, mac, UDP_TELEOP_TAG_LEN);
+    return body + UDP_TELEOP_TAG_LEN;
+}
+
+UdpTeleop::Verdict UdpTeleop::accept(const uint8_t* data, size_t len, uint32_t now_ms, Latest& out) {
+    UdpTeleopHeader hdr;
+    if (len < sizeof(hdr) + UDP_TELEOP_TAG_LEN) {
+        m_stats.malformed++;
+        return Verdict::MALFORMED;
+    }
+    memcpy(&hdr, data, sizeof(hdr));
+
+    size_t payload = hdr.msg == UDP_TELEOP_MSG_WALK ? sizeof(UdpTeleopWalk)
+                   : hdr.msg == UDP_TELEOP_MSG_POSE ? sizeof(WsPoseEntry) : 0;
+    if (hdr.magic != UDP_TELEOP_MAGIC || hdr.version != UDP_TELEOP_VERSION || payload == 0 || hdr.session == 0 ||
+        len != sizeof(hdr) + payload + UDP_TELEOP_TAG_LEN) {
+        m_stats.malformed++;
+        return Verdict::MALFORMED;
+    }
+
+    // Constant time: how much of a forged tag matched must not show
+    uint8_t mac[20];
+    tag(data, len - UDP_TELEOP_TAG_LEN, mac);
+    uint8_t diff = 0;
+    for (int i = 0; i < UDP_TELEOP_TAG_LEN; i++) {
+        diff |= mac[i] ^ data[len - UDP_TELEOP_TAG_LEN + i];
+    }
+    if (diff != 0) {
+        m_stats.bad_tag++;
+        return Verdict::BAD_TAG;
+    }
+
+    uint32_t delay = now_ms - hdr.sent_ms;
+    if (!m_active || hdr.session != m_session) {
+        // One driver at a time; a restarted or second client waits out the deadman
+        if (m_active && now_ms - m_last_ms < UDP_TELEOP_DEADMAN_MS) {
+            m_stats.busy++;
+            return Verdict::BUSY;
+        }
+        // A session that has ended stays ended, or its captured datagrams could restart it
+        for (uint32_t retired : m_retired) {
+            if (retired == hdr.session) {
+                m_stats.out_of_order++;
+                return Verdict::OUT_OF_ORDER;
+            }
+        }
+        if (m_active) {
+            m_retired[m_retired_next] = m_session;
+            m_retired_next = (m_retired_next + 1) % UDP_TELEOP_RETIRED;
+        }
+        m_active = true;
+        m_session = hdr.session;
+        m_min_delay = delay;
+    } else {
+        if ((int32_t)(hdr.seq - m_seq) <= 0) {
+            m_stats.out_of_order++;
+            return Verdict::OUT_OF_ORDER;
+        }
+        // Clock offset plus the quickest transit yet; anything slower queued somewhere
+        int32_t excess = (int32_t)(delay - m_min_delay);
+        if (excess < 0) {
+            m_min_delay = delay;
+        } else if (excess > UDP_TELEOP_MAX_AGE_MS) {
+            m_stats.stale++;
+            return Verdict::STALE;
+        }
+    }
+    m_seq = hdr.seq;
+    m_last_ms = now_ms;
+    m_stats.accepted++;
+
+    const uint8_t* body = data + sizeof(hdr);
+    if (hdr.msg == UDP_TELEOP_MSG_WALK) {
+        if (out.walk) m_stats.superseded++;
+        out.walk = true;
+        out.walk_hdr = hdr;
+        memcpy(&out.walk_msg, body, sizeof(out.walk_msg));
+    } else {
+        if (out.pose) m_stats.superseded++;
+        out.pose = true;
+        out.pose_hdr = hdr;
+        memcpy(&out.pose_msg, body, sizeof(out.pose_msg));
+    }
+    out.last = hdr;
+    return Verdict::ACCEPTED;
+}
+
+int UdpTeleop::drain(uint32_t now_ms, Latest& out) {
+    uint8_t bufs[UDP_TELEOP_BATCH][UDP_TELEOP_DATAGRAM_MAX];
+    struct sockaddr_in addrs[UDP_TELEOP_BATCH];
+    struct iovec iov[UDP_TELEOP_BATCH];
+    struct mmsghdr msgs[UDP_TELEOP_BATCH];
+
+    int accepted = 0;
+    for (;;) {
+        memset(msgs, 0, sizeof(msgs));
+        for (int i = 0; i < UDP_TELEOP_BATCH; i++) {
+            iov[i].iov_base = bufs[i];
+            iov[i].iov_len = sizeof(bufs[i]);
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_name = &addrs[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+        }
+
+        int n = recvmmsg(m_fd, msgs, UDP_TELEOP_BATCH, MSG_DONTWAIT, nullptr);
+        if (n <= 0) {
+            if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                LOG_WARN("UDP", "recvmmsg() failed: %s", strerror(errno));
+            }
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            // Truncated datagrams were longer than any valid one
+            size_t len = (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) ? 0 : msgs[i].msg_len;
+            if (accept(bufs[i], len, now_ms, out) == Verdict::ACCEPTED) {
+                m_peer = addrs[i];
+                m_has_peer = true;
+                accepted++;
+            }
+        }
+        if (n < UDP_TELEOP_BATCH) break;
+    }
+    return accepted;
+}
+
+bool UdpTeleop::sendStatus(const UdpTeleopHeader& hdr, const UdpTeleopStatus& status) {
+    if (m_fd < 0 || !m_has_peer) {
+        return false;
+    }
+    UdpTeleopHeader reply = hdr;
+    reply.msg = UDP_TELEOP_MSG_STATUS;
+
+    uint8_t buf[sizeof(UdpTeleopHeader) + sizeof(UdpTeleopStatus) + UDP_TELEOP_TAG_LEN];
+    size_t len = seal(reply, &status, sizeof(status), buf);
+    return sendto(m_fd, buf, len, MSG_DONTWAIT, (struct sockaddr*)&m_peer, sizeof(m_peer)) == (ssize_t)len;
+}
@@ -0,0 +1,143 @@
+/**
+ * Spider Robot v3.1 - UDP Teleoperation Endpoint
+ *
+ * Owns the --udp-port socket and enforces the rules of udp_teleop_binary.h:
+ * tag, session, sequence and age. Each wakeup drains the socket with
+ * recvmmsg() and leaves only the newest walk and the newest pose for
+ * the daemon to act on, so a burst that queued up behind a slow loop
+ * iteration costs one motion update, not one per datagram.
+ *
+ * Owned by the I/O thread; not thread-safe.
+ */
+
+#ifndef UDP_TELEOP_H
+#define UDP_TELEOP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <netinet/in.h>
+
+extern "C" {
+#include "udp_teleop_binary.h"
+}
+
+#define UDP_TELEOP_BATCH    16      // Datagrams per recvmmsg()
+#define UDP_TELEOP_RETIRED  8       // Ended sessions refused for good
+
+class UdpTeleop {
+public:
+    enum class Verdict {
+        ACCEPTED,
+        MALFORMED,          // Wrong magic, version, type or length
+        BAD_TAG,
+        OUT_OF_ORDER,       // seq not above the last accepted one
+        STALE,              // Held up in flight past UDP_TELEOP_MAX_AGE_MS
+        BUSY                // Another session is still active
+    };
+
+    struct Stats {
+        uint32_t accepted = 0;
+        uint32_t superseded = 0;    // Accepted, then replaced in the same drain
+        uint32_t malformed = 0;
+        uint32_t bad_tag = 0;
+        uint32_t out_of_order = 0;
+        uint32_t stale = 0;
+        uint32_t busy = 0;
+    };
+
+    /**
+     * Newest datagram of each kind since the caller last cleared it.
+     */
+    struct Latest {
+        bool walk = false;
+        bool pose = false;
+        UdpTeleopHeader walk_hdr;
+        UdpTeleopWalk walk_msg;
+        UdpTeleopHeader pose_hdr;
+        WsPoseEntry pose_msg;
+        UdpTeleopHeader last;       // Newest of either, answered by the status
+    };
+
+    UdpTeleop() = default;
+    ~UdpTeleop();
+    UdpTeleop(const UdpTeleop&) = delete;
+    UdpTeleop& operator=(const UdpTeleop&) = delete;
+
+    /**
+     * Shared secret, 1..UDP_TELEOP_KEY_MAX bytes.
+     */
+    bool setKey(const uint8_t* key, size_t len);
+
+    /**
+     * Key from a file, one trailing newline ignored.
+     */
+    bool loadKey(const char* path);
+
+    bool hasKey() const { return m_keyed; }
+
+    /**
+     * Bind a non-blocking UDP socket on port (all interfaces). Needs a key.
+     */
+    bool open(uint16_t port);
+    void close();
+    int getFd() const { return m_fd; }
+
+    /**
+     * Read everything waiting on the socket into out. Returns the number
+     * accepted; the status peer becomes the sender of the newest.
+     */
+    int drain(uint32_t now_ms, Latest& out);
+
+    /**
+     * Check one datagram that arrived at now_ms and, if it is accepted,
+     * record it in out. No socket involved.
+     */
+    Verdict accept(const uint8_t* data, size_t len, uint32_t now_ms, Latest& out);
+
+    /**
+     * Send a status answering hdr to the peer of the newest accepted
+     * datagram. False if there is none or the socket is full.
+     */
+    bool sendStatus(const UdpTeleopHeader& hdr, const UdpTeleopStatus& status);
+
+    /**
+     * Header, payload and tag into out (UDP_TELEOP_DATAGRAM_MAX bytes).
+     * Returns the datagram length. The client side of the protocol.
+     */
+    size_t seal(const UdpTeleopHeader& hdr, const void* payload, size_t len, uint8_t* out) const;
+
+    /**
+     * Milliseconds since the last accepted datagram, or UINT32_MAX if none.
+     */
+    uint32_t silentMs(uint32_t now_ms) const {
+        return m_active ? now_ms - m_last_ms : UINT32_MAX;
+    }
+
+    /**
+     * Stale and out-of-order datagrams, for UdpTeleopStatus.dropped.
+     */
+    uint16_t dropped() const { return (uint16_t)(m_stats.stale + m_stats.out_of_order); }
+
+    const Stats& stats() const { return m_stats; }
+
+private:
+    void tag(const uint8_t* data, size_t len, uint8_t out[20]) const;
+
+    int m_fd = -1;
+    bool m_keyed = false;
+    uint8_t m_ipad[UDP_TELEOP_KEY_MAX];
+    uint8_t m_opad[UDP_TELEOP_KEY_MAX];
+
+    bool m_active = false;          // A session has been accepted
+    uint32_t m_session = 0;
+    uint32_t m_seq = 0;             // Last accepted in m_session
+    uint32_t m_min_delay = 0;       // Quickest arrival - sent_ms seen in m_session
+    uint32_t m_last_ms = 0;         // Arrival of the last accepted datagram
+    uint32_t m_retired[UDP_TELEOP_RETIRED] = {};
+    int m_retired_next = 0;
+    struct sockaddr_in m_peer = {};
+    bool m_has_peer = false;
+    Stats m_stats;
+};
+
+#endif // UDP_TELEOP_H
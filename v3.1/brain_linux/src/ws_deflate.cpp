@@ -0,0 +1,253 @@
+/**
+ * Spider Robot v3.1 - WebSocket permessage-deflate Implementation
+ */
+
+#include "ws_deflate.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#ifdef SPIDER_WS_DEFLATE
+#include <zlib.h>
+#endif
+
+// The tail a sync flush ends with; stripped on send, put back on receive
+static const uint8_t DEFLATE_TAIL[4] = { 0x00, 0x00, 0xFF, 0xFF };
+
+// [p, end) with blanks trimmed at both ends
+static void trim(const char*& p, const char*& end) {
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+    while (end > p && (end[-1] == ' ' || end[-1] == '\t')) end--;
+}
+
+static bool equals(const char* p, const char* end, const char* word) {
+    size_t n = strlen(word);
+    return (size_t)(end - p) == n && strncmp(p, word, n) == 0;
+}
+
+// 8..15, optionally quoted; anything else is -1
+static int window_bits(const char* p, const char* end) {
+    if (end - p >= 2 && *p == '"' && end[-1] == '"') {
+        p++;
+        end--;
+    }
+    int v = 0;
+    if (p == end || end - p > 2) return -1;
+    for (; p < end; p++) {
+        if (*p < '0' || *p > '9') return -1;
+        v = v * 10 + (*p - '0');
+    }
+    return (v >= 8 && v <= 15) ? v : -1;
+}
+
+static bool accept_offer(const char* p, const char* end, WsDeflateParams& out,
+                         char* response, size_t response_size) {
+    const char* name_end = (const char*)memchr(p, ';', (size_t)(end - p));
+    if (!name_end) name_end = end;
+    const char* name = p;
+    trim(name, name_end);
+    if (!equals(name, name_end, "permessage-deflate")) return false;
+
+    WsDeflateParams params;
+    bool seen[4] = {};
+    bool server_bits = false;
+    for (p = name_end; p < end; ) {
+        if (*p == ';') p++;
+        const char* param_end = (const char*)memchr(p, ';', (size_t)(end - p));
+        if (!param_end) param_end = end;
+        const char* key = p;
+        const char* key_end = (const char*)memchr(p, '=', (size_t)(param_end - p));
+        const char* value = key_end ? key_end + 1 : nullptr;
+        const char* value_end = param_end;
+        if (!key_end) key_end = param_end;
+        trim(key, key_end);
+        if (value) trim(value, value_end);
+        p = param_end;
+
+        int idx;
+        if (equals(key, key_end, "server_no_context_takeover") && !value) {
+            idx = 0;
+            params.server_no_context_takeover = true;
+        } else if (equals(key, key_end, "client_no_context_takeover") && !value) {
+            idx = 1;
+            params.client_no_context_takeover = true;
+        } else if (equals(key, key_end, "server_max_window_bits") && value) {
+            idx = 2;
+            int bits = window_bits(value, value_end);
+            if (bits < 9) return false;
+            params.server_max_window_bits = bits;
+            server_bits = true;
+        } else if (equals(key, key_end, "client_max_window_bits")) {
+            // Our inflater always has a 15-bit window, so any limit the client keeps to is fine
+            idx = 3;
+            if (value && window_bits(value, value_end) < 0) return false;
+        } else {
+            return false;
+        }
+        if (seen[idx]) return false;
+        seen[idx] = true;
+    }
+
+    int n = snprintf(response, response_size, "permessage-deflate%s%s",
+                     params.server_no_context_takeover ? "; server_no_context_takeover" : "",
+                     params.client_no_context_takeover ? "; client_no_context_takeover" : "");
+    if (server_bits && n >= 0 && (size_t)n < response_size) {
+        n += snprintf(response + n, response_size - n, "; server_max_window_bits=%d",
+                      params.server_max_window_bits);
+    }
+    if (n < 0 || (size_t)n >= response_size) return false;
+    out = params;
+    return true;
+}
+
+bool ws_deflate_negotiate(const char* offers, WsDeflateParams& out, char* response, size_t response_size) {
+    const char* end = offers + strcspn(offers, "\r\n");
+    for (const char* p = offers; p < end; ) {
+        const char* offer_end = (const char*)memchr(p, ',', (size_t)(end - p));
+        if (!offer_end) offer_end = end;
+        if (accept_offer(p, offer_end, out, response, response_size)) return true;
+        p = offer_end + 1;
+    }
+    return false;
+}
+
+#ifdef SPIDER_WS_DEFLATE
+
+bool WsDeflate::available() {
+    return true;
+}
+
+WsDeflate::WsDeflate(const WsDeflateParams& params, int level)
+    : m_params(params), m_level(level) {
+}
+
+WsDeflate::~WsDeflate() {
+    if (m_deflate) {
+        deflateEnd(m_deflate);
+        delete m_deflate;
+    }
+    if (m_inflate) {
+        inflateEnd(m_inflate);
+        delete m_inflate;
+    }
+}
+
+// Run the compressor over [in, in + len) with flush, growing out past used as needed
+static bool deflate_run(z_stream* z, const uint8_t* in, size_t len, int flush,
+                        std::vector<uint8_t>& out, size_t& used) {
+    z->next_in = (Bytef*)in;
+    z->avail_in = (uInt)len;
+    do {
+        if (out.size() - used < 64) {
+            out.resize(out.size() * 2 + 256);
+        }
+        z->next_out = out.data() + used;
+        z->avail_out = (uInt)(out.size() - used);
+        int ret = deflate(z, flush);
+        used = out.size() - z->avail_out;
+        if (ret == Z_STREAM_ERROR) return false;
+    } while (z->avail_in > 0 || z->avail_out == 0);
+    return true;
+}
+
+bool WsDeflate::compress(const uint8_t* a, size_t a_len, const uint8_t* b, size_t b_len,
+                         std::vector<uint8_t>& out) {
+    if (!m_deflate) {
+        z_stream* z = new z_stream();
+        if (deflateInit2(z, m_level, Z_DEFLATED, -m_params.server_max_window_bits,
+                         WS_DEFLATE_MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK) {
+            delete z;
+            return false;
+        }
+        m_deflate = z;
+    }
+
+    size_t used = 0;
+    out.resize(out.capacity());
+    if ((a_len > 0 && !deflate_run(m_deflate, a, a_len, Z_NO_FLUSH, out, used)) ||
+        !deflate_run(m_deflate, b, b_len, Z_SYNC_FLUSH, out, used)) {
+        return false;
+    }
+    if (used == 0) {
+        // Nothing new since the last flush: zlib writes no block, but an
+        // empty message is still sent as one (00 + the tail)
+        out.assign(1, 0x00);
+    } else if (used < sizeof(DEFLATE_TAIL)) {
+        return false;
+    } else {
+        out.resize(used - sizeof(DEFLATE_TAIL));
+    }
+    if (!contextTakeover()) {
+        deflateReset(m_deflate);
+    }
+    return true;
+}
+
+int WsDeflate::decompress(const uint8_t* data, size_t len, size_t max_len, std::vector<uint8_t>& out) {
+    if (!m_inflate) {
+        z_stream* z = new z_stream();
+        if (inflateInit2(z, -15) != Z_OK) {
+            delete z;
+            return 1011;
+        }
+        m_inflate = z;
+    }
+
+    // Room for a little more than max_len, so a message of exactly
+    // max_len is told apart from one that keeps going
+    const size_t cap = max_len + 256;
+    out.resize(out.capacity());
+    size_t used = 0;
+    const uint8_t* parts[2] = { data, DEFLATE_TAIL };
+    size_t lens[2] = { len, sizeof(DEFLATE_TAIL) };
+    for (int i = 0; i < 2; i++) {
+        m_inflate->next_in = (Bytef*)parts[i];
+        m_inflate->avail_in = (uInt)lens[i];
+        do {
+            if (out.size() - used < 256) {
+                if (out.size() >= cap) return 1009;
+                out.resize(std::min(out.size() * 2 + 1024, cap));
+            }
+            m_inflate->next_out = out.data() + used;
+            m_inflate->avail_out = (uInt)(out.size() - used);
+            int ret = inflate(m_inflate, Z_SYNC_FLUSH);
+            used = out.size() - m_inflate->avail_out;
+            if (ret == Z_STREAM_END) {
+                // The client closed its stream with a final block; the next
+                // message starts a new one
+                inflateReset(m_inflate);
+                i = 2;
+                break;
+            }
+            if (ret == Z_BUF_ERROR) break;     // Input used up and output flushed
+            if (ret != Z_OK) return 1007;
+        } while (m_inflate->avail_in > 0 || m_inflate->avail_out == 0);
+    }
+    if (used > max_len) return 1009;
+    out.resize(used);
+    return 0;
+}
+
+#else
+
+bool WsDeflate::available() {
+    return false;
+}
+
+WsDeflate::WsDeflate(const WsDeflateParams& params, int level)
+    : m_params(params), m_level(level) {
+}
+
+WsDeflate::~WsDeflate() {
+}
+
+bool WsDeflate::compress(const uint8_t*, size_t, const uint8_t*, size_t, std::vector<uint8_t>&) {
+    return false;
+}
+
+int WsDeflate::decompress(const uint8_t*, size_t, size_t, std::vector<uint8_t>&) {
+    return 1011;
+}
+
+#endif
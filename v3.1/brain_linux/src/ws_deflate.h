@@ -0,0 +1,78 @@
+/**
+ * Spider Robot v3.1 - WebSocket permessage-deflate (RFC 7692)
+ *
+ * Offer negotiation for the handshake, and a per-client compressor and
+ * decompressor over zlib's raw deflate. zlib is optional: without it
+ * (SPIDER_WS_DEFLATE undefined) WsDeflate::available() is false and the
+ * daemon declines every offer.
+ *
+ * Streams are created on first use, so a client that negotiates but only
+ * ever exchanges small commands costs nothing beyond this object.
+ */
+
+#ifndef WS_DEFLATE_H
+#define WS_DEFLATE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#define WS_FRAME_RSV1           0x40    // First frame of a compressed message
+
+#define WS_DEFLATE_LEVEL_DEFAULT    6
+#define WS_DEFLATE_MIN_DEFAULT      512     // Smaller frames go out as they are
+#define WS_DEFLATE_MEM_LEVEL        8       // zlib default: 128KB + window per compressor
+
+struct z_stream_s;
+
+struct WsDeflateParams {
+    bool server_no_context_takeover = false;
+    bool client_no_context_takeover = false;
+    int server_max_window_bits = 15;    // Our compressor's window
+};
+
+/**
+ * Accept the first permessage-deflate offer in a Sec-WebSocket-Extensions
+ * value (up to the end of its line) that we can honour, and write the
+ * extension value to answer with into response. Offers with unknown or
+ * repeated parameters, or a server window below 9 bits (zlib's raw
+ * deflate cannot do 8), are skipped.
+ * @return true if an offer was accepted
+ */
+bool ws_deflate_negotiate(const char* offers, WsDeflateParams& out, char* response, size_t response_size);
+
+class WsDeflate {
+public:
+    static bool available();
+
+    WsDeflate(const WsDeflateParams& params, int level);
+    ~WsDeflate();
+    WsDeflate(const WsDeflate&) = delete;
+    WsDeflate& operator=(const WsDeflate&) = delete;
+
+    /**
+     * Compress the message a + b (either may be empty) into out, without
+     * the 00 00 FF FF tail. With context takeover the result depends on
+     * every message before it, so it must reach the client.
+     */
+    bool compress(const uint8_t* a, size_t a_len, const uint8_t* b, size_t b_len, std::vector<uint8_t>& out);
+
+    /**
+     * Inflate one received message into out.
+     * @return 0, or the close code to fail the connection with: 1009 if
+     *         it inflates past max_len, 1007 if it is not valid deflate,
+     *         1011 if zlib could not be set up
+     */
+    int decompress(const uint8_t* data, size_t len, size_t max_len, std::vector<uint8_t>& out);
+
+    bool contextTakeover() const { return !m_params.server_no_context_takeover; }
+    const WsDeflateParams& params() const { return m_params; }
+
+private:
+    WsDeflateParams m_params;
+    int m_level;
+    z_stream_s* m_deflate = nullptr;
+    z_stream_s* m_inflate = nullptr;
+};
+
+#endif // WS_DEFLATE_H
@@ -0,0 +1,126 @@
+/**
+ * Spider Robot v3.1 - WebSocket frame coding
+ *
+ * Header parsing and payload unmasking for client frames (RFC 6455 5.2),
+ * and header encoding for the daemon's unmasked server frames, shared by
+ * the daemon and the micro-benchmarks.
+ */
+
+#ifndef WS_FRAME_H
+#define WS_FRAME_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#define WS_FRAME_HEADER_MAX     10      // Server frames carry no mask key
+
+struct WsFrameHeader {
+    bool fin;
+    bool rsv1;                  // permessage-deflate: compressed message
+    uint8_t opcode;
+    bool masked;
+    uint64_t payload_len;
+    size_t header_len;          // Including the mask key
+};
+
+/**
+ * Parse the frame header at the start of buf. header_len stays 0 until
+ * the whole header (with the mask key) is in buf, so a caller can size
+ * its buffer for a frame that is still arriving.
+ * @return true once the header and the whole payload are in buf
+ */
+inline bool ws_frame_parse(const uint8_t* buf, size_t len, WsFrameHeader& out) {
+    out.header_len = 0;
+    if (len < 2) return false;
+
+    out.fin = buf[0] & 0x80;
+    out.rsv1 = buf[0] & 0x40;
+    out.opcode = buf[0] & 0x0F;
+    out.masked = buf[1] & 0x80;
+    uint64_t payload_len = buf[1] & 0x7F;
+    size_t header_len = 2;
+    if (payload_len == 126) {
+        if (len < 4) return false;
+        payload_len = (buf[2] << 8) | buf[3];
+        header_len = 4;
+    } else if (payload_len == 127) {
+        if (len < 10) return false;
+        payload_len = 0;
+        for (int i = 0; i < 8; i++) {
+            payload_len = (payload_len << 8) | buf[2 + i];
+        }
+        header_len = 10;
+    }
+    if (out.masked) header_len += 4;
+    if (len < header_len) return false;
+
+    out.payload_len = payload_len;
+    out.header_len = header_len;
+    return len - header_len >= payload_len;
+}
+
+/**
+ * Write the header of a final, unmasked server frame carrying len
+ * payload bytes into out (WS_FRAME_HEADER_MAX bytes).
+ * @return header length: 2, 4 or 10
+ */
+inline size_t ws_frame_header(uint8_t* out, uint8_t opcode, uint64_t len) {
+    out[0] = 0x80 | opcode;
+    if (len < 126) {
+        out[1] = (uint8_t)len;
+        return 2;
+    }
+    if (len < 65536) {
+        out[1] = 126;
+        out[2] = (uint8_t)(len >> 8);
+        out[3] = (uint8_t)len;
+        return 4;
+    }
+    out[1] = 127;
+    for (int i = 0; i < 8; i++) {
+        out[2 + i] = (uint8_t)(len >> ((7 - i) * 8));
+    }
+    return 10;
+}
+
+/**
+ * XOR payload with the 4-byte mask key in place: 16 bytes at a time with
+ * SSE2 or NEON, 8 bytes at a time otherwise (the C906 build).
+ */
+inline void ws_unmask(uint8_t* payload, size_t len, const uint8_t* mask) {
+    uint32_t key32;
+    memcpy(&key32, mask, 4);
+    uint64_t key64 = ((uint64_t)key32 << 32) | key32;
+
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i key128 = _mm_set1_epi32((int)key32);
+    for (; i + 16 <= len; i += 16) {
+        __m128i* p = (__m128i*)(payload + i);
+        _mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p), key128));
+    }
+#elif defined(__ARM_NEON)
+    const uint8x16_t key128 = vreinterpretq_u8_u32(vdupq_n_u32(key32));
+    for (; i + 16 <= len; i += 16) {
+        vst1q_u8(payload + i, veorq_u8(vld1q_u8(payload + i), key128));
+    }
+#endif
+    for (; i + 8 <= len; i += 8) {
+        uint64_t w;
+        memcpy(&w, payload + i, 8);
+        w ^= key64;
+        memcpy(payload + i, &w, 8);
+    }
+    for (; i < len; i++) {
+        payload[i] ^= mask[i % 4];
+    }
+}
+
+#endif // WS_FRAME_H
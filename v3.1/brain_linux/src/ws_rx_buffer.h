@@ -0,0 +1,151 @@
+/**
+ * Spider Robot v3.1 - WebSocket receive buffer
+ *
+ * Per-client RX storage with a read cursor: parsed frames only advance
+ * the cursor, and the unparsed tail is moved to the front only when the
+ * next frame would not fit behind it. A connected client holds an
+ * RX_BUFFER_SIZE buffer taken from a WsBufferPool by attach() and handed
+ * back by detach(), so idle client slots hold no buffer at all. Frames
+ * larger than that switch the client to a buffer of WS_RX_LARGE_BYTES
+ * from a second pool, which goes back once drained. Bigger or fragmented
+ * messages are reassembled outside it (see wsProcessFrame).
+ */
+
+#ifndef WS_RX_BUFFER_H
+#define WS_RX_BUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#define RX_BUFFER_SIZE      4096
+#define WS_RX_LARGE_BYTES   65536   // Largest frame held whole (header included)
+
+/**
+ * Free list of buffers of one size class (client RX, large frames and
+ * messages, queued TX), so steady traffic and reconnects do not
+ * allocate. Buffers keep their capacity while pooled; beyond max_idle
+ * of them, released buffers are freed instead.
+ */
+class WsBufferPool {
+public:
+    explicit WsBufferPool(size_t max_idle = SIZE_MAX) : m_max_idle(max_idle) {}
+
+    std::vector<uint8_t> acquire(size_t size = WS_RX_LARGE_BYTES) {
+        std::vector<uint8_t> buf;
+        if (!m_free.empty()) {
+            buf = std::move(m_free.back());
+            m_free.pop_back();
+        }
+        buf.resize(size);
+        return buf;
+    }
+
+    void release(std::vector<uint8_t>&& buf) {
+        if (buf.capacity() == 0 || m_free.size() >= m_max_idle) {
+            buf = std::vector<uint8_t>();
+            return;
+        }
+        m_free.push_back(std::move(buf));
+    }
+
+    size_t idle() const { return m_free.size(); }
+
+private:
+    std::vector<std::vector<uint8_t>> m_free;
+    size_t m_max_idle;
+};
+
+class WsRxBuffer {
+public:
+    // Unparsed bytes
+    uint8_t* data() { return base() + m_start; }
+    size_t size() const { return m_end - m_start; }
+
+    // Free space behind them, for recv()
+    uint8_t* tail() { return base() + m_end; }
+    size_t tailSpace() const { return capacity() - m_end; }
+    size_t capacity() const { return m_large.empty() ? m_small.size() : m_large.size(); }
+    bool isLarge() const { return !m_large.empty(); }
+
+    void commit(size_t n) { m_end += n; }
+
+    /**
+     * Take the RX_BUFFER_SIZE buffer for a new connection.
+     */
+    void attach(WsBufferPool& small) {
+        m_small = small.acquire(RX_BUFFER_SIZE);
+        m_start = m_end = 0;
+    }
+
+    /**
+     * Give every buffer back when the connection goes.
+     */
+    void detach(WsBufferPool& small, WsBufferPool& large) {
+        m_start = m_end = 0;
+        shrink(large);
+        if (m_small.capacity() != 0) {
+            small.release(std::move(m_small));
+            m_small = std::vector<uint8_t>();
+        }
+    }
+
+    void consume(size_t n) {
+        m_start += n;
+        if (m_start >= m_end) m_start = m_end = 0;
+    }
+
+    void compact() {
+        if (m_start == 0) return;
+        memmove(base(), base() + m_start, size());
+        m_end -= m_start;
+        m_start = 0;
+    }
+
+    /**
+     * Make room for a frame of frame_len bytes at the cursor, compacting
+     * or moving to a pooled buffer as needed.
+     * @return false if the frame is larger than WS_RX_LARGE_BYTES (it
+     *         has to be streamed instead)
+     */
+    bool reserve(size_t frame_len, WsBufferPool& pool) {
+        if (frame_len > WS_RX_LARGE_BYTES) return false;
+        if (frame_len > capacity()) {
+            std::vector<uint8_t> large = pool.acquire();
+            memcpy(large.data(), data(), size());
+            m_end = size();
+            m_start = 0;
+            m_large = std::move(large);
+        } else if (m_start + frame_len > capacity()) {
+            compact();
+        }
+        return true;
+    }
+
+    /**
+     * Hand a drained large buffer back; the small one takes over again.
+     */
+    void shrink(WsBufferPool& pool) {
+        if (isLarge() && size() == 0) {
+            pool.release(std::move(m_large));
+            m_large = std::vector<uint8_t>();
+        }
+    }
+
+    void clear(WsBufferPool& pool) {
+        m_start = m_end = 0;
+        shrink(pool);
+    }
+
+private:
+    uint8_t* base() { return m_large.empty() ? m_small.data() : m_large.data(); }
+
+    std::vector<uint8_t> m_small;       // While attached
+    std::vector<uint8_t> m_large;
+    size_t m_start = 0;
+    size_t m_end = 0;
+};
+
+#endif // WS_RX_BUFFER_H
@@ -56,6 +56,11 @@ copy_sources_to_sdk() {
     cp "$SCRIPT_DIR/muscle_rtos/safety/"*.c "$SDK_TASK/safety/" 2>/dev/null || true
     cp "$SCRIPT_DIR/muscle_rtos/safety/"*.h "$SDK_TASK/safety/" 2>/dev/null || true
     
+    # Copy motion runtime (interpolator)
+    mkdir -p "$SDK_TASK/motion_runtime"
+    cp "$SCRIPT_DIR/muscle_rtos/motion_runtime/"*.c "$SDK_TASK/motion_runtime/" 2>/dev/null || true
+    cp "$SCRIPT_DIR/muscle_rtos/motion_runtime/"*.h "$SDK_TASK/motion_runtime/" 2>/dev/null || true
+    
     # Copy common headers
     cp "$SCRIPT_DIR/common/"*.h "$SDK_TASK/" 2>/dev/null || true
     cp "$SCRIPT_DIR/common/"*.c "$SDK_TASK/" 2>/dev/null || true
@@ -0,0 +1,69 @@
+#ifndef SPIDER_CACHE_OPS_H
+#define SPIDER_CACHE_OPS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * D-cache maintenance for the non-coherent shared region.
+ *
+ * The C906 cores have no hardware coherency across the Linux/FreeRTOS
+ * boundary. A cacheable view of the ring must clean what it wrote and
+ * invalidate what it is about to read. These use the T-Head XTheadCmo
+ * instructions (raw encodings, so any toolchain assembles them); in
+ * Linux user mode they trap unless the firmware sets mxstatus.UCME.
+ * Host builds are cache-coherent and compile them away.
+ */
+#define CACHE_LINE_SIZE 64
+
+#if defined(__riscv)
+
+static inline void cache_clean_line(const volatile void *addr) {
+    register const volatile void *a0 __asm__("a0") = addr;
+    __asm volatile (".long 0x0255000b" : : "r"(a0) : "memory");    // th.dcache.cva a0
+}
+
+static inline void cache_invalidate_line(const volatile void *addr) {
+    register const volatile void *a0 __asm__("a0") = addr;
+    __asm volatile (".long 0x0265000b" : : "r"(a0) : "memory");    // th.dcache.iva a0
+}
+
+static inline void cache_sync(void) {
+    __asm volatile (".long 0x0190000b" : : : "memory");            // th.sync.s
+}
+
+#else
+
+static inline void cache_clean_line(const volatile void *addr) { (void)addr; }
+static inline void cache_invalidate_line(const volatile void *addr) { (void)addr; }
+static inline void cache_sync(void) { __sync_synchronize(); }
+
+#endif
+
+static inline void cache_clean_range(const volatile void *addr, size_t len) {
+    uintptr_t p = (uintptr_t)addr & ~(uintptr_t)(CACHE_LINE_SIZE - 1);
+    uintptr_t end = (uintptr_t)addr + len;
+    for (; p < end; p += CACHE_LINE_SIZE) {
+        cache_clean_line((const volatile void *)p);
+    }
+    cache_sync();
+}
+
+static inline void cache_invalidate_range(const volatile void *addr, size_t len) {
+    uintptr_t p = (uintptr_t)addr & ~(uintptr_t)(CACHE_LINE_SIZE - 1);
+    uintptr_t end = (uintptr_t)addr + len;
+    for (; p < end; p += CACHE_LINE_SIZE) {
+        cache_invalidate_line((const volatile void *)p);
+    }
+    cache_sync();
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SPIDER_CACHE_OPS_H
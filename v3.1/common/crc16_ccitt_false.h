@@ -8,6 +8,15 @@
 extern "C" {
 #endif
 
+// Implementation, chosen at compile time (see crc16_ccitt_false.c)
+#define CRC16_IMPL_BITWISE  0
+#define CRC16_IMPL_TABLE    1
+#define CRC16_IMPL_SLICE4   2
+
+#ifndef CRC16_IMPL
+#define CRC16_IMPL          CRC16_IMPL_TABLE
+#endif
+
 /**
  * CRC-16/CCITT-FALSE
  * - Polynomial: 0x1021
@@ -16,10 +25,20 @@ extern "C" {
  * - RefOut:     false
  * - XorOut:     0x0000
  *
- * Test vector: All servos 1500µs, seq=1, t_ms=100, flags=0x0004 → CRC = 0x29A4
+ * Test vector: All servos 1500µs, seq=1, t_ms=100, flags=0x0004 → CRC = 0xC73C
  */
 uint16_t crc16_ccitt_false(const uint8_t *data, size_t len);
 
+/**
+ * Incremental form, for data that is not contiguous:
+ *   crc = crc16_ccitt_false_init();
+ *   crc = crc16_ccitt_false_update(crc, part, part_len);   // any number of times
+ *   crc = crc16_ccitt_false_final(crc);
+ */
+uint16_t crc16_ccitt_false_init(void);
+uint16_t crc16_ccitt_false_update(uint16_t crc, const uint8_t *data, size_t len);
+uint16_t crc16_ccitt_false_final(uint16_t crc);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,14 +1,26 @@
 /**
  * Spider Robot v3.1 - Eye Event Protocol
  * 
- * Brain → Eye Service communication via Unix socket.
- * JSON event format for simplicity and debuggability.
+ * Brain → Eye Service communication via Unix socket, in one of two forms:
+ *
+ *  - EyeEventPacket datagrams on EYE_PACKET_SOCKET_PATH (SOCK_SEQPACKET),
+ *    one event per packet, no framing or parsing. The Brain sends an
+ *    EYE_EV_HELLO first and uses the socket once the same version comes
+ *    back; otherwise it falls back to JSON.
+ *  - Newline-delimited JSON on EYE_SOCKET_PATH (SOCK_STREAM), kept for
+ *    debugging (socat, nc -U) and for --eye-json.
  */
 
 #ifndef EYE_EVENT_PROTOCOL_H
 #define EYE_EVENT_PROTOCOL_H
 
-#define EYE_SOCKET_PATH "/tmp/spider_eye.sock"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define EYE_SOCKET_PATH         "/tmp/spider_eye.sock"
+#define EYE_PACKET_SOCKET_PATH  "/tmp/spider_eye_pkt.sock"
 
 /**
  * Event Types (JSON "type" field):
@@ -52,4 +64,100 @@
 // Maximum event JSON size
 #define EYE_EVENT_MAX_SIZE 256
 
+// ---- Binary events ----
+
+#define EYE_PACKET_MAGIC        0xE7
+#define EYE_PACKET_VERSION      1
+#define EYE_HELLO_TIMEOUT_MS    200     // Brain waits this long for the reply
+
+typedef enum {
+    EYE_EV_HELLO = 0,           // Negotiation, echoed by the Eye Service
+    EYE_EV_MOOD,
+    EYE_EV_LOOK,
+    EYE_EV_BLINK,
+    EYE_EV_WINK,
+    EYE_EV_COLOR,
+    EYE_EV_IDLE,
+    EYE_EV_ESTOP,
+    EYE_EV_STATUS,
+    EYE_EV_WAKE,                // Restart the frame clock (see eye_state_block.h)
+    EYE_EV_COUNT
+} EyeEventType;
+
+typedef enum { EYE_ID_LEFT = 0, EYE_ID_RIGHT = 1 } EyeId;
+
+typedef enum {
+    EYE_MOOD_ID_NORMAL = 0,
+    EYE_MOOD_ID_ANGRY,
+    EYE_MOOD_ID_HAPPY,
+    EYE_MOOD_ID_SLEEPY,
+    EYE_MOOD_ID_COUNT
+} EyeMoodId;
+
+#define EYE_FLAG_IDLE_ENABLED       0x01    // idle
+#define EYE_HELLO_FLAG_STATE_BLOCK  0x01    // hello: EyeStateBlock fd attached / mapped
+
+typedef struct {
+    uint8_t  magic;             // EYE_PACKET_MAGIC
+    uint8_t  version;           // EYE_PACKET_VERSION
+    uint8_t  type;              // EyeEventType
+    uint8_t  eye;               // wink: EyeId
+    float    x;                 // look: [-1, 1]
+    float    y;
+    uint16_t rgb565;            // color
+    uint8_t  mood;              // mood: EyeMoodId
+    uint8_t  flags;             // idle: EYE_FLAG_*, hello: EYE_HELLO_FLAG_*
+} EyeEventPacket;
+
+#ifdef __cplusplus
+static_assert(sizeof(EyeEventPacket) == 16, "EyeEventPacket must be 16 bytes");
+#else
+_Static_assert(sizeof(EyeEventPacket) == 16, "EyeEventPacket must be 16 bytes");
+#endif
+
+static inline const char *eye_mood_name(uint8_t mood) {
+    static const char *const names[EYE_MOOD_ID_COUNT] = {
+        EYE_MOOD_NORMAL, EYE_MOOD_ANGRY, EYE_MOOD_HAPPY, EYE_MOOD_SLEEPY
+    };
+    return names[mood < EYE_MOOD_ID_COUNT ? mood : 0];
+}
+
+static inline EyeEventPacket eye_event_make(uint8_t type) {
+    EyeEventPacket ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.magic = EYE_PACKET_MAGIC;
+    ev.version = EYE_PACKET_VERSION;
+    ev.type = type;
+    return ev;
+}
+
+/**
+ * The JSON line for an event, without the newline.
+ * Returns the length, 0 for EYE_EV_HELLO or an unknown type.
+ */
+static inline int eye_event_format_json(const EyeEventPacket *ev, char *buf, size_t size) {
+    switch (ev->type) {
+    case EYE_EV_MOOD:
+        return snprintf(buf, size, "{\"type\":\"mood\",\"mood\":\"%s\"}", eye_mood_name(ev->mood));
+    case EYE_EV_LOOK:
+        return snprintf(buf, size, "{\"type\":\"look\",\"x\":%.3f,\"y\":%.3f}", ev->x, ev->y);
+    case EYE_EV_BLINK:
+        return snprintf(buf, size, "{\"type\":\"blink\"}");
+    case EYE_EV_WINK:
+        return snprintf(buf, size, "{\"type\":\"wink\",\"eye\":\"%s\"}",
+                        ev->eye == EYE_ID_RIGHT ? EYE_RIGHT : EYE_LEFT);
+    case EYE_EV_COLOR:
+        return snprintf(buf, size, "{\"type\":\"color\",\"rgb565\":%u}", ev->rgb565);
+    case EYE_EV_IDLE:
+        return snprintf(buf, size, "{\"type\":\"idle\",\"enabled\":%s}",
+                        (ev->flags & EYE_FLAG_IDLE_ENABLED) ? "true" : "false");
+    case EYE_EV_ESTOP:
+        return snprintf(buf, size, "{\"type\":\"estop\"}");
+    case EYE_EV_STATUS:
+        return snprintf(buf, size, "{\"type\":\"status\"}");
+    default:
+        return 0;
+    }
+}
+
 #endif // EYE_EVENT_PROTOCOL_H
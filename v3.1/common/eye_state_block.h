@@ -0,0 +1,191 @@
+/**
+ * Eye State Block - Brain → Eye Service shared memory
+ *
+ * Latest-value eye state (gaze, iris color, mood, idle and a blink
+ * counter), written by the Brain and read by the Eye Service once per
+ * frame, so a gaze update costs no syscall. The Brain creates the block
+ * with memfd_create() and passes the fd with SCM_RIGHTS in its
+ * EYE_EV_HELLO (EYE_HELLO_FLAG_STATE_BLOCK); the Eye Service echoes the
+ * flag if it maps it. Winks, estop and status stay on the socket.
+ *
+ * Layout:
+ * ┌────────────────────────────────────────┐
+ * │ Line 0 - seq, magic/version, data      │  Brain writes
+ * ├────────────────────────────────────────┤
+ * │ Line 1 - reader_sleep, display status  │  Eye Service writes
+ * └────────────────────────────────────────┘
+ *
+ * Every field has a generation counter bumped on each write; the reader
+ * applies a field when its counter moved (blinks once per step of
+ * gen[EYE_STATE_BLINK]). Seqlock as in shared_telemetry.h, without cache
+ * maintenance: both processes share the same coherent core.
+ *
+ * The Eye Service stops its frame clock when nothing animates. It then
+ * stores a new nonzero epoch in reader_sleep, fences, and reads the block
+ * once more; the Brain fences after each write and sends one EYE_EV_WAKE
+ * per epoch it sees. Either side sees the other's store, so no update is
+ * left unread.
+ *
+ * The Eye Service also publishes its display status in line 1 (SPI clock,
+ * frames sent, per-frame transfer time) under a seqlock of its own, for
+ * the Brain's eye status reply.
+ */
+
+#ifndef EYE_STATE_BLOCK_H
+#define EYE_STATE_BLOCK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define EYE_STATE_MAGIC         0x54534545  // "EEST"
+#define EYE_STATE_VERSION       0x0100      // v1.0
+#define EYE_STATE_LINE          64
+#define EYE_STATE_SIZE          (2 * EYE_STATE_LINE)
+#define EYE_STATE_READ_TRIES    4
+
+#define EYE_STATE_LOAD_ACQUIRE(p)       __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define EYE_STATE_STORE_RELEASE(p, v)   __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define EYE_STATE_FENCE()               __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+typedef enum {
+    EYE_STATE_LOOK = 0,
+    EYE_STATE_COLOR,
+    EYE_STATE_MOOD,
+    EYE_STATE_IDLE,
+    EYE_STATE_BLINK,
+    EYE_STATE_FIELD_COUNT
+} EyeStateField;
+
+typedef struct {
+    uint32_t gen[EYE_STATE_FIELD_COUNT];    // Writes per field, 0 = never set
+    float    look_x;                        // [-1, 1]
+    float    look_y;
+    uint16_t rgb565;
+    uint8_t  mood;                          // EyeMoodId
+    uint8_t  idle;                          // 1 = idle animation on
+} EyeStateData;
+
+typedef struct {
+    uint32_t spi_hz;                        // Panel clock, 0 without panels (null/file sink)
+    uint32_t frames;                        // Frames sent
+    uint32_t frame_us;                      // Transfer time of the last frame
+    uint32_t frame_us_avg;                  // Moving average over ~8 frames
+    uint32_t frame_us_max;
+    uint32_t kib_sent;                      // Pixel data sent
+} EyeDisplayStatus;
+
+typedef struct {
+    // Line 0: Brain
+    volatile uint32_t seq;          // Odd while the Brain is writing
+    uint32_t magic;                 // EYE_STATE_MAGIC
+    uint16_t version;               // EYE_STATE_VERSION
+    uint16_t size;                  // sizeof(EyeStateBlock)
+    uint32_t reserved0;
+    EyeStateData data;
+    uint8_t pad0[EYE_STATE_LINE - 16 - sizeof(EyeStateData)];
+
+    // Line 1: Eye Service
+    volatile uint32_t reader_sleep; // Nonzero epoch while the frame clock is stopped
+    volatile uint32_t status_seq;   // Odd while the Eye Service is writing status
+    EyeDisplayStatus status;
+    uint8_t pad1[EYE_STATE_LINE - 8 - sizeof(EyeDisplayStatus)];
+} EyeStateBlock;
+
+#ifdef __cplusplus
+static_assert(sizeof(EyeStateBlock) == EYE_STATE_SIZE, "EyeStateBlock must be 2 lines");
+static_assert(offsetof(EyeStateBlock, reader_sleep) == EYE_STATE_LINE, "reader_sleep must start line 1");
+#else
+_Static_assert(sizeof(EyeStateBlock) == EYE_STATE_SIZE, "EyeStateBlock must be 2 lines");
+_Static_assert(offsetof(EyeStateBlock, reader_sleep) == EYE_STATE_LINE, "reader_sleep must start line 1");
+#endif
+
+/**
+ * Writer: reset the block before handing it out.
+ */
+static inline void eye_state_init(volatile EyeStateBlock *b) {
+    memset((void *)b, 0, sizeof(*b));
+    b->version = EYE_STATE_VERSION;
+    b->size = EYE_STATE_SIZE;
+    EYE_STATE_STORE_RELEASE(&b->magic, (uint32_t)EYE_STATE_MAGIC);
+}
+
+/**
+ * Writer: publish the whole state. Single writer only.
+ */
+static inline void eye_state_write(volatile EyeStateBlock *b, const EyeStateData *d) {
+    uint32_t seq = b->seq;
+    EYE_STATE_STORE_RELEASE(&b->seq, seq + 1);
+    EYE_STATE_FENCE();
+    memcpy((void *)&b->data, d, sizeof(*d));
+    EYE_STATE_STORE_RELEASE(&b->seq, seq + 2);
+}
+
+/**
+ * Reader: copy a consistent snapshot into out.
+ * Returns 0 on success, -1 if the block is not valid, -2 if every try
+ * raced an update.
+ */
+static inline int eye_state_read(const volatile EyeStateBlock *b, EyeStateData *out) {
+    if (EYE_STATE_LOAD_ACQUIRE(&b->magic) != EYE_STATE_MAGIC ||
+        b->version != EYE_STATE_VERSION || b->size != EYE_STATE_SIZE) {
+        return -1;
+    }
+
+    for (int i = 0; i < EYE_STATE_READ_TRIES; i++) {
+        uint32_t s1 = EYE_STATE_LOAD_ACQUIRE(&b->seq);
+        if (s1 & 1) {
+            continue;
+        }
+        memcpy(out, (const void *)&b->data, sizeof(*out));
+        EYE_STATE_FENCE();
+        if (b->seq == s1) {
+            return 0;
+        }
+    }
+    return -2;
+}
+
+/**
+ * Eye Service: publish the display status. Single writer only.
+ */
+static inline void eye_display_status_write(volatile EyeStateBlock *b, const EyeDisplayStatus *st) {
+    uint32_t seq = b->status_seq;
+    EYE_STATE_STORE_RELEASE(&b->status_seq, seq + 1);
+    EYE_STATE_FENCE();
+    memcpy((void *)&b->status, st, sizeof(*st));
+    EYE_STATE_STORE_RELEASE(&b->status_seq, seq + 2);
+}
+
+/**
+ * Brain: copy a consistent display status into out.
+ * Returns 0 on success, -1 if none was published yet, -2 if every try
+ * raced an update.
+ */
+static inline int eye_display_status_read(const volatile EyeStateBlock *b, EyeDisplayStatus *out) {
+    for (int i = 0; i < EYE_STATE_READ_TRIES; i++) {
+        uint32_t s1 = EYE_STATE_LOAD_ACQUIRE(&b->status_seq);
+        if (s1 == 0) {
+            return -1;
+        }
+        if (s1 & 1) {
+            continue;
+        }
+        memcpy(out, (const void *)&b->status, sizeof(*out));
+        EYE_STATE_FENCE();
+        if (b->status_seq == s1) {
+            return 0;
+        }
+    }
+    return -2;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EYE_STATE_BLOCK_H
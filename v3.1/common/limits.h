@@ -14,11 +14,30 @@
 #define SERVO_ANGLE_MAX_DEG   155
 #define SERVO_ANGLE_CENTER    90
 
+// Joint motion limits for planned moves (us of pulse width; 11.1 us per degree)
+#define SERVO_VEL_MAX_US_PER_S   2000    // ~180 deg/s, well inside SG90/MG90 no-load speed
+#define SERVO_ACC_MAX_US_PER_S2  10000   // Full speed within 0.2 s
+
 // Channel allocation
 #define SERVO_COUNT_LEGS      8
 #define SERVO_COUNT_TOTAL     13
 #define SERVO_CHANNEL_SCAN    12
 
+// Channels the Muscle drives: the layout above, plus any extra ones a
+// larger robot adds (build with -DSERVO_CHANNEL_COUNT=n, fed PosePacketN).
+// Up to 32, 16 per PCA9685 board.
+#ifndef SERVO_CHANNEL_COUNT
+#define SERVO_CHANNEL_COUNT   SERVO_COUNT_TOTAL
+#endif
+#define SERVO_CHANNEL_MAX     32
+
+// Interpolation groups, each with its own timeline on the Muscle:
+// leg i (coxa 2i, femur 2i+1, tibia 8+i), then the scan servo. Channels
+// past SERVO_COUNT_TOTAL share the scan servo's group.
+#define SERVO_GROUP_COUNT     5
+#define SERVO_GROUP_SCAN      4
+#define SERVO_GROUP_ALL       ((uint8_t)((1u << SERVO_GROUP_COUNT) - 1))
+
 // Timing limits
 #define HEARTBEAT_TIMEOUT_MS  250
 #define MOTION_UPDATE_HZ      50
@@ -27,6 +46,8 @@
 // Interpolation
 #define INTERP_SUBSTEPS_MIN   1
 #define INTERP_SUBSTEPS_MAX   16
+#define INTERP_QUEUE_DEPTH    8       // Keyframes queued behind the active segment
+#define MUSCLE_PREFETCH_DEPTH 32      // Validated packets the Muscle takes off the ring ahead of output
 
 // Stride scaling
 #define STRIDE_FACTOR_MIN     0.3f
@@ -43,4 +64,18 @@ static inline uint16_t clamp_servo_us(uint16_t value) {
     return value;
 }
 
+static inline int servo_group_of(int ch) {
+    if (ch >= SERVO_CHANNEL_SCAN) return SERVO_GROUP_SCAN;
+    return (ch < SERVO_COUNT_LEGS) ? ch / 2 : ch - SERVO_COUNT_LEGS;
+}
+
+// Groups holding any channel of mask
+static inline uint8_t servo_groups_for_channels(uint16_t mask) {
+    uint8_t groups = 0;
+    for (int ch = 0; ch < SERVO_COUNT_TOTAL; ch++) {
+        if (mask & (1u << ch)) groups |= (uint8_t)(1u << servo_group_of(ch));
+    }
+    return groups;
+}
+
 #endif // SPIDER_LIMITS_H
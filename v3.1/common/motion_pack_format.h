@@ -0,0 +1,132 @@
+/**
+ * Motion Pack - Precompiled Motion Sequences
+ *
+ * Binary file of named servo sequences, built offline by
+ * python/motion_pack.py and mmap'd read-only by the Brain, so playing a
+ * sequence is pointer arithmetic with no parsing. Frames are stored
+ * ready to send: clamped and with calibration offsets applied.
+ *
+ * Layout (little-endian):
+ * ┌────────────────────────────────────────┐
+ * │ MotionPackHeader (32 bytes)            │
+ * ├────────────────────────────────────────┤
+ * │ MotionPackEntry[sequence_count]        │  at index_offset
+ * ├────────────────────────────────────────┤
+ * │ MotionPackFrame[frame_count]           │  at frames_offset
+ * └────────────────────────────────────────┘
+ *
+ * Each entry names a contiguous run of frames. A frame's t_ms is the time
+ * to reach it from the previous frame (for the first frame, from the
+ * pose the sequence starts in).
+ */
+
+#ifndef MOTION_PACK_FORMAT_H
+#define MOTION_PACK_FORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "limits.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MOTION_PACK_MAGIC       0x4B504D53  // "SMPK"
+#define MOTION_PACK_VERSION     0x0100      // v1.0
+#define MOTION_PACK_NAME_LEN    24          // Including the NUL
+
+typedef struct {
+    uint32_t magic;             // MOTION_PACK_MAGIC
+    uint16_t version;           // MOTION_PACK_VERSION
+    uint16_t sequence_count;
+    uint32_t frame_count;
+    uint32_t index_offset;      // Bytes from file start
+    uint32_t frames_offset;     // Bytes from file start, 4-byte aligned
+    uint32_t file_size;
+    uint32_t reserved[2];
+} MotionPackHeader;
+
+typedef struct {
+    char     name[MOTION_PACK_NAME_LEN];    // NUL-terminated, NUL-padded
+    uint32_t name_hash;         // FNV-1a of name, as json_hash()
+    uint32_t first_frame;       // Index into the frame table
+    uint32_t frame_count;
+    uint32_t duration_ms;       // Sum of the frames' t_ms
+    uint16_t mask;              // Channels the frames drive
+    uint16_t reserved0;
+    uint32_t reserved1;
+} MotionPackEntry;
+
+typedef struct {
+    uint32_t t_ms;
+    uint16_t flags;             // FLAG_HOLD / FLAG_INTERP_Q16, passed through
+    uint16_t servo_us[SERVO_COUNT_TOTAL];
+} MotionPackFrame;
+
+#ifdef __cplusplus
+static_assert(sizeof(MotionPackHeader) == 32, "MotionPackHeader must be 32 bytes");
+static_assert(sizeof(MotionPackEntry) == 48, "MotionPackEntry must be 48 bytes");
+static_assert(sizeof(MotionPackFrame) == 32, "MotionPackFrame must be 32 bytes");
+#else
+_Static_assert(sizeof(MotionPackHeader) == 32, "MotionPackHeader must be 32 bytes");
+_Static_assert(sizeof(MotionPackEntry) == 48, "MotionPackEntry must be 48 bytes");
+_Static_assert(sizeof(MotionPackFrame) == 32, "MotionPackFrame must be 32 bytes");
+#endif
+
+static inline uint32_t motion_pack_hash(const char *s) {
+    uint32_t h = 2166136261u;
+    while (*s) {
+        h ^= (uint8_t)*s++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static inline const MotionPackEntry *motion_pack_index(const void *base) {
+    const MotionPackHeader *hdr = (const MotionPackHeader *)base;
+    return (const MotionPackEntry *)((const uint8_t *)base + hdr->index_offset);
+}
+
+static inline const MotionPackFrame *motion_pack_frames(const void *base) {
+    const MotionPackHeader *hdr = (const MotionPackHeader *)base;
+    return (const MotionPackFrame *)((const uint8_t *)base + hdr->frames_offset);
+}
+
+/**
+ * Check that a pack of size bytes is self-consistent: header, tables
+ * inside the file, every entry's frames inside the frame table and
+ * names terminated. Returns 0 if valid, -1 otherwise.
+ */
+static inline int motion_pack_validate(const void *base, size_t size) {
+    if (size < sizeof(MotionPackHeader)) return -1;
+
+    const MotionPackHeader *hdr = (const MotionPackHeader *)base;
+    if (hdr->magic != MOTION_PACK_MAGIC || (hdr->version >> 8) != (MOTION_PACK_VERSION >> 8)) return -1;
+    if (hdr->file_size != size) return -1;
+    if (hdr->index_offset % 4 != 0 || hdr->frames_offset % 4 != 0) return -1;
+
+    uint64_t index_end = (uint64_t)hdr->index_offset + (uint64_t)hdr->sequence_count * sizeof(MotionPackEntry);
+    uint64_t frames_end = (uint64_t)hdr->frames_offset + (uint64_t)hdr->frame_count * sizeof(MotionPackFrame);
+    if (hdr->index_offset < sizeof(MotionPackHeader) || index_end > size ||
+        hdr->frames_offset < sizeof(MotionPackHeader) || frames_end > size) {
+        return -1;
+    }
+
+    const MotionPackEntry *index = motion_pack_index(base);
+    for (uint32_t i = 0; i < hdr->sequence_count; i++) {
+        const MotionPackEntry *e = &index[i];
+        if (memchr(e->name, '\0', MOTION_PACK_NAME_LEN) == NULL) return -1;
+        if (e->frame_count == 0 ||
+            (uint64_t)e->first_frame + e->frame_count > hdr->frame_count) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MOTION_PACK_FORMAT_H
@@ -0,0 +1,130 @@
+#ifndef PROTOCOL_POSEDELTA_H
+#define PROTOCOL_POSEDELTA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "versioning.h"
+#include "limits.h"
+#include "protocol_posepacket31.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * PosePacketDelta - Sparse motion packet (Brain → Muscle via the ring)
+ *
+ * Carries only the channels set in mask; the Muscle merges them into the
+ * target of the last pose it applied, so the others keep their value.
+ * Shares the PosePacket31 header (magic aside) and fits the same slot.
+ *
+ * Layout (16 + 2 * channels + 2 bytes, little-endian):
+ * Offset  Size  Field
+ * ------  ----  -----
+ *   0      2    magic (0xB31D)
+ *   2      1    ver_major (3)
+ *   3      1    ver_minor (1)
+ *   4      4    seq (same counter as PosePacket31)
+ *   8      4    t_ms
+ *  12      2    flags (FLAG_ESTOP is never sent as a delta)
+ *  14      2    mask (bit n = CHn present)
+ *  16    2*n    servo_us of the set channels, lowest channel first
+ *  16+2n   2    crc16 (over bytes 0..15+2n)
+ *
+ * Unused bytes after the CRC are zero.
+ */
+
+#define POSEDELTA_HEADER_SIZE   16
+#define POSEDELTA_MAX_CHANNELS  (SERVO_COUNT_TOTAL - 1)     // More than this is a full packet
+#define POSEDELTA_MASK_ALL      ((uint16_t)((1u << SERVO_COUNT_TOTAL) - 1))
+
+#pragma pack(push, 1)
+typedef struct {
+    uint16_t magic;                       // SPIDER_DELTA_MAGIC
+    uint8_t  ver_major;
+    uint8_t  ver_minor;
+    uint32_t seq;
+    uint32_t t_ms;
+    uint16_t flags;
+    uint16_t mask;                        // Channels carried
+    uint16_t data[POSEDELTA_MAX_CHANNELS + 1];  // Values, then crc16
+} PosePacketDelta;
+#pragma pack(pop)
+
+#ifdef __cplusplus
+static_assert(sizeof(PosePacketDelta) == sizeof(PosePacket31), "PosePacketDelta must fit a PosePacket31");
+static_assert(offsetof(PosePacketDelta, flags) == offsetof(PosePacket31, flags), "Headers must match");
+static_assert(offsetof(PosePacketDelta, data) == POSEDELTA_HEADER_SIZE, "Values start at byte 16");
+#else
+_Static_assert(sizeof(PosePacketDelta) == sizeof(PosePacket31), "PosePacketDelta must fit a PosePacket31");
+_Static_assert(offsetof(PosePacketDelta, flags) == offsetof(PosePacket31, flags), "Headers must match");
+_Static_assert(offsetof(PosePacketDelta, data) == POSEDELTA_HEADER_SIZE, "Values start at byte 16");
+#endif
+
+static inline uint32_t posedelta_channels(uint16_t mask) {
+    uint32_t n = 0;
+    for (; mask != 0; mask &= (uint16_t)(mask - 1)) {
+        n++;
+    }
+    return n;
+}
+
+// Checked before the CRC can even be located
+static inline int posedelta_mask_valid(uint16_t mask) {
+    return (mask & ~POSEDELTA_MASK_ALL) == 0 && posedelta_channels(mask) <= POSEDELTA_MAX_CHANNELS;
+}
+
+// Bytes covered by the CRC
+static inline size_t posedelta_crc_len(uint16_t mask) {
+    return POSEDELTA_HEADER_SIZE + 2 * posedelta_channels(mask);
+}
+
+/**
+ * Fill d with the masked channels of servo_us. The CRC is left zero;
+ * set it over posedelta_crc_len() bytes with posedelta_set_crc().
+ */
+static inline void posedelta_init(PosePacketDelta *d, uint32_t seq, uint32_t t_ms,
+                                  uint16_t flags, uint16_t mask, const uint16_t *servo_us) {
+    d->magic = SPIDER_DELTA_MAGIC;
+    d->ver_major = SPIDER_VERSION_MAJOR;
+    d->ver_minor = SPIDER_VERSION_MINOR;
+    d->seq = seq;
+    d->t_ms = t_ms;
+    d->flags = flags;
+    d->mask = mask;
+    uint32_t n = 0;
+    for (int ch = 0; ch < SERVO_COUNT_TOTAL; ch++) {
+        if (mask & (1u << ch)) {
+            d->data[n++] = servo_us[ch];
+        }
+    }
+    for (; n <= POSEDELTA_MAX_CHANNELS; n++) {
+        d->data[n] = 0;
+    }
+}
+
+static inline uint16_t posedelta_crc(const PosePacketDelta *d) {
+    return d->data[posedelta_channels(d->mask)];
+}
+
+static inline void posedelta_set_crc(PosePacketDelta *d, uint16_t crc) {
+    d->data[posedelta_channels(d->mask)] = crc;
+}
+
+/**
+ * Overwrite the channels d carries in target (SERVO_COUNT_TOTAL values).
+ */
+static inline void posedelta_merge(const PosePacketDelta *d, uint16_t *target) {
+    uint32_t n = 0;
+    for (int ch = 0; ch < SERVO_COUNT_TOTAL; ch++) {
+        if (d->mask & (1u << ch)) {
+            target[ch] = d->data[n++];
+        }
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PROTOCOL_POSEDELTA_H
@@ -45,6 +45,23 @@ typedef struct {
 #define FLAG_INTERP_FLOAT (0 << 3)  // bit3-4: Float interpolation
 #define FLAG_INTERP_Q16   (1 << 3)  // bit3-4: Fixed Q16 interpolation
 #define FLAG_SCAN_ENABLE  (1 << 5)  // bit5: Scan servo active
+#define FLAG_GROUP_SHIFT  8
+#define FLAG_GROUP_MASK   (0x1F << FLAG_GROUP_SHIFT)  // bit8-12: Interpolation groups (0 = all)
+
+/**
+ * Interpolation groups a packet addresses (SERVO_GROUP_* bits, limits.h).
+ * The Muscle restarts or extends only their timelines and ignores the
+ * other channels' values; no group bits means every group, as before.
+ */
+static inline uint8_t posepacket31_groups(uint16_t flags) {
+    uint8_t groups = (uint8_t)((flags & FLAG_GROUP_MASK) >> FLAG_GROUP_SHIFT);
+    return groups ? groups : SERVO_GROUP_ALL;
+}
+
+static inline uint16_t posepacket31_set_groups(uint16_t flags, uint8_t groups) {
+    return (uint16_t)((flags & ~FLAG_GROUP_MASK) |
+                      (((uint16_t)groups << FLAG_GROUP_SHIFT) & FLAG_GROUP_MASK));
+}
 
 // Compile-time size check
 #ifdef __cplusplus
@@ -0,0 +1,127 @@
+#ifndef PROTOCOL_POSEPACKETN_H
+#define PROTOCOL_POSEPACKETN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "versioning.h"
+#include "limits.h"
+#include "protocol_posepacket31.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * PosePacketN - Variable-width motion packet (Brain → Muscle via the ring)
+ *
+ * A full pose for a robot with any number of channels up to
+ * POSEPACKETN_MAX_CHANNELS. Shares the PosePacket31 header (magic aside);
+ * channel_count says how many values follow, for channels 0..count-1.
+ * A Muscle driving more channels keeps the others at their last target,
+ * one driving fewer rejects the packet.
+ *
+ * Layout (16 + 2 * count + 2 bytes, little-endian):
+ * Offset  Size  Field
+ * ------  ----  -----
+ *   0      2    magic (0xB31E)
+ *   2      1    ver_major (3)
+ *   3      1    ver_minor (1)
+ *   4      4    seq (same counter as PosePacket31)
+ *   8      4    t_ms
+ *  12      2    flags (same bits as PosePacket31)
+ *  14      1    channel_count (1..32)
+ *  15      1    reserved (0)
+ *  16    2*n    servo_us of CH0..CH(n-1)
+ *  16+2n   2    crc16 (over bytes 0..15+2n)
+ *
+ * Unused bytes after the CRC are zero. It takes a 128-byte ring slot
+ * above POSEPACKETN_SLOT64_CHANNELS channels (see shared_motion_buffer.h).
+ */
+
+#define POSEPACKETN_HEADER_SIZE     16
+#define POSEPACKETN_MAX_CHANNELS    SERVO_CHANNEL_MAX
+#define POSEPACKETN_SLOT64_CHANNELS 15      // Most that fit a 64-byte slot
+
+#pragma pack(push, 1)
+typedef struct {
+    uint16_t magic;                       // SPIDER_WIDE_MAGIC
+    uint8_t  ver_major;
+    uint8_t  ver_minor;
+    uint32_t seq;
+    uint32_t t_ms;
+    uint16_t flags;
+    uint8_t  channel_count;
+    uint8_t  reserved;
+    uint16_t data[POSEPACKETN_MAX_CHANNELS + 1];  // Values, then crc16
+} PosePacketN;
+#pragma pack(pop)
+
+#ifdef __cplusplus
+static_assert(offsetof(PosePacketN, flags) == offsetof(PosePacket31, flags), "Headers must match");
+static_assert(offsetof(PosePacketN, data) == POSEPACKETN_HEADER_SIZE, "Values start at byte 16");
+#else
+_Static_assert(offsetof(PosePacketN, flags) == offsetof(PosePacket31, flags), "Headers must match");
+_Static_assert(offsetof(PosePacketN, data) == POSEPACKETN_HEADER_SIZE, "Values start at byte 16");
+#endif
+
+// Bytes on the wire, CRC included
+static inline size_t posepacketn_size(uint32_t channels) {
+    return POSEPACKETN_HEADER_SIZE + 2 * (size_t)channels + 2;
+}
+
+// Bytes covered by the CRC
+static inline size_t posepacketn_crc_len(const PosePacketN *p) {
+    return POSEPACKETN_HEADER_SIZE + 2 * (size_t)p->channel_count;
+}
+
+// Checked before the CRC can even be located
+static inline int posepacketn_count_valid(uint8_t count) {
+    return count >= 1 && count <= POSEPACKETN_MAX_CHANNELS;
+}
+
+/**
+ * Fill p with channels 0..count-1 of servo_us. The CRC is left zero;
+ * set it over posepacketn_crc_len() bytes with posepacketn_set_crc().
+ */
+static inline void posepacketn_init(PosePacketN *p, uint32_t seq, uint32_t t_ms,
+                                    uint16_t flags, uint8_t count, const uint16_t *servo_us) {
+    p->magic = SPIDER_WIDE_MAGIC;
+    p->ver_major = SPIDER_VERSION_MAJOR;
+    p->ver_minor = SPIDER_VERSION_MINOR;
+    p->seq = seq;
+    p->t_ms = t_ms;
+    p->flags = flags;
+    p->channel_count = count;
+    p->reserved = 0;
+    uint32_t n = 0;
+    for (; n < count; n++) {
+        p->data[n] = servo_us[n];
+    }
+    for (; n <= POSEPACKETN_MAX_CHANNELS; n++) {
+        p->data[n] = 0;
+    }
+}
+
+static inline uint16_t posepacketn_crc(const PosePacketN *p) {
+    return p->data[p->channel_count];
+}
+
+static inline void posepacketn_set_crc(PosePacketN *p, uint16_t crc) {
+    p->data[p->channel_count] = crc;
+}
+
+/**
+ * Overwrite channels 0..channel_count-1 of target. The caller has
+ * checked target holds that many.
+ */
+static inline void posepacketn_merge(const PosePacketN *p, uint16_t *target) {
+    for (uint32_t ch = 0; ch < p->channel_count; ch++) {
+        target[ch] = p->data[ch];
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PROTOCOL_POSEPACKETN_H
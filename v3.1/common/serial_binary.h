@@ -0,0 +1,153 @@
+#ifndef SERIAL_BINARY_H
+#define SERIAL_BINARY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "crc16_ccitt_false.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Binary serial protocol (controller ↔ Brain, SerialControl)
+ *
+ * Text commands never contain 0x00, so the first 0x00 byte on the port
+ * switches it to binary mode. From then on every frame is COBS encoded
+ * and ends with 0x00; senders should also start each frame with 0x00 so
+ * a lost byte only costs one frame (empty frames are ignored). The port
+ * drops back to text mode on SERIAL_BIN_MSG_TEXT_MODE or after
+ * SERIAL_BIN_IDLE_MS without input. All fields are little-endian.
+ *
+ * Decoded frame:
+ * Offset  Size  Field
+ * ------  ----  -----
+ *   0      1    magic (SERIAL_BIN_MAGIC)
+ *   1      1    type (SERIAL_BIN_MSG_*)
+ *   2      n    payload (0..SERIAL_BIN_MAX_PAYLOAD)
+ *   2+n    2    crc16 (CRC-16/CCITT-FALSE over bytes 0..2+n-1)
+ *
+ * SERIAL_BIN_MSG_TEXT: one text command line without the newline, e.g.
+ *   "STATUS". Replies come back as TEXT frames while in binary mode.
+ *
+ * SERIAL_BIN_MSG_POSE: the WebSocket binary pose frame, WsPoseHeader plus
+ *   count × WsPoseEntry (common/ws_pose_binary.h), up to
+ *   SERIAL_BIN_MAX_POSES entries. The reply is SERIAL_BIN_MSG_ACK carrying
+ *   a WsPoseAck, sent when requested or on error, as over WebSocket.
+ *
+ * SERIAL_BIN_MSG_TEXT_MODE: no payload, back to newline-framed text.
+ */
+
+#define SERIAL_BIN_MAGIC            0xA5
+
+#define SERIAL_BIN_MSG_TEXT         0x01
+#define SERIAL_BIN_MSG_POSE         0x31
+#define SERIAL_BIN_MSG_TEXT_MODE    0x7F
+#define SERIAL_BIN_MSG_ACK          0xB1
+
+#define SERIAL_BIN_IDLE_MS          1000
+
+#define SERIAL_BIN_MAX_PAYLOAD      512
+#define SERIAL_BIN_MAX_POSES        ((SERIAL_BIN_MAX_PAYLOAD - 4) / 32)
+#define SERIAL_BIN_MAX_FRAME        (2 + SERIAL_BIN_MAX_PAYLOAD + 2)
+// COBS adds one byte per 254, plus the leading and trailing delimiters
+#define SERIAL_BIN_MAX_ENCODED      (SERIAL_BIN_MAX_FRAME + SERIAL_BIN_MAX_FRAME / 254 + 3)
+
+/**
+ * COBS-encode len bytes into out (at least len + len / 254 + 1 bytes).
+ * The result contains no 0x00. Returns the encoded length.
+ */
+static inline size_t cobs_encode(const uint8_t *in, size_t len, uint8_t *out) {
+    size_t code_pos = 0;
+    size_t out_len = 1;
+    uint8_t code = 1;
+
+    for (size_t i = 0; i < len; i++) {
+        if (in[i] != 0) {
+            out[out_len++] = in[i];
+            code++;
+        }
+        if (in[i] == 0 || code == 0xFF) {
+            out[code_pos] = code;
+            code_pos = out_len++;
+            code = 1;
+        }
+    }
+    out[code_pos] = code;
+    return out_len;
+}
+
+/**
+ * Decode a COBS block (without its 0x00 delimiter) into out, which must
+ * hold max bytes. Returns the decoded length, or -1 if the input is
+ * malformed or does not fit.
+ */
+static inline int cobs_decode(const uint8_t *in, size_t len, uint8_t *out, size_t max) {
+    size_t out_len = 0;
+    size_t i = 0;
+
+    while (i < len) {
+        uint8_t code = in[i++];
+        if (code == 0 || i + code - 1 > len) return -1;
+
+        for (uint8_t k = 1; k < code; k++) {
+            if (in[i] == 0 || out_len >= max) return -1;
+            out[out_len++] = in[i++];
+        }
+        // A zero follows every group except a full one or the last
+        if (code != 0xFF && i < len) {
+            if (out_len >= max) return -1;
+            out[out_len++] = 0;
+        }
+    }
+    return (int)out_len;
+}
+
+/**
+ * Build a complete frame, delimiters included, into out (at least
+ * SERIAL_BIN_MAX_ENCODED bytes). Returns the number of bytes to write,
+ * or 0 if the payload is too long.
+ */
+static inline size_t serial_bin_pack(uint8_t *out, uint8_t type, const void *payload, size_t len) {
+    uint8_t raw[SERIAL_BIN_MAX_FRAME];
+
+    if (len > SERIAL_BIN_MAX_PAYLOAD) return 0;
+
+    raw[0] = SERIAL_BIN_MAGIC;
+    raw[1] = type;
+    if (len > 0) {
+        memcpy(raw + 2, payload, len);
+    }
+    uint16_t crc = crc16_ccitt_false(raw, 2 + len);
+    raw[2 + len] = (uint8_t)(crc & 0xFF);
+    raw[3 + len] = (uint8_t)(crc >> 8);
+
+    out[0] = 0;
+    size_t n = 1 + cobs_encode(raw, 4 + len, out + 1);
+    out[n++] = 0;
+    return n;
+}
+
+/**
+ * Decode one COBS block (between delimiters) into raw (at least
+ * SERIAL_BIN_MAX_FRAME bytes) and check magic and CRC. On success stores
+ * the type and returns the payload length; the payload starts at raw + 2.
+ * Returns -1 for anything malformed.
+ */
+static inline int serial_bin_unpack(const uint8_t *in, size_t len, uint8_t *raw, uint8_t *type) {
+    int n = cobs_decode(in, len, raw, SERIAL_BIN_MAX_FRAME);
+    if (n < 4 || raw[0] != SERIAL_BIN_MAGIC) return -1;
+
+    uint16_t crc = (uint16_t)(raw[n - 2] | (raw[n - 1] << 8));
+    if (crc16_ccitt_false(raw, (size_t)n - 2) != crc) return -1;
+
+    *type = raw[1];
+    return n - 4;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SERIAL_BINARY_H
@@ -0,0 +1,98 @@
+/**
+ * Servo Calibration Table - Binary Format
+ *
+ * Per-channel calibration applied by the Brain to every outgoing pose,
+ * written by python/calibration.py (--export) and loaded by the daemon
+ * at startup or on calib_reload. Logical pulse widths map to physical
+ * ones as
+ *
+ *     out = clamp(neutral + direction * scale * (in - neutral) + offset,
+ *                 min_us, max_us)
+ *
+ * with neutral = SERVO_PWM_NEUTRAL_US.
+ *
+ * Layout (little-endian):
+ * ┌────────────────────────────────────────┐
+ * │ ServoCalibHeader (16 bytes)            │
+ * ├────────────────────────────────────────┤
+ * │ ServoCalibChannel[SERVO_COUNT_TOTAL]   │
+ * └────────────────────────────────────────┘
+ */
+
+#ifndef SERVO_CALIB_FORMAT_H
+#define SERVO_CALIB_FORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "limits.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SERVO_CALIB_MAGIC       0x4C435353  // "SSCL"
+#define SERVO_CALIB_VERSION     0x0100      // v1.0
+#define SERVO_CALIB_SCALE_ONE   4096        // Q12
+#define SERVO_CALIB_SCALE_MIN   2048        // 0.5
+#define SERVO_CALIB_SCALE_MAX   8192        // 2.0
+
+// CALIB_OFFSET_MIN/MAX_DEG in us, at 2000 us per 180 degrees
+#define SERVO_CALIB_OFFSET_MIN_US  (CALIB_OFFSET_MIN_DEG * 2000 / 180)
+#define SERVO_CALIB_OFFSET_MAX_US  (CALIB_OFFSET_MAX_DEG * 2000 / 180)
+
+typedef struct {
+    uint32_t magic;             // SERVO_CALIB_MAGIC
+    uint16_t version;           // SERVO_CALIB_VERSION
+    uint16_t channel_count;     // SERVO_COUNT_TOTAL
+    uint32_t file_size;
+    uint32_t reserved;
+} ServoCalibHeader;
+
+typedef struct {
+    int16_t  offset_us;         // Added after scaling
+    int8_t   direction;         // +1 or -1 (servo mounted mirrored)
+    uint8_t  reserved0;
+    uint16_t scale_q12;         // Travel scale, SERVO_CALIB_SCALE_ONE = 1.0
+    uint16_t min_us;            // Physical limits, within SERVO_PWM_MIN/MAX_US
+    uint16_t max_us;
+    uint16_t reserved1;
+} ServoCalibChannel;
+
+#ifdef __cplusplus
+static_assert(sizeof(ServoCalibHeader) == 16, "ServoCalibHeader must be 16 bytes");
+static_assert(sizeof(ServoCalibChannel) == 12, "ServoCalibChannel must be 12 bytes");
+#else
+_Static_assert(sizeof(ServoCalibHeader) == 16, "ServoCalibHeader must be 16 bytes");
+_Static_assert(sizeof(ServoCalibChannel) == 12, "ServoCalibChannel must be 12 bytes");
+#endif
+
+/**
+ * Check a table of size bytes: header, channel count and every channel's
+ * values in range. Returns 0 if valid, -1 otherwise.
+ */
+static inline int servo_calib_validate(const void *base, size_t size) {
+    if (size < sizeof(ServoCalibHeader)) return -1;
+
+    const ServoCalibHeader *hdr = (const ServoCalibHeader *)base;
+    if (hdr->magic != SERVO_CALIB_MAGIC || (hdr->version >> 8) != (SERVO_CALIB_VERSION >> 8)) return -1;
+    if (hdr->file_size != size || hdr->channel_count != SERVO_COUNT_TOTAL) return -1;
+    if (size != sizeof(ServoCalibHeader) + SERVO_COUNT_TOTAL * sizeof(ServoCalibChannel)) return -1;
+
+    const ServoCalibChannel *ch = (const ServoCalibChannel *)(hdr + 1);
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) {
+        if (ch[i].direction != 1 && ch[i].direction != -1) return -1;
+        if (ch[i].offset_us < SERVO_CALIB_OFFSET_MIN_US || ch[i].offset_us > SERVO_CALIB_OFFSET_MAX_US) return -1;
+        if (ch[i].scale_q12 < SERVO_CALIB_SCALE_MIN || ch[i].scale_q12 > SERVO_CALIB_SCALE_MAX) return -1;
+        if (ch[i].min_us < SERVO_PWM_MIN_US || ch[i].max_us > SERVO_PWM_MAX_US ||
+            ch[i].min_us > ch[i].max_us) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SERVO_CALIB_FORMAT_H
@@ -0,0 +1,221 @@
+/**
+ * Shared Packet Acknowledgements for Spider Robot Delivery Tracking
+ *
+ * Used by BOTH Linux (Brain, reader) and FreeRTOS (Muscle, writer).
+ *
+ * The reverse direction of the motion ring: for every slot it consumes
+ * the Muscle appends one record with the packet seq and whether it was
+ * applied or why it was rejected (the validate_packet() checks, or
+ * discarded under E-STOP). read_idx already returns ring credit; this
+ * tells the Brain what became of each packet.
+ *
+ * Layout: behind the latency probe in the reserved tail
+ * ┌────────────────────────────────────────┐
+ * │ SharedAckHeader (64 bytes)             │
+ * │ ├─ magic/version   - Written at boot   │
+ * │ ├─ record_count    - Power of 2        │
+ * │ └─ write_idx       - Monotonic counter │
+ * ├────────────────────────────────────────┤
+ * │ SharedAckRecord[record_count] (16 each)│
+ * │ ├─ stamp           - Index + 1, last   │
+ * │ ├─ seq             - Packet seq        │
+ * │ ├─ time_us         - Low 32 bits       │
+ * │ └─ status, slot                        │
+ * └────────────────────────────────────────┘
+ *
+ * Single writer, overwriting the oldest record; a reader that falls
+ * more than record_count behind learns how many it missed. Records are
+ * stamped and re-checked as in shared_log.h.
+ */
+
+#ifndef SHARED_ACK_H
+#define SHARED_ACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "shared_motion_buffer.h"
+#include "shared_probe.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SHARED_ACK_MAGIC        0x4B415053  // "SPAK"
+#define SHARED_ACK_VERSION      0x0100      // v1.0
+
+#define SHARED_ACK_RECORD_SIZE  16
+#define SHARED_ACK_RECORDS      256
+#define SHARED_ACK_AREA_SIZE    (SHARED_CACHE_LINE + SHARED_ACK_RECORDS * SHARED_ACK_RECORD_SIZE)
+#define SHARED_ACK_OFFSET       (SHARED_PROBE_OFFSET + SHARED_PROBE_SIZE)
+
+// Status: 0 = applied, SKIPPED = applied but superseded before output,
+// otherwise why the packet was dropped. The NACK codes for the packet
+// checks are validate_packet()'s return, negated.
+#define SHARED_ACK_OK           0   // Handed to the output task (or E-STOP executed)
+#define SHARED_NACK_MAGIC       1
+#define SHARED_NACK_VERSION     2
+#define SHARED_NACK_CRC         3
+#define SHARED_NACK_SEQ         4   // Not newer than the last applied seq
+#define SHARED_NACK_ESTOP       5   // Discarded while E-STOP is latched
+#define SHARED_NACK_COUNT       6   // NACK codes are 1 .. SHARED_NACK_COUNT - 1
+#define SHARED_ACK_SKIPPED      6   // Merged into a newer immediate pose, never output on its own
+#define SHARED_ACK_STATUS_COUNT 7
+
+typedef struct {
+    uint32_t magic;                 // SHARED_ACK_MAGIC, written last at init
+    uint16_t version;               // SHARED_ACK_VERSION
+    uint16_t record_size;           // SHARED_ACK_RECORD_SIZE
+    uint32_t record_count;          // Power of 2
+    volatile uint32_t write_idx;    // Records written since boot
+    uint32_t reserved[12];
+} SharedAckHeader;
+
+typedef struct {
+    volatile uint32_t stamp;        // Record index + 1, 0 while being written
+    uint32_t seq;                   // PosePacket31 seq (0 if the magic was bad)
+    uint32_t time_us;               // Low 32 bits of timebase_shared_us() at the decision
+    uint8_t status;                 // SHARED_ACK_* / SHARED_NACK_*
+    uint8_t reserved0;
+    uint16_t slot;                  // Low 16 bits of the ring index it came from
+} SharedAckRecord;
+
+#ifdef __cplusplus
+static_assert(sizeof(SharedAckHeader) == SHARED_CACHE_LINE, "SharedAckHeader must be one line");
+static_assert(sizeof(SharedAckRecord) == SHARED_ACK_RECORD_SIZE, "SharedAckRecord must be 16 bytes");
+static_assert(SHARED_ACK_OFFSET % SHARED_CACHE_LINE == 0, "Ack area must be line aligned");
+static_assert(SHARED_ACK_OFFSET + SHARED_ACK_AREA_SIZE <= SHARED_MEM_SIZE, "Ack area must fit the tail");
+#else
+_Static_assert(sizeof(SharedAckHeader) == SHARED_CACHE_LINE, "SharedAckHeader must be one line");
+_Static_assert(sizeof(SharedAckRecord) == SHARED_ACK_RECORD_SIZE, "SharedAckRecord must be 16 bytes");
+_Static_assert(SHARED_ACK_OFFSET % SHARED_CACHE_LINE == 0, "Ack area must be line aligned");
+_Static_assert(SHARED_ACK_OFFSET + SHARED_ACK_AREA_SIZE <= SHARED_MEM_SIZE, "Ack area must fit the tail");
+#endif
+
+static inline volatile SharedAckHeader *shared_ack_area(volatile void *region_base) {
+    return (volatile SharedAckHeader *)((volatile uint8_t *)region_base + SHARED_ACK_OFFSET);
+}
+
+static inline volatile SharedAckRecord *shared_ack_record(volatile SharedAckHeader *ack,
+                                                          uint32_t idx) {
+    volatile uint8_t *base = (volatile uint8_t *)ack + SHARED_CACHE_LINE;
+    return (volatile SharedAckRecord *)(base + (idx & (ack->record_count - 1)) * SHARED_ACK_RECORD_SIZE);
+}
+
+/**
+ * Writer: reset the area. Not safe against a concurrent append.
+ */
+static inline void shared_ack_init(volatile SharedAckHeader *ack) {
+    ack->magic = 0;
+    SHARED_FENCE_FULL();
+    ack->version = SHARED_ACK_VERSION;
+    ack->record_size = SHARED_ACK_RECORD_SIZE;
+    ack->record_count = SHARED_ACK_RECORDS;
+    ack->write_idx = 0;
+    for (uint32_t i = 0; i < SHARED_ACK_RECORDS; i++) {
+        shared_ack_record(ack, i)->stamp = 0;
+    }
+    SHARED_STORE_RELEASE(&ack->magic, (uint32_t)SHARED_ACK_MAGIC);
+}
+
+/**
+ * Writer: fill the next record and return it. It is not visible until
+ * shared_ack_publish(), so the caller can clean its line first and a
+ * reader never sees write_idx ahead of the record. Appends must be
+ * serialized by the caller.
+ */
+static inline volatile SharedAckRecord *shared_ack_append(volatile SharedAckHeader *ack,
+                                                          uint32_t seq, uint8_t status,
+                                                          uint32_t slot, uint64_t time_us) {
+    uint32_t idx = ack->write_idx;
+    volatile SharedAckRecord *rec = shared_ack_record(ack, idx);
+
+    SHARED_STORE_RELEASE(&rec->stamp, 0u);
+    rec->seq = seq;
+    rec->time_us = (uint32_t)time_us;
+    rec->status = status;
+    rec->reserved0 = 0;
+    rec->slot = (uint16_t)slot;
+    SHARED_STORE_RELEASE(&rec->stamp, idx + 1);
+    return rec;
+}
+
+/**
+ * Writer: make the record from the last shared_ack_append() visible.
+ */
+static inline void shared_ack_publish(volatile SharedAckHeader *ack) {
+    SHARED_STORE_RELEASE(&ack->write_idx, ack->write_idx + 1);
+}
+
+static inline int shared_ack_valid(const volatile SharedAckHeader *ack) {
+    uint32_t n = ack->record_count;
+    return SHARED_LOAD_ACQUIRE(&ack->magic) == SHARED_ACK_MAGIC &&
+           ack->version == SHARED_ACK_VERSION &&
+           ack->record_size == SHARED_ACK_RECORD_SIZE &&
+           n >= 1 && n <= SHARED_ACK_RECORDS && (n & (n - 1)) == 0;
+}
+
+/**
+ * Reader: copy the record at *cursor into out and advance.
+ * Returns 1 if a record was copied, 0 if the reader has caught up.
+ * *lost accumulates records overwritten before they could be read;
+ * a writer restart (write_idx behind the cursor) rewinds the cursor.
+ */
+static inline int shared_ack_read(volatile SharedAckHeader *ack, uint32_t *cursor,
+                                  SharedAckRecord *out, uint32_t *lost) {
+    uint32_t n = ack->record_count;
+
+    while (1) {
+        uint32_t w = SHARED_LOAD_ACQUIRE(&ack->write_idx);
+        uint32_t c = *cursor;
+        if ((int32_t)(w - c) < 0) {
+            c = (w > n) ? w - n : 0;
+        }
+        if (c == w) {
+            *cursor = c;
+            return 0;
+        }
+        if (w - c > n) {
+            *lost += w - c - n;
+            c = w - n;
+        }
+
+        volatile SharedAckRecord *rec = shared_ack_record(ack, c);
+        uint32_t stamp = SHARED_LOAD_ACQUIRE(&rec->stamp);
+        if (stamp == c + 1) {
+            out->seq = rec->seq;
+            out->time_us = rec->time_us;
+            out->status = rec->status;
+            out->reserved0 = 0;
+            out->slot = rec->slot;
+            SHARED_FENCE_FULL();
+            if (rec->stamp == stamp) {
+                out->stamp = stamp;
+                *cursor = c + 1;
+                return 1;
+            }
+        }
+
+        // Rewritten while we looked: it is gone, move on
+        (*lost)++;
+        *cursor = c + 1;
+    }
+}
+
+static inline const char *shared_ack_status_name(uint8_t status) {
+    switch (status) {
+    case SHARED_ACK_OK:         return "ok";
+    case SHARED_NACK_MAGIC:     return "magic";
+    case SHARED_NACK_VERSION:   return "version";
+    case SHARED_NACK_CRC:       return "crc";
+    case SHARED_NACK_SEQ:       return "seq";
+    case SHARED_NACK_ESTOP:     return "estop";
+    case SHARED_ACK_SKIPPED:    return "skipped";
+    default:                    return "unknown";
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SHARED_ACK_H
@@ -0,0 +1,254 @@
+/**
+ * Shared Event Log for Spider Robot Inter-Core Diagnostics
+ *
+ * Used by BOTH Linux (Brain, reader) and FreeRTOS (Muscle, writer).
+ *
+ * The Muscle records fixed-size binary events here instead of calling
+ * printf on the hot path. Formatting happens later, in a low-priority
+ * Muscle task that echoes to the UART and/or in the Brain, which maps the
+ * same region and reads the records directly.
+ *
+ * Layout: first area of the reserved tail (see shared_motion_buffer.h)
+ * ┌────────────────────────────────────────┐
+ * │ SharedLogHeader (64 bytes)             │
+ * │ ├─ magic/version   - Written at boot   │
+ * │ ├─ record_count    - Power of 2        │
+ * │ ├─ write_idx       - Monotonic counter │
+ * │ └─ suppressed      - Rate-limited hits │
+ * ├────────────────────────────────────────┤
+ * │ SharedLogRecord[record_count] (32 each)│
+ * │ ├─ seq             - Index + 1, last   │
+ * │ ├─ event/count                         │
+ * │ ├─ time_us         - Shared timebase   │
+ * │ └─ args[4]                             │
+ * └────────────────────────────────────────┘
+ *
+ * The whole area has a single writer, so readers never store to it and
+ * any number of them can follow with their own cursor. The writer
+ * overwrites the oldest record when the ring is full; a reader that falls
+ * behind learns how many records it missed. Each record is stamped with
+ * seq = index + 1 after its payload, so a reader copies it, re-checks seq,
+ * and discards a record that was rewritten under it.
+ */
+
+#ifndef SHARED_LOG_H
+#define SHARED_LOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "shared_motion_buffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SHARED_LOG_MAGIC        0x474C5053  // "SPLG"
+#define SHARED_LOG_VERSION      0x0100      // v1.0
+
+#define SHARED_LOG_RECORD_SIZE  32
+#define SHARED_LOG_RECORDS      256
+#define SHARED_LOG_ARGS         4
+#define SHARED_LOG_AREA_SIZE    (SHARED_CACHE_LINE + SHARED_LOG_RECORDS * SHARED_LOG_RECORD_SIZE)
+#define SHARED_LOG_OFFSET       SHARED_RING_REGION_SIZE     // Start of the reserved tail
+
+// Event IDs
+#define SHARED_LOG_EVT_BOOT             1   // args: version major, minor
+#define SHARED_LOG_EVT_PKT_MAGIC        2   // args: magic
+#define SHARED_LOG_EVT_PKT_VERSION      3   // args: major, minor
+#define SHARED_LOG_EVT_PKT_CRC          4   // args: computed, in packet
+#define SHARED_LOG_EVT_PKT_SEQ          5   // args: seq, last accepted seq
+#define SHARED_LOG_EVT_ESTOP            6
+#define SHARED_LOG_EVT_LAYOUT_REJECTED  7   // args: -err, magic, version
+#define SHARED_LOG_EVT_RING_ATTACHED    8   // args: version, slot count
+#define SHARED_LOG_EVT_WDT_TIMEOUT      9
+#define SHARED_LOG_EVT_WDT_ESTOP        10
+#define SHARED_LOG_EVT_UNKNOWN_CMD      11  // args: cmd id, total unknown
+#define SHARED_LOG_EVT_STATUS           12  // args: rx, drop, last seq, estop
+#define SHARED_LOG_EVT_ESTOP_INPUT      13  // args: 1 if already asserted at boot
+#define SHARED_LOG_EVT_TUNABLES         14  // args: generation, output Hz, substeps, heartbeat ms
+#define SHARED_LOG_EVT_COUNT            15
+
+// Severity for the reader's log level
+#define SHARED_LOG_LEVEL_DEBUG  0
+#define SHARED_LOG_LEVEL_INFO   1
+#define SHARED_LOG_LEVEL_WARN   2
+#define SHARED_LOG_LEVEL_ERROR  3
+
+typedef struct {
+    uint32_t magic;                 // SHARED_LOG_MAGIC, written last at init
+    uint16_t version;               // SHARED_LOG_VERSION
+    uint16_t record_size;           // SHARED_LOG_RECORD_SIZE
+    uint32_t record_count;          // Power of 2
+    volatile uint32_t write_idx;    // Records written since boot
+    volatile uint32_t suppressed;   // Events dropped by rate limiting
+    uint32_t reserved[11];
+} SharedLogHeader;
+
+typedef struct {
+    volatile uint32_t seq;          // Record index + 1, 0 while being written
+    uint16_t event;                 // SHARED_LOG_EVT_*
+    uint16_t count;                 // Occurrences folded into this record (>= 1)
+    uint64_t time_us;               // timebase_shared_us() of the latest occurrence
+    uint32_t args[SHARED_LOG_ARGS];
+} SharedLogRecord;
+
+#ifdef __cplusplus
+static_assert(sizeof(SharedLogHeader) == SHARED_CACHE_LINE, "SharedLogHeader must be one line");
+static_assert(sizeof(SharedLogRecord) == SHARED_LOG_RECORD_SIZE, "SharedLogRecord must be 32 bytes");
+static_assert(SHARED_LOG_AREA_SIZE <= SHARED_TAIL_SIZE, "Log area must fit the reserved tail");
+#else
+_Static_assert(sizeof(SharedLogHeader) == SHARED_CACHE_LINE, "SharedLogHeader must be one line");
+_Static_assert(sizeof(SharedLogRecord) == SHARED_LOG_RECORD_SIZE, "SharedLogRecord must be 32 bytes");
+_Static_assert(SHARED_LOG_AREA_SIZE <= SHARED_TAIL_SIZE, "Log area must fit the reserved tail");
+#endif
+
+static inline volatile SharedLogHeader *shared_log_area(volatile void *region_base) {
+    return (volatile SharedLogHeader *)((volatile uint8_t *)region_base + SHARED_LOG_OFFSET);
+}
+
+static inline volatile SharedLogRecord *shared_log_record(volatile SharedLogHeader *log,
+                                                          uint32_t idx) {
+    volatile uint8_t *base = (volatile uint8_t *)log + SHARED_CACHE_LINE;
+    return (volatile SharedLogRecord *)(base + (idx & (log->record_count - 1)) * SHARED_LOG_RECORD_SIZE);
+}
+
+/**
+ * Writer: reset the area. Not safe against a concurrent append.
+ */
+static inline void shared_log_init(volatile SharedLogHeader *log) {
+    log->magic = 0;
+    SHARED_FENCE_FULL();
+    log->version = SHARED_LOG_VERSION;
+    log->record_size = SHARED_LOG_RECORD_SIZE;
+    log->record_count = SHARED_LOG_RECORDS;
+    log->write_idx = 0;
+    log->suppressed = 0;
+    for (uint32_t i = 0; i < SHARED_LOG_RECORDS; i++) {
+        shared_log_record(log, i)->seq = 0;
+    }
+    SHARED_STORE_RELEASE(&log->magic, (uint32_t)SHARED_LOG_MAGIC);
+}
+
+/**
+ * Writer: append one record and return it (so the caller can clean its
+ * line). Appends must be serialized by the caller.
+ */
+static inline volatile SharedLogRecord *shared_log_append(volatile SharedLogHeader *log,
+                                                          uint16_t event, uint16_t count,
+                                                          uint64_t time_us, const uint32_t *args) {
+    uint32_t idx = log->write_idx;
+    volatile SharedLogRecord *rec = shared_log_record(log, idx);
+
+    SHARED_STORE_RELEASE(&rec->seq, 0u);
+    rec->event = event;
+    rec->count = count;
+    rec->time_us = time_us;
+    for (int i = 0; i < SHARED_LOG_ARGS; i++) {
+        rec->args[i] = args ? args[i] : 0;
+    }
+    SHARED_STORE_RELEASE(&rec->seq, idx + 1);
+    SHARED_STORE_RELEASE(&log->write_idx, idx + 1);
+    return rec;
+}
+
+static inline int shared_log_valid(const volatile SharedLogHeader *log) {
+    uint32_t n = log->record_count;
+    return SHARED_LOAD_ACQUIRE(&log->magic) == SHARED_LOG_MAGIC &&
+           log->version == SHARED_LOG_VERSION &&
+           log->record_size == SHARED_LOG_RECORD_SIZE &&
+           n >= 1 && n <= SHARED_LOG_RECORDS && (n & (n - 1)) == 0;
+}
+
+/**
+ * Reader: copy the record at *cursor into out and advance.
+ * Returns 1 if a record was copied, 0 if the reader has caught up.
+ * *lost accumulates records overwritten before they could be read;
+ * a writer restart (write_idx behind the cursor) rewinds the cursor.
+ */
+static inline int shared_log_read(volatile SharedLogHeader *log, uint32_t *cursor,
+                                  SharedLogRecord *out, uint32_t *lost) {
+    uint32_t n = log->record_count;
+
+    while (1) {
+        uint32_t w = SHARED_LOAD_ACQUIRE(&log->write_idx);
+        uint32_t c = *cursor;
+        if ((int32_t)(w - c) < 0) {
+            c = (w > n) ? w - n : 0;
+        }
+        if (c == w) {
+            *cursor = c;
+            return 0;
+        }
+        if (w - c > n) {
+            *lost += w - c - n;
+            c = w - n;
+        }
+
+        volatile SharedLogRecord *rec = shared_log_record(log, c);
+        uint32_t seq = SHARED_LOAD_ACQUIRE(&rec->seq);
+        if (seq == c + 1) {
+            out->event = rec->event;
+            out->count = rec->count;
+            out->time_us = rec->time_us;
+            for (int i = 0; i < SHARED_LOG_ARGS; i++) {
+                out->args[i] = rec->args[i];
+            }
+            SHARED_FENCE_FULL();
+            if (rec->seq == seq) {
+                out->seq = seq;
+                *cursor = c + 1;
+                return 1;
+            }
+        }
+
+        // Rewritten while we looked: it is gone, move on
+        (*lost)++;
+        *cursor = c + 1;
+    }
+}
+
+static inline const char *shared_log_format(uint16_t event) {
+    switch (event) {
+    case SHARED_LOG_EVT_BOOT:            return "Muscle runtime v%lu.%lu started";
+    case SHARED_LOG_EVT_PKT_MAGIC:       return "Bad magic: 0x%04lX";
+    case SHARED_LOG_EVT_PKT_VERSION:     return "Bad version: %lu.%lu";
+    case SHARED_LOG_EVT_PKT_CRC:         return "CRC mismatch: calc=0x%04lX pkt=0x%04lX";
+    case SHARED_LOG_EVT_PKT_SEQ:         return "Stale seq %lu (last %lu)";
+    case SHARED_LOG_EVT_ESTOP:           return "ESTOP activated - all servos neutral";
+    case SHARED_LOG_EVT_LAYOUT_REJECTED: return "Shared layout rejected (err=-%lu magic=0x%08lX ver=0x%04lX)";
+    case SHARED_LOG_EVT_RING_ATTACHED:   return "Shared ring v%lu.%lu attached: %lu slots";
+    case SHARED_LOG_EVT_WDT_TIMEOUT:     return "WATCHDOG: Heartbeat timeout!";
+    case SHARED_LOG_EVT_WDT_ESTOP:       return "WATCHDOG: ESTOP triggered!";
+    case SHARED_LOG_EVT_UNKNOWN_CMD:     return "Unknown mailbox cmd 0x%02lX (%lu total)";
+    case SHARED_LOG_EVT_STATUS:          return "Status: rx=%lu drop=%lu seq=%lu estop=%lu";
+    case SHARED_LOG_EVT_ESTOP_INPUT:     return "ESTOP input asserted (at boot: %lu)";
+    case SHARED_LOG_EVT_TUNABLES:        return "Tunables gen %lu applied: %lu Hz, %lu substeps, heartbeat %lu ms";
+    default:                             return "Unknown event (args 0x%lX 0x%lX 0x%lX 0x%lX)";
+    }
+}
+
+static inline int shared_log_level(uint16_t event) {
+    switch (event) {
+    case SHARED_LOG_EVT_PKT_SEQ:
+    case SHARED_LOG_EVT_STATUS:
+        return SHARED_LOG_LEVEL_DEBUG;
+    case SHARED_LOG_EVT_BOOT:
+    case SHARED_LOG_EVT_RING_ATTACHED:
+    case SHARED_LOG_EVT_TUNABLES:
+        return SHARED_LOG_LEVEL_INFO;
+    case SHARED_LOG_EVT_ESTOP:
+    case SHARED_LOG_EVT_WDT_TIMEOUT:
+    case SHARED_LOG_EVT_WDT_ESTOP:
+    case SHARED_LOG_EVT_ESTOP_INPUT:
+    case SHARED_LOG_EVT_LAYOUT_REJECTED:
+        return SHARED_LOG_LEVEL_ERROR;
+    default:
+        return SHARED_LOG_LEVEL_WARN;
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SHARED_LOG_H
@@ -1,82 +1,275 @@
 /**
- * Shared Memory Ring Buffer for Spider Robot v3.1 Inter-Core Communication
- * 
+ * Shared Memory Trajectory Ring for Spider Robot Inter-Core Communication
+ *
  * Used by BOTH Linux (Brain) and FreeRTOS (Muscle) for zero-copy packet transfer.
- * 
- * Memory Layout at 0x83F00000 (256KB reserved):
+ *
+ * Layout v3.5 at 0x83F00000 (256KB reserved):
  * ┌────────────────────────────────────────┐
- * │ SharedMotionBuffer (528 bytes)         │
- * │ ├─ write_idx (4)   - Linux writes      │
- * │ ├─ read_idx (4)    - FreeRTOS writes   │
- * │ ├─ flags (4)       - Status flags      │
- * │ ├─ reserved (4)    - Alignment         │
- * │ └─ packets[8][64]  - Ring buffer slots │
+ * │ SharedRingHeader (192 bytes)           │
+ * │ Line 0 - Linux writes once             │
+ * │ ├─ magic/version   - Layout identity   │
+ * │ ├─ header_size     - Offset of slots   │
+ * │ ├─ slot_size       - Bytes per slot    │
+ * │ ├─ slot_count      - Power of 2        │
+ * │ └─ brain_flags     - BRAIN_READY       │
+ * │ Line 1 - Linux writes                  │
+ * │ ├─ write_idx                           │
+ * │ └─ brain_alive     - Liveness counter  │
+ * │ Line 2 - FreeRTOS writes               │
+ * │ ├─ read_idx                            │
+ * │ └─ muscle_flags    - All other flags   │
+ * ├────────────────────────────────────────┤
+ * │ SharedRingSlot[slot_count] (slot_size) │
+ * │ ├─ exec_at_us (8)  - Shared timebase   │
+ * │ ├─ gen (4)         - Ring index + 1    │
+ * │ ├─ reserved (4)                        │
+ * │ └─ PosePacket31 (42) + padding         │
+ * │    or PosePacketDelta / PosePacketN    │
+ * ├────────────────────────────────────────┤
+ * │ Reserved tail (top SHARED_TAIL_SIZE)   │
+ * │ └─ FreeRTOS event log (shared_log.h)   │
  * └────────────────────────────────────────┘
- * 
+ *
+ * Negotiation:
+ * 1. Linux picks slot_size (whole cache lines, enough for the widest
+ *    packet it sends: 64 bytes, or 128 for a PosePacketN of more than 15
+ *    channels) and slot_count (largest power of 2 that fits below the
+ *    reserved tail, optionally capped), writes the header, clears muscle_flags, then sets
+ *    SHARED_FLAG_BRAIN_READY in brain_flags
+ * 2. FreeRTOS validates magic, version, slot_size and slot_count against
+ *    the region before touching any slot, then sets SHARED_FLAG_MUSCLE_READY
+ * 3. A header FreeRTOS does not understand is never consumed
+ *
+ * header_size is the offset of slot 0. A Brain that maps the slots
+ * cacheable uses SHARED_HEADER_SIZE_PAGED, so the indices (written by
+ * both sides) stay alone in an uncached page and only Brain-written slot
+ * lines go through the D-cache (see cache_ops.h).
+ *
  * Flow:
- * 1. Linux writes PosePacket31 to packets[write_idx % 8]
- * 2. Linux increments write_idx (memory barrier)
+ * 1. Linux writes slots[write_idx & (slot_count - 1)]
+ * 2. Linux publishes write_idx with a release store
  * 3. Linux sends mailbox notification via /dev/cvi-rtos-cmdqu
- * 4. FreeRTOS receives mailbox IRQ
- * 5. FreeRTOS reads packets from read_idx to write_idx
- * 6. FreeRTOS increments read_idx after processing
+ * 4. FreeRTOS reads slots from read_idx to write_idx
+ * 5. FreeRTOS validates each slot into its private queue (up to
+ *    MUSCLE_PREFETCH_DEPTH ahead of output) and increments read_idx past
+ *    it at once; a queued slot is applied once timebase_shared_us()
+ *    reaches exec_at_us (0 = apply on arrival). With the queue full,
+ *    FreeRTOS stops and leaves the rest in the ring
+ *
+ * Overwrite: a Brain stream with the overwrite-oldest policy may write
+ * into a full ring, reusing the oldest slot the Muscle has not consumed;
+ * write_idx then runs more than slot_count ahead of read_idx. Each slot
+ * carries gen = its ring index + 1, zeroed while an overwrite is in
+ * progress. The Muscle copies a slot and accepts it only if gen matched
+ * before and after the copy; otherwise the slot was lapped or torn and
+ * it resumes at the oldest slot still in the ring (write_idx - slot_count).
+ *
+ * Each word has a single writer and each index sits in its own line, so
+ * the cores never bounce a line they both write. Each side keeps its own
+ * index locally and a cached copy of the other's, refreshing that copy
+ * (acquire load) only when the ring looks full (Linux) or empty (FreeRTOS).
+ *
+ * Batching: Linux may publish several slots with one write_idx update and
+ * one notification. While FreeRTOS holds SHARED_FLAG_NOTIFY_SUPPRESS it is
+ * already draining, so Linux skips step 3. FreeRTOS must re-check write_idx
+ * after clearing the flag. This store-then-load handshake is the one place
+ * either side needs a full fence.
+ *
+ * Liveness: Linux bumps brain_alive once per heartbeat period. A Muscle
+ * whose watchdog samples it sets SHARED_FLAG_ALIVE_WATCH and needs no
+ * CMD_HEARTBEAT interrupt. Otherwise Linux still sends one, but only in
+ * periods where read_idx did not move (every consumed packet already fed
+ * the watchdog).
  */
 
 #ifndef SHARED_MOTION_BUFFER_H
 #define SHARED_MOTION_BUFFER_H
 
+#include <stddef.h>
 #include <stdint.h>
+#include "protocol_posepacket31.h"
+#include "protocol_posepacketn.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// Host builds (the simulator) point this at ordinary memory
+#ifndef SHARED_MEM_BASE
 #define SHARED_MEM_BASE         0x83F00000
+#endif
 #define SHARED_MEM_SIZE         0x40000     // 256KB reserved for FreeRTOS comm
 
-#define PACKET_RING_SIZE        8           // Must be power of 2
-#define PACKET_SLOT_SIZE        64          // Each slot fits PosePacket31 (42 bytes) + padding
+// The top of the reservation holds FreeRTOS-owned areas; the ring never reaches it
+#define SHARED_TAIL_SIZE        0x8000
+#define SHARED_RING_REGION_SIZE (SHARED_MEM_SIZE - SHARED_TAIL_SIZE)
+
+#define SHARED_LAYOUT_MAGIC     0x32425253  // "SRB2"
+#define SHARED_LAYOUT_VERSION   0x0305      // v3.5
+
+#define SHARED_CACHE_LINE       64
+#define SHARED_HEADER_SIZE      (3 * SHARED_CACHE_LINE)
+#define SHARED_HEADER_SIZE_PAGED 0x1000     // Header padded to one page
+#define PACKET_SLOT_SIZE        64          // exec_at_us + gen + PosePacket31 (42 bytes) + padding
+#define PACKET_SLOT_SIZE_MAX    128         // Room for a PosePacketN of 32 channels
+#define SHARED_SLOT_HEADER_SIZE 16          // exec_at_us, gen, reserved
+#define SHARED_RING_MIN_SLOTS   8
 
+// Scheduled slots further ahead than this are treated as a clock mismatch
+#define SHARED_EXEC_MAX_LEAD_US (60ULL * 1000000ULL)
+
+// brain_flags
 #define SHARED_FLAG_BRAIN_READY     (1U << 0)
+
+// muscle_flags
 #define SHARED_FLAG_MUSCLE_READY    (1U << 1)
 #define SHARED_FLAG_ESTOP           (1U << 2)
 #define SHARED_FLAG_OVERFLOW        (1U << 3)
+#define SHARED_FLAG_NOTIFY_SUPPRESS (1U << 4)   // Muscle is draining; Brain may skip the mailbox notify
+#define SHARED_FLAG_LAYOUT_REJECTED (1U << 5)   // Muscle does not understand the header
+#define SHARED_FLAG_ALIVE_WATCH     (1U << 6)   // Muscle watchdog samples brain_alive
 
+// ACK/NACK are reserved: the mailbox only runs Linux -> FreeRTOS, so
+// consumption shows in read_idx and round trips use shared_probe.h
 #define CMD_MOTION_PACKET       0x20
 #define CMD_MOTION_ACK          0x21
 #define CMD_MOTION_NACK         0x22
 #define CMD_MOTION_HEARTBEAT    0x23
 
-#pragma pack(push, 1)
+// Naturally aligned (no packing) so the indices can be accessed atomically
 typedef struct {
+    // Line 0: identity, written by Linux at map time
+    uint32_t magic;                 // SHARED_LAYOUT_MAGIC
+    uint16_t version;               // SHARED_LAYOUT_VERSION
+    uint16_t header_size;           // Offset of slot 0 from the region base
+    uint16_t slot_size;             // Multiple of 64, PACKET_SLOT_SIZE..PACKET_SLOT_SIZE_MAX
+    uint16_t reserved0;
+    uint32_t slot_count;            // Power of 2, chosen by Linux
+    volatile uint32_t brain_flags;  // Linux writes (SHARED_FLAG_BRAIN_READY)
+    uint32_t reserved1[11];
+
+    // Line 1: producer
     volatile uint32_t write_idx;    // Linux writes, FreeRTOS reads (monotonic counter)
+    volatile uint32_t brain_alive;  // Linux bumps every heartbeat period
+    uint32_t reserved2[14];
+
+    // Line 2: consumer
     volatile uint32_t read_idx;     // FreeRTOS writes, Linux reads (monotonic counter)
-    volatile uint32_t flags;        // Status flags (see SHARED_FLAG_*)
-    volatile uint32_t reserved;     // Alignment padding / future use
-    volatile uint8_t  packets[PACKET_RING_SIZE][PACKET_SLOT_SIZE];
-} SharedMotionBuffer;
+    volatile uint32_t muscle_flags; // FreeRTOS writes (all other SHARED_FLAG_*)
+    uint32_t reserved3[14];
+} SharedRingHeader;
+
+/**
+ * A slot as large as it can get. Only the ring's slot_size bytes of it
+ * are in the ring; the packet area runs to the end of those.
+ */
+#pragma pack(push, 1)
+typedef struct {
+    uint64_t     exec_at_us;        // timebase_shared_us() deadline, 0 = on arrival
+    volatile uint32_t gen;          // shared_ring_slot_gen() of the index written, 0 while overwriting
+    uint32_t     reserved;
+    union {
+        PosePacket31 pkt;           // Header shared by every packet kind; magic tells them apart
+        uint8_t      bytes[PACKET_SLOT_SIZE_MAX - SHARED_SLOT_HEADER_SIZE];
+    };
+} SharedRingSlot;
 #pragma pack(pop)
 
 #ifdef __cplusplus
-static_assert(sizeof(SharedMotionBuffer) == 528, "SharedMotionBuffer must be 528 bytes");
+static_assert(sizeof(SharedRingHeader) == SHARED_HEADER_SIZE, "SharedRingHeader must be 192 bytes");
+static_assert(offsetof(SharedRingHeader, write_idx) == SHARED_CACHE_LINE, "write_idx must start line 1");
+static_assert(offsetof(SharedRingHeader, read_idx) == 2 * SHARED_CACHE_LINE, "read_idx must start line 2");
+static_assert(sizeof(SharedRingSlot) == PACKET_SLOT_SIZE_MAX, "SharedRingSlot must be 128 bytes");
+static_assert(offsetof(SharedRingSlot, pkt) == SHARED_SLOT_HEADER_SIZE, "Packet must start at byte 16");
+static_assert(offsetof(SharedRingSlot, gen) % 4 == 0, "gen must be naturally aligned");
 #else
-_Static_assert(sizeof(SharedMotionBuffer) == 528, "SharedMotionBuffer must be 528 bytes");
+_Static_assert(sizeof(SharedRingHeader) == SHARED_HEADER_SIZE, "SharedRingHeader must be 192 bytes");
+_Static_assert(offsetof(SharedRingHeader, write_idx) == SHARED_CACHE_LINE, "write_idx must start line 1");
+_Static_assert(offsetof(SharedRingHeader, read_idx) == 2 * SHARED_CACHE_LINE, "read_idx must start line 2");
+_Static_assert(sizeof(SharedRingSlot) == PACKET_SLOT_SIZE_MAX, "SharedRingSlot must be 128 bytes");
+_Static_assert(offsetof(SharedRingSlot, pkt) == SHARED_SLOT_HEADER_SIZE, "Packet must start at byte 16");
+_Static_assert(offsetof(SharedRingSlot, gen) % 4 == 0, "gen must be naturally aligned");
 #endif
 
-static inline uint32_t shared_buffer_available(const volatile SharedMotionBuffer *buf) {
-    return buf->write_idx - buf->read_idx;
+#define SHARED_LOAD_ACQUIRE(p)      __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define SHARED_STORE_RELEASE(p, v)  __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define SHARED_FENCE_FULL()         __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+/**
+ * Smallest slot size (whole cache lines) that holds a packet for the
+ * given number of channels: PACKET_SLOT_SIZE up to
+ * POSEPACKETN_SLOT64_CHANNELS, PACKET_SLOT_SIZE_MAX beyond.
+ */
+static inline uint32_t shared_ring_slot_size_for(uint32_t channels) {
+    uint32_t pkt = POSEPACKETN_HEADER_SIZE + 2 * channels + 2;
+    if (pkt < sizeof(PosePacket31)) pkt = sizeof(PosePacket31);
+    uint32_t size = SHARED_SLOT_HEADER_SIZE + pkt;
+    return (size + SHARED_CACHE_LINE - 1) & ~(uint32_t)(SHARED_CACHE_LINE - 1);
 }
 
-static inline int shared_buffer_is_full(const volatile SharedMotionBuffer *buf) {
-    return (buf->write_idx - buf->read_idx) >= PACKET_RING_SIZE;
+/**
+ * Largest power-of-2 slot count that fits a region of the given size
+ * after the header (2048 64-byte slots for SHARED_RING_REGION_SIZE).
+ */
+static inline uint32_t shared_ring_slots_for_size(uint32_t region_size, uint32_t header_size,
+                                                  uint32_t slot_size) {
+    uint32_t max_slots = (region_size - header_size) / slot_size;
+    uint32_t slots = SHARED_RING_MIN_SLOTS;
+    while ((slots << 1) <= max_slots) {
+        slots <<= 1;
+    }
+    return slots;
+}
+
+/**
+ * Check a header before using it. Returns 0 if the layout is usable.
+ */
+static inline int shared_ring_header_check(const volatile SharedRingHeader *hdr,
+                                           uint32_t region_size) {
+    if (hdr->magic != SHARED_LAYOUT_MAGIC) return -1;
+    if (hdr->version != SHARED_LAYOUT_VERSION) return -2;
+    uint32_t size = hdr->slot_size;
+    if (hdr->header_size < SHARED_HEADER_SIZE || size < PACKET_SLOT_SIZE ||
+        size > PACKET_SLOT_SIZE_MAX || size % SHARED_CACHE_LINE != 0) return -3;
+
+    uint32_t n = hdr->slot_count;
+    if (n < SHARED_RING_MIN_SLOTS || (n & (n - 1)) != 0) return -4;
+    if ((uint64_t)hdr->header_size + (uint64_t)n * size > region_size) return -5;
+    return 0;
+}
+
+// Occupancy helpers read both indices; hot paths use cached copies instead
+static inline uint32_t shared_ring_available(const volatile SharedRingHeader *hdr) {
+    return hdr->write_idx - hdr->read_idx;
 }
 
-static inline int shared_buffer_is_empty(const volatile SharedMotionBuffer *buf) {
-    return buf->write_idx == buf->read_idx;
+static inline int shared_ring_is_full(const volatile SharedRingHeader *hdr) {
+    return (hdr->write_idx - hdr->read_idx) >= hdr->slot_count;
 }
 
-static inline uint32_t shared_buffer_slot_index(uint32_t idx) {
-    return idx % PACKET_RING_SIZE;  // Works because PACKET_RING_SIZE is power of 2
+static inline int shared_ring_is_empty(const volatile SharedRingHeader *hdr) {
+    return hdr->write_idx == hdr->read_idx;
+}
+
+static inline volatile SharedRingSlot *shared_ring_slot(volatile SharedRingHeader *hdr,
+                                                        uint32_t idx) {
+    volatile uint8_t *base = (volatile uint8_t *)hdr + hdr->header_size;
+    return (volatile SharedRingSlot *)(base + (idx & (hdr->slot_count - 1)) * hdr->slot_size);
+}
+
+// Generation stamp of the slot written at ring index idx (never 0 in practice)
+static inline uint32_t shared_ring_slot_gen(uint32_t idx) {
+    return idx + 1;
+}
+
+/**
+ * Oldest index a reader at read_idx can still find intact once the
+ * writer reached write_idx: read_idx itself unless the ring was lapped.
+ */
+static inline uint32_t shared_ring_oldest(const volatile SharedRingHeader *hdr,
+                                          uint32_t read_idx, uint32_t write_idx) {
+    uint32_t oldest = write_idx - hdr->slot_count;
+    return ((int32_t)(oldest - read_idx) > 0) ? oldest : read_idx;
 }
 
 #ifdef __cplusplus
@@ -0,0 +1,144 @@
+/**
+ * Shared Latency Probe for Spider Robot Inter-Core Round Trips
+ *
+ * Used by BOTH Linux (Brain) and FreeRTOS (Muscle).
+ *
+ * The mailbox only runs Brain -> Muscle, so the Muscle answers a ping
+ * through shared memory instead. The Brain writes a request (seq and its
+ * send time on the shared timebase) and sends CMD_PING with the seq; the
+ * Muscle's mailbox interrupt stamps the arrival, its motion task copies
+ * the request into the response with both of its own stamps and cleans
+ * the line. From one answer the Brain gets the mailbox one-way time
+ * (rx_us - tx_us), the Muscle's interrupt-to-task time (echo_us - rx_us)
+ * and their sum, request sent to answer written (echo_us - tx_us), with
+ * no need to poll for the answer.
+ *
+ * Layout: behind the trace area in the reserved tail
+ * ┌──────────────────────────────────────────┐
+ * │ Line 0 - request, Brain writes           │
+ * │ ├─ seq             - Written last        │
+ * │ └─ tx_us           - Shared timebase     │
+ * ├──────────────────────────────────────────┤
+ * │ Line 1 - response, Muscle writes         │
+ * │ ├─ seq             - 0 while writing     │
+ * │ ├─ tx_us           - Copied from request │
+ * │ ├─ rx_us           - Mailbox interrupt   │
+ * │ └─ echo_us         - Motion task answer  │
+ * └──────────────────────────────────────────┘
+ *
+ * One writer per line, so neither side's cache clean can clobber the
+ * other's stores. The Brain keeps at most one ping outstanding; a late
+ * answer to an abandoned seq is told apart by the seq it carries.
+ */
+
+#ifndef SHARED_PROBE_H
+#define SHARED_PROBE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "shared_motion_buffer.h"
+#include "shared_trace.h"
+#include "cache_ops.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SHARED_PROBE_SIZE           (2 * SHARED_CACHE_LINE)
+#define SHARED_PROBE_OFFSET         (SHARED_TRACE_OFFSET + SHARED_TRACE_AREA_SIZE)
+
+typedef struct {
+    volatile uint32_t seq;          // Ping seq, 0 = none
+    uint32_t reserved0;
+    uint64_t tx_us;                 // timebase_shared_us() before CMD_PING
+    uint64_t reserved1[6];
+} SharedProbeRequest;
+
+typedef struct {
+    volatile uint32_t seq;          // Seq answered, 0 while being written
+    uint32_t reserved0;
+    uint64_t tx_us;                 // Request's tx_us
+    uint64_t rx_us;                 // Mailbox interrupt took CMD_PING
+    uint64_t echo_us;               // Motion task wrote this answer
+    uint64_t reserved1[4];
+} SharedProbeResponse;
+
+typedef struct {
+    SharedProbeRequest request;
+    SharedProbeResponse response;
+} SharedProbe;
+
+#ifdef __cplusplus
+static_assert(sizeof(SharedProbe) == SHARED_PROBE_SIZE, "SharedProbe must be 2 lines");
+static_assert(offsetof(SharedProbe, response) == SHARED_CACHE_LINE, "response must start line 1");
+static_assert(SHARED_PROBE_OFFSET % SHARED_CACHE_LINE == 0, "SharedProbe must be line aligned");
+static_assert(SHARED_PROBE_OFFSET + SHARED_PROBE_SIZE <= SHARED_MEM_SIZE, "SharedProbe must fit the tail");
+#else
+_Static_assert(sizeof(SharedProbe) == SHARED_PROBE_SIZE, "SharedProbe must be 2 lines");
+_Static_assert(offsetof(SharedProbe, response) == SHARED_CACHE_LINE, "response must start line 1");
+_Static_assert(SHARED_PROBE_OFFSET % SHARED_CACHE_LINE == 0, "SharedProbe must be line aligned");
+_Static_assert(SHARED_PROBE_OFFSET + SHARED_PROBE_SIZE <= SHARED_MEM_SIZE, "SharedProbe must fit the tail");
+#endif
+
+static inline volatile SharedProbe *shared_probe_area(volatile void *region_base) {
+    return (volatile SharedProbe *)((volatile uint8_t *)region_base + SHARED_PROBE_OFFSET);
+}
+
+/**
+ * Brain: publish a request. Send CMD_PING with seq afterwards.
+ */
+static inline void shared_probe_request(volatile SharedProbe *p, uint32_t seq, uint64_t tx_us) {
+    SHARED_STORE_RELEASE(&p->request.seq, 0u);
+    p->request.tx_us = tx_us;
+    SHARED_STORE_RELEASE(&p->request.seq, seq);
+}
+
+/**
+ * Muscle: answer seq. Does nothing unless the request still carries it,
+ * so a ping overtaken by a newer one is not answered with the wrong tx_us.
+ * Returns 0 if answered.
+ */
+static inline int shared_probe_answer(volatile SharedProbe *p, uint32_t seq,
+                                      uint64_t rx_us, uint64_t echo_us) {
+    // The Brain's line may be in our cache from an earlier answer
+    cache_invalidate_range(&p->request, sizeof(p->request));
+    if (seq == 0 || SHARED_LOAD_ACQUIRE(&p->request.seq) != seq) {
+        return -1;
+    }
+    uint64_t tx_us = p->request.tx_us;
+
+    SHARED_STORE_RELEASE(&p->response.seq, 0u);
+    cache_clean_range(&p->response.seq, sizeof(p->response.seq));
+
+    p->response.tx_us = tx_us;
+    p->response.rx_us = rx_us;
+    p->response.echo_us = echo_us;
+    cache_clean_range(&p->response, sizeof(p->response));
+
+    SHARED_STORE_RELEASE(&p->response.seq, seq);
+    cache_clean_range(&p->response.seq, sizeof(p->response.seq));
+    return 0;
+}
+
+/**
+ * Brain: copy the latest answer. Returns its seq, or 0 if there is none
+ * or it changed while being copied.
+ */
+static inline uint32_t shared_probe_read(const volatile SharedProbe *p, uint64_t *tx_us,
+                                         uint64_t *rx_us, uint64_t *echo_us) {
+    uint32_t s1 = SHARED_LOAD_ACQUIRE(&p->response.seq);
+    if (s1 == 0) {
+        return 0;
+    }
+    *tx_us = p->response.tx_us;
+    *rx_us = p->response.rx_us;
+    *echo_us = p->response.echo_us;
+    SHARED_FENCE_FULL();
+    return (p->response.seq == s1) ? s1 : 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SHARED_PROBE_H
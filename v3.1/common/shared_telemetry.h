@@ -0,0 +1,220 @@
+/**
+ * Shared Telemetry Block for Spider Robot Inter-Core Diagnostics
+ *
+ * Used by BOTH Linux (Brain, reader) and FreeRTOS (Muscle, writer).
+ *
+ * The Muscle's output task republishes its counters, fault flags,
+ * watchdog state, tick timing and the interpolated servo outputs here
+ * every tick, so the Brain can read them without a mailbox round trip.
+ * Its load monitor (muscle_rtos/safety/load_monitor.h) adds per-stage
+ * cycle counts, task load and stack headroom, refreshed once a second,
+ * and a histogram of tick period jitter.
+ *
+ * Layout: follows the event log in the reserved tail (see shared_log.h)
+ * ┌────────────────────────────────────────┐
+ * │ Line 0 - seq, magic/version, size      │
+ * ├────────────────────────────────────────┤
+ * │ Lines 1-4 - SharedTelemetryData        │
+ * └────────────────────────────────────────┘
+ *
+ * Seqlock: the writer makes seq odd, writes the data, then makes it even
+ * again. A reader copies the data between two reads of seq and keeps the
+ * copy only if both were the same even value. Because the Muscle writes
+ * through its D-cache, each step is cleaned to DRAM before the next, so
+ * the Brain's uncached view can never see new data under an old seq.
+ */
+
+#ifndef SHARED_TELEMETRY_H
+#define SHARED_TELEMETRY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "shared_motion_buffer.h"
+#include "shared_log.h"
+#include "cache_ops.h"
+#include "limits.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SHARED_TELEMETRY_MAGIC      0x4D4C5453  // "STLM"
+#define SHARED_TELEMETRY_VERSION    0x0103      // v1.3
+#define SHARED_TELEMETRY_SIZE       (5 * SHARED_CACHE_LINE)
+#define SHARED_TELEMETRY_OFFSET     (SHARED_LOG_OFFSET + SHARED_LOG_AREA_SIZE)
+#define SHARED_TELEMETRY_READ_TRIES 4
+
+// Timed stages, in SharedTelemetryData.stage[]
+#define SHARED_LOAD_STAGE_TICK      0   // One output tick, interpolation to I2C
+#define SHARED_LOAD_STAGE_MOTION    1   // One motion task pass over the ring
+#define SHARED_LOAD_STAGE_VALIDATE  2   // One packet validation
+#define SHARED_LOAD_STAGE_I2C       3   // pca9685_update_us(): queueing the servo writes
+#define SHARED_LOAD_STAGE_WATCHDOG  4   // One watchdog check
+#define SHARED_LOAD_STAGE_COUNT     5
+
+// Tasks in task_load_permille[] and stack_free_words[]
+#define SHARED_LOAD_TASK_MOTION     0
+#define SHARED_LOAD_TASK_OUTPUT     1
+#define SHARED_LOAD_TASK_WATCHDOG   2
+#define SHARED_LOAD_TASK_COUNT      3
+
+static inline const char *shared_load_stage_name(int stage) {
+    switch (stage) {
+    case SHARED_LOAD_STAGE_TICK:        return "tick";
+    case SHARED_LOAD_STAGE_MOTION:      return "motion";
+    case SHARED_LOAD_STAGE_VALIDATE:    return "validate";
+    case SHARED_LOAD_STAGE_I2C:         return "i2c";
+    case SHARED_LOAD_STAGE_WATCHDOG:    return "watchdog";
+    default:                            return "unknown";
+    }
+}
+
+static inline const char *shared_load_task_name(int task) {
+    switch (task) {
+    case SHARED_LOAD_TASK_MOTION:       return "motion";
+    case SHARED_LOAD_TASK_OUTPUT:       return "servo_out";
+    case SHARED_LOAD_TASK_WATCHDOG:     return "watchdog";
+    default:                            return "unknown";
+    }
+}
+
+// Tick period jitter: |period - nominal| in bins bounded by these (us), the last one open
+#define SHARED_JITTER_BINS          8
+
+static inline uint32_t shared_jitter_edge_us(int bin) {
+    static const uint32_t edges[SHARED_JITTER_BINS - 1] = { 50, 100, 250, 500, 1000, 2000, 5000 };
+    return (bin >= 0 && bin < SHARED_JITTER_BINS - 1) ? edges[bin] : UINT32_MAX;
+}
+
+static inline int shared_jitter_bin(uint32_t deviation_us) {
+    int bin = 0;
+    while (bin < SHARED_JITTER_BINS - 1 && deviation_us >= shared_jitter_edge_us(bin)) {
+        bin++;
+    }
+    return bin;
+}
+
+// CPU cycles spent in one stage over the last window (all 0 when it never ran)
+typedef struct {
+    uint32_t min_cycles;
+    uint32_t avg_cycles;
+    uint32_t max_cycles;
+    uint32_t count;
+} SharedLoadStage;
+
+typedef struct {
+    uint64_t time_us;               // timebase_shared_us() of this update
+    uint32_t ticks;                 // Output ticks since boot
+    uint32_t rx_count;              // Packets applied
+    uint32_t drop_count;            // Packets rejected
+    uint32_t last_seq;              // Last applied packet seq
+    uint32_t fault_flags;           // fault_flags_get_all()
+    uint32_t unknown_cmds;          // Unknown mailbox commands
+    uint32_t tick_period_us;        // Measured spacing of the last two ticks
+    uint32_t tick_period_max_us;    // Largest spacing in the current window
+    uint32_t tick_work_us;          // Time spent in the last tick
+    uint32_t tick_work_max_us;      // Longest tick in the current window
+    uint8_t  watchdog_state;        // WatchdogState
+    uint8_t  estop;                 // E-STOP latched
+    uint8_t  interp_active;         // A segment is running
+    uint8_t  reserved0;
+    uint16_t servo_us[SERVO_COUNT_TOTAL];   // Interpolated outputs
+    uint32_t skip_count;            // Immediate packets superseded in a backlog (v1.1)
+    uint32_t overrun_count;         // Ring slots overwritten by the Brain before we read them (v1.2)
+    uint32_t cycles_per_us;         // Rate of the cycle counter below (v1.3)
+    SharedLoadStage stage[SHARED_LOAD_STAGE_COUNT];         // Over the last 1 s window
+    uint16_t task_load_permille[SHARED_LOAD_TASK_COUNT];    // Share of that window spent busy
+    uint16_t stack_free_words[SHARED_LOAD_TASK_COUNT];      // Least stack ever left, 0 = unknown
+    uint32_t jitter_hist[SHARED_JITTER_BINS];               // Ticks per period deviation, since boot
+} SharedTelemetryData;
+
+typedef struct {
+    // Line 0: seqlock and identity
+    volatile uint32_t seq;          // Odd while the Muscle is writing
+    uint32_t magic;                 // SHARED_TELEMETRY_MAGIC
+    uint16_t version;               // SHARED_TELEMETRY_VERSION
+    uint16_t size;                  // sizeof(SharedTelemetry)
+    uint32_t reserved0[13];
+
+    // Lines 1-4: data
+    SharedTelemetryData data;
+    uint8_t pad[4 * SHARED_CACHE_LINE - sizeof(SharedTelemetryData)];
+} SharedTelemetry;
+
+#ifdef __cplusplus
+static_assert(sizeof(SharedTelemetry) == SHARED_TELEMETRY_SIZE, "SharedTelemetry must be 5 lines");
+static_assert(offsetof(SharedTelemetry, data) == SHARED_CACHE_LINE, "data must start line 1");
+static_assert(SHARED_TELEMETRY_OFFSET % SHARED_CACHE_LINE == 0, "SharedTelemetry must be line aligned");
+static_assert(SHARED_TELEMETRY_OFFSET + SHARED_TELEMETRY_SIZE <= SHARED_MEM_SIZE, "SharedTelemetry must fit the tail");
+#else
+_Static_assert(sizeof(SharedTelemetry) == SHARED_TELEMETRY_SIZE, "SharedTelemetry must be 5 lines");
+_Static_assert(offsetof(SharedTelemetry, data) == SHARED_CACHE_LINE, "data must start line 1");
+_Static_assert(SHARED_TELEMETRY_OFFSET % SHARED_CACHE_LINE == 0, "SharedTelemetry must be line aligned");
+_Static_assert(SHARED_TELEMETRY_OFFSET + SHARED_TELEMETRY_SIZE <= SHARED_MEM_SIZE, "SharedTelemetry must fit the tail");
+#endif
+
+static inline volatile SharedTelemetry *shared_telemetry_area(volatile void *region_base) {
+    return (volatile SharedTelemetry *)((volatile uint8_t *)region_base + SHARED_TELEMETRY_OFFSET);
+}
+
+/**
+ * Writer: reset the block. Not safe against a concurrent update.
+ */
+static inline void shared_telemetry_init(volatile SharedTelemetry *t) {
+    t->magic = 0;
+    SHARED_FENCE_FULL();
+    t->seq = 0;
+    t->version = SHARED_TELEMETRY_VERSION;
+    t->size = SHARED_TELEMETRY_SIZE;
+    memset((void *)&t->data, 0, sizeof(t->data));
+    SHARED_STORE_RELEASE(&t->magic, (uint32_t)SHARED_TELEMETRY_MAGIC);
+    cache_clean_range(t, sizeof(*t));
+}
+
+/**
+ * Writer: publish one update. Single writer only.
+ */
+static inline void shared_telemetry_write(volatile SharedTelemetry *t, const SharedTelemetryData *d) {
+    uint32_t seq = t->seq;
+
+    SHARED_STORE_RELEASE(&t->seq, seq + 1);
+    cache_clean_range(&t->seq, sizeof(t->seq));
+
+    memcpy((void *)&t->data, d, sizeof(*d));
+    cache_clean_range(&t->data, sizeof(t->data));
+
+    SHARED_STORE_RELEASE(&t->seq, seq + 2);
+    cache_clean_range(&t->seq, sizeof(t->seq));
+}
+
+/**
+ * Reader: copy a consistent snapshot into out.
+ * Returns 0 on success, -1 if the block was never initialized, -2 if
+ * every try raced an update.
+ */
+static inline int shared_telemetry_read(const volatile SharedTelemetry *t, SharedTelemetryData *out) {
+    if (SHARED_LOAD_ACQUIRE(&t->magic) != SHARED_TELEMETRY_MAGIC ||
+        t->version != SHARED_TELEMETRY_VERSION || t->size != SHARED_TELEMETRY_SIZE) {
+        return -1;
+    }
+
+    for (int i = 0; i < SHARED_TELEMETRY_READ_TRIES; i++) {
+        uint32_t s1 = SHARED_LOAD_ACQUIRE(&t->seq);
+        if (s1 & 1) {
+            continue;
+        }
+        memcpy(out, (const void *)&t->data, sizeof(*out));
+        SHARED_FENCE_FULL();
+        if (t->seq == s1) {
+            return 0;
+        }
+    }
+    return -2;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SHARED_TELEMETRY_H
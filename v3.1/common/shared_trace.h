@@ -0,0 +1,218 @@
+/**
+ * Shared Trace Buffer for Spider Robot Latency Analysis
+ *
+ * Used by BOTH Linux (Brain) and FreeRTOS (Muscle).
+ *
+ * Named probe points along the command path record a timestamp on the
+ * shared timebase (timebase_micros(), the SoC counter both cores read)
+ * plus the packet seq they concern, so one dump shows where the time
+ * between a WebSocket command and the servo moving went. The Muscle's
+ * records live in shared memory behind the telemetry block; the Brain
+ * keeps its own in process memory using the same record format and
+ * merges both on `trace_dump`.
+ *
+ * Layout: behind SharedTelemetry in the reserved tail
+ * ┌──────────────────────────────────────────┐
+ * │ SharedTraceHeader (64 bytes)             │
+ * │ ├─ magic/version   - Written at boot     │
+ * │ ├─ record_count    - Power of 2          │
+ * │ └─ write_idx       - Monotonic counter   │
+ * ├──────────────────────────────────────────┤
+ * │ SharedTraceRecord[record_count] (32 each)│
+ * │ ├─ stamp           - Index + 1, last     │
+ * │ ├─ probe           - SHARED_TRACE_*      │
+ * │ ├─ time_us         - Shared timebase     │
+ * │ └─ arg, arg2       - seq, probe detail   │
+ * └──────────────────────────────────────────┘
+ *
+ * Single writer per buffer, overwriting the oldest record. Readers
+ * snapshot the newest records and drop any whose stamp changed while
+ * they copied it, as with shared_log.h.
+ */
+
+#ifndef SHARED_TRACE_H
+#define SHARED_TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "shared_motion_buffer.h"
+#include "shared_telemetry.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SHARED_TRACE_MAGIC          0x52545053  // "SPTR"
+#define SHARED_TRACE_VERSION        0x0100      // v1.0
+
+#define SHARED_TRACE_RECORD_SIZE    32
+#define SHARED_TRACE_RECORDS        512
+#define SHARED_TRACE_AREA_SIZE      (SHARED_CACHE_LINE + SHARED_TRACE_RECORDS * SHARED_TRACE_RECORD_SIZE)
+#define SHARED_TRACE_OFFSET         (SHARED_TELEMETRY_OFFSET + SHARED_TELEMETRY_SIZE)
+
+// Probe points, in path order. arg is the packet seq unless noted.
+// Brain (0x01-0x0F)
+#define SHARED_TRACE_CMD_DECODED        0x01    // WS/serial frame decoded (timestamp at decode)
+#define SHARED_TRACE_PACKET_BUILT       0x02    // PosePacket31 built, CRC done
+#define SHARED_TRACE_RING_WRITTEN       0x03    // Slot published; arg2 = write_idx
+#define SHARED_TRACE_MAILBOX_SENT       0x04    // Notify sent (arg = last seq of the batch)
+#define SHARED_TRACE_ESTOP_SENT         0x05    // CMD_ESTOP sent; arg = E-STOP count, no seq
+// Muscle (0x10-0x1F)
+#define SHARED_TRACE_MUSCLE_NOTIFIED    0x10    // Mailbox IRQ; arg = write_idx, no seq
+#define SHARED_TRACE_MUSCLE_DEQUEUED    0x11    // Slot read from the ring
+#define SHARED_TRACE_MUSCLE_VALIDATED   0x12    // Magic/version/CRC/seq checks passed
+#define SHARED_TRACE_OUTPUT_STARTED     0x13    // Output task started the keyframe
+#define SHARED_TRACE_I2C_DONE           0x14    // First PCA9685 update of the keyframe written
+#define SHARED_TRACE_ESTOP_RECEIVED     0x15    // E-STOP latched; arg = count, no seq
+#define SHARED_TRACE_ESTOP_STOPPED      0x16    // Servos driven neutral; arg = count, arg2 = us since latched
+
+#define SHARED_TRACE_MUSCLE_FIRST       0x10
+
+typedef struct {
+    uint32_t magic;                 // SHARED_TRACE_MAGIC, written last at init
+    uint16_t version;               // SHARED_TRACE_VERSION
+    uint16_t record_size;           // SHARED_TRACE_RECORD_SIZE
+    uint32_t record_count;          // Power of 2
+    volatile uint32_t write_idx;    // Records written since boot
+    uint32_t reserved[12];
+} SharedTraceHeader;
+
+typedef struct {
+    volatile uint32_t stamp;        // Record index + 1, 0 while being written
+    uint16_t probe;                 // SHARED_TRACE_*
+    uint16_t reserved0;
+    uint64_t time_us;               // timebase_micros()
+    uint32_t arg;
+    uint32_t arg2;
+    uint64_t reserved1;
+} SharedTraceRecord;
+
+#ifdef __cplusplus
+static_assert(sizeof(SharedTraceHeader) == SHARED_CACHE_LINE, "SharedTraceHeader must be one line");
+static_assert(sizeof(SharedTraceRecord) == SHARED_TRACE_RECORD_SIZE, "SharedTraceRecord must be 32 bytes");
+static_assert(SHARED_TRACE_OFFSET % SHARED_CACHE_LINE == 0, "Trace area must be line aligned");
+static_assert(SHARED_TRACE_OFFSET + SHARED_TRACE_AREA_SIZE <= SHARED_MEM_SIZE, "Trace area must fit the tail");
+#else
+_Static_assert(sizeof(SharedTraceHeader) == SHARED_CACHE_LINE, "SharedTraceHeader must be one line");
+_Static_assert(sizeof(SharedTraceRecord) == SHARED_TRACE_RECORD_SIZE, "SharedTraceRecord must be 32 bytes");
+_Static_assert(SHARED_TRACE_OFFSET % SHARED_CACHE_LINE == 0, "Trace area must be line aligned");
+_Static_assert(SHARED_TRACE_OFFSET + SHARED_TRACE_AREA_SIZE <= SHARED_MEM_SIZE, "Trace area must fit the tail");
+#endif
+
+static inline volatile SharedTraceHeader *shared_trace_area(volatile void *region_base) {
+    return (volatile SharedTraceHeader *)((volatile uint8_t *)region_base + SHARED_TRACE_OFFSET);
+}
+
+static inline volatile SharedTraceRecord *shared_trace_record(volatile SharedTraceHeader *tr,
+                                                              uint32_t idx) {
+    volatile uint8_t *base = (volatile uint8_t *)tr + SHARED_CACHE_LINE;
+    return (volatile SharedTraceRecord *)(base + (idx & (tr->record_count - 1)) * SHARED_TRACE_RECORD_SIZE);
+}
+
+/**
+ * Writer: reset a buffer of record_count records (power of 2) that
+ * follows the header in memory.
+ */
+static inline void shared_trace_init(volatile SharedTraceHeader *tr, uint32_t record_count) {
+    tr->magic = 0;
+    SHARED_FENCE_FULL();
+    tr->version = SHARED_TRACE_VERSION;
+    tr->record_size = SHARED_TRACE_RECORD_SIZE;
+    tr->record_count = record_count;
+    tr->write_idx = 0;
+    for (uint32_t i = 0; i < record_count; i++) {
+        shared_trace_record(tr, i)->stamp = 0;
+    }
+    SHARED_STORE_RELEASE(&tr->magic, (uint32_t)SHARED_TRACE_MAGIC);
+}
+
+/**
+ * Writer: append one record and return it (so the caller can clean its
+ * line). Appends must be serialized by the caller.
+ */
+static inline volatile SharedTraceRecord *shared_trace_append(volatile SharedTraceHeader *tr,
+                                                              uint16_t probe, uint64_t time_us,
+                                                              uint32_t arg, uint32_t arg2) {
+    uint32_t idx = tr->write_idx;
+    volatile SharedTraceRecord *rec = shared_trace_record(tr, idx);
+
+    SHARED_STORE_RELEASE(&rec->stamp, 0u);
+    rec->probe = probe;
+    rec->time_us = time_us;
+    rec->arg = arg;
+    rec->arg2 = arg2;
+    SHARED_STORE_RELEASE(&rec->stamp, idx + 1);
+    SHARED_STORE_RELEASE(&tr->write_idx, idx + 1);
+    return rec;
+}
+
+static inline int shared_trace_valid(const volatile SharedTraceHeader *tr, uint32_t max_records) {
+    uint32_t n = tr->record_count;
+    return SHARED_LOAD_ACQUIRE(&tr->magic) == SHARED_TRACE_MAGIC &&
+           tr->version == SHARED_TRACE_VERSION &&
+           tr->record_size == SHARED_TRACE_RECORD_SIZE &&
+           n >= 1 && n <= max_records && (n & (n - 1)) == 0;
+}
+
+/**
+ * Reader: copy up to max of the newest records into out, oldest first.
+ * Records rewritten during the copy are skipped. Returns the count.
+ */
+static inline size_t shared_trace_snapshot(volatile SharedTraceHeader *tr,
+                                           SharedTraceRecord *out, size_t max) {
+    uint32_t w = SHARED_LOAD_ACQUIRE(&tr->write_idx);
+    uint32_t n = tr->record_count;
+    uint32_t avail = (w < n) ? w : n;
+    if (avail > max) avail = (uint32_t)max;
+
+    size_t count = 0;
+    for (uint32_t c = w - avail; c != w; c++) {
+        volatile SharedTraceRecord *rec = shared_trace_record(tr, c);
+        uint32_t stamp = SHARED_LOAD_ACQUIRE(&rec->stamp);
+        if (stamp != c + 1) continue;
+
+        SharedTraceRecord *o = &out[count];
+        o->probe = rec->probe;
+        o->reserved0 = 0;
+        o->time_us = rec->time_us;
+        o->arg = rec->arg;
+        o->arg2 = rec->arg2;
+        o->reserved1 = 0;
+        SHARED_FENCE_FULL();
+        if (rec->stamp == stamp) {
+            o->stamp = stamp;
+            count++;
+        }
+    }
+    return count;
+}
+
+static inline const char *shared_trace_probe_name(uint16_t probe) {
+    switch (probe) {
+    case SHARED_TRACE_CMD_DECODED:      return "cmd_decoded";
+    case SHARED_TRACE_PACKET_BUILT:     return "packet_built";
+    case SHARED_TRACE_RING_WRITTEN:     return "ring_written";
+    case SHARED_TRACE_MAILBOX_SENT:     return "mailbox_sent";
+    case SHARED_TRACE_ESTOP_SENT:       return "estop_sent";
+    case SHARED_TRACE_MUSCLE_NOTIFIED:  return "muscle_notified";
+    case SHARED_TRACE_MUSCLE_DEQUEUED:  return "muscle_dequeued";
+    case SHARED_TRACE_MUSCLE_VALIDATED: return "muscle_validated";
+    case SHARED_TRACE_OUTPUT_STARTED:   return "output_started";
+    case SHARED_TRACE_I2C_DONE:         return "i2c_done";
+    case SHARED_TRACE_ESTOP_RECEIVED:   return "estop_received";
+    case SHARED_TRACE_ESTOP_STOPPED:    return "estop_stopped";
+    default:                            return "unknown";
+    }
+}
+
+// Probes whose arg is a packet seq
+static inline int shared_trace_probe_has_seq(uint16_t probe) {
+    return probe != SHARED_TRACE_MUSCLE_NOTIFIED && probe != SHARED_TRACE_ESTOP_SENT &&
+           probe != SHARED_TRACE_ESTOP_RECEIVED && probe != SHARED_TRACE_ESTOP_STOPPED;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SHARED_TRACE_H
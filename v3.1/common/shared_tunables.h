@@ -0,0 +1,258 @@
+/**
+ * Shared Runtime Tunables for Spider Robot Live Tuning
+ *
+ * Used by BOTH Linux (Brain) and FreeRTOS (Muscle).
+ *
+ * Timing the Muscle otherwise takes from limits.h at build time: the
+ * output rate, interpolation substeps and the heartbeat timeout. The
+ * Brain publishes a set (from its tunables file or set_tunable) by
+ * bumping a generation; the output task looks at the generation once
+ * per tick and, when it moved, applies the whole set at that tick
+ * boundary and reports what it is now running with. Values outside the
+ * TUNABLE_* ranges are clamped, not refused, and the clamp is reported.
+ *
+ * Layout: behind the ack area in the reserved tail
+ * ┌──────────────────────────────────────────┐
+ * │ Line 0 - request, Brain writes           │
+ * │ ├─ magic/version   - Written once        │
+ * │ ├─ generation      - Odd while writing   │
+ * │ └─ SharedTunablesData                    │
+ * ├──────────────────────────────────────────┤
+ * │ Line 1 - in effect, Muscle writes        │
+ * │ ├─ seq             - Odd while writing   │
+ * │ ├─ generation      - Last one applied    │
+ * │ ├─ applies         - Sets taken          │
+ * │ ├─ clamped         - TUNABLE_BIT_* mask  │
+ * │ └─ SharedTunablesData                    │
+ * └──────────────────────────────────────────┘
+ *
+ * One writer per line. A generation of 0 means the Brain has published
+ * nothing, and the Muscle keeps the limits.h defaults.
+ */
+
+#ifndef SHARED_TUNABLES_H
+#define SHARED_TUNABLES_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "shared_motion_buffer.h"
+#include "shared_ack.h"
+#include "cache_ops.h"
+#include "limits.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SHARED_TUNABLES_MAGIC       0x4E555453  // "STUN"
+#define SHARED_TUNABLES_VERSION     0x0100      // v1.0
+
+#define SHARED_TUNABLES_SIZE        (2 * SHARED_CACHE_LINE)
+#define SHARED_TUNABLES_OFFSET      (SHARED_ACK_OFFSET + SHARED_ACK_AREA_SIZE)
+
+// Accepted ranges. The output period is whole milliseconds, 1000 / hz;
+// past 100 Hz the PCA9685's own PWM frame (50 Hz) hides any gain. The
+// heartbeat timeout must cover two of the Brain's 100 ms heartbeats.
+#define TUNABLE_OUTPUT_HZ_MIN       10
+#define TUNABLE_OUTPUT_HZ_MAX       100
+#define TUNABLE_HEARTBEAT_MS_MIN    200
+#define TUNABLE_HEARTBEAT_MS_MAX    2000
+
+// Default substeps per output tick (5 ms segment starts at 50 Hz)
+#define TUNABLE_INTERP_SUBSTEPS_DEFAULT  4
+
+#define TUNABLE_BIT_OUTPUT_HZ       (1u << 0)
+#define TUNABLE_BIT_INTERP_SUBSTEPS (1u << 1)
+#define TUNABLE_BIT_HEARTBEAT_MS    (1u << 2)
+
+typedef struct {
+    uint32_t output_hz;             // Output task tick rate
+    uint32_t interp_substeps;       // Segment-start resolution per tick
+    uint32_t heartbeat_timeout_ms;  // Watchdog HOLD after this long without the Brain
+} SharedTunablesData;
+
+typedef struct {
+    volatile uint32_t magic;        // SHARED_TUNABLES_MAGIC once the Brain has written
+    uint16_t version;               // SHARED_TUNABLES_VERSION
+    uint16_t reserved0;
+    volatile uint32_t generation;   // Even and > 0 when a set is published
+    SharedTunablesData data;
+    uint32_t reserved1[10];
+} SharedTunablesRequest;
+
+typedef struct {
+    volatile uint32_t seq;          // Odd while the Muscle rewrites the line
+    uint32_t generation;            // Request generation in effect, 0 = defaults
+    uint32_t applies;               // Sets taken since boot
+    uint32_t clamped;               // TUNABLE_BIT_* clamped in the last set
+    SharedTunablesData data;        // What the Muscle is running with
+    uint32_t reserved1[9];
+} SharedTunablesApplied;
+
+typedef struct {
+    SharedTunablesRequest request;
+    SharedTunablesApplied applied;
+} SharedTunables;
+
+#ifdef __cplusplus
+static_assert(sizeof(SharedTunables) == SHARED_TUNABLES_SIZE, "SharedTunables must be 2 lines");
+static_assert(offsetof(SharedTunables, applied) == SHARED_CACHE_LINE, "applied must start line 1");
+static_assert(SHARED_TUNABLES_OFFSET % SHARED_CACHE_LINE == 0, "SharedTunables must be line aligned");
+static_assert(SHARED_TUNABLES_OFFSET + SHARED_TUNABLES_SIZE <= SHARED_MEM_SIZE, "SharedTunables must fit the tail");
+#else
+_Static_assert(sizeof(SharedTunables) == SHARED_TUNABLES_SIZE, "SharedTunables must be 2 lines");
+_Static_assert(offsetof(SharedTunables, applied) == SHARED_CACHE_LINE, "applied must start line 1");
+_Static_assert(SHARED_TUNABLES_OFFSET % SHARED_CACHE_LINE == 0, "SharedTunables must be line aligned");
+_Static_assert(SHARED_TUNABLES_OFFSET + SHARED_TUNABLES_SIZE <= SHARED_MEM_SIZE, "SharedTunables must fit the tail");
+#endif
+
+static inline volatile SharedTunables *shared_tunables_area(volatile void *region_base) {
+    return (volatile SharedTunables *)((volatile uint8_t *)region_base + SHARED_TUNABLES_OFFSET);
+}
+
+static inline void shared_tunables_defaults(SharedTunablesData *d) {
+    d->output_hz = MOTION_UPDATE_HZ;
+    d->interp_substeps = TUNABLE_INTERP_SUBSTEPS_DEFAULT;
+    d->heartbeat_timeout_ms = HEARTBEAT_TIMEOUT_MS;
+}
+
+static inline uint32_t shared_tunables_clamp_one(uint32_t v, uint32_t lo, uint32_t hi,
+                                                 uint32_t bit, uint32_t *clamped) {
+    if (v < lo || v > hi) {
+        *clamped |= bit;
+        return (v < lo) ? lo : hi;
+    }
+    return v;
+}
+
+/**
+ * Clamp d into the accepted ranges. Returns the TUNABLE_BIT_* of the
+ * fields that had to change.
+ */
+static inline uint32_t shared_tunables_clamp(SharedTunablesData *d) {
+    uint32_t clamped = 0;
+    d->output_hz = shared_tunables_clamp_one(d->output_hz, TUNABLE_OUTPUT_HZ_MIN,
+                                             TUNABLE_OUTPUT_HZ_MAX, TUNABLE_BIT_OUTPUT_HZ, &clamped);
+    d->interp_substeps = shared_tunables_clamp_one(d->interp_substeps, INTERP_SUBSTEPS_MIN,
+                                                   INTERP_SUBSTEPS_MAX, TUNABLE_BIT_INTERP_SUBSTEPS,
+                                                   &clamped);
+    d->heartbeat_timeout_ms = shared_tunables_clamp_one(d->heartbeat_timeout_ms,
+                                                        TUNABLE_HEARTBEAT_MS_MIN,
+                                                        TUNABLE_HEARTBEAT_MS_MAX,
+                                                        TUNABLE_BIT_HEARTBEAT_MS, &clamped);
+    return clamped;
+}
+
+/**
+ * Brain: publish a set. Generations continue from whatever the area
+ * holds, so a restarted Brain's first set still differs from the one
+ * the Muscle applied last. Returns the new generation.
+ */
+static inline uint32_t shared_tunables_publish(volatile SharedTunables *t,
+                                               const SharedTunablesData *d) {
+    uint32_t gen = 0;
+    if (SHARED_LOAD_ACQUIRE(&t->request.magic) == SHARED_TUNABLES_MAGIC) {
+        gen = t->request.generation;
+    }
+    gen = (gen + 2) & ~1u;
+    if (gen == 0) {
+        gen = 2;
+    }
+
+    SHARED_STORE_RELEASE(&t->request.generation, gen - 1);
+    t->request.version = SHARED_TUNABLES_VERSION;
+    t->request.reserved0 = 0;
+    t->request.data.output_hz = d->output_hz;
+    t->request.data.interp_substeps = d->interp_substeps;
+    t->request.data.heartbeat_timeout_ms = d->heartbeat_timeout_ms;
+    SHARED_STORE_RELEASE(&t->request.magic, (uint32_t)SHARED_TUNABLES_MAGIC);
+    SHARED_STORE_RELEASE(&t->request.generation, gen);
+    return gen;
+}
+
+/**
+ * Muscle: fill the applied line with the boot values d, generation 0.
+ * Call before the output task starts.
+ */
+static inline void shared_tunables_init(volatile SharedTunables *t, const SharedTunablesData *d) {
+    t->applied.seq = 0;
+    t->applied.generation = 0;
+    t->applied.applies = 0;
+    t->applied.clamped = 0;
+    t->applied.data.output_hz = d->output_hz;
+    t->applied.data.interp_substeps = d->interp_substeps;
+    t->applied.data.heartbeat_timeout_ms = d->heartbeat_timeout_ms;
+    cache_clean_range(&t->applied, sizeof(t->applied));
+}
+
+/**
+ * Muscle: if the Brain has published a generation other than seen,
+ * copy it into out, set *seen to it and return 1. Returns 0 when there
+ * is nothing new or the set is being rewritten (try again next tick).
+ */
+static inline int shared_tunables_poll(volatile SharedTunables *t, uint32_t *seen,
+                                       SharedTunablesData *out) {
+    cache_invalidate_range(&t->request, sizeof(t->request));
+    uint32_t g1 = SHARED_LOAD_ACQUIRE(&t->request.generation);
+    if (g1 == *seen || g1 == 0 || (g1 & 1) ||
+        SHARED_LOAD_ACQUIRE(&t->request.magic) != SHARED_TUNABLES_MAGIC ||
+        t->request.version != SHARED_TUNABLES_VERSION) {
+        return 0;
+    }
+    out->output_hz = t->request.data.output_hz;
+    out->interp_substeps = t->request.data.interp_substeps;
+    out->heartbeat_timeout_ms = t->request.data.heartbeat_timeout_ms;
+    SHARED_FENCE_FULL();
+    if (t->request.generation != g1) {
+        return 0;
+    }
+    *seen = g1;
+    return 1;
+}
+
+/**
+ * Muscle: report the set now in effect for generation gen.
+ */
+static inline void shared_tunables_report(volatile SharedTunables *t, uint32_t gen,
+                                          const SharedTunablesData *d, uint32_t clamped) {
+    uint32_t seq = t->applied.seq;
+    SHARED_STORE_RELEASE(&t->applied.seq, seq + 1);
+    cache_clean_range(&t->applied.seq, sizeof(t->applied.seq));
+
+    t->applied.generation = gen;
+    t->applied.applies = t->applied.applies + 1;
+    t->applied.clamped = clamped;
+    t->applied.data.output_hz = d->output_hz;
+    t->applied.data.interp_substeps = d->interp_substeps;
+    t->applied.data.heartbeat_timeout_ms = d->heartbeat_timeout_ms;
+    cache_clean_range(&t->applied, sizeof(t->applied));
+
+    SHARED_STORE_RELEASE(&t->applied.seq, seq + 2);
+    cache_clean_range(&t->applied.seq, sizeof(t->applied.seq));
+}
+
+/**
+ * Brain: copy the applied line. Returns 0 if it was being rewritten.
+ */
+static inline int shared_tunables_read_applied(const volatile SharedTunables *t,
+                                               SharedTunablesApplied *out) {
+    uint32_t s1 = SHARED_LOAD_ACQUIRE(&t->applied.seq);
+    if (s1 & 1) {
+        return 0;
+    }
+    out->generation = t->applied.generation;
+    out->applies = t->applied.applies;
+    out->clamped = t->applied.clamped;
+    out->data.output_hz = t->applied.data.output_hz;
+    out->data.interp_substeps = t->applied.data.interp_substeps;
+    out->data.heartbeat_timeout_ms = t->applied.data.heartbeat_timeout_ms;
+    SHARED_FENCE_FULL();
+    out->seq = s1;
+    return t->applied.seq == s1;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SHARED_TUNABLES_H
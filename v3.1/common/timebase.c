@@ -0,0 +1,38 @@
+/**
+ * Timebase
+ *
+ * The clock readers are inline in timebase.h and the same on every
+ * platform. Only sleeping differs: MILKV_DUO_SDK builds (the FreeRTOS
+ * Muscle) yield to the scheduler, everything else is Linux or a host
+ * build and uses nanosleep.
+ */
+
+#if !defined(MILKV_DUO_SDK) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "timebase.h"
+
+#if defined(MILKV_DUO_SDK)
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+void timebase_delay_ms(uint32_t ms) {
+    vTaskDelay(pdMS_TO_TICKS(ms));
+}
+
+#else
+
+#include <errno.h>
+#include <time.h>
+
+void timebase_delay_ms(uint32_t ms) {
+    struct timespec req;
+    req.tv_sec = ms / 1000;
+    req.tv_nsec = (long)(ms % 1000) * 1000000L;
+    while (nanosleep(&req, &req) != 0 && errno == EINTR) {
+    }
+}
+
+#endif
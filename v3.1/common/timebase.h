@@ -3,22 +3,57 @@
 
 #include <stdint.h>
 
+#if !defined(__riscv)
+#include <time.h>
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 /**
- * Platform-agnostic time interface.
- * Implementations differ for Linux (clock_gettime) and FreeRTOS (xTaskGetTickCount).
+ * Shared timebase.
+ *
+ * Both C906 cores read the same SoC system counter through the RISC-V
+ * `time` CSR: Linux lets user space execute rdtime, and the FreeRTOS
+ * core runs in machine mode. A timestamp or deadline taken on either
+ * side therefore means the same instant on the other, with no offset
+ * to estimate. Host builds (tests, simulator, tools) fall back to
+ * CLOCK_MONOTONIC, which the in-process simulated Muscle shares.
+ *
+ * Every reader below is inline and touches no memory beyond the
+ * counter, so it is safe from any thread, ISR or RT loop.
  */
+#define TIMEBASE_SHARED_HZ  25000000ULL     // CV180x system counter
+
+static inline uint64_t timebase_shared_us(void) {
+#if defined(__riscv)
+    uint64_t ticks;
+    __asm volatile ("rdtime %0" : "=r"(ticks));
+    return ticks / (TIMEBASE_SHARED_HZ / 1000000ULL);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+#endif
+}
 
-// Get current time in milliseconds (monotonic)
-uint32_t timebase_millis(void);
+// Current time in microseconds, comparable across cores
+static inline uint64_t timebase_micros(void) {
+    return timebase_shared_us();
+}
+
+// Current time in milliseconds, on the same clock; wraps after 49 days
+static inline uint32_t timebase_millis(void) {
+    return (uint32_t)(timebase_shared_us() / 1000ULL);
+}
 
-// Get current time in microseconds (monotonic, if available)
-uint64_t timebase_micros(void);
+// Milliseconds without the wrap, for uptimes and long-lived deadlines
+static inline uint64_t timebase_millis64(void) {
+    return timebase_shared_us() / 1000ULL;
+}
 
-// Sleep for specified milliseconds (non-blocking on RTOS, blocking on Linux)
+// Sleep for specified milliseconds (vTaskDelay on FreeRTOS, nanosleep on Linux; timebase.c)
 void timebase_delay_ms(uint32_t ms);
 
 #ifdef __cplusplus
@@ -0,0 +1,151 @@
+#ifndef UDP_TELEOP_BINARY_H
+#define UDP_TELEOP_BINARY_H
+
+#include <stdint.h>
+#include "limits.h"
+#include "ws_pose_binary.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * UDP teleoperation protocol (client ↔ Brain, --udp-port)
+ *
+ * For joysticks and gamepads streaming at a fixed rate: each datagram
+ * carries the whole current command, so a lost one is simply replaced by
+ * the next and nothing is ever retransmitted. The Brain drains every
+ * datagram waiting on a wakeup and acts only on the newest of each kind
+ * (latest wins); older ones are counted and dropped. All fields are
+ * little-endian.
+ *
+ * Datagram: UdpTeleopHeader, a fixed payload for the type, then an
+ * UDP_TELEOP_TAG_LEN byte tag: the first bytes of HMAC-SHA1 over
+ * everything before it, keyed with the shared secret (--udp-key).
+ * Datagrams with a wrong length or tag are dropped without a reply.
+ *
+ * Header (16 bytes):
+ * Offset  Size  Field
+ * ------  ----  -----
+ *   0      1    magic (UDP_TELEOP_MAGIC)
+ *   1      1    msg (UDP_TELEOP_MSG_*)
+ *   2      1    version (UDP_TELEOP_VERSION)
+ *   3      1    reserved (0)
+ *   4      4    session (random and nonzero per client start)
+ *   8      4    seq (increments per datagram within a session)
+ *  12      4    sent_ms (sender's millisecond clock, any epoch)
+ *
+ * Within a session only a seq above the last accepted one is taken:
+ * duplicates, replays and reordered datagrams are dropped. A different
+ * session takes over once the current one has been silent for
+ * UDP_TELEOP_DEADMAN_MS, and the Brain refuses the last few sessions it
+ * replaced. A datagram that spent more than
+ * UDP_TELEOP_MAX_AGE_MS longer in flight than the quickest one of its
+ * session (sent_ms against arrival, so the clocks need not agree) is
+ * stale and dropped too.
+ *
+ * UDP_TELEOP_MSG_WALK payload (12 bytes), as the walk command:
+ *   0      2    dir (int16, -1000..1000 = -1..1)
+ *   2      2    turn (int16, -1000..1000, > 0 clockwise)
+ *   4      2    speed (uint16, 1000 = 1.0)
+ *   6      2    stride (uint16, 1000 = 1.0)
+ *   8      1    gait (UDP_TELEOP_GAIT_*)
+ *   9      3    reserved (0)
+ * A walk keeps going only while walks keep arriving: after
+ * UDP_TELEOP_DEADMAN_MS without one the Brain stops it.
+ *
+ * UDP_TELEOP_MSG_POSE payload (32 bytes): one WsPoseEntry, queued as an
+ * immediate pose (see ws_pose_binary.h). Run with --pose-policy
+ * overwrite so a backed-up ring also keeps only the newest.
+ *
+ * UDP_TELEOP_MSG_STATUS (Brain → client, 24 byte payload), sent back to
+ * the sender after each wakeup that accepted something, with the header
+ * echoing the session, seq and sent_ms of the datagram it answers (for
+ * round-trip time) and its own tag:
+ *   0      1    state (UDP_TELEOP_STATE_* bits)
+ *   1      1    result (UDP_TELEOP_RESULT_* for the answered datagram)
+ *   2      2    dropped (stale and out-of-order datagrams, wrapping)
+ *   4      4    pose_seq (motion seq of the last pose queued, 0 if none)
+ *   8      4    x_mm (int32, odometry)
+ *  12      4    y_mm (int32)
+ *  16      2    heading_cdeg (int16, centidegrees counter-clockwise)
+ *  18      2    nearest_mm (int16, closest obstacle ahead, -1 unknown)
+ *  20      4    reserved (0)
+ */
+
+#define UDP_TELEOP_MAGIC          0x54
+#define UDP_TELEOP_VERSION        1
+
+#define UDP_TELEOP_MSG_WALK       0x41
+#define UDP_TELEOP_MSG_POSE       0x42
+#define UDP_TELEOP_MSG_STATUS     0xC1
+
+#define UDP_TELEOP_GAIT_TRIPOD    0
+#define UDP_TELEOP_GAIT_WAVE      1
+#define UDP_TELEOP_GAIT_RIPPLE    2
+
+#define UDP_TELEOP_STATE_ESTOP    (1 << 0)
+#define UDP_TELEOP_STATE_WALKING  (1 << 1)
+#define UDP_TELEOP_STATE_HALTED   (1 << 2)   // Avoidance is holding the walk back
+
+#define UDP_TELEOP_RESULT_OK          0
+#define UDP_TELEOP_RESULT_ESTOP       1
+#define UDP_TELEOP_RESULT_QUEUE_FULL  2
+#define UDP_TELEOP_RESULT_BAD_GAIT    3
+
+#define UDP_TELEOP_TAG_LEN        8
+#define UDP_TELEOP_KEY_MAX        64         // One SHA-1 block
+#define UDP_TELEOP_MAX_AGE_MS     150
+#define UDP_TELEOP_DEADMAN_MS     500
+
+#pragma pack(push, 1)
+typedef struct {
+    uint8_t  magic;
+    uint8_t  msg;
+    uint8_t  version;
+    uint8_t  reserved;
+    uint32_t session;
+    uint32_t seq;
+    uint32_t sent_ms;
+} UdpTeleopHeader;
+
+typedef struct {
+    int16_t  dir;
+    int16_t  turn;
+    uint16_t speed;
+    uint16_t stride;
+    uint8_t  gait;
+    uint8_t  reserved[3];
+} UdpTeleopWalk;
+
+typedef struct {
+    uint8_t  state;
+    uint8_t  result;
+    uint16_t dropped;
+    uint32_t pose_seq;
+    int32_t  x_mm;
+    int32_t  y_mm;
+    int16_t  heading_cdeg;
+    int16_t  nearest_mm;
+    uint32_t reserved;
+} UdpTeleopStatus;
+#pragma pack(pop)
+
+#define UDP_TELEOP_DATAGRAM_MAX   (sizeof(UdpTeleopHeader) + sizeof(WsPoseEntry) + UDP_TELEOP_TAG_LEN)
+
+// Compile-time size check
+#ifdef __cplusplus
+static_assert(sizeof(UdpTeleopHeader) == 16, "UdpTeleopHeader must be 16 bytes");
+static_assert(sizeof(UdpTeleopWalk) == 12, "UdpTeleopWalk must be 12 bytes");
+static_assert(sizeof(UdpTeleopStatus) == 24, "UdpTeleopStatus must be 24 bytes");
+#else
+_Static_assert(sizeof(UdpTeleopHeader) == 16, "UdpTeleopHeader must be 16 bytes");
+_Static_assert(sizeof(UdpTeleopWalk) == 12, "UdpTeleopWalk must be 12 bytes");
+_Static_assert(sizeof(UdpTeleopStatus) == 24, "UdpTeleopStatus must be 24 bytes");
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // UDP_TELEOP_BINARY_H
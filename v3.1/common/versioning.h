@@ -6,5 +6,7 @@
 #define SPIDER_VERSION_STRING "3.1"
 
 #define SPIDER_MAGIC          0xB31A
+#define SPIDER_DELTA_MAGIC    0xB31D      // PosePacketDelta
+#define SPIDER_WIDE_MAGIC     0xB31E      // PosePacketN
 
 #endif // SPIDER_VERSIONING_H
@@ -0,0 +1,97 @@
+#ifndef WS_POSE_BINARY_H
+#define WS_POSE_BINARY_H
+
+#include <stdint.h>
+#include "limits.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Binary WebSocket pose protocol (client → Brain, opcode 0x02)
+ *
+ * Streams PosePacket31-compatible poses without JSON. All fields are
+ * little-endian. A frame is one WsPoseHeader followed by `count`
+ * WsPoseEntry records (1..WS_POSE_MAX_BATCH).
+ *
+ * Header (4 bytes):
+ * Offset  Size  Field
+ * ------  ----  -----
+ *   0      1    msg (WS_POSE_MSG_POSE)
+ *   1      1    count
+ *   2      1    req_flags (WS_POSE_REQ_ACK = reply with WsPoseAck,
+ *                          WS_POSE_REQ_SCHEDULE = timed trajectory, see below)
+ *   3      1    reserved (0)
+ *
+ * Entry (32 bytes):
+ *   0      4    t_ms (interpolation time to target)
+ *   4      2    flags (FLAG_HOLD / FLAG_INTERP_Q16 / FLAG_SCAN_ENABLE;
+ *                      FLAG_ESTOP is ignored, CLAMP is always set)
+ *   6     26    servo_us[13]
+ *
+ * With WS_POSE_REQ_SCHEDULE the entries are consecutive trajectory
+ * segments: the first starts shortly after arrival (or when the previous
+ * scheduled batch ends), each following one t_ms after its predecessor.
+ * The Muscle buffers them and applies each at its deadline. Without it,
+ * entries are applied as soon as they reach the Muscle.
+ *
+ * Ack (Brain → client, opcode 0x02, 8 bytes):
+ *   0      1    msg (WS_POSE_MSG_ACK)
+ *   1      1    accepted (entries queued)
+ *   2      1    status (WS_POSE_STATUS_*)
+ *   3      1    reserved
+ *   4      4    seq of the last accepted entry (0 if none)
+ */
+
+#define WS_POSE_MSG_POSE          0x31
+#define WS_POSE_MSG_ACK           0xB1
+
+#define WS_POSE_REQ_ACK           (1 << 0)
+#define WS_POSE_REQ_SCHEDULE      (1 << 1)
+
+#define WS_POSE_STATUS_OK         0
+#define WS_POSE_STATUS_MALFORMED  1
+#define WS_POSE_STATUS_QUEUE_FULL 2
+
+#define WS_POSE_MAX_BATCH         64
+
+#pragma pack(push, 1)
+typedef struct {
+    uint8_t msg;
+    uint8_t count;
+    uint8_t req_flags;
+    uint8_t reserved;
+} WsPoseHeader;
+
+typedef struct {
+    uint32_t t_ms;
+    uint16_t flags;
+    uint16_t servo_us[SERVO_COUNT_TOTAL];
+} WsPoseEntry;
+
+typedef struct {
+    uint8_t  msg;
+    uint8_t  accepted;
+    uint8_t  status;
+    uint8_t  reserved;
+    uint32_t seq;
+} WsPoseAck;
+#pragma pack(pop)
+
+// Compile-time size check
+#ifdef __cplusplus
+static_assert(sizeof(WsPoseHeader) == 4, "WsPoseHeader must be 4 bytes");
+static_assert(sizeof(WsPoseEntry) == 32, "WsPoseEntry must be 32 bytes");
+static_assert(sizeof(WsPoseAck) == 8, "WsPoseAck must be 8 bytes");
+#else
+_Static_assert(sizeof(WsPoseHeader) == 4, "WsPoseHeader must be 4 bytes");
+_Static_assert(sizeof(WsPoseEntry) == 32, "WsPoseEntry must be 32 bytes");
+_Static_assert(sizeof(WsPoseAck) == 8, "WsPoseAck must be 8 bytes");
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WS_POSE_BINARY_H
@@ -0,0 +1,207 @@
+#ifndef WS_STREAM_BINARY_H
+#define WS_STREAM_BINARY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "shared_telemetry.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Binary WebSocket stream protocol (Brain → client, opcode 0x02)
+ *
+ * Pushed only to clients that subscribed to the topic with
+ * {"cmd":"subscribe","topic":"scan_point,distance","rate_ms":100}.
+ * rate_ms caps how often a client gets a frame per topic; ESTOP changes
+ * are never held back. All fields are little-endian. Each frame is one
+ * WsStreamHeader followed by the msg-specific body.
+ *
+ * Header (4 bytes):
+ * Offset  Size  Field
+ * ------  ----  -----
+ *   0      1    msg (WS_STREAM_MSG_*)
+ *   1      1    count (meaning per msg, see below)
+ *   2      2    seq (per client and topic, +1 per frame sent)
+ *
+ * WS_STREAM_MSG_SCAN: count × WsStreamScanPoint (8 bytes each), every
+ *   point captured since the previous frame, oldest first. If a client
+ *   falls more than WS_STREAM_MAX_POINTS behind, the oldest are lost.
+ *
+ * WS_STREAM_MSG_DISTANCE: count = 1, one WsStreamDistance. Only sent
+ *   when the sensor has a new sample.
+ *
+ * WS_STREAM_MSG_TELEMETRY: SharedTelemetryData, delta encoded as 16-bit
+ *   words: WS_STREAM_TELEMETRY_MASKS u64 masks (bit i % 64 of mask i / 64
+ *   set = word i follows), then the masked words in order. count = 1 for a keyframe (every word present),
+ *   0 for a delta against this client's previous telemetry frame.
+ *   Keyframes go out first and every WS_STREAM_KEYFRAME_INTERVAL frames.
+ *
+ * WS_STREAM_MSG_ESTOP: count = 1, one WsStreamEstop. Sent on subscribe
+ *   and on every change.
+ *
+ * WS_STREAM_MSG_AVOID: count = 1, one WsStreamAvoid. The obstacle
+ *   avoider's decision, sent on subscribe, on every action change and
+ *   when avoidance is switched on or off.
+ *
+ * WS_STREAM_MSG_MAP: not a topic; the reply to {"type":"map_get"}.
+ *   One WsStreamMap, then count tiles of tile_cells^2 int8 log-odds
+ *   (cell x + y * tile_cells, x forward and y left in the odometry
+ *   frame), in the order of their bits in tile_mask: bit tx + ty * tiles
+ *   is the tile at origin + (tx, ty). Tiles without evidence are left
+ *   out. seq is always 0.
+ *
+ * Frames are not dropped once queued: a client whose TX queue is over
+ * the high-water mark is skipped for that interval instead, so deltas
+ * always apply to the previous frame the client received.
+ */
+
+#define WS_STREAM_MSG_SCAN          0xC1
+#define WS_STREAM_MSG_DISTANCE      0xC2
+#define WS_STREAM_MSG_TELEMETRY     0xC3
+#define WS_STREAM_MSG_ESTOP         0xC4
+#define WS_STREAM_MSG_AVOID         0xC5
+#define WS_STREAM_MSG_MAP           0xC6
+
+// Topic bits in a client's subscription mask
+#define WS_STREAM_TOPIC_SCAN        0
+#define WS_STREAM_TOPIC_DISTANCE    1
+#define WS_STREAM_TOPIC_TELEMETRY   2
+#define WS_STREAM_TOPIC_ESTOP       3
+#define WS_STREAM_TOPIC_AVOID       4
+#define WS_STREAM_TOPIC_COUNT       5
+
+#define WS_STREAM_MAX_POINTS        32
+#define WS_STREAM_KEYFRAME_INTERVAL 50
+#define WS_STREAM_AVOID_OFF         0xFF    // WsStreamAvoid.action while avoidance is off
+
+#define WS_STREAM_TELEMETRY_WORDS   (sizeof(SharedTelemetryData) / 2)
+#define WS_STREAM_TELEMETRY_MASKS   ((WS_STREAM_TELEMETRY_WORDS + 63) / 64)
+#define WS_STREAM_TELEMETRY_MASK_LEN (8 * WS_STREAM_TELEMETRY_MASKS)
+#define WS_STREAM_TELEMETRY_MAX     (WS_STREAM_TELEMETRY_MASK_LEN + 2 * WS_STREAM_TELEMETRY_WORDS)
+
+#pragma pack(push, 1)
+typedef struct {
+    uint8_t  msg;
+    uint8_t  count;
+    uint16_t seq;
+} WsStreamHeader;
+
+typedef struct {
+    int16_t  angle_deg;
+    int16_t  distance_mm;       // -1 = error/timeout
+    uint32_t timestamp_ms;      // CLOCK_MONOTONIC, low 32 bits
+} WsStreamScanPoint;
+
+typedef struct {
+    uint16_t distance_mm;
+    uint8_t  status;            // DistanceSensor::Status
+    uint8_t  profile;           // DistanceSensor::Profile
+    uint32_t sample_seq;
+} WsStreamDistance;
+
+typedef struct {
+    uint8_t  active;
+    uint8_t  reserved[3];
+} WsStreamEstop;
+
+typedef struct {
+    uint8_t  action;            // ObstacleAvoider::Action or WS_STREAM_AVOID_OFF
+    uint8_t  reserved;
+    int16_t  front_mm;          // -1 = unknown
+    int16_t  heading_deg;
+    int16_t  heading_mm;        // -1 = unknown
+} WsStreamAvoid;
+
+typedef struct {
+    int16_t  origin_tx;         // World tile at the window's low corner
+    int16_t  origin_ty;
+    uint16_t cell_mm;
+    uint8_t  tile_cells;        // Tile edge in cells
+    uint8_t  tiles;             // Window edge in tiles
+    int32_t  robot_x_mm;        // Odometry pose
+    int32_t  robot_y_mm;
+    int16_t  heading_cdeg;      // Counter-clockwise, 1/100 degree
+    int8_t   occupied;          // Log-odds above which a cell counts as occupied
+    uint8_t  reserved;
+    uint64_t tile_mask;
+} WsStreamMap;
+#pragma pack(pop)
+
+#ifdef __cplusplus
+static_assert(sizeof(WsStreamHeader) == 4, "WsStreamHeader must be 4 bytes");
+static_assert(sizeof(WsStreamScanPoint) == 8, "WsStreamScanPoint must be 8 bytes");
+static_assert(sizeof(WsStreamDistance) == 8, "WsStreamDistance must be 8 bytes");
+static_assert(sizeof(WsStreamAvoid) == 8, "WsStreamAvoid must be 8 bytes");
+static_assert(sizeof(WsStreamMap) == 28, "WsStreamMap must be 28 bytes");
+#else
+_Static_assert(sizeof(WsStreamHeader) == 4, "WsStreamHeader must be 4 bytes");
+_Static_assert(sizeof(WsStreamScanPoint) == 8, "WsStreamScanPoint must be 8 bytes");
+_Static_assert(sizeof(WsStreamDistance) == 8, "WsStreamDistance must be 8 bytes");
+_Static_assert(sizeof(WsStreamAvoid) == 8, "WsStreamAvoid must be 8 bytes");
+_Static_assert(sizeof(WsStreamMap) == 28, "WsStreamMap must be 28 bytes");
+#endif
+
+/**
+ * Encode cur as a telemetry body (mask + words) into out, which must
+ * hold WS_STREAM_TELEMETRY_MAX bytes. prev = NULL makes a keyframe.
+ * Returns the body length; WS_STREAM_TELEMETRY_MASK_LEN (masks only)
+ * means nothing changed.
+ */
+static inline size_t ws_stream_telemetry_encode(uint8_t *out, const SharedTelemetryData *cur,
+                                                const SharedTelemetryData *prev) {
+    uint16_t cw[WS_STREAM_TELEMETRY_WORDS];
+    uint16_t pw[WS_STREAM_TELEMETRY_WORDS];
+    memcpy(cw, cur, sizeof(cw));
+    if (prev) {
+        memcpy(pw, prev, sizeof(pw));
+    }
+
+    uint64_t mask[WS_STREAM_TELEMETRY_MASKS] = { 0 };
+    size_t len = WS_STREAM_TELEMETRY_MASK_LEN;
+    for (size_t i = 0; i < WS_STREAM_TELEMETRY_WORDS; i++) {
+        if (!prev || cw[i] != pw[i]) {
+            mask[i / 64] |= 1ULL << (i % 64);
+            memcpy(out + len, &cw[i], 2);
+            len += 2;
+        }
+    }
+    memcpy(out, mask, sizeof(mask));
+    return len;
+}
+
+/**
+ * Apply a telemetry body to state (the previous frame's result, or
+ * anything for a keyframe). Returns 0, or -1 if the body is malformed.
+ */
+static inline int ws_stream_telemetry_decode(SharedTelemetryData *state, const uint8_t *in, size_t len) {
+    uint16_t w[WS_STREAM_TELEMETRY_WORDS];
+    uint64_t mask[WS_STREAM_TELEMETRY_MASKS];
+    const size_t tail = WS_STREAM_TELEMETRY_WORDS % 64;
+
+    if (len < WS_STREAM_TELEMETRY_MASK_LEN) return -1;
+    memcpy(mask, in, sizeof(mask));
+    if (tail != 0 && (mask[WS_STREAM_TELEMETRY_MASKS - 1] >> tail) != 0) return -1;
+
+    memcpy(w, state, sizeof(w));
+    size_t off = WS_STREAM_TELEMETRY_MASK_LEN;
+    for (size_t i = 0; i < WS_STREAM_TELEMETRY_WORDS; i++) {
+        if (mask[i / 64] & (1ULL << (i % 64))) {
+            if (off + 2 > len) return -1;
+            memcpy(&w[i], in + off, 2);
+            off += 2;
+        }
+    }
+    if (off != len) return -1;
+
+    memcpy(state, w, sizeof(w));
+    return 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WS_STREAM_BINARY_H
@@ -0,0 +1,477 @@
+/**
+ * Spider Robot v3.1 - Native WebSocket client Implementation
+ */
+
+#include "spider_client.h"
+#include "sha1.h"
+#include "ws_frame.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <random>
+#include <sys/socket.h>
+#include <unistd.h>
+
+extern "C" {
+#include "timebase.h"
+}
+
+#define SPIDER_CLIENT_READ_CHUNK    (64 * 1024)
+
+static void base64_encode(const uint8_t* in, size_t len, char* out) {
+    static const char b64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t i, j;
+    for (i = 0, j = 0; i < len; i += 3, j += 4) {
+        uint32_t v = in[i] << 16;
+        if (i + 1 < len) v |= in[i + 1] << 8;
+        if (i + 2 < len) v |= in[i + 2];
+        out[j]     = b64[(v >> 18) & 0x3F];
+        out[j + 1] = b64[(v >> 12) & 0x3F];
+        out[j + 2] = (i + 1 < len) ? b64[(v >> 6) & 0x3F] : '=';
+        out[j + 3] = (i + 2 < len) ? b64[v & 0x3F] : '=';
+    }
+    out[j] = '\0';
+}
+
+static uint32_t next_rand(uint32_t& s) {
+    s ^= s << 13;
+    s ^= s >> 17;
+    s ^= s << 5;
+    return s;
+}
+
+// Milliseconds left until deadline, at least 0
+static int remaining_ms(uint64_t deadline) {
+    uint64_t now = timebase_millis64();
+    return now >= deadline ? 0 : (int)(deadline - now);
+}
+
+SpiderClient::SpiderClient() {
+    std::random_device rd;
+    m_mask_seed = rd() | 1;             // xorshift must not start at 0
+}
+
+SpiderClient::~SpiderClient() {
+    close();
+}
+
+bool SpiderClient::connect(const char* host, uint16_t port, int timeout_ms) {
+    close();
+    m_error.clear();
+    uint64_t deadline = timebase_millis64() + (uint64_t)(timeout_ms > 0 ? timeout_ms : 0);
+
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* res = nullptr;
+    char service[8];
+    snprintf(service, sizeof(service), "%u", port);
+    if (getaddrinfo(host, service, &hints, &res) != 0 || !res) {
+        m_error = "cannot resolve host";
+        return false;
+    }
+
+    int fd = -1;
+    for (addrinfo* ai = res; ai && fd < 0; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) continue;
+        if (::connect(fd, ai->ai_addr, ai->ai_addrlen) != 0 && errno != EINPROGRESS) {
+            ::close(fd);
+            fd = -1;
+            continue;
+        }
+        pollfd pfd = {fd, POLLOUT, 0};
+        int err = 0;
+        socklen_t err_len = sizeof(err);
+        if (::poll(&pfd, 1, remaining_ms(deadline)) != 1 ||
+            getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &err_len) != 0 || err != 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(res);
+    if (fd < 0) {
+        m_error = "connect failed";
+        return false;
+    }
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    m_fd = fd;
+    m_telemetry_valid = false;
+    if (!handshake(host, remaining_ms(deadline))) {
+        std::string why = m_error;
+        close();
+        m_error = why;
+        return false;
+    }
+    return true;
+}
+
+bool SpiderClient::handshake(const char* host, int timeout_ms) {
+    uint64_t deadline = timebase_millis64() + (uint64_t)timeout_ms;
+
+    uint8_t nonce[16];
+    for (int i = 0; i < 16; i += 4) {
+        uint32_t r = next_rand(m_mask_seed);
+        memcpy(nonce + i, &r, 4);
+    }
+    char key[32];
+    base64_encode(nonce, sizeof(nonce), key);
+
+    char req[512];
+    int req_len = snprintf(req, sizeof(req),
+        "GET / HTTP/1.1\r\n"
+        "Host: %s\r\n"
+        "Upgrade: websocket\r\n"
+        "Connection: Upgrade\r\n"
+        "Sec-WebSocket-Key: %s\r\n"
+        "Sec-WebSocket-Version: 13\r\n"
+        "\r\n", host, key);
+    if (req_len <= 0 || (size_t)req_len >= sizeof(req) ||
+        send(m_fd, req, (size_t)req_len, MSG_NOSIGNAL) != req_len) {
+        m_error = "handshake send failed";
+        return false;
+    }
+
+    std::string resp;
+    size_t end;
+    char buf[1024];
+    while ((end = resp.find("\r\n\r\n")) == std::string::npos) {
+        pollfd pfd = {m_fd, POLLIN, 0};
+        if (resp.size() > 4096 || ::poll(&pfd, 1, remaining_ms(deadline)) != 1) {
+            m_error = "handshake timed out";
+            return false;
+        }
+        ssize_t n = recv(m_fd, buf, sizeof(buf), 0);
+        if (n <= 0 && !(n < 0 && (errno == EAGAIN || errno == EINTR))) {
+            m_error = "handshake closed";
+            return false;
+        }
+        if (n > 0) resp.append(buf, (size_t)n);
+    }
+    if (resp.compare(0, 12, "HTTP/1.1 101") != 0) {
+        m_error = "handshake refused";
+        return false;
+    }
+
+    // Accept = base64(SHA-1(key + GUID))
+    char concat[96];
+    snprintf(concat, sizeof(concat), "%s258EAFA5-E914-47DA-95CA-C5AB0DC85B11", key);
+    uint8_t hash[20];
+    sha1((const uint8_t*)concat, strlen(concat), hash);
+    char accept[32];
+    base64_encode(hash, sizeof(hash), accept);
+    size_t at = resp.find("Sec-WebSocket-Accept:");
+    if (at == std::string::npos || at > end) {
+        m_error = "handshake without accept";
+        return false;
+    }
+    at += 21;
+    while (resp[at] == ' ') at++;
+    if (resp.compare(at, strlen(accept), accept) != 0) {
+        m_error = "handshake accept mismatch";
+        return false;
+    }
+
+    // Frames may follow the response in the same read
+    m_rx.assign(resp.begin() + end + 4, resp.end());
+    return true;
+}
+
+void SpiderClient::close() {
+    if (m_fd < 0) {
+        return;
+    }
+    ::close(m_fd);
+    m_fd = -1;
+    m_rx.clear();
+    m_tx.clear();
+    m_tx_off = 0;
+
+    // Taken out first: a callback may connect again and queue new work
+    std::deque<Pending> replies;
+    std::deque<AckCallback> acks;
+    replies.swap(m_replies);
+    acks.swap(m_acks);
+    for (auto& p : replies) {
+        if (p.cb) p.cb(nullptr, 0);
+    }
+    for (auto& cb : acks) {
+        if (cb) cb(nullptr);
+    }
+}
+
+void SpiderClient::fail(const char* what) {
+    if (m_fd < 0) {
+        return;
+    }
+    m_error = what;
+    close();
+}
+
+// Client frames are masked (RFC 6455 5.3); head and body form one payload
+bool SpiderClient::queueFrame(uint8_t opcode, const void* head, size_t head_len,
+                              const void* body, size_t body_len) {
+    if (m_fd < 0 || txQueued() > SPIDER_CLIENT_TX_LIMIT) {
+        return false;
+    }
+    if (m_tx_off > 0 && m_tx_off >= m_tx.size() / 2) {
+        m_tx.erase(m_tx.begin(), m_tx.begin() + (ptrdiff_t)m_tx_off);
+        m_tx_off = 0;
+    }
+
+    size_t len = head_len + body_len;
+    uint8_t hdr[WS_FRAME_HEADER_MAX + 4];
+    size_t hdr_len = ws_frame_header(hdr, opcode, len);
+    hdr[1] |= 0x80;
+    uint32_t mask = next_rand(m_mask_seed);
+    memcpy(hdr + hdr_len, &mask, 4);
+    hdr_len += 4;
+
+    size_t at = m_tx.size();
+    m_tx.resize(at + hdr_len + len);
+    uint8_t* p = m_tx.data() + at;
+    memcpy(p, hdr, hdr_len);
+    if (head_len) memcpy(p + hdr_len, head, head_len);
+    if (body_len) memcpy(p + hdr_len + head_len, body, body_len);
+    ws_unmask(p + hdr_len, len, hdr + hdr_len - 4);
+    return true;
+}
+
+uint32_t SpiderClient::command(const char* json, ReplyCallback cb) {
+    const char* p = json;
+    while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') p++;
+    if (*p != '{') {
+        m_error = "command is not a JSON object";
+        return 0;
+    }
+    p++;
+    const char* q = p;
+    while (*q == ' ' || *q == '\t' || *q == '\r' || *q == '\n') q++;
+
+    // {"id":N, then the command's own members
+    uint32_t id = m_next_id;
+    char prefix[24];
+    int prefix_len = snprintf(prefix, sizeof(prefix), "{\"id\":%u%s", id, *q == '}' ? "" : ",");
+    if (!queueFrame(0x01, prefix, (size_t)prefix_len, p, strlen(p))) {
+        return 0;
+    }
+    m_next_id = m_next_id == UINT32_MAX ? 1 : m_next_id + 1;
+    m_replies.push_back({id, std::move(cb)});
+    return id;
+}
+
+uint32_t SpiderClient::batch(const char* const* cmds, size_t count, ReplyCallback cb) {
+    std::string json = "{\"cmd\":\"batch\",\"cmds\":[";
+    for (size_t i = 0; i < count; i++) {
+        if (i > 0) json += ',';
+        json += cmds[i];
+    }
+    json += "]}";
+    return command(json, std::move(cb));
+}
+
+uint32_t SpiderClient::subscribe(const char* topics, int rate_ms, ReplyCallback cb) {
+    std::string json = "{\"cmd\":\"subscribe\",\"topic\":\"";
+    json += topics;
+    json += "\",\"rate_ms\":";
+    json += std::to_string(rate_ms);
+    json += '}';
+    return command(json, std::move(cb));
+}
+
+uint32_t SpiderClient::unsubscribe(const char* topics, ReplyCallback cb) {
+    std::string json = "{\"cmd\":\"unsubscribe\",\"topic\":\"";
+    json += topics;
+    json += "\"}";
+    return command(json, std::move(cb));
+}
+
+bool SpiderClient::sendPoses(const WsPoseEntry* entries, size_t count, uint8_t req_flags, AckCallback cb) {
+    if (count == 0 || count > WS_POSE_MAX_BATCH) {
+        m_error = "pose count out of range";
+        return false;
+    }
+    // Always acked, so each ack is the next frame's and none is unsolicited
+    WsPoseHeader hdr = {};
+    hdr.msg = WS_POSE_MSG_POSE;
+    hdr.count = (uint8_t)count;
+    hdr.req_flags = (uint8_t)(req_flags | WS_POSE_REQ_ACK);
+    if (!queueFrame(0x02, &hdr, sizeof(hdr), entries, count * sizeof(WsPoseEntry))) {
+        return false;
+    }
+    m_acks.push_back(std::move(cb));
+    return true;
+}
+
+bool SpiderClient::flush() {
+    while (m_fd >= 0 && wantsWrite()) {
+        ssize_t n = send(m_fd, m_tx.data() + m_tx_off, m_tx.size() - m_tx_off, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            fail("send failed");
+            return false;
+        }
+        m_tx_off += (size_t)n;
+    }
+    if (m_tx_off == m_tx.size()) {
+        m_tx.clear();
+        m_tx_off = 0;
+    }
+    return m_fd >= 0;
+}
+
+int SpiderClient::pump() {
+    if (m_fd < 0) return -1;
+    if (m_dispatching) return 0;
+    if (!flush()) return -1;
+
+    bool eof = false;
+    for (;;) {
+        size_t at = m_rx.size();
+        m_rx.resize(at + SPIDER_CLIENT_READ_CHUNK);
+        ssize_t n = recv(m_fd, m_rx.data() + at, SPIDER_CLIENT_READ_CHUNK, MSG_DONTWAIT);
+        m_rx.resize(at + (n > 0 ? (size_t)n : 0));
+        if (n > 0) continue;
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        // Whatever came before the end is still delivered
+        eof = true;
+        break;
+    }
+
+    int handled = dispatch();
+    if (eof) {
+        fail("connection closed by daemon");
+    }
+    // Pongs and whatever the callbacks queued
+    if (!flush()) return -1;
+    return handled;
+}
+
+int SpiderClient::poll(int timeout_ms) {
+    if (m_fd < 0) return -1;
+    pollfd pfd = {m_fd, (short)(POLLIN | (wantsWrite() ? POLLOUT : 0)), 0};
+    if (::poll(&pfd, 1, timeout_ms) < 0 && errno != EINTR) {
+        fail("poll failed");
+        return -1;
+    }
+    return pump();
+}
+
+int SpiderClient::dispatch() {
+    int handled = 0;
+    size_t off = 0;
+    m_dispatching = true;
+    while (m_fd >= 0) {
+        WsFrameHeader hdr;
+        bool complete = ws_frame_parse(m_rx.data() + off, m_rx.size() - off, hdr);
+        if (hdr.header_len > 0 && hdr.payload_len > SPIDER_CLIENT_RX_MAX) {
+            fail("message too big");
+            break;
+        }
+        if (!complete) break;
+
+        uint8_t* payload = m_rx.data() + off + hdr.header_len;
+        size_t len = (size_t)hdr.payload_len;
+        off += hdr.header_len + len;
+        if (hdr.masked) {
+            ws_unmask(payload, len, payload - 4);
+        }
+
+        // The daemon never fragments
+        if (!hdr.fin || hdr.opcode == 0x00) {
+            fail("fragmented frame");
+        } else if (hdr.opcode == 0x01) {
+            dispatchText((const char*)payload, len);
+            handled++;
+        } else if (hdr.opcode == 0x02) {
+            dispatchBinary(payload, len);
+            handled++;
+        } else if (hdr.opcode == 0x08) {
+            fail("connection closed by daemon");
+        } else if (hdr.opcode == 0x09) {
+            queueFrame(0x0A, payload, len, nullptr, 0);
+        }
+    }
+    m_dispatching = false;
+    // A callback that closed the connection also emptied m_rx
+    if (m_fd >= 0) {
+        m_rx.erase(m_rx.begin(), m_rx.begin() + (ptrdiff_t)off);
+    }
+    return handled;
+}
+
+void SpiderClient::dispatchText(const char* text, size_t len) {
+    uint32_t id = 0;
+    if (len > 6 && memcmp(text, "{\"id\":", 6) == 0) {
+        for (size_t i = 6; i < len && i < 16 && text[i] >= '0' && text[i] <= '9'; i++) {
+            id = id * 10 + (uint32_t)(text[i] - '0');
+        }
+    }
+
+    bool in_flight = false;
+    for (const Pending& p : m_replies) {
+        if (p.id == id) {
+            in_flight = id != 0;
+            break;
+        }
+    }
+    if (!in_flight) {
+        if (m_on_event) m_on_event(text, len);
+        return;
+    }
+
+    // Older commands were handled first and answered with nothing
+    while (m_fd >= 0 && !m_replies.empty()) {
+        Pending p = std::move(m_replies.front());
+        m_replies.pop_front();
+        bool mine = p.id == id;
+        if (p.cb) {
+            p.cb(mine ? text : nullptr, mine ? len : 0);
+        }
+        if (mine) break;
+    }
+}
+
+void SpiderClient::dispatchBinary(const uint8_t* data, size_t len) {
+    if (len == sizeof(WsPoseAck) && data[0] == WS_POSE_MSG_ACK) {
+        WsPoseAck ack;
+        memcpy(&ack, data, sizeof(ack));
+        if (m_acks.empty()) return;
+        AckCallback cb = std::move(m_acks.front());
+        m_acks.pop_front();
+        if (cb) cb(&ack);
+        return;
+    }
+    if (len < sizeof(WsStreamHeader)) {
+        return;
+    }
+
+    WsStreamHeader hdr;
+    memcpy(&hdr, data, sizeof(hdr));
+    const uint8_t* body = data + sizeof(hdr);
+    size_t body_len = len - sizeof(hdr);
+    if (m_on_stream) {
+        m_on_stream(hdr, body, body_len);
+        if (m_fd < 0) return;
+    }
+
+    if (hdr.msg == WS_STREAM_MSG_TELEMETRY) {
+        // Deltas apply to the previous frame, so nothing until a keyframe
+        bool keyframe = hdr.count == 1;
+        if (!keyframe && !m_telemetry_valid) return;
+        m_telemetry_valid = ws_stream_telemetry_decode(&m_telemetry, body, body_len) == 0;
+        if (m_telemetry_valid && m_on_telemetry) {
+            m_on_telemetry(m_telemetry, hdr.seq);
+        }
+    }
+}
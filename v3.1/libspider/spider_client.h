@@ -0,0 +1,166 @@
+/**
+ * Spider Robot v3.1 - Native WebSocket client (libspider)
+ *
+ * Talks to brain_daemon (or brain_sim) on port 9000 without blocking:
+ * connect() does the handshake, then every call only queues bytes, and
+ * pump() (or poll(), or the caller's own poll loop on fd()) moves them
+ * and dispatches what came back.
+ *
+ * Commands are pipelined. command() tags the JSON with "id":N, and the
+ * daemon answers a tagged command to this connection only, with the same
+ * id as the reply's first member, so the reply finds its callback however
+ * many commands are in flight. The daemon handles a connection's commands
+ * in order, so a reply to N also settles every older one still waiting:
+ * their callbacks run with json = nullptr ("answered with nothing", e.g.
+ * map_get, whose map comes as a stream frame). Replies for no command in
+ * flight and untagged messages go to the event callback.
+ *
+ * Binary pose frames always ask for a WsPoseAck, and acks come back in
+ * the order the frames went out. Subscribed stream frames go to the
+ * stream callback; telemetry frames are also delta-decoded and handed
+ * over whole.
+ *
+ * When the connection is lost every callback still waiting runs with
+ * nullptr. Callbacks may queue commands and poses and may close(), but
+ * must not call pump() or poll().
+ *
+ * Not thread-safe.
+ */
+
+#ifndef SPIDER_CLIENT_H
+#define SPIDER_CLIENT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "shared_telemetry.h"
+#include "ws_pose_binary.h"
+#include "ws_stream_binary.h"
+}
+
+#define SPIDER_CLIENT_PORT          9000
+#define SPIDER_CLIENT_TX_LIMIT      (256 * 1024)    // Unsent bytes before sends are refused
+#define SPIDER_CLIENT_RX_MAX        (1024 * 1024)   // Longest message accepted from the daemon
+
+class SpiderClient {
+public:
+    // json = nullptr: the command got no reply of its own, or the connection went
+    using ReplyCallback = std::function<void(const char* json, size_t len)>;
+    // ack = nullptr: the connection went first
+    using AckCallback = std::function<void(const WsPoseAck* ack)>;
+    using EventCallback = std::function<void(const char* json, size_t len)>;
+    using StreamCallback = std::function<void(const WsStreamHeader& hdr, const uint8_t* body, size_t len)>;
+    using TelemetryCallback = std::function<void(const SharedTelemetryData& telemetry, uint16_t seq)>;
+
+    SpiderClient();
+    ~SpiderClient();
+
+    SpiderClient(const SpiderClient&) = delete;
+    SpiderClient& operator=(const SpiderClient&) = delete;
+
+    /**
+     * Connect and complete the WebSocket handshake, waiting at most
+     * timeout_ms. The socket is non-blocking from then on.
+     */
+    bool connect(const char* host, uint16_t port = SPIDER_CLIENT_PORT, int timeout_ms = 2000);
+
+    /**
+     * Drop the connection; callbacks still waiting run with nullptr.
+     */
+    void close();
+
+    bool connected() const { return m_fd >= 0; }
+    int fd() const { return m_fd; }
+
+    /**
+     * Bytes are queued that the socket did not take yet: poll for POLLOUT.
+     */
+    bool wantsWrite() const { return m_tx.size() > m_tx_off; }
+    size_t txQueued() const { return m_tx.size() - m_tx_off; }
+
+    const char* lastError() const { return m_error.c_str(); }
+
+    /**
+     * Queue a JSON command object, e.g. {"cmd":"status"}.
+     * @return its id, or 0 if it was not queued (not connected, not an
+     *         object, or SPIDER_CLIENT_TX_LIMIT reached)
+     */
+    uint32_t command(const char* json, ReplyCallback cb = nullptr);
+    uint32_t command(const std::string& json, ReplyCallback cb = nullptr) { return command(json.c_str(), std::move(cb)); }
+
+    /**
+     * {"cmd":"batch","cmds":[...]}: up to 16 commands run back to back
+     * with a single reply.
+     */
+    uint32_t batch(const char* const* cmds, size_t count, ReplyCallback cb = nullptr);
+
+    /**
+     * Subscribe to stream topics ("scan_point,distance", "muscle_telemetry", ...).
+     */
+    uint32_t subscribe(const char* topics, int rate_ms = 0, ReplyCallback cb = nullptr);
+    uint32_t unsubscribe(const char* topics = "all", ReplyCallback cb = nullptr);
+
+    /**
+     * Queue one binary pose frame of 1..WS_POSE_MAX_BATCH entries.
+     * WS_POSE_REQ_ACK is always added to req_flags.
+     */
+    bool sendPoses(const WsPoseEntry* entries, size_t count, uint8_t req_flags = 0, AckCallback cb = nullptr);
+
+    void onEvent(EventCallback cb) { m_on_event = std::move(cb); }
+    void onStream(StreamCallback cb) { m_on_stream = std::move(cb); }
+    void onTelemetry(TelemetryCallback cb) { m_on_telemetry = std::move(cb); }
+
+    /**
+     * Send what the socket takes, then read and dispatch everything that
+     * arrived. Never blocks.
+     * @return messages dispatched, or -1 once the connection is gone
+     */
+    int pump();
+
+    /**
+     * Wait up to timeout_ms for the socket, then pump().
+     */
+    int poll(int timeout_ms);
+
+    size_t pendingReplies() const { return m_replies.size(); }
+    size_t pendingAcks() const { return m_acks.size(); }
+
+private:
+    struct Pending {
+        uint32_t id;
+        ReplyCallback cb;
+    };
+
+    bool handshake(const char* host, int timeout_ms);
+    bool queueFrame(uint8_t opcode, const void* head, size_t head_len, const void* body, size_t body_len);
+    bool flush();
+    int dispatch();
+    void dispatchText(const char* text, size_t len);
+    void dispatchBinary(const uint8_t* data, size_t len);
+    void fail(const char* what);
+
+    int m_fd = -1;
+    std::string m_error;
+    std::vector<uint8_t> m_rx;
+    std::vector<uint8_t> m_tx;
+    size_t m_tx_off = 0;                // Sent part of m_tx
+    uint32_t m_mask_seed;
+    uint32_t m_next_id = 1;
+    bool m_dispatching = false;
+
+    std::deque<Pending> m_replies;      // Oldest first
+    std::deque<AckCallback> m_acks;
+
+    EventCallback m_on_event;
+    StreamCallback m_on_stream;
+    TelemetryCallback m_on_telemetry;
+    SharedTelemetryData m_telemetry = {};
+    bool m_telemetry_valid = false;     // A keyframe has arrived
+};
+
+#endif // SPIDER_CLIENT_H
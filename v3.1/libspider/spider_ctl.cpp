@@ -0,0 +1,116 @@
+/**
+ * Spider Robot v3.1 - libspider command-line client
+ *
+ * Sends each JSON argument as a command, all of them pipelined on one
+ * connection, and prints every reply with its id as it arrives. With
+ * --sub it then subscribes and prints one line per stream frame (and
+ * every untagged message) until --wait runs out.
+ *
+ * Usage: spider_ctl [--host H] [--port 9000] [--sub TOPICS] [--rate MS]
+ *                   [--wait MS] [JSON ...]
+ *
+ *   spider_ctl '{"cmd":"status"}' '{"cmd":"get_servos"}'
+ *   spider_ctl --sub muscle_telemetry,estop --rate 100 --wait 5000
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "spider_client.h"
+
+extern "C" {
+#include "timebase.h"
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+        "Usage: %s [--host H] [--port 9000] [--sub TOPICS] [--rate MS] [--wait MS] [JSON ...]\n", prog);
+}
+
+int main(int argc, char** argv) {
+    const char* host = "127.0.0.1";
+    int port = SPIDER_CLIENT_PORT;
+    const char* sub = nullptr;
+    int rate_ms = 0;
+    int wait_ms = 2000;
+    int first_cmd = argc;
+
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--host") == 0 && has_value) {
+            host = argv[++i];
+        } else if (strcmp(argv[i], "--port") == 0 && has_value) {
+            port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--sub") == 0 && has_value) {
+            sub = argv[++i];
+        } else if (strcmp(argv[i], "--rate") == 0 && has_value) {
+            rate_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--wait") == 0 && has_value) {
+            wait_ms = atoi(argv[++i]);
+        } else if (argv[i][0] == '-' && argv[i][1] == '-') {
+            usage(argv[0]);
+            return 2;
+        } else {
+            first_cmd = i;
+            break;
+        }
+    }
+
+    SpiderClient client;
+    if (!client.connect(host, (uint16_t)port)) {
+        fprintf(stderr, "Cannot connect to %s:%d: %s\n", host, port, client.lastError());
+        return 1;
+    }
+
+    int unanswered = 0;
+    auto print_reply = [&unanswered](uint32_t id) {
+        return [&unanswered, id](const char* json, size_t len) {
+            if (json) {
+                printf("%u %.*s\n", id, (int)len, json);
+            } else {
+                printf("%u (no reply)\n", id);
+                unanswered++;
+            }
+        };
+    };
+
+    // Ids are handed out in order, so each callback knows its own up front
+    uint32_t next = 0;
+    for (int i = first_cmd; i < argc; i++) {
+        uint32_t id = client.command(argv[i], print_reply(next + 1));
+        if (id == 0) {
+            fprintf(stderr, "Not sent: %s (%s)\n", argv[i], client.lastError());
+            return 1;
+        }
+        next = id;
+    }
+    if (sub) {
+        client.subscribe(sub, rate_ms, print_reply(next + 1));
+        client.onEvent([](const char* json, size_t len) {
+            printf("event %.*s\n", (int)len, json);
+        });
+        client.onStream([](const WsStreamHeader& hdr, const uint8_t*, size_t len) {
+            printf("stream 0x%02X count=%u seq=%u bytes=%zu\n", hdr.msg, hdr.count, hdr.seq, len);
+        });
+        client.onTelemetry([](const SharedTelemetryData& t, uint16_t seq) {
+            printf("telemetry seq=%u muscle_seq=%u\n", seq, t.last_seq);
+        });
+    }
+
+    // Replies first, then streams until --wait is up
+    uint64_t deadline = timebase_millis64() + (uint64_t)wait_ms;
+    while (client.connected() && (sub || client.pendingReplies() > 0)) {
+        uint64_t now = timebase_millis64();
+        if (now >= deadline) break;
+        client.poll((int)(deadline - now));
+        fflush(stdout);
+    }
+
+    if (client.pendingReplies() > 0 || !client.connected()) {
+        fprintf(stderr, "%zu command(s) unanswered%s%s\n", client.pendingReplies(),
+                client.connected() ? "" : ": ", client.connected() ? "" : client.lastError());
+        return 1;
+    }
+    return unanswered > 0 ? 1 : 0;
+}
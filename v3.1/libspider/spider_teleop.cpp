@@ -0,0 +1,162 @@
+/**
+ * Spider Robot v3.1 - UDP teleop sender Implementation
+ */
+
+#include "spider_teleop.h"
+#include "sha1.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <netdb.h>
+#include <random>
+#include <sys/socket.h>
+#include <unistd.h>
+
+extern "C" {
+#include "timebase.h"
+}
+
+static int16_t to_milli(float v, float lo, float hi) {
+    if (v < lo) v = lo;
+    if (v > hi) v = hi;
+    return (int16_t)(v * 1000.0f + (v < 0 ? -0.5f : 0.5f));
+}
+
+SpiderTeleop::~SpiderTeleop() {
+    close();
+}
+
+bool SpiderTeleop::open(const char* host, uint16_t port, const uint8_t* key, size_t key_len) {
+    close();
+    if (key_len == 0 || key_len > UDP_TELEOP_KEY_MAX) {
+        return false;
+    }
+    // HMAC: the key zero-padded to a block, xored with each pad
+    memset(m_ipad, 0x36, sizeof(m_ipad));
+    memset(m_opad, 0x5C, sizeof(m_opad));
+    for (size_t i = 0; i < key_len; i++) {
+        m_ipad[i] ^= key[i];
+        m_opad[i] ^= key[i];
+    }
+
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    addrinfo* res = nullptr;
+    char service[8];
+    snprintf(service, sizeof(service), "%u", port);
+    if (getaddrinfo(host, service, &hints, &res) != 0 || !res) {
+        return false;
+    }
+    for (addrinfo* ai = res; ai && m_fd < 0; ai = ai->ai_next) {
+        m_fd = socket(ai->ai_family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (m_fd >= 0 && ::connect(m_fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+            ::close(m_fd);
+            m_fd = -1;
+        }
+    }
+    freeaddrinfo(res);
+    if (m_fd < 0) {
+        return false;
+    }
+
+    std::random_device rd;
+    do {
+        m_session = rd();
+    } while (m_session == 0);
+    m_seq = 0;
+    m_has_status = false;
+    return true;
+}
+
+void SpiderTeleop::close() {
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+void SpiderTeleop::tag(const uint8_t* data, size_t len, uint8_t out[20]) const {
+    uint8_t inner[UDP_TELEOP_KEY_MAX + UDP_TELEOP_DATAGRAM_MAX];
+    memcpy(inner, m_ipad, UDP_TELEOP_KEY_MAX);
+    memcpy(inner + UDP_TELEOP_KEY_MAX, data, len);
+    uint8_t inner_hash[20];
+    sha1(inner, UDP_TELEOP_KEY_MAX + len, inner_hash);
+
+    uint8_t outer[UDP_TELEOP_KEY_MAX + 20];
+    memcpy(outer, m_opad, UDP_TELEOP_KEY_MAX);
+    memcpy(outer + UDP_TELEOP_KEY_MAX, inner_hash, 20);
+    sha1(outer, sizeof(outer), out);
+}
+
+bool SpiderTeleop::send(uint8_t msg, const void* payload, size_t len) {
+    if (m_fd < 0) {
+        return false;
+    }
+    UdpTeleopHeader hdr = {};
+    hdr.magic = UDP_TELEOP_MAGIC;
+    hdr.msg = msg;
+    hdr.version = UDP_TELEOP_VERSION;
+    hdr.session = m_session;
+    hdr.seq = ++m_seq;
+    hdr.sent_ms = timebase_millis();
+
+    uint8_t buf[UDP_TELEOP_DATAGRAM_MAX];
+    size_t body = sizeof(hdr) + len;
+    memcpy(buf, &hdr, sizeof(hdr));
+    memcpy(buf + sizeof(hdr), payload, len);
+    uint8_t mac[20];
+    tag(buf, body, mac);
+    memcpy(buf + body, mac, UDP_TELEOP_TAG_LEN);
+
+    // A full socket drops this one; the next command replaces it anyway
+    return ::send(m_fd, buf, body + UDP_TELEOP_TAG_LEN, MSG_NOSIGNAL) == (ssize_t)(body + UDP_TELEOP_TAG_LEN);
+}
+
+bool SpiderTeleop::walk(float dir, float turn, float speed, float stride, uint8_t gait) {
+    UdpTeleopWalk w = {};
+    w.dir = to_milli(dir, -1.0f, 1.0f);
+    w.turn = to_milli(turn, -1.0f, 1.0f);
+    // Only kept in range of the field; the gait engine clamps further
+    w.speed = (uint16_t)to_milli(speed, 0.0f, 30.0f);
+    w.stride = (uint16_t)to_milli(stride, 0.0f, 30.0f);
+    w.gait = gait;
+    return send(UDP_TELEOP_MSG_WALK, &w, sizeof(w));
+}
+
+bool SpiderTeleop::pose(const WsPoseEntry& entry) {
+    return send(UDP_TELEOP_MSG_POSE, &entry, sizeof(entry));
+}
+
+int SpiderTeleop::pollStatus() {
+    int got = 0;
+    uint8_t buf[UDP_TELEOP_DATAGRAM_MAX];
+    const size_t expect = sizeof(UdpTeleopHeader) + sizeof(UdpTeleopStatus) + UDP_TELEOP_TAG_LEN;
+    ssize_t n;
+    while (m_fd >= 0 && (n = recv(m_fd, buf, sizeof(buf), 0)) >= 0) {
+        if ((size_t)n != expect) continue;
+
+        UdpTeleopHeader hdr;
+        memcpy(&hdr, buf, sizeof(hdr));
+        if (hdr.magic != UDP_TELEOP_MAGIC || hdr.msg != UDP_TELEOP_MSG_STATUS ||
+            hdr.version != UDP_TELEOP_VERSION || hdr.session != m_session) {
+            continue;
+        }
+        uint8_t mac[20];
+        tag(buf, expect - UDP_TELEOP_TAG_LEN, mac);
+        if (memcmp(mac, buf + expect - UDP_TELEOP_TAG_LEN, UDP_TELEOP_TAG_LEN) != 0) {
+            continue;
+        }
+
+        // Answers may be reordered in flight; keep the newest
+        if (!m_has_status || hdr.seq >= m_status_seq) {
+            memcpy(&m_status, buf + sizeof(hdr), sizeof(m_status));
+            m_status_seq = hdr.seq;
+            m_rtt_ms = timebase_millis() - hdr.sent_ms;
+            m_has_status = true;
+        }
+        got++;
+    }
+    return got;
+}
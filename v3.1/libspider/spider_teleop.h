@@ -0,0 +1,81 @@
+/**
+ * Spider Robot v3.1 - UDP teleop sender (libspider)
+ *
+ * The client side of udp_teleop_binary.h, for a joystick or planner
+ * loop that sends the whole current command at a fixed rate: walk() and
+ * pose() each send one tagged datagram at once, and pollStatus() reads
+ * the daemon's answers without blocking. Each open() starts a new
+ * session, so a restarted sender is never mistaken for a replay of the
+ * old one.
+ *
+ * Not thread-safe.
+ */
+
+#ifndef SPIDER_TELEOP_H
+#define SPIDER_TELEOP_H
+
+#include <cstddef>
+#include <cstdint>
+
+extern "C" {
+#include "udp_teleop_binary.h"
+}
+
+class SpiderTeleop {
+public:
+    SpiderTeleop() = default;
+    ~SpiderTeleop();
+
+    SpiderTeleop(const SpiderTeleop&) = delete;
+    SpiderTeleop& operator=(const SpiderTeleop&) = delete;
+
+    /**
+     * Connect a non-blocking UDP socket to the daemon's --udp-port, keyed
+     * with its --udp-key secret (1..UDP_TELEOP_KEY_MAX bytes).
+     */
+    bool open(const char* host, uint16_t port, const uint8_t* key, size_t key_len);
+    void close();
+    int fd() const { return m_fd; }
+
+    /**
+     * Walk command, as the walk JSON command: dir and turn -1..1 (turn
+     * > 0 clockwise), speed and stride 1.0 = normal. Keep sending it
+     * faster than UDP_TELEOP_DEADMAN_MS or the daemon stops the walk.
+     */
+    bool walk(float dir, float turn, float speed = 1.0f, float stride = 1.0f,
+              uint8_t gait = UDP_TELEOP_GAIT_TRIPOD);
+
+    /**
+     * One immediate pose.
+     */
+    bool pose(const WsPoseEntry& entry);
+
+    /**
+     * Read every status waiting on the socket.
+     * @return how many were genuine answers to this session
+     */
+    int pollStatus();
+
+    bool hasStatus() const { return m_has_status; }
+    const UdpTeleopStatus& status() const { return m_status; }
+    uint32_t statusSeq() const { return m_status_seq; }     // seq of the datagram answered
+    uint32_t rttMs() const { return m_rtt_ms; }
+    uint32_t session() const { return m_session; }
+
+private:
+    bool send(uint8_t msg, const void* payload, size_t len);
+    void tag(const uint8_t* data, size_t len, uint8_t out[20]) const;
+
+    int m_fd = -1;
+    uint8_t m_ipad[UDP_TELEOP_KEY_MAX];
+    uint8_t m_opad[UDP_TELEOP_KEY_MAX];
+    uint32_t m_session = 0;
+    uint32_t m_seq = 0;
+
+    bool m_has_status = false;
+    UdpTeleopStatus m_status = {};
+    uint32_t m_status_seq = 0;
+    uint32_t m_rtt_ms = 0;
+};
+
+#endif // SPIDER_TELEOP_H
@@ -12,57 +12,155 @@
 
 #include "FreeRTOS.h"
 #include "task.h"
-#include "queue.h"
 #include "semphr.h"
 
 #include "pca9685.h"
+#include "i2c_hal.h"
+#include "estop_input.h"
 #include "limits.h"
 #include "versioning.h"
 #include "shared_motion_buffer.h"
+#include "shared_telemetry.h"
+#include "shared_probe.h"
+#include "shared_ack.h"
+#include "shared_tunables.h"
+#include "timebase.h"
+#include "cache_ops.h"
 #include "protocol_posepacket31.h"
+#include "protocol_posedelta.h"
+#include "protocol_posepacketn.h"
 #include "crc16_ccitt_false.h"
 #include "safety/fault_flags.h"
 #include "safety/watchdog.h"
 #include "safety/failsafe.h"
+#include "safety/event_log.h"
+#include "safety/trace_recorder.h"
+#include "safety/load_monitor.h"
+#include "motion_runtime/interpolator.h"
 
-#define MOTION_QUEUE_LENGTH   4
 #define MOTION_TASK_STACK     512
 #define MOTION_TASK_PRIORITY  4
+#define MOTION_ATTACH_POLL_MS 100   // Until the Brain's ring is up; afterwards the mailbox wakes us
 
-#define CMD_HEARTBEAT         0x10
+// Output task: above the motion task so a tick's I2C burst is never split by packet handling.
+// It is also the E-STOP lane: woken straight from the mailbox or E-STOP input interrupt, it owns
+// the bus and the interpolator, so nothing can write a pose after the neutral one
+#define OUTPUT_TASK_STACK     512
+#define OUTPUT_TASK_PRIORITY  5
+#define OUTPUT_QUEUE_DEPTH    MUSCLE_PREFETCH_DEPTH
+#define ESTOP_INPUT_POLL_MS   10    // E-STOP line sampling when its interrupt is unavailable
+
+#if SERVO_CHANNEL_COUNT < SERVO_COUNT_TOTAL || SERVO_CHANNEL_COUNT > SERVO_CHANNEL_MAX || \
+    SERVO_CHANNEL_COUNT > PCA9685_BOARD_COUNT * PCA9685_CHANNEL_COUNT
+#error "SERVO_CHANNEL_COUNT must be SERVO_COUNT_TOTAL..32 and fit the PCA9685 boards"
+#endif
+
+// Output period in effect (see output_poll_tunables())
+#define OUTPUT_PERIOD_US      (g_output_period_ms * 1000ULL)
+
+// Scheduled keyframes reach the interpolator this far ahead so it can see the next one
+#define KEYFRAME_LOOKAHEAD_US (2ULL * OUTPUT_PERIOD_US)
+
+// Motion task notification bits, set by the mailbox handler
+#define MOTION_NOTIFY_PACKET  (1UL << 0)
+#define MOTION_NOTIFY_ESTOP   (1UL << 1)
+#define MOTION_NOTIFY_PING    (1UL << 2)
+
+// Output task notification bits; anything else it waits for is its tick
+#define OUTPUT_NOTIFY_ESTOP   (1UL << 0)
+#define OUTPUT_NOTIFY_WAKE    (1UL << 1)    // Leave the parked state
+
+// Same IDs as brain_linux/src/mailbox.h
 #define CMD_MOTION_PACKET     0x20
-#define CMD_ESTOP             0x30
+#define CMD_HEARTBEAT         0x22
+#define CMD_ESTOP             0x23
+#define CMD_PING              0x24
+
+static TaskHandle_t g_motion_task = NULL;
+static TaskHandle_t g_output_task = NULL;
+
+/**
+ * Keyframe handed from the motion task to the output task. The motion
+ * task validates slots into this queue as soon as the mailbox fires, so
+ * their ring slots are free again before any of them is played. Scheduled
+ * keyframes (exec_at_us set) join the keyframe queues of the groups they
+ * address; immediate ones restart those groups from the current output.
+ */
+typedef struct {
+    uint16_t servo_us[SERVO_CHANNEL_COUNT];
+    uint32_t t_ms;
+    InterpMode mode;
+    uint64_t at_us;
+    int scheduled;
+    uint8_t groups;         // Interpolation groups addressed (SERVO_GROUP_*)
+    uint32_t seq;           // For the trace probes
+} OutputTarget;
 
-static QueueHandle_t g_motion_queue = NULL;
-static volatile SharedMotionBuffer *g_shared_buf = NULL;
+// Motion task writes head, output task reads tail, both under a critical section
+static OutputTarget g_output_queue[OUTPUT_QUEUE_DEPTH];
+static uint32_t g_output_head = 0;
+static uint32_t g_output_tail = 0;
+static volatile int g_output_parked = 0;        // Output task blocked with nothing to play
+static volatile int g_output_blocked = 0;       // Motion task found the queue full
+static volatile int g_estop_input_polled = 0; // No E-STOP interrupt: the output task samples the line
+static int g_estop_input_level = 0;             // Last sampled level, for the rising edge
+static uint32_t g_window_ticks = 0;             // Output ticks since the telemetry window rolled
+static volatile SharedRingHeader *g_shared_hdr = NULL;
+static uint32_t g_read_idx = 0;                 // Ours; published to read_idx
+static uint32_t g_write_cache = 0;              // Last write_idx seen from the Brain
+static uint16_t g_target_us[SERVO_CHANNEL_COUNT];  // Last keyframe handed over; deltas merge into it
+static uint32_t g_slot_payload = 0;             // Packet bytes a slot of the attached ring holds
 static volatile uint32_t g_last_seq = 0;
 static volatile uint32_t g_rx_count = 0;
 static volatile uint32_t g_drop_count = 0;
+static volatile uint32_t g_skip_count = 0;     // Superseded by a newer immediate packet
+static volatile uint32_t g_overrun_count = 0;  // Slots the Brain overwrote before we read them
 static volatile int g_estop_active = 0;
+static volatile uint32_t g_estop_count = 0;     // E-STOPs latched, for the trace probes
+static volatile uint64_t g_estop_rx_us = 0;     // When the newest was latched
+static volatile uint32_t g_unknown_cmd_count = 0;
+static volatile SharedAckHeader *g_ack = NULL;      // Written by the motion task only
+static volatile uint32_t g_ping_seq = 0;        // Latest CMD_PING, answered by the motion task
+// Output rate, substeps and heartbeat timeout: limits.h defaults until the Brain
+// publishes a tunables set. Telemetry timing maxima cover one second of ticks
+static volatile uint32_t g_output_period_ms = 1000 / MOTION_UPDATE_HZ;  // Output task writes
+static SharedTunablesData g_tunables;           // In effect; output task only after boot
+static uint32_t g_tunables_gen = 0;             // Generation applied, 0 = defaults
+static volatile uint64_t g_ping_rx_us = 0;
 
 // Forward declarations
 static void set_all_servos_neutral(void);
+static void wake_output_task(void);
 
 // Watchdog callbacks
 static void on_watchdog_timeout(void) {
-    printf("[Spider] WATCHDOG: Heartbeat timeout!\n");
+    event_log(SHARED_LOG_EVT_WDT_TIMEOUT, 0, 0, 0, 0);
     set_all_servos_neutral();
+    wake_output_task();
 }
 
 static void on_watchdog_estop(void) {
-    printf("[Spider] WATCHDOG: ESTOP triggered!\n");
+    event_log(SHARED_LOG_EVT_WDT_ESTOP, 0, 0, 0, 0);
     failsafe_enter_estop();
+    wake_output_task();
 }
 
 static uint16_t compute_crc16(const uint8_t *data, size_t len) {
     return crc16_ccitt_false(data, len);
 }
 
-static int validate_packet(const PosePacket31 *pkt) {
-    if (pkt->magic != SPIDER_MAGIC) {
+/**
+ * Check a ring packet: a full PosePacket31, a PosePacketDelta or a
+ * PosePacketN, told apart by magic. A delta mask or channel count that
+ * cannot be right fails like a CRC mismatch, since the CRC cannot even
+ * be located; so does a PosePacketN for more channels than we drive.
+ */
+static int check_packet(const PosePacket31 *pkt) {
+    if (pkt->magic != SPIDER_MAGIC && pkt->magic != SPIDER_DELTA_MAGIC &&
+        pkt->magic != SPIDER_WIDE_MAGIC) {
         fault_flags_set(FAULT_PACKET_MAGIC);
         g_drop_count++;
-        printf("[Spider] Bad magic: 0x%04X\n", pkt->magic);
+        event_log(SHARED_LOG_EVT_PKT_MAGIC, pkt->magic, 0, 0, 0);
         return -1;
     }
 
@@ -70,123 +168,591 @@ static int validate_packet(const PosePacket31 *pkt) {
         pkt->ver_minor != SPIDER_VERSION_MINOR) {
         fault_flags_set(FAULT_PACKET_VERSION);
         g_drop_count++;
-        printf("[Spider] Bad version: %d.%d\n", pkt->ver_major, pkt->ver_minor);
+        event_log(SHARED_LOG_EVT_PKT_VERSION, pkt->ver_major, pkt->ver_minor, 0, 0);
         return -2;
     }
 
-    uint16_t computed_crc = compute_crc16((const uint8_t *)pkt, 
-                                           sizeof(PosePacket31) - 2);
-    if (computed_crc != pkt->crc16) {
+    size_t crc_len = sizeof(PosePacket31) - 2;
+    uint16_t stored_crc = pkt->crc16;
+    if (pkt->magic == SPIDER_DELTA_MAGIC) {
+        const PosePacketDelta *d = (const PosePacketDelta *)pkt;
+        if (!posedelta_mask_valid(d->mask) || (d->flags & FLAG_ESTOP)) {
+            fault_flags_set(FAULT_PACKET_CRC);
+            g_drop_count++;
+            event_log(SHARED_LOG_EVT_PKT_CRC, 0, d->mask, 0, 0);
+            return -3;
+        }
+        crc_len = posedelta_crc_len(d->mask);
+        stored_crc = posedelta_crc(d);
+    } else if (pkt->magic == SPIDER_WIDE_MAGIC) {
+        const PosePacketN *w = (const PosePacketN *)pkt;
+        uint8_t count = w->channel_count;
+        if (!posepacketn_count_valid(count) || count > SERVO_CHANNEL_COUNT ||
+            posepacketn_size(count) > g_slot_payload) {
+            fault_flags_set(FAULT_PACKET_CRC);
+            g_drop_count++;
+            event_log(SHARED_LOG_EVT_PKT_CRC, 0, count, 0, 0);
+            return -3;
+        }
+        crc_len = posepacketn_crc_len(w);
+        stored_crc = posepacketn_crc(w);
+    }
+
+    uint16_t computed_crc = compute_crc16((const uint8_t *)pkt, crc_len);
+    if (computed_crc != stored_crc) {
         fault_flags_set(FAULT_PACKET_CRC);
         g_drop_count++;
-        printf("[Spider] CRC mismatch: calc=0x%04X pkt=0x%04X\n", computed_crc, pkt->crc16);
+        event_log(SHARED_LOG_EVT_PKT_CRC, computed_crc, stored_crc, 0, 0);
         return -3;
     }
 
     if (pkt->seq <= g_last_seq && g_last_seq != 0) {
         g_drop_count++;
+        event_log(SHARED_LOG_EVT_PKT_SEQ, pkt->seq, g_last_seq, 0, 0);
         return -4;
     }
 
     return 0;
 }
 
-static void apply_servo_values(const PosePacket31 *pkt) {
-    for (int ch = 0; ch < SERVO_COUNT_TOTAL && ch < 13; ch++) {
-        uint16_t pulse_us = pkt->servo_us[ch];
-        pca9685_set_pwm_us(ch, pulse_us);
+static int validate_packet(const PosePacket31 *pkt) {
+    uint32_t start = load_cycles();
+    int err = check_packet(pkt);
+    load_monitor_record(SHARED_LOAD_STAGE_VALIDATE, load_cycles() - start);
+    return err;
+}
+
+/**
+ * Apply a validated packet to g_target_us: a full pose replaces the
+ * channels it carries, a delta only the ones in its mask.
+ */
+static void merge_target(const PosePacket31 *pkt) {
+    if (pkt->magic == SPIDER_DELTA_MAGIC) {
+        posedelta_merge((const PosePacketDelta *)pkt, g_target_us);
+    } else if (pkt->magic == SPIDER_WIDE_MAGIC) {
+        posepacketn_merge((const PosePacketN *)pkt, g_target_us);
+    } else {
+        memcpy(g_target_us, pkt->servo_us, sizeof(pkt->servo_us));
+    }
+}
+
+/**
+ * Hand a validated packet to the output task as its next keyframe.
+ * exec_at_us is when the keyframe's segment starts (0 = now). A delta
+ * is merged into the previous keyframe's target first.
+ * Returns -1 if the output task has not caught up yet; it wakes the
+ * motion task once it takes the next keyframe.
+ */
+static int set_output_target(const PosePacket31 *pkt, uint64_t exec_at_us) {
+    int ret = -1;
+    taskENTER_CRITICAL();
+    if (g_output_head - g_output_tail < OUTPUT_QUEUE_DEPTH) {
+        OutputTarget *t = &g_output_queue[g_output_head % OUTPUT_QUEUE_DEPTH];
+        merge_target(pkt);
+        memcpy(t->servo_us, g_target_us, sizeof(t->servo_us));
+        t->t_ms = pkt->t_ms;
+        t->mode = (pkt->flags & FLAG_INTERP_Q16) ? INTERP_MODE_Q16 : INTERP_MODE_FLOAT;
+        t->scheduled = (exec_at_us != 0);
+        t->groups = posepacket31_groups(pkt->flags);
+        t->at_us = t->scheduled ? exec_at_us : timebase_shared_us();
+        t->seq = pkt->seq;
+        g_output_head++;
+        ret = 0;
+    } else {
+        g_output_blocked = 1;
+    }
+    taskEXIT_CRITICAL();
+    return ret;
+}
+
+static int peek_output_target(OutputTarget *out) {
+    int ret = -1;
+    taskENTER_CRITICAL();
+    if (g_output_tail != g_output_head) {
+        *out = g_output_queue[g_output_tail % OUTPUT_QUEUE_DEPTH];
+        ret = 0;
+    }
+    taskEXIT_CRITICAL();
+    return ret;
+}
+
+static int output_queue_full(void) {
+    taskENTER_CRITICAL();
+    int full = (g_output_head - g_output_tail >= OUTPUT_QUEUE_DEPTH);
+    if (full) {
+        g_output_blocked = 1;
     }
+    taskEXIT_CRITICAL();
+    return full;
+}
+
+// The motion task left slots in the ring on a full queue; there is room again
+static void unblock_motion_task(int blocked) {
+    if (blocked && g_motion_task != NULL) {
+        xTaskNotify(g_motion_task, MOTION_NOTIFY_PACKET, eSetBits);
+    }
+}
+
+static void pop_output_target(void) {
+    taskENTER_CRITICAL();
+    g_output_tail++;
+    int blocked = g_output_blocked;
+    g_output_blocked = 0;
+    taskEXIT_CRITICAL();
+    unblock_motion_task(blocked);
+}
+
+/**
+ * Park the output task if it has nothing to do: no keyframe playing or
+ * due within the lookahead, no E-STOP and the watchdog happy. The PCA9685
+ * keeps driving the last pose on its own. The motion task wakes it after
+ * every pass that consumed slots, so a keyframe queued after the check
+ * still plays and the telemetry counters never go stale. *wake_at_us is
+ * when the next queued keyframe needs the task, 0 = none queued.
+ */
+static int output_try_park(uint64_t *wake_at_us) {
+    uint64_t wake_at = 0;
+    taskENTER_CRITICAL();
+    int pending = (g_output_tail != g_output_head);
+    if (pending) {
+        const OutputTarget *t = &g_output_queue[g_output_tail % OUTPUT_QUEUE_DEPTH];
+        if (t->scheduled && t->at_us > timebase_shared_us() + KEYFRAME_LOOKAHEAD_US) {
+            wake_at = t->at_us - KEYFRAME_LOOKAHEAD_US;
+            pending = 0;
+        }
+    }
+    int park = !pending && !g_estop_active && watchdog_is_motion_allowed() &&
+               interpolator_is_idle();
+    g_output_parked = park;
+    taskEXIT_CRITICAL();
+    *wake_at_us = wake_at;
+    return park;
+}
+
+static void wake_output_task(void) {
+    if (g_output_parked && g_output_task != NULL) {
+        xTaskNotify(g_output_task, OUTPUT_NOTIFY_WAKE, eSetBits);
+    }
+}
+
+static void flush_output_targets(void) {
+    taskENTER_CRITICAL();
+    g_output_tail = g_output_head;
+    int blocked = g_output_blocked;
+    g_output_blocked = 0;
+    taskEXIT_CRITICAL();
+    unblock_motion_task(blocked);
 }
 
 static void set_all_servos_neutral(void) {
     pca9685_set_all_us(SERVO_PWM_NEUTRAL_US);
 }
 
-static void handle_estop(void) {
+/**
+ * Latch E-STOP from task context and wake the output task to stop the
+ * servos. latch_estop_from_isr() is the interrupt-context version.
+ */
+static void latch_estop(void) {
+    taskENTER_CRITICAL();
     g_estop_active = 1;
+    g_estop_rx_us = timebase_shared_us();
+    uint32_t count = ++g_estop_count;
+    taskEXIT_CRITICAL();
+    trace_point(SHARED_TRACE_ESTOP_RECEIVED, count, 0);
+    if (g_output_task != NULL) {
+        xTaskNotify(g_output_task, OUTPUT_NOTIFY_ESTOP, eSetBits);
+    }
+}
+
+/**
+ * Motion task half of an E-STOP: flags and log. The servos are the
+ * output task's job (see output_estop()).
+ */
+static void handle_estop(void) {
     fault_flags_set(FAULT_ESTOP_ACTIVE);
     
-    set_all_servos_neutral();
-    
-    if (g_shared_buf != NULL) {
-        g_shared_buf->flags |= SHARED_FLAG_ESTOP;
-        __asm volatile ("fence rw, rw" ::: "memory");
+    if (g_shared_hdr != NULL) {
+        g_shared_hdr->muscle_flags |= SHARED_FLAG_ESTOP;
     }
     
-    printf("[Spider] ESTOP activated - all servos neutral\n");
+    event_log(SHARED_LOG_EVT_ESTOP, 0, 0, 0, 0);
 }
 
-static void handle_heartbeat(void) {
-    watchdog_feed();  // Feed watchdog on heartbeat
+/**
+ * Tell the Brain what became of the packet in ring slot idx. The record
+ * line is cleaned before write_idx moves, so the Brain never sees an
+ * ACK it cannot read yet.
+ */
+static void ack_packet(uint32_t seq, uint8_t status, uint32_t idx) {
+    volatile SharedAckRecord *rec = shared_ack_append(g_ack, seq, status, idx, timebase_shared_us());
+    cache_clean_range(rec, sizeof(*rec));
+    shared_ack_publish(g_ack);
+    cache_clean_range(g_ack, sizeof(*g_ack));
+}
+
+/**
+ * Validate the header the Brain published. The ring is only used once
+ * magic, version and geometry check out; a Brain restart clears
+ * MUSCLE_READY and forces a fresh check.
+ */
+static int shared_ring_attach(void) {
+    volatile SharedRingHeader *hdr = (volatile SharedRingHeader *)SHARED_MEM_BASE;
+
+    if (!(SHARED_LOAD_ACQUIRE(&hdr->brain_flags) & SHARED_FLAG_BRAIN_READY)) {
+        g_shared_hdr = NULL;
+        watchdog_set_alive_counter(NULL);
+        return -1;
+    }
+    uint32_t flags = hdr->muscle_flags;
+    if (g_shared_hdr != NULL && (flags & SHARED_FLAG_MUSCLE_READY)) {
+        return 0;
+    }
+
+    int err = shared_ring_header_check(hdr, SHARED_RING_REGION_SIZE);
+    if (err != 0) {
+        if (!(flags & SHARED_FLAG_LAYOUT_REJECTED)) {
+            event_log(SHARED_LOG_EVT_LAYOUT_REJECTED, (uint32_t)-err, hdr->magic, hdr->version, 0);
+            SHARED_STORE_RELEASE(&hdr->muscle_flags, flags | SHARED_FLAG_LAYOUT_REJECTED);
+        }
+        g_shared_hdr = NULL;
+        return err;
+    }
+
+    g_read_idx = hdr->read_idx;
+    g_write_cache = g_read_idx;
+    g_slot_payload = hdr->slot_size - SHARED_SLOT_HEADER_SIZE;
+    // The watchdog samples brain_alive from here on, so the Brain can drop its heartbeat interrupt
+    watchdog_set_alive_counter(&hdr->brain_alive);
+    SHARED_STORE_RELEASE(&hdr->muscle_flags,
+                         (flags & ~SHARED_FLAG_LAYOUT_REJECTED) |
+                         SHARED_FLAG_MUSCLE_READY | SHARED_FLAG_ALIVE_WATCH);
+    g_shared_hdr = hdr;
+    event_log(SHARED_LOG_EVT_RING_ATTACHED, hdr->version >> 8, hdr->version & 0xFF,
+              hdr->slot_count, 0);
+    return 0;
+}
+
+/**
+ * Copy ring slot idx into out. Fails if its generation stamp is not
+ * idx's before and after the copy: the Brain overwrote it (or is doing
+ * so) under the overwrite-oldest policy. The copy is what gets used, so
+ * a slot overwritten after this is harmless.
+ */
+static int read_ring_slot(volatile SharedRingHeader *hdr, uint32_t idx, SharedRingSlot *out) {
+    volatile SharedRingSlot *slot = shared_ring_slot(hdr, idx);
+
+    // The Brain may have written these lines through its D-cache; drop any stale copy here
+    uint32_t size = hdr->slot_size;
+    cache_invalidate_range(slot, size);
+    uint32_t gen = SHARED_LOAD_ACQUIRE(&slot->gen);
+    memcpy(out, (const void *)slot, size);
+    SHARED_FENCE_FULL();
+    cache_invalidate_range(&slot->gen, sizeof(slot->gen));
+    return (gen == shared_ring_slot_gen(idx) && slot->gen == gen) ? 0 : -1;
+}
+
+/**
+ * Step past a slot read_ring_slot() refused. If the Brain lapped us,
+ * everything before the oldest slot it left intact is gone as well.
+ */
+static uint32_t skip_overrun(volatile SharedRingHeader *hdr, uint32_t read_idx) {
+    g_write_cache = SHARED_LOAD_ACQUIRE(&hdr->write_idx);
+    uint32_t next = shared_ring_oldest(hdr, read_idx + 1, g_write_cache);
+    g_overrun_count += next - read_idx;
+    return next;
+}
+
+/**
+ * An immediate jump (no deadline, t_ms 0, no hold): a newer one queued
+ * behind it would override it on arrival, like the Brain's COALESCE.
+ * Only the header is looked at; the packet is validated afterwards.
+ */
+static int is_streaming_slot(const SharedRingSlot *slot) {
+    return slot->exec_at_us == 0 && slot->pkt.t_ms == 0 &&
+           !(slot->pkt.flags & (FLAG_ESTOP | FLAG_HOLD));
+}
+
+/**
+ * Latest-wins drain of the run of streaming packets at read_idx. If the
+ * Muscle fell behind, replaying each one would cost a full output write
+ * for a pose that is already in the past: every packet of the run is
+ * still validated and merged into the target in order, so deltas stay
+ * consistent, but only the newest valid one is handed to the output
+ * task and the others are acked SKIPPED. A packet that fails validation
+ * ends the run, so the ACKs stay in ring order.
+ * The caller has checked the output queue has room.
+ * Returns the number of packets applied (skipped ones included).
+ */
+static int drain_streaming_run(volatile SharedRingHeader *hdr, uint32_t *read_idx_io) {
+    uint32_t read_idx = *read_idx_io;
+    SharedRingSlot newest_slot;     // Whole slot: a PosePacketN runs past a PosePacket31
+    PosePacket31 *newest = &newest_slot.pkt;
+    uint32_t newest_idx = 0;
+    uint8_t groups = 0;             // Every group the run touched
+    int have = 0;
+    int applied = 0;
+    
+    while (read_idx != g_write_cache && !g_estop_active) {
+        SharedRingSlot slot;
+        if (read_ring_slot(hdr, read_idx, &slot) != 0 || !is_streaming_slot(&slot)) {
+            break;
+        }
+        
+        const PosePacket31 *pkt = &slot.pkt;
+        trace_point(SHARED_TRACE_MUSCLE_DEQUEUED, pkt->seq, read_idx);
+        int err = validate_packet(pkt);
+        if (err != 0) {
+            if (have) {
+                break;
+            }
+            ack_packet(err != -1 ? pkt->seq : 0, (uint8_t)-err, read_idx);
+        } else {
+            trace_point(SHARED_TRACE_MUSCLE_VALIDATED, pkt->seq, 0);
+            watchdog_feed();
+            if (have) {
+                merge_target(newest);
+                ack_packet(newest->seq, SHARED_ACK_SKIPPED, newest_idx);
+                g_skip_count++;
+            }
+            memcpy(newest_slot.bytes, slot.bytes, g_slot_payload);
+            groups |= posepacket31_groups(pkt->flags);
+            newest_idx = read_idx;
+            have = 1;
+            g_last_seq = pkt->seq;      // Later packets of the run validate against it
+            applied++;
+        }
+        read_idx++;
+        SHARED_STORE_RELEASE(&hdr->read_idx, read_idx);
+    }
+    
+    if (have) {
+        if (g_estop_active) {
+            ack_packet(newest->seq, SHARED_NACK_ESTOP, newest_idx);
+            applied--;
+        } else {
+            // The skipped packets' groups jump to the merged target as well
+            newest->flags = posepacket31_set_groups(newest->flags, groups);
+            set_output_target(newest, 0);
+            g_rx_count++;
+            ack_packet(newest->seq, SHARED_ACK_OK, newest_idx);
+        }
+    }
+    
+    *read_idx_io = read_idx;
+    return applied;
 }
 
 static int process_shared_buffer_packets(void) {
-    if (g_shared_buf == NULL) {
+    if (shared_ring_attach() != 0) {
         return 0;
     }
+    volatile SharedRingHeader *hdr = g_shared_hdr;
 
-    __asm volatile ("fence rw, rw" ::: "memory");
+    // Tell the Brain we are draining so it can skip mailbox notifications
+    hdr->muscle_flags |= SHARED_FLAG_NOTIFY_SUPPRESS;
     
-    uint32_t read_idx = g_shared_buf->read_idx;
-    uint32_t write_idx = g_shared_buf->write_idx;
+    uint32_t read_idx = g_read_idx;
     int processed = 0;
     
-    while (read_idx != write_idx) {
+    while (1) {
+        // Only look at the Brain's line when our cached copy says we caught up
+        if (read_idx == g_write_cache) {
+            g_write_cache = SHARED_LOAD_ACQUIRE(&hdr->write_idx);
+        }
+        if (read_idx == g_write_cache) {
+            // Clear, then re-check so a batch published meanwhile is not stranded.
+            // Store then load across cores: the one full fence in this path.
+            hdr->muscle_flags &= ~SHARED_FLAG_NOTIFY_SUPPRESS;
+            SHARED_FENCE_FULL();
+            g_write_cache = SHARED_LOAD_ACQUIRE(&hdr->write_idx);
+            if (read_idx == g_write_cache) {
+                break;
+            }
+            hdr->muscle_flags |= SHARED_FLAG_NOTIFY_SUPPRESS;
+            continue;
+        }
+        
+        SharedRingSlot slot;
+        if (read_ring_slot(hdr, read_idx, &slot) != 0) {
+            read_idx = skip_overrun(hdr, read_idx);
+            SHARED_STORE_RELEASE(&hdr->read_idx, read_idx);
+            continue;
+        }
+
+        // Pending trajectory segments are discarded while E-STOP holds
         if (g_estop_active) {
+            ack_packet(slot.pkt.seq, SHARED_NACK_ESTOP, read_idx);
             read_idx++;
-            g_shared_buf->read_idx = read_idx;
-            __asm volatile ("fence rw, rw" ::: "memory");
+            SHARED_STORE_RELEASE(&hdr->read_idx, read_idx);
+            continue;
+        }
+
+        if (is_streaming_slot(&slot)) {
+            if (output_queue_full()) {
+                // Output task is behind; leave the slot in the ring until it pops a keyframe
+                hdr->muscle_flags &= ~SHARED_FLAG_NOTIFY_SUPPRESS;
+                break;
+            }
+            processed += drain_streaming_run(hdr, &read_idx);
             continue;
         }
 
-        uint32_t slot = shared_buffer_slot_index(read_idx);
-        const PosePacket31 *pkt = 
-            (const PosePacket31 *)g_shared_buf->packets[slot];
+        // Scheduled slots are queued at once and wait for their deadline in the output
+        // queue. Deadlines implausibly far ahead mean the clocks disagree, so play them now.
+        uint64_t exec_at = slot.exec_at_us;
+        uint64_t now = timebase_shared_us();
+        if (exec_at > now && exec_at - now > SHARED_EXEC_MAX_LEAD_US) {
+            exec_at = 0;
+        }
+
+        const PosePacket31 *pkt = &slot.pkt;
+        trace_point(SHARED_TRACE_MUSCLE_DEQUEUED, pkt->seq, read_idx);
         
-        if (validate_packet(pkt) == 0) {
+        int err = validate_packet(pkt);
+        if (err == 0) {
+            trace_point(SHARED_TRACE_MUSCLE_VALIDATED, pkt->seq, 0);
             watchdog_feed();  // Feed watchdog on valid packet
             
             if (pkt->flags & FLAG_ESTOP) {
+                latch_estop();
                 handle_estop();
             } else {
-                apply_servo_values(pkt);
+                if (set_output_target(pkt, exec_at) != 0) {
+                    // Output task is behind; leave the slot in the ring until it pops a keyframe
+                    hdr->muscle_flags &= ~SHARED_FLAG_NOTIFY_SUPPRESS;
+                    break;
+                }
                 g_last_seq = pkt->seq;
                 g_rx_count++;
                 processed++;
             }
+            ack_packet(pkt->seq, SHARED_ACK_OK, read_idx);
+        } else {
+            ack_packet(err != -1 ? pkt->seq : 0, (uint8_t)-err, read_idx);
         }
         
+        // Release: our reads of the slot complete before the Brain may reuse it
         read_idx++;
-        g_shared_buf->read_idx = read_idx;
-        __asm volatile ("fence rw, rw" ::: "memory");
+        SHARED_STORE_RELEASE(&hdr->read_idx, read_idx);
     }
 
+    g_read_idx = read_idx;
     return processed;
 }
 
-void mailbox_cmd_handler(uint8_t cmd_id, uint32_t param) {
-    (void)param;
+/**
+ * NACK everything the Brain has queued while E-STOP holds, so pending
+ * trajectory segments are dropped at once rather than left in the ring
+ * (and the Brain's flow control sees its credit back).
+ */
+static void flush_shared_buffer_packets(void) {
+    if (shared_ring_attach() != 0) {
+        return;
+    }
+    volatile SharedRingHeader *hdr = g_shared_hdr;
+    
+    uint32_t read_idx = g_read_idx;
+    uint32_t write_idx = SHARED_LOAD_ACQUIRE(&hdr->write_idx);
+    while (read_idx != write_idx) {
+        SharedRingSlot slot;
+        if (read_ring_slot(hdr, read_idx, &slot) != 0) {
+            read_idx = skip_overrun(hdr, read_idx);
+            write_idx = g_write_cache;
+            continue;
+        }
+        ack_packet(slot.pkt.seq, SHARED_NACK_ESTOP, read_idx);
+        read_idx++;
+    }
+    SHARED_STORE_RELEASE(&hdr->read_idx, read_idx);
     
+    g_read_idx = read_idx;
+    g_write_cache = read_idx;
+}
+
+static void notify_task_from_isr(TaskHandle_t task, uint32_t bits) {
+    if (task == NULL) {
+        return;
+    }
+    BaseType_t woken = pdFALSE;
+    xTaskNotifyFromISR(task, bits, eSetBits, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+static void notify_motion_task_from_isr(uint32_t bits) {
+    notify_task_from_isr(g_motion_task, bits);
+}
+
+/**
+ * Latch E-STOP from interrupt context so no further packet is applied. The
+ * output task stops the servos ahead of everything else; the motion task
+ * flushes the ring behind it and raises SHARED_FLAG_ESTOP for the Brain.
+ */
+static void latch_estop_from_isr(void) {
+    UBaseType_t state = taskENTER_CRITICAL_FROM_ISR();
+    g_estop_active = 1;
+    g_estop_rx_us = timebase_shared_us();
+    uint32_t count = ++g_estop_count;
+    taskEXIT_CRITICAL_FROM_ISR(state);
+    trace_point_from_isr(SHARED_TRACE_ESTOP_RECEIVED, count, 0);
+    notify_task_from_isr(g_output_task, OUTPUT_NOTIFY_ESTOP);
+    notify_motion_task_from_isr(MOTION_NOTIFY_ESTOP);
+}
+
+/**
+ * E-STOP input edge (interrupt context): the same latch as CMD_ESTOP,
+ * with neither Linux nor the mailbox in the path.
+ */
+static void on_estop_input(void) {
+    event_log_from_isr(SHARED_LOG_EVT_ESTOP_INPUT, 0, 0, 0, 0);
+    latch_estop_from_isr();
+}
+
+/**
+ * E-STOP input without its interrupt: the output task samples the line
+ * every ESTOP_INPUT_POLL_MS, parked or not, and latches on the rising
+ * level. Output task only.
+ */
+static void poll_estop_input(void) {
+    int level = estop_input_asserted();
+    if (level && !g_estop_input_level) {
+        event_log(SHARED_LOG_EVT_ESTOP_INPUT, 0, 0, 0, 0);
+        latch_estop();
+        xTaskNotify(g_motion_task, MOTION_NOTIFY_ESTOP, eSetBits);
+    }
+    g_estop_input_level = level;
+}
+
+/**
+ * Mailbox callback (interrupt context). Only latches work for the motion
+ * task: ring draining and CRC checks happen there, I2C output on the
+ * output task, and logging is a binary record, so this returns in
+ * microseconds and a heartbeat never waits behind an I2C burst.
+ */
+void mailbox_cmd_handler(uint8_t cmd_id, uint32_t param) {
     switch (cmd_id) {
     case CMD_HEARTBEAT:
-        handle_heartbeat();
+        watchdog_feed_from_isr();
         break;
         
     case CMD_MOTION_PACKET:
-        if (!g_estop_active) {
-            int n = process_shared_buffer_packets();
-            if (n > 0) {
-                printf("[Spider] Processed %d motion packets\n", n);
-            }
-        }
+        trace_point_from_isr(SHARED_TRACE_MUSCLE_NOTIFIED, param, 0);
+        notify_motion_task_from_isr(MOTION_NOTIFY_PACKET);
         break;
         
     case CMD_ESTOP:
-        handle_estop();
+        latch_estop_from_isr();
+        break;
+        
+    case CMD_PING:
+        // Stamp arrival here; the answer is written at task level like any other work
+        g_ping_rx_us = timebase_shared_us();
+        g_ping_seq = param;
+        notify_motion_task_from_isr(MOTION_NOTIFY_PING);
         break;
         
     default:
-        printf("[Spider] Unknown cmd: 0x%02X\n", cmd_id);
+        g_unknown_cmd_count++;
+        event_log_from_isr(SHARED_LOG_EVT_UNKNOWN_CMD, cmd_id, g_unknown_cmd_count, 0, 0);
         break;
     }
 }
@@ -196,72 +762,353 @@ static void motion_task_entry(void *pvParameters) {
     
     printf("[Spider] Motion task started\n");
     
-    PosePacket31 pkt;
     TickType_t last_status_time = xTaskGetTickCount();
     
     while (1) {
-        if (xQueueReceive(g_motion_queue, &pkt, pdMS_TO_TICKS(100)) == pdTRUE) {
-            if (g_estop_active) {
-                continue;
-            }
-            
-            if (validate_packet(&pkt) == 0) {
-                if (pkt.flags & FLAG_ESTOP) {
-                    handle_estop();
-                } else {
-                    apply_servo_values(&pkt);
-                    g_last_seq = pkt.seq;
-                    g_rx_count++;
-                }
-            }
+        // Attached, only a notification wakes us: the ring handshake re-checks write_idx
+        // after clearing SHARED_FLAG_NOTIFY_SUPPRESS, so no batch is left without one, and
+        // slots left behind a full output queue are resumed when the output task pops
+        TickType_t wait = (g_shared_hdr != NULL) ? portMAX_DELAY : pdMS_TO_TICKS(MOTION_ATTACH_POLL_MS);
+
+        uint32_t bits = 0;
+        xTaskNotifyWait(0, 0xFFFFFFFFUL, &bits, wait);
+
+        if (bits & MOTION_NOTIFY_ESTOP) {
+            handle_estop();
         }
         
+        if (bits & MOTION_NOTIFY_PING) {
+            taskENTER_CRITICAL();
+            uint32_t seq = g_ping_seq;
+            uint64_t rx_us = g_ping_rx_us;
+            taskEXIT_CRITICAL();
+            shared_probe_answer(shared_probe_area((volatile void *)SHARED_MEM_BASE), seq,
+                                rx_us, timebase_shared_us());
+        }
+        
+        // A notification or a due slot
+        uint32_t pass_start = load_cycles();
+        uint32_t read_before = g_read_idx;
         if (!g_estop_active) {
             int n = process_shared_buffer_packets();
             (void)n;
+        } else {
+            flush_shared_buffer_packets();
+        }
+        if (g_read_idx != read_before) {
+            wake_output_task();
         }
+        load_monitor_record(SHARED_LOAD_STAGE_MOTION, load_cycles() - pass_start);
+        load_monitor_check_stack(SHARED_LOAD_TASK_MOTION);
         
         TickType_t now = xTaskGetTickCount();
         if ((now - last_status_time) >= pdMS_TO_TICKS(5000)) {
-            printf("[Spider] Status: rx=%lu drop=%lu seq=%lu estop=%d\n",
-                   (unsigned long)g_rx_count, 
-                   (unsigned long)g_drop_count,
-                   (unsigned long)g_last_seq,
-                   g_estop_active);
+            event_log(SHARED_LOG_EVT_STATUS, g_rx_count, g_drop_count, g_last_seq,
+                      (uint32_t)g_estop_active);
             last_status_time = now;
         }
     }
 }
 
+/**
+ * Take a newly published tunables set between two ticks, before anything
+ * of the next one is computed. The whole set applies at once, so the
+ * period, the substep grid and the jitter reference always agree. The
+ * period is whole milliseconds: the rate reported back is the one that
+ * gives. Output task only.
+ */
+static void output_poll_tunables(volatile SharedTunables *tun) {
+    SharedTunablesData d;
+    if (!shared_tunables_poll(tun, &g_tunables_gen, &d)) {
+        return;
+    }
+    
+    uint32_t clamped = shared_tunables_clamp(&d);
+    uint32_t period_ms = 1000 / d.output_hz;
+    d.output_hz = 1000 / period_ms;
+    
+    g_output_period_ms = period_ms;
+    interpolator_set_tick_us(period_ms * 1000);
+    interpolator_set_substeps((uint8_t)d.interp_substeps);
+    load_monitor_set_nominal_period(period_ms * 1000);
+    watchdog_set_timeout_ms(d.heartbeat_timeout_ms);
+    g_tunables = d;
+    
+    shared_tunables_report(tun, g_tunables_gen, &d, clamped);
+    event_log(SHARED_LOG_EVT_TUNABLES, g_tunables_gen, d.output_hz, d.interp_substeps,
+              d.heartbeat_timeout_ms);
+}
+
+/**
+ * Publish this tick's state to the shared telemetry block. The counters
+ * are written by other tasks; a slightly stale value is fine here.
+ */
+static void publish_telemetry(volatile SharedTelemetry *telem, SharedTelemetryData *d,
+                              const uint16_t *output, uint64_t start_us, uint32_t period_us) {
+    uint32_t work_us = (uint32_t)(timebase_shared_us() - start_us);
+
+    int roll = (g_window_ticks == 0);
+    if (++g_window_ticks >= g_tunables.output_hz) {
+        g_window_ticks = 0;
+    }
+    if (roll) {
+        d->tick_period_max_us = 0;
+        d->tick_work_max_us = 0;
+    }
+    load_monitor_tick_period(period_us);
+    load_monitor_publish(d, roll);
+    d->ticks++;
+    d->time_us = start_us;
+    d->rx_count = g_rx_count;
+    d->drop_count = g_drop_count;
+    d->skip_count = g_skip_count;
+    d->overrun_count = g_overrun_count;
+    d->last_seq = g_last_seq;
+    d->fault_flags = fault_flags_get_all();
+    d->unknown_cmds = g_unknown_cmd_count;
+    d->tick_period_us = period_us;
+    d->tick_work_us = work_us;
+    if (period_us > d->tick_period_max_us) d->tick_period_max_us = period_us;
+    if (work_us > d->tick_work_max_us) d->tick_work_max_us = work_us;
+    d->watchdog_state = (uint8_t)watchdog_get_state();
+    d->estop = (uint8_t)(g_estop_active != 0);
+    d->interp_active = (uint8_t)!interpolator_is_idle();
+    memcpy(d->servo_us, output, sizeof(d->servo_us));
+
+    shared_telemetry_write(telem, d);
+}
+
+/**
+ * Roll the telemetry window as the output task parks, so the load
+ * figures cover the motion that just ended instead of freezing part way
+ * through a window. Nothing to do if the last tick already rolled.
+ */
+static void close_telemetry_window(volatile SharedTelemetry *telem, SharedTelemetryData *d) {
+    if (g_window_ticks == 1) {
+        return;
+    }
+    load_monitor_publish(d, 1);
+    d->tick_period_max_us = 0;
+    d->tick_work_max_us = 0;
+    g_window_ticks = 1;         // The next roll is a full window after the wake
+    shared_telemetry_write(telem, d);
+}
+
+/**
+ * E-STOP on the output task: drop the queued keyframes, cancel the
+ * running segment and enter the failsafe E-STOP state, which drives
+ * every channel neutral in one ALL_LED write. Records how long after
+ * the latch the servos were stopped.
+ */
+static void output_estop(uint16_t *output) {
+    flush_output_targets();
+    for (int ch = 0; ch < SERVO_CHANNEL_COUNT; ch++) {
+        output[ch] = SERVO_PWM_NEUTRAL_US;
+    }
+    interpolator_reset(output);
+    failsafe_enter_estop();
+    
+    taskENTER_CRITICAL();
+    uint32_t count = g_estop_count;
+    uint64_t rx_us = g_estop_rx_us;
+    taskEXIT_CRITICAL();
+    uint64_t now = timebase_shared_us();
+    trace_point(SHARED_TRACE_ESTOP_STOPPED, count, (uint32_t)(now > rx_us ? now - rx_us : 0));
+}
+
+/**
+ * Fixed-rate servo output. Feeds keyframes from the motion task to the
+ * interpolator and hands each tick's output to pca9685_update_us(), so
+ * only channels that moved reach the I2C bus. The Brain only has to send
+ * keyframes; the smoothness of the motion comes from here. Each tick
+ * also refreshes the shared telemetry block. With nothing to play the
+ * task parks instead of ticking (see output_try_park()).
+ */
+static void output_task_entry(void *pvParameters) {
+    (void)pvParameters;
+    
+    uint16_t output[SERVO_CHANNEL_COUNT];
+    for (int ch = 0; ch < SERVO_CHANNEL_COUNT; ch++) {
+        output[ch] = SERVO_PWM_NEUTRAL_US;
+    }
+    
+    interpolator_set_tick_us(g_output_period_ms * 1000);
+    interpolator_set_substeps((uint8_t)g_tunables.interp_substeps);
+    interpolator_reset(output);
+    printf("[Spider] Output task started (%lu Hz, %lu substeps)\n",
+           (unsigned long)g_tunables.output_hz, (unsigned long)g_tunables.interp_substeps);
+    
+    volatile SharedTunables *tun = shared_tunables_area((volatile void *)SHARED_MEM_BASE);
+    
+    volatile SharedTelemetry *telem = shared_telemetry_area((volatile void *)SHARED_MEM_BASE);
+    SharedTelemetryData telem_data;
+    memset(&telem_data, 0, sizeof(telem_data));
+    shared_telemetry_init(telem);
+    
+    uint64_t last_us = timebase_shared_us();
+    TickType_t next_wake = xTaskGetTickCount() + pdMS_TO_TICKS(g_output_period_ms);
+    
+    while (1) {
+        // Sleep to the next tick like vTaskDelayUntil(), unless an E-STOP cuts it short.
+        // Parked, nothing runs until a keyframe, an E-STOP, the watchdog or the deadline
+        // of a queued keyframe wakes us, or the E-STOP line is due to be sampled
+        TickType_t wait = next_wake - xTaskGetTickCount();
+        if ((int32_t)wait < 0) {
+            wait = 0;
+        }
+        uint64_t wake_at = 0;
+        int parked = (telem_data.ticks > 0) && output_try_park(&wake_at);
+        if (parked) {
+            close_telemetry_window(telem, &telem_data);
+            wait = portMAX_DELAY;
+            if (wake_at != 0) {
+                uint64_t now = timebase_shared_us();
+                wait = pdMS_TO_TICKS((uint32_t)((wake_at > now) ? (wake_at - now + 999) / 1000 : 0));
+            }
+        }
+        int poll_wake = 0;
+        if (g_estop_input_polled && wait > pdMS_TO_TICKS(ESTOP_INPUT_POLL_MS)) {
+            wait = pdMS_TO_TICKS(ESTOP_INPUT_POLL_MS);
+            poll_wake = 1;
+        }
+        uint32_t bits = 0;
+        BaseType_t notified = xTaskNotifyWait(0, 0xFFFFFFFFUL, &bits, wait);
+        if (g_estop_input_polled) {
+            poll_estop_input();
+            if (parked && poll_wake && notified == pdFALSE && !g_estop_active) {
+                continue;       // Only the sampling woke us: stay parked
+            }
+        }
+        if (parked) {
+            // Tick at once, timed as if the previous tick was one period ago
+            g_output_parked = 0;
+            next_wake = xTaskGetTickCount();
+            last_us = timebase_shared_us() - OUTPUT_PERIOD_US;
+        }
+        if (bits & OUTPUT_NOTIFY_ESTOP) {
+            output_estop(output);
+        }
+        if ((int32_t)(next_wake - xTaskGetTickCount()) > 0) {
+            continue;
+        }
+        output_poll_tunables(tun);
+        next_wake += pdMS_TO_TICKS(g_output_period_ms);
+        
+        uint32_t tick_start = load_cycles();
+        uint64_t now = timebase_shared_us();
+        uint64_t elapsed = now - last_us;
+        uint32_t period_us = (uint32_t)elapsed;
+        last_us = now;
+        
+        // Safety paths have already driven the servos neutral; track that and stay off the bus
+        if (g_estop_active || !watchdog_is_motion_allowed()) {
+            flush_output_targets();
+            for (int ch = 0; ch < SERVO_CHANNEL_COUNT; ch++) {
+                output[ch] = SERVO_PWM_NEUTRAL_US;
+            }
+            interpolator_reset(output);
+            publish_telemetry(telem, &telem_data, output, now, period_us);
+            continue;
+        }
+        
+        // Immediate keyframes restart their groups' timelines; scheduled ones queue behind
+        // the running segments once within the lookahead, or wait for their start time when
+        // those are idle. Each group is timed from when its own segment started
+        uint32_t group_elapsed[SERVO_GROUP_COUNT];
+        for (int g = 0; g < SERVO_GROUP_COUNT; g++) {
+            group_elapsed[g] = (uint32_t)elapsed;
+        }
+        OutputTarget target;
+        uint32_t started_seq = 0;
+        while (peek_output_target(&target) == 0) {
+            uint32_t since = (uint32_t)(now - target.at_us);
+            if (!target.scheduled) {
+                interpolator_start_groups(output, target.servo_us, target.t_ms, target.mode,
+                                          target.groups);
+                for (int g = 0; g < SERVO_GROUP_COUNT; g++) {
+                    if (target.groups & (1u << g)) group_elapsed[g] = since;
+                }
+            } else {
+                if (target.at_us > now + KEYFRAME_LOOKAHEAD_US) {
+                    break;
+                }
+                uint8_t idle = 0;
+                for (int g = 0; g < SERVO_GROUP_COUNT; g++) {
+                    uint8_t bit = (uint8_t)(1u << g);
+                    if ((target.groups & bit) && interpolator_is_idle_groups(bit)) idle |= bit;
+                }
+                if ((idle && target.at_us > now) ||
+                    !interpolator_push_groups(target.servo_us, target.t_ms, target.groups)) {
+                    break;
+                }
+                // A keyframe that arrived late starts now rather than skipping ahead
+                for (int g = 0; g < SERVO_GROUP_COUNT; g++) {
+                    if ((idle & (1u << g)) && since < group_elapsed[g]) {
+                        group_elapsed[g] = since;
+                    }
+                }
+            }
+            pop_output_target();
+            trace_point(SHARED_TRACE_OUTPUT_STARTED, target.seq, target.scheduled);
+            started_seq = target.seq;
+        }
+        
+        interpolator_advance_groups(output, group_elapsed);
+        
+        // Latched while this tick was computed: the E-STOP lane runs next, with nothing after it
+        if (g_estop_active) {
+            continue;
+        }
+        
+        // The driver skips channels whose tick did not change
+        uint32_t i2c_start = load_cycles();
+        pca9685_update_us(output, SERVO_CHANNEL_COUNT);
+        load_monitor_record(SHARED_LOAD_STAGE_I2C, load_cycles() - i2c_start);
+        if (started_seq != 0) {
+            trace_point(SHARED_TRACE_I2C_DONE, started_seq, 0);
+        }
+        
+        load_monitor_record(SHARED_LOAD_STAGE_TICK, load_cycles() - tick_start);
+        load_monitor_check_stack(SHARED_LOAD_TASK_OUTPUT);
+        publish_telemetry(telem, &telem_data, output, now, period_us);
+    }
+}
+
 void main_cvirtos(void) {
     printf("[Spider] ================================\n");
     printf("[Spider] Muscle Runtime v3.1 Starting\n");
     printf("[Spider] ================================\n");
     
     fault_flags_init();
+    event_log_init();
+    trace_init();
+    for (int ch = 0; ch < SERVO_CHANNEL_COUNT; ch++) {
+        g_target_us[ch] = SERVO_PWM_NEUTRAL_US;
+    }
+    g_ack = shared_ack_area((volatile void *)SHARED_MEM_BASE);
+    shared_ack_init(g_ack);
+    cache_clean_range(g_ack, SHARED_ACK_AREA_SIZE);
+    shared_tunables_defaults(&g_tunables);
+    shared_tunables_init(shared_tunables_area((volatile void *)SHARED_MEM_BASE), &g_tunables);
     
     if (pca9685_init(PCA9685_I2C_ADDR_DEFAULT) != 0) {
         printf("[Spider] ERROR: PCA9685 init failed!\n");
         fault_flags_set(FAULT_PCA9685_INIT);
     } else {
-        printf("[Spider] PCA9685 initialized at 50Hz\n");
+        printf("[Spider] PCA9685 initialized at 50Hz (I2C %lu kHz)\n",
+               (unsigned long)(i2c_hal_get_speed() / 1000));
         set_all_servos_neutral();
         printf("[Spider] All servos set to neutral (%d us)\n", SERVO_PWM_NEUTRAL_US);
     }
     
-    g_shared_buf = (volatile SharedMotionBuffer *)SHARED_MEM_BASE;
-    g_shared_buf->read_idx = 0;
-    g_shared_buf->flags |= SHARED_FLAG_MUSCLE_READY;
-    __asm volatile ("fence rw, rw" ::: "memory");
-    printf("[Spider] Shared memory at 0x%08lX ready\n", (unsigned long)SHARED_MEM_BASE);
-    
-    g_motion_queue = xQueueCreate(MOTION_QUEUE_LENGTH, sizeof(PosePacket31));
-    if (g_motion_queue == NULL) {
-        printf("[Spider] ERROR: Failed to create motion queue!\n");
-        fault_flags_set(FAULT_QUEUE_CREATE);
-        return;
+    // The Brain owns the header; attach now if it is already up, else on first packet
+    if (shared_ring_attach() == 0) {
+        printf("[Spider] Shared memory at 0x%08lX ready\n", (unsigned long)SHARED_MEM_BASE);
+    } else {
+        printf("[Spider] Shared memory at 0x%08lX waiting for Brain layout v%d.%d\n",
+               (unsigned long)SHARED_MEM_BASE,
+               SHARED_LAYOUT_VERSION >> 8, SHARED_LAYOUT_VERSION & 0xFF);
     }
-    printf("[Spider] Motion queue created\n");
     
     BaseType_t ret = xTaskCreate(
         motion_task_entry,
@@ -269,7 +1116,7 @@ void main_cvirtos(void) {
         MOTION_TASK_STACK,
         NULL,
         MOTION_TASK_PRIORITY,
-        NULL
+        &g_motion_task
     );
     
     if (ret != pdPASS) {
@@ -280,6 +1127,40 @@ void main_cvirtos(void) {
     
     printf("[Spider] Motion task created\n");
     
+    ret = xTaskCreate(
+        output_task_entry,
+        "servo_out",
+        OUTPUT_TASK_STACK,
+        NULL,
+        OUTPUT_TASK_PRIORITY,
+        &g_output_task
+    );
+    
+    if (ret != pdPASS) {
+        printf("[Spider] ERROR: Failed to create output task!\n");
+        fault_flags_set(FAULT_QUEUE_CREATE);
+        return;
+    }
+    
+    printf("[Spider] Output task created\n");
+    
+    // The E-STOP switch needs neither Linux nor the Brain
+    if (estop_input_init(on_estop_input) == 0) {
+        printf("[Spider] E-STOP input armed\n");
+    } else {
+        printf("[Spider] WARNING: E-STOP input interrupt unavailable, polling every %d ms\n",
+               ESTOP_INPUT_POLL_MS);
+        fault_flags_set(FAULT_ESTOP_INPUT_POLLED);
+        g_estop_input_polled = 1;
+    }
+    if (estop_input_asserted()) {
+        g_estop_input_level = 1;
+        printf("[Spider] E-STOP input asserted at boot\n");
+        event_log(SHARED_LOG_EVT_ESTOP_INPUT, 1, 0, 0, 0);
+        latch_estop();
+        xTaskNotify(g_motion_task, MOTION_NOTIFY_ESTOP, eSetBits);
+    }
+    
     // Initialize and start watchdog
     watchdog_init(on_watchdog_timeout, on_watchdog_estop);
     if (watchdog_task_create() == 0) {
@@ -288,6 +1169,10 @@ void main_cvirtos(void) {
         printf("[Spider] WARNING: Watchdog task creation failed!\n");
     }
     
+    if (event_log_task_create() != 0) {
+        printf("[Spider] WARNING: Event log task creation failed!\n");
+    }
+    
     printf("[Spider] Initialization complete!\n");
     printf("[Spider] Waiting for Brain commands...\n");
 }
@@ -0,0 +1,39 @@
+#ifndef ESTOP_INPUT_H
+#define ESTOP_INPUT_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Hardware E-STOP input for Milk-V Duo FreeRTOS
+ *
+ * One GPIO line, owned by the small core, wired to a normally-closed
+ * E-STOP switch to GND with a pull-up: pressing the switch or a broken
+ * wire lets the line go high. The rising edge interrupts the small core
+ * directly, so a stop does not depend on the Brain, Linux or the mailbox.
+ */
+
+// Called from interrupt context on every assertion; must not block
+typedef void (*EstopInputHandler)(void);
+
+/**
+ * Configure the line as an input and enable its rising-edge interrupt.
+ * A line already high gives no edge: check estop_input_asserted() after.
+ * Returns 0 on success, -1 if the interrupt cannot be registered: the
+ * caller must then poll estop_input_asserted() for the rising level.
+ */
+int estop_input_init(EstopInputHandler on_assert);
+
+/**
+ * Current level of the line: 1 while the switch is open.
+ */
+int estop_input_asserted(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESTOP_INPUT_H
@@ -0,0 +1,98 @@
+/**
+ * E-STOP Input MMIO Driver for CV181x (Milk-V Duo 256M)
+ *
+ * Direct register access to a DesignWare APB GPIO bank - no SDK HAL
+ * dependency. By default PWR_GPIO[2] in the always-on domain, which
+ * Linux leaves alone; override ESTOP_GPIO_BASE, ESTOP_GPIO_PIN and
+ * ESTOP_GPIO_INTR for another line. Linux must not claim the line.
+ *
+ * The line is edge-triggered on its rising edge without the bank's
+ * debounce, which would delay the stop by milliseconds: an E-STOP
+ * latches, so contact bounce only repeats an assertion.
+ */
+
+#include <stdint.h>
+#include "estop_input.h"
+
+/* SDK interrupt API - declared manually to avoid include issues */
+typedef int (*irq_handler_t)(int irqn, void *priv);
+extern int request_irq(uint32_t irqn, irq_handler_t handler, uint32_t flags,
+                       const char *name, void *priv);
+
+#ifndef ESTOP_GPIO_BASE
+#define ESTOP_GPIO_BASE     0x05021000UL    // PWR_GPIO (RTC domain)
+#endif
+#ifndef ESTOP_GPIO_PIN
+#define ESTOP_GPIO_PIN      2
+#endif
+
+// PLIC source for the bank (CV180x interrupt table); override if the SDK numbers differ
+#ifndef ESTOP_GPIO_INTR
+#define ESTOP_GPIO_INTR     70
+#endif
+
+#define GPIO_SWPORTA_DDR    0x04
+#define GPIO_INTEN          0x30
+#define GPIO_INTMASK        0x34
+#define GPIO_INTTYPE_LEVEL  0x38    // 1 = edge
+#define GPIO_INT_POLARITY   0x3C    // 1 = rising edge / active high
+#define GPIO_INTSTATUS      0x40
+#define GPIO_DEBOUNCE       0x48
+#define GPIO_PORTA_EOI      0x4C
+#define GPIO_EXT_PORTA      0x50
+
+#define ESTOP_BIT           (1UL << ESTOP_GPIO_PIN)
+
+static EstopInputHandler s_handler = 0;
+
+static inline void mmio_write(uint32_t offset, uint32_t value) {
+    *(volatile uint32_t *)(ESTOP_GPIO_BASE + offset) = value;
+    __asm__ __volatile__("fence w,o" ::: "memory");
+}
+
+static inline uint32_t mmio_read(uint32_t offset) {
+    __asm__ __volatile__("fence i,r" ::: "memory");
+    return *(volatile uint32_t *)(ESTOP_GPIO_BASE + offset);
+}
+
+// Only our bit: other lines of the bank keep their configuration
+static void mmio_update(uint32_t offset, uint32_t set) {
+    uint32_t v = mmio_read(offset);
+    mmio_write(offset, set ? (v | ESTOP_BIT) : (v & ~ESTOP_BIT));
+}
+
+static int estop_irq_handler(int irqn, void *priv) {
+    (void)irqn;
+    (void)priv;
+
+    if (mmio_read(GPIO_INTSTATUS) & ESTOP_BIT) {
+        mmio_write(GPIO_PORTA_EOI, ESTOP_BIT);
+        if (s_handler) {
+            s_handler();
+        }
+    }
+    return 0;
+}
+
+int estop_input_init(EstopInputHandler on_assert) {
+    s_handler = on_assert;
+
+    mmio_update(GPIO_INTEN, 0);
+    mmio_update(GPIO_SWPORTA_DDR, 0);       // Input
+    mmio_update(GPIO_DEBOUNCE, 0);
+    mmio_update(GPIO_INTTYPE_LEVEL, 1);
+    mmio_update(GPIO_INT_POLARITY, 1);
+    mmio_write(GPIO_PORTA_EOI, ESTOP_BIT);  // Drop an edge latched before setup
+    mmio_update(GPIO_INTMASK, 0);
+
+    int ret = (request_irq(ESTOP_GPIO_INTR, estop_irq_handler, 0, "estop", 0) == 0) ? 0 : -1;
+    if (ret == 0) {
+        mmio_update(GPIO_INTEN, 1);
+    }
+
+    return ret;
+}
+
+int estop_input_asserted(void) {
+    return (mmio_read(GPIO_EXT_PORTA) & ESTOP_BIT) ? 1 : 0;
+}
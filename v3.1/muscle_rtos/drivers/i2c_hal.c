@@ -19,16 +19,34 @@ extern int hal_i2c_read(uint8_t i2c_id, uint8_t dev, uint16_t addr, uint16_t ale
 
 static uint8_t s_initialized = 0;
 
-int i2c_hal_init(void) {
+// The SDK driver sets its own bus timing; the speed is only reported back
+static uint32_t s_bus_hz = I2C_HAL_SPEED_STANDARD;
+
+int i2c_hal_init(uint32_t bus_hz) {
     if (s_initialized) {
         return 0;
     }
 
     hal_i2c_init(I2C_BUS_ID);
+    s_bus_hz = bus_hz;
     s_initialized = 1;
     return 0;
 }
 
+int i2c_hal_set_speed(uint32_t bus_hz) {
+    s_bus_hz = bus_hz;
+    return 0;
+}
+
+uint32_t i2c_hal_get_speed(void) {
+    return s_bus_hz;
+}
+
+uint32_t i2c_hal_self_test(uint8_t dev_addr, uint8_t reg) {
+    uint8_t value;
+    return (i2c_hal_read_reg(dev_addr, reg, &value, 1) == 0) ? s_bus_hz : 0;
+}
+
 int i2c_hal_write_reg(uint8_t dev_addr, uint8_t reg, uint8_t value) {
     return hal_i2c_write(I2C_BUS_ID, dev_addr, reg, 1, &value, 1);
 }
@@ -37,6 +55,15 @@ int i2c_hal_write_buf(uint8_t dev_addr, uint8_t reg, const uint8_t *data, size_t
     return hal_i2c_write(I2C_BUS_ID, dev_addr, reg, 1, (uint8_t *)data, (uint16_t)len);
 }
 
+// The SDK driver is blocking; async writes complete before returning
+int i2c_hal_write_buf_async(uint8_t dev_addr, uint8_t reg, const uint8_t *data, size_t len) {
+    return i2c_hal_write_buf(dev_addr, reg, data, len);
+}
+
+int i2c_hal_flush(void) {
+    return 0;
+}
+
 int i2c_hal_read_reg(uint8_t dev_addr, uint8_t reg, uint8_t *value, size_t len) {
     return hal_i2c_read(I2C_BUS_ID, dev_addr, reg, 1, value, (uint16_t)len);
 }
@@ -14,11 +14,31 @@ extern "C" {
  * Wraps platform-specific I2C driver (cv180x I2C peripheral).
  */
 
+// Bus speeds (Hz); the PCA9685 supports Fast-mode Plus
+#define I2C_HAL_SPEED_STANDARD   100000
+#define I2C_HAL_SPEED_FAST       400000
+#define I2C_HAL_SPEED_FAST_PLUS  1000000
+
 /**
- * Initialize I2C peripheral (I2C1 on Milk-V Duo).
+ * Initialize I2C peripheral (I2C1 on Milk-V Duo) at bus_hz, rounded
+ * down to one of the I2C_HAL_SPEED_* modes.
  * Returns 0 on success.
  */
-int i2c_hal_init(void);
+int i2c_hal_init(uint32_t bus_hz);
+
+/**
+ * Change the bus speed (same rounding as i2c_hal_init()).
+ */
+int i2c_hal_set_speed(uint32_t bus_hz);
+
+uint32_t i2c_hal_get_speed(void);
+
+/**
+ * Read reg from dev_addr a few times at the current speed, stepping down
+ * a mode each time a transfer aborts or times out. Returns the speed that
+ * worked, or 0 if the device does not respond even in standard mode.
+ */
+uint32_t i2c_hal_self_test(uint8_t dev_addr, uint8_t reg);
 
 /**
  * Write a single register value.
@@ -30,6 +50,25 @@ int i2c_hal_write_reg(uint8_t addr, uint8_t reg, uint8_t value);
  */
 int i2c_hal_write_buf(uint8_t addr, uint8_t reg, const uint8_t *data, size_t len);
 
+/**
+ * Largest write i2c_hal_write_buf_async() accepts (all 16 PCA9685 channels).
+ */
+#define I2C_HAL_ASYNC_MAX  64
+
+/**
+ * Start a write and return without waiting for it to finish; data is
+ * copied. The next transfer waits for the bus, so ordering is kept.
+ * Falls back to a blocking write where there is no interrupt support.
+ * Returns 0 if the write was started.
+ */
+int i2c_hal_write_buf_async(uint8_t addr, uint8_t reg, const uint8_t *data, size_t len);
+
+/**
+ * Wait for any async write in flight and return the result of the last
+ * one that failed since the previous call (0 = all OK).
+ */
+int i2c_hal_flush(void);
+
 /**
  * Read registers into buffer.
  */
@@ -5,12 +5,24 @@
  * Uses DesignWare I2C controller at I2C1 (0x04010000).
  * 
  * Pins: GP4 = I2C1_SCL, GP5 = I2C1_SDA
+ *
+ * Once the scheduler runs, writes are interrupt-driven: the ISR refills
+ * the TX FIFO on TX_EMPTY and completes on STOP_DET or TX_ABRT, while
+ * the caller sleeps on a task notification. Before that (init) and if
+ * the IRQ cannot be registered, transfers fall back to polling.
  */
 
 #include <stdint.h>
+#include <string.h>
 #include "i2c_hal.h"
 #include "FreeRTOS.h"
 #include "task.h"
+#include "semphr.h"
+
+/* SDK interrupt API - declared manually to avoid include issues */
+typedef int (*irq_handler_t)(int irqn, void *priv);
+extern int request_irq(uint32_t irqn, irq_handler_t handler, uint32_t flags,
+                       const char *name, void *priv);
 
 #define I2C1_BASE       0x04010000UL
 
@@ -28,6 +40,7 @@
 #define IC_TX_TL        0x3C
 #define IC_CLR_INTR     0x40
 #define IC_CLR_TX_ABRT  0x54
+#define IC_CLR_STOP_DET 0x60
 #define IC_ENABLE       0x6C
 #define IC_STATUS       0x70
 #define IC_TXFLR        0x74
@@ -52,6 +65,11 @@
 
 #define IC_RAW_TX_ABRT          (1 << 6)
 
+// IC_INTR_MASK / IC_INTR_STAT bits
+#define IC_INTR_TX_EMPTY        (1 << 4)
+#define IC_INTR_TX_ABRT         (1 << 6)
+#define IC_INTR_STOP_DET        (1 << 9)
+
 #define PINMUX_BASE         0x03001000UL
 #define GP4_PINMUX_OFFSET   0x0E0
 #define GP5_PINMUX_OFFSET   0x0E4
@@ -61,10 +79,42 @@
 #define CLK_DIV_BASE        0x03002000UL
 #define CLK_I2C1_DIV_OFFSET 0x80
 
+// div_clk_i2c: FPLL divided by [20:16] when bit 3 selects the register factor
+#define CLK_I2C_SRC_HZ      1500000000UL
+#define CLK_I2C_DIV_DEFAULT 15              // 100 MHz
+#define CLK_DIV_SEL_REG     (1 << 3)
+#define CLK_DIV_FACTOR(r)   (((r) >> 16) & 0x1F)
+
 #define I2C_TIMEOUT_MS      100
 
+// PLIC source for I2C1 (CV180x interrupt table); override if the SDK numbers differ
+#ifndef I2C1_INTR
+#define I2C1_INTR           50
+#endif
+
+// TX_EMPTY fires at or below this FIFO level, leaving time to refill before the bus idles
+#define I2C_TX_THRESHOLD    4
+
+// Completion bit in the caller's task notification value
+#define I2C_NOTIFY_DONE     (1UL << 31)
+
+#define XFER_BUSY           1
+
+typedef struct {
+    uint8_t buf[I2C_HAL_ASYNC_MAX + 1];  // Register address, then data
+    size_t len;
+    size_t pos;                          // Bytes queued to the FIFO
+    volatile int status;                 // XFER_BUSY, 0 = done, <0 = error
+    TaskHandle_t waiter;                 // NULL for async writes
+} I2cXfer;
+
 static volatile uint32_t *i2c_base = (volatile uint32_t *)I2C1_BASE;
 static uint8_t s_initialized = 0;
+static uint32_t s_bus_hz = 0;
+static uint8_t s_irq_ready = 0;
+static SemaphoreHandle_t s_bus = NULL;   // Given back by the ISR when an async write ends
+static I2cXfer s_xfer;
+static volatile int s_async_result = 0;
 
 static inline void mmio_write(uint32_t offset, uint32_t value) {
     *(volatile uint32_t *)(I2C1_BASE + offset) = value;
@@ -81,6 +131,34 @@ static inline void pinmux_write(uint32_t offset, uint32_t value) {
     __asm__ __volatile__("fence w,o" ::: "memory");
 }
 
+static inline uint32_t clkgen_read(uint32_t offset) {
+    __asm__ __volatile__("fence i,r" ::: "memory");
+    return *(volatile uint32_t *)(CLK_DIV_BASE + offset);
+}
+
+// Controller input clock in kHz, from the divider the boot firmware programmed
+static uint32_t i2c_clk_khz(void) {
+    uint32_t reg = clkgen_read(CLK_I2C1_DIV_OFFSET);
+    uint32_t div = (reg & CLK_DIV_SEL_REG) ? CLK_DIV_FACTOR(reg) : CLK_I2C_DIV_DEFAULT;
+    if (div == 0) {
+        div = CLK_I2C_DIV_DEFAULT;
+    }
+    return (uint32_t)(CLK_I2C_SRC_HZ / div / 1000UL);
+}
+
+/**
+ * SCL high/low counts for the given tHIGH/tLOW and fall time (ns), as
+ * the DesignWare databook computes them: the controller adds its own
+ * sync cycles to HCNT, hence the offsets.
+ */
+static uint32_t scl_hcnt(uint32_t ic_clk_khz, uint32_t t_high_ns, uint32_t tf_ns) {
+    return (uint32_t)(((uint64_t)ic_clk_khz * (t_high_ns + tf_ns) + 500000) / 1000000) - 3;
+}
+
+static uint32_t scl_lcnt(uint32_t ic_clk_khz, uint32_t t_low_ns, uint32_t tf_ns) {
+    return (uint32_t)(((uint64_t)ic_clk_khz * (t_low_ns + tf_ns) + 500000) / 1000000) - 1;
+}
+
 static void i2c_disable(void) {
     int timeout = 100;
     mmio_write(IC_ENABLE, 0);
@@ -119,52 +197,151 @@ static int i2c_wait_tx_empty(void) {
     return 0;
 }
 
-int i2c_hal_init(void) {
-    if (s_initialized) {
+static int scheduler_running(void) {
+    return xTaskGetSchedulerState() == taskSCHEDULER_RUNNING;
+}
+
+static int bus_acquire(void) {
+    if (s_bus == NULL || !scheduler_running()) {
         return 0;
     }
+    if (xSemaphoreTake(s_bus, pdMS_TO_TICKS(I2C_TIMEOUT_MS)) == pdTRUE) {
+        return 0;
+    }
+    // An async write never completed: abort it and take the bus over
+    if (s_xfer.status == XFER_BUSY && s_xfer.waiter == NULL) {
+        taskENTER_CRITICAL();
+        mmio_write(IC_INTR_MASK, 0);
+        s_xfer.status = -1;
+        s_async_result = -1;
+        taskEXIT_CRITICAL();
+        i2c_disable();
+        i2c_enable();
+        return 0;
+    }
+    return -1;
+}
 
-    pinmux_write(GP4_PINMUX_OFFSET, FMUX_I2C1_SCL);
-    pinmux_write(GP5_PINMUX_OFFSET, FMUX_I2C1_SDA);
-
-    i2c_disable();
-
-    uint32_t con = IC_CON_MASTER_MODE | IC_CON_SPEED_FS |
-                   IC_CON_IC_RESTART_EN | IC_CON_IC_SLAVE_DISABLE;
-    mmio_write(IC_CON, con);
+static void bus_release(void) {
+    if (s_bus != NULL && scheduler_running()) {
+        xSemaphoreGive(s_bus);
+    }
+}
 
-    mmio_write(IC_FS_SCL_HCNT, 60);
-    mmio_write(IC_FS_SCL_LCNT, 130);
+// ISR side: the transfer ended with result
+static void xfer_finish_from_isr(int result, BaseType_t *woken) {
+    mmio_write(IC_INTR_MASK, 0);
+    s_xfer.status = result;
+    if (s_xfer.waiter != NULL) {
+        xTaskNotifyFromISR(s_xfer.waiter, I2C_NOTIFY_DONE, eSetBits, woken);
+    } else {
+        if (result != 0) {
+            s_async_result = result;
+        }
+        xSemaphoreGiveFromISR(s_bus, woken);
+    }
+}
 
-    mmio_write(IC_RX_TL, 0);
-    mmio_write(IC_TX_TL, 0);
+static int i2c_irq_handler(int irqn, void *priv) {
+    (void)irqn;
+    (void)priv;
+    BaseType_t woken = pdFALSE;
+    uint32_t stat = mmio_read(IC_INTR_STAT);
 
-    mmio_write(IC_INTR_MASK, 0);
+    if (s_xfer.status != XFER_BUSY) {
+        mmio_write(IC_INTR_MASK, 0);
+        mmio_read(IC_CLR_INTR);
+        return 0;
+    }
 
-    i2c_enable();
+    if (stat & IC_INTR_TX_ABRT) {
+        mmio_read(IC_TX_ABRT_SRC);
+        mmio_read(IC_CLR_TX_ABRT);
+        xfer_finish_from_isr(-2, &woken);
+    } else {
+        if (stat & IC_INTR_TX_EMPTY) {
+            while (s_xfer.pos < s_xfer.len && (mmio_read(IC_STATUS) & IC_STATUS_TFNF)) {
+                uint32_t cmd = s_xfer.buf[s_xfer.pos];
+                if (++s_xfer.pos == s_xfer.len) {
+                    cmd |= IC_DATA_CMD_STOP;
+                }
+                mmio_write(IC_DATA_CMD, cmd);
+            }
+            if (s_xfer.pos == s_xfer.len) {
+                mmio_write(IC_INTR_MASK, IC_INTR_TX_ABRT | IC_INTR_STOP_DET);
+            }
+        }
+        if (stat & IC_INTR_STOP_DET) {
+            mmio_read(IC_CLR_STOP_DET);
+            if (s_xfer.pos == s_xfer.len) {
+                xfer_finish_from_isr(0, &woken);
+            }
+        }
+    }
 
-    s_initialized = 1;
+    portYIELD_FROM_ISR(woken);
     return 0;
 }
 
-int i2c_hal_write_reg(uint8_t dev_addr, uint8_t reg, uint8_t value) {
+/**
+ * Queue buf to the controller and let the ISR clock it out. The bus must
+ * be held; an async write hands it to the ISR to release.
+ */
+static int xfer_start(uint8_t dev_addr, uint8_t reg, const uint8_t *data, size_t len,
+                      TaskHandle_t waiter) {
     if (i2c_wait_idle() != 0) return -1;
 
     i2c_disable();
     mmio_write(IC_TAR, dev_addr);
     i2c_enable();
 
-    mmio_write(IC_DATA_CMD, reg);
-    mmio_write(IC_DATA_CMD, value | IC_DATA_CMD_STOP);
-
-    if (i2c_wait_tx_empty() != 0) return -2;
-    if (i2c_wait_idle() != 0) return -3;
+    s_xfer.buf[0] = reg;
+    memcpy(&s_xfer.buf[1], data, len);
+    s_xfer.len = len + 1;
+    s_xfer.pos = 0;
+    s_xfer.waiter = waiter;
+    s_xfer.status = XFER_BUSY;
 
+    mmio_read(IC_CLR_INTR);
+    // TX_EMPTY is already asserted, so the ISR fills the FIFO straight away
+    mmio_write(IC_INTR_MASK, IC_INTR_TX_EMPTY | IC_INTR_TX_ABRT | IC_INTR_STOP_DET);
     return 0;
 }
 
-int i2c_hal_write_buf(uint8_t dev_addr, uint8_t reg, const uint8_t *data, size_t len) {
-    if (len == 0) return 0;
+/**
+ * Sleep until the ISR reports completion. Other notification bits that
+ * woke us are posted back, so the caller's own task loop still sees them.
+ */
+static int xfer_wait(void) {
+    TickType_t start = xTaskGetTickCount();
+    TickType_t limit = pdMS_TO_TICKS(I2C_TIMEOUT_MS);
+    uint32_t foreign = 0;
+
+    while (s_xfer.status == XFER_BUSY) {
+        TickType_t waited = xTaskGetTickCount() - start;
+        if (waited >= limit) {
+            taskENTER_CRITICAL();
+            mmio_write(IC_INTR_MASK, 0);
+            if (s_xfer.status == XFER_BUSY) {
+                s_xfer.status = -1;
+            }
+            taskEXIT_CRITICAL();
+            i2c_disable();
+            i2c_enable();
+            break;
+        }
+        uint32_t bits = 0;
+        xTaskNotifyWait(0, I2C_NOTIFY_DONE, &bits, limit - waited);
+        foreign |= bits & ~I2C_NOTIFY_DONE;
+    }
+
+    if (foreign != 0) {
+        xTaskNotify(xTaskGetCurrentTaskHandle(), foreign, eSetBits);
+    }
+    return s_xfer.status;
+}
+
+static int write_buf_polled(uint8_t dev_addr, uint8_t reg, const uint8_t *data, size_t len) {
     if (i2c_wait_idle() != 0) return -1;
 
     i2c_disable();
@@ -190,8 +367,151 @@ int i2c_hal_write_buf(uint8_t dev_addr, uint8_t reg, const uint8_t *data, size_t
     return 0;
 }
 
-int i2c_hal_read_reg(uint8_t dev_addr, uint8_t reg, uint8_t *data, size_t len) {
+/**
+ * Program IC_CON and the SCL counts for bus_hz with the controller
+ * disabled. Standard mode uses the SS counts; Fast and Fast-mode Plus
+ * share the FS counts with the timing minimums of each mode.
+ */
+static void i2c_apply_speed(uint32_t bus_hz) {
+    uint32_t ic_clk = i2c_clk_khz();
+    uint32_t con = IC_CON_MASTER_MODE | IC_CON_IC_RESTART_EN | IC_CON_IC_SLAVE_DISABLE;
+
+    i2c_disable();
+    if (bus_hz <= I2C_HAL_SPEED_STANDARD) {
+        con |= IC_CON_SPEED_SS;
+        mmio_write(IC_SS_SCL_HCNT, scl_hcnt(ic_clk, 4000, 300));
+        mmio_write(IC_SS_SCL_LCNT, scl_lcnt(ic_clk, 4700, 300));
+        bus_hz = I2C_HAL_SPEED_STANDARD;
+    } else if (bus_hz <= I2C_HAL_SPEED_FAST) {
+        con |= IC_CON_SPEED_FS;
+        mmio_write(IC_FS_SCL_HCNT, scl_hcnt(ic_clk, 600, 300));
+        mmio_write(IC_FS_SCL_LCNT, scl_lcnt(ic_clk, 1300, 300));
+        bus_hz = I2C_HAL_SPEED_FAST;
+    } else {
+        con |= IC_CON_SPEED_FS;
+        mmio_write(IC_FS_SCL_HCNT, scl_hcnt(ic_clk, 260, 120));
+        mmio_write(IC_FS_SCL_LCNT, scl_lcnt(ic_clk, 500, 120));
+        bus_hz = I2C_HAL_SPEED_FAST_PLUS;
+    }
+    mmio_write(IC_CON, con);
+    i2c_enable();
+
+    s_bus_hz = bus_hz;
+}
+
+int i2c_hal_set_speed(uint32_t bus_hz) {
+    if (bus_acquire() != 0) return -1;
+    i2c_apply_speed(bus_hz);
+    bus_release();
+    return 0;
+}
+
+uint32_t i2c_hal_get_speed(void) {
+    return s_bus_hz;
+}
+
+uint32_t i2c_hal_self_test(uint8_t dev_addr, uint8_t reg) {
+    uint32_t speed = s_bus_hz;
+
+    while (speed != 0) {
+        i2c_hal_set_speed(speed);
+
+        // A few reads; any abort or timeout means this speed is not reliable
+        int ok = 1;
+        for (int i = 0; i < 4 && ok; i++) {
+            uint8_t value;
+            ok = (i2c_hal_read_reg(dev_addr, reg, &value, 1) == 0);
+        }
+        if (ok) {
+            return speed;
+        }
+
+        if (speed > I2C_HAL_SPEED_FAST) {
+            speed = I2C_HAL_SPEED_FAST;
+        } else if (speed > I2C_HAL_SPEED_STANDARD) {
+            speed = I2C_HAL_SPEED_STANDARD;
+        } else {
+            speed = 0;
+        }
+    }
+    return 0;
+}
+
+int i2c_hal_init(uint32_t bus_hz) {
+    if (s_initialized) {
+        return 0;
+    }
+
+    pinmux_write(GP4_PINMUX_OFFSET, FMUX_I2C1_SCL);
+    pinmux_write(GP5_PINMUX_OFFSET, FMUX_I2C1_SDA);
+
+    i2c_apply_speed(bus_hz);
+    i2c_disable();
+
+    mmio_write(IC_RX_TL, 0);
+    mmio_write(IC_TX_TL, I2C_TX_THRESHOLD);
+
+    mmio_write(IC_INTR_MASK, 0);
+
+    i2c_enable();
+
+    s_bus = xSemaphoreCreateBinary();
+    if (s_bus != NULL) {
+        xSemaphoreGive(s_bus);
+        s_irq_ready = (request_irq(I2C1_INTR, i2c_irq_handler, 0, "i2c1", NULL) == 0);
+    }
+
+    s_initialized = 1;
+    return 0;
+}
+
+int i2c_hal_write_reg(uint8_t dev_addr, uint8_t reg, uint8_t value) {
+    return i2c_hal_write_buf(dev_addr, reg, &value, 1);
+}
+
+int i2c_hal_write_buf(uint8_t dev_addr, uint8_t reg, const uint8_t *data, size_t len) {
     if (len == 0) return 0;
+    if (bus_acquire() != 0) return -1;
+
+    int ret;
+    if (s_irq_ready && scheduler_running() && len <= I2C_HAL_ASYNC_MAX) {
+        ret = xfer_start(dev_addr, reg, data, len, xTaskGetCurrentTaskHandle());
+        if (ret == 0) {
+            ret = xfer_wait();
+        }
+    } else {
+        ret = write_buf_polled(dev_addr, reg, data, len);
+    }
+
+    bus_release();
+    return ret;
+}
+
+int i2c_hal_write_buf_async(uint8_t dev_addr, uint8_t reg, const uint8_t *data, size_t len) {
+    if (len == 0) return 0;
+    if (!s_irq_ready || !scheduler_running() || len > I2C_HAL_ASYNC_MAX) {
+        return i2c_hal_write_buf(dev_addr, reg, data, len);
+    }
+    if (bus_acquire() != 0) return -1;
+
+    // From here the ISR owns the bus and releases it on completion
+    int ret = xfer_start(dev_addr, reg, data, len, NULL);
+    if (ret != 0) {
+        bus_release();
+    }
+    return ret;
+}
+
+int i2c_hal_flush(void) {
+    if (bus_acquire() != 0) return -1;
+    int ret = s_async_result;
+    s_async_result = 0;
+    bus_release();
+    return ret;
+}
+
+// Reads are rare (init only) and stay polled
+static int read_reg_polled(uint8_t dev_addr, uint8_t reg, uint8_t *data, size_t len) {
     if (i2c_wait_idle() != 0) return -1;
 
     i2c_disable();
@@ -211,6 +531,10 @@ int i2c_hal_read_reg(uint8_t dev_addr, uint8_t reg, uint8_t *data, size_t len) {
     for (size_t i = 0; i < len; i++) {
         uint32_t start = xTaskGetTickCount();
         while (!(mmio_read(IC_STATUS) & IC_STATUS_RFNE)) {
+            if (mmio_read(IC_RAW_INTR_STAT) & IC_RAW_TX_ABRT) {
+                mmio_read(IC_CLR_TX_ABRT);
+                return -4;
+            }
             if ((xTaskGetTickCount() - start) > pdMS_TO_TICKS(I2C_TIMEOUT_MS)) {
                 return -2;
             }
@@ -224,6 +548,14 @@ int i2c_hal_read_reg(uint8_t dev_addr, uint8_t reg, uint8_t *data, size_t len) {
     return 0;
 }
 
+int i2c_hal_read_reg(uint8_t dev_addr, uint8_t reg, uint8_t *data, size_t len) {
+    if (len == 0) return 0;
+    if (bus_acquire() != 0) return -1;
+    int ret = read_reg_polled(dev_addr, reg, data, len);
+    bus_release();
+    return ret;
+}
+
 void i2c_hal_delay_ms(uint32_t ms) {
     vTaskDelay(pdMS_TO_TICKS(ms));
 }
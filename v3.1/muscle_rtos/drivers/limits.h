@@ -19,6 +19,12 @@
 #define SERVO_COUNT_TOTAL     13
 #define SERVO_CHANNEL_SCAN    12
 
+// Channels driven, extra ones after the layout above (see common/limits.h)
+#ifndef SERVO_CHANNEL_COUNT
+#define SERVO_CHANNEL_COUNT   SERVO_COUNT_TOTAL
+#endif
+#define SERVO_CHANNEL_MAX     32
+
 // Timing and safety
 #define HEARTBEAT_TIMEOUT_MS  250   // Watchdog timeout (Brain must send within this)
 #define MOTION_UPDATE_HZ      50
@@ -1,7 +1,8 @@
 /**
  * PCA9685 16-Channel PWM Servo Driver
  *
- * I2C driver for FreeRTOS on Milk-V Duo.
+ * I2C driver for FreeRTOS on Milk-V Duo. Drives PCA9685_BOARD_COUNT
+ * chips at consecutive addresses as one run of channels.
  */
 
 #include "pca9685.h"
@@ -19,76 +20,257 @@
 #define MODE1_RESTART  0x80
 #define MODE1_SLEEP    0x10
 #define MODE1_AI       0x20  // Auto-increment
+#define MODE1_ALLCALL  0x01  // Answer on PCA9685_I2C_ADDR_ALLCALL
 
 // MODE2 bits
 #define MODE2_OUTDRV   0x04  // Totem pole outputs
+#define MODE2_OCH      0x08  // Outputs change on ACK instead of STOP; kept clear
 
-// Internal oscillator: 25 MHz
-#define PCA9685_OSC_FREQ  25000000
 #define PCA9685_TICK_MAX  4096
+#define PCA9685_TICK_MASK (PCA9685_TICK_MAX - 1)
 
-static uint8_t s_i2c_addr = PCA9685_I2C_ADDR_DEFAULT;
-static uint16_t s_ticks_per_us = 0;  // Pre-calculated for efficiency
+// Staggered ON offsets: one slot of 4096 / 16 ticks (~1.25 ms) per channel
+#define PCA9685_STAGGER_STEP  (PCA9685_TICK_MAX / PCA9685_CHANNEL_COUNT)
+
+// Pulse width conversion factor fraction bits (2500 us * ~0.2 * 2^20 fits 32 bits)
+#define TICKS_Q_SHIFT     20
+
+// Shadow value for a channel whose register contents are not known
+#define SHADOW_UNKNOWN    0xFFFF
+
+// MODE1 after wake-up; ALLCALL lets one write reach every board
+#if PCA9685_BOARD_COUNT > 1
+#define MODE1_RUN      (MODE1_AI | MODE1_ALLCALL)
+#else
+#define MODE1_RUN      MODE1_AI
+#endif
+
+static uint8_t s_i2c_addr = PCA9685_I2C_ADDR_DEFAULT;  // Board 0; board b is at s_i2c_addr + b
+static uint32_t s_ticks_per_us_q20 = 0;  // Calibrated at init: ticks = us * this >> 20
+static int s_stagger = PCA9685_PHASE_STAGGER;
+
+// Last pulse width (OFF - ON ticks) written per channel, for pca9685_update_us()
+static uint16_t s_shadow_width[PCA9685_OUTPUT_COUNT];
+
+static void shadow_set(uint8_t first_ch, uint8_t count, const uint16_t *width, int ok) {
+    for (uint8_t i = 0; i < count; i++) {
+        s_shadow_width[first_ch + i] = ok ? width[i] : SHADOW_UNKNOWN;
+    }
+}
+
+static uint8_t board_addr(uint8_t board) {
+    return (uint8_t)(s_i2c_addr + board);
+}
+
+// Pulses are staggered across each board's own 16 outputs
+static uint16_t channel_on_tick(uint8_t channel) {
+    return s_stagger ? (uint16_t)((channel % PCA9685_CHANNEL_COUNT) * PCA9685_STAGGER_STEP) : 0;
+}
 
 int pca9685_init(uint8_t i2c_addr) {
     s_i2c_addr = i2c_addr;
+    shadow_set(0, PCA9685_OUTPUT_COUNT, NULL, 0);
 
     // Initialize I2C HAL
-    if (i2c_hal_init() != 0) {
+    if (i2c_hal_init(PCA9685_I2C_BUS_HZ) != 0) {
         return -1;
     }
 
+    // Settle on the fastest speed the wiring to every board handles
+    for (uint8_t b = 0; b < PCA9685_BOARD_COUNT; b++) {
+        if (i2c_hal_self_test(board_addr(b), PCA9685_REG_MODE1) == 0) {
+            return -2;
+        }
+    }
+
     // Calculate prescale for 50 Hz
     // prescale = round(osc_freq / (4096 * update_rate)) - 1
-    uint8_t prescale = (uint8_t)((PCA9685_OSC_FREQ / (PCA9685_TICK_MAX * PCA9685_FREQ_HZ)) - 1);
+    const uint32_t frame_ticks = PCA9685_TICK_MAX * PCA9685_FREQ_HZ;
+    uint8_t prescale = (uint8_t)((PCA9685_OSC_HZ + frame_ticks / 2) / frame_ticks - 1);
+
+    for (uint8_t b = 0; b < PCA9685_BOARD_COUNT; b++) {
+        uint8_t addr = board_addr(b);
 
-    // Put to sleep before changing prescale
-    uint8_t mode1 = 0;
-    i2c_hal_read_reg(s_i2c_addr, PCA9685_REG_MODE1, &mode1, 1);
-    i2c_hal_write_reg(s_i2c_addr, PCA9685_REG_MODE1, (mode1 & ~MODE1_RESTART) | MODE1_SLEEP);
+        // Put to sleep before changing prescale
+        uint8_t mode1 = 0;
+        i2c_hal_read_reg(addr, PCA9685_REG_MODE1, &mode1, 1);
+        i2c_hal_write_reg(addr, PCA9685_REG_MODE1, (mode1 & ~MODE1_RESTART) | MODE1_SLEEP);
 
-    // Set prescale
-    i2c_hal_write_reg(s_i2c_addr, PCA9685_REG_PRESCALE, prescale);
+        // Set prescale
+        i2c_hal_write_reg(addr, PCA9685_REG_PRESCALE, prescale);
 
-    // Wake up with auto-increment
-    i2c_hal_write_reg(s_i2c_addr, PCA9685_REG_MODE1, MODE1_AI);
+        // Wake up with auto-increment
+        i2c_hal_write_reg(addr, PCA9685_REG_MODE1, MODE1_RUN);
+    }
 
-    // Wait for oscillator to stabilize
+    // Wait for oscillators to stabilize
     i2c_hal_delay_ms(5);
 
-    // Set MODE2 for totem-pole outputs
-    i2c_hal_write_reg(s_i2c_addr, PCA9685_REG_MODE2, MODE2_OUTDRV);
+    // Set MODE2 for totem-pole outputs. OCH stays clear: a transaction's registers
+    // take effect together on its STOP, not byte by byte
+    for (uint8_t b = 0; b < PCA9685_BOARD_COUNT; b++) {
+        i2c_hal_write_reg(board_addr(b), PCA9685_REG_MODE2, MODE2_OUTDRV);
+    }
 
-    // Calculate ticks per microsecond
-    // At 50 Hz, period = 20000 µs, 4096 ticks
-    // ticks_per_us = 4096 / 20000 ≈ 0.2048
-    // For integer math: use (pulse_us * 4096) / 20000
-    s_ticks_per_us = 4096;  // Store for division later
+    // One tick lasts (prescale + 1) oscillator cycles, so with the real
+    // oscillator frequency ticks_per_us = osc_hz / ((prescale + 1) * 1e6)
+    // (~0.2049 nominal). Kept as a Q20 reciprocal: no divide per channel.
+    s_ticks_per_us_q20 = (uint32_t)(((uint64_t)PCA9685_OSC_HZ << TICKS_Q_SHIFT) /
+                                    ((uint64_t)(prescale + 1) * 1000000ULL));
 
     return 0;
 }
 
+static uint16_t pulse_us_to_ticks(uint16_t pulse_us) {
+    // Clamp to safe range (MANDATORY - Muscle enforces this)
+    if (pulse_us < SERVO_PWM_MIN_US) pulse_us = SERVO_PWM_MIN_US;
+    if (pulse_us > SERVO_PWM_MAX_US) pulse_us = SERVO_PWM_MAX_US;
+
+    // Convert µs to ticks with the calibrated reciprocal, rounded
+    return (uint16_t)(((uint32_t)pulse_us * s_ticks_per_us_q20 +
+                       (1UL << (TICKS_Q_SHIFT - 1))) >> TICKS_Q_SHIFT);
+}
+
+// ON/OFF for a pulse of width ticks, in register order (ON_L, ON_H, OFF_L, OFF_H).
+// A staggered pulse may wrap past tick 4095; the chip handles OFF < ON.
+static void fill_led_regs(uint8_t *data, uint16_t on_tick, uint16_t width) {
+    uint16_t off_tick = (uint16_t)((on_tick + width) & PCA9685_TICK_MASK);
+    data[0] = (uint8_t)(on_tick & 0xFF);
+    data[1] = (uint8_t)(on_tick >> 8);
+    data[2] = (uint8_t)(off_tick & 0xFF);
+    data[3] = (uint8_t)(off_tick >> 8);
+}
+
+/**
+ * Write pulse widths for count consecutive channels of one board in one
+ * auto-increment transaction (MODE1_AI walks the register pointer
+ * through the LEDn blocks) and record them in the shadow. An async write
+ * is recorded as written; pca9685_update_us() catches a failure on its
+ * next call.
+ */
+static int write_widths(uint8_t first_ch, uint8_t count, const uint16_t *width, int async) {
+    uint8_t data[PCA9685_CHANNEL_COUNT * 4];
+    for (uint8_t i = 0; i < count; i++) {
+        fill_led_regs(&data[i * 4], channel_on_tick((uint8_t)(first_ch + i)), width[i]);
+    }
+
+    uint8_t addr = board_addr(first_ch / PCA9685_CHANNEL_COUNT);
+    uint8_t reg = PCA9685_REG_LED0_ON_L + ((first_ch % PCA9685_CHANNEL_COUNT) * 4);
+    size_t len = (size_t)count * 4;
+    int ret = async ? i2c_hal_write_buf_async(addr, reg, data, len)
+                    : i2c_hal_write_buf(addr, reg, data, len);
+    shadow_set(first_ch, count, width, ret == 0);
+    return ret;
+}
+
 int pca9685_set_pwm_us(uint8_t channel, uint16_t pulse_us) {
-    if (channel >= PCA9685_CHANNEL_COUNT) {
+    if (channel >= PCA9685_OUTPUT_COUNT) {
         return -1;
     }
 
-    // Clamp to safe range (MANDATORY - Muscle enforces this)
-    if (pulse_us < SERVO_PWM_MIN_US) pulse_us = SERVO_PWM_MIN_US;
-    if (pulse_us > SERVO_PWM_MAX_US) pulse_us = SERVO_PWM_MAX_US;
+    uint16_t width = pulse_us_to_ticks(pulse_us);
+    return write_widths(channel, 1, &width, 0);
+}
 
-    // Convert µs to ticks: (pulse_us * 4096) / 20000
-    uint16_t off_tick = (uint16_t)(((uint32_t)pulse_us * 4096) / 20000);
+int pca9685_set_pwm_us_multi(uint8_t first_ch, uint8_t count, const uint16_t *pulse_us) {
+    if (count == 0) {
+        return 0;
+    }
+    if (first_ch >= PCA9685_OUTPUT_COUNT || count > PCA9685_OUTPUT_COUNT - first_ch) {
+        return -1;
+    }
 
-    return pca9685_set_pwm_raw(channel, 0, off_tick);
+    // One transaction per board the channels span
+    int ret = 0;
+    uint8_t end = (uint8_t)(first_ch + count);
+    for (uint8_t ch = first_ch; ch < end;) {
+        uint8_t board_end = (uint8_t)((ch / PCA9685_CHANNEL_COUNT + 1) * PCA9685_CHANNEL_COUNT);
+        uint8_t n = (uint8_t)((end < board_end ? end : board_end) - ch);
+        uint16_t width[PCA9685_CHANNEL_COUNT];
+        for (uint8_t i = 0; i < n; i++) {
+            width[i] = pulse_us_to_ticks(pulse_us[ch - first_ch + i]);
+        }
+        if (write_widths(ch, n, width, 0) != 0) {
+            ret = -2;
+        }
+        ch = (uint8_t)(ch + n);
+    }
+    return ret;
+}
+
+/**
+ * pca9685_update_us() for the count channels of one board starting at
+ * first_ch. Dirty channels are found without a branch per channel.
+ */
+static int update_board(uint8_t first_ch, uint8_t count, const uint16_t *pulse_us) {
+    uint16_t width[PCA9685_CHANNEL_COUNT];
+    const uint16_t *shadow = &s_shadow_width[first_ch];
+    uint16_t dirty = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        width[i] = pulse_us_to_ticks(pulse_us[i]);
+        dirty |= (uint16_t)((width[i] != shadow[i]) << i);
+    }
+
+    if (PCA9685_SYNC_UPDATE) {
+        if (dirty == 0) {
+            return 0;
+        }
+        // One burst from the first to the last dirty channel, latched on one STOP
+        uint8_t first = 0;
+        uint8_t last = (uint8_t)(count - 1);
+        while (!(dirty & (1u << first))) first++;
+        while (!(dirty & (1u << last))) last--;
+        return write_widths((uint8_t)(first_ch + first), (uint8_t)(last - first + 1),
+                            &width[first], 1);
+    }
+
+    // One transaction per run of adjacent dirty channels
+    int ret = 0;
+    uint8_t ch = 0;
+    while (dirty >> ch) {
+        if (!(dirty & (1u << ch))) {
+            ch++;
+            continue;
+        }
+        uint8_t first = ch;
+        while (ch < count && (dirty & (1u << ch))) {
+            ch++;
+        }
+        if (write_widths((uint8_t)(first_ch + first), (uint8_t)(ch - first), &width[first], 1) != 0) {
+            ret = -2;
+        }
+    }
+    return ret;
+}
+
+int pca9685_update_us(const uint16_t *pulse_us, uint8_t count) {
+    if (count > PCA9685_OUTPUT_COUNT) {
+        return -1;
+    }
+
+    // The last tick's writes went out async; if one failed, the shadow cannot be trusted
+    if (i2c_hal_flush() != 0) {
+        shadow_set(0, PCA9685_OUTPUT_COUNT, NULL, 0);
+    }
+
+    // Board by board: each burst is clocked out while the next board's is built
+    int ret = 0;
+    for (uint8_t first = 0; first < count; first = (uint8_t)(first + PCA9685_CHANNEL_COUNT)) {
+        uint8_t n = (uint8_t)(count - first);
+        if (n > PCA9685_CHANNEL_COUNT) n = PCA9685_CHANNEL_COUNT;
+        if (update_board(first, n, &pulse_us[first]) != 0) {
+            ret = -2;
+        }
+    }
+    return ret;
 }
 
 int pca9685_set_pwm_raw(uint8_t channel, uint16_t on, uint16_t off) {
-    if (channel >= PCA9685_CHANNEL_COUNT) {
+    if (channel >= PCA9685_OUTPUT_COUNT) {
         return -1;
     }
 
-    uint8_t reg = PCA9685_REG_LED0_ON_L + (channel * 4);
+    uint8_t reg = PCA9685_REG_LED0_ON_L + ((channel % PCA9685_CHANNEL_COUNT) * 4);
     uint8_t data[4] = {
         (uint8_t)(on & 0xFF),
         (uint8_t)(on >> 8),
@@ -96,29 +278,69 @@ int pca9685_set_pwm_raw(uint8_t channel, uint16_t on, uint16_t off) {
         (uint8_t)(off >> 8)
     };
 
-    return i2c_hal_write_buf(s_i2c_addr, reg, data, 4);
+    int ret = i2c_hal_write_buf(board_addr(channel / PCA9685_CHANNEL_COUNT), reg, data, 4);
+
+    // The shadow only describes pulses starting at the channel's own ON tick
+    uint16_t shadow = (ret == 0 && on == channel_on_tick(channel))
+                          ? (uint16_t)((off - on) & PCA9685_TICK_MASK) : SHADOW_UNKNOWN;
+    shadow_set(channel, 1, &shadow, 1);
+    return ret;
 }
 
 void pca9685_set_all_us(uint16_t pulse_us) {
-    for (uint8_t i = 0; i < PCA9685_CHANNEL_COUNT; i++) {
-        pca9685_set_pwm_us(i, pulse_us);
+    uint16_t width = pulse_us_to_ticks(pulse_us);
+
+    if (s_stagger) {
+        // ALL_LED would line every pulse up again; one burst per board keeps the offsets
+        uint16_t widths[PCA9685_CHANNEL_COUNT];
+        for (uint8_t i = 0; i < PCA9685_CHANNEL_COUNT; i++) {
+            widths[i] = width;
+        }
+        for (uint8_t b = 0; b < PCA9685_BOARD_COUNT; b++) {
+            write_widths((uint8_t)(b * PCA9685_CHANNEL_COUNT), PCA9685_CHANNEL_COUNT, widths, 0);
+        }
+        return;
     }
+
+    // ALL_LED registers load every channel in one 4-byte write, to every board at once
+    uint8_t addr = (PCA9685_BOARD_COUNT > 1) ? PCA9685_I2C_ADDR_ALLCALL : s_i2c_addr;
+    uint8_t data[4];
+    fill_led_regs(data, 0, width);
+    int ret = i2c_hal_write_buf(addr, PCA9685_REG_ALL_ON_L, data, sizeof(data));
+
+    for (uint8_t i = 0; i < PCA9685_OUTPUT_COUNT; i++) {
+        s_shadow_width[i] = (ret == 0) ? width : SHADOW_UNKNOWN;
+    }
+}
+
+void pca9685_set_phase_stagger(int enable) {
+    s_stagger = enable ? 1 : 0;
+
+    // Every ON register changes; the next update rewrites all channels
+    shadow_set(0, PCA9685_OUTPUT_COUNT, NULL, 0);
 }
 
 void pca9685_sleep(void) {
-    uint8_t mode1 = 0;
-    i2c_hal_read_reg(s_i2c_addr, PCA9685_REG_MODE1, &mode1, 1);
-    i2c_hal_write_reg(s_i2c_addr, PCA9685_REG_MODE1, mode1 | MODE1_SLEEP);
+    for (uint8_t b = 0; b < PCA9685_BOARD_COUNT; b++) {
+        uint8_t mode1 = 0;
+        i2c_hal_read_reg(board_addr(b), PCA9685_REG_MODE1, &mode1, 1);
+        i2c_hal_write_reg(board_addr(b), PCA9685_REG_MODE1, mode1 | MODE1_SLEEP);
+    }
 }
 
 void pca9685_wake(void) {
-    uint8_t mode1 = 0;
-    i2c_hal_read_reg(s_i2c_addr, PCA9685_REG_MODE1, &mode1, 1);
-    i2c_hal_write_reg(s_i2c_addr, PCA9685_REG_MODE1, mode1 & ~MODE1_SLEEP);
+    uint8_t mode1[PCA9685_BOARD_COUNT];
+    for (uint8_t b = 0; b < PCA9685_BOARD_COUNT; b++) {
+        mode1[b] = 0;
+        i2c_hal_read_reg(board_addr(b), PCA9685_REG_MODE1, &mode1[b], 1);
+        i2c_hal_write_reg(board_addr(b), PCA9685_REG_MODE1, mode1[b] & ~MODE1_SLEEP);
+    }
     i2c_hal_delay_ms(5);
 
     // Restart if needed
-    if (mode1 & MODE1_RESTART) {
-        i2c_hal_write_reg(s_i2c_addr, PCA9685_REG_MODE1, mode1 | MODE1_RESTART);
+    for (uint8_t b = 0; b < PCA9685_BOARD_COUNT; b++) {
+        if (mode1[b] & MODE1_RESTART) {
+            i2c_hal_write_reg(board_addr(b), PCA9685_REG_MODE1, mode1[b] | MODE1_RESTART);
+        }
     }
 }
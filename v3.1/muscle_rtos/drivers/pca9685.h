@@ -8,12 +8,43 @@ extern "C" {
 #endif
 
 #define PCA9685_I2C_ADDR_DEFAULT  0x40
-#define PCA9685_CHANNEL_COUNT     16
+#define PCA9685_I2C_ADDR_ALLCALL  0x70     // Every board with MODE1 ALLCALL set answers
+#define PCA9685_CHANNEL_COUNT     16       // Per board
+
+// Boards on the bus, at consecutive addresses from the one given to
+// pca9685_init(). Channel n is output n % 16 of board n / 16.
+#ifndef PCA9685_BOARD_COUNT
+#define PCA9685_BOARD_COUNT       1
+#endif
+#define PCA9685_OUTPUT_COUNT      (PCA9685_BOARD_COUNT * PCA9685_CHANNEL_COUNT)
 #define PCA9685_FREQ_HZ           50   // Standard servo frequency
 
+// Measured oscillator frequency. The internal one is specified at 25 MHz but
+// varies per chip; scope the 50 Hz frame and use 25 MHz * 20000 / frame_us.
+#ifndef PCA9685_OSC_HZ
+#define PCA9685_OSC_HZ            25000000
+#endif
+
+// Stagger each channel's pulse start across the frame (default off)
+#ifndef PCA9685_PHASE_STAGGER
+#define PCA9685_PHASE_STAGGER     0
+#endif
+
+// Send each update's changed channels as one burst, latched on a single STOP (default on)
+#ifndef PCA9685_SYNC_UPDATE
+#define PCA9685_SYNC_UPDATE       1
+#endif
+
+// Requested bus speed; build with -DPCA9685_I2C_BUS_HZ=1000000 for Fast-mode Plus
+#ifndef PCA9685_I2C_BUS_HZ
+#define PCA9685_I2C_BUS_HZ        400000
+#endif
+
 /**
- * Initialize PCA9685 on I2C bus.
- * Returns 0 on success, negative on error.
+ * Initialize the PCA9685 boards at i2c_addr onwards. The bus starts at
+ * PCA9685_I2C_BUS_HZ and drops to a slower mode if a chip does not
+ * answer reliably there. With several boards each also answers on
+ * PCA9685_I2C_ADDR_ALLCALL. Returns 0 on success, negative on error.
  */
 int pca9685_init(uint8_t i2c_addr);
 
@@ -23,6 +54,34 @@ int pca9685_init(uint8_t i2c_addr);
  */
 int pca9685_set_pwm_us(uint8_t channel, uint16_t pulse_us);
 
+/**
+ * Set count consecutive channels starting at first_ch in one
+ * auto-increment I2C transaction per board (4 bytes per channel).
+ * pulse_us[i] is clamped like pca9685_set_pwm_us() and goes to channel
+ * first_ch + i.
+ */
+int pca9685_set_pwm_us_multi(uint8_t first_ch, uint8_t count, const uint16_t *pulse_us);
+
+/**
+ * Bring channels 0..count-1 to pulse_us, writing only those whose pulse
+ * width in ticks differs from the last value written. The driver keeps a shadow
+ * of every channel and sends one auto-increment transaction per run of
+ * init, or whose last write failed, always count as changed. Each board
+ * is handled in turn: its burst is on the wire while the next board's is
+ * worked out, and it latches on its own STOP. With
+ * PCA9685_SYNC_UPDATE everything from the first to the last changed
+ * channel goes out in one auto-increment transaction, unchanged ones in
+ * between rewritten as they are; MODE2 OCH is left clear, so the chip
+ * applies the whole burst on its STOP and each output switches at the
+ * end of its current PWM period. Without staggering the channels share
+ * that period, so every joint changes on the same 50 Hz cycle. Without
+ * PCA9685_SYNC_UPDATE each run of adjacent changed channels is its own
+ * transaction. The writes are sent with i2c_hal_write_buf_async(), so
+ * this returns while they are still being clocked out. Returns 0 if
+ * every write was started.
+ */
+int pca9685_update_us(const uint16_t *pulse_us, uint8_t count);
+
 /**
  * Set PWM for a channel using raw on/off tick values (0-4095).
  */
@@ -30,16 +89,26 @@ int pca9685_set_pwm_raw(uint8_t channel, uint16_t on, uint16_t off);
 
 /**
  * Set all channels to the same pulse width (for neutral/safe pose).
+ * Uses the ALL_LED registers, so it is a single short I2C write, sent
+ * to the ALLCALL address when there are several boards (one 64-byte
+ * burst per board when staggering).
  */
 void pca9685_set_all_us(uint16_t pulse_us);
 
 /**
- * Put PCA9685 into sleep mode (low power).
+ * Start channel n's pulse at tick n * 256 instead of 0, so at most two
+ * servo pulses overlap and their inrush currents do not add up at the
+ * start of the frame. Takes effect on the next write of each channel.
+ */
+void pca9685_set_phase_stagger(int enable);
+
+/**
+ * Put every PCA9685 into sleep mode (low power).
  */
 void pca9685_sleep(void);
 
 /**
- * Wake PCA9685 from sleep mode.
+ * Wake every PCA9685 from sleep mode.
  */
 void pca9685_wake(void);
 
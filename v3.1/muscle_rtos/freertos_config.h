@@ -32,6 +32,20 @@
  */
 #define SPIDER_TICK_RATE_HZ         1000
 
+/**
+ * Tickless idle (configUSE_TICKLESS_IDLE = 1 in the SDK's FreeRTOSConfig.h)
+ *
+ * Rationale:
+ * - Parked, the motion task blocks on the mailbox and the output task on
+ *   its notification; the PCA9685 holds the pose without the core
+ * - The watchdog deadline (or brain_alive sampling) is then the only
+ *   timed wake, so the tick interrupt is suppressed in between
+ * - Mailbox interrupts still wake the core at once, so the next packet
+ *   sees no added latency
+ */
+#define SPIDER_USE_TICKLESS_IDLE    1
+#define SPIDER_IDLE_TICKS_BEFORE_SLEEP  5   /* configEXPECTED_IDLE_TIME_BEFORE_SLEEP */
+
 /*===========================================================================
  * TASK PRIORITY DEFINITIONS
  * Higher number = Higher priority (FreeRTOS convention)
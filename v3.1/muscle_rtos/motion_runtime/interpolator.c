@@ -2,59 +2,307 @@
  * Motion Interpolator
  *
  * Smoothly interpolates servo positions from start to target.
- * Supports float and Q16.16 fixed-point modes.
+ * Supports float and Q16.16 fixed-point modes for single linear moves,
+ * and a queue of keyframes joined by C1-continuous cubic Hermite
+ * segments (Q16 only) for sparse trajectories.
+ *
+ * Each channel group of limits.h (a leg, the scan servo) has its own
+ * timeline: segment, duration, progress and keyframe queue. Starting a
+ * move on one group leaves the others running. Channel arrays hold
+ * SERVO_CHANNEL_COUNT values; each group walks its own channel list, so
+ * a tick costs the same per channel whatever the robot.
  */
 
 #include "interpolator.h"
 #include <string.h>
 
-// Interpolation state
-static uint16_t s_start_us[SERVO_COUNT_TOTAL];
-static uint16_t s_target_us[SERVO_COUNT_TOTAL];
-static uint32_t s_duration_ms;
-static uint32_t s_elapsed_ms;
-static InterpMode s_mode;
-static bool s_active;
+#define TICK_PERIOD_US  (1000000UL / MOTION_UPDATE_HZ)  // 20 ms
+#define Q16_ONE         65536LL
 
-#define TICK_PERIOD_MS  (1000 / MOTION_UPDATE_HZ)  // 20 ms
+typedef enum {
+    SEGMENT_LINEAR,
+    SEGMENT_HERMITE
+} SegmentProfile;
 
-void interpolator_start(const uint16_t *current_us, const uint16_t *target_us,
-                        uint32_t duration_ms, InterpMode mode) {
-    memcpy(s_start_us, current_us, sizeof(s_start_us));
-    memcpy(s_target_us, target_us, sizeof(s_target_us));
+typedef struct {
+    uint16_t target_us[SERVO_CHANNEL_COUNT];
+    uint32_t duration_us;
+} Keyframe;
+
+// A leg's three joints; the scan group also takes the channels past the layout
+#define GROUP_CHANNELS_MAX  (3 + SERVO_CHANNEL_COUNT - SERVO_COUNT_TOTAL)
+
+/**
+ * One channel group's timeline: its running segment and the keyframes
+ * queued behind it. Only the group's channels of the per-channel arrays
+ * below belong to it.
+ */
+typedef struct {
+    uint8_t channels[GROUP_CHANNELS_MAX];
+    uint8_t count;
+    uint32_t duration_us;
+    uint32_t elapsed_us;
+    InterpMode mode;
+    SegmentProfile profile;
+    bool active;
+    Keyframe queue[INTERP_QUEUE_DEPTH];
+    uint8_t queue_head;
+    uint8_t queue_count;
+} Timeline;
 
-    s_duration_ms = (duration_ms > 0) ? duration_ms : 1;
-    s_elapsed_ms = 0;
-    s_mode = mode;
-    s_active = true;
+// Active segments. Velocities are Q16 us per ms.
+static uint16_t s_start_us[SERVO_CHANNEL_COUNT];
+static uint16_t s_target_us[SERVO_CHANNEL_COUNT];
+static int32_t s_m0_us[SERVO_CHANNEL_COUNT];      // Hermite tangents, scaled to the segment
+static int32_t s_m1_us[SERVO_CHANNEL_COUNT];
+static int64_t s_v_end[SERVO_CHANNEL_COUNT];      // Velocity on reaching the target
+static uint32_t s_tick_us = TICK_PERIOD_US;
+static uint8_t s_substeps = 1;
+static uint32_t s_substep_us = TICK_PERIOD_US;
+
+// Last output, where the next segment starts from
+static uint16_t s_pos_us[SERVO_CHANNEL_COUNT];
+
+static Timeline s_groups[SERVO_GROUP_COUNT];
+static bool s_groups_ready;
+
+static void groups_init(void) {
+    if (s_groups_ready) {
+        return;
+    }
+    for (int ch = 0; ch < SERVO_CHANNEL_COUNT; ch++) {
+        Timeline *tl = &s_groups[servo_group_of(ch)];
+        tl->channels[tl->count++] = (uint8_t)ch;
+    }
+    s_groups_ready = true;
 }
 
-bool interpolator_tick(uint16_t *output_us) {
-    if (!s_active) {
+static uint32_t duration_to_us(uint32_t duration_ms) {
+    return (duration_ms > 0) ? duration_ms * 1000UL : 1;
+}
+
+static int64_t secant_velocity(int32_t delta_us, uint32_t duration_us) {
+    return (int64_t)delta_us * Q16_ONE * 1000 / (int64_t)duration_us;
+}
+
+static int64_t abs64(int64_t v) {
+    return (v < 0) ? -v : v;
+}
+
+/**
+ * Velocity at a keyframe between a segment of d0 over t0 and one of d1
+ * over t1: the time-weighted mean of the two secants (non-uniform
+ * Catmull-Rom), zero where the direction changes, and bounded by three
+ * times the smaller secant so neither segment overshoots its ends.
+ */
+static int64_t keyframe_velocity(int32_t d0, uint32_t t0_us, int32_t d1, uint32_t t1_us) {
+    if (d0 == 0 || d1 == 0 || ((d0 < 0) != (d1 < 0))) {
+        return 0;
+    }
+
+    int64_t v = (int64_t)(d0 + d1) * Q16_ONE * 1000 / ((int64_t)t0_us + t1_us);
+    int64_t s0 = abs64(secant_velocity(d0, t0_us));
+    int64_t s1 = abs64(secant_velocity(d1, t1_us));
+    int64_t limit = 3 * ((s0 < s1) ? s0 : s1);
+
+    if (v > limit) v = limit;
+    if (v < -limit) v = -limit;
+    return v;
+}
+
+// Tangent for a Hermite segment: velocity times duration, in us
+static int32_t velocity_to_tangent(int64_t v, uint32_t duration_us) {
+    return (int32_t)(v * (int64_t)duration_us / (1000 * Q16_ONE));
+}
+
+static void evaluate_hermite(const Timeline *tl, uint16_t *output_us, uint32_t t_q16) {
+    int64_t t = t_q16;
+    int64_t t2 = (t * t) >> 16;
+    int64_t t3 = (t2 * t) >> 16;
+    int64_t h00 = 2 * t3 - 3 * t2 + Q16_ONE;
+    int64_t h10 = t3 - 2 * t2 + t;
+    int64_t h01 = 3 * t2 - 2 * t3;
+    int64_t h11 = t3 - t2;
+
+    for (int k = 0; k < tl->count; k++) {
+        int i = tl->channels[k];
+        int64_t p = h00 * s_start_us[i] + h10 * s_m0_us[i] +
+                    h01 * s_target_us[i] + h11 * s_m1_us[i];
+        p = (p + (Q16_ONE / 2)) / Q16_ONE;
+        if (p < SERVO_PWM_MIN_US) p = SERVO_PWM_MIN_US;
+        if (p > SERVO_PWM_MAX_US) p = SERVO_PWM_MAX_US;
+        output_us[i] = (uint16_t)p;
+    }
+}
+
+// Velocity of one channel at the current point of its group's segment
+static int64_t current_velocity(const Timeline *tl, int ch) {
+    if (tl->profile == SEGMENT_LINEAR) {
+        return secant_velocity((int32_t)s_target_us[ch] - s_start_us[ch], tl->duration_us);
+    }
+
+    int64_t t = (int64_t)(((uint64_t)tl->elapsed_us << 16) / tl->duration_us);
+    int64_t t2 = (t * t) >> 16;
+    int64_t d00 = 6 * t2 - 6 * t;
+    int64_t d10 = 3 * t2 - 4 * t + Q16_ONE;
+    int64_t d11 = 3 * t2 - 2 * t;
+
+    // d01 = -d00
+    int64_t dp = d00 * ((int64_t)s_start_us[ch] - s_target_us[ch]) +
+                 d10 * s_m0_us[ch] + d11 * s_m1_us[ch];
+    return dp * 1000 / (int64_t)tl->duration_us;
+}
+
+/**
+ * Start a Hermite segment from the last output with velocity v0. The end
+ * velocity looks one keyframe ahead if one is queued, else it is zero.
+ */
+static void begin_hermite(Timeline *tl, const uint16_t *target_us, uint32_t duration_us,
+                          const int64_t *v0, const Keyframe *next) {
+    for (int k = 0; k < tl->count; k++) {
+        int i = tl->channels[k];
+        int32_t d0 = (int32_t)target_us[i] - s_pos_us[i];
+        int64_t v1 = 0;
+        if (next != NULL) {
+            int32_t d1 = (int32_t)next->target_us[i] - target_us[i];
+            v1 = keyframe_velocity(d0, duration_us, d1, next->duration_us);
+        }
+
+        s_start_us[i] = s_pos_us[i];
+        s_target_us[i] = target_us[i];
+        s_m0_us[i] = velocity_to_tangent(v0[i], duration_us);
+        s_m1_us[i] = velocity_to_tangent(v1, duration_us);
+        s_v_end[i] = v1;
+    }
+
+    tl->duration_us = duration_us;
+    tl->elapsed_us = 0;
+    tl->mode = INTERP_MODE_Q16;
+    tl->profile = SEGMENT_HERMITE;
+    tl->active = true;
+}
+
+static const Keyframe *queue_peek(const Timeline *tl, uint8_t n) {
+    if (n >= tl->queue_count) {
+        return NULL;
+    }
+    return &tl->queue[(tl->queue_head + n) % INTERP_QUEUE_DEPTH];
+}
+
+// Move to the next queued keyframe, continuing with the velocity the last segment ended on
+static bool begin_next_keyframe(Timeline *tl) {
+    const Keyframe *kf = queue_peek(tl, 0);
+    if (kf == NULL) {
+        return false;
+    }
+
+    int64_t v0[SERVO_CHANNEL_COUNT];
+    memcpy(v0, s_v_end, sizeof(v0));
+    Keyframe cur = *kf;
+    tl->queue_head = (uint8_t)((tl->queue_head + 1) % INTERP_QUEUE_DEPTH);
+    tl->queue_count--;
+
+    begin_hermite(tl, cur.target_us, cur.duration_us, v0, queue_peek(tl, 0));
+    return true;
+}
+
+static void start_timeline(Timeline *tl, const uint16_t *current_us, const uint16_t *target_us,
+                           uint32_t duration_us, InterpMode mode) {
+    for (int k = 0; k < tl->count; k++) {
+        int i = tl->channels[k];
+        s_start_us[i] = current_us[i];
+        s_target_us[i] = target_us[i];
+        s_pos_us[i] = current_us[i];
+        s_v_end[i] = secant_velocity((int32_t)target_us[i] - current_us[i], duration_us);
+    }
+
+    tl->duration_us = duration_us;
+    tl->elapsed_us = 0;
+    tl->mode = mode;
+    tl->profile = SEGMENT_LINEAR;
+    tl->active = true;
+    tl->queue_count = 0;
+}
+
+// The caller has checked the queue has room
+static void push_timeline(Timeline *tl, const uint16_t *target_us, uint32_t duration_us) {
+    Keyframe *kf = &tl->queue[(tl->queue_head + tl->queue_count) % INTERP_QUEUE_DEPTH];
+    memcpy(kf->target_us, target_us, sizeof(kf->target_us));
+    kf->duration_us = duration_us;
+    tl->queue_count++;
+
+    if (!tl->active) {
+        for (int k = 0; k < tl->count; k++) {
+            s_v_end[tl->channels[k]] = 0;
+        }
+        begin_next_keyframe(tl);
+    } else if (tl->queue_count == 1 && tl->profile == SEGMENT_HERMITE &&
+               tl->duration_us - tl->elapsed_us >= s_substep_us) {
+        // The running segment planned to stop; re-plan its remainder toward this keyframe
+        int64_t v0[SERVO_CHANNEL_COUNT];
+        uint16_t target[SERVO_CHANNEL_COUNT];
+        for (int k = 0; k < tl->count; k++) {
+            int i = tl->channels[k];
+            v0[i] = current_velocity(tl, i);
+        }
+        memcpy(target, s_target_us, sizeof(target));
+        begin_hermite(tl, target, tl->duration_us - tl->elapsed_us, v0, kf);
+    }
+}
+
+static void stop_timeline(Timeline *tl) {
+    tl->active = false;
+    tl->queue_count = 0;
+    for (int k = 0; k < tl->count; k++) {
+        s_v_end[tl->channels[k]] = 0;
+    }
+}
+
+// Returns true once the timeline has nothing left to play
+static bool advance_timeline(Timeline *tl, uint16_t *output_us, uint32_t elapsed_us) {
+    if (!tl->active) {
         return true;  // Already complete
     }
 
-    s_elapsed_ms += TICK_PERIOD_MS;
+    uint32_t steps = (elapsed_us + s_substep_us / 2) / s_substep_us;
+    if (steps == 0) steps = 1;
+    tl->elapsed_us += steps * s_substep_us;
 
-    if (s_elapsed_ms >= s_duration_ms) {
-        // Interpolation complete - snap to target
-        memcpy(output_us, s_target_us, sizeof(s_target_us));
-        s_active = false;
-        return true;
+    while (tl->elapsed_us >= tl->duration_us) {
+        uint32_t carry = tl->elapsed_us - tl->duration_us;
+        for (int k = 0; k < tl->count; k++) {
+            int i = tl->channels[k];
+            s_pos_us[i] = s_target_us[i];
+        }
+
+        if (!begin_next_keyframe(tl)) {
+            // Interpolation complete - snap to target
+            for (int k = 0; k < tl->count; k++) {
+                int i = tl->channels[k];
+                output_us[i] = s_target_us[i];
+            }
+            stop_timeline(tl);
+            return true;
+        }
+        tl->elapsed_us = carry;
     }
 
     // Calculate interpolation factor
-    if (s_mode == INTERP_MODE_FLOAT) {
-        float t = (float)s_elapsed_ms / (float)s_duration_ms;
-        for (int i = 0; i < SERVO_COUNT_TOTAL; i++) {
+    if (tl->profile == SEGMENT_HERMITE) {
+        evaluate_hermite(tl, output_us, (uint32_t)(((uint64_t)tl->elapsed_us << 16) / tl->duration_us));
+    } else if (tl->mode == INTERP_MODE_FLOAT) {
+        float t = (float)tl->elapsed_us / (float)tl->duration_us;
+        for (int k = 0; k < tl->count; k++) {
+            int i = tl->channels[k];
             float start = (float)s_start_us[i];
             float target = (float)s_target_us[i];
             output_us[i] = (uint16_t)(start + (target - start) * t);
         }
     } else {
         // Q16.16 fixed-point
-        uint32_t t_q16 = (s_elapsed_ms << 16) / s_duration_ms;
-        for (int i = 0; i < SERVO_COUNT_TOTAL; i++) {
+        uint32_t t_q16 = (uint32_t)(((uint64_t)tl->elapsed_us << 16) / tl->duration_us);
+        for (int k = 0; k < tl->count; k++) {
+            int i = tl->channels[k];
             int32_t start = (int32_t)s_start_us[i];
             int32_t target = (int32_t)s_target_us[i];
             int32_t delta = target - start;
@@ -63,9 +311,105 @@ bool interpolator_tick(uint16_t *output_us) {
         }
     }
 
+    for (int k = 0; k < tl->count; k++) {
+        int i = tl->channels[k];
+        s_pos_us[i] = output_us[i];
+    }
     return false;
 }
 
+void interpolator_start(const uint16_t *current_us, const uint16_t *target_us,
+                        uint32_t duration_ms, InterpMode mode) {
+    interpolator_start_groups(current_us, target_us, duration_ms, mode, SERVO_GROUP_ALL);
+}
+
+void interpolator_start_groups(const uint16_t *current_us, const uint16_t *target_us,
+                               uint32_t duration_ms, InterpMode mode, uint8_t groups) {
+    groups_init();
+    for (int g = 0; g < SERVO_GROUP_COUNT; g++) {
+        if (groups & (1u << g)) {
+            start_timeline(&s_groups[g], current_us, target_us, duration_to_us(duration_ms), mode);
+        }
+    }
+}
+
+bool interpolator_push(const uint16_t *target_us, uint32_t duration_ms) {
+    return interpolator_push_groups(target_us, duration_ms, SERVO_GROUP_ALL);
+}
+
+bool interpolator_push_groups(const uint16_t *target_us, uint32_t duration_ms, uint8_t groups) {
+    groups_init();
+    for (int g = 0; g < SERVO_GROUP_COUNT; g++) {
+        if ((groups & (1u << g)) && s_groups[g].queue_count >= INTERP_QUEUE_DEPTH) {
+            return false;
+        }
+    }
+
+    for (int g = 0; g < SERVO_GROUP_COUNT; g++) {
+        if (groups & (1u << g)) {
+            push_timeline(&s_groups[g], target_us, duration_to_us(duration_ms));
+        }
+    }
+    return true;
+}
+
+void interpolator_reset(const uint16_t *current_us) {
+    groups_init();
+    memcpy(s_pos_us, current_us, sizeof(s_pos_us));
+    for (int g = 0; g < SERVO_GROUP_COUNT; g++) {
+        stop_timeline(&s_groups[g]);
+    }
+}
+
+bool interpolator_is_idle(void) {
+    return interpolator_is_idle_groups(SERVO_GROUP_ALL);
+}
+
+bool interpolator_is_idle_groups(uint8_t groups) {
+    for (int g = 0; g < SERVO_GROUP_COUNT; g++) {
+        if ((groups & (1u << g)) && s_groups[g].active) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void interpolator_set_substeps(uint8_t substeps) {
+    if (substeps < INTERP_SUBSTEPS_MIN) substeps = INTERP_SUBSTEPS_MIN;
+    if (substeps > INTERP_SUBSTEPS_MAX) substeps = INTERP_SUBSTEPS_MAX;
+    s_substeps = substeps;
+    s_substep_us = s_tick_us / substeps;
+}
+
+void interpolator_set_tick_us(uint32_t tick_us) {
+    s_tick_us = tick_us ? tick_us : TICK_PERIOD_US;
+    s_substep_us = s_tick_us / s_substeps;
+}
+
+bool interpolator_tick(uint16_t *output_us) {
+    return interpolator_advance(output_us, s_tick_us);
+}
+
+bool interpolator_advance(uint16_t *output_us, uint32_t elapsed_us) {
+    uint32_t elapsed[SERVO_GROUP_COUNT];
+    for (int g = 0; g < SERVO_GROUP_COUNT; g++) {
+        elapsed[g] = elapsed_us;
+    }
+    return interpolator_advance_groups(output_us, elapsed);
+}
+
+bool interpolator_advance_groups(uint16_t *output_us, const uint32_t *elapsed_us) {
+    bool done = true;
+    for (int g = 0; g < SERVO_GROUP_COUNT; g++) {
+        if (!advance_timeline(&s_groups[g], output_us, elapsed_us[g])) {
+            done = false;
+        }
+    }
+    return done;
+}
+
 void interpolator_abort(void) {
-    s_active = false;
+    for (int g = 0; g < SERVO_GROUP_COUNT; g++) {
+        stop_timeline(&s_groups[g]);
+    }
 }
@@ -16,10 +16,33 @@ typedef enum {
 
 /**
  * Start interpolation from current to target over duration_ms.
+ * Linear, and drops any queued keyframes.
  */
 void interpolator_start(const uint16_t *current_us, const uint16_t *target_us,
                         uint32_t duration_ms, InterpMode mode);
 
+/**
+ * Queue a keyframe: reach target_us duration_ms after the previous one.
+ * Keyframes are joined by cubic Hermite segments in Q16 whose velocity is
+ * continuous across keyframes. The tangent at a keyframe comes from its
+ * neighbours and is zero where the motion reverses or the queue ends,
+ * so a keyframe is never overshot. A keyframe queued behind the last
+ * segment re-plans that segment from the current position and velocity.
+ * If idle, starts from the last output. Returns false if the queue is full.
+ */
+bool interpolator_push(const uint16_t *target_us, uint32_t duration_ms);
+
+/**
+ * Set the known output position with zero velocity and drop everything
+ * queued. Call before the first interpolator_push().
+ */
+void interpolator_reset(const uint16_t *current_us);
+
+/**
+ * True while no segment is running in any group.
+ */
+bool interpolator_is_idle(void);
+
 /**
  * Tick the interpolator (call at 50 Hz).
  * Updates output_us array with interpolated values.
@@ -27,6 +50,47 @@ void interpolator_start(const uint16_t *current_us, const uint16_t *target_us,
  */
 bool interpolator_tick(uint16_t *output_us);
 
+/**
+ * Advance by a measured time instead of one fixed tick. elapsed_us is
+ * rounded to the substep grid (one tick / substeps, at least one
+ * substep), so a segment started partway through a tick is timed from
+ * when it actually started. Time past the end of a segment carries into
+ * the next queued keyframe.
+ */
+bool interpolator_advance(uint16_t *output_us, uint32_t elapsed_us);
+
+/**
+ * Substeps per tick, clamped to INTERP_SUBSTEPS_MIN..INTERP_SUBSTEPS_MAX.
+ * With 1 (the default) every advance counts as a full tick.
+ */
+void interpolator_set_substeps(uint8_t substeps);
+
+/**
+ * Length of one tick, 1 / MOTION_UPDATE_HZ until set; the substep grid
+ * follows it. Call from the task that advances the interpolator.
+ */
+void interpolator_set_tick_us(uint32_t tick_us);
+
+/**
+ * Per-group forms of the calls above. groups is a mask of SERVO_GROUP_*
+ * bits (limits.h); only those groups' timelines are started, extended or
+ * looked at, and only their channels are read from target_us. The other
+ * groups keep their segments and queues. The forms without a mask
+ * address every group. interpolator_push_groups() queues nothing unless
+ * every addressed group has room.
+ */
+void interpolator_start_groups(const uint16_t *current_us, const uint16_t *target_us,
+                               uint32_t duration_ms, InterpMode mode, uint8_t groups);
+bool interpolator_push_groups(const uint16_t *target_us, uint32_t duration_ms, uint8_t groups);
+bool interpolator_is_idle_groups(uint8_t groups);
+
+/**
+ * interpolator_advance() with a separate elapsed time per group
+ * (SERVO_GROUP_COUNT values), for groups whose segment started partway
+ * through the tick. Returns true when every group is idle.
+ */
+bool interpolator_advance_groups(uint16_t *output_us, const uint32_t *elapsed_us);
+
 /**
  * Abort current interpolation (freeze at current position).
  */
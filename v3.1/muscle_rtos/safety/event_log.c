@@ -0,0 +1,137 @@
+/**
+ * Deferred Event Log Implementation
+ *
+ * The writer side of common/shared_log.h. Appends are serialized with a
+ * critical section; that is a handful of stores, far shorter than the
+ * printf it replaces. Each record's line is cleaned so the Brain's
+ * uncached view sees it.
+ */
+
+#include "event_log.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "cache_ops.h"
+#include "timebase.h"
+#include "versioning.h"
+
+#include <stdio.h>
+
+#define EVENT_LOG_TASK_STACK     384
+#define EVENT_LOG_TASK_PRIORITY  1      // Above idle only
+#define EVENT_LOG_DRAIN_MS       100
+
+// Minimum spacing between two records of the same event, in us (0 = every one)
+static const uint32_t s_min_interval_us[SHARED_LOG_EVT_COUNT] = {
+    [SHARED_LOG_EVT_PKT_MAGIC]   = 1000000,
+    [SHARED_LOG_EVT_PKT_VERSION] = 1000000,
+    [SHARED_LOG_EVT_PKT_CRC]     = 1000000,
+    [SHARED_LOG_EVT_PKT_SEQ]     = 1000000,
+    [SHARED_LOG_EVT_ESTOP]       = 100000,
+    [SHARED_LOG_EVT_ESTOP_INPUT] = 100000,  // Contact bounce
+    [SHARED_LOG_EVT_UNKNOWN_CMD] = 1000000,
+};
+
+static volatile SharedLogHeader *s_log = NULL;
+static uint64_t s_last_us[SHARED_LOG_EVT_COUNT];
+static uint16_t s_pending[SHARED_LOG_EVT_COUNT];   // Repeats not yet in a record
+
+static TaskHandle_t s_task_handle = NULL;
+
+static void event_log_task_entry(void *pvParameters);
+
+// Caller holds the critical section
+static void append_locked(uint16_t event, const uint32_t *args) {
+    if (s_log == NULL) {
+        return;
+    }
+
+    uint64_t now = timebase_shared_us();
+    uint16_t count = 1;
+
+    if (event < SHARED_LOG_EVT_COUNT) {
+        uint32_t interval = s_min_interval_us[event];
+        if (interval != 0 && s_last_us[event] != 0 && now - s_last_us[event] < interval) {
+            if (s_pending[event] < UINT16_MAX - 1) {
+                s_pending[event]++;
+            }
+            s_log->suppressed++;
+            return;
+        }
+        s_last_us[event] = now;
+        count += s_pending[event];
+        s_pending[event] = 0;
+    }
+
+    volatile SharedLogRecord *rec = shared_log_append(s_log, event, count, now, args);
+    cache_clean_range(rec, sizeof(*rec));
+    cache_clean_range(s_log, sizeof(*s_log));
+}
+
+void event_log_init(void) {
+    s_log = shared_log_area((volatile void *)SHARED_MEM_BASE);
+    shared_log_init(s_log);
+    cache_clean_range(s_log, SHARED_LOG_AREA_SIZE);
+
+    event_log(SHARED_LOG_EVT_BOOT, SPIDER_VERSION_MAJOR, SPIDER_VERSION_MINOR, 0, 0);
+}
+
+void event_log(uint16_t event, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3) {
+    const uint32_t args[SHARED_LOG_ARGS] = { a0, a1, a2, a3 };
+
+    taskENTER_CRITICAL();
+    append_locked(event, args);
+    taskEXIT_CRITICAL();
+}
+
+void event_log_from_isr(uint16_t event, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3) {
+    const uint32_t args[SHARED_LOG_ARGS] = { a0, a1, a2, a3 };
+
+    UBaseType_t saved = taskENTER_CRITICAL_FROM_ISR();
+    append_locked(event, args);
+    taskEXIT_CRITICAL_FROM_ISR(saved);
+}
+
+int event_log_task_create(void) {
+    BaseType_t result = xTaskCreate(
+        event_log_task_entry,
+        "event_log",
+        EVENT_LOG_TASK_STACK,
+        NULL,
+        EVENT_LOG_TASK_PRIORITY,
+        &s_task_handle
+    );
+
+    return (result == pdPASS) ? 0 : -1;
+}
+
+static void event_log_task_entry(void *pvParameters) {
+    (void)pvParameters;
+
+    uint32_t cursor = 0;
+    uint32_t lost_reported = 0;
+    uint32_t lost = 0;
+    SharedLogRecord rec;
+
+    while (1) {
+        while (s_log != NULL && shared_log_read(s_log, &cursor, &rec, &lost)) {
+            printf("[Spider] ");
+            printf(shared_log_format(rec.event),
+                   (unsigned long)rec.args[0], (unsigned long)rec.args[1],
+                   (unsigned long)rec.args[2], (unsigned long)rec.args[3]);
+            if (rec.count > 1) {
+                printf(" (x%u)", (unsigned)rec.count);
+            }
+            printf("\n");
+        }
+
+        if (lost != lost_reported) {
+            printf("[Spider] Event log: %lu records lost before printing\n",
+                   (unsigned long)(lost - lost_reported));
+            lost_reported = lost;
+        }
+
+        vTaskDelay(pdMS_TO_TICKS(EVENT_LOG_DRAIN_MS));
+    }
+}
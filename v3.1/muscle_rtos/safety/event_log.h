@@ -0,0 +1,50 @@
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include <stdint.h>
+#include "shared_log.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Deferred event log for Spider Robot v3.1
+ *
+ * Records fixed-size binary events into the shared log area
+ * (common/shared_log.h) in a few hundred cycles, so diagnostics can be
+ * left on in the packet and interrupt paths. Nothing is formatted here:
+ * a low-priority task echoes new records to the UART, and the Brain
+ * reads the same records from shared memory.
+ *
+ * Each event ID is rate limited: repeats within its minimum interval are
+ * only counted, and the count is folded into the next record of that ID.
+ */
+
+/**
+ * Reset the shared log area and record SHARED_LOG_EVT_BOOT.
+ * Call once at boot, before anything logs.
+ */
+void event_log_init(void);
+
+/**
+ * Record an event from task context.
+ */
+void event_log(uint16_t event, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3);
+
+/**
+ * Record an event from interrupt context.
+ */
+void event_log_from_isr(uint16_t event, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3);
+
+/**
+ * Create the low-priority task that formats new records to the UART.
+ * Returns 0 on success.
+ */
+int event_log_task_create(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EVENT_LOG_H
@@ -25,6 +25,7 @@ typedef enum {
     FAULT_SERVO_CLAMP       = (1 << 7),  // Value was clamped (info, not error)
     FAULT_I2C_ERROR         = (1 << 8),
     FAULT_ESTOP_ACTIVE      = (1 << 9),
+    FAULT_ESTOP_INPUT_POLLED = (1 << 10), // No E-STOP input interrupt; the line is sampled
 } FaultFlag;
 
 /**
@@ -0,0 +1,122 @@
+/**
+ * Load Monitor Implementation
+ *
+ * Accumulators are shared between the tasks that record and the output
+ * task that publishes, so both sides take them under a critical section;
+ * each update is a handful of adds.
+ */
+
+#include "load_monitor.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "limits.h"
+#include "timebase.h"
+
+#include <string.h>
+
+#define NOMINAL_PERIOD_US   (1000000UL / MOTION_UPDATE_HZ)
+
+static uint32_t s_nominal_period_us = NOMINAL_PERIOD_US;   // Output task only
+
+typedef struct {
+    uint32_t min_cycles;
+    uint32_t max_cycles;
+    uint32_t sum_cycles;
+    uint32_t count;
+} StageWindow;
+
+// The task each top-level stage belongs to; nested stages count under their parent
+static const int8_t s_stage_task[SHARED_LOAD_STAGE_COUNT] = {
+    [SHARED_LOAD_STAGE_TICK] = SHARED_LOAD_TASK_OUTPUT,
+    [SHARED_LOAD_STAGE_MOTION] = SHARED_LOAD_TASK_MOTION,
+    [SHARED_LOAD_STAGE_VALIDATE] = -1,
+    [SHARED_LOAD_STAGE_I2C] = -1,
+    [SHARED_LOAD_STAGE_WATCHDOG] = SHARED_LOAD_TASK_WATCHDOG,
+};
+
+static StageWindow s_window[SHARED_LOAD_STAGE_COUNT];
+static uint32_t s_window_start = 0;         // load_cycles() when the window opened, 0 = not yet
+static uint32_t s_jitter_hist[SHARED_JITTER_BINS];
+static uint16_t s_stack_free[SHARED_LOAD_TASK_COUNT];
+static uint64_t s_stack_checked_us[SHARED_LOAD_TASK_COUNT];
+
+void load_monitor_record(uint8_t stage, uint32_t cycles) {
+    if (stage >= SHARED_LOAD_STAGE_COUNT) {
+        return;
+    }
+
+    taskENTER_CRITICAL();
+    StageWindow *w = &s_window[stage];
+    if (w->count == 0 || cycles < w->min_cycles) w->min_cycles = cycles;
+    if (cycles > w->max_cycles) w->max_cycles = cycles;
+    w->sum_cycles += cycles;
+    w->count++;
+    taskEXIT_CRITICAL();
+}
+
+void load_monitor_set_nominal_period(uint32_t period_us) {
+    s_nominal_period_us = period_us;
+}
+
+void load_monitor_tick_period(uint32_t period_us) {
+    uint32_t deviation = (period_us > s_nominal_period_us) ? period_us - s_nominal_period_us
+                                                           : s_nominal_period_us - period_us;
+    s_jitter_hist[shared_jitter_bin(deviation)]++;
+}
+
+void load_monitor_check_stack(uint8_t task) {
+    if (task >= SHARED_LOAD_TASK_COUNT) {
+        return;
+    }
+
+    uint64_t now = timebase_shared_us();
+    if (s_stack_checked_us[task] != 0 && now - s_stack_checked_us[task] < LOAD_STACK_CHECK_US) {
+        return;
+    }
+    s_stack_checked_us[task] = now;
+
+    UBaseType_t free_words = uxTaskGetStackHighWaterMark(NULL);
+    s_stack_free[task] = (uint16_t)((free_words > 0xFFFF) ? 0xFFFF : free_words);
+}
+
+void load_monitor_publish(SharedTelemetryData *d, int roll) {
+    d->cycles_per_us = LOAD_CYCLES_PER_US;
+    memcpy(d->jitter_hist, s_jitter_hist, sizeof(d->jitter_hist));
+    memcpy(d->stack_free_words, s_stack_free, sizeof(d->stack_free_words));
+
+    if (!roll) {
+        return;
+    }
+
+    StageWindow window[SHARED_LOAD_STAGE_COUNT];
+    uint32_t now = load_cycles();
+    taskENTER_CRITICAL();
+    memcpy(window, s_window, sizeof(window));
+    memset(s_window, 0, sizeof(s_window));
+    taskEXIT_CRITICAL();
+
+    uint32_t span = now - s_window_start;
+    int first = (s_window_start == 0);
+    s_window_start = now;
+    if (first) {
+        return;     // The first window started at boot, not at a roll
+    }
+
+    uint32_t busy[SHARED_LOAD_TASK_COUNT] = { 0 };
+    for (int i = 0; i < SHARED_LOAD_STAGE_COUNT; i++) {
+        SharedLoadStage *st = &d->stage[i];
+        st->count = window[i].count;
+        st->min_cycles = window[i].min_cycles;
+        st->max_cycles = window[i].max_cycles;
+        st->avg_cycles = window[i].count ? window[i].sum_cycles / window[i].count : 0;
+        if (s_stage_task[i] >= 0) {
+            busy[s_stage_task[i]] += window[i].sum_cycles;
+        }
+    }
+    for (int t = 0; t < SHARED_LOAD_TASK_COUNT; t++) {
+        uint64_t permille = span ? (uint64_t)busy[t] * 1000 / span : 0;
+        d->task_load_permille[t] = (uint16_t)((permille > 1000) ? 1000 : permille);
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef LOAD_MONITOR_H
+#define LOAD_MONITOR_H
+
+#include <stdint.h>
+#include "shared_telemetry.h"
+
+#if !defined(__riscv)
+#include <time.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Load monitor for Spider Robot v3.1
+ *
+ * Times the Muscle's hot paths with the CPU cycle counter and folds them
+ * into 1 s windows: per-stage min/avg/max cycles (SHARED_LOAD_STAGE_*),
+ * the share of each window every task spent busy, each task's stack
+ * high-water mark and a since-boot histogram of tick period jitter. The
+ * output task copies it all into the shared telemetry block, so nothing
+ * is formatted on this core.
+ *
+ * Task load comes from the stages themselves (the output tick, the
+ * motion pass, the watchdog check) rather than FreeRTOS run-time stats,
+ * which need a run-time counter the SDK config does not enable.
+ */
+
+#if defined(__riscv)
+#define LOAD_CYCLES_PER_US  700         // C906L at 700 MHz
+#else
+#define LOAD_CYCLES_PER_US  1000        // Host builds count nanoseconds
+#endif
+
+// How often a task's stack high-water mark is refreshed
+#define LOAD_STACK_CHECK_US 1000000ULL
+
+static inline uint32_t load_cycles(void) {
+#if defined(__riscv)
+    uint64_t cycles;
+    __asm volatile ("rdcycle %0" : "=r"(cycles));
+    return (uint32_t)cycles;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec);
+#endif
+}
+
+/**
+ * Record one run of stage that took cycles (load_cycles() delta).
+ * Any task.
+ */
+void load_monitor_record(uint8_t stage, uint32_t cycles);
+
+/**
+ * Record the measured spacing of two output ticks against the nominal
+ * period (1 / MOTION_UPDATE_HZ unless set). Output task only.
+ */
+void load_monitor_tick_period(uint32_t period_us);
+void load_monitor_set_nominal_period(uint32_t period_us);
+
+/**
+ * Refresh the calling task's stack high-water mark, at most once per
+ * LOAD_STACK_CHECK_US. task is a SHARED_LOAD_TASK_* index.
+ */
+void load_monitor_check_stack(uint8_t task);
+
+/**
+ * Fill the load fields of d. With roll set the current window closes:
+ * its stage statistics and task load replace the published ones and a
+ * new window starts. Output task only.
+ */
+void load_monitor_publish(SharedTelemetryData *d, int roll);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LOAD_MONITOR_H
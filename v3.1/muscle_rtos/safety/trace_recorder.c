@@ -0,0 +1,46 @@
+/**
+ * Latency Trace Recorder Implementation
+ *
+ * The Muscle writer of common/shared_trace.h. Like the event log, appends
+ * are serialized with a critical section and each record's line is
+ * cleaned for the Brain's uncached view.
+ */
+
+#include "trace_recorder.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "cache_ops.h"
+#include "timebase.h"
+
+static volatile SharedTraceHeader *s_trace = NULL;
+
+// Caller holds the critical section
+static void append_locked(uint16_t probe, uint32_t arg, uint32_t arg2) {
+    if (s_trace == NULL) {
+        return;
+    }
+
+    volatile SharedTraceRecord *rec = shared_trace_append(s_trace, probe, timebase_shared_us(), arg, arg2);
+    cache_clean_range(rec, sizeof(*rec));
+    cache_clean_range(s_trace, sizeof(*s_trace));
+}
+
+void trace_init(void) {
+    s_trace = shared_trace_area((volatile void *)SHARED_MEM_BASE);
+    shared_trace_init(s_trace, SHARED_TRACE_RECORDS);
+    cache_clean_range(s_trace, SHARED_TRACE_AREA_SIZE);
+}
+
+void trace_point(uint16_t probe, uint32_t arg, uint32_t arg2) {
+    taskENTER_CRITICAL();
+    append_locked(probe, arg, arg2);
+    taskEXIT_CRITICAL();
+}
+
+void trace_point_from_isr(uint16_t probe, uint32_t arg, uint32_t arg2) {
+    UBaseType_t saved = taskENTER_CRITICAL_FROM_ISR();
+    append_locked(probe, arg, arg2);
+    taskEXIT_CRITICAL_FROM_ISR(saved);
+}
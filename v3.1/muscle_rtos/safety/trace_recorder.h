@@ -0,0 +1,40 @@
+#ifndef TRACE_RECORDER_H
+#define TRACE_RECORDER_H
+
+#include <stdint.h>
+#include "shared_trace.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Latency trace recorder for Spider Robot v3.1
+ *
+ * Muscle half of common/shared_trace.h: each probe along the packet path
+ * (mailbox IRQ, dequeue, validation, output start, I2C done) appends one
+ * 32-byte record on the shared timebase into the trace area. Nothing is
+ * formatted on this core; the Brain merges these records with its own
+ * on `trace_dump`.
+ */
+
+/**
+ * Reset the shared trace area. Call once at boot, before any probe.
+ */
+void trace_init(void);
+
+/**
+ * Record a probe from task context.
+ */
+void trace_point(uint16_t probe, uint32_t arg, uint32_t arg2);
+
+/**
+ * Record a probe from interrupt context.
+ */
+void trace_point_from_isr(uint16_t probe, uint32_t arg, uint32_t arg2);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TRACE_RECORDER_H
@@ -2,14 +2,21 @@
  * Watchdog Subsystem Implementation
  *
  * Independent FreeRTOS task monitors heartbeat from Brain.
- * - 250 ms timeout → HOLD state
+ * - 250 ms timeout → HOLD state (runtime tunable, shared_tunables.h)
  * - ESTOP flag → immediate safe state
  * - Uses atomic operations for thread-safe state access
+ *
+ * The task sleeps on a notification timeout until last feed + timeout.
+ * A feed only stores its tick, so while the Brain is healthy the task
+ * wakes once per timeout period, finds the deadline moved and sleeps
+ * again; when nothing moved it, the timeout fires exactly on time. It is
+ * notified only to leave TIMEOUT/HOLD/ESTOP, where there is no deadline.
  */
 
 #include "watchdog.h"
 #include "failsafe.h"
 #include "fault_flags.h"
+#include "load_monitor.h"
 
 #include "FreeRTOS.h"
 #include "task.h"
@@ -21,18 +28,27 @@
 
 #define WATCHDOG_TASK_STACK     256
 #define WATCHDOG_TASK_PRIORITY  (configMAX_PRIORITIES - 1)  // Highest priority
-#define WATCHDOG_CHECK_PERIOD_MS  25  // Check 4x per timeout period
+#define WATCHDOG_ALIVE_SAMPLE_MS  50  // brain_alive sampling, twice per Brain heartbeat period
 
 static TaskHandle_t s_watchdog_task_handle = NULL;
 
 static volatile _Atomic WatchdogState s_state = WATCHDOG_STATE_NORMAL;
 static volatile _Atomic TickType_t s_last_feed_tick = 0;
+static volatile _Atomic TickType_t s_timeout_ticks = pdMS_TO_TICKS(HEARTBEAT_TIMEOUT_MS);
+static const volatile uint32_t *_Atomic s_alive_counter = NULL;
+static uint32_t s_alive_seen = 0;           // Watchdog task only
 
 static WatchdogTimeoutCallback s_timeout_cb = NULL;
 static WatchdogEstopCallback s_estop_cb = NULL;
 
 static void watchdog_task_entry(void *pvParameters);
 
+static void watchdog_wake(void) {
+    if (s_watchdog_task_handle != NULL) {
+        xTaskNotify(s_watchdog_task_handle, 0, eNoAction);
+    }
+}
+
 void watchdog_init(WatchdogTimeoutCallback timeout_cb, WatchdogEstopCallback estop_cb) {
     s_timeout_cb = timeout_cb;
     s_estop_cb = estop_cb;
@@ -60,9 +76,39 @@ void watchdog_feed(void) {
     if (current == WATCHDOG_STATE_TIMEOUT || current == WATCHDOG_STATE_HOLD) {
         atomic_store(&s_state, WATCHDOG_STATE_NORMAL);
         fault_flags_clear(FAULT_HEARTBEAT_TIMEOUT);
+        watchdog_wake();        // Re-arm the deadline
+    }
+}
+
+void watchdog_feed_from_isr(void) {
+    atomic_store(&s_last_feed_tick, xTaskGetTickCountFromISR());
+
+    if (atomic_load(&s_state) != WATCHDOG_STATE_NORMAL && s_watchdog_task_handle != NULL) {
+        BaseType_t woken = pdFALSE;
+        xTaskNotifyFromISR(s_watchdog_task_handle, 0, eNoAction, &woken);
+        portYIELD_FROM_ISR(woken);
     }
 }
 
+void watchdog_set_alive_counter(const volatile uint32_t *counter) {
+    atomic_store(&s_alive_counter, counter);
+    watchdog_wake();            // Start or stop sampling
+}
+
+void watchdog_set_timeout_ms(uint32_t timeout_ms) {
+    TickType_t ticks = pdMS_TO_TICKS(timeout_ms);
+    if (ticks == 0) {
+        ticks = 1;
+    }
+    if (atomic_exchange(&s_timeout_ticks, ticks) != ticks) {
+        watchdog_wake();        // Re-arm against the new deadline
+    }
+}
+
+uint32_t watchdog_get_timeout_ms(void) {
+    return (uint32_t)(atomic_load(&s_timeout_ticks) * portTICK_PERIOD_MS);
+}
+
 void watchdog_signal_estop(void) {
     atomic_store(&s_state, WATCHDOG_STATE_ESTOP);
     fault_flags_set(FAULT_ESTOP_ACTIVE);
@@ -81,13 +127,15 @@ int watchdog_clear_estop(void) {
     TickType_t now = xTaskGetTickCount();
     TickType_t last = atomic_load(&s_last_feed_tick);
 
-    if ((now - last) < pdMS_TO_TICKS(HEARTBEAT_TIMEOUT_MS)) {
+    if ((now - last) < atomic_load(&s_timeout_ticks)) {
         atomic_store(&s_state, WATCHDOG_STATE_NORMAL);
         fault_flags_clear(FAULT_ESTOP_ACTIVE);
+        watchdog_wake();
         return 0;
     }
 
     atomic_store(&s_state, WATCHDOG_STATE_HOLD);
+    watchdog_wake();
     return -1;
 }
 
@@ -106,24 +154,48 @@ uint32_t watchdog_get_ms_since_feed(void) {
     return (uint32_t)((now - last) * portTICK_PERIOD_MS);
 }
 
+// Newest of the stored feed and stamp, by age at now (tick wrap safe)
+static void watchdog_note_feed(TickType_t now, TickType_t stamp) {
+    TickType_t last = atomic_load(&s_last_feed_tick);
+    if ((TickType_t)(now - stamp) < (TickType_t)(now - last)) {
+        atomic_store(&s_last_feed_tick, stamp);
+    }
+}
+
 static void watchdog_task_entry(void *pvParameters) {
     (void)pvParameters;
 
-    TickType_t last_wake = xTaskGetTickCount();
+    const TickType_t sample = pdMS_TO_TICKS(WATCHDOG_ALIVE_SAMPLE_MS);
+    TickType_t last_sample = xTaskGetTickCount();
 
     while (1) {
+        uint32_t start = load_cycles();
         TickType_t now = xTaskGetTickCount();
-        TickType_t last_feed = atomic_load(&s_last_feed_tick);
-        WatchdogState current = atomic_load(&s_state);
 
-        if (current == WATCHDOG_STATE_ESTOP) {
-            vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(WATCHDOG_CHECK_PERIOD_MS));
-            continue;
+        // brain_alive has no event to wait on. A bump seen now happened
+        // after the previous sample, so that is the feed time credited:
+        // the timeout may fire up to one sample period early, never late.
+        const volatile uint32_t *alive = atomic_load(&s_alive_counter);
+        if (alive != NULL) {
+            uint32_t value = *alive;
+            if (value != s_alive_seen) {
+                s_alive_seen = value;
+                watchdog_note_feed(now, last_sample);
+            }
+            last_sample = now;
         }
 
+        // Load the feed before reading the clock so a feed in between cannot look ahead of now
+        TickType_t last_feed = atomic_load(&s_last_feed_tick);
+        TickType_t timeout = atomic_load(&s_timeout_ticks);
+        now = xTaskGetTickCount();
+        WatchdogState current = atomic_load(&s_state);
         TickType_t elapsed = now - last_feed;
+        TickType_t wait = portMAX_DELAY;
 
-        if (elapsed > pdMS_TO_TICKS(HEARTBEAT_TIMEOUT_MS)) {
+        if (current == WATCHDOG_STATE_ESTOP) {
+            // Nothing to time until watchdog_clear_estop()
+        } else if (elapsed >= timeout) {
             if (current == WATCHDOG_STATE_NORMAL) {
                 atomic_store(&s_state, WATCHDOG_STATE_TIMEOUT);
                 fault_flags_set(FAULT_HEARTBEAT_TIMEOUT);
@@ -137,8 +209,21 @@ static void watchdog_task_entry(void *pvParameters) {
                 atomic_store(&s_state, WATCHDOG_STATE_HOLD);
                 failsafe_enter_hold();
             }
+        } else {
+            if (current == WATCHDOG_STATE_TIMEOUT || current == WATCHDOG_STATE_HOLD) {
+                // Fed again, via watchdog_feed_from_isr() or brain_alive
+                atomic_store(&s_state, WATCHDOG_STATE_NORMAL);
+                fault_flags_clear(FAULT_HEARTBEAT_TIMEOUT);
+            }
+            wait = timeout - elapsed;
+        }
+
+        if (alive != NULL && current != WATCHDOG_STATE_ESTOP && wait > sample) {
+            wait = sample;
         }
 
-        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(WATCHDOG_CHECK_PERIOD_MS));
+        load_monitor_record(SHARED_LOAD_STAGE_WATCHDOG, load_cycles() - start);
+        load_monitor_check_stack(SHARED_LOAD_TASK_WATCHDOG);
+        xTaskNotifyWait(0, 0, NULL, wait);
     }
 }
@@ -44,10 +44,34 @@ int watchdog_task_create(void);
 
 /**
  * Feed the watchdog (call when valid PosePacket31 received).
- * Thread-safe, can be called from any task.
+ * Thread-safe, can be called from any task. Only stores the tick while
+ * NORMAL; the watchdog task picks up the new deadline when it wakes.
  */
 void watchdog_feed(void);
 
+/**
+ * Feed the watchdog from interrupt context (mailbox heartbeat).
+ * Records the tick and, outside NORMAL, notifies the watchdog task,
+ * which performs the recovery from TIMEOUT/HOLD.
+ */
+void watchdog_feed_from_isr(void);
+
+/**
+ * Also count the Brain as alive whenever *counter changes (the shared
+ * ring's brain_alive). The counter has no event, so the watchdog task
+ * samples it every WATCHDOG_ALIVE_SAMPLE_MS while set and the Brain needs
+ * no heartbeat interrupt. NULL stops sampling. Task context.
+ */
+void watchdog_set_alive_counter(const volatile uint32_t *counter);
+
+/**
+ * Heartbeat timeout, HEARTBEAT_TIMEOUT_MS until set. A change takes
+ * effect against the last feed at once: shortening it below the time
+ * already elapsed times out on the watchdog task's next pass. Any task.
+ */
+void watchdog_set_timeout_ms(uint32_t timeout_ms);
+uint32_t watchdog_get_timeout_ms(void);
+
 /**
  * Signal ESTOP condition.
  * Immediately triggers ESTOP callback and enters ESTOP state.
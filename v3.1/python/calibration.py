@@ -7,10 +7,18 @@ Offsets are stored in ~/.spider_calibration.json and applied to PWM values
 to ensure mechanical center matches 90°.
 
 Calibration range: -30° to +30° (from limits.h CALIB_OFFSET_MIN/MAX_DEG)
+
+--export writes the binary table the Brain applies itself
+(common/servo_calib_format.h), so clients can send logical pulse widths:
+    python calibration.py --export servo_calib.bin
+    scp servo_calib.bin root@192.168.42.1:/root/
+then {"cmd":"calib_reload"} or restart the daemon. Optional "direction",
+"scale", "min_us" and "max_us" lists in the JSON file go into the table too.
 """
 
 import json
 import os
+import struct
 import sys
 from pathlib import Path
 from typing import Dict, List, Optional, Any
@@ -25,6 +33,14 @@ CALIB_OFFSET_MAX_DEG = 30
 SERVO_COUNT = 12
 SERVO_COUNT_TOTAL = 13
 SERVO_NEUTRAL_US = 1500
+SERVO_PWM_MIN_US = 500
+SERVO_PWM_MAX_US = 2500
+
+SERVO_CALIB_MAGIC = 0x4C435353      # "SSCL"
+SERVO_CALIB_VERSION = 0x0100
+SERVO_CALIB_SCALE_ONE = 4096        # Q12
+CALIB_HEADER = struct.Struct("<IHHII")        # 16 bytes
+CALIB_CHANNEL = struct.Struct("<hbBHHHH")     # 12 bytes
 
 DEFAULT_CALIB_PATH = Path.home() / ".spider_calibration.json"
 
@@ -71,6 +87,10 @@ class CalibrationData:
         self.path = path or DEFAULT_CALIB_PATH
         self.version = 1
         self.offsets_deg: List[float] = [0.0] * SERVO_COUNT_TOTAL
+        self.direction: List[int] = [1] * SERVO_COUNT_TOTAL
+        self.scale: List[float] = [1.0] * SERVO_COUNT_TOTAL
+        self.min_us: List[int] = [SERVO_PWM_MIN_US] * SERVO_COUNT_TOTAL
+        self.max_us: List[int] = [SERVO_PWM_MAX_US] * SERVO_COUNT_TOTAL
         self.notes: Dict[str, str] = CHANNEL_NOTES.copy()
     
     def load(self) -> bool:
@@ -94,6 +114,15 @@ class CalibrationData:
                 for o in offsets[:SERVO_COUNT_TOTAL]
             ]
             
+            def channels(key, default):
+                values = list(data.get(key, []))[:SERVO_COUNT_TOTAL]
+                return values + [default] * (SERVO_COUNT_TOTAL - len(values))
+
+            self.direction = [-1 if int(d) < 0 else 1 for d in channels("direction", 1)]
+            self.scale = [max(0.5, min(2.0, float(v))) for v in channels("scale", 1.0)]
+            self.min_us = [max(SERVO_PWM_MIN_US, int(v)) for v in channels("min_us", SERVO_PWM_MIN_US)]
+            self.max_us = [min(SERVO_PWM_MAX_US, int(v)) for v in channels("max_us", SERVO_PWM_MAX_US)]
+            
             self.notes = data.get("notes", CHANNEL_NOTES.copy())
             print(f"Loaded calibration from {self.path}")
             return True
@@ -108,6 +137,10 @@ class CalibrationData:
             data = {
                 "version": self.version,
                 "offsets_deg": self.offsets_deg,
+                "direction": self.direction,
+                "scale": self.scale,
+                "min_us": self.min_us,
+                "max_us": self.max_us,
                 "notes": self.notes,
             }
             
@@ -121,6 +154,26 @@ class CalibrationData:
             print(f"Error saving calibration: {e}")
             return False
     
+    def export_binary(self, path: Path) -> bool:
+        """Write the Brain-side calibration table (servo_calib_format.h)."""
+        body = b""
+        for ch in range(SERVO_COUNT_TOTAL):
+            lo, hi = self.min_us[ch], self.max_us[ch]
+            if lo > hi:
+                print(f"Channel {ch}: min_us {lo} above max_us {hi}")
+                return False
+            body += CALIB_CHANNEL.pack(self.get_offset_us(ch), self.direction[ch], 0,
+                                       int(round(self.scale[ch] * SERVO_CALIB_SCALE_ONE)), lo, hi, 0)
+        header = CALIB_HEADER.pack(SERVO_CALIB_MAGIC, SERVO_CALIB_VERSION, SERVO_COUNT_TOTAL,
+                                   CALIB_HEADER.size + len(body), 0)
+        try:
+            Path(path).write_bytes(header + body)
+        except IOError as e:
+            print(f"Error writing calibration table: {e}")
+            return False
+        print(f"Wrote calibration table to {path}")
+        return True
+    
     def get_offset_deg(self, channel: int) -> float:
         """Get offset for a channel in degrees."""
         if 0 <= channel < len(self.offsets_deg):
@@ -401,6 +454,8 @@ def main():
     parser.add_argument("--calib-file", type=str, default=None, 
                        help=f"Calibration file path (default: {DEFAULT_CALIB_PATH})")
     parser.add_argument("--show", action="store_true", help="Show current calibration and exit")
+    parser.add_argument("--export", type=str, metavar="PATH",
+                       help="Write the binary table for the Brain (--servo-calib) and exit")
     parser.add_argument("--leg", type=int, choices=[0, 1, 2, 3], 
                        help="Calibrate specific leg only")
     parser.add_argument("--channel", type=int, help="Calibrate specific channel only")
@@ -414,6 +469,11 @@ def main():
         calib.print_summary()
         return 0
     
+    if args.export:
+        calib = CalibrationData(calib_path)
+        calib.load()
+        return 0 if calib.export_binary(Path(args.export)) else 1
+    
     client = SpiderClient(host=args.ip, port=args.port)
     
     if not client.connect():
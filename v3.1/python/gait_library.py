@@ -124,25 +124,11 @@ class GaitGenerator:
 
     def _get_leg_pose(self, leg_idx: int) -> LegPose:
         """Get current pose of a specific leg."""
-        if leg_idx == 0:
-            return self.current_pose.leg0
-        elif leg_idx == 1:
-            return self.current_pose.leg1
-        elif leg_idx == 2:
-            return self.current_pose.leg2
-        else:
-            return self.current_pose.leg3
+        return getattr(self.current_pose, f"leg{leg_idx}")
 
     def _set_leg_pose(self, leg_idx: int, pose: LegPose):
         """Set pose for a specific leg."""
-        if leg_idx == 0:
-            self.current_pose.leg0 = pose
-        elif leg_idx == 1:
-            self.current_pose.leg1 = pose
-        elif leg_idx == 2:
-            self.current_pose.leg2 = pose
-        else:
-            self.current_pose.leg3 = pose
+        setattr(self.current_pose, f"leg{leg_idx}", pose)
 
     def stand(self):
         """Move to neutral standing pose."""
@@ -0,0 +1,142 @@
+#!/usr/bin/env python3
+"""
+Spider Robot v3.1 - Motion Pack Compiler
+
+Compiles JSON motion sequences into the binary motion pack the Brain
+mmaps for the `play` command (layout in common/motion_pack_format.h).
+Frames are clamped and calibration offsets applied here, so the daemon
+never parses or adjusts them at runtime.
+
+Input format (same as the archived MotionLoader):
+    {"sequences": {
+        "wave": {"frames": [
+            {"servo_us": [1500, 1400, ...], "t_ms": 200},
+            ...
+        ]}
+    }}
+
+servo_us may list the first 8 (legs) or all 13 channels; the sequence
+drives exactly the channels its first frame lists. Optional per-frame
+"hold": true and "q16": true set FLAG_HOLD / FLAG_INTERP_Q16.
+
+Usage:
+    python motion_pack.py motions.json -o motions.smp [--calib ~/.spider_calibration.json]
+    scp motions.smp root@192.168.42.1:/root/
+"""
+
+import argparse
+import json
+import struct
+import sys
+from pathlib import Path
+from typing import Dict, List, Optional
+
+MOTION_PACK_MAGIC = 0x4B504D53      # "SMPK"
+MOTION_PACK_VERSION = 0x0100
+MOTION_PACK_NAME_LEN = 24
+
+SERVO_COUNT_TOTAL = 13
+SERVO_PWM_MIN_US = 500
+SERVO_PWM_MAX_US = 2500
+CALIB_OFFSET_MIN_DEG = -30
+CALIB_OFFSET_MAX_DEG = 30
+
+FLAG_HOLD = 0x0002
+FLAG_INTERP_Q16 = 0x0008
+
+HEADER = struct.Struct("<IHHIIII8x")            # 32 bytes
+ENTRY = struct.Struct("<24sIIIIHH4x")           # 48 bytes
+FRAME = struct.Struct("<IH13H")                 # 32 bytes
+
+
+def fnv1a(name: str) -> int:
+    """FNV-1a, as json_hash() / motion_pack_hash() on the Brain."""
+    h = 2166136261
+    for b in name.encode("utf-8"):
+        h ^= b
+        h = (h * 16777619) & 0xFFFFFFFF
+    return h
+
+
+def load_offsets_us(path: Optional[Path]) -> List[int]:
+    """Per-channel calibration offsets in us (calibration.py format)."""
+    offsets = [0] * SERVO_COUNT_TOTAL
+    if path is None:
+        return offsets
+    with open(path) as f:
+        data = json.load(f)
+    for ch, deg in enumerate(data.get("offsets_deg", [])[:SERVO_COUNT_TOTAL]):
+        deg = max(CALIB_OFFSET_MIN_DEG, min(CALIB_OFFSET_MAX_DEG, float(deg)))
+        offsets[ch] = int(deg * (2000.0 / 180.0))
+    return offsets
+
+
+def compile_pack(sequences: Dict[str, dict], offsets_us: List[int]) -> bytes:
+    entries = []
+    frames = []
+
+    for name, seq in sequences.items():
+        encoded = name.encode("utf-8")
+        if len(encoded) >= MOTION_PACK_NAME_LEN:
+            raise ValueError(f"sequence name too long (max {MOTION_PACK_NAME_LEN - 1}): {name}")
+        seq_frames = seq.get("frames", [])
+        if not seq_frames:
+            raise ValueError(f"sequence has no frames: {name}")
+
+        channels = len(seq_frames[0].get("servo_us", []))
+        if channels == 0 or channels > SERVO_COUNT_TOTAL:
+            raise ValueError(f"{name}: servo_us must list 1-{SERVO_COUNT_TOTAL} channels")
+        mask = (1 << channels) - 1
+
+        first = len(frames)
+        duration = 0
+        for i, frame in enumerate(seq_frames):
+            us = list(frame.get("servo_us", []))
+            if len(us) != channels:
+                raise ValueError(f"{name} frame {i}: expected {channels} channels, got {len(us)}")
+            out = [1500] * SERVO_COUNT_TOTAL
+            for ch, value in enumerate(us):
+                value = int(value) + offsets_us[ch]
+                out[ch] = max(SERVO_PWM_MIN_US, min(SERVO_PWM_MAX_US, value))
+
+            t_ms = max(0, int(frame.get("t_ms", 100)))
+            flags = (FLAG_HOLD if frame.get("hold") else 0) | (FLAG_INTERP_Q16 if frame.get("q16") else 0)
+            frames.append(FRAME.pack(t_ms, flags, *out))
+            duration += t_ms
+
+        entries.append(ENTRY.pack(encoded, fnv1a(name), first, len(seq_frames), duration, mask, 0))
+
+    index_offset = HEADER.size
+    frames_offset = index_offset + len(entries) * ENTRY.size
+    file_size = frames_offset + len(frames) * FRAME.size
+    header = HEADER.pack(MOTION_PACK_MAGIC, MOTION_PACK_VERSION, len(entries), len(frames),
+                         index_offset, frames_offset, file_size)
+    return header + b"".join(entries) + b"".join(frames)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compile JSON motion sequences into a motion pack")
+    parser.add_argument("input", type=Path, help="JSON motion file")
+    parser.add_argument("-o", "--output", type=Path, default=Path("motions.smp"))
+    parser.add_argument("--calib", type=Path, help="calibration JSON to bake into the frames")
+    args = parser.parse_args()
+
+    with open(args.input) as f:
+        root = json.load(f)
+    if not isinstance(root.get("sequences"), dict):
+        print("error: input needs a \"sequences\" object", file=sys.stderr)
+        return 1
+
+    try:
+        pack = compile_pack(root["sequences"], load_offsets_us(args.calib))
+    except ValueError as e:
+        print(f"error: {e}", file=sys.stderr)
+        return 1
+
+    args.output.write_bytes(pack)
+    print(f"Wrote {args.output}: {len(root['sequences'])} sequences, {len(pack)} bytes")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -10,6 +10,7 @@ Default endpoint: ws://192.168.42.1:9000
 """
 
 import json
+import struct
 import time
 from typing import Optional, List, Dict, Any
 
@@ -208,6 +209,53 @@ class SpiderClient:
         self.send_command(command)
         return True
     
+    def send_pose_binary(self, poses: List[List[int]], t_ms: int = 0, flags: int = 0,
+                         want_ack: bool = False,
+                         schedule: bool = False) -> Optional[Dict[str, int]]:
+        """
+        Stream one or more 13-channel poses as a binary frame (opcode 0x02).
+        
+        Args:
+            poses: List of SERVO_COUNT_TOTAL pulse widths per pose (max 64 poses)
+            t_ms: Interpolation time for each pose
+            flags: PosePacket31 flags (HOLD / INTERP_Q16 / SCAN_ENABLE)
+            want_ack: Wait for the Brain's binary ack
+            schedule: Play poses back to back at t_ms spacing on the Muscle's clock
+        
+        Returns:
+            {"accepted", "status", "seq"} if an ack was received, else None
+        """
+        if not self.connected or not self.ws:
+            print("ERROR: Not connected to Brain daemon")
+            return None
+        if not 1 <= len(poses) <= 64:
+            print(f"ERROR: Expected 1..64 poses, got {len(poses)}")
+            return None
+        
+        req_flags = (0x01 if want_ack else 0) | (0x02 if schedule else 0)
+        frame = struct.pack("<BBBB", 0x31, len(poses), req_flags, 0)
+        for pose in poses:
+            if len(pose) != self.SERVO_COUNT_TOTAL:
+                print(f"ERROR: Expected {self.SERVO_COUNT_TOTAL} values per pose, got {len(pose)}")
+                return None
+            frame += struct.pack("<IH13H", t_ms, flags, *pose)
+        
+        try:
+            self.ws.send(frame, opcode=websocket.ABNF.OPCODE_BINARY)
+            if not want_ack:
+                return None
+            # Skip any JSON broadcasts queued ahead of the ack
+            while True:
+                opcode, data = self.ws.recv_data()
+                if opcode == websocket.ABNF.OPCODE_BINARY and len(data) == 8 and data[0] == 0xB1:
+                    _, accepted, status, _, seq = struct.unpack("<BBBBI", data)
+                    return {"accepted": accepted, "status": status, "seq": seq}
+        except websocket.WebSocketTimeoutException:
+            return None
+        except Exception as e:
+            print(f"ERROR: Failed to send binary pose: {e}")
+            return None
+    
     def set_leg(self, leg: int, coxa_us: int, femur_us: int, tibia_us: int, 
                 apply_calibration: bool = True) -> bool:
         """Set all three servos of a leg at once."""
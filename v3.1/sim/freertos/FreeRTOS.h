@@ -0,0 +1,47 @@
+/**
+ * Spider Robot v3.1 - FreeRTOS host shim
+ *
+ * Just enough of the FreeRTOS API for the Muscle sources to build and
+ * run on Linux: tasks are pthreads, the tick is 1 ms of CLOCK_MONOTONIC
+ * and critical sections take one process-wide recursive mutex. Tasks run
+ * truly in parallel rather than by priority, which is harsher than the
+ * single-core target, not gentler. Simulator only (see sim/README.md).
+ */
+
+#ifndef SIM_FREERTOS_H
+#define SIM_FREERTOS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE                 0
+#define pdTRUE                  1
+#define pdFAIL                  0
+#define pdPASS                  1
+
+#define configTICK_RATE_HZ      1000
+#define configMAX_PRIORITIES    8
+#define configMINIMAL_STACK_SIZE 128
+
+#define portTICK_PERIOD_MS      (1000 / configTICK_RATE_HZ)
+#define portMAX_DELAY           ((TickType_t)0xFFFFFFFFUL)
+#define pdMS_TO_TICKS(ms)       ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+
+#define portYIELD_FROM_ISR(woken)   ((void)(woken))
+
+void vPortEnterCritical(void);
+void vPortExitCritical(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SIM_FREERTOS_H
@@ -0,0 +1,7 @@
+#ifndef SIM_PORTMACRO_H
+#define SIM_PORTMACRO_H
+
+// Port definitions live in FreeRTOS.h for the host shim
+#include "FreeRTOS.h"
+
+#endif // SIM_PORTMACRO_H
@@ -0,0 +1,7 @@
+#ifndef SIM_SEMPHR_H
+#define SIM_SEMPHR_H
+
+// The Muscle includes semphr.h but only uses task notifications and critical sections
+#include "FreeRTOS.h"
+
+#endif // SIM_SEMPHR_H
@@ -0,0 +1,57 @@
+#ifndef SIM_TASK_H
+#define SIM_TASK_H
+
+#include "FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct SimTask *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+typedef enum {
+    eNoAction = 0,
+    eSetBits,
+    eIncrement,
+    eSetValueWithOverwrite,
+    eSetValueWithoutOverwrite
+} eNotifyAction;
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_depth,
+                       void *arg, UBaseType_t priority, TaskHandle_t *out);
+
+TickType_t xTaskGetTickCount(void);
+TickType_t xTaskGetTickCountFromISR(void);
+
+void vTaskDelay(TickType_t ticks);
+void vTaskDelayUntil(TickType_t *previous_wake, TickType_t increment);
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action);
+BaseType_t xTaskNotifyFromISR(TaskHandle_t task, uint32_t value, eNotifyAction action,
+                              BaseType_t *higher_priority_woken);
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit,
+                           uint32_t *value, TickType_t ticks_to_wait);
+
+/**
+ * Host threads run on pthread stacks, so there is no FreeRTOS stack to
+ * measure: always 0 (unknown).
+ */
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+
+#define taskENTER_CRITICAL()            vPortEnterCritical()
+#define taskEXIT_CRITICAL()             vPortExitCritical()
+#define taskENTER_CRITICAL_FROM_ISR()   (vPortEnterCritical(), (UBaseType_t)0)
+#define taskEXIT_CRITICAL_FROM_ISR(s)   ((void)(s), vPortExitCritical())
+
+/**
+ * Simulator control: stop every task at its next blocking call and join
+ * them. Tasks cannot be restarted afterwards.
+ */
+void sim_freertos_shutdown(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SIM_TASK_H
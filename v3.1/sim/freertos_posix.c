@@ -0,0 +1,251 @@
+/**
+ * Spider Robot v3.1 - FreeRTOS host shim (pthreads)
+ */
+
+#define _GNU_SOURCE
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define SIM_MAX_TASKS   16
+
+struct SimTask {
+    pthread_t thread;
+    TaskFunction_t fn;
+    void *arg;
+    char name[16];
+    pthread_mutex_t lock;
+    pthread_cond_t cond;        // Notifications, and wakes delays on shutdown
+    uint32_t value;
+    int pending;
+};
+
+static struct SimTask s_tasks[SIM_MAX_TASKS];
+static int s_task_count = 0;
+static pthread_mutex_t s_tasks_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t s_critical;
+static pthread_once_t s_once = PTHREAD_ONCE_INIT;
+static struct timespec s_epoch;
+static volatile int s_shutdown = 0;
+static __thread struct SimTask *s_current = NULL;
+
+static void sim_init(void) {
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&s_critical, &attr);
+    pthread_mutexattr_destroy(&attr);
+    clock_gettime(CLOCK_MONOTONIC, &s_epoch);
+}
+
+static uint64_t now_us(void) {
+    pthread_once(&s_once, sim_init);
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    int64_t ns = (int64_t)(ts.tv_sec - s_epoch.tv_sec) * 1000000000LL +
+                 (int64_t)(ts.tv_nsec - s_epoch.tv_nsec);
+    return (uint64_t)ns / 1000ULL;
+}
+
+static struct timespec deadline_after_us(uint64_t us) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ts.tv_sec += (time_t)(us / 1000000ULL);
+    ts.tv_nsec += (long)(us % 1000000ULL) * 1000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    return ts;
+}
+
+// Tasks end at their next blocking call once the simulator shuts down
+static void check_shutdown(struct SimTask *t) {
+    if (s_shutdown && t != NULL) {
+        pthread_mutex_unlock(&t->lock);
+        pthread_exit(NULL);
+    }
+}
+
+static void sleep_us(uint64_t us) {
+    struct SimTask *t = s_current;
+    if (t == NULL) {
+        struct timespec req = { (time_t)(us / 1000000ULL), (long)(us % 1000000ULL) * 1000L };
+        while (nanosleep(&req, &req) != 0 && errno == EINTR) {
+        }
+        return;
+    }
+
+    struct timespec until = deadline_after_us(us);
+    pthread_mutex_lock(&t->lock);
+    check_shutdown(t);
+    while (pthread_cond_timedwait(&t->cond, &t->lock, &until) != ETIMEDOUT) {
+        check_shutdown(t);
+    }
+    pthread_mutex_unlock(&t->lock);
+}
+
+static void *task_trampoline(void *p) {
+    struct SimTask *t = (struct SimTask *)p;
+    s_current = t;
+    t->fn(t->arg);
+    return NULL;
+}
+
+void vPortEnterCritical(void) {
+    pthread_once(&s_once, sim_init);
+    pthread_mutex_lock(&s_critical);
+}
+
+void vPortExitCritical(void) {
+    pthread_mutex_unlock(&s_critical);
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_depth,
+                       void *arg, UBaseType_t priority, TaskHandle_t *out) {
+    (void)stack_depth;
+    (void)priority;
+    pthread_once(&s_once, sim_init);
+
+    pthread_mutex_lock(&s_tasks_lock);
+    if (s_task_count == SIM_MAX_TASKS || s_shutdown) {
+        pthread_mutex_unlock(&s_tasks_lock);
+        return pdFAIL;
+    }
+    struct SimTask *t = &s_tasks[s_task_count];
+    memset(t, 0, sizeof(*t));
+    t->fn = fn;
+    t->arg = arg;
+    snprintf(t->name, sizeof(t->name), "%s", name ? name : "task");
+
+    pthread_condattr_t cattr;
+    pthread_condattr_init(&cattr);
+    pthread_condattr_setclock(&cattr, CLOCK_MONOTONIC);
+    pthread_cond_init(&t->cond, &cattr);
+    pthread_condattr_destroy(&cattr);
+    pthread_mutex_init(&t->lock, NULL);
+
+    // The handle must be valid before the task can be notified
+    if (out) *out = t;
+    if (pthread_create(&t->thread, NULL, task_trampoline, t) != 0) {
+        if (out) *out = NULL;
+        pthread_mutex_unlock(&s_tasks_lock);
+        return pdFAIL;
+    }
+    pthread_setname_np(t->thread, t->name);
+    s_task_count++;
+    pthread_mutex_unlock(&s_tasks_lock);
+    return pdPASS;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+    (void)task;
+    return 0;
+}
+
+TickType_t xTaskGetTickCount(void) {
+    return (TickType_t)(now_us() / (1000000ULL / configTICK_RATE_HZ));
+}
+
+TickType_t xTaskGetTickCountFromISR(void) {
+    return xTaskGetTickCount();
+}
+
+void vTaskDelay(TickType_t ticks) {
+    sleep_us((uint64_t)ticks * (1000000ULL / configTICK_RATE_HZ));
+}
+
+void vTaskDelayUntil(TickType_t *previous_wake, TickType_t increment) {
+    *previous_wake += increment;
+    uint64_t due = (uint64_t)*previous_wake * (1000000ULL / configTICK_RATE_HZ);
+    uint64_t now = now_us();
+    if (due > now) {
+        sleep_us(due - now);
+    } else {
+        // Running late: catch up without sleeping, as the kernel would
+        sleep_us(0);
+    }
+}
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action) {
+    if (task == NULL) return pdFAIL;
+
+    BaseType_t ret = pdPASS;
+    pthread_mutex_lock(&task->lock);
+    switch (action) {
+    case eSetBits:                  task->value |= value; break;
+    case eIncrement:                task->value++; break;
+    case eSetValueWithOverwrite:    task->value = value; break;
+    case eSetValueWithoutOverwrite:
+        if (task->pending) ret = pdFAIL;
+        else task->value = value;
+        break;
+    case eNoAction:                 break;
+    }
+    task->pending = 1;
+    pthread_cond_signal(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+    return ret;
+}
+
+BaseType_t xTaskNotifyFromISR(TaskHandle_t task, uint32_t value, eNotifyAction action,
+                              BaseType_t *higher_priority_woken) {
+    if (higher_priority_woken) *higher_priority_woken = pdFALSE;
+    return xTaskNotify(task, value, action);
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit,
+                           uint32_t *value, TickType_t ticks_to_wait) {
+    struct SimTask *t = s_current;
+    if (t == NULL) return pdFAIL;
+
+    pthread_mutex_lock(&t->lock);
+    check_shutdown(t);
+    if (!t->pending) {
+        t->value &= ~clear_on_entry;
+        if (ticks_to_wait == portMAX_DELAY) {
+            while (!t->pending) {
+                pthread_cond_wait(&t->cond, &t->lock);
+                check_shutdown(t);
+            }
+        } else if (ticks_to_wait > 0) {
+            struct timespec until =
+                deadline_after_us((uint64_t)ticks_to_wait * (1000000ULL / configTICK_RATE_HZ));
+            while (!t->pending &&
+                   pthread_cond_timedwait(&t->cond, &t->lock, &until) != ETIMEDOUT) {
+                check_shutdown(t);
+            }
+        }
+    }
+
+    BaseType_t ret = t->pending ? pdTRUE : pdFALSE;
+    if (value) *value = t->value;
+    if (t->pending) {
+        t->value &= ~clear_on_exit;
+        t->pending = 0;
+    }
+    pthread_mutex_unlock(&t->lock);
+    return ret;
+}
+
+void sim_freertos_shutdown(void) {
+    pthread_mutex_lock(&s_tasks_lock);
+    s_shutdown = 1;
+    int count = s_task_count;
+    pthread_mutex_unlock(&s_tasks_lock);
+
+    for (int i = 0; i < count; i++) {
+        pthread_mutex_lock(&s_tasks[i].lock);
+        pthread_cond_broadcast(&s_tasks[i].cond);
+        pthread_mutex_unlock(&s_tasks[i].lock);
+    }
+    for (int i = 0; i < count; i++) {
+        pthread_join(s_tasks[i].thread, NULL);
+    }
+}
@@ -0,0 +1,234 @@
+/**
+ * Spider Robot v3.1 - Simulated I2C bus
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "i2c_sim.h"
+#include "i2c_hal.h"
+#include "pca9685.h"
+#include "timebase.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+#define PCA_REG_MODE1       0x00
+#define PCA_REG_LED0_ON_L   0x06
+#define PCA_REG_ALL_ON_L    0xFA
+#define PCA_REG_PRESCALE    0xFE
+#define PCA_MODE1_AI        0x20
+#define PCA_MODE1_ALLCALL   0x01
+
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t s_speed = I2C_HAL_SPEED_FAST;
+static uint64_t s_busy_until_us = 0;    // End of the transfer on the wire
+static uint8_t s_regs[PCA9685_BOARD_COUNT][256];
+static I2cSimStats s_stats;
+
+static uint32_t round_speed(uint32_t bus_hz) {
+    if (bus_hz >= I2C_HAL_SPEED_FAST_PLUS) return I2C_HAL_SPEED_FAST_PLUS;
+    if (bus_hz >= I2C_HAL_SPEED_FAST) return I2C_HAL_SPEED_FAST;
+    return I2C_HAL_SPEED_STANDARD;
+}
+
+static void sleep_until_us(uint64_t t_us) {
+    uint64_t now = timebase_shared_us();
+    if (t_us <= now) {
+        return;
+    }
+    uint64_t us = t_us - now;
+    struct timespec req = { (time_t)(us / 1000000ULL), (long)(us % 1000000ULL) * 1000L };
+    while (nanosleep(&req, &req) != 0 && errno == EINTR) {
+    }
+}
+
+// Wait for the bus, then book it for a transfer of bits clocks. Called with s_lock held.
+static uint64_t occupy_bus(uint32_t bits, size_t bytes) {
+    uint64_t start = timebase_shared_us();
+    if (s_busy_until_us > start) {
+        uint64_t until = s_busy_until_us;
+        pthread_mutex_unlock(&s_lock);
+        sleep_until_us(until);
+        pthread_mutex_lock(&s_lock);
+        start = timebase_shared_us();
+    }
+    uint64_t wire_us = ((uint64_t)bits * 1000000ULL + s_speed - 1) / s_speed + I2C_SIM_OVERHEAD_US;
+    s_busy_until_us = start + wire_us;
+    s_stats.transfers++;
+    s_stats.bytes += bytes;
+    s_stats.busy_us += wire_us;
+    return s_busy_until_us;
+}
+
+// Board answering on addr, -1 if none does
+static int pca_board(uint8_t addr) {
+    int board = (int)addr - PCA9685_I2C_ADDR_DEFAULT;
+    return (board >= 0 && board < PCA9685_BOARD_COUNT) ? board : -1;
+}
+
+// ALL_LED registers load every LEDn block
+static void pca_store(uint8_t *regs, uint8_t reg, uint8_t value) {
+    regs[reg] = value;
+    if (reg >= PCA_REG_ALL_ON_L && reg < PCA_REG_ALL_ON_L + 4) {
+        for (int ch = 0; ch < PCA9685_CHANNEL_COUNT; ch++) {
+            regs[PCA_REG_LED0_ON_L + ch * 4 + (reg - PCA_REG_ALL_ON_L)] = value;
+        }
+    }
+}
+
+static uint8_t pca_next(const uint8_t *regs, uint8_t reg) {
+    return (regs[PCA_REG_MODE1] & PCA_MODE1_AI) ? (uint8_t)(reg + 1) : reg;
+}
+
+static void pca_write(uint8_t *regs, uint8_t reg, const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        pca_store(regs, reg, data[i]);
+        reg = pca_next(regs, reg);
+    }
+}
+
+static int write_locked(uint8_t addr, uint8_t reg, const uint8_t *data, size_t len, int wait) {
+    // Start, address, register, payload, stop
+    uint64_t done = occupy_bus((uint32_t)(2 + len) * 9 + 2, len + 1);
+    int board = pca_board(addr);
+    int acked = 0;
+    if (board >= 0) {
+        pca_write(s_regs[board], reg, data, len);
+        acked = 1;
+    } else if (addr == PCA9685_I2C_ADDR_ALLCALL) {
+        for (int b = 0; b < PCA9685_BOARD_COUNT; b++) {
+            if (s_regs[b][PCA_REG_MODE1] & PCA_MODE1_ALLCALL) {
+                pca_write(s_regs[b], reg, data, len);
+                acked = 1;
+            }
+        }
+    }
+    if (!acked) {
+        s_stats.nacks++;
+        return -1;
+    }
+    if (wait) {
+        pthread_mutex_unlock(&s_lock);
+        sleep_until_us(done);
+        pthread_mutex_lock(&s_lock);
+    }
+    return 0;
+}
+
+int i2c_hal_init(uint32_t bus_hz) {
+    pthread_mutex_lock(&s_lock);
+    s_speed = round_speed(bus_hz);
+    s_busy_until_us = 0;
+    memset(s_regs, 0, sizeof(s_regs));
+    for (int b = 0; b < PCA9685_BOARD_COUNT; b++) {
+        s_regs[b][PCA_REG_MODE1] = 0x11;    // Power-on: SLEEP | ALLCALL
+        s_regs[b][PCA_REG_PRESCALE] = 0x1E;
+    }
+    memset(&s_stats, 0, sizeof(s_stats));
+    pthread_mutex_unlock(&s_lock);
+    return 0;
+}
+
+int i2c_hal_set_speed(uint32_t bus_hz) {
+    pthread_mutex_lock(&s_lock);
+    s_speed = round_speed(bus_hz);
+    pthread_mutex_unlock(&s_lock);
+    return 0;
+}
+
+uint32_t i2c_hal_get_speed(void) {
+    pthread_mutex_lock(&s_lock);
+    uint32_t speed = s_speed;
+    pthread_mutex_unlock(&s_lock);
+    return speed;
+}
+
+uint32_t i2c_hal_self_test(uint8_t dev_addr, uint8_t reg) {
+    uint8_t value;
+    return i2c_hal_read_reg(dev_addr, reg, &value, 1) == 0 ? i2c_hal_get_speed() : 0;
+}
+
+int i2c_hal_write_reg(uint8_t addr, uint8_t reg, uint8_t value) {
+    return i2c_hal_write_buf(addr, reg, &value, 1);
+}
+
+int i2c_hal_write_buf(uint8_t addr, uint8_t reg, const uint8_t *data, size_t len) {
+    pthread_mutex_lock(&s_lock);
+    int ret = write_locked(addr, reg, data, len, 1);
+    pthread_mutex_unlock(&s_lock);
+    return ret;
+}
+
+int i2c_hal_write_buf_async(uint8_t addr, uint8_t reg, const uint8_t *data, size_t len) {
+    if (len > I2C_HAL_ASYNC_MAX) {
+        return -1;
+    }
+    pthread_mutex_lock(&s_lock);
+    int ret = write_locked(addr, reg, data, len, 0);
+    pthread_mutex_unlock(&s_lock);
+    return ret;
+}
+
+int i2c_hal_flush(void) {
+    pthread_mutex_lock(&s_lock);
+    uint64_t until = s_busy_until_us;
+    pthread_mutex_unlock(&s_lock);
+    sleep_until_us(until);
+    return 0;
+}
+
+int i2c_hal_read_reg(uint8_t addr, uint8_t reg, uint8_t *data, size_t len) {
+    pthread_mutex_lock(&s_lock);
+    // Write the register pointer, repeated start, address, payload
+    uint64_t done = occupy_bus((uint32_t)(3 + len) * 9 + 3, len + 1);
+    int ret = 0;
+    int board = pca_board(addr);
+    if (board < 0) {
+        s_stats.nacks++;
+        ret = -1;
+    } else {
+        for (size_t i = 0; i < len; i++) {
+            data[i] = s_regs[board][reg];
+            reg = pca_next(s_regs[board], reg);
+        }
+    }
+    pthread_mutex_unlock(&s_lock);
+    sleep_until_us(done);
+    return ret;
+}
+
+void i2c_hal_delay_ms(uint32_t ms) {
+    vTaskDelay(pdMS_TO_TICKS(ms));
+}
+
+void i2c_sim_get_stats(I2cSimStats *out) {
+    pthread_mutex_lock(&s_lock);
+    *out = s_stats;
+    pthread_mutex_unlock(&s_lock);
+}
+
+uint16_t i2c_sim_channel_us(uint8_t channel) {
+    if (channel >= PCA9685_OUTPUT_COUNT) {
+        return 0;
+    }
+    pthread_mutex_lock(&s_lock);
+    const uint8_t *regs = s_regs[channel / PCA9685_CHANNEL_COUNT];
+    const uint8_t *led = &regs[PCA_REG_LED0_ON_L + (channel % PCA9685_CHANNEL_COUNT) * 4];
+    uint16_t on = (uint16_t)(led[0] | (led[1] << 8));
+    uint16_t off = (uint16_t)(led[2] | (led[3] << 8));
+    uint32_t prescale = regs[PCA_REG_PRESCALE];
+    pthread_mutex_unlock(&s_lock);
+
+    // Full-off bit, or nothing programmed yet
+    if ((off & 0x1000) || on == off) {
+        return 0;
+    }
+    // One tick is (prescale + 1) cycles of the 25 MHz oscillator
+    uint32_t ticks = (uint32_t)((off - on) & 0x0FFF);
+    return (uint16_t)((ticks * (prescale + 1) + 12) / 25);
+}
@@ -0,0 +1,44 @@
+/**
+ * Spider Robot v3.1 - Simulated I2C bus
+ *
+ * Host implementation of drivers/i2c_hal.h with a register model of each
+ * of the PCA9685_BOARD_COUNT boards, at PCA9685_I2C_ADDR_DEFAULT onwards
+ * and on the ALLCALL address while enabled. Each transfer takes as long as it would on
+ * the wire at the current bus speed (9 clocks per byte plus start/stop)
+ * plus a fixed driver overhead; async writes occupy the bus in the
+ * background and the next transfer waits for it, as on the Duo.
+ */
+
+#ifndef I2C_SIM_H
+#define I2C_SIM_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Controller setup and interrupt latency per transfer, on top of the wire time
+#define I2C_SIM_OVERHEAD_US  20
+
+typedef struct {
+    uint32_t transfers;
+    uint32_t nacks;             // Transfers to an address nothing answers on
+    uint64_t bytes;             // Payload bytes, register address included
+    uint64_t busy_us;           // Total simulated bus time
+} I2cSimStats;
+
+void i2c_sim_get_stats(I2cSimStats *out);
+
+/**
+ * Pulse width the modelled PCA9685s currently drive on channel (16 per
+ * board, as the driver numbers them), in us (0 when the channel is off
+ * or the prescaler was never set).
+ */
+uint16_t i2c_sim_channel_us(uint8_t channel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // I2C_SIM_H
@@ -0,0 +1,208 @@
+#!/usr/bin/env python3
+"""
+Spider Robot v3.1 - Synthetic WebSocket load for brain_sim
+
+Opens several clients that stream "servos" commands at a fixed rate, then
+asks the daemon for "status" and prints throughput, the Brain's latency
+histograms, ring occupancy and the simulated Muscle's counters. No
+external dependencies (frame handling as in python/mini_ws.py).
+
+With --single each command moves one channel ("servo"), the sparse
+traffic that goes over the ring as delta packets.
+
+Usage: load_test.py [--clients 4] [--rate 100] [--duration 10] [--single]
+"""
+
+import argparse
+import base64
+import json
+import math
+import os
+import socket
+import struct
+import threading
+import time
+
+SERVO_COUNT = 13
+
+
+def connect(host, port):
+    sock = socket.create_connection((host, port), timeout=5.0)
+    key = base64.b64encode(os.urandom(16)).decode()
+    sock.sendall((
+        "GET / HTTP/1.1\r\n"
+        f"Host: {host}:{port}\r\n"
+        "Upgrade: websocket\r\n"
+        "Connection: Upgrade\r\n"
+        f"Sec-WebSocket-Key: {key}\r\n"
+        "Sec-WebSocket-Version: 13\r\n"
+        "\r\n").encode())
+    response = b""
+    while b"\r\n\r\n" not in response:
+        chunk = sock.recv(1024)
+        if not chunk:
+            raise ConnectionError("handshake failed")
+        response += chunk
+    if b" 101 " not in response.split(b"\r\n", 1)[0]:
+        raise ConnectionError("handshake rejected")
+    return sock, response.split(b"\r\n\r\n", 1)[1]
+
+
+def encode_frame(text):
+    # Client frames must be masked (RFC 6455 5.3)
+    data = text.encode()
+    frame = bytearray([0x81])
+    if len(data) <= 125:
+        frame.append(0x80 | len(data))
+    elif len(data) <= 65535:
+        frame.append(0x80 | 126)
+        frame.extend(struct.pack(">H", len(data)))
+    else:
+        frame.append(0x80 | 127)
+        frame.extend(struct.pack(">Q", len(data)))
+    mask = os.urandom(4)
+    frame.extend(mask)
+    frame.extend(b ^ mask[i % 4] for i, b in enumerate(data))
+    return bytes(frame)
+
+
+def parse_frames(buf):
+    """Split unmasked server frames off buf. Returns (payloads, rest)."""
+    out = []
+    while len(buf) >= 2:
+        length = buf[1] & 0x7F
+        offset = 2
+        if length == 126:
+            if len(buf) < 4:
+                break
+            length = struct.unpack(">H", buf[2:4])[0]
+            offset = 4
+        elif length == 127:
+            if len(buf) < 10:
+                break
+            length = struct.unpack(">Q", buf[2:10])[0]
+            offset = 10
+        if len(buf) < offset + length:
+            break
+        if buf[0] & 0x0F == 1:
+            out.append(buf[offset:offset + length].decode(errors="replace"))
+        buf = buf[offset + length:]
+    return out, buf
+
+
+class Client(threading.Thread):
+    def __init__(self, idx, args, stop):
+        super().__init__(daemon=True)
+        self.idx = idx
+        self.args = args
+        self.stop = stop
+        self.sent = 0
+        self.queue_full = 0
+        self.errors = 0
+
+    def run(self):
+        sock, buf = connect(self.args.host, self.args.port)
+        sock.settimeout(0.0)
+        period = 1.0 / self.args.rate
+        next_send = time.monotonic()
+        t0 = next_send
+        while not self.stop.is_set():
+            now = time.monotonic()
+            if now >= next_send:
+                # A slow sweep so consecutive poses differ on every channel
+                phase = 2.0 * math.pi * 0.5 * (now - t0) + self.idx
+                us = [int(1500 + 300 * math.sin(phase + ch)) for ch in range(SERVO_COUNT)]
+                if self.args.single:
+                    ch = self.sent % SERVO_COUNT
+                    cmd = {"cmd": "servo", "channel": ch, "us": us[ch]}
+                else:
+                    cmd = {"cmd": "servos", "us": us}
+                sock.sendall(encode_frame(json.dumps(cmd)))
+                self.sent += 1
+                next_send += period
+            try:
+                chunk = sock.recv(65536)
+                if not chunk:
+                    break
+                msgs, buf = parse_frames(buf + chunk)
+                for m in msgs:
+                    if "motion_queue_full" in m:
+                        self.queue_full += 1
+                    elif '"error"' in m:
+                        self.errors += 1
+            except BlockingIOError:
+                time.sleep(min(0.001, max(0.0, next_send - time.monotonic())))
+        sock.close()
+
+
+def request_status(host, port):
+    sock, buf = connect(host, port)
+    sock.sendall(encode_frame(json.dumps({"cmd": "status"})))
+    deadline = time.monotonic() + 5.0
+    while time.monotonic() < deadline:
+        chunk = sock.recv(65536)
+        if not chunk:
+            break
+        msgs, buf = parse_frames(buf + chunk)
+        for m in msgs:
+            if m.startswith('{"status":"ok","seq"'):
+                sock.close()
+                return json.loads(m)
+    sock.close()
+    return None
+
+
+def main():
+    parser = argparse.ArgumentParser(description="WebSocket load test for brain_sim")
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=9000)
+    parser.add_argument("--clients", type=int, default=4)
+    parser.add_argument("--rate", type=float, default=100.0, help="commands/s per client")
+    parser.add_argument("--duration", type=float, default=10.0, help="seconds")
+    parser.add_argument("--single", action="store_true", help="one channel per command")
+    args = parser.parse_args()
+
+    stop = threading.Event()
+    clients = [Client(i, args, stop) for i in range(args.clients)]
+    for c in clients:
+        c.start()
+    time.sleep(args.duration)
+    stop.set()
+    for c in clients:
+        c.join(timeout=2.0)
+
+    sent = sum(c.sent for c in clients)
+    print(f"Sent:        {sent} commands ({sent / args.duration:.0f}/s over {args.clients} clients)")
+    print(f"Queue full:  {sum(c.queue_full for c in clients)}")
+    print(f"Errors:      {sum(c.errors for c in clients)}")
+
+    # Let the Muscle drain before reading its counters
+    time.sleep(0.5)
+    status = request_status(args.host, args.port)
+    if status is None:
+        print("No status reply")
+        return 1
+    print(f"Ring:        w={status['ring_w']} r={status['ring_r']} slots={status['ring_slots']}"
+          f" tx={status['tx_count']}")
+    delivery = status.get("delivery")
+    if delivery:
+        nacked = " ".join(f"{k}={v}" for k, v in delivery["nacked"].items() if v)
+        print(f"Delivery:    policy={delivery['policy']}/{delivery.get('pose_policy', delivery['policy'])}"
+              f" written={delivery['written']}"
+              f" deltas={delivery.get('deltas', 0)}"
+              f" acked={delivery['acked']} skipped={delivery.get('skipped', 0)}"
+              f" nacked=[{nacked}] ack_lost={delivery['ack_lost']}"
+              f" coalesced={delivery['coalesced']} dropped={delivery['dropped']}"
+              f" overwritten={delivery.get('overwritten', 0)}"
+              f" backlog_max={delivery['backlog_max']}")
+    muscle = status.get("muscle")
+    if muscle:
+        print("Muscle:      " + " ".join(f"{k}={v}" for k, v in muscle.items() if k != "servos"))
+    for name, h in status.get("latency_us", {}).items():
+        print(f"Latency {name:<12} n={h['n']} p50={h['p50']} p99={h['p99']} "
+              f"p999={h['p999']} max={h['max']} us")
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
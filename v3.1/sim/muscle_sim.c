@@ -0,0 +1,71 @@
+/**
+ * Spider Robot v3.1 - Host-side Muscle simulator
+ */
+
+#include "muscle_sim.h"
+#include "estop_input.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <stddef.h>
+
+// app_main_v1.c
+void main_cvirtos(void);
+void mailbox_cmd_handler(uint8_t cmd_id, uint32_t param);
+
+uintptr_t muscle_sim_shared_base = 0;
+
+static int s_started = 0;
+static volatile int s_estop_level = 0;
+static int s_estop_irq_missing = 0;
+static EstopInputHandler s_estop_handler = NULL;
+
+int muscle_sim_start(void *region) {
+    if (s_started || region == NULL) {
+        return -1;
+    }
+    muscle_sim_shared_base = (uintptr_t)region;
+    s_started = 1;
+    main_cvirtos();
+    return 0;
+}
+
+void muscle_sim_stop(void) {
+    if (s_started) {
+        sim_freertos_shutdown();
+    }
+}
+
+void muscle_sim_mailbox(uint8_t cmd_id, uint32_t param) {
+    // The cmdqu interrupt cannot land inside a critical section
+    UBaseType_t saved = taskENTER_CRITICAL_FROM_ISR();
+    mailbox_cmd_handler(cmd_id, param);
+    taskEXIT_CRITICAL_FROM_ISR(saved);
+}
+
+int estop_input_init(EstopInputHandler on_assert) {
+    if (s_estop_irq_missing) {
+        return -1;
+    }
+    s_estop_handler = on_assert;
+    return 0;
+}
+
+void muscle_sim_estop_irq_missing(int missing) {
+    s_estop_irq_missing = missing;
+}
+
+int estop_input_asserted(void) {
+    return s_estop_level;
+}
+
+void muscle_sim_estop_input(int asserted) {
+    int rising = asserted && !s_estop_level;
+    s_estop_level = asserted ? 1 : 0;
+    if (rising && s_estop_handler != NULL) {
+        UBaseType_t saved = taskENTER_CRITICAL_FROM_ISR();
+        s_estop_handler();
+        taskEXIT_CRITICAL_FROM_ISR(saved);
+    }
+}
@@ -0,0 +1,60 @@
+/**
+ * Spider Robot v3.1 - Host-side Muscle simulator
+ *
+ * Runs the real Muscle runtime (app_main_v1.c, interpolator, safety and
+ * PCA9685 driver) on pthreads through the FreeRTOS shim in freertos/,
+ * against i2c_sim.c instead of the cv180x I2C peripheral and an E-STOP
+ * line set by muscle_sim_estop_input() instead of the GPIO bank. The shared
+ * region is ordinary memory handed in by the caller, and mailbox commands
+ * are delivered by calling the Muscle's mailbox handler directly.
+ *
+ * Force-included into the Muscle sources so SHARED_MEM_BASE resolves to
+ * muscle_sim_shared_base.
+ */
+
+#ifndef MUSCLE_SIM_H
+#define MUSCLE_SIM_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Base of the region the simulated Muscle uses as SHARED_MEM_BASE
+extern uintptr_t muscle_sim_shared_base;
+
+/**
+ * Start the Muscle on region (SHARED_MEM_SIZE bytes, shared with the Brain
+ * side). Once per process: the runtime keeps its state in statics.
+ * Returns 0 on success.
+ */
+int muscle_sim_start(void *region);
+
+/**
+ * Stop all Muscle tasks. They end at their next blocking call.
+ */
+void muscle_sim_stop(void);
+
+/**
+ * Deliver a mailbox command, as the cmdqu interrupt would.
+ */
+void muscle_sim_mailbox(uint8_t cmd_id, uint32_t param);
+
+/**
+ * Set the level of the E-STOP input line; going high interrupts the
+ * Muscle as the GPIO edge would.
+ */
+void muscle_sim_estop_input(int asserted);
+
+/**
+ * Make the E-STOP input's interrupt registration fail, as on a board
+ * where request_irq() does not succeed. Call before muscle_sim_start().
+ */
+void muscle_sim_estop_irq_missing(int missing);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MUSCLE_SIM_H
@@ -59,10 +59,67 @@ void test_posepacket_neutral() {
 
     uint16_t crc = crc16_ccitt_false((const uint8_t *)&pkt, sizeof(pkt) - 2);
 
-    printf("(CRC=0x%04X) ", crc);
+    if (crc == 0xC73C) {
+        PASS();
+    } else {
+        char buf[64];
+        snprintf(buf, sizeof(buf), "Expected 0xC73C, got 0x%04X", crc);
+        FAIL(buf);
+    }
+}
+
+// Reference: the original bit-at-a-time loop
+static uint16_t crc16_reference(const uint8_t *data, size_t len) {
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= ((uint16_t)data[i] << 8);
+        for (int j = 0; j < 8; j++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+void test_matches_reference() {
+    TEST("Matches bitwise reference for all lengths 0..64");
+
+    uint8_t data[64];
+    uint32_t x = 12345;
+    for (size_t i = 0; i < sizeof(data); i++) {
+        x = x * 1103515245u + 12345u;
+        data[i] = (uint8_t)(x >> 16);
+    }
+
+    for (size_t len = 0; len <= sizeof(data); len++) {
+        if (crc16_ccitt_false(data, len) != crc16_reference(data, len)) {
+            char buf[64];
+            snprintf(buf, sizeof(buf), "Mismatch at length %zu", len);
+            FAIL(buf);
+            return;
+        }
+    }
     PASS();
 }
 
+void test_incremental() {
+    TEST("Incremental update equals one-shot");
+
+    const uint8_t data[] = "123456789";
+    bool ok = true;
+    for (size_t split = 0; split <= 9; split++) {
+        uint16_t crc = crc16_ccitt_false_init();
+        crc = crc16_ccitt_false_update(crc, data, split);
+        crc = crc16_ccitt_false_update(crc, data + split, 9 - split);
+        if (crc16_ccitt_false_final(crc) != 0x29B1) ok = false;
+    }
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("Split CRC differs");
+    }
+}
+
 void test_crc_detects_bit_flip() {
     TEST("CRC detects single bit flip");
 
@@ -86,6 +143,8 @@ int main() {
     test_empty_data();
     test_posepacket_neutral();
     test_crc_detects_bit_flip();
+    test_matches_reference();
+    test_incremental();
 
     printf("\nResults: %d passed, %d failed\n", tests_passed, tests_failed);
     return tests_failed > 0 ? 1 : 0;
@@ -0,0 +1,139 @@
+/**
+ * Eye Timeline Unit Tests
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <cmath>
+
+#include "eye_timeline.hpp"
+#include "eye_clips.hpp"
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST(name) printf("  %s: ", name)
+#define PASS() do { printf("PASS\n"); tests_passed++; } while(0)
+#define FAIL(msg) do { printf("FAIL - %s\n", msg); tests_failed++; } while(0)
+
+static bool near(float a, float b) {
+    return std::fabs(a - b) < 1e-4f;
+}
+
+void test_easing() {
+    TEST("Easing curves hit their ends and shape the middle");
+
+    bool ok = true;
+    const Ease all[] = { Ease::LINEAR, Ease::IN, Ease::OUT, Ease::SMOOTH };
+    for (Ease e : all) {
+        ok = ok && near(easeApply(e, 0.0f), 0.0f) && near(easeApply(e, 1.0f), 1.0f);
+    }
+    ok = ok && near(easeApply(Ease::STEP, 0.99f), 0.0f) && near(easeApply(Ease::STEP, 1.0f), 1.0f);
+    ok = ok && easeApply(Ease::IN, 0.5f) < 0.5f && easeApply(Ease::OUT, 0.5f) > 0.5f &&
+         near(easeApply(Ease::SMOOTH, 0.5f), 0.5f);
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("wrong easing value");
+    }
+}
+
+void test_tween_by_time() {
+    TEST("Tween follows elapsed time, not the number of samples");
+
+    const uint64_t t0 = 5000000;
+    EyeTimeline coarse, fine;
+    coarse.tween(EYE_CH_LOOK_X, 0.0f, 1.0f, 200, Ease::LINEAR, t0);
+    fine.tween(EYE_CH_LOOK_X, 0.0f, 1.0f, 200, Ease::LINEAR, t0);
+
+    float a[EYE_CH_COUNT] = {}, b[EYE_CH_COUNT] = {};
+    for (uint64_t t = t0; t <= t0 + 100000; t += 10000) {
+        fine.sample(t, b);                      // 10 ms frames
+    }
+    uint32_t mask = coarse.sample(t0 + 100000, a);    // One dropped-frame jump
+    bool ok = mask == (1u << EYE_CH_LOOK_X) && near(a[EYE_CH_LOOK_X], 0.5f) &&
+              near(b[EYE_CH_LOOK_X], 0.5f) && a[EYE_CH_LOOK_Y] == 0.0f;
+
+    // Past the end: final value written once, then the channel is released
+    mask = coarse.sample(t0 + 900000, a);
+    ok = ok && mask == (1u << EYE_CH_LOOK_X) && near(a[EYE_CH_LOOK_X], 1.0f) && !coarse.playing();
+    a[EYE_CH_LOOK_X] = 7.0f;
+    ok = ok && coarse.sample(t0 + 1000000, a) == 0 && a[EYE_CH_LOOK_X] == 7.0f;
+
+    if (ok) {
+        PASS();
+    } else {
+        printf("(%f %f) ", a[EYE_CH_LOOK_X], b[EYE_CH_LOOK_X]);
+        FAIL("tween did not track time");
+    }
+}
+
+void test_clip_current() {
+    TEST("Blink clip starts from the current lid and layers over gaze");
+
+    EyeTimeline tl;
+    float v[EYE_CH_COUNT] = {};
+    v[EYE_CH_LID_LEFT] = 0.4f;
+    v[EYE_CH_LID_RIGHT] = 0.4f;
+    tl.tween(EYE_CH_LOOK_Y, 0.0f, -1.0f, 1000, Ease::LINEAR, 0);
+    tl.play(EYE_CLIP_BLINK, 0, v);
+
+    tl.sample(0, v);
+    bool ok = near(v[EYE_CH_LID_LEFT], 0.4f);
+    tl.sample(130000, v);                       // Held closed
+    ok = ok && near(v[EYE_CH_LID_LEFT], 1.0f) && near(v[EYE_CH_LID_RIGHT], 1.0f);
+    tl.sample(300000, v);                       // Open again, gaze still going
+    ok = ok && near(v[EYE_CH_LID_LEFT], 0.0f) && !tl.playing(EYE_CH_LID_LEFT) &&
+         tl.playing(EYE_CH_LOOK_Y) && near(v[EYE_CH_LOOK_Y], -0.3f);
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("wrong clip values");
+    }
+}
+
+void test_step_and_color() {
+    TEST("Step keys hold, iris colour blends per component");
+
+    static const EyeKey keys[] = {
+        {   0, 0.0f, Ease::STEP },
+        { 100, 1.0f, Ease::STEP },
+    };
+    static const EyeTrack tracks[] = { EYE_TRACK(EYE_CH_LID_RIGHT, keys) };
+    static const EyeClip clip = EYE_CLIP("step", tracks);
+
+    EyeTimeline tl;
+    float v[EYE_CH_COUNT] = {};
+    tl.play(clip, 0, v);
+    tl.sample(99000, v);
+    bool ok = v[EYE_CH_LID_RIGHT] == 0.0f;
+    tl.sample(100000, v);
+    ok = ok && v[EYE_CH_LID_RIGHT] == 1.0f;
+
+    // Red to blue: halfway is half of each, never green
+    tl.tween(EYE_CH_IRIS, (float)0xF800, (float)0x001F, 100, Ease::LINEAR, 0);
+    tl.sample(50000, v);
+    uint16_t c = (uint16_t)v[EYE_CH_IRIS];
+    ok = ok && (c >> 11) == 16 && ((c >> 5) & 0x3F) == 0 && (c & 0x1F) == 16;
+
+    if (ok) {
+        PASS();
+    } else {
+        printf("(0x%04x) ", c);
+        FAIL("wrong step or colour value");
+    }
+}
+
+int main() {
+    printf("=== Eye Timeline Tests ===\n");
+
+    test_easing();
+    test_tween_by_time();
+    test_clip_current();
+    test_step_and_color();
+
+    printf("\nResults: %d passed, %d failed\n", tests_passed, tests_failed);
+    return tests_failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,348 @@
+/**
+ * Gait Engine Unit Tests
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+
+#include "gait_engine.h"
+
+extern "C" {
+#include "limits.h"
+}
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST(name) printf("  %s: ", name)
+#define PASS() do { printf("PASS\n"); tests_passed++; } while(0)
+#define FAIL(msg) do { printf("FAIL - %s\n", msg); tests_failed++; } while(0)
+
+static GaitEngine::Params walk(GaitEngine::Gait gait, float dir, float turn = 0.0f) {
+    GaitEngine::Params p;
+    p.gait = gait;
+    p.dir = dir;
+    p.turn = turn;
+    return p;
+}
+
+static bool lifted(const uint16_t* us, int leg) {
+    return us[leg * 2 + 1] < SERVO_PWM_NEUTRAL_US;
+}
+
+void test_idle() {
+    TEST("Idle engine produces nothing");
+
+    GaitEngine gait;
+    uint16_t us[GAIT_LEG_CHANNELS];
+    uint32_t t_ms;
+    gait.setParams(walk(GaitEngine::Gait::TRIPOD, 0.0f));
+
+    if (!gait.active() && !gait.next(us, t_ms)) {
+        PASS();
+    } else {
+        FAIL("zero direction started walking");
+    }
+}
+
+void test_tripod_diagonals() {
+    TEST("Tripod swings diagonal pairs together");
+
+    GaitEngine gait;
+    gait.setParams(walk(GaitEngine::Gait::TRIPOD, 1.0f));
+
+    uint16_t us[GAIT_LEG_CHANNELS];
+    uint32_t t_ms;
+    bool ok = true;
+    bool swung[2] = { false, false };
+    for (int step = 0; step < GAIT_KEYFRAMES_PER_CYCLE; step++) {
+        gait.next(us, t_ms);
+        ok = ok && lifted(us, 0) == lifted(us, 3) && lifted(us, 1) == lifted(us, 2);
+        ok = ok && !(lifted(us, 0) && lifted(us, 1));
+        if (lifted(us, 0)) swung[0] = true;
+        if (lifted(us, 1)) swung[1] = true;
+    }
+
+    if (ok && swung[0] && swung[1]) {
+        PASS();
+    } else {
+        FAIL("pairs out of phase");
+    }
+}
+
+void test_wave_one_leg() {
+    TEST("Wave lifts one leg at a time, each once per cycle");
+
+    GaitEngine gait;
+    gait.setParams(walk(GaitEngine::Gait::WAVE, 1.0f));
+
+    uint16_t us[GAIT_LEG_CHANNELS];
+    uint32_t t_ms;
+    bool ok = true;
+    int swings[GAIT_LEG_COUNT] = {};
+    for (int step = 0; step < GAIT_KEYFRAMES_PER_CYCLE; step++) {
+        gait.next(us, t_ms);
+        int up = 0;
+        for (int leg = 0; leg < GAIT_LEG_COUNT; leg++) {
+            if (lifted(us, leg)) {
+                up++;
+                swings[leg]++;
+            }
+        }
+        ok = ok && up <= 1;
+    }
+    for (int leg = 0; leg < GAIT_LEG_COUNT; leg++) {
+        ok = ok && swings[leg] > 0;
+    }
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("more than one leg in the air");
+    }
+}
+
+void test_turn_in_place() {
+    TEST("Turning moves left and right coxas oppositely");
+
+    GaitEngine gait;
+    gait.setParams(walk(GaitEngine::Gait::TRIPOD, 0.0f, 1.0f));
+
+    uint16_t us[GAIT_LEG_CHANNELS];
+    uint32_t t_ms;
+    gait.next(us, t_ms);
+    gait.next(us, t_ms);
+
+    // FR (0) and RL (3) share a phase but sit on opposite sides
+    int right = (int)us[0] - SERVO_PWM_NEUTRAL_US;
+    int left = (int)us[6] - SERVO_PWM_NEUTRAL_US;
+    if (gait.active() && right != 0 && right == -left) {
+        PASS();
+    } else {
+        FAIL("sides not mirrored");
+    }
+}
+
+void test_clamping() {
+    TEST("Stride and speed are clamped");
+
+    GaitEngine gait;
+    GaitEngine::Params p = walk(GaitEngine::Gait::RIPPLE, 3.0f);
+    p.stride = 5.0f;
+    p.speed = 10.0f;
+    gait.setParams(p);
+
+    uint16_t us[GAIT_LEG_CHANNELS];
+    uint32_t t_ms = 0;
+    bool ok = gait.params().stride == STRIDE_FACTOR_MAX && gait.params().speed == GAIT_SPEED_MAX &&
+              gait.params().dir == 1.0f;
+    int max_sweep = 0;
+    for (int step = 0; step < GAIT_KEYFRAMES_PER_CYCLE; step++) {
+        gait.next(us, t_ms);
+        for (int leg = 0; leg < GAIT_LEG_COUNT; leg++) {
+            int d = abs((int)us[leg * 2] - SERVO_PWM_NEUTRAL_US);
+            if (d > max_sweep) max_sweep = d;
+        }
+    }
+    ok = ok && max_sweep <= (int)(GAIT_STRIDE_US * STRIDE_FACTOR_MAX / 2) &&
+         t_ms == (uint32_t)(GAIT_CYCLE_MS / GAIT_SPEED_MAX / GAIT_KEYFRAMES_PER_CYCLE + 0.5f);
+
+    if (ok) {
+        PASS();
+    } else {
+        printf("(sweep=%d t_ms=%u) ", max_sweep, t_ms);
+        FAIL("limits exceeded");
+    }
+}
+
+void test_speed_timing() {
+    TEST("Keyframe interval follows speed");
+
+    GaitEngine gait;
+    GaitEngine::Params p = walk(GaitEngine::Gait::TRIPOD, 1.0f);
+    uint16_t us[GAIT_LEG_CHANNELS];
+    uint32_t slow, fast;
+
+    gait.setParams(p);
+    gait.next(us, slow);
+    p.speed = 2.0f;
+    gait.setParams(p);
+    gait.next(us, fast);
+
+    if (slow == GAIT_CYCLE_MS / GAIT_KEYFRAMES_PER_CYCLE && fast * 2 >= slow - 1 && fast * 2 <= slow + 1) {
+        PASS();
+    } else {
+        FAIL("interval does not scale");
+    }
+}
+
+void test_stop() {
+    TEST("Stop ends with one neutral keyframe");
+
+    GaitEngine gait;
+    gait.setParams(walk(GaitEngine::Gait::TRIPOD, 1.0f));
+
+    uint16_t us[GAIT_LEG_CHANNELS];
+    uint32_t t_ms;
+    gait.next(us, t_ms);
+    gait.next(us, t_ms);
+    gait.setParams(walk(GaitEngine::Gait::WAVE, 0.0f));
+
+    bool ok = gait.active() && gait.next(us, t_ms) &&
+              gait.params().gait == GaitEngine::Gait::TRIPOD;
+    for (int i = 0; i < GAIT_LEG_CHANNELS; i++) {
+        ok = ok && us[i] == SERVO_PWM_NEUTRAL_US;
+    }
+    ok = ok && !gait.active() && !gait.next(us, t_ms);
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("did not return to neutral and idle");
+    }
+}
+
+void test_parse_gait() {
+    TEST("Gait names round-trip");
+
+    GaitEngine::Gait g;
+    bool ok = GaitEngine::parseGait("ripple", g) && g == GaitEngine::Gait::RIPPLE &&
+              GaitEngine::parseGait(GaitEngine::gaitName(GaitEngine::Gait::WAVE), g) &&
+              g == GaitEngine::Gait::WAVE &&
+              !GaitEngine::parseGait("gallop", g);
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("name mismatch");
+    }
+}
+
+void test_odometry() {
+    TEST("Odometry: straight walk advances x, a right turn turns clockwise");
+
+    uint16_t us[GAIT_LEG_CHANNELS];
+    uint32_t t_ms;
+    GaitEngine straight;
+    straight.setParams(walk(GaitEngine::Gait::TRIPOD, 1.0f));
+    for (int i = 0; i < GAIT_KEYFRAMES_PER_CYCLE * 4; i++) straight.next(us, t_ms);
+    GaitEngine::Odometry s = straight.odometry();
+
+    GaitEngine turning;
+    turning.setParams(walk(GaitEngine::Gait::TRIPOD, 0.0f, 1.0f));
+    for (int i = 0; i < GAIT_KEYFRAMES_PER_CYCLE; i++) turning.next(us, t_ms);
+    GaitEngine::Odometry t = turning.odometry();
+
+    // Stopping adds nothing
+    straight.setParams(walk(GaitEngine::Gait::TRIPOD, 0.0f));
+    straight.next(us, t_ms);
+    bool ok = s.x_mm > 10.0f && std::fabs(s.y_mm) < 0.01f && s.heading_rad == 0.0f &&
+              straight.odometry().x_mm == s.x_mm &&
+              t.heading_rad < -0.05f && std::fabs(t.x_mm) < 0.01f;
+    turning.resetOdometry();
+    ok = ok && turning.odometry().heading_rad == 0.0f;
+
+    if (ok) {
+        PASS();
+    } else {
+        printf("(x %.1f, turn %.3f rad) ", s.x_mm, t.heading_rad);
+        FAIL("wrong pose");
+    }
+}
+
+void test_cycle_cache() {
+    TEST("Steady walking is served from the cycle cache, speed shares a cycle");
+
+    GaitEngine gait;
+    GaitEngine::Params p = walk(GaitEngine::Gait::TRIPOD, 1.0f);
+    gait.setParams(p);
+    uint16_t us[GAIT_LEG_CHANNELS];
+    uint16_t first[GAIT_LEG_CHANNELS];
+    uint32_t t_ms;
+    gait.next(first, t_ms);
+    for (int i = 1; i < GAIT_KEYFRAMES_PER_CYCLE * 3; i++) gait.next(us, t_ms);
+    p.speed = 2.0f;
+    gait.setParams(p);
+    gait.next(us, t_ms);
+
+    bool ok = gait.cacheMisses() == 1 && gait.cacheHits() == GAIT_KEYFRAMES_PER_CYCLE * 3 &&
+              memcmp(us, first, sizeof(us)) == 0;
+
+    // More distinct cycles than entries: the oldest is computed again
+    for (int k = 0; k <= GAIT_CACHE_CYCLES; k++) {
+        gait.setParams(walk(GaitEngine::Gait::WAVE, 0.1f * (k + 1)));
+        gait.next(us, t_ms);
+    }
+    uint32_t misses = gait.cacheMisses();
+    gait.setParams(walk(GaitEngine::Gait::WAVE, 0.1f));
+    for (int i = 0; i < GAIT_BLEND_KEYFRAMES + 1; i++) gait.next(us, t_ms);
+    ok = ok && gait.cacheMisses() == misses + 1;
+
+    if (ok) {
+        PASS();
+    } else {
+        printf("(hits=%u misses=%u) ", gait.cacheHits(), gait.cacheMisses());
+        FAIL("cycles recomputed");
+    }
+}
+
+void test_blend() {
+    TEST("A change of direction blends from the old cycle to the new");
+
+    uint16_t fwd[GAIT_KEYFRAMES_PER_CYCLE][GAIT_LEG_CHANNELS];
+    uint16_t back[GAIT_KEYFRAMES_PER_CYCLE][GAIT_LEG_CHANNELS];
+    uint32_t t_ms;
+    GaitEngine a, b;
+    a.setParams(walk(GaitEngine::Gait::TRIPOD, 1.0f));
+    b.setParams(walk(GaitEngine::Gait::TRIPOD, -1.0f));
+    for (int i = 0; i < GAIT_KEYFRAMES_PER_CYCLE; i++) {
+        a.next(fwd[i], t_ms);
+        b.next(back[i], t_ms);
+    }
+
+    GaitEngine gait;
+    uint16_t us[GAIT_LEG_CHANNELS];
+    gait.setParams(walk(GaitEngine::Gait::TRIPOD, 1.0f));
+    gait.next(us, t_ms);
+    gait.next(us, t_ms);
+    gait.setParams(walk(GaitEngine::Gait::TRIPOD, -1.0f));
+
+    bool ok = true;
+    int step = 2;
+    for (int k = 1; k <= GAIT_BLEND_KEYFRAMES + 1; k++, step++) {
+        gait.next(us, t_ms);
+        float w = k > GAIT_BLEND_KEYFRAMES ? 1.0f : (float)k / (GAIT_BLEND_KEYFRAMES + 1);
+        for (int ch = 0; ch < GAIT_LEG_CHANNELS; ch++) {
+            float expect = fwd[step][ch] + w * ((int)back[step][ch] - (int)fwd[step][ch]);
+            ok = ok && std::fabs(us[ch] - expect) <= 0.5f;
+        }
+    }
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("no blend");
+    }
+}
+
+int main() {
+    printf("=== Gait Engine Tests ===\n");
+
+    test_idle();
+    test_tripod_diagonals();
+    test_wave_one_leg();
+    test_turn_in_place();
+    test_clamping();
+    test_speed_timing();
+    test_stop();
+    test_parse_gait();
+    test_odometry();
+    test_cycle_cache();
+    test_blend();
+
+    printf("\nResults: %d passed, %d failed\n", tests_passed, tests_failed);
+    return tests_failed > 0 ? 1 : 0;
+}
@@ -145,6 +145,254 @@ void test_interpolation_abort() {
     }
 }
 
+void test_interpolation_substeps() {
+    TEST("Substeps time a partial first tick");
+
+    uint16_t start[SERVO_COUNT_TOTAL];
+    uint16_t target[SERVO_COUNT_TOTAL];
+    uint16_t output[SERVO_COUNT_TOTAL];
+
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) {
+        start[i] = 1000;
+        target[i] = 2000;
+        output[i] = 1000;
+    }
+
+    // 4 substeps = 5 ms grid; 10 ms into a 100 ms move is 10%
+    interpolator_set_substeps(4);
+    interpolator_start(start, target, 100, INTERP_MODE_Q16);
+    interpolator_advance(output, 9000);
+    uint16_t partial = output[0];
+
+    // One substep is always taken, even for a tiny elapsed time
+    interpolator_advance(output, 100);
+    uint16_t minimum = output[0];
+
+    interpolator_set_substeps(1);
+
+    // Q16 truncates, so allow 1 us below the exact value
+    if (abs((int)partial - 1100) <= 1 && abs((int)minimum - 1150) <= 1) {
+        PASS();
+    } else {
+        char buf[64];
+        snprintf(buf, sizeof(buf), "Expected 1100/1150, got %u/%u", partial, minimum);
+        FAIL(buf);
+    }
+}
+
+static void fill(uint16_t* a, uint16_t v) {
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) a[i] = v;
+}
+
+void test_keyframes_c1() {
+    TEST("Keyframes pass a via-point without stopping");
+
+    uint16_t pos[SERVO_COUNT_TOTAL];
+    uint16_t kf[SERVO_COUNT_TOTAL];
+    uint16_t output[SERVO_COUNT_TOTAL];
+
+    fill(pos, 1000);
+    interpolator_reset(pos);
+    fill(kf, 1500);
+    interpolator_push(kf, 100);
+    fill(kf, 2000);
+    interpolator_push(kf, 100);
+
+    // Steps of 20 ms: samples at 80, 100 and 120 ms around the via-point
+    int samples[10];
+    bool done = false;
+    int n = 0;
+    while (!done && n < 10) {
+        done = interpolator_tick(output);
+        samples[n++] = output[0];
+    }
+
+    int before = samples[4] - samples[3];
+    int after = samples[5] - samples[4];
+    bool ok = done && output[0] == 2000 && abs(samples[4] - 1500) <= 1 &&
+              before > 50 && after > 50 && abs(before - after) <= 10;
+
+    if (ok) {
+        PASS();
+    } else {
+        char buf[80];
+        snprintf(buf, sizeof(buf), "80/100/120 ms = %d/%d/%d, end %u",
+                 samples[3], samples[4], samples[5], output[0]);
+        FAIL(buf);
+    }
+}
+
+void test_keyframes_no_overshoot() {
+    TEST("Keyframe reversal does not overshoot");
+
+    uint16_t pos[SERVO_COUNT_TOTAL];
+    uint16_t kf[SERVO_COUNT_TOTAL];
+    uint16_t output[SERVO_COUNT_TOTAL];
+
+    fill(pos, 1000);
+    interpolator_reset(pos);
+    fill(kf, 2000);
+    interpolator_push(kf, 100);
+    fill(kf, 1000);
+    interpolator_push(kf, 60);
+
+    uint16_t peak = 0;
+    bool done = false;
+    for (int tick = 0; tick < 20 && !done; tick++) {
+        done = interpolator_tick(output);
+        if (output[0] > peak) peak = output[0];
+    }
+
+    if (done && peak == 2000 && output[0] == 1000) {
+        PASS();
+    } else {
+        char buf[64];
+        snprintf(buf, sizeof(buf), "peak %u, end %u", peak, output[0]);
+        FAIL(buf);
+    }
+}
+
+void test_keyframes_replan() {
+    TEST("Late keyframe re-plans the running segment");
+
+    uint16_t pos[SERVO_COUNT_TOTAL];
+    uint16_t kf[SERVO_COUNT_TOTAL];
+    uint16_t output[SERVO_COUNT_TOTAL];
+
+    fill(pos, 1000);
+    interpolator_reset(pos);
+    fill(kf, 1500);
+    interpolator_push(kf, 100);
+
+    interpolator_tick(output);
+    interpolator_tick(output);
+    uint16_t at_40 = output[0];
+
+    fill(kf, 2000);
+    interpolator_push(kf, 100);
+
+    // No jump at the re-plan, and still moving at the old endpoint
+    interpolator_tick(output);
+    uint16_t at_60 = output[0];
+    interpolator_tick(output);
+    interpolator_tick(output);
+    uint16_t at_100 = output[0];
+    interpolator_tick(output);
+    uint16_t at_120 = output[0];
+
+    bool ok = at_60 > at_40 && at_60 - at_40 < 200 && abs((int)at_100 - 1500) <= 1 &&
+              at_120 - at_100 > 50;
+
+    if (ok) {
+        PASS();
+    } else {
+        char buf[80];
+        snprintf(buf, sizeof(buf), "40/60/100/120 ms = %u/%u/%u/%u", at_40, at_60, at_100, at_120);
+        FAIL(buf);
+    }
+}
+
+void test_keyframes_queue_full() {
+    TEST("Keyframe queue rejects when full");
+
+    uint16_t pos[SERVO_COUNT_TOTAL];
+    fill(pos, 1500);
+    interpolator_reset(pos);
+
+    // The first keyframe starts at once; INTERP_QUEUE_DEPTH more fit behind it
+    int accepted = 0;
+    for (int i = 0; i < INTERP_QUEUE_DEPTH + 4; i++) {
+        if (interpolator_push(pos, 100)) accepted++;
+    }
+    interpolator_abort();
+
+    if (accepted == INTERP_QUEUE_DEPTH + 1 && interpolator_is_idle()) {
+        PASS();
+    } else {
+        FAIL("Unexpected queue capacity");
+    }
+}
+
+void test_groups_independent() {
+    TEST("A scan-only start leaves the leg timelines running");
+
+    uint16_t start[SERVO_COUNT_TOTAL];
+    uint16_t target[SERVO_COUNT_TOTAL];
+    uint16_t output[SERVO_COUNT_TOTAL];
+    fill(start, 1000);
+    fill(target, 2000);
+    fill(output, 1000);
+
+    interpolator_set_substeps(1);
+    interpolator_reset(output);
+    interpolator_start(start, target, 100, INTERP_MODE_Q16);
+    interpolator_tick(output);
+    interpolator_tick(output);
+
+    // Leg values of a scan-only update are not looked at
+    uint16_t scan[SERVO_COUNT_TOTAL];
+    fill(scan, SERVO_PWM_MIN_US);
+    scan[SERVO_CHANNEL_SCAN] = 1800;
+    interpolator_start_groups(output, scan, 100, INTERP_MODE_Q16, 1u << SERVO_GROUP_SCAN);
+
+    bool ok = !interpolator_is_idle_groups(SERVO_GROUP_ALL & ~(1u << SERVO_GROUP_SCAN));
+    bool done = false;
+    for (int tick = 0; tick < 3; tick++) {
+        done = interpolator_tick(output);
+    }
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) {
+        if (i != SERVO_CHANNEL_SCAN && output[i] != 2000) ok = false;
+    }
+    ok = ok && !done && interpolator_is_idle_groups(1u << 0) &&
+         !interpolator_is_idle_groups(1u << SERVO_GROUP_SCAN) &&
+         output[SERVO_CHANNEL_SCAN] > 1400 && output[SERVO_CHANNEL_SCAN] < 1800;
+
+    for (int tick = 0; tick < 3 && !done; tick++) {
+        done = interpolator_tick(output);
+    }
+    ok = ok && done && output[SERVO_CHANNEL_SCAN] == 1800 && output[0] == 2000;
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("Leg timelines restarted or scan did not move");
+    }
+}
+
+void test_groups_push() {
+    TEST("Group keyframes queue per group, all or nothing");
+
+    uint16_t pos[SERVO_COUNT_TOTAL];
+    uint16_t output[SERVO_COUNT_TOTAL];
+    fill(pos, 1500);
+    fill(output, 1500);
+    interpolator_set_substeps(1);
+    interpolator_reset(output);
+
+    int accepted = 0;
+    for (int i = 0; i < INTERP_QUEUE_DEPTH + 4; i++) {
+        if (interpolator_push_groups(pos, 100, 1u << 0)) accepted++;
+    }
+    bool ok = accepted == INTERP_QUEUE_DEPTH + 1 && interpolator_is_idle_groups(1u << 1);
+
+    // Leg 0 is full, so the others do not take the keyframe either
+    ok = ok && !interpolator_push(pos, 100) && interpolator_is_idle_groups(1u << 1);
+    ok = ok && interpolator_push_groups(pos, 100, 1u << 1) && !interpolator_is_idle_groups(1u << 1);
+
+    // Each group advances by its own elapsed time
+    uint32_t elapsed[SERVO_GROUP_COUNT] = { 0, 100000, 0, 0, 0 };
+    interpolator_advance_groups(output, elapsed);
+    ok = ok && interpolator_is_idle_groups(1u << 1) && !interpolator_is_idle_groups(1u << 0);
+    interpolator_abort();
+    ok = ok && interpolator_is_idle();
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("Unexpected per-group queueing");
+    }
+}
+
 int main() {
     printf("=== Interpolator Tests ===\n");
 
@@ -152,6 +400,13 @@ int main() {
     test_interpolation_midpoint();
     test_interpolation_q16();
     test_interpolation_abort();
+    test_interpolation_substeps();
+    test_keyframes_c1();
+    test_keyframes_no_overshoot();
+    test_keyframes_replan();
+    test_keyframes_queue_full();
+    test_groups_independent();
+    test_groups_push();
 
     printf("\nResults: %d passed, %d failed\n", tests_passed, tests_failed);
     return tests_failed > 0 ? 1 : 0;
@@ -0,0 +1,260 @@
+/**
+ * JSON Tokenizer Unit Tests
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include "json_tokenizer.h"
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST(name) printf("  %s: ", name)
+#define PASS() do { printf("PASS\n"); tests_passed++; } while(0)
+#define FAIL(msg) do { printf("FAIL - %s\n", msg); tests_failed++; } while(0)
+
+static bool parse(JsonTokens& t, const char* json) {
+    return t.parse(json, strlen(json));
+}
+
+void test_flat_object() {
+    TEST("Flat object with string and int");
+
+    JsonTokens t;
+    if (!parse(t, "{\"type\":\"servo\",\"channel\":3,\"us\":1600}")) {
+        FAIL("parse failed");
+        return;
+    }
+    if (t.isString("type", "servo") && t.getInt("channel", -1) == 3 && t.getInt("us", -1) == 1600) {
+        PASS();
+    } else {
+        FAIL("wrong values");
+    }
+}
+
+void test_whitespace_insensitive() {
+    TEST("Whitespace around separators");
+
+    JsonTokens t;
+    if (!parse(t, " { \"type\" : \"move\" ,\n \"t_ms\" : -5 } ")) {
+        FAIL("parse failed");
+        return;
+    }
+    if (t.isString("type", "move") && t.getInt("t_ms", 0) == -5) {
+        PASS();
+    } else {
+        FAIL("wrong values");
+    }
+}
+
+void test_int_array() {
+    TEST("Integer array");
+
+    JsonTokens t;
+    parse(t, "{\"type\":\"servos\",\"us\":[1500, 1600,1700 ,2500]}");
+    uint16_t v[8];
+    int n = t.getUintArray("us", v, 8);
+    if (n == 4 && v[0] == 1500 && v[1] == 1600 && v[2] == 1700 && v[3] == 2500) {
+        PASS();
+    } else {
+        char buf[64];
+        snprintf(buf, sizeof(buf), "Expected 4 values, got %d", n);
+        FAIL(buf);
+    }
+}
+
+void test_float_array() {
+    TEST("Float array");
+
+    JsonTokens t;
+    parse(t, "{\"cmd\":\"feet\",\"pos\":[85.5, -40,-1.5e2 ,0]}");
+    float v[8];
+    int n = t.getFloatArray("pos", v, 8);
+    if (n == 4 && v[0] == 85.5f && v[1] == -40.0f && v[2] == -150.0f && v[3] == 0.0f) {
+        PASS();
+    } else {
+        char buf[64];
+        snprintf(buf, sizeof(buf), "Expected 4 values, got %d", n);
+        FAIL(buf);
+    }
+}
+
+void test_nested_flattened() {
+    TEST("Nested object keys are flattened");
+
+    JsonTokens t;
+    if (!parse(t, "{\"type\":\"scan_start\",\"profile\":{\"min_deg\":30,\"max_deg\":150},\"x\":1}")) {
+        FAIL("parse failed");
+        return;
+    }
+    if (t.getInt("min_deg", -1) == 30 && t.getInt("max_deg", -1) == 150 && t.getInt("x", -1) == 1) {
+        PASS();
+    } else {
+        FAIL("nested keys not found");
+    }
+}
+
+void test_float_and_bool() {
+    TEST("Float and bool values");
+
+    JsonTokens t;
+    parse(t, "{\"x\":-0.25,\"y\":0.5,\"on\":true}");
+    float x = t.getFloat("x", 9.0f);
+    float y = t.getFloat("y", 9.0f);
+    if (x > -0.26f && x < -0.24f && y > 0.49f && y < 0.51f && t.getBool("on", false)) {
+        PASS();
+    } else {
+        FAIL("wrong values");
+    }
+}
+
+void test_string_with_escape() {
+    TEST("Escaped quote inside string");
+
+    JsonTokens t;
+    if (!parse(t, "{\"name\":\"a\\\"b\",\"type\":\"servo\"}")) {
+        FAIL("parse failed");
+        return;
+    }
+    if (t.isString("type", "servo")) {
+        PASS();
+    } else {
+        FAIL("key after escaped string lost");
+    }
+}
+
+void test_missing_key_defaults() {
+    TEST("Missing key returns default");
+
+    JsonTokens t;
+    parse(t, "{\"type\":\"servo\"}");
+    char buf[8];
+    if (t.getInt("us", -1) == -1 && !t.getString("name", buf, sizeof(buf)) && !t.find("cmd")) {
+        PASS();
+    } else {
+        FAIL("unexpected value for missing key");
+    }
+}
+
+void test_malformed_rejected() {
+    TEST("Malformed input rejected");
+
+    JsonTokens t;
+    const char* bad[] = {
+        "",
+        "[1,2]",
+        "{\"type\":\"servo\"",
+        "{\"type\" \"servo\"}",
+        "{\"us\":[1,2}",
+        "{type:1}",
+    };
+    for (const char* json : bad) {
+        if (parse(t, json)) {
+            char buf[64];
+            snprintf(buf, sizeof(buf), "accepted '%s'", json);
+            FAIL(buf);
+            return;
+        }
+    }
+    PASS();
+}
+
+void test_array_of_objects() {
+    TEST("Objects of an array are stepped through in order");
+
+    JsonTokens t;
+    bool ok = parse(t, "{\"cmd\":\"batch\",\"cmds\":[ {\"cmd\":\"servo\",\"us\":[1,2]} ,"
+                       "{\"cmd\":\"look\",\"s\":\"}{\"},{\"cmd\":\"pose\"}]}");
+    const JsonToken* cmds = t.find("cmds");
+    const char* names[] = { "servo", "look", "pose" };
+    const char* cursor = nullptr;
+    const char* obj;
+    size_t len;
+    int n = 0;
+    while (ok && cmds && JsonTokens::nextObject(*cmds, cursor, obj, len)) {
+        JsonTokens e;
+        ok = n < 3 && e.parse(obj, len) && e.isString("cmd", names[n]);
+        n++;
+    }
+    ok = ok && n == 3 && cursor == nullptr;
+
+    // A non-object element stops the walk and leaves the cursor on it
+    ok = ok && parse(t, "{\"cmds\":[{\"a\":1},2]}");
+    cursor = nullptr;
+    n = 0;
+    while (ok && JsonTokens::nextObject(*t.find("cmds"), cursor, obj, len)) n++;
+    ok = ok && n == 1 && cursor != nullptr && *cursor == '2';
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("wrong elements");
+    }
+}
+
+void test_large_array() {
+    TEST("Arrays and strings over 64 KB keep their full span");
+
+    // 5000 commands: past 64 KB, where a 16-bit span would wrap
+    const int count = 5000;
+    std::string json = "{\"cmd\":\"batch\",\"cmds\":[";
+    for (int i = 0; i < count; i++) {
+        json += i > 0 ? ",{\"cmd\":\"pose\"}" : "{\"cmd\":\"pose\"}";
+    }
+    json += "],\"note\":\"" + std::string(70000, 'x') + "\"}";
+
+    JsonTokens t;
+    bool ok = t.parse(json.data(), json.size());
+    const JsonToken* cmds = t.find("cmds");
+    const JsonToken* note = t.find("note");
+    ok = ok && cmds && cmds->val_len > 65536 && cmds->val[cmds->val_len - 1] == ']' &&
+         note && note->val_len == 70000;
+
+    const char* cursor = nullptr;
+    const char* obj;
+    size_t len;
+    int n = 0;
+    while (ok && JsonTokens::nextObject(*cmds, cursor, obj, len)) n++;
+    ok = ok && n == count && cursor == nullptr;
+
+    if (ok) {
+        PASS();
+    } else {
+        printf("(%d objects) ", n);
+        FAIL("span truncated");
+    }
+}
+
+void test_hash_constexpr() {
+    TEST("Compile-time hash matches runtime hash");
+
+    constexpr uint32_t h = json_hash("scan_start");
+    const char* s = "scan_start";
+    if (h == json_hash(s, strlen(s)) && h != json_hash("scan_stop")) {
+        PASS();
+    } else {
+        FAIL("hash mismatch");
+    }
+}
+
+int main() {
+    printf("=== JSON Tokenizer Tests ===\n");
+
+    test_flat_object();
+    test_whitespace_insensitive();
+    test_int_array();
+    test_float_array();
+    test_nested_flattened();
+    test_float_and_bool();
+    test_string_with_escape();
+    test_missing_key_defaults();
+    test_malformed_rejected();
+    test_array_of_objects();
+    test_large_array();
+    test_hash_constexpr();
+
+    printf("\nResults: %d passed, %d failed\n", tests_passed, tests_failed);
+    return tests_failed > 0 ? 1 : 0;
+}
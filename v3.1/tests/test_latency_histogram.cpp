@@ -0,0 +1,125 @@
+/**
+ * Latency Histogram Unit Tests
+ */
+
+#include <cstdio>
+#include <cstdint>
+
+#include "latency_histogram.h"
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST(name) printf("  %s: ", name)
+#define PASS() do { printf("PASS\n"); tests_passed++; } while(0)
+#define FAIL(msg) do { printf("FAIL - %s\n", msg); tests_failed++; } while(0)
+
+// Histograms are ~2 KB; keep them off the stack like the daemon does
+static LatencyHistogram g_hist;
+static LatencyHistogram::Snapshot g_snap;
+
+void test_bucket_bounds() {
+    TEST("Every value lands in a bucket that contains it");
+
+    bool ok = true;
+    uint32_t values[] = { 0, 1, 15, 16, 17, 31, 32, 33, 100, 1000, 20000, 123456, 1u << 30, UINT32_MAX };
+    for (uint32_t v : values) {
+        size_t b = LatencyHistogram::bucketOf(v);
+        if (b >= LATENCY_BUCKETS || LatencyHistogram::bucketLow(b) > v || LatencyHistogram::bucketHigh(b) < v) {
+            ok = false;
+        }
+    }
+    // Buckets tile the range without gaps
+    for (size_t b = 1; ok && b < LATENCY_BUCKETS; b++) {
+        if (LatencyHistogram::bucketLow(b) != LatencyHistogram::bucketHigh(b - 1) + 1) ok = false;
+    }
+
+    if (ok && LatencyHistogram::bucketOf(UINT32_MAX) == LATENCY_BUCKETS - 1) {
+        PASS();
+    } else {
+        FAIL("bucket does not contain its value");
+    }
+}
+
+void test_precision() {
+    TEST("Bucket width stays within 1/16 of the value");
+
+    bool ok = true;
+    for (size_t b = LATENCY_SUB_COUNT; b < LATENCY_BUCKETS; b++) {
+        uint32_t low = LatencyHistogram::bucketLow(b);
+        uint32_t width = LatencyHistogram::bucketHigh(b) - low + 1;
+        if ((uint64_t)width * LATENCY_SUB_COUNT > low) ok = false;
+    }
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("bucket too wide");
+    }
+}
+
+void test_percentiles() {
+    TEST("Percentiles of 1..1000 us");
+
+    for (uint32_t v = 1; v <= 1000; v++) {
+        g_hist.record(v);
+    }
+    g_hist.snapshot(g_snap);
+
+    uint32_t p50 = g_snap.percentile(0.5);
+    uint32_t p99 = g_snap.percentile(0.99);
+    uint32_t p999 = g_snap.percentile(0.999);
+    bool ok = g_snap.count == 1000 && g_snap.max_us == 1000 &&
+              p50 >= 500 && p50 <= 500 + 500 / 16 &&
+              p99 >= 990 && p99 <= 1000 &&
+              p999 == 1000;
+
+    if (ok) {
+        PASS();
+    } else {
+        printf("(p50=%u p99=%u p999=%u) ", p50, p99, p999);
+        FAIL("percentile out of tolerance");
+    }
+}
+
+void test_interval() {
+    TEST("Snapshot difference covers only the interval");
+
+    LatencyHistogram::Snapshot before = g_snap;
+    for (int i = 0; i < 100; i++) {
+        g_hist.record(5000);
+    }
+    g_hist.snapshot(g_snap);
+    LatencyHistogram::Snapshot d = g_snap.since(before);
+
+    uint32_t p50 = d.percentile(0.5);
+    if (d.count == 100 && p50 >= 5000 && p50 <= 5000 + 5000 / 16 && d.max_us == p50) {
+        PASS();
+    } else {
+        FAIL("interval still sees earlier samples");
+    }
+}
+
+void test_empty() {
+    TEST("Empty snapshot reports zero");
+
+    LatencyHistogram::Snapshot s;
+    if (s.percentile(0.99) == 0 && s.since(s).count == 0) {
+        PASS();
+    } else {
+        FAIL("empty snapshot not zero");
+    }
+}
+
+int main() {
+    printf("=== Latency Histogram Tests ===\n");
+
+    test_bucket_bounds();
+    test_precision();
+    test_percentiles();
+    test_interval();
+    test_empty();
+
+    printf("\nResults: %d passed, %d failed\n", tests_passed, tests_failed);
+    return tests_failed > 0 ? 1 : 0;
+}
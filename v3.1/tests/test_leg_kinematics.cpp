@@ -0,0 +1,199 @@
+/**
+ * Leg Inverse Kinematics Unit Tests
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+
+#include "leg_kinematics.h"
+
+extern "C" {
+#include "limits.h"
+}
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST(name) printf("  %s: ", name)
+#define PASS() do { printf("PASS\n"); tests_passed++; } while(0)
+#define FAIL(msg) do { printf("FAIL - %s\n", msg); tests_failed++; } while(0)
+
+// Forward kinematics for one leg, same conventions as the solver
+static void forward(const LegKinematics::Config& c, int leg, float coxa, float femur, float tibia,
+                    FootTargets& out) {
+    float knee = tibia + (float)M_PI_2;
+    float dir = femur - (float)M_PI + knee;
+    float r = c.coxa_mm + c.femur_mm * std::cos(femur) + c.tibia_mm * std::cos(dir);
+    float z = c.femur_mm * std::sin(femur) + c.tibia_mm * std::sin(dir);
+
+    float lx = r * std::cos(coxa);
+    float ly = r * std::sin(coxa);
+    float a = c.hip_angle[leg];
+    out.x[leg] = c.hip_x[leg] + lx * std::cos(a) - ly * std::sin(a);
+    out.y[leg] = c.hip_y[leg] + lx * std::sin(a) + ly * std::cos(a);
+    out.z[leg] = z;
+}
+
+void test_atan2_accuracy() {
+    TEST("atan2Lut matches atan2 in all quadrants");
+
+    float worst = 0.0f;
+    for (int i = 0; i < 360; i++) {
+        float a = (float)i * (float)M_PI / 180.0f;
+        for (float mag = 0.5f; mag < 500.0f; mag *= 7.0f) {
+            float y = mag * std::sin(a);
+            float x = mag * std::cos(a);
+            float err = std::fabs(LegKinematics::atan2Lut(y, x) - std::atan2(y, x));
+            if (err > (float)M_PI) err = 2.0f * (float)M_PI - err;  // +-pi are the same angle
+            if (err > worst) worst = err;
+        }
+    }
+
+    if (worst < 3e-5f && LegKinematics::atan2Lut(0.0f, 0.0f) == 0.0f) {
+        PASS();
+    } else {
+        printf("(max error %g rad) ", worst);
+        FAIL("table too coarse");
+    }
+}
+
+void test_acos_accuracy() {
+    TEST("acosLut matches acos including the ends");
+
+    float worst = 0.0f;
+    for (int i = -1000; i <= 1000; i++) {
+        float c = (float)i / 1000.0f;
+        float err = std::fabs(LegKinematics::acosLut(c) - std::acos(c));
+        if (err > worst) worst = err;
+    }
+    bool clamped = LegKinematics::acosLut(1.5f) == LegKinematics::acosLut(1.0f);
+
+    if (worst < 3e-5f && clamped) {
+        PASS();
+    } else {
+        printf("(max error %g rad) ", worst);
+        FAIL("acos out of tolerance");
+    }
+}
+
+void test_neutral() {
+    TEST("Neutral feet solve to neutral pulse widths on 12 channels");
+
+    LegKinematics ik;
+    FootTargets feet;
+    ik.neutralFeet(feet);
+
+    uint16_t us[SERVO_COUNT_TOTAL] = {};
+    uint8_t unreachable = 0xFF;
+    uint16_t mask = ik.feetToServoUs(feet, us, &unreachable);
+
+    bool ok = mask == 0x0FFF && unreachable == 0;
+    for (int ch = 0; ch < 12; ch++) {
+        ok = ok && us[ch] >= SERVO_PWM_NEUTRAL_US - 1 && us[ch] <= SERVO_PWM_NEUTRAL_US + 1;
+    }
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("neutral stance not at 1500 us");
+    }
+}
+
+void test_round_trip() {
+    TEST("Solve inverts forward kinematics");
+
+    LegKinematics ik;
+    const LegKinematics::Config& c = ik.config();
+    float worst = 0.0f;
+    bool reachable = true;
+
+    for (float coxa = -0.6f; coxa <= 0.6f; coxa += 0.3f) {
+        for (float femur = -0.5f; femur <= 0.8f; femur += 0.25f) {
+            for (float tibia = -0.6f; tibia <= 0.9f; tibia += 0.3f) {
+                FootTargets feet;
+                for (int leg = 0; leg < IK_LEG_COUNT; leg++) {
+                    forward(c, leg, coxa, femur, tibia, feet);
+                }
+                JointAngles out;
+                reachable = reachable && ik.solve(feet, out) == 0;
+                for (int leg = 0; leg < IK_LEG_COUNT; leg++) {
+                    float e = std::fabs(out.coxa[leg] - coxa);
+                    e = std::fmax(e, std::fabs(out.femur[leg] - femur));
+                    e = std::fmax(e, std::fabs(out.tibia[leg] - tibia));
+                    if (e > worst) worst = e;
+                }
+            }
+        }
+    }
+
+    if (reachable && worst < 1e-3f) {
+        PASS();
+    } else {
+        printf("(max error %g rad) ", worst);
+        FAIL("round trip mismatch");
+    }
+}
+
+void test_unreachable() {
+    TEST("Out-of-reach target is flagged and extended");
+
+    LegKinematics ik;
+    FootTargets feet;
+    ik.neutralFeet(feet);
+    feet.x[1] += 500.0f;
+    feet.y[1] += 500.0f;
+
+    JointAngles out;
+    uint8_t unreachable = ik.solve(feet, out);
+
+    // Fully extended: tibia in line with the femur
+    if (unreachable == 0x02 && std::fabs(out.tibia[1] - (float)M_PI_2) < 1e-3f) {
+        PASS();
+    } else {
+        FAIL("far target not clamped to full extension");
+    }
+}
+
+void test_soft_limits() {
+    TEST("Pulse widths respect the angle soft limits and calibration");
+
+    LegKinematics::Config cfg;
+    cfg.dir[0][LegKinematics::FEMUR] = -1;
+    cfg.neutral_us[0][LegKinematics::COXA] = 1550;
+    LegKinematics ik;
+    ik.setConfig(cfg);
+
+    JointAngles angles = {};
+    angles.tibia[2] = 3.0f;      // Far past 155 degrees
+    angles.femur[0] = 0.1f;
+
+    uint16_t us[SERVO_COUNT_TOTAL] = {};
+    ik.toServoUs(angles, us);
+
+    uint16_t soft_max = (uint16_t)(SERVO_PWM_MIN_US + SERVO_ANGLE_MAX_DEG * 2000 / 180);
+    float femur_expected = SERVO_PWM_NEUTRAL_US - 0.1f * 2000.0f / (float)M_PI;
+    bool ok = us[SERVO_COUNT_LEGS + 2] >= soft_max - 1 && us[SERVO_COUNT_LEGS + 2] <= soft_max + 1 &&
+              std::fabs(us[1] - femur_expected) <= 1.0f && us[0] == 1550;
+
+    if (ok) {
+        PASS();
+    } else {
+        printf("(tibia=%u femur=%u coxa=%u) ", us[SERVO_COUNT_LEGS + 2], us[1], us[0]);
+        FAIL("limits or calibration not applied");
+    }
+}
+
+int main() {
+    printf("=== Leg Kinematics Tests ===\n");
+
+    test_atan2_accuracy();
+    test_acos_accuracy();
+    test_neutral();
+    test_round_trip();
+    test_unreachable();
+    test_soft_limits();
+
+    printf("\nResults: %d passed, %d failed\n", tests_passed, tests_failed);
+    return tests_failed > 0 ? 1 : 0;
+}
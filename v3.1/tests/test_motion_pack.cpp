@@ -0,0 +1,209 @@
+/**
+ * Motion Pack and Player Unit Tests
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "motion_pack.h"
+#include "motion_player.h"
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST(name) printf("  %s: ", name)
+#define PASS() do { printf("PASS\n"); tests_passed++; } while(0)
+#define FAIL(msg) do { printf("FAIL - %s\n", msg); tests_failed++; } while(0)
+
+// Two sequences: "wave" (3 frames, legs only) and "nod" (2 frames, all channels)
+static std::vector<uint8_t> build_pack() {
+    const char* names[] = { "wave", "nod" };
+    const uint32_t counts[] = { 3, 2 };
+    const uint16_t masks[] = { 0x00FF, 0x1FFF };
+
+    MotionPackHeader hdr = {};
+    hdr.magic = MOTION_PACK_MAGIC;
+    hdr.version = MOTION_PACK_VERSION;
+    hdr.sequence_count = 2;
+    hdr.frame_count = 5;
+    hdr.index_offset = sizeof(MotionPackHeader);
+    hdr.frames_offset = hdr.index_offset + 2 * sizeof(MotionPackEntry);
+    hdr.file_size = hdr.frames_offset + 5 * sizeof(MotionPackFrame);
+
+    std::vector<uint8_t> buf(hdr.file_size);
+    memcpy(buf.data(), &hdr, sizeof(hdr));
+
+    uint32_t first = 0;
+    for (int s = 0; s < 2; s++) {
+        MotionPackEntry e = {};
+        strcpy(e.name, names[s]);
+        e.name_hash = motion_pack_hash(names[s]);
+        e.first_frame = first;
+        e.frame_count = counts[s];
+        e.mask = masks[s];
+        for (uint32_t i = 0; i < counts[s]; i++) {
+            MotionPackFrame f = {};
+            f.t_ms = 100 * (i + 1);
+            for (int ch = 0; ch < SERVO_COUNT_TOTAL; ch++) {
+                f.servo_us[ch] = (uint16_t)(1000 + 100 * s + 10 * i + ch);
+            }
+            memcpy(buf.data() + hdr.frames_offset + (first + i) * sizeof(f), &f, sizeof(f));
+            e.duration_ms += f.t_ms;
+        }
+        memcpy(buf.data() + hdr.index_offset + s * sizeof(e), &e, sizeof(e));
+        first += counts[s];
+    }
+    return buf;
+}
+
+void test_lookup() {
+    TEST("Sequences are found by name");
+
+    std::vector<uint8_t> buf = build_pack();
+    MotionPack pack;
+    bool ok = pack.openBuffer(buf.data(), buf.size()) && pack.sequenceCount() == 2;
+
+    const MotionPackEntry* nod = pack.find("nod");
+    ok = ok && nod && nod->frame_count == 2 && nod->duration_ms == 300 &&
+         pack.frames(*nod)[1].servo_us[0] == 1110 && pack.find("missing") == nullptr &&
+         pack.find("wav") == nullptr;
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("lookup failed");
+    }
+}
+
+void test_validation() {
+    TEST("Corrupt packs are rejected");
+
+    std::vector<uint8_t> good = build_pack();
+    MotionPack pack;
+    bool ok = true;
+
+    std::vector<uint8_t> bad = good;
+    bad[0] ^= 0xFF;                                         // Magic
+    ok = ok && !pack.openBuffer(bad.data(), bad.size());
+
+    ok = ok && !pack.openBuffer(good.data(), good.size() - 1);   // Truncated
+
+    bad = good;
+    MotionPackEntry* e = (MotionPackEntry*)(bad.data() + sizeof(MotionPackHeader));
+    e[1].frame_count = 4;                                   // Runs past the frame table
+    ok = ok && !pack.openBuffer(bad.data(), bad.size());
+
+    bad = good;
+    e = (MotionPackEntry*)(bad.data() + sizeof(MotionPackHeader));
+    memset(e[0].name, 'x', MOTION_PACK_NAME_LEN);           // Unterminated name
+    ok = ok && !pack.openBuffer(bad.data(), bad.size());
+
+    if (ok && !pack.isOpen()) {
+        PASS();
+    } else {
+        FAIL("accepted a corrupt pack");
+    }
+}
+
+void test_file_mmap() {
+    TEST("Pack file is mapped read-only");
+
+    std::vector<uint8_t> buf = build_pack();
+    const char* path = "/tmp/test_motion_pack.smp";
+    FILE* f = fopen(path, "wb");
+    bool ok = f && fwrite(buf.data(), 1, buf.size(), f) == buf.size();
+    if (f) fclose(f);
+
+    MotionPack pack;
+    ok = ok && pack.open(path) && pack.find("wave") && pack.find("wave")->mask == 0x00FF;
+    pack.close();
+    remove(path);
+
+    if (ok && !pack.isOpen()) {
+        PASS();
+    } else {
+        FAIL("could not open pack file");
+    }
+}
+
+void test_play_once_with_blend() {
+    TEST("Player blends into the first frame and stops after one pass");
+
+    std::vector<uint8_t> buf = build_pack();
+    MotionPack pack;
+    pack.openBuffer(buf.data(), buf.size());
+    const MotionPackEntry* wave = pack.find("wave");
+
+    MotionPlayer player;
+    MotionPlayer::Request req;
+    req.entry = wave;
+    req.frames = pack.frames(*wave);
+    req.blend_ms = 400;
+    player.start(req);
+
+    uint16_t us[SERVO_COUNT_TOTAL];
+    uint32_t t[4] = {};
+    uint16_t flags;
+    bool ok = player.active() && player.mask() == 0x00FF;
+    int n = 0;
+    while (n < 4 && player.next(us, t[n], flags)) n++;
+
+    ok = ok && n == 3 && t[0] == 400 && t[1] == 200 && t[2] == 300 && us[0] == 1020 && !player.active();
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("wrong frames or timing");
+    }
+}
+
+void test_loop() {
+    TEST("Looping replays the sequence with stored timing");
+
+    std::vector<uint8_t> buf = build_pack();
+    MotionPack pack;
+    pack.openBuffer(buf.data(), buf.size());
+    const MotionPackEntry* nod = pack.find("nod");
+
+    MotionPlayer player;
+    MotionPlayer::Request req;
+    req.entry = nod;
+    req.frames = pack.frames(*nod);
+    req.loops = 0;
+    req.blend_ms = 500;
+    player.start(req);
+
+    uint16_t us[SERVO_COUNT_TOTAL];
+    uint32_t t_ms;
+    uint16_t flags;
+    bool ok = true;
+    for (int i = 0; i < 7; i++) {
+        ok = ok && player.next(us, t_ms, flags);
+        uint32_t expected = (i == 0) ? 500 : ((i % 2 == 0) ? 100 : 200);
+        ok = ok && t_ms == expected && us[12] == 1100 + 10 * (i % 2) + 12;
+    }
+    ok = ok && player.active() && player.loopsDone() == 3;
+    player.stop();
+    ok = ok && !player.active() && !player.next(us, t_ms, flags);
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("loop did not wrap");
+    }
+}
+
+int main() {
+    printf("=== Motion Pack Tests ===\n");
+
+    test_lookup();
+    test_validation();
+    test_file_mmap();
+    test_play_once_with_blend();
+    test_loop();
+
+    printf("\nResults: %d passed, %d failed\n", tests_passed, tests_failed);
+    return tests_failed > 0 ? 1 : 0;
+}
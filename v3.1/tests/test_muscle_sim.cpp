@@ -0,0 +1,800 @@
+/**
+ * Muscle Simulator Integration Tests
+ *
+ * Brain-side SharedMemory against the real Muscle runtime running on the
+ * host (sim/), so packets go through validation, the output task, the
+ * interpolator and the PCA9685 driver.
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <sys/mman.h>
+
+#include "shared_memory.h"
+#include "mailbox.h"
+
+extern "C" {
+#include "crc16_ccitt_false.h"
+#include "protocol_posedelta.h"
+#include "protocol_posepacketn.h"
+#include "timebase.h"
+#include "muscle_sim.h"
+#include "i2c_sim.h"
+#include "limits.h"
+#include "fault_flags.h"
+}
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST(name) printf("  %s: ", name)
+#define PASS() do { printf("PASS\n"); tests_passed++; } while(0)
+#define FAIL(msg) do { printf("FAIL - %s\n", msg); tests_failed++; } while(0)
+
+// Switch to servos neutral; loose for a loaded host, the Muscle itself needs well under 1 ms
+#define ESTOP_INPUT_BUDGET_US 5000
+// Without the interrupt: one 10 ms sampling period on top
+#define ESTOP_POLLED_BUDGET_US 15000
+
+static SharedMemory g_shm;
+static uint32_t g_seq = 0;
+
+// Wait up to timeout_ms for cond, heartbeating like the motion thread does
+template <typename Cond>
+static bool wait_for(Cond cond, uint32_t timeout_ms) {
+    for (uint32_t t = 0; t < timeout_ms; t += 10) {
+        if (t % 50 == 0) muscle_sim_mailbox(CMD_HEARTBEAT, 0);
+        if (cond()) return true;
+        timebase_delay_ms(10);
+    }
+    return cond();
+}
+
+static bool send_pose(const uint16_t* servo_us, uint32_t t_ms, uint16_t flags) {
+    PosePacket31 pkt;
+    posepacket31_init(&pkt, ++g_seq);
+    pkt.t_ms = t_ms;
+    pkt.flags |= flags;
+    memcpy(pkt.servo_us, servo_us, sizeof(pkt.servo_us));
+    pkt.crc16 = crc16_ccitt_false((const uint8_t*)&pkt, sizeof(pkt) - 2);
+
+    uint32_t write_idx = 0;
+    if (!g_shm.writePacket(&pkt, write_idx)) return false;
+    muscle_sim_mailbox(CMD_MOTION_PACKET, write_idx);
+    return true;
+}
+
+static bool send_raw(const PosePacket31& pkt) {
+    uint32_t write_idx = 0;
+    if (!g_shm.writePacket(&pkt, write_idx)) return false;
+    muscle_sim_mailbox(CMD_MOTION_PACKET, write_idx);
+    return true;
+}
+
+static bool telemetry_matches(const uint16_t* servo_us) {
+    SharedTelemetryData t;
+    return g_shm.readTelemetry(t) && memcmp(t.servo_us, servo_us, sizeof(t.servo_us)) == 0;
+}
+
+void test_attach() {
+    TEST("Muscle validates the published ring");
+
+    if (wait_for([] { return g_shm.muscleAccepted(); }, 1000) && !g_shm.layoutRejected()) {
+        PASS();
+    } else {
+        FAIL("ring not attached");
+    }
+}
+
+void test_immediate_pose() {
+    TEST("Immediate pose reaches telemetry and the PCA9685");
+
+    uint16_t target[SERVO_COUNT_TOTAL];
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) target[i] = (uint16_t)(1200 + 40 * i);
+
+    bool ok = send_pose(target, 0, 0) &&
+              wait_for([&] { return telemetry_matches(target); }, 1000);
+
+    // Register round trip loses at most a tick (~4.9 us)
+    for (int i = 0; ok && i < SERVO_COUNT_TOTAL; i++) {
+        ok = abs((int)i2c_sim_channel_us((uint8_t)i) - target[i]) <= 5;
+    }
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("pose not applied");
+    }
+}
+
+void test_single_burst() {
+    TEST("A pose change reaches the PCA9685 in one transaction");
+
+    uint16_t target[SERVO_COUNT_TOTAL];
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) target[i] = 1500;
+    bool ok = send_pose(target, 0, 0) && wait_for([&] { return telemetry_matches(target); }, 1000);
+    timebase_delay_ms(50);
+
+    // Channels at both ends, so a per-run driver would need two writes
+    I2cSimStats before, after;
+    i2c_sim_get_stats(&before);
+    target[0] = 1300;
+    target[SERVO_CHANNEL_SCAN] = 1700;
+    ok = ok && send_pose(target, 0, 0) && wait_for([&] { return telemetry_matches(target); }, 1000);
+    timebase_delay_ms(50);
+    i2c_sim_get_stats(&after);
+
+    ok = ok && after.transfers - before.transfers == 1 &&
+         after.bytes - before.bytes == 1 + 4 * SERVO_COUNT_TOTAL;
+
+    if (ok) {
+        PASS();
+    } else {
+        printf("(%u transfers) ", after.transfers - before.transfers);
+        FAIL("update split across transactions");
+    }
+}
+
+void test_parked() {
+    TEST("A settled pose parks the output task and the next packet wakes it");
+
+    uint16_t target[SERVO_COUNT_TOTAL];
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) target[i] = 1520;
+    bool ok = send_pose(target, 0, 0) && wait_for([&] { return telemetry_matches(target); }, 1000);
+    timebase_delay_ms(50);
+
+    SharedTelemetryData t;
+    uint32_t ticks = g_shm.readTelemetry(t) ? t.ticks : 0;
+    wait_for([] { return false; }, 200);               // Heartbeats only
+    ok = ok && g_shm.readTelemetry(t) && t.ticks == ticks && !t.interp_active;
+
+    target[0] = 1480;
+    uint64_t start = timebase_shared_us();
+    ok = ok && send_pose(target, 0, 0) && wait_for([&] { return telemetry_matches(target); }, 1000);
+    uint64_t wake_us = timebase_shared_us() - start;
+    ok = ok && wake_us < 2000000ULL / MOTION_UPDATE_HZ;  // Within two tick periods
+
+    if (ok) {
+        PASS();
+    } else {
+        printf("(%u ticks, %llu us) ", t.ticks - ticks, (unsigned long long)wake_us);
+        FAIL("output kept ticking or woke late");
+    }
+}
+
+void test_interpolated_pose() {
+    TEST("Timed pose is interpolated over t_ms");
+
+    uint16_t target[SERVO_COUNT_TOTAL];
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) target[i] = 1800;
+
+    uint64_t start = timebase_shared_us();
+    bool ok = send_pose(target, 300, FLAG_INTERP_Q16);
+
+    // Partway through, the output must be between the old and the new pose
+    bool midway = false;
+    ok = ok && wait_for([&] {
+        SharedTelemetryData t;
+        if (g_shm.readTelemetry(t) && t.interp_active && t.servo_us[0] > 1200 && t.servo_us[0] < 1800) {
+            midway = true;
+        }
+        return telemetry_matches(target);
+    }, 2000);
+    uint64_t elapsed_ms = (timebase_shared_us() - start) / 1000;
+
+    if (ok && midway && elapsed_ms >= 280) {
+        PASS();
+    } else {
+        printf("(%llu ms) ", (unsigned long long)elapsed_ms);
+        FAIL("no interpolation");
+    }
+}
+
+void test_scan_group() {
+    TEST("A scan-only packet leaves a running leg move alone");
+
+    uint16_t pose[SERVO_COUNT_TOTAL];
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) pose[i] = 1500;
+    bool ok = send_pose(pose, 0, 0) && wait_for([&] { return telemetry_matches(pose); }, 1000);
+
+    uint16_t legs[SERVO_COUNT_TOTAL];
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) legs[i] = 1900;
+    legs[SERVO_CHANNEL_SCAN] = 1500;
+    uint8_t leg_groups = (uint8_t)(SERVO_GROUP_ALL & ~(1u << SERVO_GROUP_SCAN));
+    ok = ok && send_pose(legs, 400, posepacket31_set_groups(FLAG_INTERP_Q16, leg_groups));
+    timebase_delay_ms(100);
+
+    // Stale leg values, as the Brain sends them; they must not be jumped to
+    pose[SERVO_CHANNEL_SCAN] = 1700;
+    ok = ok && send_pose(pose, 0, posepacket31_set_groups(0, 1u << SERVO_GROUP_SCAN));
+    SharedTelemetryData t;
+    ok = ok && wait_for([&] {
+        return g_shm.readTelemetry(t) && t.servo_us[SERVO_CHANNEL_SCAN] == 1700;
+    }, 1000);
+    bool moving = ok && t.servo_us[0] > 1500 && t.servo_us[0] < 1900;
+
+    legs[SERVO_CHANNEL_SCAN] = 1700;
+    ok = ok && wait_for([&] { return telemetry_matches(legs); }, 1000);
+
+    if (ok && moving) {
+        PASS();
+    } else {
+        printf("(ch0=%u) ", t.servo_us[0]);
+        FAIL("leg move restarted by the scan update");
+    }
+}
+
+// WatchdogState (muscle_rtos/safety/watchdog.h)
+enum { WDT_NORMAL = 0, WDT_HOLD = 2 };
+
+static uint8_t watchdog_state() {
+    SharedTelemetryData t;
+    return g_shm.readTelemetry(t) ? t.watchdog_state : 0xFF;
+}
+
+void test_alive_counter() {
+    TEST("brain_alive alone keeps the watchdog fed, and its stall trips it");
+
+    bool ok = (g_shm.getHeader()->muscle_flags & SHARED_FLAG_ALIVE_WATCH) != 0;
+
+    // No mailbox heartbeats at all from here
+    for (int i = 0; ok && i < 12; i++) {
+        ok = g_shm.bumpAlive();
+        timebase_delay_ms(50);
+    }
+    ok = ok && watchdog_state() == WDT_NORMAL;
+
+    timebase_delay_ms(HEARTBEAT_TIMEOUT_MS + 150);
+    uint8_t stalled = watchdog_state();
+
+    for (int i = 0; i < 4; i++) {
+        g_shm.bumpAlive();
+        timebase_delay_ms(50);
+    }
+    uint8_t resumed = watchdog_state();
+
+    if (ok && stalled == WDT_HOLD && resumed == WDT_NORMAL) {
+        PASS();
+    } else {
+        printf("(%u %u) ", stalled, resumed);
+        FAIL("watchdog did not follow brain_alive");
+    }
+}
+
+void test_load_monitor() {
+    TEST("Load monitor publishes stage timings and tick jitter");
+
+    SharedTelemetryData t;
+    bool ok = wait_for([&] {
+        return g_shm.readTelemetry(t) && t.stage[SHARED_LOAD_STAGE_TICK].count > 0;
+    }, 3000);
+
+    const SharedLoadStage& tick = t.stage[SHARED_LOAD_STAGE_TICK];
+    const SharedLoadStage& i2c = t.stage[SHARED_LOAD_STAGE_I2C];
+    uint64_t jitter = 0;
+    for (int i = 0; i < SHARED_JITTER_BINS; i++) jitter += t.jitter_hist[i];
+    ok = ok && t.cycles_per_us > 0 && tick.min_cycles <= tick.avg_cycles && tick.avg_cycles <= tick.max_cycles;
+    ok = ok && i2c.count == tick.count && t.stage[SHARED_LOAD_STAGE_WATCHDOG].count > 0;
+    ok = ok && jitter > 0 && jitter <= t.ticks;
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("load figures missing");
+    }
+}
+
+void test_ping() {
+    TEST("CMD_PING is answered with the request's seq and ordered stamps");
+
+    uint64_t tx_us = timebase_shared_us();
+    g_shm.writeProbe(7, tx_us);
+    muscle_sim_mailbox(CMD_PING, 7);
+
+    uint64_t tx = 0, rx = 0, echo = 0;
+    bool ok = wait_for([&] { return g_shm.readProbe(tx, rx, echo) == 7; }, 500);
+    ok = ok && tx == tx_us && rx >= tx && echo >= rx;
+
+    // A stale seq (overtaken request) is not answered
+    g_shm.writeProbe(9, timebase_shared_us());
+    muscle_sim_mailbox(CMD_PING, 8);
+    timebase_delay_ms(50);
+    ok = ok && g_shm.readProbe(tx, rx, echo) == 7;
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("wrong probe answer");
+    }
+}
+
+void test_acks() {
+    TEST("Every consumed packet is acked or nacked with its reason");
+
+    SharedAckRecord acks[8];
+    uint32_t lost = 0;
+    g_shm.readAcks(acks, 8, lost);      // Skip what earlier tests produced
+
+    uint16_t pose[SERVO_COUNT_TOTAL];
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) pose[i] = 1400;
+    bool ok = send_pose(pose, 0, 0);
+    uint32_t good_seq = g_seq;
+
+    PosePacket31 pkt;
+    posepacket31_init(&pkt, ++g_seq);
+    memcpy(pkt.servo_us, pose, sizeof(pkt.servo_us));
+    pkt.crc16 = 0;                                              // Bad CRC
+    ok = ok && send_raw(pkt);
+    posepacket31_init(&pkt, good_seq);                          // Stale seq
+    memcpy(pkt.servo_us, pose, sizeof(pkt.servo_us));
+    pkt.crc16 = crc16_ccitt_false((const uint8_t*)&pkt, sizeof(pkt) - 2);
+    ok = ok && send_raw(pkt);
+
+    size_t n = 0;
+    wait_for([&] {
+        n += g_shm.readAcks(acks + n, 8 - n, lost);
+        return n >= 3;
+    }, 500);
+    ok = ok && n == 3 && lost == 0 &&
+         acks[0].seq == good_seq && acks[0].status == SHARED_ACK_OK &&
+         acks[1].seq == good_seq + 1 && acks[1].status == SHARED_NACK_CRC &&
+         acks[2].seq == good_seq && acks[2].status == SHARED_NACK_SEQ;
+
+    if (ok) {
+        PASS();
+    } else {
+        printf("(n=%zu) ", n);
+        FAIL("wrong ACK records");
+    }
+}
+
+void test_delta_merge() {
+    TEST("Delta packet changes only its channels");
+
+    uint16_t pose[SERVO_COUNT_TOTAL];
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) pose[i] = 1300;
+    bool ok = send_pose(pose, 0, 0) && wait_for([&] { return telemetry_matches(pose); }, 1000);
+
+    pose[3] = 1900;
+    pose[SERVO_CHANNEL_SCAN] = 1100;
+    PosePacket31 pkt;
+    PosePacketDelta* d = reinterpret_cast<PosePacketDelta*>(&pkt);
+    uint16_t mask = (uint16_t)((1u << 3) | (1u << SERVO_CHANNEL_SCAN));
+    posedelta_init(d, ++g_seq, 0, FLAG_CLAMP_ENABLE, mask, pose);
+    posedelta_set_crc(d, crc16_ccitt_false((const uint8_t*)d, posedelta_crc_len(mask)));
+    ok = ok && send_raw(pkt) && wait_for([&] { return telemetry_matches(pose); }, 1000);
+
+    // Still 13 channels on the bus side
+    for (int i = 0; ok && i < SERVO_COUNT_TOTAL; i++) {
+        ok = abs((int)i2c_sim_channel_us((uint8_t)i) - pose[i]) <= 5;
+    }
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("delta not merged");
+    }
+}
+
+static bool send_wide(const uint16_t* servo_us, uint8_t count) {
+    PosePacketN pkt;
+    posepacketn_init(&pkt, ++g_seq, 0, FLAG_CLAMP_ENABLE, count, servo_us);
+    posepacketn_set_crc(&pkt, crc16_ccitt_false((const uint8_t*)&pkt, posepacketn_crc_len(&pkt)));
+
+    uint32_t write_idx = 0;
+    if (g_shm.writePacketsN(&pkt, 1, write_idx) != 1) return false;
+    muscle_sim_mailbox(CMD_MOTION_PACKET, write_idx);
+    return true;
+}
+
+// Republish the ring sized for channels, as a restarted Brain would
+static bool remap(uint32_t channels) {
+    g_shm.unmap();
+    g_shm.setChannels(channels);
+    return g_shm.map() && wait_for([] { return muscle_sim_mailbox(CMD_MOTION_PACKET, 0),
+                                               g_shm.muscleAccepted(); }, 1000);
+}
+
+void test_wide_slots() {
+    TEST("PosePacketN through 128-byte slots; too many channels dropped");
+
+    bool ok = remap(POSEPACKETN_MAX_CHANNELS) && g_shm.getSlotSize() == PACKET_SLOT_SIZE_MAX &&
+              !g_shm.layoutRejected();
+
+    uint16_t pose[POSEPACKETN_MAX_CHANNELS];
+    for (int i = 0; i < POSEPACKETN_MAX_CHANNELS; i++) pose[i] = (uint16_t)(1100 + 50 * i);
+    ok = ok && send_wide(pose, SERVO_COUNT_TOTAL) &&
+         wait_for([&] { return telemetry_matches(pose); }, 1000);
+    for (int i = 0; ok && i < SERVO_COUNT_TOTAL; i++) {
+        ok = abs((int)i2c_sim_channel_us((uint8_t)i) - pose[i]) <= 5;
+    }
+
+    // This Muscle drives SERVO_COUNT_TOTAL channels
+    SharedTelemetryData t;
+    uint32_t drops = g_shm.readTelemetry(t) ? t.drop_count : 0;
+    ok = ok && send_wide(pose, SERVO_COUNT_TOTAL + 1) &&
+         wait_for([&] { return g_shm.readTelemetry(t) && t.drop_count == drops + 1; }, 1000);
+
+    // Too wide for 64-byte slots: refused on the Brain side
+    ok = remap(SERVO_COUNT_TOTAL) && ok && g_shm.getSlotSize() == PACKET_SLOT_SIZE &&
+         !send_wide(pose, POSEPACKETN_SLOT64_CHANNELS + 1);
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("wide packet not handled");
+    }
+}
+
+void test_latest_wins() {
+    TEST("A backlog of immediate poses is merged and only the newest output");
+
+    SharedAckRecord acks[8];
+    uint32_t lost = 0;
+    g_shm.readAcks(acks, 8, lost);
+
+    uint16_t pose[SERVO_COUNT_TOTAL];
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) pose[i] = 1450;
+    bool ok = send_pose(pose, 0, 0) && wait_for([&] { return telemetry_matches(pose); }, 1000);
+    g_shm.readAcks(acks, 8, lost);
+    uint32_t rx_before = 0, skip_before = 0;
+    SharedTelemetryData t;
+    if (g_shm.readTelemetry(t)) {
+        rx_before = t.rx_count;
+        skip_before = t.skip_count;
+    }
+
+    // Queue four without notifying, as if the Muscle had stalled: a full pose, then deltas
+    PosePacket31 pkts[4];
+    uint16_t expect[SERVO_COUNT_TOTAL];
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) expect[i] = 1550;
+    posepacket31_init(&pkts[0], ++g_seq);
+    memcpy(pkts[0].servo_us, expect, sizeof(expect));
+    pkts[0].crc16 = crc16_ccitt_false((const uint8_t*)&pkts[0], sizeof(pkts[0]) - 2);
+    for (int k = 1; k < 4; k++) {
+        int ch = 2 * k;
+        expect[ch] = (uint16_t)(1200 + 100 * k);
+        uint16_t mask = (uint16_t)(1u << ch);
+        PosePacketDelta* d = reinterpret_cast<PosePacketDelta*>(&pkts[k]);
+        posedelta_init(d, ++g_seq, 0, FLAG_CLAMP_ENABLE, mask, expect);
+        posedelta_set_crc(d, crc16_ccitt_false((const uint8_t*)d, posedelta_crc_len(mask)));
+    }
+
+    uint32_t write_idx = 0;
+    ok = ok && g_shm.writePackets(pkts, 4, write_idx, nullptr) == 4;
+    muscle_sim_mailbox(CMD_MOTION_PACKET, write_idx);
+
+    size_t n = 0;
+    ok = ok && wait_for([&] {
+        n += g_shm.readAcks(acks + n, 8 - n, lost);
+        return n >= 4;
+    }, 1000);
+    uint32_t skipped = 0;
+    for (size_t i = 0; ok && i < n; i++) {
+        if (acks[i].status == SHARED_ACK_SKIPPED) skipped++;
+        else ok = acks[i].status == SHARED_ACK_OK;
+    }
+    ok = ok && n == 4 && acks[3].seq == g_seq && acks[3].status == SHARED_ACK_OK && skipped > 0;
+    ok = ok && wait_for([&] { return telemetry_matches(expect); }, 1000);
+    ok = ok && g_shm.readTelemetry(t) && t.skip_count - skip_before == skipped &&
+         t.rx_count - rx_before == 4 - skipped;
+
+    if (ok) {
+        PASS();
+    } else {
+        printf("(n=%zu skipped=%u) ", n, skipped);
+        FAIL("backlog not collapsed to the newest pose");
+    }
+}
+
+void test_prefetch() {
+    TEST("A scheduled keyframe frees its slot at once and plays on its deadline");
+
+    SharedAckRecord acks[8];
+    uint32_t lost = 0;
+    g_shm.readAcks(acks, 8, lost);
+
+    uint16_t pose[SERVO_COUNT_TOTAL];
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) pose[i] = 1500;
+    bool ok = send_pose(pose, 0, 0) && wait_for([&] { return telemetry_matches(pose); }, 1000);
+    g_shm.readAcks(acks, 8, lost);
+
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) pose[i] = 1580;
+    PosePacket31 pkt;
+    posepacket31_init(&pkt, ++g_seq);
+    memcpy(pkt.servo_us, pose, sizeof(pkt.servo_us));
+    pkt.crc16 = crc16_ccitt_false((const uint8_t*)&pkt, sizeof(pkt) - 2);
+    uint64_t due = timebase_shared_us() + 300000;
+    uint32_t write_idx = 0;
+    ok = ok && g_shm.writePackets(&pkt, 1, write_idx, &due) == 1;
+    muscle_sim_mailbox(CMD_MOTION_PACKET, write_idx);
+
+    // Acked and off the ring long before it is due, the servos still on the old pose
+    size_t n = 0;
+    ok = ok && wait_for([&] {
+        n += g_shm.readAcks(acks + n, 8 - n, lost);
+        return n >= 1 && g_shm.refreshReadIdx() == g_shm.getWriteIdx();
+    }, 100);
+    ok = ok && n == 1 && acks[0].seq == g_seq && acks[0].status == SHARED_ACK_OK;
+    ok = ok && timebase_shared_us() < due && !telemetry_matches(pose);
+
+    ok = ok && wait_for([&] { return telemetry_matches(pose); }, 1000) &&
+         timebase_shared_us() >= due;
+
+    if (ok) {
+        PASS();
+    } else {
+        printf("(n=%zu) ", n);
+        FAIL("keyframe not prefetched or played early");
+    }
+}
+
+void test_overwrite_oldest() {
+    TEST("Overwriting a full ring gets the newest pose through");
+
+    uint16_t pose[SERVO_COUNT_TOTAL];
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) pose[i] = 1500;
+    bool ok = send_pose(pose, 0, 0) && wait_for([&] { return telemetry_matches(pose); }, 1000);
+    SharedTelemetryData t;
+    uint32_t overruns = g_shm.readTelemetry(t) ? t.overrun_count : 0;
+
+    // Keyframes due in 300 ms fill the Muscle's prefetch queue, so it stops at the head
+    // of the ring; fill the ring behind them without notifying
+    PosePacket31 pkts[MUSCLE_PREFETCH_DEPTH];
+    uint64_t due[MUSCLE_PREFETCH_DEPTH];
+    uint64_t at = timebase_shared_us() + 300000;
+    for (int k = 0; k < MUSCLE_PREFETCH_DEPTH; k++) {
+        posepacket31_init(&pkts[k], ++g_seq);
+        memcpy(pkts[k].servo_us, pose, sizeof(pkts[k].servo_us));
+        pkts[k].crc16 = crc16_ccitt_false((const uint8_t*)&pkts[k], sizeof(pkts[k]) - 2);
+        due[k] = at;
+    }
+    uint32_t write_idx = 0;
+    ok = ok && g_shm.writePackets(pkts, MUSCLE_PREFETCH_DEPTH, write_idx, due) == MUSCLE_PREFETCH_DEPTH;
+    muscle_sim_mailbox(CMD_MOTION_PACKET, write_idx);
+    ok = ok && wait_for([&] { return g_shm.refreshReadIdx() == g_shm.getWriteIdx(); }, 200);
+    PosePacket31 pkt;
+    while (ok && !g_shm.isFull()) {
+        posepacket31_init(&pkt, ++g_seq);
+        memcpy(pkt.servo_us, pose, sizeof(pkt.servo_us));
+        pkt.crc16 = crc16_ccitt_false((const uint8_t*)&pkt, sizeof(pkt) - 2);
+        ok = g_shm.writePackets(&pkt, 1, write_idx) == 1;
+        g_shm.refreshReadIdx();
+    }
+    ok = ok && !g_shm.writePacket(&pkt, write_idx);            // Rejected as before
+
+    // The newest pose replaces the oldest unread slot; the rest drains once the queue moves
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) pose[i] = 1650;
+    posepacket31_init(&pkt, ++g_seq);
+    memcpy(pkt.servo_us, pose, sizeof(pkt.servo_us));
+    pkt.crc16 = crc16_ccitt_false((const uint8_t*)&pkt, sizeof(pkt) - 2);
+    uint32_t overwritten = 0;
+    ok = ok && g_shm.overwritePackets(&pkt, 1, write_idx, nullptr, overwritten) == 1 && overwritten == 1;
+    muscle_sim_mailbox(CMD_MOTION_PACKET, write_idx);
+
+    ok = ok && wait_for([&] { return telemetry_matches(pose); }, 2000);
+    ok = ok && g_shm.readTelemetry(t) && t.overrun_count - overruns == 1;
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("newest pose not applied after the overwrite");
+    }
+}
+
+static uint32_t output_ticks() {
+    SharedTelemetryData t;
+    return g_shm.readTelemetry(t) ? t.ticks : 0;
+}
+
+static bool tunables_applied(uint32_t gen, SharedTunablesApplied& out) {
+    return wait_for([&] { return g_shm.readTunablesApplied(out) && out.generation == gen; }, 1000);
+}
+
+void test_tunables() {
+    TEST("A published tunables set changes the output rate at the next tick");
+
+    // A long move keeps the output task ticking instead of parked
+    uint16_t pose[SERVO_COUNT_TOTAL];
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) pose[i] = 1300;
+    bool ok = send_pose(pose, 0, 0) && wait_for([&] { return telemetry_matches(pose); }, 1000);
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) pose[i] = 1700;
+    ok = ok && send_pose(pose, 2000, 0);
+
+    SharedTunablesData d;
+    shared_tunables_defaults(&d);
+    d.output_hz = 25;
+    d.interp_substeps = 2;
+    SharedTunablesApplied applied;
+    uint32_t gen = g_shm.writeTunables(d);
+    ok = ok && gen != 0 && tunables_applied(gen, applied);
+    ok = ok && applied.data.output_hz == 25 && applied.data.interp_substeps == 2 && applied.clamped == 0;
+
+    // 20 ticks at the default 50 Hz; allow a loaded host some slack
+    uint32_t before = output_ticks();
+    wait_for([] { return false; }, 400);
+    uint32_t slow = output_ticks() - before;
+    ok = ok && slow >= 6 && slow <= 13;
+
+    // Out of range is clamped, and says so
+    d.output_hz = 1000;
+    gen = g_shm.writeTunables(d);
+    ok = ok && tunables_applied(gen, applied) && applied.data.output_hz == TUNABLE_OUTPUT_HZ_MAX &&
+         applied.clamped == TUNABLE_BIT_OUTPUT_HZ;
+
+    shared_tunables_defaults(&d);
+    gen = g_shm.writeTunables(d);
+    ok = ok && tunables_applied(gen, applied) && applied.data.output_hz == MOTION_UPDATE_HZ;
+
+    if (ok) {
+        PASS();
+    } else {
+        printf("(%u ticks in 400 ms) ", slow);
+        FAIL("tunables not applied");
+    }
+}
+
+void test_estop_input() {
+    TEST("E-STOP input stops the servos and raises SHARED_FLAG_ESTOP");
+
+    uint16_t pose[SERVO_COUNT_TOTAL];
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) pose[i] = 1300;
+    bool ok = send_pose(pose, 0, 0) && wait_for([&] { return telemetry_matches(pose); }, 1000);
+    ok = ok && !g_shm.muscleEstop();
+
+    // Nothing from the Brain side: only the line goes high
+    uint64_t pressed_us = timebase_shared_us();
+    muscle_sim_estop_input(1);
+    uint64_t neutral_us = 0;
+    while (neutral_us == 0 && timebase_shared_us() - pressed_us < 100000) {
+        if (abs((int)i2c_sim_channel_us(0) - SERVO_PWM_NEUTRAL_US) <= 5) neutral_us = timebase_shared_us();
+    }
+    // One ALL_LED write is ~150 us on the simulated bus; the rest is host thread wake-up
+    ok = ok && neutral_us != 0 && neutral_us - pressed_us < ESTOP_INPUT_BUDGET_US;
+    ok = ok && wait_for([&] { return g_shm.muscleEstop(); }, 500);
+    muscle_sim_estop_input(0);
+
+    if (ok) {
+        PASS();
+    } else if (neutral_us != 0) {
+        char msg[64];
+        snprintf(msg, sizeof(msg), "neutral after %llu us", (unsigned long long)(neutral_us - pressed_us));
+        FAIL(msg);
+    } else {
+        FAIL("servos not driven neutral");
+    }
+}
+
+// --estop-irq-missing only: the output task samples the line instead
+void test_estop_input_polled() {
+    TEST("Without its interrupt the E-STOP input is sampled, parked or not");
+
+    uint16_t pose[SERVO_COUNT_TOTAL];
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) pose[i] = 1300;
+    bool ok = send_pose(pose, 0, 0) && wait_for([&] { return telemetry_matches(pose); }, 1000);
+    timebase_delay_ms(50);
+
+    // Sampling does not count as ticks: the output task stays parked
+    SharedTelemetryData t;
+    uint32_t ticks = g_shm.readTelemetry(t) ? t.ticks : 0;
+    wait_for([] { return false; }, 200);
+    ok = ok && g_shm.readTelemetry(t) && t.ticks == ticks &&
+         (t.fault_flags & FAULT_ESTOP_INPUT_POLLED) && !g_shm.muscleEstop();
+
+    uint64_t pressed_us = timebase_shared_us();
+    muscle_sim_estop_input(1);
+    uint64_t neutral_us = 0;
+    while (neutral_us == 0 && timebase_shared_us() - pressed_us < 100000) {
+        if (abs((int)i2c_sim_channel_us(0) - SERVO_PWM_NEUTRAL_US) <= 5) neutral_us = timebase_shared_us();
+    }
+    ok = ok && neutral_us != 0 && neutral_us - pressed_us < ESTOP_POLLED_BUDGET_US;
+    ok = ok && wait_for([&] { return g_shm.muscleEstop(); }, 500);
+    muscle_sim_estop_input(0);
+
+    if (ok) {
+        PASS();
+    } else if (neutral_us != 0) {
+        char msg[64];
+        snprintf(msg, sizeof(msg), "neutral after %llu us", (unsigned long long)(neutral_us - pressed_us));
+        FAIL(msg);
+    } else {
+        FAIL("servos not driven neutral");
+    }
+}
+
+// Runs after test_estop_input(): the Muscle stays latched, so only the
+// mailbox path's own effects (flushing the ring) are new here
+void test_estop() {
+    TEST("Mailbox E-STOP drives all servos neutral and flushes the ring");
+
+    muscle_sim_mailbox(CMD_ESTOP, 0);
+
+    uint16_t neutral[SERVO_COUNT_TOTAL];
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) neutral[i] = SERVO_PWM_NEUTRAL_US;
+
+    bool ok = wait_for([&] {
+        SharedTelemetryData t;
+        return g_shm.readTelemetry(t) && t.estop && telemetry_matches(neutral);
+    }, 1000);
+
+    I2cSimStats stats;
+    i2c_sim_get_stats(&stats);
+    ok = ok && stats.transfers > 0 && stats.nacks == 0 && stats.busy_us > 0;
+
+    // Packets reaching the ring while latched are flushed, not applied
+    SharedAckRecord acks[8];
+    uint32_t lost = 0;
+    while (g_shm.readAcks(acks, 8, lost) > 0) {}
+    uint16_t pose[SERVO_COUNT_TOTAL];
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) pose[i] = 1700;
+    ok = ok && send_pose(pose, 0, 0);
+    size_t n = 0;
+    ok = ok && wait_for([&] {
+        n += g_shm.readAcks(acks + n, 8 - n, lost);
+        return n >= 1;
+    }, 500);
+    ok = ok && acks[0].seq == g_seq && acks[0].status == SHARED_NACK_ESTOP && telemetry_matches(neutral);
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("E-STOP not applied");
+    }
+}
+
+static int finish(void* region) {
+    muscle_sim_stop();
+    g_shm.unmap();
+    munmap(region, SHARED_MEM_SIZE);
+
+    printf("\nResults: %d passed, %d failed\n", tests_passed, tests_failed);
+    return tests_failed > 0 ? 1 : 0;
+}
+
+int main(int argc, char** argv) {
+    printf("=== Muscle Simulator Tests ===\n");
+
+    // The runtime starts once per process, so this variant is its own run
+    bool irq_missing = argc > 1 && strcmp(argv[1], "--estop-irq-missing") == 0;
+    muscle_sim_estop_irq_missing(irq_missing);
+
+    void* region = mmap(nullptr, SHARED_MEM_SIZE, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED || muscle_sim_start(region) != 0) {
+        printf("Cannot start the simulator\n");
+        return 1;
+    }
+    g_shm.setRegion(region);
+    if (!g_shm.map()) {
+        printf("Cannot map the ring\n");
+        return 1;
+    }
+
+    test_attach();
+    test_immediate_pose();
+    if (irq_missing) {
+        test_estop_input_polled();
+        test_estop();
+        return finish(region);
+    }
+    test_single_burst();
+    test_parked();
+    test_interpolated_pose();
+    test_alive_counter();
+    test_load_monitor();
+    test_ping();
+    test_acks();
+    test_delta_merge();
+    test_scan_group();
+    test_latest_wins();
+    test_prefetch();
+    test_overwrite_oldest();
+    test_wide_slots();
+    test_tunables();
+    test_estop_input();
+    test_estop();
+
+    return finish(region);
+}
@@ -0,0 +1,183 @@
+/**
+ * Obstacle Avoider Unit Tests
+ */
+
+#include <cstdio>
+#include <cstdint>
+
+#include "obstacle_avoider.h"
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST(name) printf("  %s: ", name)
+#define PASS() do { printf("PASS\n"); tests_passed++; } while(0)
+#define FAIL(msg) do { printf("FAIL - %s\n", msg); tests_failed++; } while(0)
+
+using Action = ObstacleAvoider::Action;
+
+static void fill(int* sector_mm, int mm) {
+    for (size_t i = 0; i < SCAN_SECTOR_COUNT; i++) {
+        sector_mm[i] = mm;
+    }
+}
+
+static GaitEngine::Params forward() {
+    GaitEngine::Params p;
+    p.dir = 1.0f;
+    p.speed = 1.0f;
+    return p;
+}
+
+void test_thresholds() {
+    TEST("Front distance picks forward, slow and back-up");
+
+    ObstacleAvoider a;
+    int sectors[SCAN_SECTOR_COUNT];
+    fill(sectors, -1);
+
+    bool ok = a.evaluate(sectors, 1000).action == Action::SLOW;    // Nothing known yet
+    a.onSample(AVOID_FRONT_DEG, 800, 1000);
+    ok = ok && a.evaluate(sectors, 1000).action == Action::FORWARD;
+    a.onSample(AVOID_FRONT_DEG, 300, 1100);
+    ok = ok && a.evaluate(sectors, 1100).action == Action::SLOW && a.decision().front_mm == 300;
+    a.onSample(AVOID_FRONT_DEG, 100, 1200);
+    ok = ok && a.evaluate(sectors, 1200).action == Action::BACKUP;
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("wrong action for the front distance");
+    }
+}
+
+void test_turn_towards_clearance() {
+    TEST("Warning distance turns towards the clearest sector");
+
+    ObstacleAvoider a;
+    int sectors[SCAN_SECTOR_COUNT];
+    fill(sectors, 200);
+    sectors[7] = 1500;                                  // 140-160 deg: left
+    a.onSample(AVOID_FRONT_DEG, 200, 1000);
+    const ObstacleAvoider::Decision& d = a.evaluate(sectors, 1000);
+    bool ok = d.action == Action::TURN_LEFT && d.heading_deg == 150 && d.heading_mm == 1500;
+
+    ObstacleAvoider b;
+    fill(sectors, 200);
+    sectors[1] = 1500;                                  // 20-40 deg: right
+    b.onSample(AVOID_FRONT_DEG, 200, 1000);
+    ok = ok && b.evaluate(sectors, 1000).action == Action::TURN_RIGHT;
+
+    ObstacleAvoider c;
+    fill(sectors, 110);                                 // Boxed in
+    c.onSample(AVOID_FRONT_DEG, 200, 1000);
+    ok = ok && c.evaluate(sectors, 1000).action == Action::STOP;
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("wrong heading or action");
+    }
+}
+
+void test_front_from_map() {
+    TEST("Without a front sample the map's front cone is used");
+
+    ObstacleAvoider a;
+    int sectors[SCAN_SECTOR_COUNT];
+    fill(sectors, 1000);
+    sectors[5] = 100;                                   // 100-120 deg, inside the cone
+
+    // Off-cone samples never count as the front distance
+    a.onSample(20, 50, 1000);
+    bool ok = a.evaluate(sectors, 1000).action == Action::BACKUP && a.decision().front_mm == 100;
+
+    // A stale front sample gives way to the map
+    ObstacleAvoider b;
+    b.onSample(AVOID_FRONT_DEG, 1200, 1000);
+    fill(sectors, 300);
+    ok = ok && b.evaluate(sectors, 1000 + b.getConfig().max_age_ms + 1).front_mm == 300;
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("wrong front distance");
+    }
+}
+
+void test_hold() {
+    TEST("A turn is held for hold_ms unless things get worse");
+
+    ObstacleAvoider a;
+    int sectors[SCAN_SECTOR_COUNT];
+    fill(sectors, 200);
+    sectors[7] = 1500;
+    a.onSample(AVOID_FRONT_DEG, 200, 1000);
+    bool ok = a.evaluate(sectors, 1000).action == Action::TURN_LEFT;
+
+    uint32_t hold = a.getConfig().hold_ms;
+    a.onSample(AVOID_FRONT_DEG, 900, 1100);
+    ok = ok && a.evaluate(sectors, 1100).action == Action::TURN_LEFT;
+    a.onSample(AVOID_FRONT_DEG, 900, 1000 + hold);
+    ok = ok && a.evaluate(sectors, 1000 + hold).action == Action::FORWARD;
+
+    // Critical overrides the hold at once
+    a.onSample(AVOID_FRONT_DEG, 200, 2000);
+    ok = ok && a.evaluate(sectors, 2000).action == Action::TURN_LEFT;
+    a.onSample(AVOID_FRONT_DEG, 80, 2010);
+    ok = ok && a.evaluate(sectors, 2010).action == Action::BACKUP;
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("hold not applied or not overridden");
+    }
+}
+
+void test_steer() {
+    TEST("Only forward walks are steered");
+
+    ObstacleAvoider a;
+    int sectors[SCAN_SECTOR_COUNT];
+    fill(sectors, 200);
+    sectors[7] = 1500;
+    a.onSample(AVOID_FRONT_DEG, 200, 1000);
+    a.evaluate(sectors, 1000);
+
+    const ObstacleAvoider::Config& c = a.getConfig();
+    GaitEngine::Params p = a.steer(forward());
+    bool ok = p.dir == 0.0f && p.turn == -c.turn_rate;
+
+    GaitEngine::Params back = forward();
+    back.dir = -1.0f;
+    p = a.steer(back);
+    ok = ok && p.dir == -1.0f && p.turn == 0.0f && p.speed == 1.0f;
+
+    a.onSample(AVOID_FRONT_DEG, 100, 2000);
+    a.evaluate(sectors, 2000);
+    p = a.steer(forward());
+    ok = ok && p.dir == c.backup_dir && p.speed == c.slow_speed;
+
+    a.reset();
+    p = a.steer(forward());
+    ok = ok && a.decision().action == Action::FORWARD && p.dir == 1.0f && p.speed == 1.0f;
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("wrong steering");
+    }
+}
+
+int main() {
+    printf("=== Obstacle Avoider Tests ===\n");
+
+    test_thresholds();
+    test_turn_towards_clearance();
+    test_front_from_map();
+    test_hold();
+    test_steer();
+
+    printf("\nResults: %d passed, %d failed\n", tests_passed, tests_failed);
+    return tests_failed > 0 ? 1 : 0;
+}
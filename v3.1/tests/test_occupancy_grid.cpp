@@ -0,0 +1,201 @@
+/**
+ * Occupancy Grid Unit Tests
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+
+#include "occupancy_grid.h"
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST(name) printf("  %s: ", name)
+#define PASS() do { printf("PASS\n"); tests_passed++; } while(0)
+#define FAIL(msg) do { printf("FAIL - %s\n", msg); tests_failed++; } while(0)
+
+#define MAX_MM 2000
+
+static OccupancyGrid::Pose at(float x, float y, float heading = 0.0f) {
+    OccupancyGrid::Pose p;
+    p.x_mm = x;
+    p.y_mm = y;
+    p.heading_rad = heading;
+    return p;
+}
+
+void test_hit_and_free() {
+    TEST("A reading marks its end cell occupied, the ray free");
+
+    static OccupancyGrid grid;
+    grid.clear();
+    for (int i = 0; i < 3; i++) {
+        grid.update(at(25, 25), 90, 500, MAX_MM);
+    }
+
+    bool ok = grid.at(525, 25) > OCC_OCCUPIED && grid.at(275, 25) < 0 &&
+              grid.at(25, 275) == 0 && grid.at(800, 25) == 0;
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("wrong cells");
+    }
+}
+
+void test_heading_and_angle() {
+    TEST("Scan angles turn left of the heading, the heading is counter-clockwise");
+
+    static OccupancyGrid grid;
+    grid.clear();
+    // Facing +y, sensor 90 degrees to the right: the hit is on +x
+    grid.update(at(25, 25, 1.5707963f), 0, 400, MAX_MM);
+    grid.update(at(25, 25), 180, 300, MAX_MM);
+
+    if (grid.at(425, 25) > 0 && grid.at(25, 325) > 0) {
+        PASS();
+    } else {
+        FAIL("ray in the wrong direction");
+    }
+}
+
+void test_out_of_range() {
+    TEST("Out of range frees the ray without a hit; errors add nothing");
+
+    static OccupancyGrid grid;
+    grid.clear();
+    grid.update(at(25, 25), 90, MAX_MM, MAX_MM);
+    grid.update(at(25, 25), 0, -1, MAX_MM);
+
+    bool ok = grid.at(1000, 25) < 0 && grid.at(MAX_MM + 25, 25) <= 0 && grid.at(25, -500) == 0;
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("hit recorded past range");
+    }
+}
+
+void test_evidence_accumulates() {
+    TEST("Log-odds saturate and an obstacle survives a single miss");
+
+    static OccupancyGrid grid;
+    grid.clear();
+    for (int i = 0; i < 20; i++) {
+        grid.update(at(25, 25), 90, 500, MAX_MM);
+    }
+    bool saturated = grid.at(525, 25) == OCC_LOGODDS_MAX;
+    grid.update(at(25, 25), 90, 800, MAX_MM);
+
+    if (saturated && grid.at(525, 25) > OCC_OCCUPIED) {
+        PASS();
+    } else {
+        FAIL("evidence lost");
+    }
+}
+
+void test_recenter_keeps_world() {
+    TEST("Recentering keeps cells in place and clears tiles that left");
+
+    static OccupancyGrid grid;
+    grid.clear();
+    grid.update(at(25, 25), 90, 500, MAX_MM);       // Obstacle near the start
+    grid.update(at(25, 25), 270, 1500, MAX_MM);      // Behind the start
+    int ox = grid.originTileX();
+
+    // Two tiles ahead: the window moves, the obstacle ahead stays put
+    float x = 2.5f * OCC_TILE_CELLS * OCC_CELL_MM;
+    grid.update(at(x, 25), 90, 300, MAX_MM);
+    bool moved = grid.originTileX() > ox;
+    bool kept = grid.at(525, 25) > 0 && grid.at(x + 325, 25) > 0;
+
+    // Far enough that the start leaves the window
+    float far = 9.0f * OCC_TILE_CELLS * OCC_CELL_MM;
+    grid.update(at(far, 25), 90, 300, MAX_MM);
+    bool dropped = grid.at(25 - 1525, 25) == 0 && grid.at(525, 25) == 0 && grid.at(far + 325, 25) > 0;
+
+    if (moved && kept && dropped) {
+        PASS();
+    } else {
+        printf("(moved %d kept %d dropped %d) ", moved, kept, dropped);
+        FAIL("window did not roll");
+    }
+}
+
+void test_clearance() {
+    TEST("Clearance stops at the first occupied cell, -1 without evidence");
+
+    static OccupancyGrid grid;
+    grid.clear();
+    for (int i = 0; i < 3; i++) {
+        grid.update(at(25, 25), 90, 600, MAX_MM);
+        grid.update(at(25, 25), 150, MAX_MM, MAX_MM);
+    }
+    int ahead = grid.clearance(at(25, 25), 90, MAX_MM);
+    int left = grid.clearance(at(25, 25), 150, MAX_MM);
+    int unknown = grid.clearance(at(25, 25), 20, MAX_MM);
+
+    int sectors[SCAN_SECTOR_COUNT];
+    grid.sectorClearance(at(25, 25), MAX_MM, sectors);
+
+    bool ok = ahead >= 550 && ahead <= 600 && left == MAX_MM && unknown == -1 &&
+              sectors[90 / SCAN_SECTOR_DEG] == ahead && sectors[0] == -1;
+    if (ok) {
+        PASS();
+    } else {
+        printf("(ahead %d left %d unknown %d) ", ahead, left, unknown);
+        FAIL("wrong clearance");
+    }
+}
+
+void test_snapshot() {
+    TEST("Snapshot carries only tiles with evidence, in mask order");
+
+    static OccupancyGrid grid;
+    static uint8_t buf[OCC_SNAPSHOT_MAX];
+    grid.clear();
+    uint8_t tiles = 0;
+    size_t empty = grid.snapshot(at(0, 0), buf, tiles);
+    bool ok = empty == sizeof(WsStreamMap) && tiles == 0;
+
+    grid.update(at(25, 25, 0.5f), 90, 300, MAX_MM);
+    size_t len = grid.snapshot(at(25, 25, 0.5f), buf, tiles);
+    WsStreamMap hdr;
+    memcpy(&hdr, buf, sizeof(hdr));
+    ok = ok && tiles == grid.tilesUsed() && tiles >= 1 &&
+         len == sizeof(hdr) + tiles * OCC_TILE_CELLS * OCC_TILE_CELLS &&
+         (uint32_t)__builtin_popcountll(hdr.tile_mask) == tiles &&
+         hdr.cell_mm == OCC_CELL_MM && hdr.tiles == OCC_TILES && hdr.robot_x_mm == 25 &&
+         hdr.heading_cdeg == 2865 && hdr.origin_tx == grid.originTileX();
+
+    // The hit cell, found through the mask like a client would
+    int cx = (25 + 300 * 0.8775826f) / OCC_CELL_MM;
+    int cy = (25 + 300 * 0.4794255f) / OCC_CELL_MM;
+    int tx = cx / OCC_TILE_CELLS - hdr.origin_tx;
+    int ty = cy / OCC_TILE_CELLS - hdr.origin_ty;
+    int bit = tx + ty * OCC_TILES;
+    int index = __builtin_popcountll(hdr.tile_mask & ((1ULL << bit) - 1));
+    const int8_t* tile = (const int8_t*)(buf + sizeof(hdr) + index * OCC_TILE_CELLS * OCC_TILE_CELLS);
+    ok = ok && (hdr.tile_mask & (1ULL << bit)) &&
+         tile[(cx % OCC_TILE_CELLS) + (cy % OCC_TILE_CELLS) * OCC_TILE_CELLS] == OCC_LOGODDS_HIT;
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("snapshot malformed");
+    }
+}
+
+int main() {
+    printf("=== Occupancy Grid Tests ===\n");
+
+    test_hit_and_free();
+    test_heading_and_angle();
+    test_out_of_range();
+    test_evidence_accumulates();
+    test_recenter_keeps_world();
+    test_clearance();
+    test_snapshot();
+
+    printf("\nResults: %d passed, %d failed\n", tests_passed, tests_failed);
+    return tests_failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,128 @@
+/**
+ * Packet Backlog (ring flow control) Unit Tests
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+
+#include "packet_backlog.h"
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST(name) printf("  %s: ", name)
+#define PASS() do { printf("PASS\n"); tests_passed++; } while(0)
+#define FAIL(msg) do { printf("FAIL - %s\n", msg); tests_failed++; } while(0)
+
+using Backlog = PacketBacklog<4>;
+
+static PosePacket31 packet(uint32_t seq, uint16_t flags = FLAG_CLAMP_ENABLE) {
+    PosePacket31 pkt;
+    memset(&pkt, 0, sizeof(pkt));
+    pkt.seq = seq;
+    pkt.flags = flags;
+    return pkt;
+}
+
+void test_queue_keeps_order() {
+    TEST("QUEUE keeps seq order and drops the newest when full");
+
+    Backlog b;
+    bool ok = true;
+    for (uint32_t s = 1; s <= 4; s++) {
+        ok = ok && b.push(packet(s), 0, s, FlowPolicy::QUEUE) == Backlog::Result::QUEUED;
+    }
+    ok = ok && b.push(packet(5), 0, 5, FlowPolicy::QUEUE) == Backlog::Result::DROPPED;
+
+    b.pop(2);
+    ok = ok && b.size() == 2 && b.packets()[0].seq == 3 && b.rxUs()[1] == 4 && b.highWater() == 4;
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("wrong order or overflow handling");
+    }
+}
+
+void test_coalesce_immediate_only() {
+    TEST("COALESCE folds back-to-back immediate poses, never scheduled ones");
+
+    Backlog b;
+    bool ok = b.push(packet(1), 0, 0, FlowPolicy::COALESCE) == Backlog::Result::QUEUED;
+    ok = ok && b.push(packet(2), 0, 0, FlowPolicy::COALESCE) == Backlog::Result::COALESCED;
+    ok = ok && b.size() == 1 && b.packets()[0].seq == 2;
+
+    // A scheduled keyframe ends the run; so does a hold
+    ok = ok && b.push(packet(3), 123456, 0, FlowPolicy::COALESCE) == Backlog::Result::QUEUED;
+    ok = ok && b.push(packet(4), 0, 0, FlowPolicy::COALESCE) == Backlog::Result::QUEUED;
+    ok = ok && b.push(packet(5, FLAG_HOLD), 0, 0, FlowPolicy::COALESCE) == Backlog::Result::QUEUED;
+    ok = ok && b.size() == 4 && b.packets()[1].seq == 3 && b.execAt()[1] == 123456;
+
+    // A scan-only pose must not replace one that moves the legs
+    Backlog g;
+    uint16_t scan = posepacket31_set_groups(FLAG_CLAMP_ENABLE, 1u << SERVO_GROUP_SCAN);
+    ok = ok && g.push(packet(1, scan), 0, 0, FlowPolicy::COALESCE) == Backlog::Result::QUEUED;
+    ok = ok && g.push(packet(2), 0, 0, FlowPolicy::COALESCE) == Backlog::Result::COALESCED;
+    ok = ok && g.push(packet(3, scan), 0, 0, FlowPolicy::COALESCE) == Backlog::Result::QUEUED;
+    ok = ok && g.size() == 2 && g.packets()[0].seq == 2;
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("wrong coalescing");
+    }
+}
+
+void test_estop_never_dropped() {
+    TEST("E-STOP evicts the oldest when full and survives the purge");
+
+    Backlog b;
+    for (uint32_t s = 1; s <= 4; s++) {
+        b.push(packet(s), 0, 0, FlowPolicy::QUEUE);
+    }
+    bool ok = b.push(packet(5, FLAG_ESTOP), 0, 0, FlowPolicy::DROP) == Backlog::Result::EVICTED;
+    ok = ok && b.packets()[0].seq == 2 && b.size() == 4;
+    ok = ok && b.push(packet(6), 0, 0, FlowPolicy::DROP) == Backlog::Result::DROPPED;
+
+    ok = ok && b.retainEstop() == 3 && b.size() == 1 && b.packets()[0].seq == 5;
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("E-STOP packet lost");
+    }
+}
+
+void test_policy_names() {
+    TEST("Policy names round-trip");
+
+    const FlowPolicy all[] = {
+        FlowPolicy::DROP, FlowPolicy::QUEUE, FlowPolicy::COALESCE, FlowPolicy::BLOCK, FlowPolicy::OVERWRITE
+    };
+    bool ok = true;
+    for (FlowPolicy p : all) {
+        FlowPolicy parsed = FlowPolicy::DROP;
+        ok = ok && parseFlowPolicy(flowPolicyName(p), parsed) && parsed == p;
+    }
+    FlowPolicy keep = FlowPolicy::BLOCK;
+    ok = ok && !parseFlowPolicy("fast", keep) && keep == FlowPolicy::BLOCK;
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("name does not parse back");
+    }
+}
+
+int main() {
+    printf("=== Packet Backlog Tests ===\n");
+
+    test_queue_keeps_order();
+    test_coalesce_immediate_only();
+    test_estop_never_dropped();
+    test_policy_names();
+
+    printf("\nResults: %d passed, %d failed\n", tests_passed, tests_failed);
+    return tests_failed > 0 ? 1 : 0;
+}
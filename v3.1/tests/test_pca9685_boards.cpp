@@ -0,0 +1,132 @@
+/**
+ * PCA9685 Multi-Board Driver Tests
+ *
+ * The real driver built for two boards (PCA9685_BOARD_COUNT=2) against
+ * the simulated I2C bus (sim/i2c_sim.c), which models both chips.
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+
+extern "C" {
+#include "pca9685.h"
+#include "i2c_sim.h"
+#include "timebase.h"
+#include "limits.h"
+}
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST(name) printf("  %s: ", name)
+#define PASS() do { printf("PASS\n"); tests_passed++; } while(0)
+#define FAIL(msg) do { printf("FAIL - %s\n", msg); tests_failed++; } while(0)
+
+// Register round trip loses at most a tick (~4.9 us)
+static bool outputs_match(const uint16_t* us, int count) {
+    for (int ch = 0; ch < count; ch++) {
+        if (abs((int)i2c_sim_channel_us((uint8_t)ch) - us[ch]) > 5) return false;
+    }
+    return true;
+}
+
+// Transfers and bytes sent by fn, once the bus is idle again
+template <typename Fn>
+static I2cSimStats traffic(Fn fn) {
+    I2cSimStats before, after;
+    i2c_sim_get_stats(&before);
+    fn();
+    timebase_delay_ms(5);
+    i2c_sim_get_stats(&after);
+    after.transfers -= before.transfers;
+    after.bytes -= before.bytes;
+    after.nacks -= before.nacks;
+    return after;
+}
+
+void test_init() {
+    TEST("Both boards answer and are initialised");
+
+    if (PCA9685_OUTPUT_COUNT == 32 && pca9685_init(PCA9685_I2C_ADDR_DEFAULT) == 0) {
+        PASS();
+    } else {
+        FAIL("init failed");
+    }
+}
+
+void test_set_all_allcall() {
+    TEST("Neutral reaches every board in one ALLCALL write");
+
+    I2cSimStats s = traffic([] { pca9685_set_all_us(SERVO_PWM_NEUTRAL_US); });
+    uint16_t neutral[PCA9685_OUTPUT_COUNT];
+    for (int i = 0; i < PCA9685_OUTPUT_COUNT; i++) neutral[i] = SERVO_PWM_NEUTRAL_US;
+
+    if (s.transfers == 1 && s.nacks == 0 && outputs_match(neutral, PCA9685_OUTPUT_COUNT)) {
+        PASS();
+    } else {
+        printf("(%u transfers) ", s.transfers);
+        FAIL("not every channel neutral");
+    }
+}
+
+void test_update_per_board() {
+    TEST("An update sends one burst per board it changes");
+
+    uint16_t pose[PCA9685_OUTPUT_COUNT];
+    for (int i = 0; i < PCA9685_OUTPUT_COUNT; i++) pose[i] = SERVO_PWM_NEUTRAL_US;
+    pose[2] = 1200;
+    pose[5] = 1300;
+    pose[17] = 1700;
+    pose[30] = 1800;
+
+    I2cSimStats both = traffic([&] { pca9685_update_us(pose, PCA9685_OUTPUT_COUNT); });
+    bool ok = both.transfers == 2 && both.bytes == (1 + 4 * 4) + (1 + 4 * 14) &&
+              outputs_match(pose, PCA9685_OUTPUT_COUNT);
+
+    I2cSimStats none = traffic([&] { pca9685_update_us(pose, PCA9685_OUTPUT_COUNT); });
+    pose[20] = 1000;
+    I2cSimStats second = traffic([&] { pca9685_update_us(pose, PCA9685_OUTPUT_COUNT); });
+    ok = ok && none.transfers == 0 && second.transfers == 1 && second.bytes == 1 + 4 &&
+         outputs_match(pose, PCA9685_OUTPUT_COUNT);
+
+    if (ok) {
+        PASS();
+    } else {
+        printf("(%u/%u/%u transfers) ", both.transfers, none.transfers, second.transfers);
+        FAIL("wrong bursts");
+    }
+}
+
+void test_multi_spans_boards() {
+    TEST("A run across the board boundary is split per board");
+
+    uint16_t us[4] = {1100, 1200, 1300, 1400};
+    int ret = -1;
+    I2cSimStats s = traffic([&] { ret = pca9685_set_pwm_us_multi(14, 4, us); });
+    bool ok = ret == 0 && s.transfers == 2 && s.nacks == 0;
+    for (int i = 0; ok && i < 4; i++) {
+        ok = abs((int)i2c_sim_channel_us((uint8_t)(14 + i)) - us[i]) <= 5;
+    }
+    ok = ok && pca9685_set_pwm_us_multi(30, 3, us) == -1 &&
+         pca9685_set_pwm_us(PCA9685_OUTPUT_COUNT, 1500) == -1 &&
+         pca9685_update_us(us, PCA9685_OUTPUT_COUNT + 1) == -1;
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("boundary not handled");
+    }
+}
+
+int main() {
+    printf("=== PCA9685 Multi-Board Tests ===\n");
+
+    test_init();
+    test_set_all_allcall();
+    test_update_per_board();
+    test_multi_spans_boards();
+
+    printf("\nResults: %d passed, %d failed\n", tests_passed, tests_failed);
+    return tests_failed > 0 ? 1 : 0;
+}
@@ -6,6 +6,8 @@
 #include <cstdint>
 #include <cstring>
 #include "../common/protocol_posepacket31.h"
+#include "../common/protocol_posedelta.h"
+#include "../common/protocol_posepacketn.h"
 #include "../common/crc16_ccitt_false.h"
 #include "../common/limits.h"
 #include "../common/versioning.h"
@@ -120,6 +122,137 @@ void test_byte_layout() {
     }
 }
 
+void test_delta_layout() {
+    TEST("Delta packs set channels in order, CRC right behind");
+
+    uint16_t servo_us[SERVO_COUNT_TOTAL];
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) servo_us[i] = (uint16_t)(1000 + i);
+    uint16_t mask = (uint16_t)((1u << 2) | (1u << 7) | (1u << 12));
+
+    PosePacketDelta d;
+    memset(&d, 0xA5, sizeof(d));
+    posedelta_init(&d, 9, 100, FLAG_CLAMP_ENABLE, mask, servo_us);
+    uint16_t crc = crc16_ccitt_false((const uint8_t *)&d, posedelta_crc_len(mask));
+    posedelta_set_crc(&d, crc);
+
+    const uint8_t *bytes = (const uint8_t *)&d;
+    bool ok = d.magic == SPIDER_DELTA_MAGIC && d.seq == 9 && d.mask == mask;
+    ok = ok && posedelta_crc_len(mask) == 22;
+    ok = ok && d.data[0] == 1002 && d.data[1] == 1007 && d.data[2] == 1012;
+    ok = ok && bytes[22] == (crc & 0xFF) && bytes[23] == (crc >> 8);
+    ok = ok && posedelta_crc(&d) == crc;
+    for (size_t i = 24; i < sizeof(d); i++) {
+        ok = ok && bytes[i] == 0;
+    }
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("Delta layout incorrect");
+    }
+}
+
+void test_delta_merge() {
+    TEST("Delta merge leaves other channels alone");
+
+    uint16_t servo_us[SERVO_COUNT_TOTAL];
+    uint16_t target[SERVO_COUNT_TOTAL];
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) {
+        servo_us[i] = 2000;
+        target[i] = SERVO_PWM_NEUTRAL_US;
+    }
+
+    PosePacketDelta d;
+    posedelta_init(&d, 1, 0, FLAG_CLAMP_ENABLE, (uint16_t)(1u << 5), servo_us);
+    posedelta_merge(&d, target);
+
+    bool ok = true;
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) {
+        ok = ok && target[i] == (i == 5 ? 2000 : SERVO_PWM_NEUTRAL_US);
+    }
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("Wrong channels merged");
+    }
+}
+
+void test_delta_mask_limits() {
+    TEST("Delta masks beyond the channels or the slot are invalid");
+
+    bool ok = posedelta_mask_valid(0) && posedelta_mask_valid((uint16_t)(1u << SERVO_CHANNEL_SCAN));
+    ok = ok && posedelta_mask_valid((uint16_t)(POSEDELTA_MASK_ALL & ~1u));
+    ok = ok && !posedelta_mask_valid(POSEDELTA_MASK_ALL);
+    ok = ok && !posedelta_mask_valid((uint16_t)(1u << SERVO_COUNT_TOTAL));
+    ok = ok && posedelta_crc_len((uint16_t)(POSEDELTA_MASK_ALL & ~1u)) + 2 == sizeof(PosePacket31);
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("Mask limits wrong");
+    }
+}
+
+void test_wide_layout() {
+    TEST("PosePacketN carries count channels, CRC right behind");
+
+    uint16_t servo_us[POSEPACKETN_MAX_CHANNELS];
+    for (int i = 0; i < POSEPACKETN_MAX_CHANNELS; i++) servo_us[i] = (uint16_t)(1000 + i);
+
+    PosePacketN p;
+    memset(&p, 0xA5, sizeof(p));
+    posepacketn_init(&p, 11, 40, FLAG_CLAMP_ENABLE, 21, servo_us);
+    uint16_t crc = crc16_ccitt_false((const uint8_t *)&p, posepacketn_crc_len(&p));
+    posepacketn_set_crc(&p, crc);
+
+    const uint8_t *bytes = (const uint8_t *)&p;
+    bool ok = p.magic == SPIDER_WIDE_MAGIC && p.seq == 11 && p.t_ms == 40;
+    ok = ok && bytes[14] == 21 && bytes[15] == 0;
+    ok = ok && posepacketn_crc_len(&p) == 58 && posepacketn_size(21) == 60;
+    ok = ok && p.data[0] == 1000 && p.data[20] == 1020;
+    ok = ok && bytes[58] == (crc & 0xFF) && bytes[59] == (crc >> 8);
+    for (size_t i = 60; i < sizeof(p); i++) {
+        ok = ok && bytes[i] == 0;
+    }
+    ok = ok && posepacketn_size(POSEPACKETN_MAX_CHANNELS) == sizeof(p);
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("PosePacketN layout incorrect");
+    }
+}
+
+void test_wide_merge() {
+    TEST("PosePacketN merge sets its channels, count checked");
+
+    uint16_t servo_us[POSEPACKETN_MAX_CHANNELS];
+    uint16_t target[POSEPACKETN_MAX_CHANNELS];
+    for (int i = 0; i < POSEPACKETN_MAX_CHANNELS; i++) {
+        servo_us[i] = 2000;
+        target[i] = SERVO_PWM_NEUTRAL_US;
+    }
+
+    PosePacketN p;
+    posepacketn_init(&p, 1, 0, FLAG_CLAMP_ENABLE, 18, servo_us);
+    posepacketn_merge(&p, target);
+
+    bool ok = true;
+    for (int i = 0; i < POSEPACKETN_MAX_CHANNELS; i++) {
+        ok = ok && target[i] == (i < 18 ? 2000 : SERVO_PWM_NEUTRAL_US);
+    }
+    ok = ok && !posepacketn_count_valid(0) && posepacketn_count_valid(1) &&
+         posepacketn_count_valid(POSEPACKETN_MAX_CHANNELS) &&
+         !posepacketn_count_valid(POSEPACKETN_MAX_CHANNELS + 1);
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("Wrong channels merged");
+    }
+}
+
 int main() {
     printf("=== PosePacket31 Tests ===\n");
 
@@ -129,6 +262,11 @@ int main() {
     test_flags_bitfield();
     test_servo_channel_count();
     test_byte_layout();
+    test_delta_layout();
+    test_delta_merge();
+    test_delta_mask_limits();
+    test_wide_layout();
+    test_wide_merge();
 
     printf("\nResults: %d passed, %d failed\n", tests_passed, tests_failed);
     return tests_failed > 0 ? 1 : 0;
@@ -0,0 +1,127 @@
+/**
+ * CPU Accounting and Sampling Profiler Unit Tests
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+#include "profiler.h"
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST(name) printf("  %s: ", name)
+#define PASS() do { printf("PASS\n"); tests_passed++; } while(0)
+#define FAIL(msg) do { printf("FAIL - %s\n", msg); tests_failed++; } while(0)
+
+// Exported (ENABLE_EXPORTS), so dladdr can name it in the folded stacks
+__attribute__((noinline)) uint64_t profiler_test_burn(uint64_t until_us) {
+    volatile uint64_t x = 0;
+    while (timebase_micros() < until_us) {
+        for (int i = 0; i < 1000; i++) x = x + (uint64_t)i * 2654435761u;
+    }
+    return x;
+}
+
+void test_cpu_scope() {
+    TEST("CpuScope counts calls, time and this thread's allocations");
+
+    CpuCost cost;
+    {
+        CpuScope scope(cost);
+        delete new int(1);
+        delete[] new char[16];
+        usleep(2000);
+    }
+    {
+        CpuScope scope(cost);
+        // Another thread's allocations are not ours
+        std::thread t([] { for (int i = 0; i < 10; i++) delete new int(i); });
+        t.join();
+    }
+    bool ok = cost.calls == 2 && cost.total_us >= 2000 && cost.max_us >= 2000 &&
+              cost.max_us <= cost.total_us && cost.allocs >= 2 && cost.allocs < 10;
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("counters wrong");
+    }
+}
+
+void test_start_refused() {
+    TEST("Bad rates and a second profiler are refused");
+
+    SamplingProfiler a, b;
+    bool ok = !a.start(0) && !a.start(PROFILE_MAX_HZ + 1) && !a.running();
+    ok = ok && a.start(100) && a.running() && !a.start(100) && !b.start(100);
+    a.stop();
+    ok = ok && !a.running() && b.start(100);
+    b.stop();
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("start accepted");
+    }
+}
+
+void test_folded_output() {
+    TEST("Samples of a busy loop fold into stacks through it");
+
+    SamplingProfiler p;
+    bool ok = p.start(PROFILE_MAX_HZ);
+    profiler_test_burn(timebase_micros() + 300000);
+    size_t samples = p.stop();
+    ok = ok && samples > 20 && p.dropped() == 0;
+
+    char path[] = "/tmp/test_profiler_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd >= 0) close(fd);
+    size_t stacks = 0;
+    ok = ok && fd >= 0 && p.writeFolded(path, &stacks) && stacks > 0 && stacks <= samples;
+
+    // "thread;outer;...;inner count", counts adding up to the samples
+    size_t lines = 0, total = 0, burning = 0;
+    char line[8192];
+    FILE* f = fopen(path, "r");
+    while (f && fgets(line, sizeof(line), f)) {
+        char* count = strrchr(line, ' ');
+        if (!count || !strchr(line, ';')) {
+            ok = false;
+            break;
+        }
+        size_t n = strtoul(count + 1, nullptr, 10);
+        lines++;
+        total += n;
+        if (strstr(line, ";profiler_test_burn")) burning += n;
+    }
+    if (f) fclose(f);
+    unlink(path);
+    ok = ok && lines == stacks && total == samples && burning * 2 > samples;
+
+    p.reset();
+    ok = ok && p.samples() == 0;
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("folded stacks wrong");
+    }
+}
+
+int main() {
+    printf("=== Profiler Tests ===\n");
+
+    test_cpu_scope();
+    test_start_refused();
+    test_folded_output();
+
+    printf("\nResults: %d passed, %d failed\n", tests_passed, tests_failed);
+    return tests_failed > 0 ? 1 : 0;
+}
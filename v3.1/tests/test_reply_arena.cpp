@@ -0,0 +1,135 @@
+/**
+ * Reply Arena Unit Tests
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+
+#include "reply_arena.h"
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST(name) printf("  %s: ", name)
+#define PASS() do { printf("PASS\n"); tests_passed++; } while(0)
+#define FAIL(msg) do { printf("FAIL - %s\n", msg); tests_failed++; } while(0)
+
+static ReplyArena s_arena;
+
+static bool is(const JsonWriter& w, const char* expect) {
+    return w.size() == strlen(expect) && memcmp(w.data(), expect, w.size()) == 0;
+}
+
+void test_structure() {
+    TEST("Objects, arrays and commas come out as JSON");
+
+    s_arena.reset();
+    JsonWriter w(s_arena);
+    w.beginObject()
+     .field("type", "motions")
+     .field("n", -12)
+     .field("big", (uint64_t)18446744073709551615ULL)
+     .field("min", (int64_t)INT64_MIN)
+     .field("ok", true)
+     .field("x", 0.125, 2)
+     .beginArray("list").value(1u).value("a").beginObject().endObject().beginArray().endArray().endArray()
+     .endObject();
+
+    if (w.ok() && is(w, "{\"type\":\"motions\",\"n\":-12,\"big\":18446744073709551615,"
+                        "\"min\":-9223372036854775808,\"ok\":true,\"x\":0.12,\"list\":[1,\"a\",{},[]]}")) {
+        PASS();
+    } else {
+        printf("(%.*s) ", (int)w.size(), w.data());
+        FAIL("wrong text");
+    }
+}
+
+void test_escaping() {
+    TEST("Quotes, backslashes and control characters are escaped");
+
+    s_arena.reset();
+    JsonWriter w(s_arena);
+    w.beginObject().field("s", "a\"b\\c\nd\x01").endObject();
+
+    if (w.ok() && is(w, "{\"s\":\"a\\\"b\\\\c\\u000ad\\u0001\"}")) {
+        PASS();
+    } else {
+        printf("(%.*s) ", (int)w.size(), w.data());
+        FAIL("wrong escape");
+    }
+}
+
+void test_frame() {
+    TEST("frame() puts the header right in front of the payload");
+
+    static char pad[65536];
+    const size_t sizes[] = { 125, 126, 65000 };
+    bool ok = true;
+    for (size_t len : sizes) {
+        // A string value: the payload is the padding plus its two quotes
+        memset(pad, 'x', len - 2);
+        pad[len - 2] = '\0';
+        s_arena.reset();
+        JsonWriter w(s_arena);
+        w.value(pad);
+        size_t frame_len;
+        const uint8_t* f = w.frame(frame_len);
+        WsFrameHeader hdr;
+        ok = ok && w.ok() && ws_frame_parse(f, frame_len, hdr) && hdr.fin && hdr.opcode == 0x01 &&
+             !hdr.masked && hdr.payload_len == len && hdr.header_len == (len < 126 ? 2u : 4u) &&
+             f + hdr.header_len == (const uint8_t*)w.data();
+    }
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("bad frame");
+    }
+}
+
+void test_overflow_and_reset() {
+    TEST("Full arena and a second open writer fail; reset() frees the space");
+
+    s_arena.reset();
+    bool ok;
+    {
+        JsonWriter w(s_arena);
+        JsonWriter nested(s_arena);
+        nested.value(1);
+        ok = !nested.ok() && nested.size() == 0;
+        w.beginArray();
+        while (w.ok()) w.value(123456789);
+        ok = ok && s_arena.overflows() == 2;
+    }
+    ok = ok && s_arena.used() > REPLY_ARENA_BYTES - 16;
+    {
+        JsonWriter w(s_arena);
+        w.value(1);
+        ok = ok && !w.ok();
+    }
+    s_arena.reset();
+    {
+        JsonWriter w(s_arena);
+        w.value(1);
+        ok = ok && w.ok() && is(w, "1") && s_arena.highWater() > REPLY_ARENA_BYTES - 16;
+    }
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("arena accounting wrong");
+    }
+}
+
+int main() {
+    printf("=== Reply Arena Tests ===\n");
+
+    test_structure();
+    test_escaping();
+    test_frame();
+    test_overflow_and_reset();
+
+    printf("\nResults: %d passed, %d failed\n", tests_passed, tests_failed);
+    return tests_failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,115 @@
+/**
+ * Robot Topology Unit Tests
+ */
+
+#include <cstdio>
+#include <cstdint>
+
+#include "robot_model.h"
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST(name) printf("  %s: ", name)
+#define PASS() do { printf("PASS\n"); tests_passed++; } while(0)
+#define FAIL(msg) do { printf("FAIL - %s\n", msg); tests_failed++; } while(0)
+
+using Hexapod = RobotModel<6, 4>;
+
+// Checked at compile time: the point of the model
+static_assert(SpiderModel::channel(2, SpiderModel::TIBIA) == 10, "Tibia on aux channel 8+i");
+static_assert(SpiderModel::legMask(1) == ((1u << 2) | (1u << 3) | (1u << 9)), "Leg 1 channels");
+static_assert(SpiderModel::SLOT_SIZE == 64, "Spider fits a 64-byte slot");
+static_assert(Hexapod::CHANNEL_COUNT == 25 && Hexapod::WIDE_PACKETS, "Hexapod needs PosePacketN");
+static_assert(Hexapod::SLOT_SIZE == 128, "Hexapod needs a 128-byte slot");
+static_assert(Hexapod::channel(5, Hexapod::TARSUS) == 12 + 6 + 5, "Tarsus after the tibias");
+
+void test_v31_names() {
+    TEST("v3.1 servo names map to their channels");
+
+    const char* names[] = {
+        "leg0_coxa", "leg0_femur", "leg1_coxa", "leg1_femur",
+        "leg2_coxa", "leg2_femur", "leg3_coxa", "leg3_femur",
+        "aux0", "aux1", "aux2", "aux3", "scan"
+    };
+    bool ok = true;
+    for (int ch = 0; ch < SERVO_COUNT_TOTAL; ch++) {
+        ok = ok && SpiderModel::channelOf(names[ch]) == ch;
+    }
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("channel mismatch");
+    }
+}
+
+void test_all_names() {
+    TEST("Every generated name round-trips, tibias alias aux");
+
+    bool ok = SpiderModel::channelOf("leg3_tibia") == SpiderModel::channelOf("aux3");
+    for (int i = 0; i < Hexapod::NAME_COUNT; i++) {
+        const auto& e = Hexapod::NAMES.entries[i];
+        ok = ok && Hexapod::channelOf(e.name) == e.channel;
+    }
+    ok = ok && Hexapod::channelOf("leg5_tarsus") == Hexapod::channel(5, Hexapod::TARSUS) &&
+         Hexapod::channelOf("scan") == Hexapod::SCAN_CHANNEL;
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("name lost");
+    }
+}
+
+void test_unknown_names() {
+    TEST("Unknown and near-miss names are rejected");
+
+    const char* bad[] = {
+        "", "leg", "leg4_coxa", "leg0_coxa ", "leg0_coxaa", "LEG0_COXA",
+        "aux4", "scan2", "leg0_tarsus", "a_name_longer_than_sixteen_bytes"
+    };
+    bool ok = true;
+    for (const char* name : bad) {
+        ok = ok && SpiderModel::channelOf(name) == -1;
+    }
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("bad name accepted");
+    }
+}
+
+void test_limits_and_geometry() {
+    TEST("Joint limits and hip layout match v3.1, middle legs sideways");
+
+    SpiderModel::Limits joint = SpiderModel::limits(0);
+    SpiderModel::Limits scan = SpiderModel::limits(SpiderModel::SCAN_CHANNEL);
+    SpiderModel::Hip rl = SpiderModel::hip(3);
+    Hexapod::Hip mid = Hexapod::hip(2);
+
+    bool ok = joint.min_us == 778 && joint.max_us == 2222 &&
+              scan.min_us == SERVO_PWM_MIN_US && scan.max_us == SERVO_PWM_MAX_US &&
+              rl.x == -SpiderModel::HIP_X_MM && rl.y == SpiderModel::HIP_Y_MM &&
+              rl.angle > 2.356f && rl.angle < 2.357f &&
+              mid.x == 0.0f && mid.y == -Hexapod::HIP_Y_MM && mid.angle < -1.570f && mid.angle > -1.571f;
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("limits or geometry differ");
+    }
+}
+
+int main() {
+    printf("=== Robot Model Tests ===\n");
+
+    test_v31_names();
+    test_all_names();
+    test_unknown_names();
+    test_limits_and_geometry();
+
+    printf("\nResults: %d passed, %d failed\n", tests_passed, tests_failed);
+    return tests_failed > 0 ? 1 : 0;
+}
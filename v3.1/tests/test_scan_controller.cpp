@@ -0,0 +1,348 @@
+/**
+ * ScanController Unit Tests
+ *
+ * Slot layout, in-place updates, the polar sector map and the sweep
+ * pipeline. Sweeps use dwell_ms = 0 and a near-instant servo, with
+ * samples stamped "now", so a few ms of ticking covers a whole profile.
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <unistd.h>
+#include "scan_controller.h"
+
+extern "C" {
+#include "timebase.h"
+}
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST(name) printf("  %s: ", name)
+#define PASS() do { printf("PASS\n"); tests_passed++; } while(0)
+#define FAIL(msg) do { printf("FAIL - %s\n", msg); tests_failed++; } while(0)
+
+static ScanController::ScanProfile fastProfile(int min_deg, int max_deg, int step_deg) {
+    ScanController::ScanProfile p;
+    p.min_deg = min_deg;
+    p.max_deg = max_deg;
+    p.step_deg = step_deg;
+    p.rate_hz = 0;
+    p.dwell_ms = 0;
+    p.servo_deg_per_s = 1000000;
+    return p;
+}
+
+// Every call produces a new sample measured "just now"
+static ScanController::SampleCallback sampler(int& readings, int (*value)(int n)) {
+    return [&readings, value](ScanController::RangeSample& out) -> bool {
+        readings++;
+        out.seq = (uint32_t)readings;
+        out.distance_mm = value(readings);
+        out.start_ms = out.end_ms = timebase_millis64();
+        return true;
+    };
+}
+
+// Tick until n readings have been taken
+static void sweep(ScanController& scan, int& readings, int n) {
+    for (int guard = 0; readings < n && guard < 10000; guard++) {
+        scan.tick();
+        usleep(200);
+    }
+}
+
+void test_slot_layout() {
+    TEST("Slots cover min..max, off-grid max gets its own");
+
+    ScanController scan;
+    scan.setProfile(fastProfile(20, 165, 10));
+    if (scan.getSlotCount() == 16 && scan.getSlot(0).angle_deg == 20 &&
+        scan.getSlot(14).angle_deg == 160 && scan.getSlot(15).angle_deg == 165 &&
+        scan.getPointCount() == 0) {
+        PASS();
+    } else {
+        FAIL("wrong layout");
+    }
+}
+
+void test_profile_sanitized() {
+    TEST("Out-of-range profile is clamped");
+
+    ScanController scan;
+    ScanController::ScanProfile p = fastProfile(-30, 400, 0);
+    p.rate_hz = -5;
+    p.servo_deg_per_s = 0;
+    scan.setProfile(p);
+    const ScanController::ScanProfile& q = scan.getProfile();
+    if (q.min_deg == 0 && q.max_deg == 180 && q.step_deg == 1 && q.rate_hz == 0 &&
+        q.servo_deg_per_s == 1 &&
+        scan.getSlotCount() == SCAN_MAX_POINTS) {
+        PASS();
+    } else {
+        FAIL("not clamped");
+    }
+}
+
+void test_sweep_updates_in_place() {
+    TEST("Repeated sweeps update slots in place");
+
+    ScanController scan;
+    scan.setProfile(fastProfile(20, 60, 10));
+
+    int readings = 0;
+    scan.setSampleCallback(sampler(readings, [](int n) { return 1000 + n; }));
+    scan.start();
+    // 20..60 and back down to 20
+    sweep(scan, readings, 9);
+    scan.stop();
+
+    bool ok = scan.getPointCount() == 5 && scan.getSlotCount() == 5;
+    // The final reading came back at 20 degrees
+    ok = ok && scan.getDistanceAtAngle(20, 0) == 1009;
+    ok = ok && scan.getDistanceAtAngle(60, 0) == 1005;
+    ok = ok && scan.getDistanceAtAngle(44, 5) == 1007;   // Nearest slot is 40
+    ok = ok && scan.getDistanceAtAngle(45, 2) == -1;
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("wrong slot contents");
+    }
+}
+
+void test_cone_queries() {
+    TEST("Cone average, sector min and median");
+
+    ScanController scan;
+    scan.setProfile(fastProfile(0, 60, 5));
+
+    // Sector 0 (0..19 deg) sees 500, 510, 2000 (spike), 520;
+    // sector 1 (20..39 deg) sees 900s; sector 2 sees errors only
+    static const int values[] = {
+        500, 510, 2000, 520,        // 0, 5, 10, 15
+        900, 910, 920, 930,         // 20, 25, 30, 35
+        -1, -1, -1, -1, -1,         // 40..60
+    };
+    int readings = 0;
+    scan.setSampleCallback(sampler(readings, [](int n) { return values[n - 1]; }));
+    scan.start();
+    sweep(scan, readings, 13);
+
+    bool ok = scan.getAverageDistanceInCone(25, 10) == (900 + 910 + 920) / 3;
+    ok = ok && scan.getConeMinDistance(10, 20) == 500;
+    ok = ok && scan.getConeMedianDistance(10, 20) == 510;       // Spike rejected
+    ok = ok && scan.getConeMedianDistance(30, 10) == 910;     // Lower median
+    ok = ok && scan.getConeMinDistance(50, 10) == -1;           // Errors only
+    ok = ok && scan.getConeMinDistance(10, 60, 60000) == 500;   // Fresh
+    ok = ok && scan.getClosestDistance() == 500 && scan.getClosestAngle() == 0;
+    scan.stop();
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("wrong cone results");
+    }
+}
+
+void test_clear() {
+    TEST("clearScanData empties slots and sectors");
+
+    ScanController scan;
+    scan.setProfile(fastProfile(0, 20, 10));
+    int readings = 0;
+    scan.setSampleCallback(sampler(readings, [](int) { return 300; }));
+    scan.start();
+    sweep(scan, readings, 3);
+    scan.stop();
+    scan.clearScanData();
+
+    if (scan.getPointCount() == 0 && scan.getClosestDistance() == -1 &&
+        scan.getConeMinDistance(10, 20) == -1 && scan.getSector(0).updated_ms == 0) {
+        PASS();
+    } else {
+        FAIL("data left behind");
+    }
+}
+
+void test_waits_for_settled_sample() {
+    TEST("Samples started before the servo settles are skipped");
+
+    ScanController scan;
+    ScanController::ScanProfile p = fastProfile(0, 20, 10);
+    p.dwell_ms = 30;
+    scan.setProfile(p);
+
+    // A sample stamped at the moment of the call: the first ones predate
+    // the settle time and must not be taken
+    int calls = 0;
+    int taken = 0;
+    uint64_t t0 = timebase_millis64();
+    scan.setSampleCallback([&](ScanController::RangeSample& out) -> bool {
+        calls++;
+        out.seq = (uint32_t)calls;
+        out.distance_mm = 400;
+        out.start_ms = out.end_ms = timebase_millis64();
+        return true;
+    });
+    scan.setDataCallback([&](const ScanController::ScanPoint&) { taken++; });
+    scan.start();
+    while (taken == 0 && timebase_millis64() - t0 < 1000) {
+        scan.tick();
+        usleep(1000);
+    }
+    uint64_t elapsed = timebase_millis64() - t0;
+    scan.stop();
+
+    if (taken == 1 && calls > 1 && elapsed >= 30 && scan.getDistanceAtAngle(0, 0) == 400) {
+        PASS();
+    } else {
+        FAIL("sample taken before settle");
+    }
+}
+
+void test_sample_timeout() {
+    TEST("No sample within the timeout records an error and moves on");
+
+    ScanController scan;
+    ScanController::ScanProfile p = fastProfile(0, 20, 10);
+    p.sample_timeout_ms = 5;
+    scan.setProfile(p);
+
+    int angles = 0;
+    scan.setSampleCallback([](ScanController::RangeSample&) -> bool { return false; });
+    scan.setServoCallback([&](int) { angles++; });
+    scan.start();
+    for (int i = 0; i < 200 && angles < 3; i++) {
+        scan.tick();
+        usleep(1000);
+    }
+    scan.stop();
+
+    if (angles >= 3 && scan.getPointCount() >= 2 && scan.getDistanceAtAngle(0, 0) == -1) {
+        PASS();
+    } else {
+        FAIL("sweep stalled");
+    }
+}
+
+static ScanController::ScanProfile adaptiveProfile() {
+    ScanController::ScanProfile p = fastProfile(20, 160, 10);
+    p.adaptive = true;
+    return p;
+}
+
+void test_adaptive_fast_stares_ahead() {
+    TEST("Fast straight walk stares ahead without moving the servo");
+
+    ScanController scan;
+    scan.setProfile(adaptiveProfile());
+    ScanController::MotionHint hint;
+    hint.dir = 1.0f;
+    hint.speed = 2.0f;
+    scan.setMotionHint(hint);
+
+    int readings = 0, moves = 0;
+    scan.setSampleCallback(sampler(readings, [](int n) { return 500 + n; }));
+    scan.setServoCallback([&](int) { moves++; });
+    scan.start();
+    sweep(scan, readings, 10);
+
+    bool ok = scan.getWindowMin() == 90 && scan.getWindowMax() == 90 && moves == 1 &&
+              scan.isHolding() && scan.getCurrentAngle() == 90 && scan.getPointCount() == 1;
+    scan.stop();
+
+    if (ok) {
+        PASS();
+    } else {
+        printf("(window %d..%d, %d moves) ", scan.getWindowMin(), scan.getWindowMax(), moves);
+        FAIL("servo kept sweeping");
+    }
+}
+
+void test_adaptive_turn_and_pace() {
+    TEST("Window narrows with pace and widens toward the turn");
+
+    ScanController scan;
+    scan.setProfile(adaptiveProfile());
+    int readings = 0;
+    scan.setSampleCallback(sampler(readings, [](int n) { return 500 + n; }));
+    scan.start();
+
+    ScanController::MotionHint hint;
+    hint.dir = 1.0f;
+    hint.speed = 1.0f;
+    scan.setMotionHint(hint);
+    sweep(scan, readings, 12);
+    int slow_lo = scan.getWindowMin(), slow_hi = scan.getWindowMax();
+    bool slow_ok = slow_lo > 20 && slow_hi < 160 && slow_lo + slow_hi == 180 &&
+                   scan.getCurrentAngle() >= slow_lo && scan.getCurrentAngle() <= slow_hi;
+
+    // Turning right (clockwise) looks toward smaller angles
+    hint.turn = 0.8f;
+    scan.setMotionHint(hint);
+    sweep(scan, readings, 24);
+    int turn_lo = scan.getWindowMin(), turn_hi = scan.getWindowMax();
+    bool turn_ok = turn_lo == 20 && turn_hi < slow_hi && turn_hi - turn_lo > slow_hi - slow_lo &&
+                   scan.getCurrentAngle() <= turn_hi;
+    scan.stop();
+
+    if (slow_ok && turn_ok) {
+        PASS();
+    } else {
+        printf("(slow %d..%d, turn %d..%d) ", slow_lo, slow_hi, turn_lo, turn_hi);
+        FAIL("wrong window");
+    }
+}
+
+void test_adaptive_parked_holds() {
+    TEST("Stationary with a fresh map holds, resumes when it goes stale");
+
+    ScanController scan;
+    ScanController::ScanProfile p = adaptiveProfile();
+    p.min_deg = 60;
+    p.max_deg = 120;
+    p.fresh_ms = 50;
+    scan.setProfile(p);
+
+    int readings = 0, moves = 0;
+    scan.setSampleCallback(sampler(readings, [](int n) { return 500 + n; }));
+    scan.setServoCallback([&](int) { moves++; });
+    scan.start();
+    sweep(scan, readings, 7);          // 60..120, then the step back to 110
+    int swept = moves;
+    sweep(scan, readings, 12);
+    bool held = scan.isHolding() && moves == swept && scan.getTravelDeg() == 30 + 60 + 10;   // To 60, up, one back
+
+    // Nothing new is learned from a parked sensor's other angles: go again
+    for (int i = 0; i < 600 && moves == swept; i++) {
+        scan.tick();
+        usleep(200);
+    }
+    bool resumed = moves > swept;
+    scan.stop();
+
+    if (held && resumed) {
+        PASS();
+    } else {
+        printf("(held %d, resumed %d, travel %u) ", held, resumed, scan.getTravelDeg());
+        FAIL("did not park");
+    }
+}
+
+int main() {
+    printf("=== ScanController Tests ===\n");
+
+    test_slot_layout();
+    test_profile_sanitized();
+    test_sweep_updates_in_place();
+    test_cone_queries();
+    test_clear();
+    test_waits_for_settled_sample();
+    test_sample_timeout();
+    test_adaptive_fast_stares_ahead();
+    test_adaptive_turn_and_pace();
+    test_adaptive_parked_holds();
+
+    printf("\nResults: %d passed, %d failed\n", tests_passed, tests_failed);
+    return tests_failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,193 @@
+/**
+ * Serial Binary Protocol Unit Tests
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+
+extern "C" {
+#include "serial_binary.h"
+#include "ws_pose_binary.h"
+}
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST(name) printf("  %s: ", name)
+#define PASS() do { printf("PASS\n"); tests_passed++; } while(0)
+#define FAIL(msg) do { printf("FAIL - %s\n", msg); tests_failed++; } while(0)
+
+static bool cobs_roundtrip(const uint8_t* in, size_t len) {
+    uint8_t enc[1100];
+    uint8_t dec[1100];
+    size_t n = cobs_encode(in, len, enc);
+    if (n > len + len / 254 + 1) return false;
+    for (size_t i = 0; i < n; i++) {
+        if (enc[i] == 0) return false;
+    }
+    int m = cobs_decode(enc, n, dec, sizeof(dec));
+    return m == (int)len && memcmp(in, dec, len) == 0;
+}
+
+void test_cobs_vectors() {
+    TEST("COBS known vectors");
+
+    const uint8_t in1[] = {0x00};
+    const uint8_t out1[] = {0x01, 0x01};
+    const uint8_t in2[] = {0x11, 0x22, 0x00, 0x33};
+    const uint8_t out2[] = {0x03, 0x11, 0x22, 0x02, 0x33};
+    const uint8_t in3[] = {0x00, 0x00};
+    const uint8_t out3[] = {0x01, 0x01, 0x01};
+
+    uint8_t enc[8];
+    bool ok = true;
+    ok = ok && cobs_encode(in1, sizeof(in1), enc) == sizeof(out1) && memcmp(enc, out1, sizeof(out1)) == 0;
+    ok = ok && cobs_encode(in2, sizeof(in2), enc) == sizeof(out2) && memcmp(enc, out2, sizeof(out2)) == 0;
+    ok = ok && cobs_encode(in3, sizeof(in3), enc) == sizeof(out3) && memcmp(enc, out3, sizeof(out3)) == 0;
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("encoding differs from reference");
+    }
+}
+
+void test_cobs_roundtrip() {
+    TEST("COBS roundtrip incl. 254-byte runs");
+
+    uint8_t buf[1000];
+    bool ok = cobs_roundtrip(buf, 0);
+
+    // Non-zero runs around the group limit, with and without zeros
+    for (size_t len = 250; len <= 520 && ok; len++) {
+        for (size_t i = 0; i < len; i++) {
+            buf[i] = (uint8_t)(i % 255 + 1);
+        }
+        ok = cobs_roundtrip(buf, len);
+        if (ok && len > 10) {
+            buf[len / 3] = 0;
+            buf[len - 1] = 0;
+            ok = cobs_roundtrip(buf, len);
+        }
+    }
+
+    memset(buf, 0, sizeof(buf));
+    ok = ok && cobs_roundtrip(buf, sizeof(buf));
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("roundtrip mismatch");
+    }
+}
+
+void test_cobs_malformed() {
+    TEST("COBS rejects malformed blocks");
+
+    const uint8_t zero_inside[] = {0x03, 0x11, 0x00};
+    const uint8_t truncated[] = {0x05, 0x11, 0x22};
+    uint8_t out[8];
+
+    bool ok = cobs_decode(zero_inside, sizeof(zero_inside), out, sizeof(out)) == -1;
+    ok = ok && cobs_decode(truncated, sizeof(truncated), out, sizeof(out)) == -1;
+
+    const uint8_t fits[] = {0x05, 0x11, 0x22, 0x33, 0x44};
+    ok = ok && cobs_decode(fits, sizeof(fits), out, 3) == -1;
+    ok = ok && cobs_decode(fits, sizeof(fits), out, 4) == 4;
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("malformed block accepted");
+    }
+}
+
+void test_pose_frame_roundtrip() {
+    TEST("Pose frame pack/unpack");
+
+    uint8_t payload[sizeof(WsPoseHeader) + 2 * sizeof(WsPoseEntry)];
+    WsPoseHeader hdr = {WS_POSE_MSG_POSE, 2, WS_POSE_REQ_ACK, 0};
+    memcpy(payload, &hdr, sizeof(hdr));
+    for (int e = 0; e < 2; e++) {
+        WsPoseEntry entry = {};
+        entry.t_ms = 20;
+        for (int i = 0; i < SERVO_COUNT_TOTAL; i++) {
+            entry.servo_us[i] = (uint16_t)(1500 + e * 100 + i);
+        }
+        memcpy(payload + sizeof(hdr) + e * sizeof(entry), &entry, sizeof(entry));
+    }
+
+    uint8_t wire[SERIAL_BIN_MAX_ENCODED];
+    size_t n = serial_bin_pack(wire, SERIAL_BIN_MSG_POSE, payload, sizeof(payload));
+
+    bool ok = n > 2 && wire[0] == 0 && wire[n - 1] == 0;
+    for (size_t i = 1; ok && i + 1 < n; i++) {
+        ok = wire[i] != 0;
+    }
+
+    uint8_t raw[SERIAL_BIN_MAX_FRAME];
+    uint8_t type = 0;
+    int len = serial_bin_unpack(wire + 1, n - 2, raw, &type);
+    ok = ok && len == (int)sizeof(payload) && type == SERIAL_BIN_MSG_POSE &&
+         memcmp(raw + 2, payload, sizeof(payload)) == 0;
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("frame did not survive roundtrip");
+    }
+}
+
+void test_frame_rejects_corruption() {
+    TEST("Frame CRC and magic checked");
+
+    const char text[] = "STATUS";
+    uint8_t wire[SERIAL_BIN_MAX_ENCODED];
+    size_t n = serial_bin_pack(wire, SERIAL_BIN_MSG_TEXT, text, strlen(text));
+
+    uint8_t raw[SERIAL_BIN_MAX_FRAME];
+    uint8_t type = 0;
+    bool ok = serial_bin_unpack(wire + 1, n - 2, raw, &type) == (int)strlen(text) &&
+              type == SERIAL_BIN_MSG_TEXT && memcmp(raw + 2, text, strlen(text)) == 0;
+
+    // Flip one payload bit (as long as it stays non-zero)
+    wire[4] ^= 0x01;
+    ok = ok && serial_bin_unpack(wire + 1, n - 2, raw, &type) == -1;
+    wire[4] ^= 0x01;
+
+    // Wrong magic with a valid CRC
+    uint8_t bad[4] = {0x5A, SERIAL_BIN_MSG_TEXT, 0, 0};
+    uint16_t crc = crc16_ccitt_false(bad, 2);
+    bad[2] = (uint8_t)(crc & 0xFF);
+    bad[3] = (uint8_t)(crc >> 8);
+    uint8_t enc[8];
+    size_t m = cobs_encode(bad, sizeof(bad), enc);
+    ok = ok && serial_bin_unpack(enc, m, raw, &type) == -1;
+
+    // Too short for magic + type + CRC
+    ok = ok && serial_bin_unpack(enc, 2, raw, &type) == -1;
+
+    uint8_t big[SERIAL_BIN_MAX_PAYLOAD + 1] = {};
+    ok = ok && serial_bin_pack(wire, SERIAL_BIN_MSG_TEXT, big, sizeof(big)) == 0;
+    ok = ok && serial_bin_pack(wire, SERIAL_BIN_MSG_TEXT, big, SERIAL_BIN_MAX_PAYLOAD) <= SERIAL_BIN_MAX_ENCODED;
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("corrupted frame accepted");
+    }
+}
+
+int main() {
+    printf("=== Serial Binary Protocol Tests ===\n");
+
+    test_cobs_vectors();
+    test_cobs_roundtrip();
+    test_cobs_malformed();
+    test_pose_frame_roundtrip();
+    test_frame_rejects_corruption();
+
+    printf("\nResults: %d passed, %d failed\n", tests_passed, tests_failed);
+    return tests_failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,166 @@
+/**
+ * Servo Calibration Unit Tests
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "servo_calibration.h"
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST(name) printf("  %s: ", name)
+#define PASS() do { printf("PASS\n"); tests_passed++; } while(0)
+#define FAIL(msg) do { printf("FAIL - %s\n", msg); tests_failed++; } while(0)
+
+// Identity table with channel 1 offset, channel 2 mirrored and scaled, channel 3 limited
+static std::vector<uint8_t> build_table() {
+    ServoCalibHeader hdr = {};
+    hdr.magic = SERVO_CALIB_MAGIC;
+    hdr.version = SERVO_CALIB_VERSION;
+    hdr.channel_count = SERVO_COUNT_TOTAL;
+    hdr.file_size = sizeof(hdr) + SERVO_COUNT_TOTAL * sizeof(ServoCalibChannel);
+
+    std::vector<uint8_t> buf(hdr.file_size);
+    memcpy(buf.data(), &hdr, sizeof(hdr));
+
+    ServoCalibChannel ch[SERVO_COUNT_TOTAL] = {};
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) {
+        ch[i].direction = 1;
+        ch[i].scale_q12 = SERVO_CALIB_SCALE_ONE;
+        ch[i].min_us = SERVO_PWM_MIN_US;
+        ch[i].max_us = SERVO_PWM_MAX_US;
+    }
+    ch[1].offset_us = 33;
+    ch[2].direction = -1;
+    ch[2].scale_q12 = SERVO_CALIB_SCALE_ONE + SERVO_CALIB_SCALE_ONE / 2;
+    ch[3].min_us = 1000;
+    ch[3].max_us = 2000;
+    memcpy(buf.data() + sizeof(hdr), ch, sizeof(ch));
+    return buf;
+}
+
+void test_identity() {
+    TEST("Default table only applies the PWM clamp");
+
+    ServoCalibration::Table table;
+    uint16_t in[SERVO_COUNT_TOTAL], out[SERVO_COUNT_TOTAL];
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) in[i] = (uint16_t)(300 + 200 * i);
+    ServoCalibration::apply(table, in, out);
+
+    bool ok = true;
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) ok = ok && out[i] == clamp_servo_us(in[i]);
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("identity table changed a value");
+    }
+}
+
+void test_apply() {
+    TEST("Offset, direction, scale and limits are applied per channel");
+
+    std::vector<uint8_t> buf = build_table();
+    ServoCalibration::Table table;
+    bool ok = ServoCalibration::parse(buf.data(), buf.size(), table);
+
+    uint16_t us[SERVO_COUNT_TOTAL];
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) us[i] = 1600;
+    us[3] = 900;
+    ServoCalibration::apply(table, us, us);     // In place
+
+    // Channel 2: 1500 - 1.5 * 100
+    ok = ok && us[0] == 1600 && us[1] == 1633 && us[2] == 1350 && us[3] == 1000 && us[12] == 1600;
+
+    uint16_t far[SERVO_COUNT_TOTAL];
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) far[i] = 200;
+    ServoCalibration::apply(table, far, far);
+    ok = ok && far[0] == SERVO_PWM_MIN_US && far[2] == SERVO_PWM_MAX_US && far[3] == 1000;
+
+    if (ok) {
+        PASS();
+    } else {
+        printf("(%u %u %u %u) ", us[0], us[1], us[2], us[3]);
+        FAIL("wrong calibrated values");
+    }
+}
+
+void test_validation() {
+    TEST("Corrupt or out-of-range tables are rejected");
+
+    std::vector<uint8_t> good = build_table();
+    ServoCalibration::Table table;
+    table.center_us[0] = 1234;          // Must survive every failed parse
+    bool ok = true;
+
+    std::vector<uint8_t> bad = good;
+    bad[0] ^= 0xFF;                                         // Magic
+    ok = ok && !ServoCalibration::parse(bad.data(), bad.size(), table);
+
+    ok = ok && !ServoCalibration::parse(good.data(), good.size() - 1, table);   // Truncated
+
+    bad = good;
+    ServoCalibChannel* ch = (ServoCalibChannel*)(bad.data() + sizeof(ServoCalibHeader));
+    ch[4].direction = 0;
+    ok = ok && !ServoCalibration::parse(bad.data(), bad.size(), table);
+
+    bad = good;
+    ch = (ServoCalibChannel*)(bad.data() + sizeof(ServoCalibHeader));
+    ch[5].offset_us = SERVO_CALIB_OFFSET_MAX_US + 1;
+    ok = ok && !ServoCalibration::parse(bad.data(), bad.size(), table);
+
+    bad = good;
+    ch = (ServoCalibChannel*)(bad.data() + sizeof(ServoCalibHeader));
+    ch[6].min_us = 2100;
+    ch[6].max_us = 2000;
+    ok = ok && !ServoCalibration::parse(bad.data(), bad.size(), table);
+
+    if (ok && table.center_us[0] == 1234) {
+        PASS();
+    } else {
+        FAIL("accepted a bad table");
+    }
+}
+
+void test_load_file() {
+    TEST("Table file is loaded and oversized files rejected");
+
+    std::vector<uint8_t> buf = build_table();
+    const char* path = "/tmp/test_servo_calib.bin";
+    FILE* f = fopen(path, "wb");
+    bool ok = f && fwrite(buf.data(), 1, buf.size(), f) == buf.size();
+    if (f) fclose(f);
+
+    ServoCalibration::Table table;
+    ok = ok && ServoCalibration::load(path, table) && table.center_us[1] == SERVO_PWM_NEUTRAL_US + 33;
+
+    f = fopen(path, "ab");
+    if (f) {
+        fputc(0, f);
+        fclose(f);
+    }
+    ok = ok && !ServoCalibration::load(path, table) && !ServoCalibration::load("/tmp/missing.bin", table);
+    remove(path);
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("file load failed");
+    }
+}
+
+int main() {
+    printf("=== Servo Calibration Tests ===\n");
+
+    test_identity();
+    test_apply();
+    test_validation();
+    test_load_file();
+
+    printf("\nResults: %d passed, %d failed\n", tests_passed, tests_failed);
+    return tests_failed > 0 ? 1 : 0;
+}
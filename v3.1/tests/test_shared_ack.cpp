@@ -0,0 +1,151 @@
+/**
+ * Shared Packet Acknowledgement Unit Tests
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+
+extern "C" {
+#include "shared_ack.h"
+#include "shared_log.h"
+}
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST(name) printf("  %s: ", name)
+#define PASS() do { printf("PASS\n"); tests_passed++; } while(0)
+#define FAIL(msg) do { printf("FAIL - %s\n", msg); tests_failed++; } while(0)
+
+// Stand-in for the 256KB reserved region
+static uint8_t g_region[SHARED_MEM_SIZE] __attribute__((aligned(64)));
+
+static volatile SharedAckHeader* fresh_acks() {
+    memset(g_region, 0xA5, sizeof(g_region));
+    volatile SharedAckHeader* ack = shared_ack_area(g_region);
+    shared_ack_init(ack);
+    return ack;
+}
+
+static void ack(volatile SharedAckHeader* a, uint32_t seq, uint8_t status) {
+    shared_ack_append(a, seq, status, seq, 5000 + seq);
+    shared_ack_publish(a);
+}
+
+void test_area_placement() {
+    TEST("Ack area is the last tail area and fits the region");
+
+    bool after = SHARED_ACK_OFFSET >= SHARED_PROBE_OFFSET + SHARED_PROBE_SIZE &&
+                 SHARED_PROBE_OFFSET >= SHARED_TRACE_OFFSET + SHARED_TRACE_AREA_SIZE &&
+                 SHARED_LOG_OFFSET == SHARED_RING_REGION_SIZE;
+    bool fits = SHARED_ACK_OFFSET + SHARED_ACK_AREA_SIZE <= SHARED_MEM_SIZE;
+
+    if (after && fits) {
+        PASS();
+    } else {
+        FAIL("ack area overlaps another area or the region end");
+    }
+}
+
+void test_unpublished_invisible() {
+    TEST("Appended record stays invisible until published");
+
+    volatile SharedAckHeader* a = fresh_acks();
+    uint32_t cursor = 0, lost = 0;
+    SharedAckRecord rec;
+
+    shared_ack_append(a, 1, SHARED_ACK_OK, 0, 0);
+    bool ok = shared_ack_valid(a) && shared_ack_read(a, &cursor, &rec, &lost) == 0;
+    shared_ack_publish(a);
+    ok = ok && shared_ack_read(a, &cursor, &rec, &lost) == 1 && rec.seq == 1 && lost == 0;
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("record visible early or not at all");
+    }
+}
+
+void test_read_in_order() {
+    TEST("Statuses read back in order with their seq and time");
+
+    volatile SharedAckHeader* a = fresh_acks();
+    for (uint32_t i = 1; i <= 10; i++) {
+        ack(a, i, (uint8_t)(i % SHARED_ACK_STATUS_COUNT));
+    }
+
+    uint32_t cursor = 0, lost = 0;
+    SharedAckRecord rec;
+    uint32_t expect = 1;
+    bool ok = true;
+    while (shared_ack_read(a, &cursor, &rec, &lost)) {
+        if (rec.seq != expect || rec.status != expect % SHARED_ACK_STATUS_COUNT ||
+            rec.time_us != 5000 + expect || rec.slot != expect) {
+            ok = false;
+        }
+        expect++;
+    }
+
+    if (ok && expect == 11 && lost == 0) {
+        PASS();
+    } else {
+        FAIL("wrong records or count");
+    }
+}
+
+void test_overrun_reports_lost() {
+    TEST("Reader behind by more than the ring counts lost ACKs");
+
+    volatile SharedAckHeader* a = fresh_acks();
+    uint32_t total = SHARED_ACK_RECORDS + 25;
+    for (uint32_t i = 1; i <= total; i++) {
+        ack(a, i, SHARED_ACK_OK);
+    }
+
+    uint32_t cursor = 0, lost = 0;
+    SharedAckRecord rec;
+    uint32_t n = 0, first = 0;
+    while (shared_ack_read(a, &cursor, &rec, &lost)) {
+        if (n == 0) first = rec.seq;
+        n++;
+    }
+
+    if (lost == 25 && n == SHARED_ACK_RECORDS && first == 26) {
+        PASS();
+    } else {
+        char buf[80];
+        snprintf(buf, sizeof(buf), "lost=%u read=%u first=%u", lost, n, first);
+        FAIL(buf);
+    }
+}
+
+void test_status_names() {
+    TEST("Every status has a name");
+
+    bool ok = true;
+    for (uint8_t s = 0; s < SHARED_ACK_STATUS_COUNT; s++) {
+        if (strcmp(shared_ack_status_name(s), "unknown") == 0) {
+            ok = false;
+        }
+    }
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("status without a name");
+    }
+}
+
+int main() {
+    printf("=== Shared ACK Tests ===\n");
+
+    test_area_placement();
+    test_unpublished_invisible();
+    test_read_in_order();
+    test_overrun_reports_lost();
+    test_status_names();
+
+    printf("\nResults: %d passed, %d failed\n", tests_passed, tests_failed);
+    return tests_failed > 0 ? 1 : 0;
+}
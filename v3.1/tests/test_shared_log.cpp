@@ -0,0 +1,191 @@
+/**
+ * Shared Event Log Unit Tests
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+
+extern "C" {
+#include "shared_log.h"
+}
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST(name) printf("  %s: ", name)
+#define PASS() do { printf("PASS\n"); tests_passed++; } while(0)
+#define FAIL(msg) do { printf("FAIL - %s\n", msg); tests_failed++; } while(0)
+
+// Stand-in for the 256KB reserved region
+static uint8_t g_region[SHARED_MEM_SIZE] __attribute__((aligned(64)));
+
+static volatile SharedLogHeader* fresh_log() {
+    memset(g_region, 0xA5, sizeof(g_region));
+    volatile SharedLogHeader* log = shared_log_area(g_region);
+    shared_log_init(log);
+    return log;
+}
+
+static void append(volatile SharedLogHeader* log, uint16_t event, uint32_t arg) {
+    uint32_t args[SHARED_LOG_ARGS] = { arg, 0, 0, 0 };
+    shared_log_append(log, event, 1, 1000 + arg, args);
+}
+
+void test_area_placement() {
+    TEST("Log area sits in the tail, clear of the ring");
+
+    uint32_t slots = shared_ring_slots_for_size(SHARED_RING_REGION_SIZE, SHARED_HEADER_SIZE_PAGED, PACKET_SLOT_SIZE);
+    bool clear = SHARED_HEADER_SIZE_PAGED + slots * PACKET_SLOT_SIZE <= SHARED_LOG_OFFSET;
+    bool fits = SHARED_LOG_OFFSET + SHARED_LOG_AREA_SIZE <= SHARED_MEM_SIZE;
+
+    if (slots == 2048 && clear && fits) {
+        PASS();
+    } else {
+        FAIL("log area overlaps the ring or the region end");
+    }
+}
+
+void test_init_valid() {
+    TEST("Initialized area is valid and empty");
+
+    volatile SharedLogHeader* log = fresh_log();
+    uint32_t cursor = 0, lost = 0;
+    SharedLogRecord rec;
+
+    if (shared_log_valid(log) && shared_log_read(log, &cursor, &rec, &lost) == 0 && lost == 0) {
+        PASS();
+    } else {
+        FAIL("fresh log not valid or not empty");
+    }
+}
+
+void test_read_in_order() {
+    TEST("Records read back in order");
+
+    volatile SharedLogHeader* log = fresh_log();
+    for (uint32_t i = 0; i < 10; i++) {
+        append(log, SHARED_LOG_EVT_PKT_CRC, i);
+    }
+
+    uint32_t cursor = 0, lost = 0;
+    SharedLogRecord rec;
+    uint32_t expect = 0;
+    bool ok = true;
+    while (shared_log_read(log, &cursor, &rec, &lost)) {
+        if (rec.event != SHARED_LOG_EVT_PKT_CRC || rec.args[0] != expect ||
+            rec.time_us != 1000 + expect || rec.seq != expect + 1) {
+            ok = false;
+        }
+        expect++;
+    }
+
+    if (ok && expect == 10 && lost == 0 && cursor == 10) {
+        PASS();
+    } else {
+        FAIL("wrong records or count");
+    }
+}
+
+void test_overrun_reports_lost() {
+    TEST("Reader behind by more than the ring counts lost records");
+
+    volatile SharedLogHeader* log = fresh_log();
+    uint32_t total = SHARED_LOG_RECORDS + 40;
+    for (uint32_t i = 0; i < total; i++) {
+        append(log, SHARED_LOG_EVT_STATUS, i);
+    }
+
+    uint32_t cursor = 0, lost = 0;
+    SharedLogRecord rec;
+    uint32_t n = 0;
+    uint32_t first = 0;
+    while (shared_log_read(log, &cursor, &rec, &lost)) {
+        if (n == 0) first = rec.args[0];
+        n++;
+    }
+
+    if (lost == 40 && n == SHARED_LOG_RECORDS && first == 40) {
+        PASS();
+    } else {
+        char buf[80];
+        snprintf(buf, sizeof(buf), "lost=%u read=%u first=%u", lost, n, first);
+        FAIL(buf);
+    }
+}
+
+void test_torn_record_skipped() {
+    TEST("Record rewritten under the reader is dropped");
+
+    volatile SharedLogHeader* log = fresh_log();
+    append(log, SHARED_LOG_EVT_ESTOP, 0);
+    append(log, SHARED_LOG_EVT_ESTOP, 1);
+
+    // Writer is mid-way through reusing slot 0
+    shared_log_record(log, 0)->seq = 0;
+
+    uint32_t cursor = 0, lost = 0;
+    SharedLogRecord rec;
+    int got = shared_log_read(log, &cursor, &rec, &lost);
+
+    if (got == 1 && rec.args[0] == 1 && lost == 1 && cursor == 2) {
+        PASS();
+    } else {
+        FAIL("torn record not skipped");
+    }
+}
+
+void test_writer_restart_rewinds() {
+    TEST("Writer restart rewinds the reader");
+
+    volatile SharedLogHeader* log = fresh_log();
+    for (uint32_t i = 0; i < 5; i++) {
+        append(log, SHARED_LOG_EVT_STATUS, i);
+    }
+    uint32_t cursor = 0, lost = 0;
+    SharedLogRecord rec;
+    while (shared_log_read(log, &cursor, &rec, &lost)) {}
+
+    // Muscle reboots and logs again
+    shared_log_init(log);
+    append(log, SHARED_LOG_EVT_BOOT, 7);
+
+    int got = shared_log_read(log, &cursor, &rec, &lost);
+    if (cursor == 1 && got == 1 && rec.event == SHARED_LOG_EVT_BOOT && rec.args[0] == 7) {
+        PASS();
+    } else {
+        FAIL("reader did not follow the restart");
+    }
+}
+
+void test_formats_cover_events() {
+    TEST("Every event has a format");
+
+    bool ok = true;
+    for (uint16_t e = 1; e < SHARED_LOG_EVT_COUNT; e++) {
+        if (strncmp(shared_log_format(e), "Unknown event", 13) == 0) {
+            ok = false;
+        }
+    }
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("event without a format string");
+    }
+}
+
+int main() {
+    printf("=== Shared Event Log Tests ===\n");
+
+    test_area_placement();
+    test_init_valid();
+    test_read_in_order();
+    test_overrun_reports_lost();
+    test_torn_record_skipped();
+    test_writer_restart_rewinds();
+    test_formats_cover_events();
+
+    printf("\nResults: %d passed, %d failed\n", tests_passed, tests_failed);
+    return tests_failed > 0 ? 1 : 0;
+}
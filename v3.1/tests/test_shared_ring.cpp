@@ -0,0 +1,187 @@
+/**
+ * Shared Ring Layout Unit Tests
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+
+extern "C" {
+#include "shared_motion_buffer.h"
+}
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST(name) printf("  %s: ", name)
+#define PASS() do { printf("PASS\n"); tests_passed++; } while(0)
+#define FAIL(msg) do { printf("FAIL - %s\n", msg); tests_failed++; } while(0)
+
+// Stand-in for the 256KB reserved region
+static uint8_t g_region[SHARED_MEM_SIZE] __attribute__((aligned(64)));
+
+static SharedRingHeader* make_header(uint32_t slots) {
+    memset(g_region, 0, sizeof(g_region));
+    SharedRingHeader* hdr = (SharedRingHeader*)g_region;
+    hdr->magic = SHARED_LAYOUT_MAGIC;
+    hdr->version = SHARED_LAYOUT_VERSION;
+    hdr->header_size = SHARED_HEADER_SIZE;
+    hdr->slot_size = PACKET_SLOT_SIZE;
+    hdr->slot_count = slots;
+    return hdr;
+}
+
+void test_slots_for_region() {
+    TEST("Slot count fills 256KB region");
+
+    uint32_t n = shared_ring_slots_for_size(SHARED_MEM_SIZE, SHARED_HEADER_SIZE, PACKET_SLOT_SIZE);
+    uint32_t paged = shared_ring_slots_for_size(SHARED_MEM_SIZE, SHARED_HEADER_SIZE_PAGED, PACKET_SLOT_SIZE);
+    if (n == 2048 && paged == 2048 && SHARED_HEADER_SIZE + n * PACKET_SLOT_SIZE <= SHARED_MEM_SIZE) {
+        PASS();
+    } else {
+        char buf[64];
+        snprintf(buf, sizeof(buf), "Expected 2048 slots, got %u", n);
+        FAIL(buf);
+    }
+}
+
+void test_small_region_minimum() {
+    TEST("Tiny region still yields minimum slots");
+
+    if (shared_ring_slots_for_size(0x1000, SHARED_HEADER_SIZE, PACKET_SLOT_SIZE) == 32 &&
+        shared_ring_slots_for_size(SHARED_HEADER_SIZE, SHARED_HEADER_SIZE, PACKET_SLOT_SIZE) == SHARED_RING_MIN_SLOTS) {
+        PASS();
+    } else {
+        FAIL("unexpected slot count");
+    }
+}
+
+void test_header_accepted() {
+    TEST("Valid header accepted");
+
+    SharedRingHeader* hdr = make_header(2048);
+    if (shared_ring_header_check(hdr, SHARED_MEM_SIZE) == 0) {
+        PASS();
+    } else {
+        FAIL("valid header rejected");
+    }
+}
+
+void test_header_rejected() {
+    TEST("Bad magic/version/geometry rejected");
+
+    SharedRingHeader* hdr = make_header(2048);
+    hdr->magic = 0;
+    int bad_magic = shared_ring_header_check(hdr, SHARED_MEM_SIZE);
+
+    hdr = make_header(2048);
+    hdr->version = 0x0301;
+    int bad_version = shared_ring_header_check(hdr, SHARED_MEM_SIZE);
+
+    hdr = make_header(1000);
+    int not_pow2 = shared_ring_header_check(hdr, SHARED_MEM_SIZE);
+
+    hdr = make_header(4096);
+    int too_big = shared_ring_header_check(hdr, SHARED_MEM_SIZE);
+
+    if (bad_magic != 0 && bad_version != 0 && not_pow2 != 0 && too_big != 0) {
+        PASS();
+    } else {
+        FAIL("invalid header accepted");
+    }
+}
+
+void test_slot_wraps() {
+    TEST("Slot index wraps with monotonic counters");
+
+    SharedRingHeader* hdr = make_header(8);
+    volatile SharedRingSlot* first = shared_ring_slot(hdr, 0);
+    volatile SharedRingSlot* wrapped = shared_ring_slot(hdr, 8);
+    volatile SharedRingSlot* last = shared_ring_slot(hdr, 0xFFFFFFFFu);
+
+    if ((uint8_t*)first == g_region + SHARED_HEADER_SIZE && first == wrapped &&
+        (uint8_t*)last == g_region + SHARED_HEADER_SIZE + 7 * PACKET_SLOT_SIZE) {
+        PASS();
+    } else {
+        FAIL("wrong slot address");
+    }
+}
+
+void test_full_and_empty() {
+    TEST("Full/empty across counter overflow");
+
+    SharedRingHeader* hdr = make_header(8);
+    hdr->read_idx = 0xFFFFFFFCu;
+    hdr->write_idx = 0xFFFFFFFCu;
+    int empty = shared_ring_is_empty(hdr);
+    hdr->write_idx = hdr->read_idx + 8;
+    int full = shared_ring_is_full(hdr);
+
+    if (empty && full && shared_ring_available(hdr) == 8) {
+        PASS();
+    } else {
+        FAIL("wrong occupancy");
+    }
+}
+
+void test_lapped_reader() {
+    TEST("A lapped reader resumes at the oldest intact slot");
+
+    SharedRingHeader* hdr = make_header(8);
+    bool ok = shared_ring_oldest(hdr, 100, 105) == 100 &&      // Not lapped
+              shared_ring_oldest(hdr, 100, 108) == 100 &&      // Exactly full
+              shared_ring_oldest(hdr, 100, 111) == 103 &&      // Three overwritten
+              shared_ring_oldest(hdr, 0xFFFFFFFEu, 9) == 1;    // Across counter overflow
+    ok = ok && shared_ring_slot_gen(7) != shared_ring_slot_gen(7 + 8) && shared_ring_slot_gen(0) != 0;
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("wrong resume index");
+    }
+}
+
+void test_wide_slots() {
+    TEST("Slot size follows the channel count");
+
+    bool sizes = shared_ring_slot_size_for(SERVO_COUNT_TOTAL) == PACKET_SLOT_SIZE &&
+                 shared_ring_slot_size_for(POSEPACKETN_SLOT64_CHANNELS) == PACKET_SLOT_SIZE &&
+                 shared_ring_slot_size_for(POSEPACKETN_SLOT64_CHANNELS + 1) == PACKET_SLOT_SIZE_MAX &&
+                 shared_ring_slot_size_for(POSEPACKETN_MAX_CHANNELS) == PACKET_SLOT_SIZE_MAX &&
+                 SHARED_SLOT_HEADER_SIZE + posepacketn_size(POSEPACKETN_MAX_CHANNELS) <= PACKET_SLOT_SIZE_MAX;
+
+    SharedRingHeader* hdr = make_header(1024);
+    hdr->slot_size = PACKET_SLOT_SIZE_MAX;
+    bool accepted = shared_ring_header_check(hdr, SHARED_MEM_SIZE) == 0 &&
+                    (uint8_t*)shared_ring_slot(hdr, 3) == g_region + SHARED_HEADER_SIZE + 3 * PACKET_SLOT_SIZE_MAX;
+    hdr->slot_count = 2048;
+    bool too_big = shared_ring_header_check(hdr, SHARED_MEM_SIZE) != 0;
+    hdr->slot_count = 1024;
+    hdr->slot_size = 96;
+    bool odd = shared_ring_header_check(hdr, SHARED_MEM_SIZE) != 0;
+    hdr->slot_size = 2 * PACKET_SLOT_SIZE_MAX;
+    bool huge = shared_ring_header_check(hdr, SHARED_MEM_SIZE) != 0;
+
+    if (sizes && accepted && too_big && odd && huge &&
+        shared_ring_slots_for_size(SHARED_MEM_SIZE, SHARED_HEADER_SIZE, PACKET_SLOT_SIZE_MAX) == 1024) {
+        PASS();
+    } else {
+        FAIL("wrong wide slot geometry");
+    }
+}
+
+int main() {
+    printf("=== Shared Ring Layout Tests ===\n");
+
+    test_slots_for_region();
+    test_small_region_minimum();
+    test_header_accepted();
+    test_header_rejected();
+    test_slot_wraps();
+    test_full_and_empty();
+    test_lapped_reader();
+    test_wide_slots();
+
+    printf("\nResults: %d passed, %d failed\n", tests_passed, tests_failed);
+    return tests_failed > 0 ? 1 : 0;
+}
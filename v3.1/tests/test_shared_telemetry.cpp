@@ -0,0 +1,109 @@
+/**
+ * Shared Telemetry Block Unit Tests
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+
+extern "C" {
+#include "shared_telemetry.h"
+}
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST(name) printf("  %s: ", name)
+#define PASS() do { printf("PASS\n"); tests_passed++; } while(0)
+#define FAIL(msg) do { printf("FAIL - %s\n", msg); tests_failed++; } while(0)
+
+// Stand-in for the 256KB reserved region
+static uint8_t g_region[SHARED_MEM_SIZE] __attribute__((aligned(64)));
+
+static volatile SharedTelemetry* fresh_block() {
+    memset(g_region, 0, sizeof(g_region));
+    volatile SharedTelemetry* t = shared_telemetry_area(g_region);
+    shared_telemetry_init(t);
+    return t;
+}
+
+void test_placement() {
+    TEST("Telemetry follows the log inside the tail");
+
+    bool after_log = SHARED_TELEMETRY_OFFSET >= SHARED_LOG_OFFSET + SHARED_LOG_AREA_SIZE;
+    bool in_tail = SHARED_TELEMETRY_OFFSET >= SHARED_RING_REGION_SIZE &&
+                   SHARED_TELEMETRY_OFFSET + SHARED_TELEMETRY_SIZE <= SHARED_MEM_SIZE;
+
+    if (after_log && in_tail) {
+        PASS();
+    } else {
+        FAIL("telemetry overlaps the log or leaves the region");
+    }
+}
+
+void test_uninitialized_rejected() {
+    TEST("Block without magic is not read");
+
+    memset(g_region, 0, sizeof(g_region));
+    SharedTelemetryData d;
+    if (shared_telemetry_read(shared_telemetry_area(g_region), &d) == -1) {
+        PASS();
+    } else {
+        FAIL("read an uninitialized block");
+    }
+}
+
+void test_round_trip() {
+    TEST("Published snapshot reads back");
+
+    volatile SharedTelemetry* t = fresh_block();
+    SharedTelemetryData in;
+    memset(&in, 0, sizeof(in));
+    in.time_us = 123456789ULL;
+    in.ticks = 42;
+    in.rx_count = 7;
+    in.drop_count = 2;
+    in.last_seq = 99;
+    in.fault_flags = 0x20;
+    in.tick_period_us = 20010;
+    in.watchdog_state = 1;
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) {
+        in.servo_us[i] = (uint16_t)(1000 + i);
+    }
+    shared_telemetry_write(t, &in);
+    shared_telemetry_write(t, &in);
+
+    SharedTelemetryData out;
+    int ret = shared_telemetry_read(t, &out);
+    if (ret == 0 && memcmp(&in, &out, sizeof(in)) == 0 && t->seq == 4) {
+        PASS();
+    } else {
+        FAIL("snapshot differs or seq not even");
+    }
+}
+
+void test_write_in_progress() {
+    TEST("Odd seq (writer active) is never returned");
+
+    volatile SharedTelemetry* t = fresh_block();
+    t->seq = 3;
+
+    SharedTelemetryData out;
+    if (shared_telemetry_read(t, &out) == -2) {
+        PASS();
+    } else {
+        FAIL("returned a snapshot during a write");
+    }
+}
+
+int main() {
+    printf("=== Shared Telemetry Tests ===\n");
+
+    test_placement();
+    test_uninitialized_rejected();
+    test_round_trip();
+    test_write_in_progress();
+
+    printf("\nResults: %d passed, %d failed\n", tests_passed, tests_failed);
+    return tests_failed > 0 ? 1 : 0;
+}
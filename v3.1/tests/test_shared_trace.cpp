@@ -0,0 +1,199 @@
+/**
+ * Shared Trace Buffer Unit Tests
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "trace.h"
+
+extern "C" {
+#include "shared_trace.h"
+#include "timebase.h"
+}
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST(name) printf("  %s: ", name)
+#define PASS() do { printf("PASS\n"); tests_passed++; } while(0)
+#define FAIL(msg) do { printf("FAIL - %s\n", msg); tests_failed++; } while(0)
+
+// Stand-in for the 256KB reserved region
+static uint8_t g_region[SHARED_MEM_SIZE] __attribute__((aligned(64)));
+
+static volatile SharedTraceHeader* fresh_area() {
+    memset(g_region, 0, sizeof(g_region));
+    volatile SharedTraceHeader* tr = shared_trace_area(g_region);
+    shared_trace_init(tr, SHARED_TRACE_RECORDS);
+    return tr;
+}
+
+static SharedTraceRecord g_out[SHARED_TRACE_RECORDS];
+
+void test_placement() {
+    TEST("Trace area follows telemetry inside the tail");
+
+    bool after_telemetry = SHARED_TRACE_OFFSET >= SHARED_TELEMETRY_OFFSET + SHARED_TELEMETRY_SIZE;
+    bool in_tail = SHARED_TRACE_OFFSET + SHARED_TRACE_AREA_SIZE <= SHARED_MEM_SIZE;
+
+    if (after_telemetry && in_tail) {
+        PASS();
+    } else {
+        FAIL("trace area overlaps telemetry or leaves the region");
+    }
+}
+
+void test_uninitialized_rejected() {
+    TEST("Area without magic is not valid");
+
+    memset(g_region, 0, sizeof(g_region));
+    volatile SharedTraceHeader* tr = shared_trace_area(g_region);
+    bool before = shared_trace_valid(tr, SHARED_TRACE_RECORDS);
+    shared_trace_init(tr, SHARED_TRACE_RECORDS);
+    bool after = shared_trace_valid(tr, SHARED_TRACE_RECORDS);
+
+    if (!before && after) {
+        PASS();
+    } else {
+        FAIL("validity check wrong");
+    }
+}
+
+void test_snapshot_order() {
+    TEST("Snapshot returns records oldest first");
+
+    volatile SharedTraceHeader* tr = fresh_area();
+    for (uint32_t i = 0; i < 5; i++) {
+        shared_trace_append(tr, SHARED_TRACE_MUSCLE_DEQUEUED, 1000 + i, 10 + i, 0);
+    }
+
+    size_t n = shared_trace_snapshot(tr, g_out, SHARED_TRACE_RECORDS);
+    bool ok = (n == 5);
+    for (size_t i = 0; ok && i < n; i++) {
+        ok = g_out[i].arg == 10 + i && g_out[i].time_us == 1000 + i &&
+             g_out[i].probe == SHARED_TRACE_MUSCLE_DEQUEUED;
+    }
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("wrong count or order");
+    }
+}
+
+void test_wrap() {
+    TEST("Wrapped buffer keeps the newest records");
+
+    volatile SharedTraceHeader* tr = fresh_area();
+    uint32_t total = SHARED_TRACE_RECORDS + 100;
+    for (uint32_t i = 0; i < total; i++) {
+        shared_trace_append(tr, SHARED_TRACE_I2C_DONE, i, i, 0);
+    }
+
+    size_t few = shared_trace_snapshot(tr, g_out, 8);
+    bool ok = (few == 8) && g_out[0].arg == total - 8 && g_out[7].arg == total - 1;
+
+    size_t n = shared_trace_snapshot(tr, g_out, SHARED_TRACE_RECORDS);
+    ok = ok && n == SHARED_TRACE_RECORDS && g_out[0].arg == 100 && g_out[n - 1].arg == total - 1;
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("lost newest records after wrap");
+    }
+}
+
+void test_torn_skipped() {
+    TEST("Record being rewritten is skipped");
+
+    volatile SharedTraceHeader* tr = fresh_area();
+    for (uint32_t i = 0; i < 4; i++) {
+        shared_trace_append(tr, SHARED_TRACE_MUSCLE_VALIDATED, i, i, 0);
+    }
+    // Writer mid-record: stamp cleared
+    shared_trace_record(tr, 2)->stamp = 0;
+
+    size_t n = shared_trace_snapshot(tr, g_out, SHARED_TRACE_RECORDS);
+    if (n == 3 && g_out[0].arg == 0 && g_out[1].arg == 1 && g_out[2].arg == 3) {
+        PASS();
+    } else {
+        FAIL("returned a record without its stamp");
+    }
+}
+
+void test_timebase_monotonic() {
+    TEST("timebase_micros is monotonic and shared");
+
+    uint64_t a = timebase_micros();
+    timebase_delay_ms(2);
+    uint64_t b = timebase_micros();
+    uint64_t s = timebase_shared_us();
+
+    if (b >= a + 2000 && s >= b) {
+        PASS();
+    } else {
+        FAIL("clock went backwards or delay too short");
+    }
+}
+
+void test_brain_recorder() {
+    TEST("Brain trace_point lands in its snapshot");
+
+    trace_point(SHARED_TRACE_PACKET_BUILT, 77);
+    trace_point_at(SHARED_TRACE_CMD_DECODED, 5, 77);
+
+    SharedTraceRecord recs[4];
+    size_t n = trace_snapshot(recs, 4);
+    if (n == 2 && recs[0].probe == SHARED_TRACE_PACKET_BUILT && recs[0].arg == 77 &&
+        recs[1].probe == SHARED_TRACE_CMD_DECODED && recs[1].time_us == 5) {
+        PASS();
+    } else {
+        FAIL("recorded points missing");
+    }
+}
+
+void test_export_json() {
+    TEST("Export names probes and spans each seq");
+
+    SharedTraceRecord recs[3];
+    memset(recs, 0, sizeof(recs));
+    recs[0].probe = SHARED_TRACE_I2C_DONE;         recs[0].time_us = 1300; recs[0].arg = 9;
+    recs[1].probe = SHARED_TRACE_CMD_DECODED;      recs[1].time_us = 1000; recs[1].arg = 9;
+    recs[2].probe = SHARED_TRACE_MUSCLE_NOTIFIED;  recs[2].time_us = 1100; recs[2].arg = 4;
+
+    std::string json = trace_export_json(recs, 3);
+    bool ok = json.find("{\"displayTimeUnit") == 0 &&
+              json.find("\"name\":\"cmd_decoded\",\"cat\":\"brain\",\"ph\":\"i\",\"s\":\"t\",\"ts\":0,") != std::string::npos &&
+              json.find("\"name\":\"i2c_done\",\"cat\":\"muscle\",\"ph\":\"i\",\"s\":\"t\",\"ts\":300,\"pid\":2") != std::string::npos &&
+              json.find("\"args\":{\"arg\":4,") != std::string::npos &&
+              json.find("\"name\":\"seq 9\",\"cat\":\"packet\",\"ph\":\"b\",\"id\":9,\"ts\":0") != std::string::npos &&
+              json.find("\"name\":\"seq 9\",\"cat\":\"packet\",\"ph\":\"e\",\"id\":9,\"ts\":300") != std::string::npos &&
+              json.find("\"seq 4\"") == std::string::npos &&
+              json.find("\"base_us\":1000") != std::string::npos;
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("unexpected JSON");
+        printf("    %s\n", json.c_str());
+    }
+}
+
+int main() {
+    printf("=== Shared Trace Tests ===\n");
+
+    test_placement();
+    test_uninitialized_rejected();
+    test_snapshot_order();
+    test_wrap();
+    test_torn_skipped();
+    test_timebase_monotonic();
+    test_brain_recorder();
+    test_export_json();
+
+    printf("\nResults: %d passed, %d failed\n", tests_passed, tests_failed);
+    return tests_failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,119 @@
+/**
+ * Slot Table Unit Tests
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+
+#include "slot_table.h"
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST(name) printf("  %s: ", name)
+#define PASS() do { printf("PASS\n"); tests_passed++; } while(0)
+#define FAIL(msg) do { printf("FAIL - %s\n", msg); tests_failed++; } while(0)
+
+static int s_live = 0;
+
+struct Entry {
+    int value = 7;
+    std::vector<int> owned;
+    Entry() { s_live++; }
+    ~Entry() { s_live--; }
+};
+
+void test_acquire_release() {
+    TEST("Slots fill lowest first, refuse when full and are reused");
+
+    SlotTable<Entry, 4> table;
+    bool ok = table.size() == 0 && s_live == 0;
+    for (int i = 0; i < 4; i++) {
+        ok = ok && table.acquire() == i;
+    }
+    ok = ok && table.full() && table.acquire() == -1 && s_live == 4;
+
+    table.release(2);
+    table.release(2);
+    ok = ok && table.size() == 3 && s_live == 3 && !table.inUse(2);
+    ok = ok && table.acquire() == 2 && table[2].value == 7 && s_live == 4;
+
+    table.clear();
+    ok = ok && table.size() == 0 && s_live == 0;
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("wrong slot bookkeeping");
+    }
+}
+
+void test_stable_and_generation() {
+    TEST("Entries never move; a stale index and generation is refused");
+
+    SlotTable<Entry, 8> table;
+    int a = table.acquire();
+    int b = table.acquire();
+    Entry* pb = &table[b];
+    pb->owned.assign(100, 1);
+    uint32_t gen_a = table.generation(a);
+
+    // Churn around b
+    table.release(a);
+    for (int i = 0; i < 5; i++) {
+        table.acquire();
+    }
+    bool ok = &table[b] == pb && pb->owned.size() == 100 && table.indexOf(*pb) == b;
+
+    // a's slot was handed out again, so the old handle no longer resolves
+    ok = ok && table.inUse(a) && table.get(a, gen_a) == nullptr &&
+         table.get(a, table.generation(a)) == &table[a] && table.get(b, table.generation(b)) == pb;
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("entry moved or stale handle accepted");
+    }
+}
+
+void test_iteration() {
+    TEST("Iteration visits slots in use, in index order");
+
+    SlotTable<Entry, 6> table;
+    for (int i = 0; i < 6; i++) {
+        table.acquire();
+        table[i].value = i;
+    }
+    table.release(0);
+    table.release(3);
+    table.release(5);
+
+    int seen[6];
+    int n = 0;
+    for (Entry& e : table) {
+        seen[n++] = e.value;
+    }
+    const SlotTable<Entry, 6>& ctable = table;
+    int sum = 0;
+    for (const Entry& e : ctable) {
+        sum += e.value;
+    }
+
+    if (n == 3 && seen[0] == 1 && seen[1] == 2 && seen[2] == 4 && sum == 7) {
+        PASS();
+    } else {
+        FAIL("wrong visit order");
+    }
+}
+
+int main() {
+    printf("=== Slot Table Tests ===\n");
+
+    test_acquire_release();
+    test_stable_and_generation();
+    test_iteration();
+
+    printf("\nResults: %d passed, %d failed\n", tests_passed, tests_failed);
+    return tests_failed > 0 ? 1 : 0;
+}
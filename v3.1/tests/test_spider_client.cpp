@@ -0,0 +1,386 @@
+/**
+ * libspider Client Unit Tests
+ *
+ * The client talks to a scripted daemon on loopback: a thread answers the
+ * handshake, then the test plays the daemon's side frame by frame while
+ * pumping the client. Teleop datagrams go to the daemon's own UdpTeleop.
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+#include "spider_client.h"
+#include "spider_teleop.h"
+#include "sha1.h"
+#include "udp_teleop.h"
+#include "ws_frame.h"
+
+extern "C" {
+#include "timebase.h"
+}
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST(name) printf("  %s: ", name)
+#define PASS() do { printf("PASS\n"); tests_passed++; } while(0)
+#define FAIL(msg) do { printf("FAIL - %s\n", msg); tests_failed++; } while(0)
+
+// ---- Scripted daemon ----
+
+static int listen_loopback(uint16_t& port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 1) != 0 ||
+        getsockname(fd, (sockaddr*)&addr, &len) != 0) {
+        close(fd);
+        return -1;
+    }
+    port = ntohs(addr.sin_port);
+    return fd;
+}
+
+static void send_frame(int fd, uint8_t opcode, const void* data, size_t len) {
+    uint8_t hdr[WS_FRAME_HEADER_MAX];
+    size_t hdr_len = ws_frame_header(hdr, opcode, len);
+    std::string out((const char*)hdr, hdr_len);
+    out.append((const char*)data, len);
+    send(fd, out.data(), out.size(), MSG_NOSIGNAL);
+}
+
+static void send_text(int fd, const char* text) {
+    send_frame(fd, 0x01, text, strlen(text));
+}
+
+// Accept one connection and answer its handshake as the daemon does
+static int accept_ws(int listen_fd) {
+    int fd = accept(listen_fd, nullptr, nullptr);
+    if (fd < 0) return -1;
+    timeval tv = {2, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    std::string req;
+    char buf[1024];
+    while (req.find("\r\n\r\n") == std::string::npos) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0) {
+            close(fd);
+            return -1;
+        }
+        req.append(buf, (size_t)n);
+    }
+    size_t at = req.find("Sec-WebSocket-Key: ") + 19;
+    std::string key = req.substr(at, req.find("\r\n", at) - at) + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+    uint8_t hash[20];
+    sha1((const uint8_t*)key.data(), key.size(), hash);
+
+    static const char b64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string accept;
+    for (int i = 0; i < 21; i += 3) {
+        uint32_t v = hash[i] << 16 | (i + 1 < 20 ? hash[i + 1] << 8 : 0) | (i + 2 < 20 ? hash[i + 2] : 0);
+        accept += b64[(v >> 18) & 0x3F];
+        accept += b64[(v >> 12) & 0x3F];
+        accept += i + 1 < 20 ? b64[(v >> 6) & 0x3F] : '=';
+        accept += i + 2 < 20 ? b64[v & 0x3F] : '=';
+    }
+    std::string resp = "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\n"
+                       "Connection: Upgrade\r\nSec-WebSocket-Accept: " + accept + "\r\n\r\n";
+    send(fd, resp.data(), resp.size(), MSG_NOSIGNAL);
+    send_text(fd, "{\"status\":\"connected\",\"version\":\"3.1\"}");
+    return fd;
+}
+
+// Next client frame, unmasked; false if it was not masked or did not come
+static bool read_frame(int fd, std::string& rx, uint8_t& opcode, std::string& payload) {
+    char buf[4096];
+    for (;;) {
+        WsFrameHeader hdr;
+        if (ws_frame_parse((const uint8_t*)rx.data(), rx.size(), hdr)) {
+            if (!hdr.masked) return false;
+            payload.assign(rx, hdr.header_len, (size_t)hdr.payload_len);
+            ws_unmask((uint8_t*)&payload[0], payload.size(), (const uint8_t*)rx.data() + hdr.header_len - 4);
+            opcode = hdr.opcode;
+            rx.erase(0, hdr.header_len + (size_t)hdr.payload_len);
+            return true;
+        }
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0) return false;
+        rx.append(buf, (size_t)n);
+    }
+}
+
+struct Session {
+    SpiderClient client;
+    int listen_fd = -1;
+    int fd = -1;
+    std::string rx;
+    int events = 0;
+    std::string last_event;
+
+    bool open() {
+        uint16_t port;
+        listen_fd = listen_loopback(port);
+        if (listen_fd < 0) return false;
+        std::thread daemon([this]() { fd = accept_ws(listen_fd); });
+        bool ok = client.connect("127.0.0.1", port, 2000);
+        daemon.join();
+        client.onEvent([this](const char* json, size_t len) {
+            events++;
+            last_event.assign(json, len);
+        });
+        return ok && fd >= 0;
+    }
+
+    // Pump until done() or a second has passed
+    template <typename Done>
+    bool pumpUntil(Done done) {
+        uint64_t deadline = timebase_millis64() + 1000;
+        while (!done() && timebase_millis64() < deadline) {
+            if (client.poll(10) < 0) break;
+        }
+        return done();
+    }
+
+    ~Session() {
+        client.close();
+        if (fd >= 0) close(fd);
+        if (listen_fd >= 0) close(listen_fd);
+    }
+};
+
+// ---- Tests ----
+
+void test_pipelined_commands() {
+    TEST("Pipelined commands are tagged and matched by id");
+
+    Session s;
+    if (!s.open()) {
+        FAIL("handshake failed");
+        return;
+    }
+
+    const char* cmds[] = { "{\"cmd\":\"map_get\"}", "{\"cmd\":\"status\"}", " { } " };
+    std::string replies[3];
+    int settled = 0;
+    bool first_null = false;
+    uint32_t ids[3];
+    for (int i = 0; i < 3; i++) {
+        ids[i] = s.client.command(cmds[i], [&, i](const char* json, size_t len) {
+            settled++;
+            if (json) {
+                replies[i].assign(json, len);
+            } else if (i == 0) {
+                first_null = true;
+            }
+        });
+    }
+    bool ok = ids[0] == 1 && ids[1] == 2 && ids[2] == 3 && s.client.pendingReplies() == 3;
+    ok = ok && s.pumpUntil([&]() { return !s.client.wantsWrite(); });
+
+    // What the daemon receives
+    const char* expect[] = { "{\"id\":1,\"cmd\":\"map_get\"}", "{\"id\":2,\"cmd\":\"status\"}", "{\"id\":3 } " };
+    for (int i = 0; i < 3 && ok; i++) {
+        uint8_t opcode;
+        std::string payload;
+        ok = read_frame(s.fd, s.rx, opcode, payload) && opcode == 0x01 && payload == expect[i];
+    }
+
+    // map_get answers with nothing tagged, an event comes in between, and a
+    // reply for no command in flight is an event too
+    send_text(s.fd, "{\"error\":\"eye_service_unavailable\"}");
+    send_text(s.fd, "{\"id\":2,\"status\":\"ok\"}");
+    send_text(s.fd, "{\"id\":2,\"status\":\"again\"}");
+    send_text(s.fd, "{\"id\":3}");
+    ok = ok && s.pumpUntil([&]() { return settled == 3 && s.events == 3; });
+
+    if (ok && first_null && replies[1] == "{\"id\":2,\"status\":\"ok\"}" && replies[2] == "{\"id\":3}" &&
+        s.last_event == "{\"id\":2,\"status\":\"again\"}" && s.client.pendingReplies() == 0) {
+        PASS();
+    } else {
+        FAIL("replies mismatched");
+    }
+}
+
+void test_pose_acks() {
+    TEST("Pose frames always ask for an ack; acks complete in order");
+
+    Session s;
+    if (!s.open()) {
+        FAIL("handshake failed");
+        return;
+    }
+
+    WsPoseEntry entries[2] = {};
+    entries[0].t_ms = 100;
+    entries[1].servo_us[12] = 1500;
+    uint32_t acked[2] = {};
+    bool ok = s.client.sendPoses(entries, 2, WS_POSE_REQ_SCHEDULE, [&](const WsPoseAck* ack) {
+        acked[0] = ack ? ack->accepted : 99;
+    });
+    ok = ok && s.client.sendPoses(entries, 1, 0, [&](const WsPoseAck* ack) {
+        acked[1] = ack ? ack->seq : 99;
+    });
+    ok = ok && !s.client.sendPoses(entries, 0) && !s.client.sendPoses(entries, WS_POSE_MAX_BATCH + 1);
+    ok = ok && s.pumpUntil([&]() { return !s.client.wantsWrite(); });
+
+    uint8_t opcode;
+    std::string payload;
+    ok = ok && read_frame(s.fd, s.rx, opcode, payload) && opcode == 0x02 &&
+         payload.size() == sizeof(WsPoseHeader) + 2 * sizeof(WsPoseEntry);
+    WsPoseHeader hdr = {};
+    if (ok) memcpy(&hdr, payload.data(), sizeof(hdr));
+    ok = ok && hdr.msg == WS_POSE_MSG_POSE && hdr.count == 2 &&
+         hdr.req_flags == (WS_POSE_REQ_ACK | WS_POSE_REQ_SCHEDULE) &&
+         memcmp(payload.data() + sizeof(hdr), entries, sizeof(entries)) == 0;
+    ok = ok && read_frame(s.fd, s.rx, opcode, payload) && payload[2] == WS_POSE_REQ_ACK;
+
+    WsPoseAck ack = { WS_POSE_MSG_ACK, 2, WS_POSE_STATUS_OK, 0, 41 };
+    send_frame(s.fd, 0x02, &ack, sizeof(ack));
+    ack.accepted = 1;
+    ack.seq = 42;
+    send_frame(s.fd, 0x02, &ack, sizeof(ack));
+    ok = ok && s.pumpUntil([&]() { return s.client.pendingAcks() == 0; });
+
+    if (ok && acked[0] == 2 && acked[1] == 42) {
+        PASS();
+    } else {
+        FAIL("acks mismatched");
+    }
+}
+
+void test_telemetry_stream() {
+    TEST("Telemetry deltas are applied from a keyframe on");
+
+    Session s;
+    if (!s.open()) {
+        FAIL("handshake failed");
+        return;
+    }
+
+    int streams = 0;
+    int decoded = 0;
+    SharedTelemetryData got = {};
+    s.client.onStream([&](const WsStreamHeader&, const uint8_t*, size_t) { streams++; });
+    s.client.onTelemetry([&](const SharedTelemetryData& t, uint16_t) {
+        decoded++;
+        got = t;
+    });
+
+    SharedTelemetryData a = {};
+    SharedTelemetryData b = {};
+    a.last_seq = 7;
+    b = a;
+    b.last_seq = 8;
+    uint8_t frame[sizeof(WsStreamHeader) + WS_STREAM_TELEMETRY_MAX];
+    WsStreamHeader hdr = { WS_STREAM_MSG_TELEMETRY, 0, 0 };
+
+    // A delta before any keyframe is passed on raw but not decoded
+    memcpy(frame, &hdr, sizeof(hdr));
+    size_t len = ws_stream_telemetry_encode(frame + sizeof(hdr), &b, &a);
+    send_frame(s.fd, 0x02, frame, sizeof(hdr) + len);
+    hdr.count = 1;
+    hdr.seq = 1;
+    memcpy(frame, &hdr, sizeof(hdr));
+    len = ws_stream_telemetry_encode(frame + sizeof(hdr), &a, nullptr);
+    send_frame(s.fd, 0x02, frame, sizeof(hdr) + len);
+    hdr.count = 0;
+    hdr.seq = 2;
+    memcpy(frame, &hdr, sizeof(hdr));
+    len = ws_stream_telemetry_encode(frame + sizeof(hdr), &b, &a);
+    send_frame(s.fd, 0x02, frame, sizeof(hdr) + len);
+    bool ok = s.pumpUntil([&]() { return streams == 3; });
+
+    if (ok && decoded == 2 && memcmp(&got, &b, sizeof(b)) == 0) {
+        PASS();
+    } else {
+        FAIL("telemetry not decoded");
+    }
+}
+
+void test_connection_lost() {
+    TEST("Callbacks still waiting run with nullptr when the daemon goes");
+
+    Session s;
+    if (!s.open()) {
+        FAIL("handshake failed");
+        return;
+    }
+
+    bool reply_null = false;
+    bool ack_null = false;
+    WsPoseEntry entry = {};
+    s.client.command("{\"cmd\":\"status\"}", [&](const char* json, size_t) { reply_null = !json; });
+    s.client.sendPoses(&entry, 1, 0, [&](const WsPoseAck* ack) { ack_null = !ack; });
+    s.pumpUntil([&]() { return !s.client.wantsWrite(); });
+    close(s.fd);
+    s.fd = -1;
+    s.pumpUntil([&]() { return !s.client.connected(); });
+
+    if (reply_null && ack_null && !s.client.connected() && s.client.pump() == -1 &&
+        s.client.command("{\"cmd\":\"status\"}") == 0 && strlen(s.client.lastError()) > 0) {
+        PASS();
+    } else {
+        FAIL("pending work not settled");
+    }
+}
+
+void test_teleop() {
+    TEST("Teleop datagrams pass the daemon's checks; its status comes back");
+
+    static const uint8_t KEY[] = "correct horse battery staple";
+    UdpTeleop daemon;
+    daemon.setKey(KEY, sizeof(KEY) - 1);
+    sockaddr_in addr = {};
+    socklen_t addr_len = sizeof(addr);
+    bool ok = daemon.open(0) && getsockname(daemon.getFd(), (sockaddr*)&addr, &addr_len) == 0;
+
+    SpiderTeleop teleop;
+    ok = ok && teleop.open("127.0.0.1", ntohs(addr.sin_port), KEY, sizeof(KEY) - 1);
+    ok = ok && teleop.walk(0.5f, -0.25f, 1.0f, 2.0f, UDP_TELEOP_GAIT_WAVE) && teleop.walk(0.6f, 0.0f);
+
+    UdpTeleop::Latest latest;
+    int accepted = 0;
+    uint64_t deadline = timebase_millis64() + 1000;
+    while (ok && accepted < 2 && timebase_millis64() < deadline) {
+        accepted += daemon.drain(timebase_millis(), latest);
+    }
+    ok = ok && accepted == 2 && latest.walk && latest.walk_hdr.seq == 2 && latest.walk_msg.dir == 600 &&
+         latest.walk_hdr.session == teleop.session();
+
+    UdpTeleopStatus status = {};
+    status.x_mm = 1234;
+    ok = ok && daemon.sendStatus(latest.last, status);
+    int got = 0;
+    deadline = timebase_millis64() + 1000;
+    while (ok && got == 0 && timebase_millis64() < deadline) {
+        got = teleop.pollStatus();
+    }
+
+    if (ok && got == 1 && teleop.hasStatus() && teleop.status().x_mm == 1234 && teleop.statusSeq() == 2) {
+        PASS();
+    } else {
+        FAIL("teleop exchange failed");
+    }
+}
+
+int main() {
+    printf("=== libspider Client Tests ===\n");
+
+    test_pipelined_commands();
+    test_pose_acks();
+    test_telemetry_stream();
+    test_connection_lost();
+    test_teleop();
+
+    printf("\nResults: %d passed, %d failed\n", tests_passed, tests_failed);
+    return tests_failed > 0 ? 1 : 0;
+}
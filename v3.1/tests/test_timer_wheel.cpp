@@ -0,0 +1,190 @@
+/**
+ * TimerWheel Unit Tests
+ *
+ * The wheel is driven with made-up times, so nothing here sleeps.
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include "timer_wheel.h"
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST(name) printf("  %s: ", name)
+#define PASS() do { printf("PASS\n"); tests_passed++; } while(0)
+#define FAIL(msg) do { printf("FAIL - %s\n", msg); tests_failed++; } while(0)
+
+void test_periodic() {
+    TEST("Periodic jobs run on their multiples, across level boundaries");
+
+    TimerWheel wheel(0);
+    int runs[3] = {};
+    bool on_time = true;
+    const uint32_t periods[3] = { 10, 64, 1000 };
+    for (int i = 0; i < 3; i++) {
+        wheel.add("job", periods[i], [&, i]() {
+            runs[i]++;
+            on_time = on_time && wheel.now() == (uint64_t)runs[i] * periods[i];
+        });
+    }
+    for (uint64_t t = 1; t <= 5000; t++) {
+        wheel.advance(t);
+    }
+
+    const TimerWheel::Stats* s = wheel.stats(2);
+    if (on_time && runs[0] == 500 && runs[1] == 78 && runs[2] == 5 &&
+        s && s->runs == 5 && s->late_max_ms == 0 && s->missed == 0) {
+        PASS();
+    } else {
+        printf("(runs %d %d %d) ", runs[0], runs[1], runs[2]);
+        FAIL("wrong schedule");
+    }
+}
+
+void test_late() {
+    TEST("A late job runs once, counts what it missed and keeps its phase");
+
+    TimerWheel wheel(1000);
+    std::vector<uint64_t> at;
+    int id = wheel.add("late", 100, [&]() { at.push_back(wheel.now()); });
+
+    wheel.advance(1100);
+    wheel.advance(2050);        // 1200..2000 due: one run, 850 ms late
+    wheel.advance(2100);
+
+    const TimerWheel::Stats* s = wheel.stats(id);
+    if (at.size() == 3 && at[0] == 1100 && at[1] == 2050 && at[2] == 2100 &&
+        s->missed == 8 && s->late_max_ms == 850 && s->late_total_ms == 850) {
+        PASS();
+    } else {
+        FAIL("late run mishandled");
+    }
+}
+
+void test_next_deadline() {
+    TEST("nextDeadline() is exact, near and past the top level");
+
+    TimerWheel wheel(123);
+    bool ok = wheel.nextDeadline() == UINT64_MAX;
+    uint64_t fired = 0;
+    const uint64_t far = 123 + 10ULL * 3600 * 1000;     // Past the top level
+    wheel.add("near", 30, [&]() { fired = wheel.now(); });
+    ok = ok && wheel.nextDeadline() == 153;
+    wheel.advance(153);
+    wheel.setInterval(0, 0);
+
+    int id = wheel.add("far", (uint32_t)(far - 153), [&]() { fired = wheel.now(); });
+    ok = ok && wheel.nextDeadline() == far;
+    wheel.advance(far - 1);
+    ok = ok && fired == 153 && wheel.nextDeadline() == far;
+    wheel.advance(far);
+    wheel.remove(id);
+
+    if (ok && fired == far && wheel.nextDeadline() == UINT64_MAX && wheel.stats(id) == nullptr) {
+        PASS();
+    } else {
+        FAIL("wrong deadline");
+    }
+}
+
+void test_reentry() {
+    TEST("Jobs may disarm, re-arm and add jobs while running");
+
+    TimerWheel wheel(0);
+    int runs[2] = {};
+    int ids[2];
+    int c = -1;
+    // Both due at 50; whichever runs first disarms the other
+    for (int i = 0; i < 2; i++) {
+        ids[i] = wheel.add("pair", 50, [&, i]() {
+            runs[i]++;
+            wheel.setInterval(ids[1 - i], 0);
+            wheel.setInterval(ids[i], 20);      // Itself, from now
+            if (c < 0) {
+                c = wheel.add("c", 5, []() {});
+            }
+        });
+    }
+
+    wheel.advance(50);
+    wheel.advance(55);
+    wheel.advance(70);      // c 10 ms late: one run, two dropped
+
+    const TimerWheel::Stats* cs = wheel.stats(c);
+    if (runs[0] + runs[1] == 2 && (runs[0] == 0 || runs[1] == 0) && cs && cs->runs == 2 && cs->missed == 2) {
+        PASS();
+    } else {
+        printf("(runs %d %d) ", runs[0], runs[1]);
+        FAIL("re-entry mishandled");
+    }
+}
+
+void test_against_reference() {
+    TEST("Random periods and steps match a brute-force schedule");
+
+    const int JOBS = 24;
+    TimerWheel wheel(77777);
+    uint64_t next_due[JOBS];
+    uint32_t period[JOBS];
+    int runs[JOBS] = {};
+    int expect[JOBS] = {};
+    bool order_ok = true;
+    uint64_t last_deadline = 0;
+
+    srand(42);
+    for (int i = 0; i < JOBS; i++) {
+        period[i] = 1 + (uint32_t)(rand() % 7000);
+        next_due[i] = 77777 + period[i];
+        wheel.add("job", period[i], [&, i]() {
+            runs[i]++;
+            // Deadline order within one advance()
+            order_ok = order_ok && next_due[i] >= last_deadline;
+            last_deadline = next_due[i];
+        });
+    }
+
+    uint64_t now = 77777;
+    for (int step = 0; step < 4000; step++) {
+        now += (uint64_t)(rand() % 97);
+        last_deadline = 0;
+        // Reference: a due job runs once and its next deadline skips past now
+        for (int i = 0; i < JOBS; i++) {
+            if (next_due[i] <= now) {
+                expect[i]++;
+            }
+        }
+        wheel.advance(now);
+        for (int i = 0; i < JOBS; i++) {
+            while (next_due[i] <= now) {
+                next_due[i] += period[i];
+            }
+        }
+    }
+
+    bool ok = order_ok;
+    for (int i = 0; i < JOBS; i++) {
+        ok = ok && runs[i] == expect[i];
+    }
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("schedule differs");
+    }
+}
+
+int main() {
+    printf("=== TimerWheel Tests ===\n");
+
+    test_periodic();
+    test_late();
+    test_next_deadline();
+    test_reentry();
+    test_against_reference();
+
+    printf("\nResults: %d passed, %d failed\n", tests_passed, tests_failed);
+    return tests_failed > 0 ? 1 : 0;
+}
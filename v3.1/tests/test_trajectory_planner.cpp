@@ -0,0 +1,245 @@
+/**
+ * Trajectory Planner Unit Tests
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+
+#include "trajectory_planner.h"
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST(name) printf("  %s: ", name)
+#define PASS() do { printf("PASS\n"); tests_passed++; } while(0)
+#define FAIL(msg) do { printf("FAIL - %s\n", msg); tests_failed++; } while(0)
+
+static const uint16_t MASK_ALL = (uint16_t)((1u << SERVO_COUNT_TOTAL) - 1);
+
+struct Sample {
+    uint32_t t_ms;
+    uint16_t us[SERVO_COUNT_TOTAL];
+};
+
+static std::vector<Sample> run(TrajectoryPlanner& planner, const uint16_t* from) {
+    std::vector<Sample> out;
+    Sample s;
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) s.us[i] = from[i];
+    while (out.size() < 10000 && planner.next(s.us, s.t_ms)) out.push_back(s);
+    return out;
+}
+
+static void fill(uint16_t* us, uint16_t value) {
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) us[i] = value;
+}
+
+void test_limits_respected() {
+    TEST("Sampled velocity stays within the joint limit");
+
+    uint16_t from[SERVO_COUNT_TOTAL], to[SERVO_COUNT_TOTAL];
+    fill(from, 1500);
+    fill(to, 1500);
+    to[0] = 2400;
+    to[3] = 900;
+    to[12] = 1550;
+
+    for (int p = 0; p < 2; p++) {
+        TrajectoryPlanner planner;
+        TrajectoryPlanner::Profile profile =
+            p ? TrajectoryPlanner::Profile::SCURVE : TrajectoryPlanner::Profile::TRAPEZOID;
+        planner.start(from, to, MASK_ALL, 0, profile);
+        std::vector<Sample> samples = run(planner, from);
+
+        // Average speed over a keyframe, plus rounding of both ends
+        float worst = 0.0f;
+        uint16_t prev[SERVO_COUNT_TOTAL];
+        for (int i = 0; i < SERVO_COUNT_TOTAL; i++) prev[i] = from[i];
+        for (const Sample& s : samples) {
+            for (int i = 0; i < SERVO_COUNT_TOTAL; i++) {
+                float d = std::fabs((float)s.us[i] - (float)prev[i]) - 1.0f;
+                float v = (d > 0.0f) ? d * 1000.0f / (float)s.t_ms : 0.0f;
+                if (v > worst) worst = v;
+                prev[i] = s.us[i];
+            }
+        }
+        if (worst > SERVO_VEL_MAX_US_PER_S * 1.01f) {
+            printf("(%s %g us/s) ", TrajectoryPlanner::profileName(profile), worst);
+            FAIL("too fast");
+            return;
+        }
+    }
+    PASS();
+}
+
+void test_acceleration_limit() {
+    TEST("Profile acceleration stays within the joint limit");
+
+    uint16_t from[SERVO_COUNT_TOTAL], to[SERVO_COUNT_TOTAL];
+    fill(from, 1500);
+    fill(to, 1500);
+    to[5] = 600;
+    to[6] = 1600;
+
+    for (int p = 0; p < 2; p++) {
+        TrajectoryPlanner planner;
+        TrajectoryPlanner::Profile profile =
+            p ? TrajectoryPlanner::Profile::SCURVE : TrajectoryPlanner::Profile::TRAPEZOID;
+        float dur = planner.start(from, to, MASK_ALL, 0, profile) / 1000.0f;
+
+        // Central differences of progress() on a fine grid, scaled to the largest move
+        const int steps = 200;      // Coarse enough that float rounding stays well below the limit
+        float h = 1.0f / steps;
+        float worst = 0.0f;
+        for (int k = 1; k < steps; k++) {
+            float tau = k * h;
+            float acc = (planner.progress(tau + h) - 2.0f * planner.progress(tau) +
+                         planner.progress(tau - h)) / (h * h);
+            acc = std::fabs(acc) * 900.0f / (dur * dur);
+            if (acc > worst) worst = acc;
+        }
+        if (worst > SERVO_ACC_MAX_US_PER_S2 * 1.02f) {
+            printf("(%s %g us/s^2) ", TrajectoryPlanner::profileName(profile), worst);
+            FAIL("too much acceleration");
+            return;
+        }
+    }
+    PASS();
+}
+
+void test_synchronized_arrival() {
+    TEST("All joints start and arrive together, exactly on target");
+
+    uint16_t from[SERVO_COUNT_TOTAL], to[SERVO_COUNT_TOTAL];
+    fill(from, 1500);
+    fill(to, 1500);
+    to[1] = 2000;
+    to[2] = 1450;
+    to[7] = 1000;
+
+    TrajectoryPlanner planner;
+    uint32_t duration = planner.start(from, to, MASK_ALL, 0,
+                                      TrajectoryPlanner::Profile::TRAPEZOID);
+    std::vector<Sample> samples = run(planner, from);
+
+    uint32_t total = 0;
+    bool ok = samples.size() > 2;
+    for (const Sample& s : samples) total += s.t_ms;
+    ok = ok && total == duration && !planner.active();
+
+    // Every joint covers the same fraction of its move at each sample
+    for (size_t k = 0; ok && k + 1 < samples.size(); k++) {
+        float f1 = (samples[k].us[1] - 1500.0f) / 500.0f;
+        float f7 = (1500.0f - samples[k].us[7]) / 500.0f;
+        ok = std::fabs(f1 - f7) < 0.005f;
+    }
+
+    const Sample& last = samples.back();
+    for (int i = 0; ok && i < SERVO_COUNT_TOTAL; i++) ok = last.us[i] == to[i];
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("joints out of step or target missed");
+    }
+}
+
+void test_min_duration() {
+    TEST("Requested duration is a minimum");
+
+    uint16_t from[SERVO_COUNT_TOTAL], to[SERVO_COUNT_TOTAL];
+    fill(from, 1500);
+    fill(to, 1500);
+    to[0] = 1520;
+
+    TrajectoryPlanner planner;
+    uint32_t slow = planner.start(from, to, MASK_ALL, 800, TrajectoryPlanner::Profile::SCURVE);
+    uint32_t fast = planner.start(from, to, MASK_ALL, 0, TrajectoryPlanner::Profile::SCURVE);
+
+    to[0] = 2500;
+    uint32_t stretched = planner.start(from, to, MASK_ALL, 100,
+                                       TrajectoryPlanner::Profile::TRAPEZOID);
+
+    // 1000 us at 2000 us/s and 10000 us/s^2 needs at least 0.7 s
+    if (slow == 800 && fast < 200 && stretched >= 700) {
+        PASS();
+    } else {
+        printf("(slow=%u fast=%u stretched=%u) ", slow, fast, stretched);
+        FAIL("wrong duration");
+    }
+}
+
+void test_scurve_smooth() {
+    TEST("S-curve velocity starts and ends at zero and is continuous");
+
+    uint16_t from[SERVO_COUNT_TOTAL], to[SERVO_COUNT_TOTAL];
+    fill(from, 1000);
+    fill(to, 2000);
+
+    TrajectoryPlanner planner;
+    planner.start(from, to, MASK_ALL, 0, TrajectoryPlanner::Profile::SCURVE);
+
+    const float h = 1e-3f;
+    float v0 = planner.progress(h) / h;
+    float v1 = (1.0f - planner.progress(1.0f - h)) / h;
+    float worst_jump = 0.0f;
+    float prev_v = 0.0f;
+    bool monotonic = true;
+    for (int k = 1; k <= 1000; k++) {
+        float tau = k * h;
+        float v = (planner.progress(tau) - planner.progress(tau - h)) / h;
+        if (k > 1 && std::fabs(v - prev_v) > worst_jump) worst_jump = std::fabs(v - prev_v);
+        if (v < -1e-3f) monotonic = false;
+        prev_v = v;
+    }
+
+    if (v0 < 0.05f && v1 < 0.05f && worst_jump < 0.05f && monotonic) {
+        PASS();
+    } else {
+        printf("(v0=%g v1=%g jump=%g) ", v0, v1, worst_jump);
+        FAIL("velocity not smooth");
+    }
+}
+
+void test_profile_names() {
+    TEST("Profile names round-trip and masked-off channels are untouched");
+
+    TrajectoryPlanner::Profile p;
+    bool ok = TrajectoryPlanner::parseProfile("scurve", p) && p == TrajectoryPlanner::Profile::SCURVE &&
+              TrajectoryPlanner::parseProfile("linear", p) && p == TrajectoryPlanner::Profile::NONE &&
+              !TrajectoryPlanner::parseProfile("cubic", p);
+
+    uint16_t from[SERVO_COUNT_TOTAL], to[SERVO_COUNT_TOTAL];
+    fill(from, 1500);
+    fill(to, 2000);
+    TrajectoryPlanner planner;
+    planner.start(from, to, 0x0001, 0, TrajectoryPlanner::Profile::TRAPEZOID);
+    ok = ok && planner.mask() == 0x0001;
+
+    uint16_t us[SERVO_COUNT_TOTAL];
+    fill(us, 1234);
+    uint32_t t_ms;
+    while (planner.next(us, t_ms)) {}
+    ok = ok && us[0] == 2000 && us[1] == 1234 && planner.mask() == 0;
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("parse or mask handling wrong");
+    }
+}
+
+int main() {
+    printf("=== Trajectory Planner Tests ===\n");
+
+    test_limits_respected();
+    test_acceleration_limit();
+    test_synchronized_arrival();
+    test_min_duration();
+    test_scurve_smooth();
+    test_profile_names();
+
+    printf("\nResults: %d passed, %d failed\n", tests_passed, tests_failed);
+    return tests_failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,159 @@
+/**
+ * Runtime Tunables Unit Tests
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+
+#include "tunables.h"
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST(name) printf("  %s: ", name)
+#define PASS() do { printf("PASS\n"); tests_passed++; } while(0)
+#define FAIL(msg) do { printf("FAIL - %s\n", msg); tests_failed++; } while(0)
+
+// Stand-in for the 256KB reserved region
+static uint8_t g_region[SHARED_MEM_SIZE] __attribute__((aligned(64)));
+
+static bool parse(const char* text, Tunables& t, int* bad_line = nullptr) {
+    return Tunables::parse(text, strlen(text), t, bad_line);
+}
+
+void test_defaults() {
+    TEST("Defaults are the build-time constants");
+
+    Tunables t;
+    SharedTunablesData d = t.muscleData();
+    SharedTunablesData ref;
+    shared_tunables_defaults(&ref);
+
+    Tunables::Id id;
+    bool ok = memcmp(&d, &ref, sizeof(d)) == 0 && d.output_hz == MOTION_UPDATE_HZ &&
+              d.heartbeat_timeout_ms == HEARTBEAT_TIMEOUT_MS;
+    ok = ok && Tunables::find("scan_step_deg", id) && id == Tunables::SCAN_STEP_DEG &&
+         !Tunables::find("no_such_tunable", id);
+    for (int i = 0; ok && i < Tunables::COUNT; i++) {
+        const Tunables::Info& info = Tunables::info((Tunables::Id)i);
+        ok = info.min <= info.def && info.def <= info.max;
+    }
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("wrong defaults");
+    }
+}
+
+void test_set() {
+    TEST("Ranges and orderings are enforced, several values checked together");
+
+    Tunables t;
+    bool ok = t.set(Tunables::OUTPUT_HZ, 40) && t.get(Tunables::OUTPUT_HZ) == 40;
+    ok = ok && !t.set(Tunables::OUTPUT_HZ, TUNABLE_OUTPUT_HZ_MAX + 1) && t.get(Tunables::OUTPUT_HZ) == 40;
+    ok = ok && !t.set(Tunables::HEARTBEAT_MS, TUNABLE_HEARTBEAT_MS_MIN - 1);
+
+    // critical past warning alone breaks the ordering; raised together it holds
+    ok = ok && !t.set(Tunables::AVOID_CRITICAL_MM, 300) && t.get(Tunables::AVOID_CRITICAL_MM) == 120;
+    Tunables::Id ids[] = { Tunables::AVOID_CRITICAL_MM, Tunables::AVOID_WARNING_MM, Tunables::AVOID_SAFE_MM };
+    int32_t values[] = { 300, 500, 900 };
+    ok = ok && t.set(ids, values, 3) && t.get(Tunables::AVOID_SAFE_MM) == 900;
+    ok = ok && !t.set(Tunables::SCAN_MIN_DEG, t.get(Tunables::SCAN_MAX_DEG));
+
+    Tunables base;
+    ok = ok && t.muscleDiffers(base);
+    t.set(Tunables::OUTPUT_HZ, MOTION_UPDATE_HZ);
+    ok = ok && !t.muscleDiffers(base);
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("bad value accepted or good one refused");
+    }
+}
+
+void test_parse() {
+    TEST("Files parse over the current set; a bad line changes nothing");
+
+    Tunables t;
+    int bad = -1;
+    bool ok = parse("# tuning\n"
+                    "output_hz = 40\n"
+                    "\n"
+                    "  heartbeat_timeout_ms=0x190   # 400 ms\r\n"
+                    "avoid_critical_mm = 300\n"
+                    "avoid_warning_mm = 350\n", t);
+    ok = ok && t.get(Tunables::OUTPUT_HZ) == 40 && t.get(Tunables::HEARTBEAT_MS) == 400 &&
+         t.get(Tunables::AVOID_CRITICAL_MM) == 300 && t.get(Tunables::INTERP_SUBSTEPS) == TUNABLE_INTERP_SUBSTEPS_DEFAULT;
+
+    ok = ok && !parse("output_hz = 30\nbogus = 1\n", t, &bad) && bad == 2 &&
+         t.get(Tunables::OUTPUT_HZ) == 40;
+    ok = ok && !parse("output_hz = 30x\n", t, &bad) && bad == 1;
+    ok = ok && !parse("output_hz\n", t, &bad) && bad == 1;
+    ok = ok && !parse("scan_min_deg = 170\n", t, &bad) && bad == 0;
+    ok = ok && !Tunables::load("/tmp/missing_tunables.conf", t);
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("parse result wrong");
+    }
+}
+
+void test_shared_round_trip() {
+    TEST("Published sets are seen once per generation and clamped on take");
+
+    memset(g_region, 0, sizeof(g_region));
+    volatile SharedTunables* area = shared_tunables_area(g_region);
+    SharedTunablesData d;
+    shared_tunables_defaults(&d);
+    shared_tunables_init(area, &d);
+
+    uint32_t seen = 0;
+    SharedTunablesData got{};
+    SharedTunablesApplied applied;
+    bool ok = !shared_tunables_poll(area, &seen, &got);
+    ok = ok && shared_tunables_read_applied(area, &applied) && applied.generation == 0 &&
+         applied.data.output_hz == MOTION_UPDATE_HZ;
+
+    d.output_hz = 500;
+    uint32_t gen = shared_tunables_publish(area, &d);
+    ok = ok && gen == 2 && shared_tunables_poll(area, &seen, &got) && seen == gen &&
+         !shared_tunables_poll(area, &seen, &got);
+    uint32_t clamped = 0;
+    if (ok) {
+        clamped = shared_tunables_clamp(&got);
+        ok = clamped == TUNABLE_BIT_OUTPUT_HZ && got.output_hz == TUNABLE_OUTPUT_HZ_MAX;
+        shared_tunables_report(area, gen, &got, clamped);
+    }
+    ok = ok && shared_tunables_read_applied(area, &applied) && applied.generation == gen &&
+         applied.applies == 1 && applied.clamped == clamped && applied.data.output_hz == TUNABLE_OUTPUT_HZ_MAX;
+
+    // Mid-write (odd generation) is left for the next poll
+    area->request.generation = gen + 1;
+    ok = ok && !shared_tunables_poll(area, &seen, &got);
+    ok = ok && shared_tunables_publish(area, &d) == gen + 2 && shared_tunables_poll(area, &seen, &got);
+
+    // A restarted Brain carries on from the generation in the area
+    ok = ok && shared_tunables_publish(area, &d) > seen;
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("generation handshake broken");
+    }
+}
+
+int main() {
+    printf("=== Tunables Tests ===\n");
+
+    test_defaults();
+    test_set();
+    test_parse();
+    test_shared_round_trip();
+
+    printf("\nResults: %d passed, %d failed\n", tests_passed, tests_failed);
+    return tests_failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,234 @@
+/**
+ * UDP Teleop Unit Tests
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+#include "udp_teleop.h"
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST(name) printf("  %s: ", name)
+#define PASS() do { printf("PASS\n"); tests_passed++; } while(0)
+#define FAIL(msg) do { printf("FAIL - %s\n", msg); tests_failed++; } while(0)
+
+static const uint8_t KEY[] = "correct horse battery staple";
+
+static void keyed(UdpTeleop& udp) {
+    udp.setKey(KEY, sizeof(KEY) - 1);
+}
+
+static size_t walk(const UdpTeleop& udp, uint8_t* out, uint32_t session, uint32_t seq,
+                   uint32_t sent_ms, int16_t dir = 500) {
+    UdpTeleopHeader hdr = { UDP_TELEOP_MAGIC, UDP_TELEOP_MSG_WALK, UDP_TELEOP_VERSION, 0, session, seq, sent_ms };
+    UdpTeleopWalk w = {};
+    w.dir = dir;
+    w.speed = 1000;
+    w.stride = 1000;
+    return udp.seal(hdr, &w, sizeof(w), out);
+}
+
+void test_hmac() {
+    TEST("Tag is HMAC-SHA1 (RFC 2202 case 2)");
+
+    // HMAC-SHA1("Jefe", "what do ya want for nothing?") = effcdf6ae5eb2fa2...
+    UdpTeleop udp;
+    udp.setKey((const uint8_t*)"Jefe", 4);
+    const char* text = "what do ya want for nothing?";
+    UdpTeleopHeader hdr;
+    memcpy(&hdr, text, sizeof(hdr));
+    uint8_t out[UDP_TELEOP_DATAGRAM_MAX];
+    size_t len = udp.seal(hdr, text + sizeof(hdr), strlen(text) - sizeof(hdr), out);
+    const uint8_t expect[UDP_TELEOP_TAG_LEN] = { 0xef, 0xfc, 0xdf, 0x6a, 0xe5, 0xeb, 0x2f, 0xa2 };
+
+    if (len == strlen(text) + UDP_TELEOP_TAG_LEN &&
+        memcmp(out + strlen(text), expect, sizeof(expect)) == 0) {
+        PASS();
+    } else {
+        FAIL("wrong tag");
+    }
+}
+
+void test_accept_and_tamper() {
+    TEST("Valid datagrams pass; bad tag, key, length or header do not");
+
+    UdpTeleop udp, other;
+    keyed(udp);
+    other.setKey((const uint8_t*)"wrong", 5);
+    UdpTeleop::Latest latest;
+    uint8_t buf[UDP_TELEOP_DATAGRAM_MAX];
+
+    size_t len = walk(udp, buf, 7, 1, 1000);
+    bool ok = udp.accept(buf, len, 1000, latest) == UdpTeleop::Verdict::ACCEPTED &&
+              latest.walk && latest.walk_msg.dir == 500 && latest.last.seq == 1;
+
+    len = walk(udp, buf, 7, 2, 1010);
+    buf[17] ^= 1;
+    ok = ok && udp.accept(buf, len, 1010, latest) == UdpTeleop::Verdict::BAD_TAG;
+    len = walk(other, buf, 7, 3, 1010);
+    ok = ok && udp.accept(buf, len, 1010, latest) == UdpTeleop::Verdict::BAD_TAG;
+    len = walk(udp, buf, 7, 4, 1010);
+    ok = ok && udp.accept(buf, len - 1, 1010, latest) == UdpTeleop::Verdict::MALFORMED;
+    len = walk(udp, buf, 0, 4, 1010);
+    ok = ok && udp.accept(buf, len, 1010, latest) == UdpTeleop::Verdict::MALFORMED;
+
+    const UdpTeleop::Stats& s = udp.stats();
+    if (ok && s.accepted == 1 && s.bad_tag == 2 && s.malformed == 2) {
+        PASS();
+    } else {
+        FAIL("verdict mismatch");
+    }
+}
+
+void test_order_and_latest() {
+    TEST("Old and repeated seqs drop; the newest of a burst wins");
+
+    UdpTeleop udp;
+    keyed(udp);
+    UdpTeleop::Latest latest;
+    uint8_t buf[UDP_TELEOP_DATAGRAM_MAX];
+
+    size_t len = walk(udp, buf, 9, 10, 0, 100);
+    bool ok = udp.accept(buf, len, 50, latest) == UdpTeleop::Verdict::ACCEPTED;
+    ok = ok && udp.accept(buf, len, 60, latest) == UdpTeleop::Verdict::OUT_OF_ORDER;
+    len = walk(udp, buf, 9, 12, 20, 300);
+    ok = ok && udp.accept(buf, len, 70, latest) == UdpTeleop::Verdict::ACCEPTED;
+    len = walk(udp, buf, 9, 11, 10, 200);
+    ok = ok && udp.accept(buf, len, 71, latest) == UdpTeleop::Verdict::OUT_OF_ORDER;
+
+    if (ok && latest.walk_msg.dir == 300 && udp.stats().superseded == 1 && udp.dropped() == 2) {
+        PASS();
+    } else {
+        FAIL("reordered datagram taken");
+    }
+}
+
+void test_stale() {
+    TEST("Datagrams held up past the age limit drop, clocks need not agree");
+
+    UdpTeleop udp;
+    keyed(udp);
+    UdpTeleop::Latest latest;
+    uint8_t buf[UDP_TELEOP_DATAGRAM_MAX];
+
+    // Sender clock 1e6 ms ahead and about to wrap: only transit differences count
+    uint32_t base = 0xFFFFFF00u;
+    size_t len = walk(udp, buf, 3, 1, base, 0);
+    bool ok = udp.accept(buf, len, 5000, latest) == UdpTeleop::Verdict::ACCEPTED;
+    len = walk(udp, buf, 3, 2, base + 100);
+    ok = ok && udp.accept(buf, len, 5100 + UDP_TELEOP_MAX_AGE_MS, latest) == UdpTeleop::Verdict::ACCEPTED;
+    len = walk(udp, buf, 3, 3, base + 200);
+    ok = ok && udp.accept(buf, len, 5201 + UDP_TELEOP_MAX_AGE_MS, latest) == UdpTeleop::Verdict::STALE;
+    // A quicker one lowers the baseline
+    len = walk(udp, buf, 3, 4, base + 300);
+    ok = ok && udp.accept(buf, len, 5290, latest) == UdpTeleop::Verdict::ACCEPTED;
+    len = walk(udp, buf, 3, 5, base + 400);
+    ok = ok && udp.accept(buf, len, 5391 + UDP_TELEOP_MAX_AGE_MS, latest) == UdpTeleop::Verdict::STALE;
+
+    if (ok && udp.stats().stale == 2) {
+        PASS();
+    } else {
+        FAIL("age check wrong");
+    }
+}
+
+void test_sessions() {
+    TEST("A new session waits out the active one; ended sessions stay ended");
+
+    UdpTeleop udp;
+    keyed(udp);
+    UdpTeleop::Latest latest;
+    uint8_t buf[UDP_TELEOP_DATAGRAM_MAX];
+    uint8_t old[UDP_TELEOP_DATAGRAM_MAX];
+
+    size_t old_len = walk(udp, old, 1, 1, 0);
+    bool ok = udp.accept(old, old_len, 0, latest) == UdpTeleop::Verdict::ACCEPTED;
+    size_t len = walk(udp, buf, 2, 1, 0);
+    ok = ok && udp.accept(buf, len, 100, latest) == UdpTeleop::Verdict::BUSY;
+    ok = ok && udp.silentMs(100) == 100;
+    ok = ok && udp.accept(buf, len, UDP_TELEOP_DEADMAN_MS, latest) == UdpTeleop::Verdict::ACCEPTED;
+    // Replaying session 1 after session 2 goes quiet
+    ok = ok && udp.accept(old, old_len, 3 * UDP_TELEOP_DEADMAN_MS, latest) == UdpTeleop::Verdict::OUT_OF_ORDER;
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("session handover wrong");
+    }
+}
+
+void test_socket_drain() {
+    TEST("drain() takes a queued burst at once and answers the sender");
+
+    UdpTeleop udp;
+    keyed(udp);
+    uint16_t port = 0;
+    for (uint16_t p = 47000; p < 47100 && port == 0; p++) {
+        if (udp.open(p)) port = p;
+    }
+    int tx = socket(AF_INET, SOCK_DGRAM, 0);
+    if (port == 0 || tx < 0) {
+        FAIL("no socket");
+        if (tx >= 0) close(tx);
+        return;
+    }
+    struct sockaddr_in to = {};
+    to.sin_family = AF_INET;
+    to.sin_port = htons(port);
+    to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    uint8_t buf[UDP_TELEOP_DATAGRAM_MAX];
+    for (uint32_t seq = 1; seq <= UDP_TELEOP_BATCH + 4; seq++) {
+        size_t len = walk(udp, buf, 5, seq, seq, (int16_t)seq);
+        sendto(tx, buf, len, 0, (struct sockaddr*)&to, sizeof(to));
+    }
+    usleep(20000);
+
+    UdpTeleop::Latest latest;
+    int n = udp.drain(100, latest);
+    UdpTeleopStatus status = {};
+    status.pose_seq = 42;
+    bool sent = udp.sendStatus(latest.last, status);
+
+    uint8_t reply[UDP_TELEOP_DATAGRAM_MAX];
+    usleep(20000);
+    ssize_t got = recv(tx, reply, sizeof(reply), MSG_DONTWAIT);
+    UdpTeleopHeader hdr;
+    UdpTeleopStatus back;
+    memcpy(&hdr, reply, sizeof(hdr));
+    memcpy(&back, reply + sizeof(hdr), sizeof(back));
+    uint8_t check[UDP_TELEOP_DATAGRAM_MAX];
+    size_t check_len = udp.seal(hdr, &back, sizeof(back), check);
+    close(tx);
+
+    bool ok = n == UDP_TELEOP_BATCH + 4 && latest.walk_msg.dir == UDP_TELEOP_BATCH + 4 &&
+              udp.stats().superseded == UDP_TELEOP_BATCH + 3 && sent &&
+              got == (ssize_t)check_len && memcmp(reply, check, check_len) == 0 &&
+              hdr.msg == UDP_TELEOP_MSG_STATUS && hdr.seq == UDP_TELEOP_BATCH + 4 && back.pose_seq == 42;
+    if (ok) {
+        PASS();
+    } else {
+        printf("(n %d got %zd) ", n, got);
+        FAIL("burst not drained");
+    }
+}
+
+int main() {
+    printf("=== UDP Teleop Tests ===\n");
+
+    test_hmac();
+    test_accept_and_tamper();
+    test_order_and_latest();
+    test_stale();
+    test_sessions();
+    test_socket_drain();
+
+    printf("\nResults: %d passed, %d failed\n", tests_passed, tests_failed);
+    return tests_failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,162 @@
+/**
+ * WebSocket permessage-deflate Unit Tests
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "ws_deflate.h"
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST(name) printf("  %s: ", name)
+#define PASS() do { printf("PASS\n"); tests_passed++; } while(0)
+#define FAIL(msg) do { printf("FAIL - %s\n", msg); tests_failed++; } while(0)
+
+static bool negotiate(const char* offers, WsDeflateParams& params, std::string& response) {
+    char buf[128];
+    if (!ws_deflate_negotiate(offers, params, buf, sizeof(buf))) return false;
+    response = buf;
+    return true;
+}
+
+void test_negotiate() {
+    TEST("Offers are accepted, parameters echoed, bad offers skipped");
+
+    WsDeflateParams p;
+    std::string r;
+    // What the vendored Python client sends
+    bool ok = negotiate("permessage-deflate; client_max_window_bits\r\nHost: x\r\n", p, r) &&
+              r == "permessage-deflate" && !p.server_no_context_takeover && p.server_max_window_bits == 15;
+    ok = ok && negotiate("permessage-deflate;server_no_context_takeover; client_no_context_takeover", p, r) &&
+         r == "permessage-deflate; server_no_context_takeover; client_no_context_takeover" &&
+         p.server_no_context_takeover && p.client_no_context_takeover;
+    ok = ok && negotiate("permessage-deflate; server_max_window_bits=\"10\"", p, r) &&
+         r == "permessage-deflate; server_max_window_bits=10" && p.server_max_window_bits == 10;
+
+    // First acceptable offer wins
+    ok = ok && negotiate("x-webkit-deflate-frame, permessage-deflate; server_max_window_bits=8, "
+                         "permessage-deflate; server_max_window_bits=12", p, r) &&
+         p.server_max_window_bits == 12;
+
+    ok = ok && !negotiate("permessage-deflate; mystery", p, r);
+    ok = ok && !negotiate("permessage-deflate; server_no_context_takeover; server_no_context_takeover", p, r);
+    ok = ok && !negotiate("permessage-deflate; client_max_window_bits=16", p, r);
+    ok = ok && !negotiate("permessage-deflate; server_max_window_bits", p, r);
+    ok = ok && !negotiate("\r\n", p, r);
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("negotiation result wrong");
+    }
+}
+
+// A telemetry-like JSON message, slightly different each time
+static std::string sample(int i) {
+    char buf[96];
+    std::string s = "{\"type\":\"telemetry\",\"servos\":[";
+    for (int ch = 0; ch < 18; ch++) {
+        snprintf(buf, sizeof(buf), "%s{\"ch\":%d,\"us\":%d}", ch ? "," : "", ch, 1500 + (ch * 7 + i) % 40);
+        s += buf;
+    }
+    return s + "]}";
+}
+
+void test_round_trip() {
+    TEST("Messages survive the round trip and context takeover pays");
+
+    WsDeflateParams params;
+    WsDeflate server(params, WS_DEFLATE_LEVEL_DEFAULT);
+    WsDeflate client(params, WS_DEFLATE_LEVEL_DEFAULT);
+    std::vector<uint8_t> wire, back;
+
+    bool ok = true;
+    size_t first = 0, later = 0;
+    for (int i = 0; ok && i < 4; i++) {
+        std::string m = sample(i);
+        // Split anywhere: a and b are one message
+        ok = server.compress((const uint8_t*)m.data(), 5, (const uint8_t*)m.data() + 5, m.size() - 5, wire) &&
+             client.decompress(wire.data(), wire.size(), 65536, back) == 0 &&
+             back.size() == m.size() && memcmp(back.data(), m.data(), m.size()) == 0;
+        if (i == 0) first = wire.size();
+        later = wire.size();
+        ok = ok && wire.size() < m.size();
+    }
+    // Later messages lean on the earlier ones
+    ok = ok && later < first / 2;
+
+    // Empty messages are still one deflate block
+    ok = ok && server.compress(nullptr, 0, nullptr, 0, wire) && !wire.empty() &&
+         client.decompress(wire.data(), wire.size(), 65536, back) == 0 && back.empty();
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("round trip broken");
+    }
+}
+
+void test_no_context_takeover() {
+    TEST("Without context takeover each message stands alone");
+
+    WsDeflateParams params;
+    params.server_no_context_takeover = true;
+    WsDeflate server(params, WS_DEFLATE_LEVEL_DEFAULT);
+    std::vector<uint8_t> a, b, back;
+
+    std::string m = sample(0);
+    bool ok = server.compress(nullptr, 0, (const uint8_t*)m.data(), m.size(), a) &&
+              server.compress(nullptr, 0, (const uint8_t*)m.data(), m.size(), b) && a == b;
+
+    // A fresh decompressor, as after a dropped frame, still reads the second
+    WsDeflate reader(WsDeflateParams(), WS_DEFLATE_LEVEL_DEFAULT);
+    ok = ok && reader.decompress(b.data(), b.size(), 65536, back) == 0 &&
+         std::string(back.begin(), back.end()) == m;
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("messages depend on each other");
+    }
+}
+
+void test_limits() {
+    TEST("Oversized and corrupt messages are refused");
+
+    WsDeflateParams params;
+    WsDeflate server(params, 9);
+    std::vector<uint8_t> zeros(100000, 0), wire, back;
+    bool ok = server.compress(nullptr, 0, zeros.data(), zeros.size(), wire) && wire.size() < 1000;
+
+    WsDeflate small(params, 9);
+    ok = ok && small.decompress(wire.data(), wire.size(), 65536, back) == 1009;
+    WsDeflate exact(params, 9);
+    ok = ok && exact.decompress(wire.data(), wire.size(), zeros.size(), back) == 0 && back.size() == zeros.size();
+
+    const uint8_t junk[] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+    WsDeflate bad(params, 9);
+    ok = ok && bad.decompress(junk, sizeof(junk), 65536, back) == 1007;
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("limit not enforced");
+    }
+}
+
+int main() {
+    printf("=== WebSocket Deflate Tests ===\n");
+
+    test_negotiate();
+    test_round_trip();
+    test_no_context_takeover();
+    test_limits();
+
+    printf("\nResults: %d passed, %d failed\n", tests_passed, tests_failed);
+    return tests_failed > 0 ? 1 : 0;
+}
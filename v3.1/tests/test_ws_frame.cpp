@@ -0,0 +1,153 @@
+/**
+ * WebSocket Frame Decoding Unit Tests
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "ws_frame.h"
+#include "ws_rx_buffer.h"
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST(name) printf("  %s: ", name)
+#define PASS() do { printf("PASS\n"); tests_passed++; } while(0)
+#define FAIL(msg) do { printf("FAIL - %s\n", msg); tests_failed++; } while(0)
+
+static const uint8_t MASK[4] = {0x12, 0x34, 0x56, 0x78};
+
+static std::vector<uint8_t> masked_frame(size_t len) {
+    std::vector<uint8_t> f = {0x81};
+    if (len < 126) {
+        f.push_back((uint8_t)(0x80 | len));
+    } else {
+        f.push_back(0x80 | 126);
+        f.push_back((uint8_t)(len >> 8));
+        f.push_back((uint8_t)len);
+    }
+    f.insert(f.end(), MASK, MASK + 4);
+    for (size_t i = 0; i < len; i++) f.push_back((uint8_t)('a' + i % 26) ^ MASK[i % 4]);
+    return f;
+}
+
+void test_header() {
+    TEST("Header lengths and completeness");
+
+    std::vector<uint8_t> small = masked_frame(10);
+    std::vector<uint8_t> big = masked_frame(300);
+    WsFrameHeader a, b, c;
+
+    bool ok = ws_frame_parse(small.data(), small.size(), a) &&
+              a.fin && a.opcode == 1 && a.masked && a.payload_len == 10 && a.header_len == 6;
+    ok = ok && ws_frame_parse(big.data(), big.size(), b) && b.payload_len == 300 && b.header_len == 8;
+
+    // Every truncation must ask for more, and report the size once the header is in
+    for (size_t n = 0; ok && n < big.size(); n++) {
+        ok = !ws_frame_parse(big.data(), n, c) &&
+             (n < 8 ? c.header_len == 0 : c.header_len == 8 && c.payload_len == 300);
+    }
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("wrong header");
+    }
+}
+
+void test_unmask() {
+    TEST("Word-wise unmask matches the byte loop at every length");
+
+    bool ok = true;
+    for (size_t len = 0; ok && len < 80; len++) {
+        std::vector<uint8_t> f = masked_frame(len);
+        WsFrameHeader h;
+        ok = ws_frame_parse(f.data(), f.size(), h);
+        ws_unmask(f.data() + h.header_len, h.payload_len, f.data() + h.header_len - 4);
+        for (size_t i = 0; ok && i < len; i++) {
+            ok = f[h.header_len + i] == (uint8_t)('a' + i % 26);
+        }
+    }
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("payload differs");
+    }
+}
+
+void test_rx_buffer() {
+    TEST("RX cursor compacts only when needed; buffers come from and go back to pools");
+
+    WsBufferPool small_pool;
+    WsBufferPool pool;
+    WsRxBuffer rx;
+    bool ok = rx.capacity() == 0;
+    rx.attach(small_pool);
+    std::vector<uint8_t> small = masked_frame(100);
+    std::vector<uint8_t> big = masked_frame(10000);
+
+    // Pipelined small frames: consumed by cursor, no move while they fit
+    memcpy(rx.tail(), small.data(), small.size());
+    memcpy(rx.tail() + small.size(), small.data(), 50);
+    rx.commit(small.size() + 50);
+    rx.consume(small.size());
+    const uint8_t* partial = rx.data();
+    ok = ok && rx.reserve(small.size(), pool) && rx.data() == partial;
+
+    // A frame that would not fit behind the cursor is moved to the front
+    rx.consume(rx.size());
+    memcpy(rx.tail(), small.data(), small.size());
+    rx.commit(small.size());
+    rx.consume(small.size() - 10);      // 10 bytes left at offset 96
+    memset(rx.tail(), 0, rx.tailSpace());
+    rx.commit(rx.tailSpace() - 4);
+    rx.consume(RX_BUFFER_SIZE - 100);
+    size_t left = rx.size();
+    ok = ok && rx.reserve(RX_BUFFER_SIZE, pool) && rx.data() != partial && rx.size() == left &&
+         rx.tailSpace() == RX_BUFFER_SIZE - left && !rx.isLarge();
+
+    // An oversized frame moves to a pooled buffer with its prefix intact
+    rx.consume(rx.size());
+    memcpy(rx.tail(), big.data(), 100);
+    rx.commit(100);
+    WsFrameHeader h{};
+    ok = ok && !ws_frame_parse(rx.data(), rx.size(), h) && h.header_len == 8 &&
+         rx.reserve(h.header_len + h.payload_len, pool) && rx.isLarge() &&
+         rx.size() == 100 && memcmp(rx.data(), big.data(), 100) == 0;
+    memcpy(rx.tail(), big.data() + 100, big.size() - 100);
+    rx.commit(big.size() - 100);
+    ok = ok && ws_frame_parse(rx.data(), rx.size(), h);
+    if (ok) {
+        rx.consume(h.header_len + h.payload_len);
+    }
+    rx.shrink(pool);
+    ok = ok && !rx.isLarge() && pool.idle() == 1 && rx.capacity() == RX_BUFFER_SIZE;
+
+    ok = ok && !rx.reserve(WS_RX_LARGE_BYTES + 1, pool);
+
+    // A closed connection keeps no buffer; the next one reuses it
+    rx.detach(small_pool, pool);
+    ok = ok && rx.capacity() == 0 && small_pool.idle() == 1;
+    rx.attach(small_pool);
+    ok = ok && rx.capacity() == RX_BUFFER_SIZE && small_pool.idle() == 0;
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("wrong buffer state");
+    }
+}
+
+int main() {
+    printf("=== WebSocket Frame Tests ===\n");
+
+    test_header();
+    test_unmask();
+    test_rx_buffer();
+
+    printf("\nResults: %d passed, %d failed\n", tests_passed, tests_failed);
+    return tests_failed > 0 ? 1 : 0;
+}
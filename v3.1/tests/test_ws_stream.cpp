@@ -0,0 +1,138 @@
+/**
+ * WebSocket Stream Protocol Unit Tests
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+
+extern "C" {
+#include "ws_stream_binary.h"
+}
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST(name) printf("  %s: ", name)
+#define PASS() do { printf("PASS\n"); tests_passed++; } while(0)
+#define FAIL(msg) do { printf("FAIL - %s\n", msg); tests_failed++; } while(0)
+
+static SharedTelemetryData sample_telemetry() {
+    SharedTelemetryData t;
+    memset(&t, 0, sizeof(t));
+    t.time_us = 123456789ULL;
+    t.ticks = 1000;
+    t.rx_count = 42;
+    t.watchdog_state = 1;
+    for (int i = 0; i < SERVO_COUNT_TOTAL; i++) {
+        t.servo_us[i] = (uint16_t)(1500 + i);
+    }
+    return t;
+}
+
+void test_keyframe_roundtrip() {
+    TEST("Keyframe carries every word and decodes");
+
+    SharedTelemetryData t = sample_telemetry();
+    uint8_t body[WS_STREAM_TELEMETRY_MAX];
+    size_t len = ws_stream_telemetry_encode(body, &t, nullptr);
+
+    SharedTelemetryData out;
+    memset(&out, 0xAA, sizeof(out));
+    if (len == WS_STREAM_TELEMETRY_MAX && ws_stream_telemetry_decode(&out, body, len) == 0 &&
+        memcmp(&out, &t, sizeof(t)) == 0) {
+        PASS();
+    } else {
+        FAIL("keyframe mismatch");
+    }
+}
+
+void test_delta_only_changed_words() {
+    TEST("Delta holds only changed words");
+
+    SharedTelemetryData prev = sample_telemetry();
+    SharedTelemetryData cur = prev;
+    cur.ticks += 1;                 // One word (low half)
+    cur.servo_us[3] = 1800;         // One word
+
+    uint8_t body[WS_STREAM_TELEMETRY_MAX];
+    size_t len = ws_stream_telemetry_encode(body, &cur, &prev);
+
+    SharedTelemetryData state = prev;
+    if (len == WS_STREAM_TELEMETRY_MASK_LEN + 2 * 2 && ws_stream_telemetry_decode(&state, body, len) == 0 &&
+        memcmp(&state, &cur, sizeof(cur)) == 0) {
+        PASS();
+    } else {
+        FAIL("wrong delta");
+    }
+}
+
+void test_unchanged_is_mask_only() {
+    TEST("No change encodes to an empty mask");
+
+    SharedTelemetryData t = sample_telemetry();
+    uint8_t body[WS_STREAM_TELEMETRY_MAX];
+    size_t len = ws_stream_telemetry_encode(body, &t, &t);
+    uint64_t mask[WS_STREAM_TELEMETRY_MASKS];
+    memcpy(mask, body, sizeof(mask));
+    bool empty = true;
+    for (uint64_t m : mask) empty = empty && m == 0;
+    if (len == WS_STREAM_TELEMETRY_MASK_LEN && empty) {
+        PASS();
+    } else {
+        FAIL("expected empty delta");
+    }
+}
+
+void test_malformed_rejected() {
+    TEST("Truncated, oversized and out-of-range bodies are rejected");
+
+    SharedTelemetryData t = sample_telemetry();
+    SharedTelemetryData state = t;
+    uint8_t body[WS_STREAM_TELEMETRY_MAX + 2];
+    size_t len = ws_stream_telemetry_encode(body, &t, nullptr);
+
+    bool ok = ws_stream_telemetry_decode(&state, body, 4) == -1;
+    ok = ok && ws_stream_telemetry_decode(&state, body, len - 2) == -1;
+    ok = ok && ws_stream_telemetry_decode(&state, body, len + 2) == -1;
+
+    // A mask bit past the last word
+    uint64_t bad[WS_STREAM_TELEMETRY_MASKS] = {};
+    bad[WS_STREAM_TELEMETRY_WORDS / 64] = 1ULL << (WS_STREAM_TELEMETRY_WORDS % 64);
+    memcpy(body, bad, sizeof(bad));
+    ok = ok && ws_stream_telemetry_decode(&state, body, WS_STREAM_TELEMETRY_MASK_LEN) == -1;
+    ok = ok && memcmp(&state, &t, sizeof(t)) == 0;     // Left untouched
+
+    if (ok) {
+        PASS();
+    } else {
+        FAIL("malformed body accepted");
+    }
+}
+
+void test_layout() {
+    TEST("Record sizes and header layout");
+
+    WsStreamHeader h = {WS_STREAM_MSG_SCAN, 3, 0x1234};
+    uint8_t raw[4];
+    memcpy(raw, &h, sizeof(h));
+    if (sizeof(WsStreamHeader) == 4 && sizeof(WsStreamScanPoint) == 8 &&
+        raw[0] == 0xC1 && raw[1] == 3 && raw[2] == 0x34 && raw[3] == 0x12) {
+        PASS();
+    } else {
+        FAIL("unexpected layout");
+    }
+}
+
+int main() {
+    printf("=== WS Stream Protocol Tests ===\n");
+
+    test_keyframe_roundtrip();
+    test_delta_only_changed_words();
+    test_unchanged_is_mask_only();
+    test_malformed_rejected();
+    test_layout();
+
+    printf("\nResults: %d passed, %d failed\n", tests_passed, tests_failed);
+    return tests_failed > 0 ? 1 : 0;
+}